@@ -0,0 +1,789 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "AgglomerativeClustering.hpp"
+#include "../ParallelFor.hpp"
+#include "../UnionFind.hpp"
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace Thea {
+namespace Algorithms {
+
+namespace AgglomerativeClusteringInternal {
+
+typedef AgglomerativeClustering::Linkage Linkage;
+typedef AgglomerativeClustering::Merge Merge;
+typedef AgglomerativeClustering::Edge Edge;
+
+// Don't spawn a thread for less than this many floating-point operations, since thread creation has significant overhead.
+static long const MIN_WORK_PER_THREAD = 200000;
+
+// Squared Euclidean distance between two points.
+inline double
+squaredDistance(double const * a, double const * b, long num_dims)
+{
+  double sum = 0;
+  for (long i = 0; i < num_dims; ++i)
+  {
+    double d = a[i] - b[i];
+    sum += d * d;
+  }
+
+  return sum;
+}
+
+// Get the number of threads to use for a task with a given amount of work.
+long
+numThreads(bool parallelize, double work)
+{
+  return parallelize ? numThreadsForWork(work, MIN_WORK_PER_THREAD) : 1;
+}
+
+// Calls the run() function of a task on one of a number of contiguous blocks of items. The task is shared, not copied.
+template <typename TaskT>
+struct BlockRunner
+{
+  BlockRunner(TaskT * task_, long num_items_, long num_blocks_) : task(task_), num_items(num_items_), num_blocks(num_blocks_) {}
+
+  void operator()(long block)
+  {
+    double items_per_block = num_items / (double)num_blocks;
+    long begin = (long)Math::round(block * items_per_block);
+    long end = (block + 1 == num_blocks ? num_items : (long)Math::round((block + 1) * items_per_block));
+    task->run(begin, end, block);
+  }
+
+  TaskT * task;
+  long num_items, num_blocks;
+
+}; // struct BlockRunner
+
+// Split [0, num_items) into num_blocks contiguous blocks and run a task on each, one block per thread.
+template <typename TaskT>
+void
+runOnBlocks(TaskT & task, long num_items, long num_blocks)
+{
+  if (num_blocks <= 1 || num_items < num_blocks)
+  {
+    task.run(0, num_items, 0);
+    return;
+  }
+
+  parallelFor(num_blocks, BlockRunner<TaskT>(&task, num_items, num_blocks), 1, num_blocks);
+}
+
+// Is (d0, i0) lexicographically smaller than (d1, i1)?
+inline bool
+lexLess(double d0, long i0, double d1, long i1)
+{
+  return d0 < d1 || (d0 == d1 && i0 < i1);
+}
+
+// Exact agglomerative clustering of vectors with the nearest-neighbor chain algorithm. Each cluster occupies the slot of one
+// of its member points, and member points are kept in linked lists so that average and complete linkages can be recomputed
+// without storing a dissimilarity matrix.
+class NNChain
+{
+  public:
+    NNChain(long num_points_, long num_dims_, double const * points_, Linkage linkage_, bool parallelize_)
+    : num_points(num_points_), num_dims(num_dims_), points(points_), linkage(linkage_), parallelize(parallelize_),
+      sizes((array_size_t)num_points_, 1), first_member((array_size_t)num_points_), last_member((array_size_t)num_points_),
+      next_member((array_size_t)num_points_, -1), active((array_size_t)num_points_), active_pos((array_size_t)num_points_)
+    {
+      for (long i = 0; i < num_points; ++i)
+      {
+        first_member[(array_size_t)i] = last_member[(array_size_t)i] = i;
+        active[(array_size_t)i] = active_pos[(array_size_t)i] = i;
+      }
+
+      if (linkage == Linkage::WARD)
+        centroids.assign(points, points + num_points * num_dims);
+    }
+
+    void run(TheaArray<Merge> & point_merges)
+    {
+      point_merges.clear();
+      point_merges.reserve((array_size_t)std::max(num_points - 1, 0L));
+
+      TheaArray<long> chain;
+      while (active.size() > 1)
+      {
+        if (chain.empty())
+          chain.push_back(active[0]);
+
+        long a = chain.back();
+        long prev = (chain.size() >= 2 ? chain[chain.size() - 2] : -1);
+
+        double dist;
+        long b = nearest(a, prev, dist);
+
+        if (b == prev)
+        {
+          chain.pop_back();
+          chain.pop_back();
+          merge(a, b, dist, point_merges);
+        }
+        else
+          chain.push_back(b);
+      }
+    }
+
+    // Search the block [begin, end) of active clusters for the one nearest the query cluster.
+    void run(long begin, long end, long block)
+    {
+      double best_dist = std::numeric_limits<double>::infinity();
+      long best_slot = -1;
+      for (long i = begin; i < end; ++i)
+      {
+        long c = active[(array_size_t)i];
+        if (c == query)
+          continue;
+
+        double d = linkageDistance(query, c, best_dist);
+        if (lexLess(d, c, best_dist, best_slot < 0 ? std::numeric_limits<long>::max() : best_slot))
+        {
+          best_dist = d;
+          best_slot = c;
+        }
+      }
+
+      block_dists[(array_size_t)block] = best_dist;
+      block_slots[(array_size_t)block] = best_slot;
+    }
+
+  private:
+    // Find the nearest active cluster to a, preferring prev in case of ties (required for correctness of the chain).
+    long nearest(long a, long prev, double & dist)
+    {
+      double work = (linkage == Linkage::WARD ? (double)active.size() * num_dims
+                                              : (double)sizes[(array_size_t)a] * (double)num_points * num_dims);
+      long num_blocks = std::min(numThreads(parallelize, work), std::max((long)active.size(), 1L));  // every block is non-empty
+
+      query = a;
+      block_dists.resize((array_size_t)num_blocks);
+      block_slots.resize((array_size_t)num_blocks);
+      runOnBlocks(*this, (long)active.size(), num_blocks);
+
+      dist = std::numeric_limits<double>::infinity();
+      long best = -1;
+      for (array_size_t i = 0; i < block_slots.size(); ++i)
+        if (block_slots[i] >= 0 && (best < 0 || lexLess(block_dists[i], block_slots[i], dist, best)))
+        {
+          dist = block_dists[i];
+          best = block_slots[i];
+        }
+
+      if (prev >= 0)
+      {
+        double prev_dist = linkageDistance(a, prev, std::numeric_limits<double>::infinity());
+        if (prev_dist <= dist)
+        {
+          dist = prev_dist;
+          best = prev;
+        }
+      }
+
+      return best;
+    }
+
+    // Distance between two clusters. For complete linkage, the computation may stop early and return any value greater than
+    // \a bound once the distance is known to exceed it.
+    double linkageDistance(long a, long b, double bound) const
+    {
+      switch (linkage)
+      {
+        case Linkage::WARD:
+        {
+          double na = (double)sizes[(array_size_t)a], nb = (double)sizes[(array_size_t)b];
+          double sqdist = squaredDistance(&centroids[(array_size_t)(a * num_dims)], &centroids[(array_size_t)(b * num_dims)],
+                                          num_dims);
+          return std::sqrt(2 * na * nb / (na + nb) * sqdist);
+        }
+
+        case Linkage::AVERAGE:
+        {
+          double sum = 0;
+          for (long i = first_member[(array_size_t)a]; i >= 0; i = next_member[(array_size_t)i])
+            for (long j = first_member[(array_size_t)b]; j >= 0; j = next_member[(array_size_t)j])
+              sum += std::sqrt(squaredDistance(points + i * num_dims, points + j * num_dims, num_dims));
+
+          return sum / ((double)sizes[(array_size_t)a] * (double)sizes[(array_size_t)b]);
+        }
+
+        default:  // Linkage::COMPLETE
+        {
+          double sq_bound = (bound < std::numeric_limits<double>::infinity() ? bound * bound : bound);
+          double max_sqdist = 0;
+          for (long i = first_member[(array_size_t)a]; i >= 0; i = next_member[(array_size_t)i])
+            for (long j = first_member[(array_size_t)b]; j >= 0; j = next_member[(array_size_t)j])
+            {
+              double sqdist = squaredDistance(points + i * num_dims, points + j * num_dims, num_dims);
+              if (sqdist > max_sqdist)
+              {
+                max_sqdist = sqdist;
+                if (max_sqdist > sq_bound)
+                  return std::sqrt(max_sqdist);
+              }
+            }
+
+          return std::sqrt(max_sqdist);
+        }
+      }
+    }
+
+    // Merge cluster b into cluster a.
+    void merge(long a, long b, double dist, TheaArray<Merge> & point_merges)
+    {
+      array_size_t ia = (array_size_t)a, ib = (array_size_t)b;
+
+      if (linkage == Linkage::WARD)
+      {
+        double na = (double)sizes[ia], nb = (double)sizes[ib];
+        double * ca = &centroids[(array_size_t)(a * num_dims)];
+        double const * cb = &centroids[(array_size_t)(b * num_dims)];
+        for (long i = 0; i < num_dims; ++i)
+          ca[i] = (na * ca[i] + nb * cb[i]) / (na + nb);
+      }
+
+      sizes[ia] += sizes[ib];
+      next_member[(array_size_t)last_member[ia]] = first_member[ib];
+      last_member[ia] = last_member[ib];
+
+      // Remove b from the list of active clusters
+      long pos = active_pos[ib];
+      long last = active.back();
+      active[(array_size_t)pos] = last;
+      active_pos[(array_size_t)last] = pos;
+      active.pop_back();
+
+      point_merges.push_back(Merge(a, b, dist, sizes[ia]));
+    }
+
+    long num_points;
+    long num_dims;
+    double const * points;
+    Linkage linkage;
+    bool parallelize;
+
+    TheaArray<long> sizes;
+    TheaArray<double> centroids;
+    TheaArray<long> first_member;
+    TheaArray<long> last_member;
+    TheaArray<long> next_member;
+    TheaArray<long> active;
+    TheaArray<long> active_pos;
+
+    long query;
+    TheaArray<double> block_dists;
+    TheaArray<long> block_slots;
+
+}; // class NNChain
+
+// Greedy agglomerative clustering restricted to the edges of a sparse graph. Each cluster occupies the slot of one of its
+// member points, and keeps a list of adjacent clusters sorted by slot. Pairs are processed from a priority queue, with stale
+// entries detected by per-cluster version numbers.
+class GraphAgglomerator
+{
+  public:
+    GraphAgglomerator(long num_points_, long num_dims_, double const * points_, Linkage linkage_)
+    : num_points(num_points_), num_dims(num_dims_), points(points_), linkage(linkage_),
+      sizes((array_size_t)num_points_, 1), versions((array_size_t)num_points_, 0), active((array_size_t)num_points_, true),
+      nbrs((array_size_t)num_points_)
+    {
+      if (linkage == Linkage::WARD)
+        centroids.assign(points, points + num_points * num_dims);
+    }
+
+    void run(TheaArray<Edge> const & edges, TheaArray<Merge> & point_merges)
+    {
+      initGraph(edges);
+
+      point_merges.clear();
+      while (!queue.empty())
+      {
+        QueueEntry e = queue.top();
+        queue.pop();
+
+        if (!active[(array_size_t)e.a] || !active[(array_size_t)e.b]
+         || versions[(array_size_t)e.a] != e.va || versions[(array_size_t)e.b] != e.vb)
+          continue;
+
+        merge(e.a, e.b, e.dist, point_merges);
+      }
+    }
+
+  private:
+    // A neighboring cluster. For average linkage, the value is the sum of the distances along the edges between the clusters;
+    // for complete linkage it is their maximum, and for Ward linkage it is the linkage distance itself.
+    struct Neighbor
+    {
+      Neighbor() {}
+      Neighbor(long cluster_, double value_, long count_) : cluster(cluster_), value(value_), count(count_) {}
+
+      bool operator<(Neighbor const & rhs) const
+      {
+        return cluster < rhs.cluster || (cluster == rhs.cluster && value < rhs.value);
+      }
+
+      long cluster;
+      double value;
+      long count;
+
+    }; // struct Neighbor
+
+    // An entry in the priority queue. The entry is stale if either cluster has changed since it was created.
+    struct QueueEntry
+    {
+      QueueEntry(double dist_, long a_, long b_, long va_, long vb_) : dist(dist_), a(a_), b(b_), va(va_), vb(vb_) {}
+
+      // Reversed, so that std::priority_queue returns the smallest distance first (with ties broken by index)
+      bool operator<(QueueEntry const & rhs) const
+      {
+        if (dist != rhs.dist) return dist > rhs.dist;
+        if (a != rhs.a) return a > rhs.a;
+        return b > rhs.b;
+      }
+
+      double dist;
+      long a, b;
+      long va, vb;
+
+    }; // struct QueueEntry
+
+    typedef TheaArray<Neighbor> NeighborList;
+
+    double wardDistance(long a, long b) const
+    {
+      double na = (double)sizes[(array_size_t)a], nb = (double)sizes[(array_size_t)b];
+      double sqdist = squaredDistance(&centroids[(array_size_t)(a * num_dims)], &centroids[(array_size_t)(b * num_dims)],
+                                      num_dims);
+      return std::sqrt(2 * na * nb / (na + nb) * sqdist);
+    }
+
+    double distance(Neighbor const & nbr) const
+    {
+      return linkage == Linkage::AVERAGE ? nbr.value / nbr.count : nbr.value;
+    }
+
+    void enqueue(long a, long b, double dist)
+    {
+      queue.push(QueueEntry(dist, a, b, versions[(array_size_t)a], versions[(array_size_t)b]));
+    }
+
+    void initGraph(TheaArray<Edge> const & edges)
+    {
+      for (array_size_t i = 0; i < edges.size(); ++i)
+      {
+        Edge const & e = edges[i];
+        if (e.first == e.second || e.first < 0 || e.second < 0 || e.first >= num_points || e.second >= num_points)
+          continue;
+
+        double value = (linkage == Linkage::WARD
+                      ? std::sqrt(squaredDistance(points + e.first * num_dims, points + e.second * num_dims, num_dims))
+                      : e.distance);
+
+        nbrs[(array_size_t)e.first].push_back(Neighbor(e.second, value, 1));
+        nbrs[(array_size_t)e.second].push_back(Neighbor(e.first, value, 1));
+      }
+
+      // Sort the neighbors of each vertex, keeping only the shortest of any repeated edges
+      for (long i = 0; i < num_points; ++i)
+      {
+        NeighborList & list = nbrs[(array_size_t)i];
+        std::sort(list.begin(), list.end());
+
+        array_size_t num_unique = 0;
+        for (array_size_t j = 0; j < list.size(); ++j)
+          if (num_unique == 0 || list[num_unique - 1].cluster != list[j].cluster)
+            list[num_unique++] = list[j];
+
+        list.resize(num_unique);
+
+        for (array_size_t j = 0; j < list.size(); ++j)
+          if (list[j].cluster > i)
+            enqueue(i, list[j].cluster, distance(list[j]));
+      }
+    }
+
+    // Merge two clusters, keeping the slot of the one with more neighbors.
+    void merge(long a, long b, double dist, TheaArray<Merge> & point_merges)
+    {
+      if (nbrs[(array_size_t)a].size() < nbrs[(array_size_t)b].size())
+        std::swap(a, b);
+
+      array_size_t ia = (array_size_t)a, ib = (array_size_t)b;
+
+      if (linkage == Linkage::WARD)
+      {
+        double na = (double)sizes[ia], nb = (double)sizes[ib];
+        double * ca = &centroids[(array_size_t)(a * num_dims)];
+        double const * cb = &centroids[(array_size_t)(b * num_dims)];
+        for (long i = 0; i < num_dims; ++i)
+          ca[i] = (na * ca[i] + nb * cb[i]) / (na + nb);
+      }
+
+      sizes[ia] += sizes[ib];
+      active[ib] = false;
+      versions[ia]++;
+
+      // Combine the two neighbor lists, which are sorted by cluster
+      NeighborList const & la = nbrs[ia];
+      NeighborList const & lb = nbrs[ib];
+      NeighborList combined;
+      combined.reserve(la.size() + lb.size());
+
+      array_size_t i = 0, j = 0;
+      while (i < la.size() || j < lb.size())
+      {
+        Neighbor n;
+        if (j >= lb.size() || (i < la.size() && la[i].cluster < lb[j].cluster))
+          n = la[i++];
+        else if (i >= la.size() || lb[j].cluster < la[i].cluster)
+          n = lb[j++];
+        else
+        {
+          n = la[i];
+          if (linkage == Linkage::COMPLETE)
+            n.value = std::max(la[i].value, lb[j].value);
+          else
+            n.value = la[i].value + lb[j].value;
+
+          n.count = la[i].count + lb[j].count;
+          ++i; ++j;
+        }
+
+        if (n.cluster == a || n.cluster == b)
+          continue;
+
+        if (linkage == Linkage::WARD)
+          n.value = wardDistance(a, n.cluster);
+
+        combined.push_back(n);
+      }
+
+      nbrs[ia].swap(combined);
+      NeighborList().swap(nbrs[ib]);
+
+      // Update the reverse links and queue the new pairs
+      NeighborList const & merged = nbrs[ia];
+      for (array_size_t k = 0; k < merged.size(); ++k)
+      {
+        long c = merged[k].cluster;
+        updateNeighbor(c, a, b, merged[k]);
+        enqueue(a, c, distance(merged[k]));
+      }
+
+      point_merges.push_back(Merge(a, b, dist, sizes[ia]));
+    }
+
+    // Replace the links from cluster c to clusters a and b with a single link to a.
+    void updateNeighbor(long c, long a, long b, Neighbor const & link)
+    {
+      NeighborList & list = nbrs[(array_size_t)c];
+
+      NeighborList::iterator bi = std::lower_bound(list.begin(), list.end(), Neighbor(b, -std::numeric_limits<double>::max(), 0));
+      if (bi != list.end() && bi->cluster == b)
+        list.erase(bi);
+
+      Neighbor n(a, link.value, link.count);
+      NeighborList::iterator ai = std::lower_bound(list.begin(), list.end(), Neighbor(a, -std::numeric_limits<double>::max(), 0));
+      if (ai != list.end() && ai->cluster == a)
+        *ai = n;
+      else
+        list.insert(ai, n);
+    }
+
+    long num_points;
+    long num_dims;
+    double const * points;
+    Linkage linkage;
+
+    TheaArray<long> sizes;
+    TheaArray<long> versions;
+    TheaArray<bool> active;
+    TheaArray<double> centroids;
+    TheaArray<NeighborList> nbrs;
+    std::priority_queue<QueueEntry> queue;
+
+}; // class GraphAgglomerator
+
+// Finds the k nearest neighbors of each point in a block by brute force.
+struct BruteForceNeighborTask
+{
+  BruteForceNeighborTask(long num_points_, long num_dims_, double const * points_, long k_, long * nbr_indices_,
+                         double * nbr_dists_)
+  : num_points(num_points_), num_dims(num_dims_), points(points_), k(k_), nbr_indices(nbr_indices_), nbr_dists(nbr_dists_)
+  {}
+
+  void run(long begin, long end, long block)
+  {
+    typedef std::pair<double, long> DistIndex;
+    std::priority_queue<DistIndex> nearest;  // max-heap of the k nearest so far
+
+    for (long i = begin; i < end; ++i)
+    {
+      double const * p = points + i * num_dims;
+      for (long j = 0; j < num_points; ++j)
+      {
+        if (j == i)
+          continue;
+
+        double sqdist = squaredDistance(p, points + j * num_dims, num_dims);
+        if ((long)nearest.size() < k)
+          nearest.push(DistIndex(sqdist, j));
+        else if (sqdist < nearest.top().first)
+        {
+          nearest.pop();
+          nearest.push(DistIndex(sqdist, j));
+        }
+      }
+
+      for (long m = (long)nearest.size() - 1; m >= 0; --m)
+      {
+        nbr_indices[i * k + m] = nearest.top().second;
+        nbr_dists[i * k + m] = std::sqrt(nearest.top().first);
+        nearest.pop();
+      }
+    }
+  }
+
+  long num_points;
+  long num_dims;
+  double const * points;
+  long k;
+  long * nbr_indices;
+  double * nbr_dists;
+
+}; // struct BruteForceNeighborTask
+
+// Orders edges by their endpoints, then by distance.
+struct EdgeLess
+{
+  bool operator()(Edge const & e0, Edge const & e1) const
+  {
+    if (e0.first != e1.first) return e0.first < e1.first;
+    if (e0.second != e1.second) return e0.second < e1.second;
+    return e0.distance < e1.distance;
+  }
+
+}; // struct EdgeLess
+
+// Orders merges by distance.
+struct MergeLess
+{
+  bool operator()(Merge const & m0, Merge const & m1) const { return m0.distance < m1.distance; }
+
+}; // struct MergeLess
+
+} // namespace AgglomerativeClusteringInternal
+
+void
+AgglomerativeClustering::clusterVectors(long num_points_, long num_dims, double const * points)
+{
+  using namespace AgglomerativeClusteringInternal;
+
+  alwaysAssertM(num_points_ >= 0 && num_dims > 0, "AgglomerativeClustering: Invalid number of points or dimensions");
+
+  num_points = num_points_;
+  merges.clear();
+  if (num_points <= 1)
+    return;
+
+  if (options.verbose)
+    THEA_CONSOLE << "AgglomerativeClustering: Clustering " << num_points << " points with " << options.linkage.toString()
+                 << " linkage (nearest-neighbor chain)";
+
+  TheaArray<Merge> point_merges;
+  NNChain nn_chain(num_points, num_dims, points, options.linkage, options.parallelize);
+  nn_chain.run(point_merges);
+
+  // The nearest-neighbor chain finds the merges of the greedy algorithm, but out of order
+  finalizeMerges(point_merges, true);
+}
+
+void
+AgglomerativeClustering::clusterGraph(long num_points_, TheaArray<Edge> const & edges, long num_dims, double const * points)
+{
+  using namespace AgglomerativeClusteringInternal;
+
+  alwaysAssertM(num_points_ >= 0, "AgglomerativeClustering: Invalid number of points");
+
+  if (options.linkage == Linkage::WARD && (!points || num_dims <= 0))
+    throw Error("AgglomerativeClustering: Ward linkage requires point coordinates");
+
+  num_points = num_points_;
+  merges.clear();
+  if (num_points <= 1)
+    return;
+
+  if (options.verbose)
+    THEA_CONSOLE << "AgglomerativeClustering: Clustering graph with " << num_points << " vertices and " << edges.size()
+                 << " edges, with " << options.linkage.toString() << " linkage";
+
+  TheaArray<Merge> point_merges;
+  GraphAgglomerator agglomerator(num_points, num_dims, points, options.linkage);
+  agglomerator.run(edges, point_merges);
+
+  if (options.verbose && (long)point_merges.size() < num_points - 1)
+    THEA_CONSOLE << "AgglomerativeClustering: Graph has " << num_points - (long)point_merges.size() << " connected components";
+
+  finalizeMerges(point_merges, false);
+}
+
+void
+AgglomerativeClustering::clusterKNNGraph(long num_points_, long num_dims, double const * points)
+{
+  using namespace AgglomerativeClusteringInternal;
+
+  alwaysAssertM(num_points_ >= 0 && num_dims > 0, "AgglomerativeClustering: Invalid number of points or dimensions");
+
+  long k = std::min(getNumNeighbors(), std::max(num_points_ - 1, 0L));
+  TheaArray<long> nbr_indices((array_size_t)(num_points_ * k), -1);
+  TheaArray<double> nbr_dists((array_size_t)(num_points_ * k), -1);
+
+  if (k > 0)
+  {
+    BruteForceNeighborTask task(num_points_, num_dims, points, k, &nbr_indices[0], &nbr_dists[0]);
+    long num_threads = numThreads(options.parallelize, (double)num_points_ * (double)num_points_ * num_dims);
+    runOnBlocks(task, num_points_, num_threads);
+  }
+
+  TheaArray<Edge> edges;
+  neighborsToEdges(num_points_, k, nbr_indices, nbr_dists, edges);
+  clusterGraph(num_points_, edges, num_dims, points);
+}
+
+void
+AgglomerativeClustering::neighborsToEdges(long n, long k, TheaArray<long> const & nbr_indices,
+                                          TheaArray<double> const & nbr_dists, TheaArray<Edge> & edges)
+{
+  using namespace AgglomerativeClusteringInternal;
+
+  edges.clear();
+  edges.reserve((array_size_t)(n * k));
+  for (long i = 0; i < n; ++i)
+    for (long j = 0; j < k; ++j)
+    {
+      long nbr = nbr_indices[(array_size_t)(i * k + j)];
+      if (nbr >= 0 && nbr != i)
+        edges.push_back(Edge(std::min(i, nbr), std::max(i, nbr), nbr_dists[(array_size_t)(i * k + j)]));
+    }
+
+  // Remove duplicates (pairs that are mutual neighbors)
+  std::sort(edges.begin(), edges.end(), EdgeLess());
+
+  array_size_t num_unique = 0;
+  for (array_size_t i = 0; i < edges.size(); ++i)
+    if (num_unique == 0 || edges[num_unique - 1].first != edges[i].first || edges[num_unique - 1].second != edges[i].second)
+      edges[num_unique++] = edges[i];
+
+  edges.resize(num_unique);
+}
+
+void
+AgglomerativeClustering::finalizeMerges(TheaArray<Merge> & point_merges, bool sort_by_distance)
+{
+  using namespace AgglomerativeClusteringInternal;
+
+  if (sort_by_distance)
+    std::stable_sort(point_merges.begin(), point_merges.end(), MergeLess());
+
+  UnionFind<> uf(num_points);
+  TheaArray<long> cluster_of_root((array_size_t)num_points);
+  for (long i = 0; i < num_points; ++i)
+    cluster_of_root[(array_size_t)i] = i;
+
+  merges.resize(point_merges.size());
+  for (array_size_t t = 0; t < point_merges.size(); ++t)
+  {
+    Merge const & pm = point_merges[t];
+    long c0 = cluster_of_root[(array_size_t)uf.find(pm.first)];
+    long c1 = cluster_of_root[(array_size_t)uf.find(pm.second)];
+
+    merges[t] = Merge(std::min(c0, c1), std::max(c0, c1), pm.distance, pm.size);
+
+    uf.merge(pm.first, pm.second);
+    cluster_of_root[(array_size_t)uf.find(pm.first)] = num_points + (long)t;
+  }
+}
+
+long
+AgglomerativeClustering::cut(long num_clusters, TheaArray<int> & labels) const
+{
+  labels.resize((array_size_t)num_points);
+  if (num_points <= 0)
+    return 0;
+
+  // Each cluster is represented by one of its points
+  TheaArray<long> rep((array_size_t)(num_points + merges.size()));
+  for (long i = 0; i < num_points; ++i)
+    rep[(array_size_t)i] = i;
+
+  for (array_size_t t = 0; t < merges.size(); ++t)
+    rep[(array_size_t)num_points + t] = rep[(array_size_t)merges[t].first];
+
+  // Apply the first n - k merges
+  long num_to_apply = std::min(std::max(num_points - num_clusters, 0L), (long)merges.size());
+  UnionFind<> uf(num_points);
+  for (long t = 0; t < num_to_apply; ++t)
+    uf.merge(rep[(array_size_t)merges[(array_size_t)t].first], rep[(array_size_t)merges[(array_size_t)t].second]);
+
+  // Number the clusters in order of first appearance
+  TheaArray<int> label_of_root((array_size_t)num_points, -1);
+  int num_labels = 0;
+  for (long i = 0; i < num_points; ++i)
+  {
+    int & root_label = label_of_root[(array_size_t)uf.find(i)];
+    if (root_label < 0)
+      root_label = num_labels++;
+
+    labels[(array_size_t)i] = root_label;
+  }
+
+  return num_labels;
+}
+
+} // namespace Algorithms
+} // namespace Thea
@@ -0,0 +1,340 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_Algorithms_AgglomerativeClustering_hpp__
+#define __Thea_Algorithms_AgglomerativeClustering_hpp__
+
+#include "../Common.hpp"
+#include "../Array.hpp"
+#include "../BoundedSortedArray.hpp"
+#include "../Math.hpp"
+#include "../ParallelFor.hpp"
+#include "../VectorN.hpp"
+#include "KDTreeN.hpp"
+#include "MetricL2.hpp"
+#include <algorithm>
+
+namespace Thea {
+namespace Algorithms {
+
+/**
+ * Native bottom-up hierarchical clustering, without the quadratic memory of a full dissimilarity matrix.
+ *
+ * Two engines are provided:
+ *   - clusterVectors() computes the exact Ward, average-linkage or complete-linkage hierarchy of a set of vectors with the
+ *     nearest-neighbor chain algorithm (Murtagh, "A survey of recent advances in hierarchical clustering algorithms", 1983).
+ *     Memory is linear in the size of the input. Linkages are recomputed from cluster centroids (Ward) or member points
+ *     (average/complete) as needed, and each nearest-neighbor search is parallelized. The chain performs O(n) searches for n
+ *     points in d dimensions, so the running time depends on the linkage:
+ *       - Ward: each search compares centroids, so the total time is O(n^2 d).
+ *       - Average and complete: each search for a cluster of size m compares each of its members with every point outside it,
+ *         taking O(m n d) time. When large clusters are searched repeatedly, as when one cluster absorbs the points one by one,
+ *         the total time approaches O(n^3 d). Complete linkage stops comparing a pair of clusters once they are known to be
+ *         farther apart than the best candidate, which often helps in practice but not in the worst case.
+ *     For more than a few thousand points with average or complete linkage, use the graph-based engine below.
+ *   - clusterGraph() and clusterKNNGraph() greedily merge clusters connected by the edges of a sparse graph, such as the
+ *     k-nearest-neighbor graph of the points. This is the scalable option for large datasets: with k neighbors per point, the
+ *     running time is roughly O(kn log n) after the graph is built, and kd-tree-accelerated graph construction is parallelized.
+ *
+ * Merges are reported with the convention of SciPy's linkage(): point i is cluster i, and the cluster created by the t'th merge
+ * is cluster n + t, where n is the number of points.
+ */
+class THEA_API AgglomerativeClustering
+{
+  public:
+    THEA_DEF_POINTER_TYPES(AgglomerativeClustering, shared_ptr, weak_ptr)
+
+    /** Ways to measure the distance between two clusters (enum class). */
+    struct THEA_API Linkage
+    {
+      /** Supported values. */
+      enum Value
+      {
+        WARD,     ///< Increase in variance, scaled to the Euclidean distance for singletons (string: "ward").
+        AVERAGE,  ///< Mean distance between members of the two clusters (string: "average").
+        COMPLETE  ///< Maximum distance between members of the two clusters (string: "complete").
+      };
+
+      THEA_ENUM_CLASS_BODY(Linkage)
+
+      THEA_ENUM_CLASS_STRINGS_BEGIN(Linkage)
+        THEA_ENUM_CLASS_STRING(WARD,      "ward")
+        THEA_ENUM_CLASS_STRING(AVERAGE,   "average")
+        THEA_ENUM_CLASS_STRING(COMPLETE,  "complete")
+      THEA_ENUM_CLASS_STRINGS_END(Linkage)
+
+    }; // struct Linkage
+
+    /** A single merge step of the hierarchy. */
+    struct THEA_API Merge
+    {
+      long first;       ///< Index of the first merged cluster.
+      long second;      ///< Index of the second merged cluster.
+      double distance;  ///< Linkage distance between the two clusters.
+      long size;        ///< Number of points in the merged cluster.
+
+      /** Default constructor. */
+      Merge() {}
+
+      /** Initializing constructor. */
+      Merge(long first_, long second_, double distance_, long size_)
+      : first(first_), second(second_), distance(distance_), size(size_) {}
+
+    }; // struct Merge
+
+    /** An undirected edge of a graph to be clustered. */
+    struct THEA_API Edge
+    {
+      long first;       ///< Index of the first endpoint.
+      long second;      ///< Index of the second endpoint.
+      double distance;  ///< Distance (dissimilarity) between the endpoints.
+
+      /** Default constructor. */
+      Edge() {}
+
+      /** Initializing constructor. */
+      Edge(long first_, long second_, double distance_) : first(first_), second(second_), distance(distance_) {}
+
+    }; // struct Edge
+
+    /** %Options for clustering. */
+    class THEA_API Options
+    {
+      public:
+        /** Constructor. Sets default options. */
+        Options() : linkage(Linkage::WARD), num_neighbors(-1), parallelize(true), verbose(false) {}
+
+        /** How to measure the distance between two clusters (default Linkage::WARD). */
+        Options & setLinkage(Linkage value) { linkage = value; return *this; }
+
+        /** Number of nearest neighbors of each point in the graph built by clusterKNNGraph() (default -1, meaning 10). */
+        Options & setNumNeighbors(long value) { num_neighbors = value; return *this; }
+
+        /** Accelerate computations by parallelization or not (default true). */
+        Options & setParallelize(bool value) { parallelize = value; return *this; }
+
+        /** Set whether progress information will be printed to the console or not (default false). */
+        Options & setVerbose(bool value) { verbose = value; return *this; }
+
+        /** Get the set of default options. */
+        static Options const & defaults() { static Options const def; return def; }
+
+      private:
+        Linkage linkage;     ///< Distance between two clusters.
+        long num_neighbors;  ///< Number of nearest neighbors of each point in a k-NN graph.
+        bool parallelize;    ///< Accelerate computations by parallelization.
+        bool verbose;        ///< Print progress information to the console.
+
+        friend class AgglomerativeClustering;
+
+    }; // class Options
+
+    /** Constructor. */
+    AgglomerativeClustering(Options const & options_ = Options::defaults()) : options(options_), num_points(0) {}
+
+    /** Get the current set of options. */
+    Options const & getOptions() const { return options; }
+
+    /** Set the options. */
+    void setOptions(Options const & options_) { options = options_; }
+
+    /**
+     * Compute the exact hierarchy of a set of vectors with the nearest-neighbor chain algorithm. Merges are ordered by
+     * increasing distance.
+     *
+     * @param num_points_ Number of points.
+     * @param num_dims Number of dimensions of each point.
+     * @param points Coordinates of the points, stored point-by-point (row-major, <tt>num_points_ x num_dims</tt>).
+     */
+    void clusterVectors(long num_points_, long num_dims, double const * points);
+
+    /**
+     * Greedily merge clusters connected by the edges of a graph, always merging the closest connected pair next. The distance
+     * between two clusters is measured only over the graph edges between them (for average and complete linkage), or from
+     * their centroids (for Ward linkage, which requires the point coordinates). If the graph is not connected, fewer than
+     * <tt>num_points_ - 1</tt> merges are produced. Merges are in the order they were performed.
+     *
+     * @param num_points_ Number of points (vertices).
+     * @param edges Graph edges. Each undirected edge needs to be listed only once; if it is repeated the smallest distance is
+     *   used.
+     * @param num_dims Number of dimensions of each point, if coordinates are supplied.
+     * @param points Coordinates of the points (row-major, <tt>num_points_ x num_dims</tt>), or null. Required for Ward linkage.
+     */
+    void clusterGraph(long num_points_, TheaArray<Edge> const & edges, long num_dims = 0, double const * points = NULL);
+
+    /**
+     * Build the symmetrized k-nearest-neighbor graph of a set of points, and cluster it with clusterGraph(). Neighbors are
+     * found by parallel brute-force search, so this overload is quadratic in the number of points. Prefer the overload for
+     * fixed-dimensional VectorN points, which uses a kd-tree.
+     */
+    void clusterKNNGraph(long num_points_, long num_dims, double const * points);
+
+    /** Build the symmetrized k-nearest-neighbor graph of a set of points with a kd-tree, and cluster it with clusterGraph(). */
+    template <long N, typename ScalarT> void clusterKNNGraph(TheaArray< VectorN<N, ScalarT> > const & points)
+    {
+      TheaArray<Edge> edges;
+      buildKNNGraph(points, getNumNeighbors(), edges, options.parallelize);
+
+      TheaArray<double> coords(points.size() * N);
+      for (array_size_t i = 0; i < points.size(); ++i)
+        for (long j = 0; j < N; ++j)
+          coords[i * N + j] = static_cast<double>(points[i][j]);
+
+      clusterGraph((long)points.size(), edges, N, coords.empty() ? NULL : &coords[0]);
+    }
+
+    /**
+     * Get the edges of the k-nearest-neighbor graph of a set of points, using a kd-tree. Each undirected edge is listed once,
+     * from the lower-indexed to the higher-indexed point, with the Euclidean distance between them.
+     */
+    template <long N, typename ScalarT>
+    static void buildKNNGraph(TheaArray< VectorN<N, ScalarT> > const & points, long k, TheaArray<Edge> & edges,
+                              bool parallelize = true)
+    {
+      typedef KDTreeN<VectorN<N, ScalarT>, N, ScalarT> KDTree;
+      KDTree kdtree(points.begin(), points.end());
+
+      long n = (long)points.size();
+      TheaArray<long> nbr_indices((array_size_t)(n * k), -1);
+      TheaArray<double> nbr_dists((array_size_t)(n * k), -1);
+
+      if (n > 0 && k > 0)
+      {
+        static long const MIN_POINTS_PER_THREAD = 256;
+        parallelForChunks(n, NeighborFinder<KDTree>(&kdtree, &points[0], k, &nbr_indices[0], &nbr_dists[0]), -1,
+                          parallelize ? numThreadsForWork(n, MIN_POINTS_PER_THREAD) : 1);
+      }
+
+      neighborsToEdges(n, k, nbr_indices, nbr_dists, edges);
+    }
+
+    /** Get the number of points clustered. */
+    long numPoints() const { return num_points; }
+
+    /** Get the number of merges. */
+    long numMerges() const { return (long)merges.size(); }
+
+    /** Get a merge step. */
+    Merge const & getMerge(long i) const { return merges[(array_size_t)i]; }
+
+    /** Get all merge steps. */
+    TheaArray<Merge> const & getMerges() const { return merges; }
+
+    /**
+     * Get a flat clustering with (at least) a given number of clusters, by applying the first <tt>n - num_clusters</tt>
+     * merges, where n is the number of points. More clusters are returned if the hierarchy is a forest with more than
+     * \a num_clusters trees.
+     *
+     * @param num_clusters The desired number of clusters.
+     * @param labels Used to return the cluster label of each point, in the range [0, number of clusters).
+     *
+     * @return The number of clusters.
+     */
+    long cut(long num_clusters, TheaArray<int> & labels) const;
+
+  private:
+    /** Finds the k nearest neighbors of a range of points. */
+    template <typename KDTreeT> class NeighborFinder
+    {
+      public:
+        /** Constructor. */
+        NeighborFinder(KDTreeT const * kdtree_, typename KDTreeT::VectorT const * points_, long k_, long * nbr_indices_,
+                       double * nbr_dists_)
+        : kdtree(kdtree_), points(points_), k(k_), nbr_indices(nbr_indices_), nbr_dists(nbr_dists_)
+        {}
+
+        /** Find the neighbors of the points with indices in [points_begin, points_end). */
+        void operator()(long points_begin, long points_end)
+        {
+          // Ask for one extra neighbor since each point is its own nearest neighbor
+          BoundedSortedArray<typename KDTreeT::NeighborPair> nbrs((int)k + 1);
+          for (long i = points_begin; i < points_end; ++i)
+          {
+            kdtree->template kClosestPairs<MetricL2>(points[i], nbrs);
+
+            long m = 0;
+            for (int j = 0; j < nbrs.size() && m < k; ++j)
+            {
+              long nbr = nbrs[j].getTargetIndex();
+              if (nbr == i)
+                continue;
+
+              nbr_indices[i * k + m] = nbr;
+              nbr_dists[i * k + m] = MetricL2::invertMonotoneApprox(nbrs[j].getMonotoneApproxDistance());
+              ++m;
+            }
+          }
+        }
+
+      private:
+        KDTreeT const * kdtree;
+        typename KDTreeT::VectorT const * points;
+        long k;
+        long * nbr_indices;
+        double * nbr_dists;
+
+    }; // class NeighborFinder
+
+    /** Get the number of neighbors per point in a k-NN graph. */
+    long getNumNeighbors() const { return options.num_neighbors > 0 ? options.num_neighbors : 10; }
+
+    /**
+     * Convert lists of k nearest neighbors (unused slots marked with negative indices) to undirected edges, each listed once.
+     */
+    static void neighborsToEdges(long n, long k, TheaArray<long> const & nbr_indices, TheaArray<double> const & nbr_dists,
+                                 TheaArray<Edge> & edges);
+
+    /**
+     * Convert merges, specified by arbitrary member points of the two merged clusters, to SciPy-style cluster indices, after
+     * optionally sorting them by distance.
+     */
+    void finalizeMerges(TheaArray<Merge> & point_merges, bool sort_by_distance);
+
+    Options options;          ///< Clustering options.
+    long num_points;          ///< Number of points clustered.
+    TheaArray<Merge> merges;  ///< Merge steps.
+
+}; // class AgglomerativeClustering
+
+} // namespace Algorithms
+} // namespace Thea
+
+#endif
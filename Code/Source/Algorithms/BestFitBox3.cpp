@@ -41,8 +41,16 @@
 
 #include "BestFitBox3.hpp"
 #include "CentroidN.hpp"
+#include "ConvexHull3.hpp"
 #include "LinearLeastSquares3.hpp"
 #include "../Quat.hpp"
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define THEA_BEST_FIT_BOX_SSE2
+#endif
 
 namespace Thea {
 namespace Algorithms {
@@ -227,10 +235,474 @@ computeBestFitOBB(TheaArray<Vector3> const & points, Box3 & result, bool has_up,
   result = Box3(AxisAlignedBox3(best_obb.lo, best_obb.hi), best_obb.cframe);
 }
 
+//
+// Convex hull method: reduce the points to a subset of the vertices of their convex hull (the extreme points along a set of
+// directions), compute the convex hull of this subset, and for each hull face (or the plane perpendicular to the up vector),
+// find the minimum-area rectangle enclosing the hull in the plane of the face with rotating calipers [Toussaint 1983]. The box
+// with one face flush with a hull face, and minimum volume, is selected, and its final extents are computed from all the input
+// points. This is the face-flush search of O'Rourke's exact minimum-volume box algorithm ["Finding minimal enclosing boxes",
+// 1985], without the cubic-time search over pairs of edges, which rarely improves the result.
+//
+
+// Number of directions along which extreme points are found, to build the convex hull
+static int const NUM_EXTREME_DIRECTIONS = 128;
+
+// Number of points whose projections are computed together, chosen so that a block fits comfortably in the L1 cache
+static array_size_t const POINT_BLOCK_SIZE = 1024;
+
+// Point coordinates, stored as separate arrays padded to a multiple of 4 elements (by repeating the last point), for SIMD
+// processing.
+struct PackedPoints
+{
+  PackedPoints(TheaArray<Vector3> const & points) : num_points(points.size())
+  {
+    array_size_t padded_size = ((num_points + 3) / 4) * 4;
+    x.resize(padded_size); y.resize(padded_size); z.resize(padded_size);
+
+    for (array_size_t i = 0; i < padded_size; ++i)
+    {
+      Vector3 const & p = points[std::min(i, num_points - 1)];
+      x[i] = (float)p.x(); y[i] = (float)p.y(); z[i] = (float)p.z();
+    }
+  }
+
+  array_size_t num_points;
+  TheaArray<float> x, y, z;
+};
+
+// The points with the minimum and maximum projections onto a direction
+struct Extremes
+{
+  float min_val, max_val;
+  long min_index, max_index;
+};
+
+// Find the points with the minimum and maximum projections onto each of a set of directions. Ties are broken arbitrarily.
+static void
+findExtremes(PackedPoints const & points, TheaArray<Vector3> const & dirs, TheaArray<Extremes> & extremes)
+{
+  array_size_t num_dirs = dirs.size();
+  array_size_t padded_size = points.x.size();
+  float const * x = &points.x[0];
+  float const * y = &points.y[0];
+  float const * z = &points.z[0];
+
+#ifdef THEA_BEST_FIT_BOX_SSE2
+
+  // Running extremes of each of the 4 lanes, for each direction
+  TheaArray<float> lane_min(4 * num_dirs, std::numeric_limits<float>::max());
+  TheaArray<float> lane_max(4 * num_dirs, -std::numeric_limits<float>::max());
+  TheaArray<int32> lane_min_index(4 * num_dirs, 0);
+  TheaArray<int32> lane_max_index(4 * num_dirs, 0);
+
+  for (array_size_t block_begin = 0; block_begin < padded_size; block_begin += POINT_BLOCK_SIZE)
+  {
+    array_size_t block_end = std::min(block_begin + POINT_BLOCK_SIZE, padded_size);
+
+    for (array_size_t d = 0; d < num_dirs; ++d)
+    {
+      __m128 dx = _mm_set1_ps((float)dirs[d].x()), dy = _mm_set1_ps((float)dirs[d].y()), dz = _mm_set1_ps((float)dirs[d].z());
+      __m128 vmin = _mm_loadu_ps(&lane_min[4 * d]), vmax = _mm_loadu_ps(&lane_max[4 * d]);
+      __m128i vmin_index = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&lane_min_index[4 * d]));
+      __m128i vmax_index = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&lane_max_index[4 * d]));
+      __m128i index = _mm_setr_epi32((int)block_begin, (int)block_begin + 1, (int)block_begin + 2, (int)block_begin + 3);
+      __m128i const four = _mm_set1_epi32(4);
+
+      for (array_size_t i = block_begin; i < block_end; i += 4)
+      {
+        __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), dx), _mm_mul_ps(_mm_loadu_ps(y + i), dy)),
+                              _mm_mul_ps(_mm_loadu_ps(z + i), dz));
+
+        __m128i lt = _mm_castps_si128(_mm_cmplt_ps(p, vmin));
+        vmin = _mm_min_ps(p, vmin);
+        vmin_index = _mm_or_si128(_mm_and_si128(lt, index), _mm_andnot_si128(lt, vmin_index));
+
+        __m128i gt = _mm_castps_si128(_mm_cmpgt_ps(p, vmax));
+        vmax = _mm_max_ps(p, vmax);
+        vmax_index = _mm_or_si128(_mm_and_si128(gt, index), _mm_andnot_si128(gt, vmax_index));
+
+        index = _mm_add_epi32(index, four);
+      }
+
+      _mm_storeu_ps(&lane_min[4 * d], vmin);
+      _mm_storeu_ps(&lane_max[4 * d], vmax);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(&lane_min_index[4 * d]), vmin_index);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(&lane_max_index[4 * d]), vmax_index);
+    }
+  }
+
+  // Reduce the lanes
+  extremes.resize(num_dirs);
+  for (array_size_t d = 0; d < num_dirs; ++d)
+  {
+    Extremes & e = extremes[d];
+    array_size_t base = 4 * d;
+
+    e.min_val = lane_min[base]; e.min_index = lane_min_index[base];
+    e.max_val = lane_max[base]; e.max_index = lane_max_index[base];
+    for (array_size_t j = base + 1; j < base + 4; ++j)
+    {
+      if (lane_min[j] < e.min_val) { e.min_val = lane_min[j]; e.min_index = lane_min_index[j]; }
+      if (lane_max[j] > e.max_val) { e.max_val = lane_max[j]; e.max_index = lane_max_index[j]; }
+    }
+  }
+
+#else
+
+  extremes.resize(num_dirs);
+  for (array_size_t d = 0; d < num_dirs; ++d)
+  {
+    Extremes & e = extremes[d];
+    e.min_val = std::numeric_limits<float>::max(); e.max_val = -std::numeric_limits<float>::max();
+    e.min_index = e.max_index = 0;
+  }
+
+  for (array_size_t block_begin = 0; block_begin < padded_size; block_begin += POINT_BLOCK_SIZE)
+  {
+    array_size_t block_end = std::min(block_begin + POINT_BLOCK_SIZE, padded_size);
+
+    for (array_size_t d = 0; d < num_dirs; ++d)
+    {
+      float dx = (float)dirs[d].x(), dy = (float)dirs[d].y(), dz = (float)dirs[d].z();
+      Extremes & e = extremes[d];
+
+      for (array_size_t i = block_begin; i < block_end; ++i)
+      {
+        float p = x[i] * dx + y[i] * dy + z[i] * dz;
+        if (p < e.min_val) { e.min_val = p; e.min_index = (long)i; }
+        if (p > e.max_val) { e.max_val = p; e.max_index = (long)i; }
+      }
+    }
+  }
+
+#endif
+
+  // Map padding points back to the last point
+  for (array_size_t d = 0; d < num_dirs; ++d)
+  {
+    extremes[d].min_index = std::min(extremes[d].min_index, (long)points.num_points - 1);
+    extremes[d].max_index = std::min(extremes[d].max_index, (long)points.num_points - 1);
+  }
+}
+
+// Z component of the cross product of two 2D vectors
+static Real
+cross2(Vector2 const & a, Vector2 const & b)
+{
+  return a.x() * b.y() - a.y() * b.x();
+}
+
+// Compute the convex hull of a set of 2D points, in counter-clockwise order, without collinear vertices (Andrew's monotone chain
+// algorithm).
+static void
+convexHull2(TheaArray<Vector2> & points, TheaArray<Vector2> & hull)
+{
+  struct LexLess
+  {
+    bool operator()(Vector2 const & a, Vector2 const & b) const
+    { return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y()); }
+  };
+
+  hull.clear();
+  if (points.size() < 3)
+  {
+    hull = points;
+    return;
+  }
+
+  std::sort(points.begin(), points.end(), LexLess());
+
+  hull.resize(2 * points.size());
+  array_size_t k = 0;
+
+  // Lower hull
+  for (array_size_t i = 0; i < points.size(); ++i)
+  {
+    while (k >= 2 && cross2(hull[k - 1] - hull[k - 2], points[i] - hull[k - 2]) <= 0) --k;
+    hull[k++] = points[i];
+  }
+
+  // Upper hull
+  for (array_size_t i = points.size() - 1, t = k + 1; i > 0; --i)
+  {
+    while (k >= t && cross2(hull[k - 1] - hull[k - 2], points[i - 1] - hull[k - 2]) <= 0) --k;
+    hull[k++] = points[i - 1];
+  }
+
+  hull.resize(k - 1);  // the last point is the same as the first
+}
+
+// Find the minimum-area rectangle enclosing a convex polygon (vertices in counter-clockwise order), which has a side collinear
+// with an edge of the polygon, with rotating calipers. Returns the area, and the direction of the flush side.
+static Real
+minAreaRectangle(TheaArray<Vector2> const & poly, Vector2 & dir)
+{
+  long n = (long)poly.size();
+  if (n < 3)
+  {
+    dir = (n == 2 ? (poly[1] - poly[0]).unit() : Vector2::unitX());
+    if (!(dir.squaredLength() > 0.5f)) dir = Vector2::unitX();  // coincident points
+    return 0;
+  }
+
+  Real best_area = -1;
+  long r = 0, t = 0, l = 0;  // calipers: maximum along edge, maximum along inward normal, minimum along edge
+  for (long i = 0; i < n; ++i)
+  {
+    Vector2 const & p = poly[(array_size_t)i];
+    Vector2 e = poly[(array_size_t)((i + 1) % n)] - p;
+    Real len = e.length();
+    if (len <= 0) continue;
+    e /= len;
+    Vector2 normal(-e.y(), e.x());  // inward, since the polygon is counter-clockwise
+
+    if (i == 0) r = 1;
+    while (e.dot(poly[(array_size_t)((r + 1) % n)] - poly[(array_size_t)(r % n)]) > 0) ++r;
+
+    if (i == 0) t = r;
+    while (normal.dot(poly[(array_size_t)((t + 1) % n)] - poly[(array_size_t)(t % n)]) > 0) ++t;
+
+    if (i == 0) l = t;
+    while (e.dot(poly[(array_size_t)((l + 1) % n)] - poly[(array_size_t)(l % n)]) < 0) ++l;
+
+    Real width = e.dot(poly[(array_size_t)(r % n)] - poly[(array_size_t)(l % n)]);
+    Real height = normal.dot(poly[(array_size_t)(t % n)] - p);
+    Real area = width * height;
+    if (best_area < 0 || area < best_area)
+    {
+      best_area = area;
+      dir = e;
+    }
+  }
+
+  if (best_area < 0)  // all edges degenerate
+  {
+    dir = Vector2::unitX();
+    return 0;
+  }
+
+  return best_area;
+}
+
+// Generate directions roughly uniformly distributed over a hemisphere, or over a half-circle in the plane perpendicular to an up
+// vector. Each direction gives two extreme points, for its positive and negative senses.
+static void
+generateDirections(int num_dirs, bool has_up, Vector3 const & up, TheaArray<Vector3> & dirs)
+{
+  dirs.clear();
+
+  if (has_up)
+  {
+    Vector3 u, v;
+    up.createOrthonormalBasis(u, v);
+    for (int i = 0; i < num_dirs; ++i)
+    {
+      Real angle = (i * Math::pi()) / num_dirs;
+      dirs.push_back(std::cos(angle) * u + std::sin(angle) * v);
+    }
+  }
+  else
+  {
+    // Fibonacci spiral on the upper hemisphere, plus the coordinate axes
+    dirs.push_back(Vector3::unitX());
+    dirs.push_back(Vector3::unitY());
+    dirs.push_back(Vector3::unitZ());
+
+    static Real const GOLDEN_ANGLE = (Real)(Math::pi() * (3 - std::sqrt(5.0)));
+    for (int i = 0; i < num_dirs; ++i)
+    {
+      Real z = (i + 0.5f) / num_dirs;
+      Real r = std::sqrt(std::max(1 - z * z, (Real)0));
+      Real angle = i * GOLDEN_ANGLE;
+      dirs.push_back(Vector3(r * std::cos(angle), r * std::sin(angle), z));
+    }
+  }
+}
+
+// Compute the area of the minimum-area rectangle enclosing a set of points projected onto the plane perpendicular to an axis,
+// and the extent of the points along the axis. Returns the volume, and the direction of one side of the rectangle.
+static double
+evalAxis(TheaArray<Vector3> const & hull_vertices, Vector3 const & axis, TheaArray<Vector2> & proj, TheaArray<Vector2> & hull2,
+         Vector3 & side_dir)
+{
+  Vector3 u, v;
+  axis.createOrthonormalBasis(u, v);
+
+  proj.resize(hull_vertices.size());
+  Real lo = 0, hi = 0;
+  for (array_size_t i = 0; i < hull_vertices.size(); ++i)
+  {
+    Vector3 const & p = hull_vertices[i];
+    proj[i] = Vector2(p.dot(u), p.dot(v));
+
+    Real h = p.dot(axis);
+    if (i == 0 || h < lo) lo = h;
+    if (i == 0 || h > hi) hi = h;
+  }
+
+  convexHull2(proj, hull2);
+
+  Vector2 dir = Vector2::unitX();
+  Real area = minAreaRectangle(hull2, dir);
+  side_dir = dir.x() * u + dir.y() * v;
+
+  return area * (double)(hi - lo);
+}
+
+// Find the axes of the minimum-volume box enclosing a subset of the points that has one face flush with a face of the convex
+// hull of the subset (or is perpendicular to the up vector).
+static bool
+findBestAxes(TheaArray<Vector3> const & points, TheaArray<long> const & subset, bool has_up, Vector3 const & up,
+             TheaArray<Vector3> & axes)
+{
+  TheaArray<Vector3> hull_vertices;
+  TheaArray<array_size_t> hull_tris;
+  if (has_up)
+  {
+    // Only the projections of the points onto the plane perpendicular to the up vector matter, which are handled by evalAxis()
+    for (array_size_t i = 0; i < subset.size(); ++i)
+      hull_vertices.push_back(points[(array_size_t)subset[i]]);
+  }
+  else
+  {
+    if (subset.size() < 4)
+      return false;
+
+    ConvexHull3 hull(ConvexHull3::Options(ConvexHull3::Options::Approx((long)subset.size(), 0)));
+    for (array_size_t i = 0; i < subset.size(); ++i)
+      hull.addPoint(points[(array_size_t)subset[i]]);
+
+    hull.computeApprox(hull_vertices, hull_tris);
+    if (hull_vertices.size() < 4 || hull_tris.empty())  // degenerate point set
+      return false;
+  }
+
+  // Find the axis and in-plane side direction of the best box
+  TheaArray<Vector2> proj, hull2;
+  Vector3 best_axis, best_side_dir;
+  double best_volume = -1;
+
+  if (has_up)
+  {
+    best_axis = up;
+    best_volume = evalAxis(hull_vertices, up, proj, hull2, best_side_dir);
+  }
+  else
+  {
+    TheaArray<Vector3> tested_axes;
+    for (array_size_t i = 0; i + 2 < hull_tris.size(); i += 3)
+    {
+      Vector3 const & v0 = hull_vertices[hull_tris[i]];
+      Vector3 axis = (hull_vertices[hull_tris[i + 1]] - v0).cross(hull_vertices[hull_tris[i + 2]] - v0);
+      Real len = axis.length();
+      if (len <= 0) continue;
+      axis /= len;
+
+      // Skip (near-)duplicate axes, e.g. from triangles of the same hull facet, or parallel facets
+      bool duplicate = false;
+      for (array_size_t j = 0; j < tested_axes.size(); ++j)
+        if (std::fabs(tested_axes[j].dot(axis)) > 1 - 1.0e-6f)
+        {
+          duplicate = true;
+          break;
+        }
+
+      if (duplicate) continue;
+      tested_axes.push_back(axis);
+
+      Vector3 side_dir;
+      double volume = evalAxis(hull_vertices, axis, proj, hull2, side_dir);
+      if (best_volume < 0 || volume < best_volume)
+      {
+        best_volume = volume;
+        best_axis = axis;
+        best_side_dir = side_dir;
+      }
+    }
+
+    if (best_volume < 0)
+      return false;
+  }
+
+  axes.resize(3);
+  axes[0] = best_side_dir.unit();
+  axes[1] = best_axis.cross(axes[0]).unit();
+  axes[2] = best_axis;
+
+  return true;
+}
+
+static bool
+computeConvexHullOBB(TheaArray<Vector3> const & points, Box3 & result, bool has_up, Vector3 const & up)
+{
+  // Maximum number of times the subset of hull vertices is augmented with the points that determine the extents of the box
+  static int const MAX_REFINEMENTS = 8;
+
+  if (points.size() < 4)
+    return false;
+
+  // Reduce the points to the extreme points along a set of directions, which are all vertices of the convex hull
+  PackedPoints packed(points);
+  TheaArray<Vector3> dirs;
+  generateDirections(NUM_EXTREME_DIRECTIONS, has_up, up, dirs);
+
+  TheaArray<Extremes> extremes;
+  findExtremes(packed, dirs, extremes);
+
+  TheaArray<long> subset;
+  for (array_size_t i = 0; i < extremes.size(); ++i)
+  {
+    subset.push_back(extremes[i].min_index);
+    subset.push_back(extremes[i].max_index);
+  }
+
+  std::sort(subset.begin(), subset.end());
+  subset.erase(std::unique(subset.begin(), subset.end()), subset.end());
+
+  TheaArray<Vector3> axes;
+  for (int iter = 0; ; ++iter)
+  {
+    if (!findBestAxes(points, subset, has_up, up, axes))
+      return false;
+
+    // Compute the extents of all the points in the frame of the box. If they are determined by points not in the subset, the
+    // box found for the subset is not the best one for all the points, so add them to the subset and try again.
+    findExtremes(packed, axes, extremes);
+    if (iter >= MAX_REFINEMENTS)
+      break;
+
+    array_size_t old_size = subset.size();
+    for (array_size_t i = 0; i < extremes.size(); ++i)
+    {
+      if (!std::binary_search(subset.begin(), subset.begin() + old_size, extremes[i].min_index))
+        subset.push_back(extremes[i].min_index);
+
+      if (!std::binary_search(subset.begin(), subset.begin() + old_size, extremes[i].max_index))
+        subset.push_back(extremes[i].max_index);
+    }
+
+    if (subset.size() == old_size)
+      break;
+
+    std::sort(subset.begin(), subset.end());
+    subset.erase(std::unique(subset.begin(), subset.end()), subset.end());
+  }
+
+  Vector3 lo(extremes[0].min_val, extremes[1].min_val, extremes[2].min_val);
+  Vector3 hi(extremes[0].max_val, extremes[1].max_val, extremes[2].max_val);
+  Vector3 c = 0.5f * (lo + hi);
+  Vector3 he = 0.5f * (hi - lo);
+
+  Matrix3 rot = basisMatrix(axes[0], axes[1], axes[2]);
+  result = Box3(AxisAlignedBox3(-he, he), CoordinateFrame3::_fromAffine(AffineTransform3(rot, rot * c)));
+
+  return true;
+}
+
 } // namespace BestFitBox3Internal
 
-BestFitBox3::BestFitBox3()
-: has_up(false), updated(true)
+BestFitBox3::BestFitBox3(Method method_)
+: has_up(false), method(method_), updated(true)
 {}
 
 void
@@ -266,7 +738,9 @@ BestFitBox3::update() const
   if (updated)
     return;
 
-  BestFitBox3Internal::computeBestFitOBB(points, box, has_up, up);
+  if (method != Method::CONVEX_HULL || !BestFitBox3Internal::computeConvexHullOBB(points, box, has_up, up))
+    BestFitBox3Internal::computeBestFitOBB(points, box, has_up, up);
+
   updated = true;
 }
 
@@ -49,14 +49,44 @@
 namespace Thea {
 namespace Algorithms {
 
-/** Approximate best-fit oriented bounding box. */
+/** Approximate best-fit (minimum-volume) oriented bounding box. */
 class THEA_API BestFitBox3
 {
   public:
     THEA_DEF_POINTER_TYPES(BestFitBox3, shared_ptr, weak_ptr)
 
+    /** Method used to search for the best-fit box (enum class). */
+    class THEA_API Method
+    {
+      public:
+        /** Supported values. */
+        enum Value
+        {
+          /**
+           * Try a fixed set of rotations about the normal of the least-squares plane of the points, or about the up vector if
+           * one has been set (string: "brute-force").
+           */
+          BRUTE_FORCE,
+
+          /**
+           * Reduce the points to (a subset of the vertices of) their convex hull, and find the minimum-area rectangle enclosing
+           * the hull, by rotating calipers, in the plane of each hull face, or in the plane perpendicular to the up vector if
+           * one has been set. Much tighter and faster than BRUTE_FORCE for large point sets (string: "convex-hull").
+           */
+          CONVEX_HULL
+        };
+
+        THEA_ENUM_CLASS_BODY(Method)
+
+        THEA_ENUM_CLASS_STRINGS_BEGIN(Method)
+          THEA_ENUM_CLASS_STRING(BRUTE_FORCE, "brute-force")
+          THEA_ENUM_CLASS_STRING(CONVEX_HULL, "convex-hull")
+        THEA_ENUM_CLASS_STRINGS_END(Method)
+
+    }; // class Method
+
     /** Constructor. */
-    BestFitBox3();
+    BestFitBox3(Method method_ = Method::BRUTE_FORCE);
 
     /** Add a point to the set. */
     void addPoint(Vector3 const & point);
@@ -80,6 +110,12 @@ class THEA_API BestFitBox3
     /** Clear the up vector. Subsequent alignments will be unconstrained. */
     void clearUpVector() { has_up = false; }
 
+    /** Set the method used to search for the best-fit box. */
+    void setMethod(Method method_) { method = method_; updated = false; }
+
+    /** Get the method used to search for the best-fit box. */
+    Method getMethod() const { return method; }
+
     /** Remove all cached data to free memory, but do <b>not</b> mark the box for recomputation. */
     void releaseMemoryWithoutUpdate();
 
@@ -93,6 +129,7 @@ class THEA_API BestFitBox3
     TheaArray<Vector3> points;
     bool has_up;
     Vector3 up;
+    Method method;
 
     mutable Box3 box;
     mutable bool updated;
@@ -47,6 +47,7 @@
 #include "../CompressedSparseMatrix.hpp"
 #include "../Math.hpp"
 #include "../Matrix.hpp"
+#include "AgglomerativeClustering.hpp"
 #include "Metrics.hpp"
 
 #ifdef THEA_ENABLE_CLUTO
@@ -76,6 +77,8 @@ class THEA_API Clustering
       enum Value
       {
         AUTO,                   ///< Automatically choose an appropriate method.
+        AGGLOMERATIVE,          ///< Cut of the exact agglomerative hierarchy (HierarchicalMethod::NN_CHAIN).
+        GRAPH_AGGLOMERATIVE,    ///< Cut of the agglomerative hierarchy on a sparse graph (HierarchicalMethod::KNN_GRAPH).
 
 #ifdef THEA_ENABLE_CLUTO
         CLUTO_CLUSTER_DIRECT,   ///< CLUTO direct clustering.
@@ -95,6 +98,18 @@ class THEA_API Clustering
       {
         AUTO,                 ///< Automatically choose an appropriate method.
 
+        /**
+         * Native exact agglomerative clustering with the nearest-neighbor chain algorithm. Uses memory linear in the input size
+         * but time at least quadratic in the number of points.
+         */
+        NN_CHAIN,
+
+        /**
+         * Native agglomerative clustering that only merges clusters joined by an edge of the k-nearest-neighbor graph of the
+         * points (or of the input graph). Scales to hundreds of thousands of points.
+         */
+        KNN_GRAPH,
+
 #ifdef THEA_ENABLE_CLUTO
         CLUTO_CLUSTER,        ///< CLUTO agglomerative clustering.
         CLUTO_CLUSTER_BIASED  ///< CLUTO biased agglomerative clustering.
@@ -120,6 +135,24 @@ class THEA_API Clustering
       THEA_ENUM_CLASS_BODY(HierarchyOverlayMethod)
     };
 
+    /** Distance between two clusters, for native agglomerative clustering (enum class). */
+    struct THEA_API Linkage
+    {
+      /** Supported values. */
+      enum Value
+      {
+        AUTO,     ///< Automatically choose an appropriate linkage (Ward for points, average for graphs).
+        WARD,     ///< Ward's minimum-variance criterion (requires points).
+        AVERAGE,  ///< Average distance between members.
+        COMPLETE  ///< Maximum distance between members.
+      };
+
+      THEA_ENUM_CLASS_BODY(Linkage)
+    };
+
+    /** A merge step of a hierarchical clustering (see AgglomerativeClustering). */
+    typedef AgglomerativeClustering::Merge Merge;
+
     /** Metric for measuring similarity between two points. */
     struct THEA_API SimilarityMeasure
     {
@@ -227,6 +260,7 @@ class THEA_API Clustering
       long                 num_nearest_neighbors;
       ClusteringCriterion  clustering_criterion;
       SplitPriority        split_priority;
+      Linkage              linkage;
 
       /** Constructor. */
       FlatOptions(FlatMethod method_ = FlatMethod::AUTO,
@@ -234,19 +268,44 @@ class THEA_API Clustering
                   GraphModel graph_model_ = GraphModel::AUTO,
                   long num_nearest_neighbors_ = -1,
                   ClusteringCriterion clustering_criterion_ = ClusteringCriterion::AUTO,
-                  SplitPriority split_priority_ = SplitPriority::AUTO)
+                  SplitPriority split_priority_ = SplitPriority::AUTO,
+                  Linkage linkage_ = Linkage::AUTO)
       : method(method_),
         similarity_measure(similarity_measure_),
         graph_model(graph_model_),
         num_nearest_neighbors(num_nearest_neighbors_),
         clustering_criterion(clustering_criterion_),
-        split_priority(split_priority_)
+        split_priority(split_priority_),
+        linkage(linkage_)
       {}
 
       /** Default options. */
       static FlatOptions const & defaults() { static FlatOptions const options; return options; }
     };
 
+    /** %Options for hierarchical clustering. */
+    struct THEA_API HierarchicalOptions
+    {
+      HierarchicalMethod  method;
+      Linkage             linkage;
+      long                num_nearest_neighbors;
+
+      /** Constructor. */
+      HierarchicalOptions(HierarchicalMethod method_ = HierarchicalMethod::AUTO, Linkage linkage_ = Linkage::AUTO,
+                          long num_nearest_neighbors_ = -1)
+      : method(method_), linkage(linkage_), num_nearest_neighbors(num_nearest_neighbors_)
+      {}
+
+      /** Default options. */
+      static HierarchicalOptions const & defaults() { static HierarchicalOptions const options; return options; }
+    };
+
+    /**
+     * Largest number of points for which HierarchicalMethod::AUTO and FlatMethod::AUTO select exact (nearest-neighbor chain)
+     * agglomerative clustering. Larger inputs are clustered on their k-nearest-neighbor graph.
+     */
+    static long const MAX_AUTO_EXACT_POINTS = 20000;
+
     /**
      * Compute a flat clustering for a set of points. The class <code>T</code> should be a basic numeric type
      * (int/float/double...), Vector2, Vector3, Vector4 or VectorN.
@@ -268,13 +327,27 @@ class THEA_API Clustering
 
       int num_clusters_found = 0;
 
-#ifdef THEA_ENABLE_CLUTO
       if (options.method == FlatMethod::AUTO)
+      {
+#ifdef THEA_ENABLE_CLUTO
         options.method = FlatMethod::CLUTO_GRAPH_CLUSTER_RB;
+#else
+        options.method = ((long)points.size() <= MAX_AUTO_EXACT_POINTS ? FlatMethod::AGGLOMERATIVE
+                                                                        : FlatMethod::GRAPH_AGGLOMERATIVE);
 #endif
+      }
 
       switch (options.method)
       {
+        case FlatMethod::AGGLOMERATIVE:
+        case FlatMethod::GRAPH_AGGLOMERATIVE:
+        {
+          AgglomerativeClustering ac(toAgglomerativeOptions(options.linkage, true, options.num_nearest_neighbors));
+          agglomerate(points, options.method == FlatMethod::GRAPH_AGGLOMERATIVE, ac);
+          num_clusters_found = (int)ac.cut(num_clusters_hint, labels);
+          break;
+        }
+
 #ifdef THEA_ENABLE_CLUTO
         case FlatMethod::CLUTO_CLUSTER_DIRECT:
         case FlatMethod::CLUTO_CLUSTER_RB:
@@ -378,7 +451,9 @@ class THEA_API Clustering
 
     /**
      * Compute a vertex clustering for a user-specified graph. The class <code>MatrixT</code> should be convertible to
-     * CompressedRowMatrix<float, int, int>.
+     * CompressedRowMatrix<float, int, int>. For FlatMethod::GRAPH_AGGLOMERATIVE (the default if CLUTO is not available), the
+     * weights are treated as similarities, and clusters joined by edges with high average (or, for complete linkage, minimum)
+     * similarity are merged first. Ward linkage is not supported for graphs.
      *
      * @param weights Input adjacency matrix.
      * @param labels %Clustering results, each entry is the label of the cluster containing the point.
@@ -394,13 +469,42 @@ class THEA_API Clustering
     {
       int num_clusters_found = 0;
 
-#ifdef THEA_ENABLE_CLUTO
       if (options.method == FlatMethod::AUTO)
+      {
+#ifdef THEA_ENABLE_CLUTO
         options.method = FlatMethod::CLUTO_GRAPH_CLUSTER_RB;
+#else
+        options.method = FlatMethod::GRAPH_AGGLOMERATIVE;
 #endif
+      }
 
       switch (options.method)
       {
+        case FlatMethod::GRAPH_AGGLOMERATIVE:
+        {
+          alwaysAssertM(weights.numRows() == weights.numColumns(), "Clustering: Adjacency matrix must be square");
+
+          // Negate the similarities so that the most similar clusters are the closest
+          TheaArray<AgglomerativeClustering::Edge> edges;
+          CompressedRowMatrix<double, long, long> csr(weights);
+          if (!csr.getRowIndices().empty())
+          {
+            for (long r = 0; r < csr.numRows(); ++r)
+              for (long k = csr.getRowIndices()[(array_size_t)r]; k < csr.getRowIndices()[(array_size_t)r + 1]; ++k)
+              {
+                long c = csr.getColumnIndices()[(array_size_t)k];
+                double w = csr.getValues()[(array_size_t)k];
+                if (c != r && w != 0)
+                  edges.push_back(AgglomerativeClustering::Edge(r, c, -w));
+              }
+          }
+
+          AgglomerativeClustering ac(toAgglomerativeOptions(options.linkage, false, options.num_nearest_neighbors));
+          ac.clusterGraph(weights.numRows(), edges);
+          num_clusters_found = (int)ac.cut(num_clusters_hint, labels);
+          break;
+        }
+
 #ifdef THEA_ENABLE_CLUTO
         case FlatMethod::CLUTO_CLUSTER_DIRECT:
         case FlatMethod::CLUTO_CLUSTER_RB:
@@ -497,6 +601,43 @@ class THEA_API Clustering
       return num_clusters_found;
     }
 
+    /**
+     * Compute a hierarchical clustering for a set of points, with a native agglomerative method. The class <code>T</code>
+     * should be a basic numeric type (int/float/double...), Vector2, Vector3, Vector4, VectorN or TheaArray (all points must
+     * have the same dimensions).
+     *
+     * @param points Input points.
+     * @param merges Used to return the merge steps, with the convention of AgglomerativeClustering.
+     * @param options Options for the clustering algorithm.
+     *
+     * @return The number of merges, which is one less than the number of points unless a graph-based method was used and the
+     *   graph was not connected.
+     */
+    template <typename T>
+    static long computeHierarchical(TheaArray<T> const & points, TheaArray<Merge> & merges,
+                                    HierarchicalOptions options = HierarchicalOptions::defaults())
+    {
+      if (options.method == HierarchicalMethod::AUTO)
+        options.method = ((long)points.size() <= MAX_AUTO_EXACT_POINTS ? HierarchicalMethod::NN_CHAIN
+                                                                        : HierarchicalMethod::KNN_GRAPH);
+
+      switch (options.method)
+      {
+        case HierarchicalMethod::NN_CHAIN:
+        case HierarchicalMethod::KNN_GRAPH:
+        {
+          AgglomerativeClustering ac(toAgglomerativeOptions(options.linkage, true, options.num_nearest_neighbors));
+          agglomerate(points, options.method == HierarchicalMethod::KNN_GRAPH, ac);
+          merges = ac.getMerges();
+          break;
+        }
+
+        default: throw Error("Clustering: Clustering method is not supported");
+      }
+
+      return (long)merges.size();
+    }
+
     /**
      * Compute a hierarchical clustering that respects a given flat clustering. This is currently restricted to producing
      * binary trees.
@@ -527,17 +668,31 @@ class THEA_API Clustering
     }
 
   private:
-
-#ifdef THEA_ENABLE_CLUTO
     /** Get the number of dimensions of a vector. The dummy argument is needed for template resolution. */
     template <typename T>            static array_size_t numElems (T const & t);
     template <long N, typename T>  static array_size_t numElems (VectorN<N, T> const & v);
     template <typename T>            static array_size_t numElems (TheaArray<T> const & v);
 
-    /** Copy a vector to a float array and return a pointer to the next array position. */
-    template <typename T>            static float * copyToFloatArray(T const & t, float * fp);
-    template <long N, typename T>  static float * copyToFloatArray(VectorN<N, T> const & v, float * fp);
-    template <typename T>            static float * copyToFloatArray(TheaArray<T> const & v, float * fp);
+    /** Copy a vector to an array and return a pointer to the next array position. */
+    template <typename T, typename U>            static U * copyToArray(T const & t, U * fp);
+    template <long N, typename T, typename U>  static U * copyToArray(VectorN<N, T> const & v, U * fp);
+    template <typename T, typename U>            static U * copyToArray(TheaArray<T> const & v, U * fp);
+
+    /** Copy an array of points (all of the same dimensions) to a dense row-major array, and return the number of dimensions. */
+    template <typename T> static long toDenseArray(TheaArray<T> const & points, TheaArray<double> & coords);
+
+    /** Build an agglomerative hierarchy on a set of points, either exactly or on their k-nearest-neighbor graph. */
+    template <typename T> static void agglomerate(TheaArray<T> const & points, bool knn_graph, AgglomerativeClustering & ac);
+
+    /** Build an agglomerative hierarchy on a set of fixed-dimensional points, using a kd-tree for the k-NN graph. */
+    template <long N, typename T>
+    static void agglomerate(TheaArray< VectorN<N, T> > const & points, bool knn_graph, AgglomerativeClustering & ac);
+
+    /** Convert standard options to options for native agglomerative clustering. */
+    static AgglomerativeClustering::Options toAgglomerativeOptions(Linkage linkage, bool have_points,
+                                                                   long num_nearest_neighbors);
+
+#ifdef THEA_ENABLE_CLUTO
 
     /** Convert an array of points to a CLUTO matrix. */
     template <typename T> static void toClutoMatrix(TheaArray<T> const & points, ClutoMatrix & cm);
@@ -575,52 +730,120 @@ class THEA_API Clustering
 
 }; // class Clustering
 
-#ifdef THEA_ENABLE_CLUTO
-
 //=============================================================================================================================
 // Get the number of dimensions of a vector. The dummy argument is needed for template resolution.
 //=============================================================================================================================
 
 template <typename T>            array_size_t Clustering::numElems         (T const & t)             { return 1; }
-template <> inline               array_size_t Clustering::numElems<Vector2>(Vector2 const & t)       { return 2; }
-template <> inline               array_size_t Clustering::numElems<Vector3>(Vector3 const & t)       { return 3; }
-template <> inline               array_size_t Clustering::numElems<Vector4>(Vector4 const & t)       { return 4; }
 template <long N, typename T>    array_size_t Clustering::numElems         (VectorN<N, T> const & v) { return (array_size_t)N; }
 template <typename T>            array_size_t Clustering::numElems         (TheaArray<T> const & v)  { return v.size(); }
 
 //=============================================================================================================================
-// Copy a vector to a float array and return a pointer to the next array position.
+// Copy a vector to an array and return a pointer to the next array position.
 //=============================================================================================================================
 
-template <typename T> float * Clustering::copyToFloatArray(T const & t, float * fp)
-{ *fp = static_cast<float>(t); return fp + 1; }  // plain numbers
-template <> inline float * Clustering::copyToFloatArray<Vector2>(Vector2 const & t, float * fp)
-{ fp[0] = t[0]; fp[1] = t[1]; return fp + 2; }
-template <> inline float * Clustering::copyToFloatArray<Vector3>(Vector3 const & t, float * fp)
-{ fp[0] = t[0]; fp[1] = t[1]; fp[2] = t[2]; return fp + 3; }
-template <> inline float * Clustering::copyToFloatArray<Vector4>(Vector4 const & t, float * fp)
-{ fp[0] = t[0]; fp[1] = t[1]; fp[2] = t[2]; fp[3] = t[3]; return fp + 4; }
+template <typename T, typename U> U * Clustering::copyToArray(T const & t, U * fp)
+{ *fp = static_cast<U>(t); return fp + 1; }  // plain numbers
 
-template <long N, typename T>
-float *
-Clustering::copyToFloatArray(VectorN<N, T> const & v, float * fp)
+template <long N, typename T, typename U>
+U *
+Clustering::copyToArray(VectorN<N, T> const & v, U * fp)
 {
   for (size_t i = 0; i < N; ++i)
-    fp[i] = static_cast<float>(v[i]);
+    fp[i] = static_cast<U>(v[i]);
 
   return fp + N;
 }
 
-template <typename T>
-float *
-Clustering::copyToFloatArray(TheaArray<T> const & v, float * fp)
+template <typename T, typename U>
+U *
+Clustering::copyToArray(TheaArray<T> const & v, U * fp)
 {
   for (typename TheaArray<T>::const_iterator vi = v.begin(); vi != v.end(); ++vi, ++fp)
-    *fp = static_cast<float>(*vi);
+    *fp = static_cast<U>(*vi);
 
   return fp;
 }
 
+//=============================================================================================================================
+// Native agglomerative clustering
+//=============================================================================================================================
+
+template <typename T>
+long
+Clustering::toDenseArray(TheaArray<T> const & points, TheaArray<double> & coords)
+{
+  if (points.empty())
+  {
+    coords.clear();
+    return 0;
+  }
+
+  array_size_t num_elems = numElems(points[0]);
+  coords.resize(num_elems * points.size());
+
+  double * fp = &coords[0];
+  for (array_size_t i = 0; i < points.size(); ++i)
+  {
+    if (numElems(points[i]) != num_elems)
+      throw Error("Clustering: Points do not have same dimensions");
+
+    fp = copyToArray(points[i], fp);
+  }
+
+  return (long)num_elems;
+}
+
+template <typename T>
+void
+Clustering::agglomerate(TheaArray<T> const & points, bool knn_graph, AgglomerativeClustering & ac)
+{
+  TheaArray<double> coords;
+  long num_dims = toDenseArray(points, coords);
+  double const * cp = (coords.empty() ? NULL : &coords[0]);
+
+  if (knn_graph)
+    ac.clusterKNNGraph((long)points.size(), num_dims, cp);
+  else
+    ac.clusterVectors((long)points.size(), num_dims, cp);
+}
+
+template <long N, typename T>
+void
+Clustering::agglomerate(TheaArray< VectorN<N, T> > const & points, bool knn_graph, AgglomerativeClustering & ac)
+{
+  if (knn_graph)
+    ac.clusterKNNGraph(points);
+  else
+  {
+    TheaArray<double> coords;
+    toDenseArray(points, coords);
+    ac.clusterVectors((long)points.size(), N, coords.empty() ? NULL : &coords[0]);
+  }
+}
+
+inline AgglomerativeClustering::Options
+Clustering::toAgglomerativeOptions(Linkage linkage, bool have_points, long num_nearest_neighbors)
+{
+  AgglomerativeClustering::Linkage ac_linkage;
+  switch (linkage)
+  {
+    case Linkage::AUTO     :  ac_linkage = (have_points ? AgglomerativeClustering::Linkage::WARD
+                                                        : AgglomerativeClustering::Linkage::AVERAGE); break;
+    case Linkage::WARD     :  ac_linkage = AgglomerativeClustering::Linkage::WARD; break;
+    case Linkage::AVERAGE  :  ac_linkage = AgglomerativeClustering::Linkage::AVERAGE; break;
+    case Linkage::COMPLETE :  ac_linkage = AgglomerativeClustering::Linkage::COMPLETE; break;
+    default                :  throw Error("Clustering: Invalid linkage");
+  }
+
+  if (!have_points && ac_linkage == AgglomerativeClustering::Linkage::WARD)
+    throw Error("Clustering: Ward linkage requires points");
+
+  return AgglomerativeClustering::Options().setLinkage(ac_linkage).setNumNeighbors(num_nearest_neighbors);
+}
+
+#ifdef THEA_ENABLE_CLUTO
+
 //=============================================================================================================================
 // Store an array of points in a compressed row matrix.
 //=============================================================================================================================
@@ -638,7 +861,7 @@ Clustering::toClutoMatrix(TheaArray<T> const & points, ClutoMatrix & cm)
 
   float * fp = &cm.getValues()[0];
   for (array_size_t i = 0; i < num_points; ++i)
-    fp = copyToFloatArray(points[i], fp);
+    fp = copyToArray(points[i], fp);
 }
 
 template <typename T>
@@ -658,7 +881,7 @@ Clustering::toClutoMatrix(TheaArray< TheaArray<T> > const & points, ClutoMatrix
     if (points[i].size() != num_elems)
       throw Error("Clustering: Points do not have same dimensions");
 
-    fp = copyToFloatArray(points[i], fp);
+    fp = copyToArray(points[i], fp);
   }
 }
 
@@ -137,6 +137,18 @@ class THEA_API ConvexHull3
       builder.end();
     }
 
+    /**
+     * Compute the approximate convex hull of the data, as a set of vertices and a list of triangles, each specified by three
+     * consecutive indices into the vertex array. Any prior data in the arrays is discarded.
+     */
+    void computeApprox(TheaArray<Vector3> & vertices, TheaArray<array_size_t> & tri_indices) const
+    {
+      updateApprox();
+
+      vertices = approx_vertices;
+      tri_indices = approx_indices;
+    }
+
     /** Compute the exact convex hull of the data. */
     template <typename Mesh> void computeExact(Mesh & mesh) const
     { throw Error("ConvexHull3: Exact convex hulls not implemented"); }
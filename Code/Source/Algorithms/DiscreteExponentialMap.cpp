@@ -45,13 +45,154 @@
 #include "../AffineTransform3.hpp"
 #include "../Map.hpp"
 #include "../Math.hpp"
+#include "../ParallelFor.hpp"
 #include "../Plane3.hpp"
+#include <algorithm>
+#include <functional>
 
 namespace Thea {
 namespace Algorithms {
 
 namespace DiscreteExponentialMapInternal {
 
+typedef SampleGraph::SurfaceSample SurfaceSample;
+
+// Parametrization data for a sample
+struct ParamData
+{
+  ParamData const * pred_data;
+  Vector2 uv;
+  AffineTransform3 uv_transform;
+  Vector3 proj_p;
+};
+
+// The tangent plane at the origin of a parametrization, with a basis
+struct TangentFrame
+{
+  TangentFrame() {}
+
+  TangentFrame(Vector3 const & origin_, Vector3 const & u_axis_, Vector3 const & v_axis_)
+  : origin(origin_), u_axis(u_axis_.unit()), v_axis(v_axis_.unit())  // renormalize to be safe
+  {
+    plane = Plane3::fromPointAndNormal(origin, u_axis.cross(v_axis));
+  }
+
+  Plane3 plane;
+  Vector3 origin;
+  Vector3 u_axis, v_axis;
+};
+
+Real
+kernelFastGaussianSqDistUnscaled(Real squared_dist, Real squared_bandwidth)
+{
+  return Math::fastMinusExp((float)(squared_dist / squared_bandwidth));
+}
+
+// Parametrize the point as an increment from its predecessor. Sets curr.proj_p and curr.uv_transform.
+void
+unwind(Plane3 const & tangent_plane, Vector3 pos_in_pred_frame, ParamData const * pred, ParamData & curr)
+{
+  if (pred)
+  {
+    ParamData const * pred_pred = pred->pred_data;
+    if (pred_pred)
+    {
+      Vector3 edge = pos_in_pred_frame - pred->proj_p;
+      Vector3 prev_edge = pred->proj_p - pred_pred->proj_p;
+
+      Vector3 right = prev_edge.cross(tangent_plane.getNormal()).fastUnit();
+      Vector3 v = edge - (edge.dot(right) * right);
+      if (v.squaredLength() > 1.0e-10f)  // TODO: Is this a generally applicable epsilon?
+      {
+        AffineTransform3 pred_inc = AffineTransform3::translation(pred->proj_p)
+                                  * AffineTransform3::rotationArc(v.fastUnit(), prev_edge.fastUnit(), false)
+                                  * AffineTransform3::translation(-pred->proj_p);
+        curr.proj_p = pred_inc * pos_in_pred_frame;
+        curr.uv_transform = pred_inc * pred->uv_transform;
+      }
+      else
+      {
+        curr.proj_p = tangent_plane.closestPoint(pos_in_pred_frame);
+        curr.uv_transform = AffineTransform3::translation(curr.proj_p - pos_in_pred_frame) * pred->uv_transform;
+      }
+    }
+    else  // the predecessor is the source
+    {
+      Vector3 edge = pos_in_pred_frame - pred->proj_p;
+      Vector3 tp = tangent_plane.closestPoint(pos_in_pred_frame);
+      Vector3 v = tp - pred->proj_p;
+      if (v.squaredLength() > 1.0e-10f)  // TODO: Is this a generally applicable epsilon?
+      {
+        AffineTransform3 pred_inc = AffineTransform3::translation(pred->proj_p)
+                                  * AffineTransform3::rotationArc(edge.fastUnit(), v.fastUnit(), false)
+                                  * AffineTransform3::translation(-pred->proj_p);
+        curr.proj_p = pred_inc * pos_in_pred_frame;
+        curr.uv_transform = pred_inc * pred->uv_transform;
+      }
+      else  // hope this never happens, because we're going to squash the edge to zero length
+      {
+        curr.proj_p = tp;
+        curr.uv_transform = AffineTransform3::translation(curr.proj_p - pos_in_pred_frame) * pred->uv_transform;
+      }
+    }
+  }
+  else  // this is the source
+  {
+    // Map to origin
+    Vector3 tp = tangent_plane.closestPoint(pos_in_pred_frame);  // just in case, but it should be on the plane anyway
+    curr.proj_p = tp;
+    curr.uv_transform = AffineTransform3::translation(tp - pos_in_pred_frame);
+  }
+}
+
+// Compute the parametrization data of a sample from that of its predecessor (null for the source). If blend_bandwidth_squared
+// is positive, the predecessor's parameters are blended with those of its neighbors that have already been parametrized, which
+// are looked up with find(sample) (returns null if the sample has not been parametrized).
+template <typename ParamDataFinderT>
+void
+computeParamData(SurfaceSample const * vertex, SurfaceSample const * pred, ParamData const * pred_data,
+                 ParamDataFinderT const & find, TangentFrame const & frame, Real blend_bandwidth_squared, ParamData & curr_data)
+{
+  if (pred_data)
+  {
+    Vector3 p = vertex->getPosition();
+    Vector3 sum_p = pred_data->uv_transform * p;
+    Real sum_weights = 1;
+
+    if (blend_bandwidth_squared > 0)
+    {
+      // Blend in the positions of nearby upwind points (the predecessor's visited neighbors) to make the estimate a bit
+      // more robust
+      SurfaceSample::NeighborSet const & pred_nbrs = pred->getNeighbors();
+      for (int i = 0; i < pred_nbrs.size(); ++i)
+      {
+        SurfaceSample::Neighbor const & pred_nbr = pred_nbrs[i];
+        ParamData const * pred_nbr_data = find(pred_nbr.getSample());
+        if (pred_nbr_data)  // already assigned parameters
+        {
+          Vector3 offset = pred_nbr.getSample()->getPosition() - p;
+          Real weight = kernelFastGaussianSqDistUnscaled(offset.squaredLength(), blend_bandwidth_squared);
+
+          sum_p += weight * (pred_nbr_data->uv_transform * p);
+          sum_weights += weight;
+        }
+      }
+    }
+
+    // Now do the DEM unwinding based on the averaged position
+    unwind(frame.plane, sum_p / sum_weights, pred_data, curr_data);
+    curr_data.pred_data = pred_data;
+  }
+  else
+  {
+    unwind(frame.plane, vertex->getPosition(), NULL, curr_data);
+    curr_data.pred_data = NULL;
+  }
+
+  Vector3 offset = curr_data.proj_p - frame.origin;
+  curr_data.uv = Vector2(offset.dot(frame.u_axis), offset.dot(frame.v_axis));
+}
+
 class Impl
 {
   public:
@@ -59,31 +200,35 @@ class Impl
     typedef DiscreteExponentialMap::ParameterMap ParameterMap;
 
   private:
-    struct ParamData
-    {
-      ParamData const * pred_data;
-      Vector2 uv;
-      AffineTransform3 uv_transform;
-      Vector3 proj_p;
-    };
-
-    typedef SampleGraph::SurfaceSample SurfaceSample;
     typedef ShortestPaths<SampleGraph> Geodesics;
     typedef TheaMap<Geodesics::VertexHandle, ParamData> ParamDataMap;  // FIXME: Can we use UnorderedMap?
 
+    // Looks up the parametrization data of a sample, if any
+    struct ParamDataFinder
+    {
+      ParamDataFinder(ParamDataMap const & param_data_) : param_data(param_data_) {}
+
+      ParamData const * operator()(SurfaceSample * sample) const
+      {
+        ParamDataMap::const_iterator existing = param_data.find(sample);
+        return existing != param_data.end() ? &existing->second : NULL;
+      }
+
+      ParamDataMap const & param_data;
+    };
+
   public:
     Impl(Options const & options_) : options(options_), radius(0) {}
 
+    Options const & getOptions() const { return options; }
+
     void parametrize(SampleGraph const & sample_graph, long origin_index_, Vector3 const & u_axis_, Vector3 const & v_axis_,
                      Real radius_)
     {
       clear();
 
       SurfaceSample * origin_sample = const_cast<SurfaceSample *>(&sample_graph.getSamples()[(array_size_t)origin_index_]);
-      origin = origin_sample->getPosition();
-      u_axis = u_axis_.unit();  // renormalize to be safe
-      v_axis = v_axis_.unit();
-      tangent_plane = Plane3::fromPointAndNormal(origin, u_axis.cross(v_axis));
+      frame = TangentFrame(origin_sample->getPosition(), u_axis_, v_axis_);
       radius = radius_;
       blend_bandwidth_squared = (options.getBlendUpwind() ? Math::square(3 * sample_graph.getAverageSeparation()) : 0);
 
@@ -112,7 +257,8 @@ class Impl
 
     CoordinateFrame3 getTangentFrame() const
     {
-      return CoordinateFrame3::_fromAffine(AffineTransform3(u_axis, v_axis, u_axis.cross(v_axis), origin));
+      return CoordinateFrame3::_fromAffine(AffineTransform3(frame.u_axis, frame.v_axis, frame.u_axis.cross(frame.v_axis),
+                                                            frame.origin));
     }
 
     Real getRadius() const
@@ -129,141 +275,280 @@ class Impl
     // This class also acts as the callback during Dijkstra search. VertexHandle is a pointer to a sample.
     bool operator()(Geodesics::VertexHandle vertex, double distance, bool has_pred, Geodesics::VertexHandle pred)
     {
-      ParamData curr_data;
-
+      ParamData const * pred_data = NULL;
       if (has_pred)
       {
         ParamDataMap::const_iterator existing_pred = param_data.find(pred);
         alwaysAssertM(existing_pred != param_data.end(), "SampleGraph: No parametrization data associated with predecessor");
-        ParamData const & pred_data = existing_pred->second;
+        pred_data = &existing_pred->second;  // hopefully the map class guarantees this will be preserved
+      }
 
-        Vector3 p = vertex->getPosition();
-        Vector3 sum_p = pred_data.uv_transform * p;
-        Real sum_weights = 1;
+      ParamData curr_data;
+      computeParamData(vertex, pred, pred_data, ParamDataFinder(param_data), frame, blend_bandwidth_squared, curr_data);
 
-        if (options.getBlendUpwind())
-        {
-          // Blend in the positions of nearby upwind points (the predecessor's visited neighbors) to make the estimate a bit
-          // more robust
-          SurfaceSample::NeighborSet const & pred_nbrs = pred->getNeighbors();
-          for (int i = 0; i < pred_nbrs.size(); ++i)
-          {
-            SurfaceSample::Neighbor const & pred_nbr = pred_nbrs[i];
-            ParamDataMap::const_iterator existing_nbr = param_data.find(pred_nbr.getSample());
-            if (existing_nbr != param_data.end())  // already assigned parameters
-            {
-              ParamData const & pred_nbr_data = existing_nbr->second;
+      params[vertex->getIndex()] = (options.getNormalize() ? curr_data.uv / radius : curr_data.uv);
+      param_data[vertex] = curr_data;
 
-              Vector3 offset = pred_nbr.getSample()->getPosition() - p;
-              Real weight = kernelFastGaussianSqDistUnscaled(offset.squaredLength(), blend_bandwidth_squared);
+      return false;
+    }
 
-              sum_p += weight * (pred_nbr_data.uv_transform * p);
-              sum_weights += weight;
-            }
-          }
-        }
+  private:
+    Options options;
+    ParameterMap params;
+    ParamDataMap param_data;
+    Geodesics geodesics;
+    TangentFrame frame;
+    Real radius;
+    Real blend_bandwidth_squared;
+
+}; // class Impl
+
+// Parametrizes patches around a sequence of origins and resamples them onto grids. Each worker has its own scratch space,
+// indexed by sample and reused across origins. Only the entries touched by a patch are reset after it is processed, so the
+// cost of a patch depends only on its size, not that of the whole graph.
+class BatchWorker
+{
+  private:
+    enum VisitStatus { WHITE, GREY, BLACK };
 
-        // Now do the DEM unwinding based on the averaged position
-        unwind(tangent_plane, sum_p / sum_weights, &pred_data, curr_data);
-        Vector3 offset = curr_data.proj_p - origin;
-        curr_data.uv = Vector2(offset.dot(u_axis), offset.dot(v_axis));
-        curr_data.pred_data = &pred_data;  // hopefully the map class guarantees this will be preserved
+    typedef std::pair<double, long> HeapEntry;  // min-heap ordered by std::greater
 
-        params[vertex->getIndex()] = (options.getNormalize() ? curr_data.uv / radius : curr_data.uv);
+    // Looks up the parametrization data of a sample, if any
+    struct ParamDataFinder
+    {
+      ParamDataFinder(BatchWorker const * worker_) : worker(worker_) {}
 
-        // THEA_CONSOLE << "Assigned params " << curr_data.uv;
+      ParamData const * operator()(SurfaceSample const * sample) const
+      {
+        array_size_t index = (array_size_t)sample->getIndex();
+        return worker->status[index] == BLACK ? &worker->param_data[index] : NULL;
       }
-      else
+
+      BatchWorker const * worker;
+    };
+
+    friend struct ParamDataFinder;
+
+  public:
+    // Compact adjacency structure of a sample graph, shared by all workers, to avoid chasing pointers to samples and their
+    // neighbor sets in the inner loop of Dijkstra's algorithm. The neighbors of sample i are entries nbr_offsets[i] to
+    // nbr_offsets[i + 1] - 1 of nbr_indices and nbr_separations.
+    struct Adjacencies
+    {
+      Adjacencies(SampleGraph const & sample_graph)
       {
-        unwind(tangent_plane, vertex->getPosition(), NULL, curr_data);
-        Vector3 offset = curr_data.proj_p - origin;
-        curr_data.uv = Vector2(offset.dot(u_axis), offset.dot(v_axis));
-        curr_data.pred_data = NULL;
+        SampleGraph::SampleArray const & samples = sample_graph.getSamples();
 
-        params[vertex->getIndex()] = (options.getNormalize() ? curr_data.uv / radius : curr_data.uv);
+        nbr_offsets.resize(samples.size() + 1);
+        nbr_offsets[0] = 0;
+        for (array_size_t i = 0; i < samples.size(); ++i)
+        {
+          SurfaceSample::NeighborSet const & nbrs = samples[i].getNeighbors();
+          for (int j = 0; j < nbrs.size(); ++j)
+          {
+            nbr_indices.push_back(nbrs[j].getSample()->getIndex());
+            nbr_separations.push_back(nbrs[j].getSeparation());
+          }
 
-        // THEA_CONSOLE << "Assigned params " << curr_data.uv << " (no pred)";
+          nbr_offsets[i + 1] = (long)nbr_indices.size();
+        }
       }
 
-      param_data[vertex] = curr_data;
+      TheaArray<long> nbr_offsets;
+      TheaArray<long> nbr_indices;
+      TheaArray<double> nbr_separations;
+    };
 
-      return false;
+    BatchWorker(DiscreteExponentialMap::Options const & options_, SampleGraph const & sample_graph_,
+                Adjacencies const & adjacencies_, long const * origin_indices_, Vector3 const * u_axes_,
+                Vector3 const * v_axes_, Real radius_, long num_channels_, Real const * sample_values_, long grid_size_,
+                Real * patches_, Real * coverage_)
+    : options(options_), sample_graph(&sample_graph_), adjacencies(&adjacencies_), origin_indices(origin_indices_),
+      u_axes(u_axes_), v_axes(v_axes_), radius(radius_), num_channels(num_channels_), sample_values(sample_values_),
+      grid_size(grid_size_), patches(patches_), coverage(coverage_)
+    {}
+
+    // Parametrize and resample the patches of origins begin to end - 1
+    void operator()(long begin, long end)
+    {
+      // Allocate the scratch space here, in the thread that uses it, the first time the thread's copy of the worker is run
+      array_size_t num_samples = (array_size_t)sample_graph->numSamples();
+      if (status.size() != num_samples)
+      {
+        status.resize(num_samples, WHITE);
+        dist.resize(num_samples);
+        pred.resize(num_samples, NULL);
+        param_data.resize(num_samples);
+        weights.resize((array_size_t)(grid_size * grid_size));
+        touched.clear();
+
+        blend_bandwidth_squared = (options.getBlendUpwind() ? Math::square(3 * sample_graph->getAverageSeparation()) : 0);
+      }
+
+      for (long i = begin; i < end; ++i)
+      {
+        parametrize(i);
+        resample(i);
+
+        for (array_size_t j = 0; j < touched.size(); ++j)
+        {
+          array_size_t index = (array_size_t)touched[j];
+          status[index] = WHITE;
+          pred[index] = NULL;
+        }
+
+        touched.clear();
+      }
     }
 
   private:
-    Real kernelFastGaussianSqDistUnscaled(Real squared_dist, Real squared_bandwidth)
+    // Run Dijkstra's algorithm from an origin, up to the patch radius, parametrizing each sample as its distance is finalized
+    void parametrize(long origin)
     {
-      return Math::fastMinusExp((float)(squared_dist / squared_bandwidth));
+      SampleGraph::SampleArray const & samples = sample_graph->getSamples();
+      SurfaceSample const & origin_sample = samples[(array_size_t)origin_indices[origin]];
+      TangentFrame frame(origin_sample.getPosition(), u_axes[origin], v_axes[origin]);
+      ParamDataFinder find(this);
+
+      heap.clear();
+      visit(origin_sample.getIndex(), 0, NULL);
+
+      while (!heap.empty())
+      {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+        HeapEntry top = heap.back();
+        heap.pop_back();
+
+        array_size_t index = (array_size_t)top.second;
+        if (status[index] == BLACK || top.first > dist[index])  // stale entry
+          continue;
+
+        if (top.first > radius)  // all remaining distances will be greater than this
+          break;
+
+        SurfaceSample const * sample = &samples[index];
+        SurfaceSample const * sample_pred = pred[index];
+        computeParamData(sample, sample_pred, (sample_pred ? &param_data[(array_size_t)sample_pred->getIndex()] : NULL),
+                         find, frame, blend_bandwidth_squared, param_data[index]);
+        status[index] = BLACK;
+
+        for (long j = adjacencies->nbr_offsets[index], end = adjacencies->nbr_offsets[index + 1]; j < end; ++j)
+        {
+          long nbr = adjacencies->nbr_indices[(array_size_t)j];
+          if (status[(array_size_t)nbr] != BLACK)
+            visit(nbr, top.first + adjacencies->nbr_separations[(array_size_t)j], sample);
+        }
+      }
     }
 
-    // Parametrize the point as an increment from its predecessor. Sets curr.proj_p and curr.uv_transform.
-    void
-    unwind(Plane3 const & tangent_plane, Vector3 pos_in_pred_frame, ParamData const * pred, ParamData & curr)
+    // Relax the distance to a sample
+    void visit(long index, double d, SurfaceSample const * p)
     {
-      if (pred)
+      array_size_t i = (array_size_t)index;
+      if (status[i] == WHITE)
       {
-        ParamData const * pred_pred = pred->pred_data;
-        if (pred_pred)
-        {
-          Vector3 edge = pos_in_pred_frame - pred->proj_p;
-          Vector3 prev_edge = pred->proj_p - pred_pred->proj_p;
+        status[i] = GREY;
+        touched.push_back(index);
+      }
+      else if (d >= dist[i])
+        return;
 
-          Vector3 right = prev_edge.cross(tangent_plane.getNormal()).fastUnit();
-          Vector3 v = edge - (edge.dot(right) * right);
-          if (v.squaredLength() > 1.0e-10f)  // TODO: Is this a generally applicable epsilon?
-          {
-            AffineTransform3 pred_inc = AffineTransform3::translation(pred->proj_p)
-                                      * AffineTransform3::rotationArc(v.fastUnit(), prev_edge.fastUnit(), false)
-                                      * AffineTransform3::translation(-pred->proj_p);
-            curr.proj_p = pred_inc * pos_in_pred_frame;
-            curr.uv_transform = pred_inc * pred->uv_transform;
-          }
-          else
-          {
-            curr.proj_p = tangent_plane.closestPoint(pos_in_pred_frame);
-            curr.uv_transform = AffineTransform3::translation(curr.proj_p - pos_in_pred_frame) * pred->uv_transform;
-          }
-        }
-        else  // the predecessor is the source
+      dist[i] = d;
+      pred[i] = p;
+      heap.push_back(HeapEntry(d, index));
+      std::push_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+    }
+
+    // Splat the values of the parametrized samples onto the grid of an origin, with bilinear weights, and normalize
+    void resample(long origin)
+    {
+      long num_cells = grid_size * grid_size;
+      Real * patch = (num_channels > 0 ? patches + origin * num_cells * num_channels : NULL);
+      if (patch)
+        std::fill(patch, patch + num_cells * num_channels, static_cast<Real>(0));
+
+      std::fill(weights.begin(), weights.end(), static_cast<Real>(0));
+
+      Real scale = 0.5f * grid_size / radius;
+      for (array_size_t j = 0; j < touched.size(); ++j)
+      {
+        long index = touched[j];
+        if (status[(array_size_t)index] != BLACK)
+          continue;
+
+        // Map [-radius, radius] to [0, grid_size], with cell centers at half-integers
+        Vector2 const & uv = param_data[(array_size_t)index].uv;
+        Real gx = (uv.x() + radius) * scale - 0.5f;
+        Real gy = (uv.y() + radius) * scale - 0.5f;
+        long ix = (long)std::floor(gx), iy = (long)std::floor(gy);
+        Real fx = gx - ix, fy = gy - iy;
+
+        Real const * values = (patch ? sample_values + index * num_channels : NULL);
+        for (int dy = 0; dy < 2; ++dy)
         {
-          Vector3 edge = pos_in_pred_frame - pred->proj_p;
-          Vector3 tp = tangent_plane.closestPoint(pos_in_pred_frame);
-          Vector3 v = tp - pred->proj_p;
-          if (v.squaredLength() > 1.0e-10f)  // TODO: Is this a generally applicable epsilon?
-          {
-            AffineTransform3 pred_inc = AffineTransform3::translation(pred->proj_p)
-                                      * AffineTransform3::rotationArc(edge.fastUnit(), v.fastUnit(), false)
-                                      * AffineTransform3::translation(-pred->proj_p);
-            curr.proj_p = pred_inc * pos_in_pred_frame;
-            curr.uv_transform = pred_inc * pred->uv_transform;
-          }
-          else  // hope this never happens, because we're going to squash the edge to zero length
+          long y = iy + dy;
+          if (y < 0 || y >= grid_size) continue;
+
+          for (int dx = 0; dx < 2; ++dx)
           {
-            curr.proj_p = tp;
-            curr.uv_transform = AffineTransform3::translation(curr.proj_p - pos_in_pred_frame) * pred->uv_transform;
+            long x = ix + dx;
+            if (x < 0 || x >= grid_size) continue;
+
+            Real w = (dx ? fx : 1 - fx) * (dy ? fy : 1 - fy);
+            if (w <= 0) continue;
+
+            long cell = y * grid_size + x;
+            weights[(array_size_t)cell] += w;
+
+            if (patch)
+            {
+              Real * cell_values = patch + cell * num_channels;
+              for (long c = 0; c < num_channels; ++c)
+                cell_values[c] += w * values[c];
+            }
           }
         }
       }
-      else  // this is the source
+
+      for (long cell = 0; cell < num_cells; ++cell)
       {
-        // Map to origin
-        Vector3 tp = tangent_plane.closestPoint(pos_in_pred_frame);  // just in case, but it should be on the plane anyway
-        curr.proj_p = tp;
-        curr.uv_transform = AffineTransform3::translation(tp - pos_in_pred_frame);
+        Real w = weights[(array_size_t)cell];
+        if (patch && w > 0)
+        {
+          Real * cell_values = patch + cell * num_channels;
+          for (long c = 0; c < num_channels; ++c)
+            cell_values[c] /= w;
+        }
       }
+
+      if (coverage)
+        std::copy(weights.begin(), weights.end(), coverage + origin * num_cells);
     }
 
-    Options options;
-    ParameterMap params;
-    ParamDataMap param_data;
-    Geodesics geodesics;
-    Plane3 tangent_plane;
-    Vector3 origin;
-    Vector3 u_axis, v_axis;
+    DiscreteExponentialMap::Options options;
+    SampleGraph const * sample_graph;
+    Adjacencies const * adjacencies;
+    long const * origin_indices;
+    Vector3 const * u_axes;
+    Vector3 const * v_axes;
     Real radius;
+    long num_channels;
+    Real const * sample_values;
+    long grid_size;
+    Real * patches;
+    Real * coverage;
     Real blend_bandwidth_squared;
 
-}; // class Impl
+    // Per-thread scratch space
+    TheaArray<char> status;
+    TheaArray<double> dist;
+    TheaArray<SurfaceSample const *> pred;
+    TheaArray<ParamData> param_data;
+    TheaArray<long> touched;
+    TheaArray<HeapEntry> heap;
+    TheaArray<Real> weights;
+
+}; // class BatchWorker
 
 } // namespace DiscreteExponentialMapInternal
 
@@ -307,6 +592,31 @@ DiscreteExponentialMap::getRadius() const
   return impl->getRadius();
 }
 
+void
+DiscreteExponentialMap::parametrizeBatch(SampleGraph const & sample_graph, long num_origins, long const * origin_indices,
+                                         Vector3 const * u_axes, Vector3 const * v_axes, Real radius, long grid_size,
+                                         long num_channels, Real const * sample_values, Real * patches, Real * coverage,
+                                         long max_threads) const
+{
+  using namespace DiscreteExponentialMapInternal;
+
+  if (num_origins <= 0)
+    return;
+
+  alwaysAssertM(origin_indices && u_axes && v_axes, "DiscreteExponentialMap: Origins and tangent axes must be specified");
+  alwaysAssertM(radius > 0, "DiscreteExponentialMap: Patch radius must be positive");
+  alwaysAssertM(grid_size > 0, "DiscreteExponentialMap: Patch grid size must be positive");
+  alwaysAssertM(num_channels <= 0 || (sample_values && patches),
+                "DiscreteExponentialMap: Sample values and output patches must be specified");
+
+  BatchWorker::Adjacencies adjacencies(sample_graph);
+
+  // Each thread gets its own copy of the worker, and hence the scratch space
+  parallelForChunks(num_origins, BatchWorker(impl->getOptions(), sample_graph, adjacencies, origin_indices, u_axes, v_axes,
+                                             radius, std::max(num_channels, 0L), sample_values, grid_size, patches, coverage),
+                    -1, max_threads);
+}
+
 void
 DiscreteExponentialMap::clear()
 {
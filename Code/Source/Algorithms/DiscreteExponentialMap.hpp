@@ -137,6 +137,37 @@ class DiscreteExponentialMap : private Noncopyable
     /** Get the bounding radius of the region which is parametrized. */
     Real getRadius() const;
 
+    /**
+     * Compute exponential map parametrizations of a surface around many origins in parallel, and resample each parametrized
+     * patch onto a regular grid. This does not change the current parametrization (see parametrize()). Each thread has its own
+     * scratch space, which is reused across origins and only partially reset for each one, so the cost of a patch depends on
+     * the number of samples within its radius and not on the size of the graph. The blend-upwind option is respected, and the
+     * normalization option is ignored.
+     *
+     * The grid of each patch has \a grid_size x \a grid_size cells spanning [-\a radius, \a radius]^2 in the tangent plane,
+     * with rows along the V axis and columns along the U axis. The values of each parametrized sample are splatted onto the
+     * grid with bilinear weights, and the value of each cell is the weighted average of the samples splatted onto it (zero if
+     * there are none).
+     *
+     * @param sample_graph The surface, represented as an adjacency graph of surface samples.
+     * @param num_origins The number of patches to compute.
+     * @param origin_indices The indices of the samples at the centers of the patches.
+     * @param u_axes The U axes of the bases of the tangent planes at the origins.
+     * @param v_axes The V axes of the bases of the tangent planes at the origins.
+     * @param radius The geodesic radius of each patch.
+     * @param grid_size The number of grid cells along each side of a patch.
+     * @param num_channels The number of values per sample to resample, which may be zero if only \a coverage is required.
+     * @param sample_values The values to be resampled, with the \a num_channels values of each sample stored consecutively.
+     * @param patches Used to return the resampled values, in a \a num_origins x \a grid_size x \a grid_size x
+     *   \a num_channels array (origin is major dimension for packing). Must have space for this many values.
+     * @param coverage If non-null, used to return the total splatting weight of each grid cell, which is zero for cells with
+     *   no nearby samples, in a \a num_origins x \a grid_size x \a grid_size array. Must have space for this many values.
+     * @param max_threads The maximum number of threads to use. If not positive, System::concurrency() is used.
+     */
+    void parametrizeBatch(SampleGraph const & sample_graph, long num_origins, long const * origin_indices,
+                          Vector3 const * u_axes, Vector3 const * v_axes, Real radius, long grid_size, long num_channels,
+                          Real const * sample_values, Real * patches, Real * coverage = NULL, long max_threads = -1) const;
+
     /** Clear any existing parametrization. */
     void clear();
 
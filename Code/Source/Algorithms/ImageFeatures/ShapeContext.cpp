@@ -44,8 +44,10 @@
 #include "../../HyperplaneN.hpp"
 #include "../../Image.hpp"
 #include "../../Math.hpp"
+#include "../../ParallelFor.hpp"
 #include "../../Vector2.hpp"
 #include <algorithm>
+#include <map>
 
 namespace Thea {
 namespace Algorithms {
@@ -297,6 +299,312 @@ struct QuadTree
 
 }; // QuadTree
 
+// Summed-area table of an 8-bit image.
+struct SummedAreaTable
+{
+  int w, h;
+  TheaArray<int64> sums;  // (w + 1) x (h + 1), with a leading row and column of zeros
+
+  SummedAreaTable(Image const & image)
+  : w(image.getWidth()), h(image.getHeight()), sums((array_size_t)((w + 1) * (h + 1)), 0)
+  {
+    for (int i = 0; i < h; ++i)
+    {
+      uint8 const * scanline = (uint8 const *)image.getScanLine(i);
+      int64 const * prev = &sums[(array_size_t)(i * (w + 1))];
+      int64 * curr = &sums[(array_size_t)((i + 1) * (w + 1))];
+
+      int64 row_sum = 0;
+      for (int j = 0; j < w; ++j)
+      {
+        row_sum += scanline[j];
+        curr[j + 1] = prev[j + 1] + row_sum;
+      }
+    }
+  }
+
+  // Sum of the pixels in columns [x0, x1] and rows [y0, y1]. The rectangle must be non-empty and lie within the image.
+  int64 sum(int x0, int y0, int x1, int y1) const
+  {
+    int stride = w + 1;
+    return sums[(array_size_t)((y1 + 1) * stride + x1 + 1)] - sums[(array_size_t)(y0 * stride + x1 + 1)]
+         - sums[(array_size_t)((y1 + 1) * stride + x0)] + sums[(array_size_t)(y0 * stride + x0)];
+  }
+
+}; // struct SummedAreaTable
+
+// Decomposition of the shape context bins around a pixel into rectangular cells of pixel offsets, shared by all pixels. Each
+// cell carries the weights with which its sum contributes to each bin.
+struct DenseStencil
+{
+  struct Cell
+  {
+    int x0, y0, x1, y1;  // column and row offsets, inclusive
+    int begin, end;      // range of entries in bins and weights
+  };
+
+  TheaArray<Cell> cells;
+  TheaArray<int> bins;
+  TheaArray<Real> weights;
+
+  // Build the stencil for bins with the given boundaries (radii[r] to radii[r + 1], angles[p] to angles[p + 1]), restricted to
+  // offsets in [-max_dx, max_dx] x [-max_dy, max_dy].
+  DenseStencil(int max_dx_, int max_dy_, TheaArray<Real> const & radii_, TheaArray<Real> const & angles_,
+               Real max_cell_fraction_)
+  : max_dx(max_dx_), max_dy(max_dy_), radii(radii_), angles(angles_), max_cell_fraction(max_cell_fraction_),
+    num_polar_bins((int)angles_.size() - 1), num_bins((int)((radii_.size() - 1) * (angles_.size() - 1))),
+    bin_counts((array_size_t)num_bins, 0)
+  {
+    computeLabels();
+    subdivide(-max_dx, -max_dy, max_dx, max_dy);
+  }
+
+ private:
+  // Label each offset with the set of bins containing it, exactly as Sector::contains() does. The label is -1 for no bin, a
+  // bin index for a single bin, or num_bins + i for the i'th entry of label_sets.
+  void computeLabels()
+  {
+    int sx = 2 * max_dx + 1, sy = 2 * max_dy + 1;
+    labels.resize((array_size_t)sx * (array_size_t)sy);
+
+    std::map<TheaArray<int>, int> label_set_indices;
+    TheaArray<int> pixel_bins;
+
+    int num_radial_bins = (int)radii.size() - 1;
+    for (int dy = -max_dy; dy <= max_dy; ++dy)
+      for (int dx = -max_dx; dx <= max_dx; ++dx)
+      {
+        Vector2 delta((Real)dx, (Real)dy);
+        Real sqdist = delta.squaredLength();
+        Real ang = Math::fastArcTan2(delta.y(), delta.x());
+        if (ang < 0) ang += Math::twoPi();
+
+        pixel_bins.clear();
+        for (int r = 0; r < num_radial_bins; ++r)
+        {
+          if (sqdist < radii[(array_size_t)r] * radii[(array_size_t)r]
+           || sqdist > radii[(array_size_t)r + 1] * radii[(array_size_t)r + 1])
+            continue;
+
+          for (int p = 0; p < num_polar_bins; ++p)
+            if (ang >= angles[(array_size_t)p] && ang <= angles[(array_size_t)p + 1])
+              pixel_bins.push_back(r * num_polar_bins + p);
+        }
+
+        int label = -1;
+        if (pixel_bins.size() == 1)
+          label = pixel_bins[0];
+        else if (pixel_bins.size() > 1)
+        {
+          std::map<TheaArray<int>, int>::const_iterator existing = label_set_indices.find(pixel_bins);
+          if (existing == label_set_indices.end())
+          {
+            label = num_bins + (int)label_sets.size();
+            label_set_indices[pixel_bins] = label;
+            label_sets.push_back(pixel_bins);
+          }
+          else
+            label = existing->second;
+        }
+
+        labels[(array_size_t)(dy + max_dy) * (array_size_t)sx + (array_size_t)(dx + max_dx)] = label;
+      }
+  }
+
+  int getLabel(int dx, int dy) const
+  {
+    return labels[(array_size_t)(dy + max_dy) * (array_size_t)(2 * max_dx + 1) + (array_size_t)(dx + max_dx)];
+  }
+
+  // Get the size up to which a cell centered at a given offset is not subdivided further.
+  Real maxCellSize(Real cx, Real cy) const
+  {
+    Real d = std::sqrt(cx * cx + cy * cy);
+
+    array_size_t r = 0;
+    while (r + 2 < radii.size() && d > radii[r + 1])
+      ++r;
+
+    Real ring_width = radii[r + 1] - radii[r];
+    Real arc_width = d * (angles[1] - angles[0]);
+
+    return max_cell_fraction * std::min(ring_width, arc_width);
+  }
+
+  void addCell(int x0, int y0, int x1, int y1)
+  {
+    Cell cell;
+    cell.x0 = x0; cell.y0 = y0;
+    cell.x1 = x1; cell.y1 = y1;
+    cell.begin = cell.end = (int)bins.size();
+
+    cells.push_back(cell);
+  }
+
+  void addBin(int bin, Real weight)
+  {
+    bins.push_back(bin);
+    weights.push_back(weight);
+    cells.back().end = (int)bins.size();
+  }
+
+  void subdivide(int x0, int y0, int x1, int y1)
+  {
+    int first = getLabel(x0, y0);
+    bool uniform = true;
+    for (int dy = y0; uniform && dy <= y1; ++dy)
+      for (int dx = x0; dx <= x1; ++dx)
+        if (getLabel(dx, dy) != first)
+        {
+          uniform = false;
+          break;
+        }
+
+    if (uniform)
+    {
+      if (first < 0)
+        return;
+
+      addCell(x0, y0, x1, y1);
+      if (first < num_bins)
+        addBin(first, 1);
+      else
+      {
+        TheaArray<int> const & label_set = label_sets[(array_size_t)(first - num_bins)];
+        for (array_size_t i = 0; i < label_set.size(); ++i)
+          addBin(label_set[i], 1);
+      }
+
+      return;
+    }
+
+    int sx = x1 - x0 + 1, sy = y1 - y0 + 1;
+    if (std::max(sx, sy) <= maxCellSize(0.5f * (x0 + x1), 0.5f * (y0 + y1)))
+    {
+      // Split the sum of the cell among the bins it overlaps, in proportion to the number of pixels in each
+      for (int dy = y0; dy <= y1; ++dy)
+        for (int dx = x0; dx <= x1; ++dx)
+        {
+          int label = getLabel(dx, dy);
+          if (label < 0)
+            continue;
+          else if (label < num_bins)
+            bin_counts[(array_size_t)label]++;
+          else
+          {
+            TheaArray<int> const & label_set = label_sets[(array_size_t)(label - num_bins)];
+            for (array_size_t i = 0; i < label_set.size(); ++i)
+              bin_counts[(array_size_t)label_set[i]]++;
+          }
+        }
+
+      addCell(x0, y0, x1, y1);
+      Real area = (Real)sx * (Real)sy;
+      for (int b = 0; b < num_bins; ++b)
+        if (bin_counts[(array_size_t)b] > 0)
+        {
+          addBin(b, bin_counts[(array_size_t)b] / area);
+          bin_counts[(array_size_t)b] = 0;
+        }
+
+      return;
+    }
+
+    int xmid = x0 + (sx - 1) / 2;
+    int ymid = y0 + (sy - 1) / 2;
+
+    subdivide(x0, y0, xmid, ymid);
+    if (xmid < x1) subdivide(xmid + 1, y0, x1, ymid);
+    if (ymid < y1) subdivide(x0, ymid + 1, xmid, y1);
+    if (xmid < x1 && ymid < y1) subdivide(xmid + 1, ymid + 1, x1, y1);
+  }
+
+  int max_dx, max_dy;
+  TheaArray<Real> radii, angles;
+  Real max_cell_fraction;
+  int num_polar_bins, num_bins;
+  TheaArray<int> labels;
+  TheaArray< TheaArray<int> > label_sets;
+  TheaArray<long> bin_counts;
+
+}; // struct DenseStencil
+
+// Computes the shape contexts of a band of rows of an image.
+class DenseBandTask
+{
+  public:
+    DenseBandTask(Image const * image_, SummedAreaTable const * sat_, DenseStencil const * stencil_, long num_radial_bins_,
+                  long num_polar_bins_, int band_size_, bool ignore_empty_pixels_, Real * values_)
+    : image(image_), sat(sat_), stencil(stencil_), num_radial_bins(num_radial_bins_), num_polar_bins(num_polar_bins_),
+      band_size(band_size_), ignore_empty_pixels(ignore_empty_pixels_), values(values_)
+    {}
+
+    void operator()(long band)
+    {
+      static Real const SQRT_3 = std::sqrt(3.0f);
+
+      int w = image->getWidth();
+      int h = image->getHeight();
+      long entry_size = num_radial_bins * num_polar_bins;
+
+      int row_begin = (int)band * band_size;
+      int row_end = std::min(row_begin + band_size, h);
+
+      DenseStencil::Cell const * cells = stencil->cells.empty() ? NULL : &stencil->cells[0];
+      long num_cells = (long)stencil->cells.size();
+
+      for (int i = row_begin; i < row_end; ++i)
+      {
+        uint8 const * scanline = (uint8 const *)image->getScanLine(i);
+        Real * entry = values + (long)i * w * entry_size;
+
+        for (int j = 0; j < w; ++j, entry += entry_size)
+        {
+          std::fill(entry, entry + entry_size, 0);
+
+          if (ignore_empty_pixels && scanline[j] == 0)
+            continue;
+
+          for (long k = 0; k < num_cells; ++k)
+          {
+            DenseStencil::Cell const & cell = cells[k];
+
+            int y0 = std::max(i + cell.y0, 0), y1 = std::min(i + cell.y1, h - 1);
+            if (y0 > y1) continue;
+
+            int x0 = std::max(j + cell.x0, 0), x1 = std::min(j + cell.x1, w - 1);
+            if (x0 > x1) continue;
+
+            int64 sum = sat->sum(x0, y0, x1, y1);
+            if (sum == 0) continue;
+
+            Real weight = sum / (Real)255;  // normalize each pixel's weight to [0, 1]
+            for (int m = cell.begin; m < cell.end; ++m)
+              entry[stencil->bins[(array_size_t)m]] += stencil->weights[(array_size_t)m] * weight;
+          }
+
+          // Compensate for increasing size of bins, as in compute()
+          for (long r = 1; r < num_radial_bins; ++r)
+          {
+            Real scale = 1 / (SQRT_3 * (1 << (r - 1)));
+            for (long p = 0; p < num_polar_bins; ++p)
+              entry[r * num_polar_bins + p] *= scale;
+          }
+        }
+      }
+    }
+
+  private:
+    Image const * image;
+    SummedAreaTable const * sat;
+    DenseStencil const * stencil;
+    long num_radial_bins, num_polar_bins;
+    int band_size;
+    bool ignore_empty_pixels;
+    Real * values;
+
+}; // class DenseBandTask
+
 } // namespace ShapeContextInternal
 
 ShapeContext::ShapeContext(Image const & image)
@@ -431,6 +739,59 @@ const
   }
 }
 
+void
+ShapeContext::computeDense(long num_radial_bins, long num_polar_bins, TheaArray<Real> & values, bool ignore_empty_pixels,
+                           Real max_radius, Real max_cell_fraction) const
+{
+  alwaysAssertM(num_radial_bins > 0 && num_polar_bins > 0, "ShapeContext: Number of bins must be positive");
+
+  values.resize((array_size_t)(qtree->image.getWidth() * qtree->image.getHeight() * num_radial_bins * num_polar_bins));
+  if (!values.empty())
+    computeDense(num_radial_bins, num_polar_bins, &values[0], ignore_empty_pixels, max_radius, max_cell_fraction);
+}
+
+void
+ShapeContext::computeDense(long num_radial_bins, long num_polar_bins, Real * values, bool ignore_empty_pixels,
+                           Real max_radius, Real max_cell_fraction) const
+{
+  using namespace ShapeContextInternal;
+
+  alwaysAssertM(num_radial_bins > 0 && num_polar_bins > 0, "ShapeContext: Number of bins must be positive");
+
+  Image const & image = qtree->image;
+  int w = image.getWidth();
+  int h = image.getHeight();
+  if (w <= 0 || h <= 0)
+    return;
+
+  // Bin boundaries, computed exactly as in compute()
+  Real rad_limit = (max_radius <= 0 ? std::sqrt((Real)(w * w + h * h)) : max_radius);
+  Real rad_init = rad_limit / (1 << (num_radial_bins - 1));
+  Real ang_step = Math::twoPi() / num_polar_bins;
+
+  TheaArray<Real> radii(1, 0), angles(1, 0);
+  Real radius = rad_init;
+  for (long r = 0; r < num_radial_bins; ++r, radius *= 2)
+    radii.push_back(radius);
+
+  Real ang = ang_step;
+  for (long p = 0; p < num_polar_bins; ++p, ang += ang_step)
+    angles.push_back(ang);
+
+  // Offsets further than the image dimensions never reach any pixel
+  int max_offset = (int)std::ceil(radii.back());
+  DenseStencil stencil(std::min(max_offset, w - 1), std::min(max_offset, h - 1), radii, angles,
+                       std::max(max_cell_fraction, (Real)0));
+  SummedAreaTable sat(image);
+
+  THEA_DEBUG << "ShapeContext: Computing dense shape contexts with " << stencil.cells.size() << " cells per pixel";
+
+  static int const BAND_SIZE = 4;
+  long num_bands = (h + BAND_SIZE - 1) / BAND_SIZE;
+  parallelFor(num_bands, DenseBandTask(&image, &sat, &stencil, num_radial_bins, num_polar_bins, BAND_SIZE, ignore_empty_pixels,
+                                      values), 1);
+}
+
 } // namespace ImageFeatures
 } // namespace Algorithms
 } // namespace Thea
@@ -104,6 +104,43 @@ class THEA_API ShapeContext
     void compute(int row, int col, long num_radial_bins, long num_polar_bins, TheaArray<Real> & values, Real max_radius = -1)
          const;
 
+    /**
+     * Computes the shape context at each pixel of a contour image in a single pass, which is much faster than compute() for
+     * large images. The bins around a pixel are decomposed, once for all pixels, into axis-aligned cells of pixel offsets (by
+     * quadtree subdivision), and the sum of the image over each cell is looked up in a summed-area table. Cells lying in a
+     * single bin are exact. Cells straddling bin boundaries are subdivided until their size is at most \a max_cell_fraction
+     * times the local width of the bins, and their sums are then split among the overlapping bins in proportion to the area of
+     * overlap. Bands of rows of the image are processed in parallel.
+     *
+     * The cost per pixel is proportional to the number of cells. With a positive \a max_cell_fraction, this grows roughly
+     * logarithmically with the maximum radius R of the context (about 1100 cells for R = 90 and 2000 cells for R = 720 with 5
+     * radial and 12 polar bins, at the default fraction). With \a max_cell_fraction = 0, cells straddling bin boundaries are
+     * subdivided down to single pixels, so the number of cells is proportional to the total length of the bin boundaries, i.e.
+     * O(R) (about 2700 cells for R = 90 and 27000 for R = 720). This is the same order as the per-pixel cost of compute(), and
+     * the dense version is then faster only by a constant factor, since each cell is a summed-area table lookup instead of a
+     * quadtree traversal.
+     *
+     * @param num_radial_bins Number of divisions in the radial direction.
+     * @param num_polar_bins Number of divisions in the angular direction.
+     * @param values Computed shape contexts, in a num_pixels * \a num_radial_bins * \a num_polar_bins array (num_pixels is
+     *   major dimension for packing), as in compute(). Must have space for this many values, e.g. the block of a feature in a
+     *   columnar feature file.
+     * @param ignore_empty_pixels Does not compute shape contexts for pixels that are empty (zero luminance, i.e. black). The
+     *   corresponding entries in \a values are set to zero.
+     * @param max_radius Limits the area of the context for a pixel to this radius (negative for default).
+     * @param max_cell_fraction Accuracy of the approximation. If zero, boundary cells are subdivided down to single pixels and
+     *   the results match those of compute() up to rounding errors, at O(R) cost per pixel (see above).
+     */
+    void computeDense(long num_radial_bins, long num_polar_bins, Real * values, bool ignore_empty_pixels = true,
+                      Real max_radius = -1, Real max_cell_fraction = 0.25f) const;
+
+    /**
+     * Computes the shape context at each pixel of a contour image in a single pass. Same as the other version of
+     * computeDense(), except that \a values is resized to num_pixels * \a num_radial_bins * \a num_polar_bins.
+     */
+    void computeDense(long num_radial_bins, long num_polar_bins, TheaArray<Real> & values, bool ignore_empty_pixels = true,
+                      Real max_radius = -1, Real max_cell_fraction = 0.25f) const;
+
   private:
     ShapeContextInternal::QuadTree * qtree;
 
@@ -0,0 +1,184 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_Algorithms_KDTreeForestN_hpp__
+#define __Thea_Algorithms_KDTreeForestN_hpp__
+
+#include "../Common.hpp"
+#include "KDTreeN.hpp"
+
+namespace Thea {
+namespace Algorithms {
+
+/**
+ * A set of randomized kd-trees on the same elements, for approximate nearest neighbor queries in high dimensions. Each tree
+ * splits its nodes along axes picked at random from the longest few (see KDTreeN::setRandomizedSplits()), so the trees
+ * partition space differently. A query visits the leaves of all the trees in a single best-bin-first order, which finds
+ * the true neighbors within a fixed budget of leaves far more often than a single tree does.
+ *
+ * Each tree stores its own copy of the elements. If the elements are large, consider building the forest on pointers to them.
+ */
+template < typename T,
+           long N,
+           typename ScalarT = Real,
+           typename NodeAttributeT = NullAttribute >
+class /* THEA_API */ KDTreeForestN : private Noncopyable
+{
+  public:
+    typedef KDTreeN<T, N, ScalarT, NodeAttributeT> KDTree;  ///< A tree in the forest.
+    typedef typename KDTree::NeighborPair NeighborPair;  ///< A pair of neighboring elements.
+    typedef typename KDTree::VectorT VectorT;  ///< Vector in N-space.
+
+    /** Default constructor. */
+    KDTreeForestN() {}
+
+    /**
+     * Construct from a list of elements. InputIterator must dereference to type T.
+     *
+     * @param begin Points to the first element to be added.
+     * @param end Points to one position beyond the last element to be added.
+     * @param num_trees Number of trees in the forest.
+     * @param num_candidate_axes The splitting axis of each node is picked at random from this many longest axes of the node.
+     * @param max_elems_in_leaf Maximum number of elements in a leaf. Use a negative argument to auto-select a suitable value.
+     */
+    template <typename InputIterator>
+    KDTreeForestN(InputIterator begin, InputIterator end, long num_trees = 4, long num_candidate_axes = 5,
+                  long max_elems_in_leaf = -1)
+    {
+      init(begin, end, num_trees, num_candidate_axes, max_elems_in_leaf);
+    }
+
+    /** Destructor. */
+    ~KDTreeForestN() { clear(); }
+
+    /**
+     * Construct from a list of elements, discarding any previous data. InputIterator must dereference to type T. The
+     * parameters are as for the constructor.
+     */
+    template <typename InputIterator>
+    void init(InputIterator begin, InputIterator end, long num_trees = 4, long num_candidate_axes = 5,
+              long max_elems_in_leaf = -1)
+    {
+      alwaysAssertM(num_trees > 0, "KDTreeForestN: Forest must have at least one tree");
+
+      clear();
+
+      trees.resize((array_size_t)num_trees);
+      for (array_size_t i = 0; i < trees.size(); ++i)
+      {
+        trees[i] = new KDTree;
+        trees[i]->setRandomizedSplits(num_candidate_axes);
+
+        // Build the other trees from the elements of the first, since the input sequence can be traversed only once
+        if (i == 0)
+          trees[i]->init(begin, end, -1, max_elems_in_leaf);
+        else
+          trees[i]->init(trees[0]->getElements(), trees[0]->getElements() + trees[0]->numElements(), -1, max_elems_in_leaf);
+      }
+    }
+
+    /** Remove all trees from the forest. */
+    void clear()
+    {
+      for (array_size_t i = 0; i < trees.size(); ++i)
+        delete trees[i];
+
+      trees.clear();
+    }
+
+    /** Get the number of trees in the forest. */
+    long numTrees() const { return (long)trees.size(); }
+
+    /** Get the i'th tree in the forest. */
+    KDTree const & getTree(long i) const { return *trees[(array_size_t)i]; }
+
+    /** Get the number of elements in the forest. */
+    long numElements() const { return trees.empty() ? 0 : trees[0]->numElements(); }
+
+    /** Get a pointer to an array of the elements in the forest. */
+    T const * getElements() const { return trees.empty() ? NULL : trees[0]->getElements(); }
+
+    /**
+     * Get the k elements approximately closest to a query object, searching all trees in the forest. See
+     * KDTreeN::approxKClosestPairs() for a description of the parameters.
+     */
+    template <typename MetricT, typename QueryT, typename BoundedNeighborPairSetT>
+    long approxKClosestPairs(QueryT const & query, BoundedNeighborPairSetT & k_closest_pairs, double epsilon,
+                             long max_leaves = -1, double dist_bound = -1, bool get_closest_points = false) const
+    {
+      if (trees.empty())
+      {
+        k_closest_pairs.clear();
+        return 0;
+      }
+
+      return KDTree::template approxKClosestPairs<MetricT>((long)trees.size(), &trees[0], query, k_closest_pairs, epsilon,
+                                                           max_leaves, dist_bound, get_closest_points);
+    }
+
+    /**
+     * Get an element approximately closest to a query object, searching all trees in the forest. See
+     * KDTreeN::approxClosestElement() for a description of the parameters.
+     */
+    template <typename MetricT, typename QueryT>
+    long approxClosestElement(QueryT const & query, double epsilon, long max_leaves = -1, double dist_bound = -1,
+                              double * dist = NULL, VectorT * closest_point = NULL) const
+    {
+      BoundedSortedArrayN<1, NeighborPair> nbr;
+      approxKClosestPairs<MetricT>(query, nbr, epsilon, max_leaves, dist_bound, closest_point != NULL);
+      if (nbr.isEmpty())
+        return -1;
+
+      if (dist) *dist = MetricT::invertMonotoneApprox(nbr[0].getMonotoneApproxDistance());
+      if (closest_point) *closest_point = nbr[0].getTargetPoint();
+
+      return nbr[0].getTargetIndex();
+    }
+
+  private:
+    TheaArray<KDTree *> trees;  ///< The trees in the forest.
+
+}; // class KDTreeForestN
+
+} // namespace Algorithms
+} // namespace Thea
+
+#endif
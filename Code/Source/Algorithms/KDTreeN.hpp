@@ -46,6 +46,8 @@
 #include "../AffineTransformN.hpp"
 #include "../Array.hpp"
 #include "../AttributedObject.hpp"
+#include "../BoundedSortedArray.hpp"
+#include "../BoundedSortedArrayN.hpp"
 #include "../Math.hpp"
 #include "../Noncopyable.hpp"
 #include "../Random.hpp"
@@ -53,6 +55,7 @@
 #include "BoundedTraitsN.hpp"
 #include "Filter.hpp"
 #include "ProximityQueryStructureN.hpp"
+#include "QueryStatistics.hpp"
 #include "RangeQueryStructure.hpp"
 #include "RayQueryStructureN.hpp"
 #include <boost/utility/enable_if.hpp>
@@ -61,6 +64,7 @@
 #include <cmath>
 #include <cstring>
 #include <functional>
+#include <queue>
 
 namespace Thea {
 namespace Algorithms {
@@ -104,6 +108,26 @@ class SampleFilter : public Filter< ElementSample<N, ScalarT> >
 
 }; // struct SampleFilter
 
+/**
+ * Selects the proxy used to prune kd-tree nodes against a query object: the bounding box of the query if it is bounded, else
+ * the query object itself. The selection is made at compile-time so that only the applicable distance functions are
+ * instantiated.
+ */
+template <typename QueryT, long N, typename ScalarT, typename Enable = void>
+struct QueryProxy
+{
+  typedef QueryT type;
+  static QueryT const & get(QueryT const & query, AxisAlignedBoxN<N, ScalarT> const & query_bounds) { return query; }
+};
+
+// Specialization for bounded query objects
+template <typename QueryT, long N, typename ScalarT>
+struct QueryProxy<QueryT, N, ScalarT, typename boost::enable_if< IsBoundedN<QueryT, N> >::type>
+{
+  typedef AxisAlignedBoxN<N, ScalarT> type;
+  static type const & get(QueryT const & query, AxisAlignedBoxN<N, ScalarT> const & query_bounds) { return query_bounds; }
+};
+
 } // namespace KDTreeNInternal
 
 template <long N, typename ScalarT>
@@ -190,6 +214,9 @@ class /* THEA_API */ KDTreeN
               current_end = 0;
             }
 
+            /** Get the number of elements currently allocated from the buffer. */
+            array_size_t size() const { return current_end; }
+
             /**
              * Allocate a block of elements and return a pointer to the first allocated element, or null if the allocation
              * exceeded buffer capacity.
@@ -287,6 +314,16 @@ class /* THEA_API */ KDTreeN
           return buffer_capacity;
         }
 
+        /** Get the number of elements currently allocated from the pool. */
+        array_size_t numAllocated() const
+        {
+          array_size_t n = 0;
+          for (array_size_t i = 0; i < buffers.size(); ++i)
+            n += buffers[i]->size();
+
+          return n;
+        }
+
         /** Reset the memory pool, optionally deallocating and removing all buffers. */
         void clear(bool deallocate_all_memory = true)
         {
@@ -386,19 +423,25 @@ class /* THEA_API */ KDTreeN
     {
       private:
         long depth;
+        long index;
         AxisAlignedBoxT bounds;
         array_size_t num_elems;
+        array_size_t elems_capacity;  // number of indices that fit in the elems array, for incremental insertion
+        array_size_t subtree_size;  // number of elements in the subtree rooted at this node
         ElementIndex * elems;
         Node * lo;
         Node * hi;
 
         friend class KDTreeN;
 
-        void init(long depth_)
+        void init(long depth_, long index_)
         {
           depth = depth_;
+          index = index_;
           bounds = AxisAlignedBoxT();
           num_elems = 0;
+          elems_capacity = 0;
+          subtree_size = 0;
           elems = NULL;
           lo = hi = NULL;
         }
@@ -408,18 +451,25 @@ class /* THEA_API */ KDTreeN
         typedef ElementIndex const * ElementIndexConstIterator;
 
         /** Constructor. */
-        Node(long depth_ = 0) : depth(depth_), lo(NULL), hi(NULL) {}
+        Node(long depth_ = 0) : depth(depth_), index(0), num_elems(0), elems_capacity(0), subtree_size(0), elems(NULL), lo(NULL),
+                                hi(NULL) {}
 
         /** Get the depth of the node in the tree (the root is at depth 0). */
         long getDepth() const { return depth; }
 
+        /**
+         * Get the index of the node, which is unique within the tree and lies in the range [0, numNodeIndices() - 1]. This can be
+         * used to associate auxiliary data with nodes.
+         */
+        long getIndex() const { return index; }
+
         /** Get the bounding box of the node. */
         AxisAlignedBoxT const & getBounds() const { return bounds; }
 
         /**
          * Get the number of element indices stored at this node. This is <b>not</b> the number of elements within the node's
          * bounding box: in memory-saving mode, indices of all such elements are only held at the leaves of the subtree rooted
-         * at this node.
+         * at this node. The same is true of inner nodes affected by incremental updates to the tree.
          */
         long numElementIndices() const { return (long)num_elems; }
 
@@ -449,7 +499,9 @@ class /* THEA_API */ KDTreeN
   public:
     /** Default constructor. */
     KDTreeN()
-    : root(NULL), num_elems(0), num_nodes(0), max_depth(0), max_elems_in_leaf(0), accelerate_nn_queries(false),
+    : root(NULL), num_elems(0), num_removed_elems(0), num_elems_at_build(0), num_indices_at_build(0), num_nodes(0),
+      num_node_indices(0), max_depth(0), auto_max_depth(true), max_elems_in_leaf(0), memory_saving_mode(false),
+      num_split_candidates(1), transform_uniform_scale(1), transform_min_scale(1), accelerate_nn_queries(false),
       valid_acceleration_structure(false), acceleration_structure(NULL), valid_bounds(true)
     {}
 
@@ -468,7 +520,9 @@ class /* THEA_API */ KDTreeN
     template <typename InputIterator>
     KDTreeN(InputIterator begin, InputIterator end, long max_depth_ = -1, long max_elems_in_leaf_ = -1,
             bool save_memory = false)
-    : root(NULL), num_elems(0), num_nodes(0), max_depth(0), max_elems_in_leaf(0), accelerate_nn_queries(false),
+    : root(NULL), num_elems(0), num_removed_elems(0), num_elems_at_build(0), num_indices_at_build(0), num_nodes(0),
+      num_node_indices(0), max_depth(0), auto_max_depth(true), max_elems_in_leaf(0), memory_saving_mode(false),
+      num_split_candidates(1), transform_uniform_scale(1), transform_min_scale(1), accelerate_nn_queries(false),
       valid_acceleration_structure(false), acceleration_structure(NULL), valid_bounds(true)
     {
       init(begin, end, max_elems_in_leaf_, max_depth_, save_memory, false /* no previous data to deallocate */);
@@ -547,88 +601,118 @@ class /* THEA_API */ KDTreeN
         }
       }
 
-      if (num_elems <= 0)
-        return;
+      build(max_depth_, max_elems_in_leaf_, save_memory, deallocate_previous_memory);
+    }
 
-      static long const DEFAULT_MAX_ELEMS_IN_LEAF = 10;
-      max_elems_in_leaf = max_elems_in_leaf_ < 0 ? DEFAULT_MAX_ELEMS_IN_LEAF : max_elems_in_leaf_;
+    /**
+     * Add an element to the tree without rebuilding it. The element is inserted into the leaf that contains it (or is closest to
+     * it), and the leaf is split if it overflows. Unbalanced subtrees are periodically rebuilt, so that a sequence of n updates
+     * takes O(n log n) amortized time. The whole tree is rebuilt when index arrays abandoned by updates take up as much memory
+     * as the tree itself, so memory use stays bounded. The indices of existing elements are not changed.
+     *
+     * @param elem The element to add. It is ignored if it does not pass the filters currently on the stack.
+     *
+     * @return The index of the new element, or a negative number if it was rejected by the filters.
+     *
+     * @see remove(), update()
+     */
+    long insert(T const & elem)
+    {
+      if (!elementPassesFilters(elem))
+        return -1;
 
-      // The fraction of elements held by the larger node at each split is 0.5
-      static double const SPLIT_FRACTION = 0.5;
-      long est_depth = Math::binaryTreeDepth(num_elems, max_elems_in_leaf, SPLIT_FRACTION);
-      max_depth = max_depth_;
-      if (max_depth < 0)
-        max_depth = est_depth;
-      else if (max_depth < est_depth)
-        est_depth = max_depth;
+      ElementIndex index = (ElementIndex)num_elems;
+      if (index < elems.size())
+        elems[index] = elem;
+      else
+        elems.push_back(elem);  // may reallocate the array
 
-      // THEA_CONSOLE << "KDTreeN: max_depth = " << max_depth << ", est_depth = " << est_depth;
+      num_elems++;
+      if (!removed_elems.empty())
+        removed_elems.push_back(false);
 
-      // Each index is stored at most once at each level
-      array_size_t BUFFER_SAFETY_MARGIN = 10;
-      array_size_t index_buffer_capacity = num_elems + BUFFER_SAFETY_MARGIN;
-      if (!save_memory)
-        index_buffer_capacity *= (array_size_t)(1 + est_depth);  // reserve space for all levels at once
+      attachElement(index);
+      reclaimIndexPool();
 
-      if (deallocate_previous_memory || index_buffer_capacity > 1.3 * index_pool.getBufferCapacity())
-      {
-        // THEA_CONSOLE << "KDTreeN: Resizing index pool: old buffer capacity = " << index_pool.getBufferCapacity()
-        //              << ", new buffer capacity = " << index_buffer_capacity;
-        index_pool.init(index_buffer_capacity);
-      }
+      return (long)index;
+    }
 
-      // Assume a complete, balanced binary tree upto the estimated depth to guess the number of leaf nodes
-      array_size_t node_buffer_capacity = (array_size_t)(1 << est_depth) + BUFFER_SAFETY_MARGIN;
-      if (deallocate_previous_memory || node_buffer_capacity > 1.3 * node_pool.getBufferCapacity())
-      {
-        // THEA_CONSOLE << "KDTreeN: Resizing node pool: old buffer capacity = " << node_pool.getBufferCapacity()
-        //              << ", new buffer capacity = " << node_buffer_capacity;
-        node_pool.init(node_buffer_capacity);
-      }
+    /**
+     * Remove an element from the tree without rebuilding it. The element is marked as removed (a tombstone) and is ignored by
+     * all subsequent queries, but its slot in the element array is not reused, so the indices of the other elements remain
+     * valid. The slots of removed elements are released by the next call to init().
+     *
+     * @param index The index of the element to remove.
+     *
+     * @return True if the element was removed, false if the index was invalid or the element had already been removed.
+     *
+     * @see insert(), update(), isRemoved()
+     */
+    bool remove(long index)
+    {
+      if (index < 0 || index >= num_elems || isRemoved(index))
+        return false;
 
-      // Create the root node
-      root = node_pool.alloc(1);
-      root->init(0);
-      num_nodes = 1;
+      detachElement((ElementIndex)index);
 
-      // THEA_CONSOLE << "Allocated root " << root << " from mempool " << &node_pool;
+      if (removed_elems.empty())
+        removed_elems.resize((array_size_t)num_elems, false);
 
-      root->num_elems = num_elems;
-      root->elems = index_pool.alloc(root->num_elems);
+      removed_elems[(array_size_t)index] = true;
+      num_removed_elems++;
 
-      AxisAlignedBoxT elem_bounds;
-      for (array_size_t i = 0; i < (array_size_t)num_elems; ++i)
-      {
-        root->elems[i] = i;
+      // Removals leave empty nodes behind, so rebuild from scratch once half the elements are gone
+      if (2 * (num_elems - num_removed_elems) < num_elems_at_build)
+        build(auto_max_depth ? -1 : max_depth, max_elems_in_leaf, memory_saving_mode, false);
+      else
+        reclaimIndexPool();
 
-        BoundedTraitsT::getBounds(elems[i], elem_bounds);
-        root->bounds.merge(elem_bounds);
-      }
+      return true;
+    }
 
-      // Expand the bounding box slightly to handle numerical error
-      root->bounds.scaleCentered(BOUNDS_EXPANSION_FACTOR);
+    /**
+     * Replace an element of the tree with a new value, for instance to move a point, without rebuilding the tree. The element
+     * keeps its index.
+     *
+     * @param index The index of the element to replace.
+     * @param elem The new value of the element. Unlike insert(), this is not checked against the filters.
+     *
+     * @return True if the element was replaced, false if the index was invalid or the element has been removed.
+     *
+     * @see insert(), remove()
+     */
+    bool update(long index, T const & elem)
+    {
+      if (index < 0 || index >= num_elems || isRemoved(index))
+        return false;
 
-      if (save_memory)
-      {
-        // Estimate the maximum number of indices that will need to be held in the scratch pool at any time during depth-first
-        // traversal with earliest-possible deallocation. This is
-        //
-        //      #elements * (sum of series 1 + 1 + SPLIT_FRACTION + SPLIT_FRACTION^2 + ... + SPLIT_FRACTION^(est_depth - 1))
-        //  <=  #elements * (1 + 1 / (1 - SPLIT_FRACTION))
-        //
-        array_size_t est_max_path_indices = (array_size_t)(num_elems * (1 + 1 / (1 - SPLIT_FRACTION)));
-        // THEA_CONSOLE << "KDTreeN: Estimated maximum number of indices on a single path = " << est_max_path_indices;
+      detachElement((ElementIndex)index);
+      elems[(array_size_t)index] = elem;
+      attachElement((ElementIndex)index);
+      reclaimIndexPool();
 
-        // Create a temporary pool for scratch storage
-        IndexPool tmp_index_pool;
-        tmp_index_pool.init(est_max_path_indices + BUFFER_SAFETY_MARGIN);
+      return true;
+    }
 
-        createTree(root, true, &tmp_index_pool, &index_pool);
-      }
-      else
-        createTree(root, false, &index_pool, NULL);
+    /** Check if the element with a given index has been removed from the tree by remove(). */
+    bool isRemoved(long index) const
+    {
+      return !removed_elems.empty() && removed_elems[(array_size_t)index];
+    }
 
-      invalidateBounds();
+    /** Get the number of elements that have been removed from the tree by remove(). These are included in numElements(). */
+    long numRemovedElements() const { return num_removed_elems; }
+
+    /**
+     * Randomize the choice of splitting axis at each node of the tree. The axis is picked uniformly at random from the
+     * \a num_candidate_axes axes along which the node's bounding box is longest. A value of 1 (the default) always splits the
+     * longest axis. Trees built with randomized splits on the same elements make complementary errors, and are searched
+     * together for approximate nearest neighbor queries (see KDTreeForestN). The setting takes effect the next time the tree is
+     * built with init().
+     */
+    void setRandomizedSplits(long num_candidate_axes)
+    {
+      num_split_candidates = std::max(1L, std::min(num_candidate_axes, N));
     }
 
     /** Destructor. */
@@ -697,6 +781,7 @@ class /* THEA_API */ KDTreeN
     {
       TransformableBaseT::setTransform(trans_);
       transform_inverse_transpose = trans_.getLinear().inverse().transpose();
+      cacheTransformProperties();
       invalidateBounds();
 
       if (valid_acceleration_structure)
@@ -724,10 +809,18 @@ class /* THEA_API */ KDTreeN
       if (deallocate_all_memory)
         elems.clear();
 
+      removed_elems.clear();
+      num_removed_elems = 0;
+      num_elems_at_build = 0;
+      num_indices_at_build = 0;
+
       node_pool.clear(deallocate_all_memory);
       index_pool.clear(deallocate_all_memory);
 
       root = NULL;
+      num_nodes = 0;
+      num_node_indices = 0;
+      free_nodes.clear();
 
       invalidateBounds();
     }
@@ -735,7 +828,10 @@ class /* THEA_API */ KDTreeN
     /** Check if the tree is empty. */
     bool isEmpty() const { return num_elems <= 0; }
 
-    /** Get the number of elements in the tree. The elements themselves can be obtained with getElements(). */
+    /**
+     * Get the number of elements in the tree, including any that have been removed by remove(). The elements themselves can be
+     * obtained with getElements().
+     */
     long numElements() const { return num_elems; }
 
     /** Get a pointer to an array of the elements in the tree. The number of elements can be obtained with numElements(). */
@@ -755,6 +851,18 @@ class /* THEA_API */ KDTreeN
     /** Get the number of nodes in the tree. */
     long numNodes() const { return num_nodes; }
 
+    /**
+     * Get the number of distinct node indices currently in use (see Node::getIndex()). This is the same as numNodes() unless
+     * parts of the tree have been rebuilt by incremental updates, in which case some indices may be unused.
+     */
+    long numNodeIndices() const { return num_node_indices; }
+
+    /**
+     * Get the number of element indices currently allocated from the tree's internal memory pool. This includes index arrays
+     * abandoned by incremental updates, which are reclaimed once they take up as much space as the tree itself.
+     */
+    long numAllocatedIndices() const { return (long)index_pool.numAllocated(); }
+
     /** Get a bounding box for all the objects in the tree. */
     AxisAlignedBoxT const & getBounds() const
     {
@@ -836,7 +944,8 @@ class /* THEA_API */ KDTreeN
 
     /**
      * Get the closest pair of elements between this structure and another structure, whose separation is less than a specified
-     * upper bound.
+     * upper bound. If the query is itself a kd-tree, both trees are traversed simultaneously, pruning pairs of nodes that are
+     * further apart than the closest pair found so far.
      *
      * @param query Query object. BoundedTraitsN<QueryT, N, ScalarT> must be defined.
      * @param dist_bound Upper bound on the distance between any pair of points considered. Ignored if negative.
@@ -851,38 +960,8 @@ class /* THEA_API */ KDTreeN
     {
       if (!root) return NeighborPair(-1);
 
-      AxisAlignedBoxT query_bounds;
-      getObjectBounds(query, query_bounds);
-
-      // Early pruning if the entire structure is too far away from the query
-      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
-      if (mon_approx_dist_bound >= 0)
-      {
-        double lower_bound;
-        if (IsBoundedN<QueryT, N>::value)
-          lower_bound = MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*root), query_bounds);
-        else
-          lower_bound = MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*root), query);
-
-        if (lower_bound > mon_approx_dist_bound)
-          return NeighborPair(-1);
-      }
-
-      // If acceleration is enabled, set an upper limit to the distance to the nearest object
-      double accel_bound = accelerationBound<MetricT>(query, dist_bound);
-      if (accel_bound >= 0)
-      {
-        double fudge = 0.001 * getBoundsWorldSpace(*root).getExtent().fastLength();
-        mon_approx_dist_bound = MetricT::computeMonotoneApprox(accel_bound + fudge);
-      }
-
-      NeighborPair pair(-1, -1, mon_approx_dist_bound);
-      if (IsBoundedN<QueryT, N>::value)
-        closestPair<MetricT>(root, query, query_bounds, pair, get_closest_points);
-      else
-        closestPair<MetricT>(root, query, query, pair, get_closest_points);
-
-      return pair;
+      // The second argument selects the dual-tree implementation if the query is (derived from) a kd-tree
+      return closestPairImpl<MetricT>(query, &query, dist_bound, get_closest_points);
     }
 
     /**
@@ -914,19 +993,29 @@ class /* THEA_API */ KDTreeN
 
       if (!root) return 0;
 
+      if (use_as_query_index_and_swap < 0)
+        THEA_QUERY_STATS_ADD(PROXIMITY_QUERIES, 1);
+
       AxisAlignedBoxT query_bounds;
       getObjectBounds(query, query_bounds);
 
+      typedef KDTreeNInternal::QueryProxy<QueryT, N, ScalarT> QueryProxyT;
+      typename QueryProxyT::type const & query_proxy = QueryProxyT::get(query, query_bounds);
+
+      // If the tree is transformed and the query is a point, map the query to object space once instead of mapping every node
+      // to world space
+      VectorT query_pt, query_pt_os;
+      bool transformed_point = (TransformableBaseT::hasTransform() && getQueryPoint(query, query_pt));
+      if (transformed_point)
+        query_pt_os = inv_transform * query_pt;
+
       // Early pruning if the entire structure is too far away from the query
       double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
       if (mon_approx_dist_bound >= 0)
       {
-        double lower_bound;
-        if (IsBoundedN<QueryT, N>::value)
-          lower_bound = MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*root), query_bounds);
-        else
-          lower_bound = MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*root), query);
-
+        double lower_bound = transformed_point
+                           ? transformedNodeDistance<MetricT>(*root, query_pt, query_pt_os)
+                           : MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*root), query_proxy);
         if (lower_bound > mon_approx_dist_bound)
           return 0;
 
@@ -934,20 +1023,247 @@ class /* THEA_API */ KDTreeN
           return 0;
       }
 
-      if (IsBoundedN<QueryT, N>::value)
-      {
-        kClosestPairs<MetricT>(root, query, query_bounds, k_closest_pairs, dist_bound, get_closest_points,
-                               use_as_query_index_and_swap);
-      }
+      if (transformed_point)
+        kClosestPairsTransformedPoint<MetricT>(root, query_pt, query_pt_os, k_closest_pairs, dist_bound, get_closest_points,
+                                               use_as_query_index_and_swap);
       else
-      {
-        kClosestPairs<MetricT>(root, query, query, k_closest_pairs, dist_bound, get_closest_points,
+        kClosestPairs<MetricT>(root, query, query_proxy, k_closest_pairs, dist_bound, get_closest_points,
                                use_as_query_index_and_swap);
+
+      return k_closest_pairs.size();
+    }
+
+    /**
+     * Get the k elements approximately closest to a query object. The tree is searched in best-bin-first order: leaves are
+     * visited in increasing order of their distance from the query, and the search stops when no unvisited leaf can improve
+     * the current neighbors by more than a factor of (1 + \a epsilon), or when \a max_leaves leaves have been visited. In the
+     * former case, the distance of the i'th returned neighbor is at most (1 + \a epsilon) times the distance of the true i'th
+     * nearest neighbor. An epsilon of zero and no leaf limit gives exact results. The parameters are otherwise as for
+     * kClosestPairs().
+     *
+     * @param query Query object. BoundedTraitsN<QueryT, N, ScalarT> must be defined.
+     * @param k_closest_pairs The k (or fewer) approximate nearest neighbors are placed here.
+     * @param epsilon Non-negative relative error bound on the distance of each returned neighbor.
+     * @param max_leaves Maximum number of leaves to visit. Ignored if non-positive. Visiting a few dozen leaves is usually
+     *   sufficient for high recall even in high dimensions, where exact search degenerates to a linear scan.
+     * @param dist_bound Upper bound on the distance between any pair of points considered. Ignored if negative.
+     * @param get_closest_points If true, the coordinates of the closest pair of points on each pair of neighboring elements is
+     *   computed and stored in the returned pairs.
+     *
+     * @return The number of neighbors found (i.e. the size of \a k_closest_pairs).
+     */
+    template <typename MetricT, typename QueryT, typename BoundedNeighborPairSetT>
+    long approxKClosestPairs(QueryT const & query, BoundedNeighborPairSetT & k_closest_pairs, double epsilon,
+                             long max_leaves = -1, double dist_bound = -1, bool get_closest_points = false) const
+    {
+      KDTreeN const * tree = this;
+      return approxKClosestPairs<MetricT>(1, &tree, query, k_closest_pairs, epsilon, max_leaves, dist_bound,
+                                          get_closest_points);
+    }
+
+    /**
+     * Get the k elements approximately closest to a query object, searching several trees at once. The trees must all have
+     * been built on the same sequence of elements (with different splits, see setRandomizedSplits()), so that they assign the
+     * same index to each element. The leaves of all the trees are visited in a single best-bin-first order, and
+     * \a max_leaves bounds the total number of leaves visited. The other parameters are as for the single-tree version of
+     * approxKClosestPairs().
+     */
+    template <typename MetricT, typename QueryT, typename BoundedNeighborPairSetT>
+    static long approxKClosestPairs(long num_trees, KDTreeN const * const * trees, QueryT const & query,
+                                    BoundedNeighborPairSetT & k_closest_pairs, double epsilon, long max_leaves = -1,
+                                    double dist_bound = -1, bool get_closest_points = false)
+    {
+      alwaysAssertM(epsilon >= 0, "KDTreeN: Approximation error bound must be non-negative");
+
+      k_closest_pairs.clear();
+
+      THEA_QUERY_STATS_ADD(PROXIMITY_QUERIES, 1);
+
+      AxisAlignedBoxT query_bounds;
+      getObjectBounds(query, query_bounds);
+
+      typedef KDTreeNInternal::QueryProxy<QueryT, N, ScalarT> QueryProxyT;
+      typename QueryProxyT::type const & query_proxy = QueryProxyT::get(query, query_bounds);
+
+      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+      double error_scale = 1 + epsilon;
+
+      std::priority_queue< SearchBin, TheaArray<SearchBin>, std::greater<SearchBin> > bins;
+      for (long i = 0; i < num_trees; ++i)
+        if (trees[i]->root)
+        {
+          double mad = trees[i]->template nodeDistance<MetricT>(*trees[i]->root, query_proxy);
+          if (mon_approx_dist_bound < 0 || mad <= mon_approx_dist_bound)
+            bins.push(SearchBin(mad, trees[i], trees[i]->root));
+        }
+
+      long num_leaves = 0;
+      while (!bins.empty())
+      {
+        SearchBin bin = bins.top();
+        bins.pop();
+
+        // All remaining bins are at least as far away as this one
+        if (!k_closest_pairs.isInsertable(NeighborPair(0, 0, scaleMonotoneApprox<MetricT>(bin.mon_approx_dist, error_scale))))
+          break;
+
+        // Descend to the nearest leaf under the bin, queueing the farther child at each level
+        KDTreeN const * tree = bin.tree;
+        Node const * node = bin.node;
+        while (node && node->lo)
+        {
+          THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
+
+          Node const * n[2] = { node->lo, node->hi };
+          double d[2] = { tree->template nodeDistance<MetricT>(*n[0], query_proxy),
+                          tree->template nodeDistance<MetricT>(*n[1], query_proxy) };
+
+          if (d[1] < d[0])
+          {
+            std::swap(n[0], n[1]);
+            std::swap(d[0], d[1]);
+          }
+
+          if ((mon_approx_dist_bound < 0 || d[1] <= mon_approx_dist_bound)
+           && k_closest_pairs.isInsertable(NeighborPair(0, 0, scaleMonotoneApprox<MetricT>(d[1], error_scale))))
+            bins.push(SearchBin(d[1], tree, n[1]));
+          else
+            THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+
+          if ((mon_approx_dist_bound < 0 || d[0] <= mon_approx_dist_bound)
+           && k_closest_pairs.isInsertable(NeighborPair(0, 0, scaleMonotoneApprox<MetricT>(d[0], error_scale))))
+            node = n[0];
+          else
+          {
+            THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+            node = NULL;
+          }
+        }
+
+        if (!node)
+          continue;
+
+        THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
+
+        tree->template kClosestPairsLeaf<MetricT>(node, query, k_closest_pairs, dist_bound, get_closest_points, -1);
+
+        if (max_leaves > 0 && ++num_leaves >= max_leaves)
+          break;
       }
 
       return k_closest_pairs.size();
     }
 
+    /**
+     * Get an element approximately closest to a query object, whose distance is at most (1 + \a epsilon) times the distance
+     * of the closest element, unless the search is cut short after \a max_leaves leaves. See approxKClosestPairs() for details.
+     *
+     * @return A non-negative handle to the element found, if any, else a negative number.
+     */
+    template <typename MetricT, typename QueryT>
+    long approxClosestElement(QueryT const & query, double epsilon, long max_leaves = -1, double dist_bound = -1,
+                              double * dist = NULL, VectorT * closest_point = NULL) const
+    {
+      BoundedSortedArrayN<1, NeighborPair> nbr;
+      approxKClosestPairs<MetricT>(query, nbr, epsilon, max_leaves, dist_bound, closest_point != NULL);
+      if (nbr.isEmpty())
+        return -1;
+
+      if (dist) *dist = MetricT::invertMonotoneApprox(nbr[0].getMonotoneApproxDistance());
+      if (closest_point) *closest_point = nbr[0].getTargetPoint();
+
+      return nbr[0].getTargetIndex();
+    }
+
+    /**
+     * For each element of a query kd-tree, get the k elements of this tree closest to it (all-k-nearest-neighbors). Both trees
+     * are traversed simultaneously, and a pair of nodes is pruned as soon as it is further apart than the k'th neighbor found so
+     * far for every query element in the query node. This is much faster than calling kClosestPairs() separately for each
+     * query element.
+     *
+     * @param query Query kd-tree.
+     * @param k Number of neighbors to find for each query element.
+     * @param k_closest_pairs Resized to the number of elements in the query tree. On return, the i'th entry contains the k (or
+     *   fewer) elements of this tree nearest to the i'th query element, in order of increasing distance. Entries for query
+     *   elements rejected by the filters of the query tree are empty.
+     * @param dist_bound Upper bound on the distance between any pair of points considered. Ignored if negative.
+     * @param get_closest_points If true, the coordinates of the closest pair of points on each pair of neighboring elements is
+     *   computed and stored in the returned pairs.
+     *
+     * @return The number of query elements for which at least one neighbor was found.
+     */
+    template <typename MetricT, typename E, typename A>
+    long allKClosestPairs(KDTreeN<E, N, ScalarT, A> const & query, long k,
+                          TheaArray< BoundedSortedArray<NeighborPair> > & k_closest_pairs, double dist_bound = -1,
+                          bool get_closest_points = false) const
+    {
+      alwaysAssertM(k > 0, "KDTreeN: Number of nearest neighbors must be positive");
+
+      THEA_QUERY_STATS_ADD(PROXIMITY_QUERIES, query.numElements());
+
+      k_closest_pairs.resize((array_size_t)query.numElements());
+      for (array_size_t i = 0; i < k_closest_pairs.size(); ++i)
+        k_closest_pairs[i].setCapacity((int)k);
+
+      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+      AllKClosestPairsState<MetricT, E, A> state(query, k_closest_pairs, mon_approx_dist_bound, get_closest_points);
+      dualTreeTraverse<MetricT>(query, state, mon_approx_dist_bound);
+
+      long num_found = 0;
+      for (array_size_t i = 0; i < k_closest_pairs.size(); ++i)
+        if (!k_closest_pairs[i].isEmpty())
+          num_found++;
+
+      return num_found;
+    }
+
+    /**
+     * Get the Hausdorff distance between a query kd-tree and this tree. The directed distance from the query to this tree is the
+     * largest distance from any query element to its nearest neighbor in this tree. It is computed by simultaneous traversal of
+     * both trees, as in allKClosestPairs(), without storing the neighbors themselves.
+     *
+     * @param query Query kd-tree.
+     * @param symmetric If true, the larger of the directed distances in both directions (the classical symmetric Hausdorff
+     *   distance) is returned. Else only the directed distance from the query to this tree is computed.
+     *
+     * @return The Hausdorff distance, or a negative number if some query element has no neighbor (e.g. because this tree is
+     *   empty).
+     */
+    template <typename MetricT, typename E, typename A>
+    double hausdorffDistance(KDTreeN<E, N, ScalarT, A> const & query, bool symmetric = false) const
+    {
+      THEA_QUERY_STATS_ADD(PROXIMITY_QUERIES, query.numElements());
+
+      TheaArray<double> nn_mad((array_size_t)query.numElements(), -1);
+      NearestNeighborDistanceState<MetricT, E, A> state(query, nn_mad);
+      dualTreeTraverse<MetricT>(query, state, -1);
+
+      double max_mad = 0;
+      for (array_size_t i = 0; i < nn_mad.size(); ++i)
+      {
+        if (query.isRemoved((long)i) || !query.elementPassesFilters(query.elems[i]))
+          continue;
+
+        if (nn_mad[i] < 0)
+          return -1;
+
+        if (nn_mad[i] > max_mad)
+          max_mad = nn_mad[i];
+      }
+
+      double result = MetricT::invertMonotoneApprox(max_mad);
+      if (symmetric)
+      {
+        double reverse = query.template hausdorffDistance<MetricT>(*this, false);
+        if (reverse < 0)
+          return -1;
+
+        result = std::max(result, reverse);
+      }
+
+      return result;
+    }
+
     /**
      * Get all objects intersecting a range.
      *
@@ -1015,32 +1331,53 @@ class /* THEA_API */ KDTreeN
 
     template <typename RayIntersectionTesterT> bool rayIntersects(RayT const & ray, Real max_time = -1) const
     {
-      return rayIntersectionTime<RayIntersectionTesterT>(ray, max_time) >= 0;
-    }
+      THEA_QUERY_STATS_ADD(RAY_QUERIES, 1);
 
-    template <typename RayIntersectionTesterT> Real rayIntersectionTime(RayT const & ray, Real max_time = -1) const
-    {
       if (root)
       {
         if (TransformableBaseT::hasTransform())
         {
           RayT tr_ray = toObjectSpace(ray);
           if (root->bounds.rayIntersects(tr_ray, max_time))
-            return rayIntersectionTime<RayIntersectionTesterT>(root, tr_ray, max_time);
+            return rayIntersects<RayIntersectionTesterT>(root, tr_ray, max_time);
         }
         else
         {
           if (root->bounds.rayIntersects(ray, max_time))
-            return rayIntersectionTime<RayIntersectionTesterT>(root, ray, max_time);
+            return rayIntersects<RayIntersectionTesterT>(root, ray, max_time);
         }
       }
 
-      return -1;
+      return false;
+    }
+
+    template <typename RayIntersectionTesterT> Real rayIntersectionTime(RayT const & ray, Real max_time = -1) const
+    {
+      THEA_QUERY_STATS_ADD(RAY_QUERIES, 1);
+
+      if (root)
+      {
+        if (TransformableBaseT::hasTransform())
+        {
+          RayT tr_ray = toObjectSpace(ray);
+          if (root->bounds.rayIntersects(tr_ray, max_time))
+            return rayIntersectionTime<RayIntersectionTesterT>(root, tr_ray, max_time);
+        }
+        else
+        {
+          if (root->bounds.rayIntersects(ray, max_time))
+            return rayIntersectionTime<RayIntersectionTesterT>(root, ray, max_time);
+        }
+      }
+
+      return -1;
     }
 
     template <typename RayIntersectionTesterT>
     RayStructureIntersectionT rayStructureIntersection(RayT const & ray, Real max_time = -1) const
     {
+      THEA_QUERY_STATS_ADD(RAY_QUERIES, 1);
+
       if (root)
       {
         if (TransformableBaseT::hasTransform())
@@ -1087,9 +1424,156 @@ class /* THEA_API */ KDTreeN
     // Allow the comparator unrestricted access to the kd-tree.
     friend struct ObjectLess;
 
+    /** Comparator for sorting axes in decreasing order of the extent of a box along them. */
+    struct AxisLonger
+    {
+      VectorT const & ext;
+
+      /** Constructor. */
+      AxisLonger(VectorT const & ext_) : ext(ext_) {}
+
+      /** Check if axis \a a is longer than axis \a b. */
+      bool operator()(long a, long b) const { return ext[a] > ext[b]; }
+    };
+
+    // Allow kd-trees on other types of elements to access this tree during simultaneous traversals.
+    template <typename E, long M, typename S, typename A> friend class KDTreeN;
+
     typedef TheaArray<Filter<T> *> FilterStack;  ///< A stack of element filters.
     typedef TheaArray<SampleFilter> SampleFilterStack;  ///< A stack of point sample filters.
 
+    /** A node awaiting a visit in a best-bin-first search, with a lower bound on its distance from the query. */
+    struct SearchBin
+    {
+      double mon_approx_dist;
+      KDTreeN const * tree;
+      Node const * node;
+
+      /** Constructor. */
+      SearchBin(double mon_approx_dist_, KDTreeN const * tree_, Node const * node_)
+      : mon_approx_dist(mon_approx_dist_), tree(tree_), node(node_) {}
+
+      /** Compare bins by distance, for ordering the priority queue. */
+      bool operator>(SearchBin const & other) const { return mon_approx_dist > other.mon_approx_dist; }
+    };
+
+    /** Get a lower bound on the distance (as a monotone approximation) between a node and a query proxy, in world space. */
+    template <typename MetricT, typename ProxyT> double nodeDistance(Node const & node, ProxyT const & query_proxy) const
+    {
+      if (TransformableBaseT::hasTransform())
+        return MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(node), query_proxy);
+      else
+        return MetricT::template monotoneApproxDistance<N, ScalarT>(node.bounds, query_proxy);
+    }
+
+    /**
+     * Build the tree on all elements that have not been removed, discarding any previous tree structure (but not the elements
+     * themselves). The arguments are as for init().
+     */
+    void build(long max_depth_, long max_elems_in_leaf_, bool save_memory, bool deallocate_previous_memory)
+    {
+      clearAccelerationStructure(deallocate_previous_memory);
+      node_pool.clear(deallocate_previous_memory);
+      index_pool.clear(deallocate_previous_memory);
+      root = NULL;
+      num_nodes = 0;
+      num_node_indices = 0;
+      num_indices_at_build = 0;
+      free_nodes.clear();
+      invalidateBounds();
+
+      static long const DEFAULT_MAX_ELEMS_IN_LEAF = 10;
+      max_elems_in_leaf = max_elems_in_leaf_ < 0 ? DEFAULT_MAX_ELEMS_IN_LEAF : max_elems_in_leaf_;
+      auto_max_depth = (max_depth_ < 0);
+      memory_saving_mode = save_memory;
+
+      long num_live_elems = num_elems - num_removed_elems;
+      num_elems_at_build = num_live_elems;
+      if (num_live_elems <= 0)
+        return;
+
+      // The fraction of elements held by the larger node at each split is 0.5
+      static double const SPLIT_FRACTION = 0.5;
+      long est_depth = Math::binaryTreeDepth(num_live_elems, max_elems_in_leaf, SPLIT_FRACTION);
+      max_depth = max_depth_;
+      if (max_depth < 0)
+        max_depth = est_depth;
+      else if (max_depth < est_depth)
+        est_depth = max_depth;
+
+      // THEA_CONSOLE << "KDTreeN: max_depth = " << max_depth << ", est_depth = " << est_depth;
+
+      // Each index is stored at most once at each level
+      array_size_t BUFFER_SAFETY_MARGIN = 10;
+      array_size_t index_buffer_capacity = num_live_elems + BUFFER_SAFETY_MARGIN;
+      if (!save_memory)
+        index_buffer_capacity *= (array_size_t)(1 + est_depth);  // reserve space for all levels at once
+
+      // The pool must be able to hold the indices of all elements in a single allocation, for the root
+      if (deallocate_previous_memory || index_buffer_capacity > 1.3 * index_pool.getBufferCapacity()
+       || num_live_elems + BUFFER_SAFETY_MARGIN > index_pool.getBufferCapacity())
+      {
+        // THEA_CONSOLE << "KDTreeN: Resizing index pool: old buffer capacity = " << index_pool.getBufferCapacity()
+        //              << ", new buffer capacity = " << index_buffer_capacity;
+        index_pool.init(index_buffer_capacity);
+      }
+
+      // Assume a complete, balanced binary tree upto the estimated depth to guess the number of leaf nodes
+      array_size_t node_buffer_capacity = (array_size_t)(1 << est_depth) + BUFFER_SAFETY_MARGIN;
+      if (deallocate_previous_memory || node_buffer_capacity > 1.3 * node_pool.getBufferCapacity())
+      {
+        // THEA_CONSOLE << "KDTreeN: Resizing node pool: old buffer capacity = " << node_pool.getBufferCapacity()
+        //              << ", new buffer capacity = " << node_buffer_capacity;
+        node_pool.init(node_buffer_capacity);
+      }
+
+      // Create the root node
+      root = allocNode(0);
+
+      // THEA_CONSOLE << "Allocated root " << root << " from mempool " << &node_pool;
+
+      root->num_elems = root->elems_capacity = root->subtree_size = (array_size_t)num_live_elems;
+      root->elems = index_pool.alloc(root->num_elems);
+
+      AxisAlignedBoxT elem_bounds;
+      array_size_t num_added = 0;
+      for (array_size_t i = 0; i < (array_size_t)num_elems; ++i)
+      {
+        if (isRemoved((long)i))
+          continue;
+
+        root->elems[num_added++] = i;
+
+        BoundedTraitsT::getBounds(elems[i], elem_bounds);
+        root->bounds.merge(elem_bounds);
+      }
+
+      // Expand the bounding box slightly to handle numerical error
+      root->bounds.scaleCentered(BOUNDS_EXPANSION_FACTOR);
+
+      if (save_memory)
+      {
+        // Estimate the maximum number of indices that will need to be held in the scratch pool at any time during depth-first
+        // traversal with earliest-possible deallocation. This is
+        //
+        //      #elements * (sum of series 1 + 1 + SPLIT_FRACTION + SPLIT_FRACTION^2 + ... + SPLIT_FRACTION^(est_depth - 1))
+        //  <=  #elements * (1 + 1 / (1 - SPLIT_FRACTION))
+        //
+        array_size_t est_max_path_indices = (array_size_t)(num_live_elems * (1 + 1 / (1 - SPLIT_FRACTION)));
+        // THEA_CONSOLE << "KDTreeN: Estimated maximum number of indices on a single path = " << est_max_path_indices;
+
+        // Create a temporary pool for scratch storage
+        IndexPool tmp_index_pool;
+        tmp_index_pool.init(est_max_path_indices + BUFFER_SAFETY_MARGIN);
+
+        createTree(root, true, &tmp_index_pool, &index_pool);
+      }
+      else
+        createTree(root, false, &index_pool, NULL);
+
+      num_indices_at_build = index_pool.numAllocated();
+    }
+
     void moveIndicesToLeafPool(Node * leaf, IndexPool * main_index_pool, IndexPool * leaf_index_pool)
     {
       if (leaf)
@@ -1097,10 +1581,22 @@ class /* THEA_API */ KDTreeN
         ElementIndex * leaf_indices_start = leaf_index_pool->alloc(leaf->num_elems);
         std::memcpy(leaf_indices_start, leaf->elems, leaf->num_elems * sizeof(ElementIndex));
         leaf->elems = leaf_indices_start;
+        leaf->elems_capacity = leaf->num_elems;
         main_index_pool->free(leaf->num_elems);
       }
     }
 
+    /** Pick one of the longest axes of a box, with extent \a ext, at random (see setRandomizedSplits()). */
+    long randomLongAxis(VectorT const & ext) const
+    {
+      long axes[N];
+      for (long i = 0; i < N; ++i)
+        axes[i] = i;
+
+      std::partial_sort(axes, axes + num_split_candidates, axes + N, AxisLonger(ext));
+      return axes[Random::common().integer(0, (int32)num_split_candidates - 1)];
+    }
+
     /** Recursively construct the tree. */
     void createTree(Node * start, bool save_memory, IndexPool * main_index_pool, IndexPool * leaf_index_pool)
     {
@@ -1121,7 +1617,8 @@ class /* THEA_API */ KDTreeN
       // Find a splitting plane
 #define THEA_KDTREEN_SPLIT_LONGEST
 #ifdef THEA_KDTREEN_SPLIT_LONGEST
-      long coord = start->bounds.getExtent().maxAxis();  // split longest dimension
+      long coord = (num_split_candidates > 1 ? randomLongAxis(start->bounds.getExtent())
+                                             : start->bounds.getExtent().maxAxis());  // split longest dimension
 #else
       long coord = (long)(start->depth % N);  // cycle between dimensions
 #endif
@@ -1131,19 +1628,16 @@ class /* THEA_API */ KDTreeN
       std::nth_element(start->elems, start->elems + mid, start->elems + start->num_elems, ObjectLess(coord, this));
 
       // Create child nodes
-      start->lo = node_pool.alloc(1);
-      start->lo->init(start->depth + 1);
-      num_nodes++;
-
-      start->hi = node_pool.alloc(1);
-      start->hi->init(start->depth + 1);
-      num_nodes++;
+      start->lo = allocNode(start->depth + 1);
+      start->hi = allocNode(start->depth + 1);
 
       // THEA_CONSOLE << "num_nodes = " << num_nodes;
 
       // Allocate element arrays for the children
       start->lo->elems = main_index_pool->alloc(start->num_elems - mid);
+      start->lo->elems_capacity = start->lo->subtree_size = start->num_elems - mid;
       start->hi->elems = main_index_pool->alloc(mid);
+      start->hi->elems_capacity = start->hi->subtree_size = mid;
 
       // Add first half of array (elems less than median) to low child
       AxisAlignedBoxT elem_bounds;
@@ -1200,294 +1694,1458 @@ class /* THEA_API */ KDTreeN
       {
         main_index_pool->free(start->num_elems);
         start->num_elems = 0;
+        start->elems_capacity = 0;
         start->elems = NULL;
       }
     }
 
-    /** Mark that the bounding box requires an update. */
-    void invalidateBounds()
+    /** Add the element with a given index, already stored in the element array, to the tree. */
+    void attachElement(ElementIndex index)
     {
-      valid_bounds = false;
+      // The element array may have been reallocated, and the acceleration structure holds pointers into it
+      clearAccelerationStructure(false);
+      invalidateBounds();
+
+      // Build from scratch if the tree is empty, or if a single node might not fit in the index pool any longer
+      if (!root || num_elems - num_removed_elems >= (long)index_pool.getBufferCapacity())
+      {
+        build(auto_max_depth ? -1 : max_depth, max_elems_in_leaf > 0 ? max_elems_in_leaf : -1, memory_saving_mode, false);
+        return;
+      }
+
+      AxisAlignedBoxT elem_bounds;
+      BoundedTraitsT::getBounds(elems[index], elem_bounds);
+
+      Node * scapegoat = attachElement(root, index, elem_bounds);
+      if (scapegoat)
+        rebuildSubtree(scapegoat);
     }
 
-    /** Recompute the bounding box if it has been invalidated. */
-    void updateBounds() const
+    /** Remove the element with a given index from the tree, without marking it as removed. */
+    void detachElement(ElementIndex index)
     {
-      if (valid_bounds) return;
+      clearAccelerationStructure(false);
+      invalidateBounds();
 
-      if (root)
+      if (!root)
+        return;
+
+      AxisAlignedBoxT elem_bounds;
+      BoundedTraitsT::getBounds(elems[index], elem_bounds);
+
+      Node * scapegoat = NULL;
+      if (detachElement(root, index, elem_bounds, &scapegoat) && scapegoat)
+        rebuildSubtree(scapegoat);
+    }
+
+    /**
+     * Rebuild the tree from scratch if the index pool has grown to more than twice its size after the last full build. Leaf
+     * arrays grown by insertions, and the index arrays of split leaves, inner nodes and rebuilt subtrees, are abandoned in the
+     * pool, which cannot free individual arrays. This must only be called when the tree is consistent with the element array.
+     */
+    void reclaimIndexPool()
+    {
+      // Don't rebuild a tiny tree too often as it grows
+      static array_size_t const MIN_RECLAIM_SIZE = 1024;
+
+      if (root && index_pool.numAllocated() > std::max(2 * num_indices_at_build, MIN_RECLAIM_SIZE))
+        build(auto_max_depth ? -1 : max_depth, max_elems_in_leaf, memory_saving_mode, false);
+    }
+
+    /** Allocate a new node, reusing the memory and index of a node discarded by a partial rebuild if possible. */
+    Node * allocNode(long depth)
+    {
+      Node * node;
+      if (free_nodes.empty())
       {
-        bounds = TransformableBaseT::hasTransform()
-               ? root->bounds.transformAndBound(TransformableBaseT::getTransform())
-               : root->bounds;
+        node = node_pool.alloc(1);
+        node->init(depth, num_node_indices++);
       }
       else
       {
-        bounds = AxisAlignedBoxT();
+        node = free_nodes.back();
+        free_nodes.pop_back();
+        node->init(depth, node->index);
       }
 
-      valid_bounds = true;
+      num_nodes++;
+      return node;
     }
 
-    /** Check if an element passes all filters currently on the stack. */
-    bool elementPassesFilters(T const & elem) const
+    /** Check if the subtree rooted at a node is unbalanced enough to be rebuilt. */
+    bool isUnbalanced(Node const * node) const
     {
-      if (filters.empty()) return true;  // early exit
+      // A child holding more than this fraction of the elements of its parent triggers a rebuild of the parent (each child of a
+      // freshly built node holds half the elements)
+      static double const MAX_CHILD_FRACTION = 0.75;
 
-      for (typename FilterStack::const_iterator fi = filters.begin(); fi != filters.end(); ++fi)
-        if (!(*fi)->allows(elem))
-          return false;
+      if (!node->lo || (long)node->subtree_size < 4 * max_elems_in_leaf)
+        return false;
 
-      return true;
+      return std::max(node->lo->subtree_size, node->hi->subtree_size) > MAX_CHILD_FRACTION * node->subtree_size;
     }
 
-    /** Get the bounding box for an object, if it is bounded. */
-    template <typename U>
-    static void getObjectBounds(U const & u, AxisAlignedBoxT & bounds,
-                                typename boost::enable_if< IsBoundedN<U, N> >::type * dummy = NULL)
+    /** Recompute the bounding box of a node from its children, or from its elements if it is a leaf. */
+    void refitBounds(Node * node)
     {
-      BoundedTraitsN<U, N, ScalarT>::getBounds(u, bounds);
-    }
+      node->bounds = AxisAlignedBoxT();
 
-    /** A dummy function that is a no-op for unbounded objects. */
-    template <typename U>
-    static void getObjectBounds(U const & u, AxisAlignedBoxT & bounds,
-                                typename boost::disable_if< IsBoundedN<U, N> >::type * dummy = NULL) {}
+      if (node->lo)
+      {
+        node->bounds.merge(node->lo->bounds);
+        node->bounds.merge(node->hi->bounds);
+      }
+      else
+      {
+        AxisAlignedBoxT elem_bounds;
+        for (array_size_t i = 0; i < node->num_elems; ++i)
+        {
+          BoundedTraitsT::getBounds(elems[node->elems[i]], elem_bounds);
+          node->bounds.merge(elem_bounds);
+        }
 
-    /** Get a bounding box for a node, in world space. */
-    AxisAlignedBoxT getBoundsWorldSpace(Node const & node) const
+        node->bounds.scaleCentered(BOUNDS_EXPANSION_FACTOR);
+      }
+    }
+
+    /**
+     * Drop the element indices stored at an inner node, which become stale when an element is added to or removed from its
+     * subtree. All elements of the subtree can still be found at its leaves.
+     */
+    static void clearInnerIndices(Node * node)
     {
-      return TransformableBaseT::hasTransform()
-           ? node.bounds.transformAndBound(TransformableBaseT::getTransform())
-           : node.bounds;
+      if (node->lo)
+      {
+        node->num_elems = 0;
+        node->elems_capacity = 0;
+        node->elems = NULL;
+      }
     }
 
     /**
-     * Recursively look for the closest pair of points between two elements. Only pairs separated by less than the current
-     * minimum distance will be considered.
+     * Add the element with a given index to a subtree, splitting the receiving leaf if it overflows.
+     *
+     * @return The highest node on the insertion path that is unbalanced after the insertion, or null if there is none.
      */
-    template <typename MetricT, typename QueryT, typename ProxyT>
-    void closestPair(Node const * start, QueryT const & query, ProxyT const & query_proxy, NeighborPair & pair,
-                     bool get_closest_points) const
+    Node * attachElement(Node * node, ElementIndex index, AxisAlignedBoxT const & elem_bounds)
     {
-      if (!start->lo)  // leaf
-        closestPairLeaf<MetricT>(start, query, pair, get_closest_points);
-      else  // not leaf
+      if (!node->lo)  // leaf
       {
-        // Figure out which child is closer (optimize for point queries?)
-        Node const * n[2] = { start->lo, start->hi };
-        double mad[2] = { MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[0]), query_proxy),
-                          MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[1]), query_proxy) };
+        if (node->num_elems >= node->elems_capacity)
+        {
+          // Grow the index array (the old one is reclaimed when the tree is next rebuilt from scratch, see reclaimIndexPool())
+          array_size_t new_capacity = std::max(2 * node->elems_capacity, (array_size_t)max_elems_in_leaf + 1);
+          if (new_capacity > index_pool.getBufferCapacity())
+            new_capacity = node->num_elems + 1;
+
+          ElementIndex * new_elems = index_pool.alloc(new_capacity);
+          if (node->num_elems > 0)
+            std::memcpy(new_elems, node->elems, node->num_elems * sizeof(ElementIndex));
+
+          node->elems = new_elems;
+          node->elems_capacity = new_capacity;
+        }
 
-        if (mad[1] > mad[0])
+        node->elems[node->num_elems++] = index;
+        node->subtree_size++;
+        node->bounds.merge(elem_bounds);
+
+        if ((long)node->num_elems > max_elems_in_leaf)
         {
-          std::swap(n[0], n[1]);
-          std::swap(mad[0], mad[1]);
+          if (auto_max_depth && node->depth >= max_depth)
+            max_depth = std::max(max_depth, (long)Math::binaryTreeDepth(num_elems - num_removed_elems, max_elems_in_leaf));
+
+          if (node->depth < max_depth)
+          {
+            createTree(node, false, &index_pool, NULL);
+            if (memory_saving_mode)
+              clearInnerIndices(node);
+          }
         }
 
-        for (int i = 0; i < 2; ++i)
-          if (pair.getMonotoneApproxDistance() < 0 || mad[i] <= pair.getMonotoneApproxDistance())
-            closestPair<MetricT>(n[i], query, query_proxy, pair, get_closest_points);
-      }
+        return NULL;
+      }
+
+      // Descend into the child that contains the element, or else the child closest to it
+      VectorT center = elem_bounds.getCenter();
+      Node * child;
+      bool in_lo = node->lo->bounds.contains(center), in_hi = node->hi->bounds.contains(center);
+      if (in_lo != in_hi)
+        child = (in_lo ? node->lo : node->hi);
+      else if (in_lo)
+        child = (node->lo->subtree_size <= node->hi->subtree_size ? node->lo : node->hi);
+      else
+        child = (node->lo->bounds.squaredDistance(center) <= node->hi->bounds.squaredDistance(center) ? node->lo : node->hi);
+
+      Node * scapegoat = attachElement(child, index, elem_bounds);
+
+      node->subtree_size++;
+      node->bounds.merge(elem_bounds);
+      clearInnerIndices(node);
+
+      return isUnbalanced(node) ? node : scapegoat;
+    }
+
+    /**
+     * Remove the element with a given index, and bounding box \a elem_bounds, from a subtree. The bounding boxes of the nodes
+     * on the path to the element's leaf are refit bottom-up.
+     *
+     * @param scapegoat Set to the highest node on the path that is unbalanced after the removal, if there is one.
+     *
+     * @return True if the element was found in the subtree, else false.
+     */
+    bool detachElement(Node * node, ElementIndex index, AxisAlignedBoxT const & elem_bounds, Node ** scapegoat)
+    {
+      if (!node->bounds.intersects(elem_bounds))
+        return false;
+
+      if (!node->lo)  // leaf
+      {
+        for (array_size_t i = 0; i < node->num_elems; ++i)
+          if (node->elems[i] == index)
+          {
+            node->elems[i] = node->elems[--node->num_elems];
+            node->subtree_size--;
+            refitBounds(node);
+            return true;
+          }
+
+        return false;
+      }
+
+      if (!detachElement(node->lo, index, elem_bounds, scapegoat) && !detachElement(node->hi, index, elem_bounds, scapegoat))
+        return false;
+
+      node->subtree_size--;
+      refitBounds(node);
+      clearInnerIndices(node);
+
+      if (isUnbalanced(node))
+        *scapegoat = node;
+
+      return true;
+    }
+
+    /** Move all element indices in a subtree to an array, and put the nodes of the subtree (except its root) on the free list. */
+    void collectAndFreeSubtree(Node * node, TheaArray<ElementIndex> & indices)
+    {
+      if (node->lo)
+      {
+        collectAndFreeSubtree(node->lo, indices);
+        collectAndFreeSubtree(node->hi, indices);
+
+        free_nodes.push_back(node->lo);
+        free_nodes.push_back(node->hi);
+        num_nodes -= 2;
+      }
+      else
+        indices.insert(indices.end(), node->elems, node->elems + node->num_elems);
+    }
+
+    /** Rebuild the subtree rooted at a node to restore balance. */
+    void rebuildSubtree(Node * node)
+    {
+      if (node == root || node->subtree_size > index_pool.getBufferCapacity())
+      {
+        // Rebuilding the entire tree also reclaims all unused memory
+        build(auto_max_depth ? -1 : max_depth, max_elems_in_leaf, memory_saving_mode, false);
+        return;
+      }
+
+      TheaArray<ElementIndex> indices;
+      indices.reserve(node->subtree_size);
+      collectAndFreeSubtree(node, indices);
+
+      node->lo = node->hi = NULL;
+      node->num_elems = node->elems_capacity = node->subtree_size = indices.size();
+      node->elems = index_pool.alloc(node->num_elems);
+      if (!indices.empty())
+        std::memcpy(node->elems, &indices[0], indices.size() * sizeof(ElementIndex));
+
+      refitBounds(node);
+      createTree(node, false, &index_pool, NULL);
+      if (memory_saving_mode)
+        clearInnerIndices(node);
+    }
+
+    /** Mark that the bounding box requires an update. */
+    void invalidateBounds()
+    {
+      valid_bounds = false;
+    }
+
+    /** Recompute the bounding box if it has been invalidated. */
+    void updateBounds() const
+    {
+      if (valid_bounds) return;
+
+      bounds = (root ? getBoundsWorldSpace(*root) : AxisAlignedBoxT());
+
+      valid_bounds = true;
+    }
+
+    /** Check if an element passes all filters currently on the stack. */
+    bool elementPassesFilters(T const & elem) const
+    {
+      if (filters.empty()) return true;  // early exit
+
+      for (typename FilterStack::const_iterator fi = filters.begin(); fi != filters.end(); ++fi)
+        if (!(*fi)->allows(elem))
+          return false;
+
+      return true;
+    }
+
+    /** Get the bounding box for an object, if it is bounded. */
+    template <typename U>
+    static void getObjectBounds(U const & u, AxisAlignedBoxT & bounds,
+                                typename boost::enable_if< IsBoundedN<U, N> >::type * dummy = NULL)
+    {
+      BoundedTraitsN<U, N, ScalarT>::getBounds(u, bounds);
+    }
+
+    /** A dummy function that is a no-op for unbounded objects. */
+    template <typename U>
+    static void getObjectBounds(U const & u, AxisAlignedBoxT & bounds,
+                                typename boost::disable_if< IsBoundedN<U, N> >::type * dummy = NULL) {}
+
+    /** Get a bounding box for a node, in world space. */
+    AxisAlignedBoxT getBoundsWorldSpace(Node const & node) const
+    {
+      if (!TransformableBaseT::hasTransform())
+        return node.bounds;
+
+      // Transform the center of the box, and bound the transformed half-extents using the absolute values of the linear part
+      // of the transform. This is equivalent to, but much cheaper than, transforming and bounding all 2^N corners.
+      VectorT center = TransformableBaseT::getTransform() * node.bounds.getCenter();
+      VectorT half_ext = transform_abs_linear * (node.bounds.getExtent() / 2);
+      return AxisAlignedBoxT(center - half_ext, center + half_ext);
+    }
+
+    /**
+     * Cache the inverse of the current transform, and the factors by which it scales distances, so that point queries can be
+     * answered in object space.
+     */
+    void cacheTransformProperties()
+    {
+      typedef MatrixMN<N, N, ScalarT> MatrixT;
+
+      Transform const & tr = TransformableBaseT::getTransform();
+      inv_transform = tr.inverse();
+
+      for (long i = 0; i < N; ++i)
+        for (long j = 0; j < N; ++j)
+          transform_abs_linear(i, j) = std::fabs(tr.getLinear()(i, j));
+
+      // The transform is a similarity (scaled rigid transform) iff L^T L is a multiple of the identity, where L is its linear
+      // part
+      static double const SIMILARITY_TOLERANCE = 1.0e-5;
+      MatrixT ltl = tr.getLinear().transpose() * tr.getLinear();
+      double sqr_scale = 0;
+      for (long i = 0; i < N; ++i)
+        sqr_scale += ltl(i, i);
+
+      sqr_scale /= N;
+      bool is_similarity = (sqr_scale > 0);
+      for (long i = 0; is_similarity && i < N; ++i)
+        for (long j = 0; j < N; ++j)
+          if (std::fabs(ltl(i, j) - (i == j ? sqr_scale : 0)) > SIMILARITY_TOLERANCE * sqr_scale)
+          {
+            is_similarity = false;
+            break;
+          }
+
+      if (is_similarity)
+      {
+        transform_uniform_scale = std::sqrt(sqr_scale);
+        if (std::fabs(transform_uniform_scale - 1) < SIMILARITY_TOLERANCE)
+          transform_uniform_scale = 1;  // rigid, distances are unchanged
+
+        transform_min_scale = transform_uniform_scale;
+      }
+      else
+      {
+        // The smallest factor by which the transform can shrink a distance is the smallest singular value of L, which is the
+        // reciprocal of the spectral norm of L^-1. The latter is bounded above by both the Frobenius norm and the geometric
+        // mean of the largest absolute row and column sums, which are much cheaper to compute than an SVD.
+        MatrixT const & inv_linear = inv_transform.getLinear();
+        double sqr_frobenius = 0, max_row_sum = 0, max_col_sum = 0;
+        for (long i = 0; i < N; ++i)
+        {
+          double row_sum = 0, col_sum = 0;
+          for (long j = 0; j < N; ++j)
+          {
+            sqr_frobenius += inv_linear(i, j) * inv_linear(i, j);
+            row_sum += std::fabs(inv_linear(i, j));
+            col_sum += std::fabs(inv_linear(j, i));
+          }
+
+          max_row_sum = std::max(max_row_sum, row_sum);
+          max_col_sum = std::max(max_col_sum, col_sum);
+        }
+
+        double inv_norm_bound = std::sqrt(std::min(sqr_frobenius, max_row_sum * max_col_sum));
+        transform_uniform_scale = -1;
+        transform_min_scale = (inv_norm_bound > 0 ? 1.0 / inv_norm_bound : 0);
+      }
+    }
+
+    /** Multiply a distance, represented by its monotone approximation, by a non-negative factor. */
+    template <typename MetricT> static double scaleMonotoneApprox(double mon_approx_dist, double scale)
+    {
+      return (scale == 1 || mon_approx_dist <= 0)
+           ? mon_approx_dist
+           : MetricT::computeMonotoneApprox(scale * MetricT::invertMonotoneApprox(mon_approx_dist));
+    }
+
+    /** Get the position of a query object if it is a point. Returns true on success. */
+    template <typename QueryT>
+    static bool getQueryPoint(QueryT const & query, VectorT & p,
+                              typename boost::enable_if< IsNonReferencedPointN<QueryT, N> >::type * dummy = NULL)
+    {
+      p = PointTraitsN<QueryT, N, ScalarT>::getPosition(query);
+      return true;
+    }
+
+    /** Returns false since the query object is not a point. */
+    template <typename QueryT>
+    static bool getQueryPoint(QueryT const & query, VectorT & p,
+                              typename boost::disable_if< IsNonReferencedPointN<QueryT, N> >::type * dummy = NULL)
+    {
+      return false;
+    }
+
+    /**
+     * Get a lower bound on the world-space distance (as a monotone approximation) between a node and a query point, given the
+     * position of the latter in both world and object space. The bound is exact if the transform is a similarity. Else, the
+     * larger of two bounds is returned: the object-space distance scaled by the smallest stretch of the transform, and the
+     * distance to the world-space bounding box of the node.
+     */
+    template <typename MetricT>
+    double transformedNodeDistance(Node const & node, VectorT const & query_pt, VectorT const & query_pt_os) const
+    {
+      double d = scaleMonotoneApprox<MetricT>(MetricT::template monotoneApproxDistance<N, ScalarT>(node.bounds, query_pt_os),
+                                              transform_min_scale);
+      if (transform_uniform_scale > 0)
+        return d;
+
+      return std::max(d, (double)MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(node), query_pt));
+    }
+
+    /**
+     * Get the world-space distance (as a monotone approximation) between an element and a query point, as well as the closest
+     * pair of points on them, given the position of the query point in both world and object space. If the transform is a
+     * similarity, the distance is computed in object space and scaled, else the element is transformed to world space.
+     */
+    template <typename MetricT>
+    double transformedPointClosestPoints(Element const & elem, VectorT const & query_pt, VectorT const & query_pt_os,
+                                         bool get_closest_points, VectorT & tp, VectorT & qp) const
+    {
+      if (transform_uniform_scale > 0)
+      {
+        double mad = MetricT::template closestPoints<N, ScalarT>(elem, query_pt_os, tp, qp);
+        if (get_closest_points)
+        {
+          tp = TransformableBaseT::getTransform() * tp;
+          qp = query_pt;
+        }
+
+        return scaleMonotoneApprox<MetricT>(mad, transform_uniform_scale);
+      }
+      else
+        return MetricT::template closestPoints<N, ScalarT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
+                                                           query_pt, tp, qp);
+    }
+
+    /**
+     * Recursively look for the element closest to a query point, when the tree has a transform. The traversal is carried out
+     * in object space, using the query point mapped to object space by the inverse transform.
+     */
+    template <typename MetricT>
+    void closestPairTransformedPoint(Node const * start, VectorT const & query_pt, VectorT const & query_pt_os,
+                                     NeighborPair & pair, bool get_closest_points) const
+    {
+      THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
+
+      if (!start->lo)  // leaf
+      {
+        THEA_QUERY_STATS_ADD(LEAVES_VISITED, 1);
+        THEA_QUERY_STATS_ADD(ELEMENTS_TESTED, (int64)start->num_elems);
+
+        VectorT qp, tp;
+        for (array_size_t i = 0; i < start->num_elems; ++i)
+        {
+          ElementIndex index = start->elems[i];
+          Element const & elem = elems[index];
+
+          if (!elementPassesFilters(elem))
+            continue;
+
+          double mad = transformedPointClosestPoints<MetricT>(elem, query_pt, query_pt_os, get_closest_points, tp, qp);
+          if (pair.getMonotoneApproxDistance() < 0 || mad <= pair.getMonotoneApproxDistance())
+            pair = NeighborPair(0, (long)index, mad, qp, tp);
+        }
+      }
+      else  // not leaf
+      {
+        Node const * n[2] = { start->lo, start->hi };
+        double mad[2] = { transformedNodeDistance<MetricT>(*n[0], query_pt, query_pt_os),
+                          transformedNodeDistance<MetricT>(*n[1], query_pt, query_pt_os) };
+
+        if (mad[1] < mad[0])
+        {
+          std::swap(n[0], n[1]);
+          std::swap(mad[0], mad[1]);
+        }
+
+        for (int i = 0; i < 2; ++i)
+          if (pair.getMonotoneApproxDistance() < 0 || mad[i] <= pair.getMonotoneApproxDistance())
+            closestPairTransformedPoint<MetricT>(n[i], query_pt, query_pt_os, pair, get_closest_points);
+          else
+            THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+      }
+    }
+
+    /**
+     * Recursively look for the k elements closest to a query point, when the tree has a transform. The traversal is carried
+     * out in object space, using the query point mapped to object space by the inverse transform.
+     */
+    template <typename MetricT, typename BoundedNeighborPairSet>
+    void kClosestPairsTransformedPoint(Node const * start, VectorT const & query_pt, VectorT const & query_pt_os,
+                                       BoundedNeighborPairSet & k_closest_pairs, double dist_bound, bool get_closest_points,
+                                       long use_as_query_index_and_swap) const
+    {
+      THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
+
+      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+
+      if (!start->lo)  // leaf
+      {
+        THEA_QUERY_STATS_ADD(LEAVES_VISITED, 1);
+        THEA_QUERY_STATS_ADD(ELEMENTS_TESTED, (int64)start->num_elems);
+
+        std::equal_to<NeighborPair> eq_comp;
+        VectorT qp, tp;
+
+        for (array_size_t i = 0; i < start->num_elems; ++i)
+        {
+          ElementIndex index = start->elems[i];
+          Element const & elem = elems[index];
+
+          if (!elementPassesFilters(elem))
+            continue;
+
+          // Check if the element is already in the set of neighbors or not
+          NeighborPair pair = (use_as_query_index_and_swap >= 0 ? NeighborPair((long)index, use_as_query_index_and_swap)
+                                                                : NeighborPair(0, (long)index));
+          if (k_closest_pairs.contains(pair, eq_comp))  // already found
+            continue;
+
+          double mad = transformedPointClosestPoints<MetricT>(elem, query_pt, query_pt_os, get_closest_points, tp, qp);
+          if (mon_approx_dist_bound < 0 || mad <= mon_approx_dist_bound)
+          {
+            pair.setMonotoneApproxDistance(mad);
+
+            if (get_closest_points)
+            {
+              if (use_as_query_index_and_swap >= 0)
+              {
+                pair.setQueryPoint(tp);
+                pair.setTargetPoint(qp);
+              }
+              else
+              {
+                pair.setQueryPoint(qp);
+                pair.setTargetPoint(tp);
+              }
+            }
+
+            k_closest_pairs.insert(pair);
+          }
+        }
+      }
+      else  // not leaf
+      {
+        Node const * n[2] = { start->lo, start->hi };
+        double d[2] = { transformedNodeDistance<MetricT>(*n[0], query_pt, query_pt_os),
+                        transformedNodeDistance<MetricT>(*n[1], query_pt, query_pt_os) };
+
+        if (d[1] < d[0])
+        {
+          std::swap(n[0], n[1]);
+          std::swap(d[0], d[1]);
+        }
+
+        for (int i = 0; i < 2; ++i)
+          if ((mon_approx_dist_bound < 0 || d[i] <= mon_approx_dist_bound)
+            && k_closest_pairs.isInsertable(NeighborPair(0, 0, d[i])))
+          {
+            kClosestPairsTransformedPoint<MetricT>(n[i], query_pt, query_pt_os, k_closest_pairs, dist_bound,
+                                                   get_closest_points, use_as_query_index_and_swap);
+          }
+          else
+            THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+      }
+    }
+
+    /**
+     * Recursively look for the closest pair of points between two elements. Only pairs separated by less than the current
+     * minimum distance will be considered.
+     */
+    template <typename MetricT, typename QueryT, typename ProxyT>
+    void closestPair(Node const * start, QueryT const & query, ProxyT const & query_proxy, NeighborPair & pair,
+                     bool get_closest_points) const
+    {
+      THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
+
+      if (!start->lo)  // leaf
+        closestPairLeaf<MetricT>(start, query, pair, get_closest_points);
+      else  // not leaf
+      {
+        // Figure out which child is closer (optimize for point queries?)
+        Node const * n[2] = { start->lo, start->hi };
+        double mad[2] = { MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[0]), query_proxy),
+                          MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[1]), query_proxy) };
+
+        if (mad[1] < mad[0])
+        {
+          std::swap(n[0], n[1]);
+          std::swap(mad[0], mad[1]);
+        }
+
+        for (int i = 0; i < 2; ++i)
+          if (pair.getMonotoneApproxDistance() < 0 || mad[i] <= pair.getMonotoneApproxDistance())
+            closestPair<MetricT>(n[i], query, query_proxy, pair, get_closest_points);
+          else
+            THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+      }
+    }
+
+    /**
+     * Search the elements in a leaf node for the one closest to another element, when the latter is a proximity query
+     * structure.
+     */
+    template <typename MetricT, typename QueryT>
+    void closestPairLeaf(
+      Node const * leaf,
+      QueryT const & query,
+      NeighborPair & pair,
+      bool get_closest_points,
+      typename boost::enable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    {
+      THEA_QUERY_STATS_ADD(LEAVES_VISITED, 1);
+      THEA_QUERY_STATS_ADD(ELEMENTS_TESTED, (int64)leaf->num_elems);
+
+      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      {
+        ElementIndex index = leaf->elems[i];
+        Element const & elem = elems[index];
+
+        if (!elementPassesFilters(elem))
+          continue;
+
+        NeighborPair swapped;
+        if (TransformableBaseT::hasTransform())
+          swapped = query.template closestPair<MetricT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
+                                                        pair.getMonotoneApproxDistance(), get_closest_points);
+        else
+          swapped = query.template closestPair<MetricT>(elem, pair.getMonotoneApproxDistance(), get_closest_points);
+
+        if (swapped.isValid())
+        {
+          pair = swapped.swapped();
+          pair.setTargetIndex((long)index);
+        }
+      }
+    }
+
+    /**
+     * Search the elements in a leaf node for the one closest to another element, when the latter is NOT a proximity query
+     * structure.
+     */
+    template <typename MetricT, typename QueryT>
+    void closestPairLeaf(
+      Node const * leaf,
+      QueryT const & query,
+      NeighborPair & pair,
+      bool get_closest_points,
+      typename boost::disable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    {
+      THEA_QUERY_STATS_ADD(LEAVES_VISITED, 1);
+      THEA_QUERY_STATS_ADD(ELEMENTS_TESTED, (int64)leaf->num_elems);
+
+      VectorT qp, tp;
+      double mad;
+
+      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      {
+        ElementIndex index = leaf->elems[i];
+        Element const & elem = elems[index];
+
+        if (!elementPassesFilters(elem))
+          continue;
+
+        if (TransformableBaseT::hasTransform())
+          mad = MetricT::template closestPoints<N, ScalarT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
+                                                            query, tp, qp);
+        else
+          mad = MetricT::template closestPoints<N, ScalarT>(elem, query, tp, qp);
+
+        if (pair.getMonotoneApproxDistance() < 0 || mad <= pair.getMonotoneApproxDistance())
+          pair = NeighborPair(0, (long)index, mad, qp, tp);
+      }
+    }
+
+    /**
+     * Recursively look for the k closest elements to a query object. Only elements at less than the specified maximum distance
+     * will be considered.
+     */
+    template <typename MetricT, typename QueryT, typename ProxyT, typename BoundedNeighborPairSet>
+    void kClosestPairs(Node const * start, QueryT const & query, ProxyT const & query_proxy,
+                       BoundedNeighborPairSet & k_closest_pairs, double dist_bound, bool get_closest_points,
+                       long use_as_query_index_and_swap)
+    const
+    {
+      THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
+
+      if (!start->lo)  // leaf
+        kClosestPairsLeaf<MetricT>(start, query, k_closest_pairs, dist_bound, get_closest_points, use_as_query_index_and_swap);
+      else  // not leaf
+      {
+        // Figure out which child is closer (optimize for point queries?)
+        Node const * n[2] = { start->lo, start->hi };
+        double d[2] = { MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[0]), query_proxy),
+                        MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[1]), query_proxy) };
+
+        if (d[1] < d[0])
+        {
+          std::swap(n[0], n[1]);
+          std::swap(d[0], d[1]);
+        }
+
+        double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+
+        for (int i = 0; i < 2; ++i)
+          if ((mon_approx_dist_bound < 0 || d[i] <= mon_approx_dist_bound)
+            && k_closest_pairs.isInsertable(NeighborPair(0, 0, d[i])))
+          {
+            kClosestPairs<MetricT>(n[i], query, query_proxy, k_closest_pairs, dist_bound, get_closest_points,
+                                   use_as_query_index_and_swap);
+          }
+          else
+            THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+      }
+    }
+
+    /**
+     * Search the elements in a leaf node for the k nearest neighbors of an object, when the latter is a proximity query
+     * structure of compatible type.
+     */
+    template <typename MetricT, typename QueryT, typename BoundedNeighborPairSet>
+    void kClosestPairsLeaf(
+      Node const * leaf,
+      QueryT const & query,
+      BoundedNeighborPairSet & k_closest_pairs,
+      double dist_bound,
+      bool get_closest_points,
+      long use_as_query_index_and_swap,
+      typename boost::enable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    {
+      THEA_QUERY_STATS_ADD(LEAVES_VISITED, 1);
+      THEA_QUERY_STATS_ADD(ELEMENTS_TESTED, (int64)leaf->num_elems);
+
+      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      {
+        ElementIndex index = leaf->elems[i];
+        Element const & elem = elems[index];
+
+        if (!elementPassesFilters(elem))
+          continue;
+
+        if (TransformableBaseT::hasTransform())
+          query.template kClosestPairs<MetricT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
+                                                                      k_closest_pairs, dist_bound, get_closest_points, false,
+                                                                      (long)index);
+        else
+          query.template kClosestPairs<MetricT>(elem, k_closest_pairs, dist_bound, get_closest_points, false, (long)index);
+      }
+    }
+
+    /**
+     * Search the elements in a leaf node for the one closest to another element, when the latter is NOT a proximity query
+     * structure.
+     */
+    template <typename MetricT, typename QueryT, typename BoundedNeighborPairSet>
+    void kClosestPairsLeaf(
+      Node const * leaf,
+      QueryT const & query,
+      BoundedNeighborPairSet & k_closest_pairs,
+      double dist_bound,
+      bool get_closest_points,
+      long use_as_query_index_and_swap,
+      typename boost::disable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    {
+      THEA_QUERY_STATS_ADD(LEAVES_VISITED, 1);
+      THEA_QUERY_STATS_ADD(ELEMENTS_TESTED, (int64)leaf->num_elems);
+
+      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+
+      std::equal_to<NeighborPair> eq_comp;
+      VectorT qp, tp;
+      double mad;
+
+      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      {
+        ElementIndex index = leaf->elems[i];
+        Element const & elem = elems[index];
+
+        if (!elementPassesFilters(elem))
+          continue;
+
+        // Check if the element is already in the set of neighbors or not
+        NeighborPair pair = (use_as_query_index_and_swap >= 0 ? NeighborPair((long)index, use_as_query_index_and_swap)
+                                                              : NeighborPair(0, (long)index));
+        if (k_closest_pairs.contains(pair, eq_comp))  // already found
+          continue;
+
+        if (TransformableBaseT::hasTransform())
+          mad = MetricT::template closestPoints<N, ScalarT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
+                                                            query, tp, qp);
+        else
+          mad = MetricT::template closestPoints<N, ScalarT>(elem, query, tp, qp);
+
+        if (mon_approx_dist_bound < 0 || mad <= mon_approx_dist_bound)
+        {
+          pair.setMonotoneApproxDistance(mad);
+
+          if (get_closest_points)
+          {
+            if (use_as_query_index_and_swap >= 0)
+            {
+              pair.setQueryPoint(tp);
+              pair.setTargetPoint(qp);
+            }
+            else
+            {
+              pair.setQueryPoint(qp);
+              pair.setTargetPoint(tp);
+            }
+          }
+
+          k_closest_pairs.insert(pair);
+        }
+      }
+    }
+
+    /** Get the closest pair of elements between this tree and a query object that is not a kd-tree. */
+    template <typename MetricT, typename QueryT>
+    NeighborPair closestPairImpl(QueryT const & query, void const * dummy, double dist_bound, bool get_closest_points) const
+    {
+      THEA_QUERY_STATS_ADD(PROXIMITY_QUERIES, 1);
+
+      AxisAlignedBoxT query_bounds;
+      getObjectBounds(query, query_bounds);
+
+      typedef KDTreeNInternal::QueryProxy<QueryT, N, ScalarT> QueryProxyT;
+      typename QueryProxyT::type const & query_proxy = QueryProxyT::get(query, query_bounds);
+
+      // If the tree is transformed and the query is a point, map the query to object space once instead of mapping every node
+      // to world space
+      VectorT query_pt, query_pt_os;
+      bool transformed_point = (TransformableBaseT::hasTransform() && getQueryPoint(query, query_pt));
+      if (transformed_point)
+        query_pt_os = inv_transform * query_pt;
+
+      // Early pruning if the entire structure is too far away from the query
+      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+      if (mon_approx_dist_bound >= 0)
+      {
+        double lower_bound = transformed_point
+                           ? transformedNodeDistance<MetricT>(*root, query_pt, query_pt_os)
+                           : MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*root), query_proxy);
+        if (lower_bound > mon_approx_dist_bound)
+          return NeighborPair(-1);
+      }
+
+      // If acceleration is enabled, set an upper limit to the distance to the nearest object
+      double accel_bound = accelerationBound<MetricT>(query, dist_bound);
+      if (accel_bound >= 0)
+      {
+        THEA_QUERY_STATS_ADD(ACCELERATION_HITS, 1);
+
+        double fudge = 0.001 * getBoundsWorldSpace(*root).getExtent().fastLength();
+        mon_approx_dist_bound = MetricT::computeMonotoneApprox(accel_bound + fudge);
+      }
+
+      NeighborPair pair(-1, -1, mon_approx_dist_bound);
+      if (transformed_point)
+        closestPairTransformedPoint<MetricT>(root, query_pt, query_pt_os, pair, get_closest_points);
+      else
+        closestPair<MetricT>(root, query, query_proxy, pair, get_closest_points);
+
+      return pair;
+    }
+
+    /** Get the closest pair of elements between this tree and a query kd-tree, by simultaneously traversing both trees. */
+    template <typename MetricT, typename QueryT, typename E, typename A>
+    NeighborPair closestPairImpl(QueryT const & query, KDTreeN<E, N, ScalarT, A> const * query_tree, double dist_bound,
+                                 bool get_closest_points) const
+    {
+      if (!query_tree->getRoot()) return NeighborPair(-1);
+
+      THEA_QUERY_STATS_ADD(PROXIMITY_QUERIES, 1);
+
+      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+
+      // If acceleration is enabled, set an upper limit to the distance to the nearest object
+      double accel_bound = accelerationBound<MetricT>(*query_tree, dist_bound);
+      if (accel_bound >= 0)
+      {
+        THEA_QUERY_STATS_ADD(ACCELERATION_HITS, 1);
+
+        double fudge = 0.001 * getBoundsWorldSpace(*root).getExtent().fastLength();
+        mon_approx_dist_bound = MetricT::computeMonotoneApprox(accel_bound + fudge);
+      }
+
+      NeighborPair pair(-1, -1, mon_approx_dist_bound);
+      ClosestPairState<E, A> state(pair, get_closest_points);
+      dualTreeTraverse<MetricT>(*query_tree, state, mon_approx_dist_bound);
+
+      return pair;
+    }
+
+    /**
+     * Bounds on the distances from the elements of each node of a query kd-tree to their current neighbors, used by traversal
+     * states that track separate results for each query element. For each node, two quantities are cached: the largest and
+     * the smallest bound of any element in the node. If every element of a node lies within distance D of every other, then
+     * no element can have a bound greater than the smallest bound plus D, which is often much tighter than the largest bound
+     * when the node is large. A negative value means there is no bound.
+     */
+    template <typename MetricT, typename QueryTreeT>
+    class QueryNodeBounds
+    {
+      public:
+        typedef typename QueryTreeT::Node QueryNode;
+
+        /** Constructor. */
+        QueryNodeBounds(QueryTreeT const & query_)
+        : query(query_), max_bounds((array_size_t)query_.numNodeIndices(), -1),
+          min_bounds((array_size_t)query_.numNodeIndices(), -1)
+        {}
+
+        /** Get the bound for an internal node, which can be no larger than the bound inherited from its parent. */
+        double get(QueryNode const * qnode, double inherited_bound) const
+        {
+          array_size_t index = (array_size_t)qnode->getIndex();
+          return tighten(qnode, minBound(max_bounds[index], inherited_bound), min_bounds[index]);
+        }
+
+        /** Set the bound for a leaf, given the largest and smallest bounds of its elements, and return it. */
+        double setLeaf(QueryNode const * qleaf, double max_bound, double min_bound)
+        {
+          array_size_t index = (array_size_t)qleaf->getIndex();
+          max_bounds[index] = max_bound;
+          min_bounds[index] = min_bound;
+          return tighten(qleaf, max_bound, min_bound);
+        }
+
+        /** Set the bound for an internal node, given the bounds of its children, and return it. */
+        double set(QueryNode const * qnode, double lo_bound, double hi_bound)
+        {
+          array_size_t index = (array_size_t)qnode->getIndex();
+          max_bounds[index] = (lo_bound < 0 || hi_bound < 0) ? -1 : std::max(lo_bound, hi_bound);
+          min_bounds[index] = minBound(min_bounds[(array_size_t)qnode->getLowChild()->getIndex()],
+                                       min_bounds[(array_size_t)qnode->getHighChild()->getIndex()]);
+          return tighten(qnode, max_bounds[index], min_bounds[index]);
+        }
+
+      private:
+        /** Get the smaller of two bounds, where negative values indicate no bound. */
+        static double minBound(double a, double b)
+        {
+          if (a < 0) return b;
+          if (b < 0) return a;
+          return std::min(a, b);
+        }
+
+        /** Tighten the bound of a node using the smallest bound of any of its elements and the diameter of the node. */
+        double tighten(QueryNode const * qnode, double max_bound, double min_bound) const
+        {
+          if (min_bound < 0)
+            return max_bound;
+
+          AxisAlignedBoxT qbounds = query.getBoundsWorldSpace(*qnode);
+          double diameter = (qbounds.getHigh() - qbounds.getLow()).length();
+          double b = MetricT::computeMonotoneApprox(MetricT::invertMonotoneApprox(min_bound) + diameter);
+
+          return minBound(max_bound, b);
+        }
+
+        QueryTreeT const & query;
+        TheaArray<double> max_bounds;
+        TheaArray<double> min_bounds;
+
+    }; // class QueryNodeBounds
+
+    /**
+     * Traversal state for finding the closest pair of elements between a query kd-tree and this tree. All query nodes share a
+     * single bound, the separation of the closest pair found so far.
+     */
+    template <typename E, typename A>
+    class ClosestPairState
+    {
+      public:
+        typedef typename KDTreeN<E, N, ScalarT, A>::Node QueryNode;
+
+        /** Constructor. */
+        ClosestPairState(NeighborPair & pair_, bool get_closest_points_)
+        : pair(pair_), get_closest_points(get_closest_points_) {}
+
+        /** Get the bound for a query node, given the bound inherited from its parent. */
+        double bound(QueryNode const * qnode, double inherited_bound) const { return pair.getMonotoneApproxDistance(); }
+
+        /** Get the bound for a query node, given the bounds returned by its children. */
+        double combineBounds(QueryNode const * qnode, double lo_bound, double hi_bound) const
+        { return pair.getMonotoneApproxDistance(); }
+
+        /** Get the bound for a single query element. */
+        double elementBound(long query_index) const { return pair.getMonotoneApproxDistance(); }
+
+        /** Consider a pair of elements as a possible result. */
+        void addPair(long query_index, long target_index, double mad, VectorT const & query_point,
+                     VectorT const & target_point)
+        {
+          if (pair.getMonotoneApproxDistance() < 0 || mad <= pair.getMonotoneApproxDistance())
+          {
+            if (get_closest_points)
+              pair = NeighborPair(query_index, target_index, mad, query_point, target_point);
+            else
+              pair = NeighborPair(query_index, target_index, mad);
+          }
+        }
+
+      private:
+        NeighborPair & pair;
+        bool get_closest_points;
+
+    }; // class ClosestPairState
+
+    /**
+     * Traversal state for finding the k nearest neighbors of every element of a query kd-tree. The bound for a query node is
+     * the largest distance to the k'th neighbor of any of its elements.
+     */
+    template <typename MetricT, typename E, typename A>
+    class AllKClosestPairsState
+    {
+      public:
+        typedef KDTreeN<E, N, ScalarT, A> QueryTree;
+        typedef typename QueryTree::Node QueryNode;
+
+        /** Constructor. */
+        AllKClosestPairsState(QueryTree const & query_, TheaArray< BoundedSortedArray<NeighborPair> > & k_closest_pairs_,
+                              double mon_approx_dist_bound_, bool get_closest_points_)
+        : query(query_), k_closest_pairs(k_closest_pairs_), mon_approx_dist_bound(mon_approx_dist_bound_),
+          get_closest_points(get_closest_points_), node_bounds(query_)
+        {}
+
+        /** Get the bound for a query node, given the bound inherited from its parent. */
+        double bound(QueryNode const * qnode, double inherited_bound)
+        {
+          if (!qnode->isLeaf())
+            return node_bounds.get(qnode, inherited_bound);
+
+          double max_mad = 0, min_mad = -1;
+          for (typename QueryNode::ElementIndexConstIterator ii = qnode->elementIndicesBegin(); ii != qnode->elementIndicesEnd();
+               ++ii)
+          {
+            if (!query.elementPassesFilters(query.elems[*ii]))
+              continue;
+
+            double mad = elementBound((long)*ii);
+            if (mad < 0)
+              max_mad = -1;
+            else
+            {
+              if (max_mad >= 0 && mad > max_mad) max_mad = mad;
+              if (min_mad < 0 || mad < min_mad) min_mad = mad;
+            }
+          }
+
+          return node_bounds.setLeaf(qnode, max_mad, min_mad);
+        }
+
+        /** Get the bound for a query node, given the bounds returned by its children. */
+        double combineBounds(QueryNode const * qnode, double lo_bound, double hi_bound)
+        {
+          return node_bounds.set(qnode, lo_bound, hi_bound);
+        }
+
+        /** Get the bound for a single query element. */
+        double elementBound(long query_index) const
+        {
+          BoundedSortedArray<NeighborPair> const & nbrs = k_closest_pairs[(array_size_t)query_index];
+          return nbrs.size() < nbrs.getCapacity() ? mon_approx_dist_bound : nbrs.last().getMonotoneApproxDistance();
+        }
+
+        /** Consider a pair of elements as a possible result. */
+        void addPair(long query_index, long target_index, double mad, VectorT const & query_point,
+                     VectorT const & target_point)
+        {
+          if (mon_approx_dist_bound >= 0 && mad > mon_approx_dist_bound)
+            return;
+
+          BoundedSortedArray<NeighborPair> & nbrs = k_closest_pairs[(array_size_t)query_index];
+          NeighborPair pair(query_index, target_index, mad);
+          if (nbrs.isInsertable(pair) && !nbrs.contains(pair, std::equal_to<NeighborPair>()))  // may be revisited after seeding
+          {
+            if (get_closest_points)
+            {
+              pair.setQueryPoint(query_point);
+              pair.setTargetPoint(target_point);
+            }
+
+            nbrs.insert(pair);
+          }
+        }
+
+      private:
+        QueryTree const & query;
+        TheaArray< BoundedSortedArray<NeighborPair> > & k_closest_pairs;
+        double mon_approx_dist_bound;
+        bool get_closest_points;
+        QueryNodeBounds<MetricT, QueryTree> node_bounds;
+
+    }; // class AllKClosestPairsState
+
+    /**
+     * Traversal state for finding the distance from every element of a query kd-tree to its nearest neighbor in this tree.
+     * Equivalent to AllKClosestPairsState with k = 1, but stores only the distances.
+     */
+    template <typename MetricT, typename E, typename A>
+    class NearestNeighborDistanceState
+    {
+      public:
+        typedef KDTreeN<E, N, ScalarT, A> QueryTree;
+        typedef typename QueryTree::Node QueryNode;
+
+        /** Constructor. */
+        NearestNeighborDistanceState(QueryTree const & query_, TheaArray<double> & nn_mad_)
+        : query(query_), nn_mad(nn_mad_), node_bounds(query_)
+        {}
+
+        /** Get the bound for a query node, given the bound inherited from its parent. */
+        double bound(QueryNode const * qnode, double inherited_bound)
+        {
+          if (!qnode->isLeaf())
+            return node_bounds.get(qnode, inherited_bound);
+
+          double max_mad = 0, min_mad = -1;
+          for (typename QueryNode::ElementIndexConstIterator ii = qnode->elementIndicesBegin(); ii != qnode->elementIndicesEnd();
+               ++ii)
+          {
+            if (!query.elementPassesFilters(query.elems[*ii]))
+              continue;
+
+            double mad = nn_mad[*ii];
+            if (mad < 0)
+              max_mad = -1;
+            else
+            {
+              if (max_mad >= 0 && mad > max_mad) max_mad = mad;
+              if (min_mad < 0 || mad < min_mad) min_mad = mad;
+            }
+          }
+
+          return node_bounds.setLeaf(qnode, max_mad, min_mad);
+        }
+
+        /** Get the bound for a query node, given the bounds returned by its children. */
+        double combineBounds(QueryNode const * qnode, double lo_bound, double hi_bound)
+        {
+          return node_bounds.set(qnode, lo_bound, hi_bound);
+        }
+
+        /** Get the bound for a single query element. */
+        double elementBound(long query_index) const { return nn_mad[(array_size_t)query_index]; }
+
+        /** Consider a pair of elements as a possible result. */
+        void addPair(long query_index, long target_index, double mad, VectorT const & query_point,
+                     VectorT const & target_point)
+        {
+          double & d = nn_mad[(array_size_t)query_index];
+          if (d < 0 || mad < d)
+            d = mad;
+        }
+
+      private:
+        QueryTree const & query;
+        TheaArray<double> & nn_mad;
+        QueryNodeBounds<MetricT, QueryTree> node_bounds;
+
+    }; // class NearestNeighborDistanceState
+
+    /**
+     * Simultaneously traverse a query kd-tree and this tree, starting from their roots. The traversal state (one of the
+     * *State classes above) accumulates the results and supplies the bounds used for pruning pairs of nodes.
+     */
+    template <typename MetricT, typename E, typename A, typename StateT>
+    void dualTreeTraverse(KDTreeN<E, N, ScalarT, A> const & query, StateT & state, double mon_approx_dist_bound) const
+    {
+      typename KDTreeN<E, N, ScalarT, A>::Node const * query_root = query.getRoot();
+      if (!root || !query_root) return;
+
+      dualTreeSeed<MetricT>(query, query_root, state);
+
+      double lower_bound = MetricT::template monotoneApproxDistance<N, ScalarT>(query.getBoundsWorldSpace(*query_root),
+                                                                                 getBoundsWorldSpace(*root));
+      dualTreeTraverse<MetricT>(query, query_root, root, lower_bound, state, mon_approx_dist_bound);
     }
 
     /**
-     * Search the elements in a leaf node for the one closest to another element, when the latter is a proximity query
-     * structure.
+     * Initialize the bounds of the elements of a query kd-tree before the dual traversal, by comparing each leaf of the query
+     * tree to the leaf of this tree nearest its center. Without this step, the depth-first traversal often pairs a query node
+     * with a distant target node before a nearby one, producing loose bounds that prune very little.
      */
-    template <typename MetricT, typename QueryT>
-    void closestPairLeaf(
-      Node const * leaf,
-      QueryT const & query,
-      NeighborPair & pair,
-      bool get_closest_points,
-      typename boost::enable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    template <typename MetricT, typename E, typename A, typename StateT>
+    void dualTreeSeed(KDTreeN<E, N, ScalarT, A> const & query, typename KDTreeN<E, N, ScalarT, A>::Node const * qnode,
+                      StateT & state) const
     {
-      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      if (!qnode->isLeaf())
       {
-        ElementIndex index = leaf->elems[i];
-        Element const & elem = elems[index];
+        dualTreeSeed<MetricT>(query, qnode->getLowChild(), state);
+        dualTreeSeed<MetricT>(query, qnode->getHighChild(), state);
+        return;
+      }
 
-        if (!elementPassesFilters(elem))
-          continue;
+      VectorT q_center = query.getBoundsWorldSpace(*qnode).getCenter();
+      Node const * tleaf = root;
+      while (!tleaf->isLeaf())
+      {
+        double d_lo = MetricT::template monotoneApproxDistance<N, ScalarT>(q_center, getBoundsWorldSpace(*tleaf->lo));
+        double d_hi = MetricT::template monotoneApproxDistance<N, ScalarT>(q_center, getBoundsWorldSpace(*tleaf->hi));
+        tleaf = (d_hi < d_lo ? tleaf->hi : tleaf->lo);
+      }
 
-        NeighborPair swapped;
-        if (TransformableBaseT::hasTransform())
-          swapped = query.template closestPair<MetricT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
-                                                        pair.getMonotoneApproxDistance(), get_closest_points);
-        else
-          swapped = query.template closestPair<MetricT>(elem, pair.getMonotoneApproxDistance(), get_closest_points);
+      VectorT qp, tp;
+      for (array_size_t i = 0; i < (array_size_t)qnode->numElementIndices(); ++i)
+      {
+        ElementIndex query_index = qnode->elementIndicesBegin()[i];
+        E const & query_elem = query.elems[query_index];
 
-        if (swapped.isValid())
+        if (!query.elementPassesFilters(query_elem))
+          continue;
+
+        for (array_size_t j = 0; j < tleaf->num_elems; ++j)
         {
-          pair = swapped.swapped();
-          pair.setTargetIndex((long)index);
+          ElementIndex target_index = tleaf->elems[j];
+          Element const & target_elem = elems[target_index];
+
+          if (!elementPassesFilters(target_elem))
+            continue;
+
+          double mad = elementClosestPoints<MetricT>(query, query_elem, target_elem, qp, tp);
+          state.addPair((long)query_index, (long)target_index, mad, qp, tp);
         }
       }
     }
 
     /**
-     * Search the elements in a leaf node for the one closest to another element, when the latter is NOT a proximity query
-     * structure.
+     * Recursively traverse a pair of nodes from a query kd-tree and this tree, given a lower bound on the separation of the
+     * nodes. The larger of the two nodes is split at each step, visiting the closer target child first when the target node is
+     * split. Once the query node is a leaf, each of its elements is searched for individually in the target subtree.
+     *
+     * @return The updated bound for the query node: a target element further away than this cannot affect the results for any
+     *   element in the query node. A negative value indicates there is no such bound.
      */
-    template <typename MetricT, typename QueryT>
-    void closestPairLeaf(
-      Node const * leaf,
-      QueryT const & query,
-      NeighborPair & pair,
-      bool get_closest_points,
-      typename boost::disable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    template <typename MetricT, typename E, typename A, typename StateT>
+    double dualTreeTraverse(KDTreeN<E, N, ScalarT, A> const & query, typename KDTreeN<E, N, ScalarT, A>::Node const * qnode,
+                            Node const * tnode, double lower_bound, StateT & state, double q_bound) const
     {
-      VectorT qp, tp;
-      double mad;
+      typedef typename KDTreeN<E, N, ScalarT, A>::Node QueryNode;
 
-      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      q_bound = state.bound(qnode, q_bound);
+      if (q_bound >= 0 && lower_bound > q_bound)
       {
-        ElementIndex index = leaf->elems[i];
-        Element const & elem = elems[index];
+        THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+        return q_bound;
+      }
 
-        if (!elementPassesFilters(elem))
-          continue;
+      THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
 
-        if (TransformableBaseT::hasTransform())
-          mad = MetricT::template closestPoints<N, ScalarT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
-                                                            query, tp, qp);
-        else
-          mad = MetricT::template closestPoints<N, ScalarT>(elem, query, tp, qp);
+      if (qnode->isLeaf())
+      {
+        dualTreeQueryLeaf<MetricT>(query, qnode, tnode, state);
+        return state.bound(qnode, q_bound);
+      }
 
-        if (pair.getMonotoneApproxDistance() < 0 || mad <= pair.getMonotoneApproxDistance())
-          pair = NeighborPair(0, (long)index, mad, qp, tp);
+      AxisAlignedBoxT q_bounds = query.getBoundsWorldSpace(*qnode);
+      AxisAlignedBoxT t_bounds = getBoundsWorldSpace(*tnode);
+
+      if (tnode->isLeaf() || (q_bounds.getHigh() - q_bounds.getLow()).squaredLength()
+                          >= (t_bounds.getHigh() - t_bounds.getLow()).squaredLength())
+      {
+        // Split the query node
+        QueryNode const * qlo = qnode->getLowChild();
+        QueryNode const * qhi = qnode->getHighChild();
+        double d_lo = MetricT::template monotoneApproxDistance<N, ScalarT>(query.getBoundsWorldSpace(*qlo), t_bounds);
+        double d_hi = MetricT::template monotoneApproxDistance<N, ScalarT>(query.getBoundsWorldSpace(*qhi), t_bounds);
+
+        double lo_bound = dualTreeTraverse<MetricT>(query, qlo, tnode, d_lo, state, q_bound);
+        double hi_bound = dualTreeTraverse<MetricT>(query, qhi, tnode, d_hi, state, q_bound);
+
+        return state.combineBounds(qnode, lo_bound, hi_bound);
+      }
+      else
+      {
+        // Split the target node, visiting the closer child first
+        AxisAlignedBoxT t_child_bounds[2] = { getBoundsWorldSpace(*tnode->lo), getBoundsWorldSpace(*tnode->hi) };
+        return dualTreeTraverseTargetChildren<MetricT>(query, qnode, q_bounds, tnode, t_child_bounds, state, q_bound);
       }
     }
 
     /**
-     * Recursively look for the k closest elements to a query object. Only elements at less than the specified maximum distance
-     * will be considered.
+     * Traverse the pairs formed by a query node and the children of a target node, visiting the closer child first. Helper
+     * function for dualTreeTraverse().
      */
-    template <typename MetricT, typename QueryT, typename ProxyT, typename BoundedNeighborPairSet>
-    void kClosestPairs(Node const * start, QueryT const & query, ProxyT const & query_proxy,
-                       BoundedNeighborPairSet & k_closest_pairs, double dist_bound, bool get_closest_points,
-                       long use_as_query_index_and_swap)
-    const
+    template <typename MetricT, typename E, typename A, typename StateT>
+    double dualTreeTraverseTargetChildren(KDTreeN<E, N, ScalarT, A> const & query,
+                                          typename KDTreeN<E, N, ScalarT, A>::Node const * qnode,
+                                          AxisAlignedBoxT const & q_bounds, Node const * tnode,
+                                          AxisAlignedBoxT const * t_child_bounds, StateT & state, double q_bound) const
     {
-      if (!start->lo)  // leaf
-        kClosestPairsLeaf<MetricT>(start, query, k_closest_pairs, dist_bound, get_closest_points, use_as_query_index_and_swap);
-      else  // not leaf
+      Node const * n[2] = { tnode->lo, tnode->hi };
+      double d[2] = { MetricT::template monotoneApproxDistance<N, ScalarT>(q_bounds, t_child_bounds[0]),
+                      MetricT::template monotoneApproxDistance<N, ScalarT>(q_bounds, t_child_bounds[1]) };
+
+      // If the query node overlaps both children (common near the top of the trees), the separations do not say which child is
+      // more likely to contain the neighbors, so fall back to comparing the separations of the box centers
+      bool swap_children = (d[1] < d[0]);
+      if (d[1] == d[0])
       {
-        // Figure out which child is closer (optimize for point queries?)
-        Node const * n[2] = { start->lo, start->hi };
-        double d[2] = { MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[0]), query_proxy),
-                        MetricT::template monotoneApproxDistance<N, ScalarT>(getBoundsWorldSpace(*n[1]), query_proxy) };
+        VectorT q_center = q_bounds.getCenter();
+        swap_children = ((t_child_bounds[1].getCenter() - q_center).squaredLength()
+                       < (t_child_bounds[0].getCenter() - q_center).squaredLength());
+      }
 
-        if (d[1] > d[0])
-        {
-          std::swap(n[0], n[1]);
-          std::swap(d[0], d[1]);
-        }
+      if (swap_children)
+      {
+        std::swap(n[0], n[1]);
+        std::swap(d[0], d[1]);
+      }
 
-        double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+      for (int i = 0; i < 2; ++i)
+        q_bound = dualTreeTraverse<MetricT>(query, qnode, n[i], d[i], state, q_bound);
 
-        for (int i = 0; i < 2; ++i)
-          if ((mon_approx_dist_bound < 0 || d[i] <= mon_approx_dist_bound)
-            && k_closest_pairs.isInsertable(NeighborPair(0, 0, d[i])))
-          {
-            kClosestPairs<MetricT>(n[i], query, query_proxy, k_closest_pairs, dist_bound, get_closest_points,
-                                   use_as_query_index_and_swap);
-          }
-      }
+      return q_bound;
     }
 
     /**
-     * Search the elements in a leaf node for the k nearest neighbors of an object, when the latter is a proximity query
-     * structure of compatible type.
+     * Search a subtree of this tree for the neighbors of each element of a leaf of a query kd-tree. The dual traversal has
+     * already localized the search to the subtree, so each element is now handled individually, visiting closer target nodes
+     * first and pruning with its own bound.
      */
-    template <typename MetricT, typename QueryT, typename BoundedNeighborPairSet>
-    void kClosestPairsLeaf(
-      Node const * leaf,
-      QueryT const & query,
-      BoundedNeighborPairSet & k_closest_pairs,
-      double dist_bound,
-      bool get_closest_points,
-      long use_as_query_index_and_swap,
-      typename boost::enable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    template <typename MetricT, typename E, typename A, typename StateT>
+    void dualTreeQueryLeaf(KDTreeN<E, N, ScalarT, A> const & query, typename KDTreeN<E, N, ScalarT, A>::Node const * qleaf,
+                           Node const * tnode, StateT & state) const
     {
-      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      AxisAlignedBoxT q_elem_bounds;
+
+      for (array_size_t i = 0; i < (array_size_t)qleaf->numElementIndices(); ++i)
       {
-        ElementIndex index = leaf->elems[i];
-        Element const & elem = elems[index];
+        ElementIndex query_index = qleaf->elementIndicesBegin()[i];
+        E const & query_elem = query.elems[query_index];
 
-        if (!elementPassesFilters(elem))
+        if (!query.elementPassesFilters(query_elem))
           continue;
 
-        if (TransformableBaseT::hasTransform())
-          query.template kClosestPairs<MetricT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
-                                                                      k_closest_pairs, dist_bound, get_closest_points, false,
-                                                                      (long)index);
-        else
-          query.template kClosestPairs<MetricT>(elem, k_closest_pairs, dist_bound, get_closest_points, false, (long)index);
+        BoundedTraitsN<E, N, ScalarT>::getBounds(query_elem, q_elem_bounds);
+        if (query.hasTransform())
+          q_elem_bounds = q_elem_bounds.transformAndBound(query.getTransform());
+
+        double d = MetricT::template monotoneApproxDistance<N, ScalarT>(q_elem_bounds, getBoundsWorldSpace(*tnode));
+        dualTreeQueryElement<MetricT>(query, (long)query_index, query_elem, q_elem_bounds, tnode, d, state);
       }
     }
 
-    /**
-     * Search the elements in a leaf node for the one closest to another element, when the latter is NOT a proximity query
-     * structure.
-     */
-    template <typename MetricT, typename QueryT, typename BoundedNeighborPairSet>
-    void kClosestPairsLeaf(
-      Node const * leaf,
-      QueryT const & query,
-      BoundedNeighborPairSet & k_closest_pairs,
-      double dist_bound,
-      bool get_closest_points,
-      long use_as_query_index_and_swap,
-      typename boost::disable_if<boost::is_base_of<ProximityQueryBaseT, QueryT>, void>::type * dummy = NULL) const
+    /** Search a subtree of this tree for the neighbors of a single element of a query kd-tree. */
+    template <typename MetricT, typename E, typename A, typename StateT>
+    void dualTreeQueryElement(KDTreeN<E, N, ScalarT, A> const & query, long query_index, E const & query_elem,
+                              AxisAlignedBoxT const & q_elem_bounds, Node const * tnode, double lower_bound,
+                              StateT & state) const
     {
-      double mon_approx_dist_bound = (dist_bound >= 0 ? MetricT::computeMonotoneApprox(dist_bound) : -1);
+      double elem_bound = state.elementBound(query_index);
+      if (elem_bound >= 0 && lower_bound > elem_bound)
+      {
+        THEA_QUERY_STATS_ADD(NODES_PRUNED, 1);
+        return;
+      }
 
-      std::equal_to<NeighborPair> eq_comp;
-      VectorT qp, tp;
-      double mad;
+      THEA_QUERY_STATS_ADD(NODES_VISITED, 1);
 
-      for (array_size_t i = 0; i < leaf->num_elems; ++i)
+      if (tnode->isLeaf())
       {
-        ElementIndex index = leaf->elems[i];
-        Element const & elem = elems[index];
+        THEA_QUERY_STATS_ADD(LEAVES_VISITED, 1);
 
-        if (!elementPassesFilters(elem))
-          continue;
+        VectorT qp, tp;
+        for (array_size_t j = 0; j < tnode->num_elems; ++j)
+        {
+          ElementIndex target_index = tnode->elems[j];
+          Element const & target_elem = elems[target_index];
 
-        // Check if the element is already in the set of neighbors or not
-        NeighborPair pair = (use_as_query_index_and_swap >= 0 ? NeighborPair((long)index, use_as_query_index_and_swap)
-                                                              : NeighborPair(0, (long)index));
-        if (k_closest_pairs.contains(pair, eq_comp))  // already found
-          continue;
+          if (!elementPassesFilters(target_elem))
+            continue;
 
-        if (TransformableBaseT::hasTransform())
-          mad = MetricT::template closestPoints<N, ScalarT>(makeTransformedObject(&elem, &TransformableBaseT::getTransform()),
-                                                            query, tp, qp);
-        else
-          mad = MetricT::template closestPoints<N, ScalarT>(elem, query, tp, qp);
+          double mad = elementClosestPoints<MetricT>(query, query_elem, target_elem, qp, tp);
+          state.addPair(query_index, (long)target_index, mad, qp, tp);
+        }
+      }
+      else
+      {
+        Node const * n[2] = { tnode->lo, tnode->hi };
+        double d[2] = { MetricT::template monotoneApproxDistance<N, ScalarT>(q_elem_bounds, getBoundsWorldSpace(*n[0])),
+                        MetricT::template monotoneApproxDistance<N, ScalarT>(q_elem_bounds, getBoundsWorldSpace(*n[1])) };
 
-        if (mon_approx_dist_bound < 0 || mad <= mon_approx_dist_bound)
+        if (d[1] < d[0])
         {
-          pair.setMonotoneApproxDistance(mad);
+          std::swap(n[0], n[1]);
+          std::swap(d[0], d[1]);
+        }
 
-          if (get_closest_points)
-          {
-            if (use_as_query_index_and_swap >= 0)
-            {
-              pair.setQueryPoint(tp);
-              pair.setTargetPoint(qp);
-            }
-            else
-            {
-              pair.setQueryPoint(qp);
-              pair.setTargetPoint(tp);
-            }
-          }
+        for (int i = 0; i < 2; ++i)
+          dualTreeQueryElement<MetricT>(query, query_index, query_elem, q_elem_bounds, n[i], d[i], state);
+      }
+    }
 
-          k_closest_pairs.insert(pair);
-        }
+    /**
+     * Find the closest pair of points between an element of a query kd-tree and an element of this tree, taking the transforms
+     * of both trees into account.
+     *
+     * @return The monotone approximation to the distance between the elements.
+     */
+    template <typename MetricT, typename E, typename A>
+    double elementClosestPoints(KDTreeN<E, N, ScalarT, A> const & query, E const & query_elem, T const & target_elem,
+                                VectorT & query_point, VectorT & target_point) const
+    {
+      THEA_QUERY_STATS_ADD(ELEMENTS_TESTED, 1);
+
+      if (query.hasTransform())
+      {
+        if (TransformableBaseT::hasTransform())
+          return MetricT::template closestPoints<N, ScalarT>(
+                     makeTransformedObject(&query_elem, &query.getTransform()),
+                     makeTransformedObject(&target_elem, &TransformableBaseT::getTransform()), query_point, target_point);
+        else
+          return MetricT::template closestPoints<N, ScalarT>(makeTransformedObject(&query_elem, &query.getTransform()),
+                                                             target_elem, query_point, target_point);
+      }
+      else
+      {
+        if (TransformableBaseT::hasTransform())
+          return MetricT::template closestPoints<N, ScalarT>(
+                     query_elem, makeTransformedObject(&target_elem, &TransformableBaseT::getTransform()), query_point,
+                     target_point);
+        else
+          return MetricT::template closestPoints<N, ScalarT>(query_elem, target_elem, query_point, target_point);
       }
     }
 
@@ -1552,8 +3210,7 @@ class /* THEA_API */ KDTreeN
     /** Transform a ray to local/object space. */
     RayT toObjectSpace(RayT const & ray) const
     {
-      AffineTransform3 inv_trans = TransformableBaseT::getTransform().inverse();  // TODO: cache this
-      return RayT(inv_trans * ray.getOrigin(), inv_trans.getLinear() * ray.getDirection());
+      return RayT(inv_transform * ray.getOrigin(), inv_transform.getLinear() * ray.getDirection());
     }
 
     /** Transform a normal to world space. */
@@ -1571,12 +3228,65 @@ class /* THEA_API */ KDTreeN
       return (new_time >= 0 && (old_time < 0 || new_time <= old_time));
     }
 
+    /**
+     * Check if a ray hits any object in a node, in the forward direction. Unlike rayIntersectionTime(), this returns as soon as
+     * any hit is found instead of searching for the nearest one, which makes occlusion tests much cheaper.
+     */
+    template <typename RayIntersectionTesterT>
+    bool rayIntersects(Node const * start, RayT const & ray, Real max_time) const
+    {
+      THEA_QUERY_STATS_ADD(RAY_NODES_VISITED, 1);
+
+      if (!start->lo)  // leaf
+      {
+        for (array_size_t i = 0; i < start->num_elems; ++i)
+        {
+          ElementIndex index = start->elems[i];
+          Element const & elem = elems[index];
+
+          if (!elementPassesFilters(elem))
+            continue;
+
+          THEA_QUERY_STATS_ADD(RAY_ELEMENTS_TESTED, 1);
+
+          Real time = RayIntersectionTesterT::template rayIntersectionTime<N, ScalarT>(ray, elem, max_time);
+          if (improvedRayTime(time, max_time))
+            return true;
+        }
+
+        return false;
+      }
+      else  // not leaf
+      {
+        // Visit the child that will be hit first, since it is more likely to contain an occluder
+        Node const * n[2] = { start->lo, start->hi };
+        Real t[2] = { n[0]->bounds.rayIntersectionTime(ray, max_time),
+                      n[1]->bounds.rayIntersectionTime(ray, max_time) };
+
+        if (improvedRayTime(t[1], t[0]))
+        {
+          std::swap(n[0], n[1]);
+          std::swap(t[0], t[1]);
+        }
+
+        for (int i = 0; i < 2; ++i)
+          if (t[i] >= 0 && rayIntersects<RayIntersectionTesterT>(n[i], ray, max_time))
+            return true;
+
+        return false;
+      }
+    }
+
     /** Get the time taken for a ray to hit the nearest object in a node, in the forward direction. */
     template <typename RayIntersectionTesterT>
     Real rayIntersectionTime(Node const * start, RayT const & ray, Real max_time) const
     {
+      THEA_QUERY_STATS_ADD(RAY_NODES_VISITED, 1);
+
       if (!start->lo)  // leaf
       {
+        THEA_QUERY_STATS_ADD(RAY_ELEMENTS_TESTED, (int64)start->num_elems);
+
         Real best_time = max_time;
         bool found = false;
         for (array_size_t i = 0; i < start->num_elems; ++i)
@@ -1636,8 +3346,12 @@ class /* THEA_API */ KDTreeN
     template <typename RayIntersectionTesterT>
     RayStructureIntersectionT rayStructureIntersection(Node const * start, RayT const & ray, Real max_time) const
     {
+      THEA_QUERY_STATS_ADD(RAY_NODES_VISITED, 1);
+
       if (!start->lo)  // leaf
       {
+        THEA_QUERY_STATS_ADD(RAY_ELEMENTS_TESTED, (int64)start->num_elems);
+
         RayStructureIntersectionT best_isec(max_time);
         bool found = false;
         for (array_size_t i = 0; i < start->num_elems; ++i)
@@ -1704,17 +3418,23 @@ class /* THEA_API */ KDTreeN
       TheaArray<ElementSample> acceleration_samples(num_acceleration_samples <= 0 ? DEFAULT_NUM_ACCELERATION_SAMPLES
                                                                                   : num_acceleration_samples);
       VectorT src_cp, dst_cp;
-      for (array_size_t i = 0; i < acceleration_samples.size(); ++i)
+      array_size_t num_samples = 0;
+      for (array_size_t i = 0; i < 10 * acceleration_samples.size() && num_samples < acceleration_samples.size(); ++i)
       {
         long elem_index = Random::common().integer(0, (int32)num_elems - 1);
+        if (isRemoved(elem_index))  // removed elements are not valid NN proxies
+          continue;
+
         VectorT p = BoundedTraitsT::getCenter(elems[elem_index]);
 
         // Snap point to element, else it's not a valid NN proxy
         MetricT::template closestPoints<N, ScalarT>(p, elems[elem_index], src_cp, dst_cp);
 
-        acceleration_samples[i] = ElementSample(dst_cp, &elems[elem_index]);
+        acceleration_samples[num_samples++] = ElementSample(dst_cp, &elems[elem_index]);
       }
 
+      acceleration_samples.resize(num_samples);
+
       acceleration_structure = new NearestNeighborAccelerationStructure;
       acceleration_structure->disableNearestNeighborAcceleration();
       acceleration_structure->init(acceleration_samples.begin(), acceleration_samples.end());
@@ -1794,16 +3514,29 @@ class /* THEA_API */ KDTreeN
 
     long num_elems;  // elems.size() doesn't tell us how many elements there are, it's just the capacity of the elems array
     ElementArray elems;  // elems.size() is *not* the number of elements in the tree!!!
+    TheaArray<bool> removed_elems;  // tombstones for removed elements, empty if no element has been removed
+    long num_removed_elems;
+    long num_elems_at_build;  // number of elements (excluding removed ones) when the tree was last built from scratch
+    array_size_t num_indices_at_build;  // number of indices allocated from the index pool when the tree was last built
 
     long num_nodes;
+    long num_node_indices;
     NodePool node_pool;
+    TheaArray<Node *> free_nodes;  // nodes discarded by partial rebuilds, available for reuse
 
     IndexPool index_pool;
 
     long max_depth;
+    bool auto_max_depth;
     long max_elems_in_leaf;
+    bool memory_saving_mode;
+    long num_split_candidates;  // number of longest axes from which the splitting axis of each node is randomly picked
 
-    MatrixMN<3, 3, ScalarT> transform_inverse_transpose;
+    MatrixMN<N, N, ScalarT> transform_inverse_transpose;
+    Transform inv_transform;  // inverse of the current transform, if any
+    MatrixMN<N, N, ScalarT> transform_abs_linear;  // absolute values of the entries of the linear part of the transform
+    double transform_uniform_scale;  // scaling factor of the transform if it is a similarity, else negative
+    double transform_min_scale;  // lower bound on the factor by which the transform scales distances
 
     FilterStack filters;
 
@@ -1824,6 +3557,14 @@ class /* THEA_API */ KDTreeN
 template <typename T, long N, typename S, typename A>
 Real const KDTreeN<T, N, S, A>::BOUNDS_EXPANSION_FACTOR = 1.05f;
 
+// A kd-tree is a bounded object, with bounding box given by KDTreeN::getBounds()
+template <typename T, long N, typename S, typename A>
+class IsBoundedN< KDTreeN<T, N, S, A>, N >
+{
+  public:
+    static bool const value = true;
+};
+
 } // namespace Algorithms
 } // namespace Thea
 
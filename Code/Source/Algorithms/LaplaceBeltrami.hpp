@@ -44,7 +44,10 @@
 
 #include "../Common.hpp"
 #include "../AddressableMatrix.hpp"
+#include "../Array.hpp"
+#include "../CompressedSparseMatrix.hpp"
 #include "../Math.hpp"
+#include "../ParallelFor.hpp"
 #include "../ResizableMatrix.hpp"
 #include "../UnorderedMap.hpp"
 #include "../Graphics/MeshType.hpp"
@@ -59,6 +62,10 @@ namespace Algorithms {
  * dot and cross products defined). The vertices, corresponding to rows (and columns) of the matrix are numbered in sequential
  * order (according to the vertex iterator of the mesh).
  *
+ * The result may be any addressable, resizable matrix, or a CompressedRowMatrix or CompressedColumnMatrix. The compressed
+ * formats are assembled directly from the non-zero entries of the operator, computed in parallel, and are much faster and
+ * more compact for large meshes. They can be passed straight to sparse linear and eigen solvers.
+ *
  * Two algorithms are provided for computing the L-B operator:
  *
  * - Guoliang Xu, "Discrete Laplace-Beltrami Operator on Sphere and Optimal Spherical Triangulations". Int. J. Comput. Geometry
@@ -103,156 +110,266 @@ class THEA_API LaplaceBeltrami
     }
 
   private:
-    /** Shorthand to check that the mesh is of the desired and the matrix is addressable and resizable. */
-    template <typename MeshTypeCheckT, typename MatrixT>
-    struct CheckTypes
+    /** Check that the matrix is addressable and resizable. */
+    template <typename MatrixT>
+    struct IsAddressableResizable
     {
-      static bool const value = MeshTypeCheckT::value
-                             && boost::is_base_of< AddressableMatrix<typename MatrixT::Value>, MatrixT >::value
+      static bool const value = boost::is_base_of< AddressableMatrix<typename MatrixT::Value>, MatrixT >::value
                              && boost::is_base_of< ResizableMatrix<typename MatrixT::Value>, MatrixT >::value;
     };
 
+    /** Check that the matrix is stored in a compressed sparse format. */
+    template <typename MatrixT>
+    struct IsCompressed
+    {
+      static bool const value = boost::is_base_of< CompressedSparseMatrixInternal::Base, MatrixT >::value;
+    };
+
+    /** A (column, value) pair in a row of the operator. */
+    typedef std::pair<long, double> RowEntry;
+
+    /** Sequentially index all vertices of a mesh. */
+    template <typename MeshT>
+    static void indexVertices(MeshT const & mesh, TheaArray<typename MeshT::Vertex const *> & vertices,
+                              TheaUnorderedMap<typename MeshT::Vertex const *, long> & indices)
+    {
+      vertices.clear();
+      indices.clear();
+      for (typename MeshT::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
+      {
+        indices[&(*vi)] = (long)vertices.size();
+        vertices.push_back(&(*vi));
+      }
+    }
+
     //==========================================================================================================================
     // Xu 2006
     //==========================================================================================================================
 
     /**
-     * Compute the discrete Laplace-Beltrami operator for a general mesh using the method of [Xu 2006] and store it in the
-     * result.
+     * Compute the discrete Laplace-Beltrami operator for a mesh using the method of [Xu 2006] and store it in an addressable,
+     * resizable matrix.
      */
     template <typename MeshT, typename MatrixT>
     static void computeXu(MeshT const & mesh, MatrixT & result,
-                          typename boost::enable_if< CheckTypes<Graphics::IsGeneralMesh<MeshT>, MatrixT> >::type * dummy = 0)
+                          typename boost::enable_if< IsAddressableResizable<MatrixT> >::type * dummy = 0)
     {
-      // First sequentially index all vertices of the mesh
+      TheaArray<typename MeshT::Vertex const *> vertices;
       TheaUnorderedMap<typename MeshT::Vertex const *, long> indices;
-      long num_vertices = 0;
-      for (typename MeshT::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
-        indices[&(*vi)] = num_vertices++;
+      indexVertices(mesh, vertices, indices);
 
-      // Now compute the discrete Laplace-Beltrami operator
+      long num_vertices = (long)vertices.size();
       result.resize(num_vertices, num_vertices);
       result.makeZero();
 
-      typename MeshT::Edge const * first_edge, * ej_next, * ej_prev, * ej;
-      typename MeshT::Vertex const * vx, * vj, * vj_prev, * vj_next;
-      typename MatrixT::Value denom, cot_a_ij, cot_b_ij, x;
-      long i, j, num_visited;
-      for (typename MeshT::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
+      TheaArray<RowEntry> row;
+      for (long i = 0; i < num_vertices; ++i)
       {
-        vx = &(*vi);
-        i = indices[vx];
+        computeXuRow(mesh, vertices[(array_size_t)i], i, indices, row);
+        for (typename TheaArray<RowEntry>::const_iterator ri = row.begin(); ri != row.end(); ++ri)
+          result.getMutable(i, ri->first) += static_cast<typename MatrixT::Value>(ri->second);
+      }
+    }
+
+    /** Computes the rows of the [Xu 2006] operator for a range of vertices, as a list of matrix entries. */
+    template <typename MeshT, typename EntryT>
+    struct XuRowsTask
+    {
+      typedef typename MeshT::Vertex Vertex;
+
+      XuRowsTask(MeshT const & mesh_, TheaArray<Vertex const *> const & vertices_,
+                 TheaUnorderedMap<Vertex const *, long> const & indices_, TheaArray< TheaArray<EntryT> > & block_entries_,
+                 TheaArray<std::string> & block_errors_)
+      : mesh(&mesh_), vertices(&vertices_), indices(&indices_), block_entries(&block_entries_), block_errors(&block_errors_)
+      {}
 
-        if (vx->numEdges() > 0)  // not an isolated vertex
+      // Compute the rows of a contiguous block of vertices, out of as many blocks as there are output arrays
+      void operator()(long block)
+      {
+        long num_vertices = (long)vertices->size();
+        long num_blocks = (long)block_entries->size();
+        long verts_per_block = num_vertices / num_blocks, extra = num_vertices % num_blocks;
+        long begin = block * verts_per_block + std::min(block, extra);
+        long end = begin + verts_per_block + (block < extra ? 1 : 0);
+
+        TheaArray<EntryT> * entries = &(*block_entries)[(array_size_t)block];
+        try
         {
-          first_edge = *vx->edgesBegin();
-          ej_prev = first_edge;
-          ej      = ej_prev->nextAroundEndpoint(vx);
-          ej_next = ej->nextAroundEndpoint(vx);
-          denom = 0;
-          num_visited = 0;
-          do
+          TheaArray<RowEntry> row;
+          for (long i = begin; i < end; ++i)
           {
-            vj      = ej->getOtherEndpoint(vx);
-            vj_prev = ej_prev->getOtherEndpoint(vx);
-            vj_next = ej_next->getOtherEndpoint(vx);
+            computeXuRow(*mesh, (*vertices)[(array_size_t)i], i, *indices, row);
+            for (typename TheaArray<RowEntry>::const_iterator ri = row.begin(); ri != row.end(); ++ri)
+              entries->push_back(EntryT(typename EntryT::first_type(i, ri->first),
+                                        static_cast<typename EntryT::second_type>(ri->second)));
+          }
+        }
+        catch (Error & e)  // don't let exceptions escape the thread
+        {
+          (*block_errors)[(array_size_t)block] = e.what();
+        }
+      }
 
-            cot_a_ij = (typename MatrixT::Value)cot(vx->getPosition(), vj_prev->getPosition(), vj->getPosition());
-            cot_b_ij = (typename MatrixT::Value)cot(vx->getPosition(), vj_next->getPosition(), vj->getPosition());
-            denom += (cot_a_ij + cot_b_ij) * (vx->getPosition() - vj->getPosition()).length();
+      MeshT const * mesh;
+      TheaArray<Vertex const *> const * vertices;
+      TheaUnorderedMap<Vertex const *, long> const * indices;
+      TheaArray< TheaArray<EntryT> > * block_entries;
+      TheaArray<std::string> * block_errors;
 
-            j = indices[vj];
-            x = 4 * (cot_a_ij + cot_b_ij);
-            result.getMutable(i, j) += x;
-            result.getMutable(i, i) -= x;
+    }; // struct XuRowsTask
 
-            ej_prev = ej;
-            ej      = ej_next;
-            ej_next = ej_next->nextAroundEndpoint(vx);
+    /**
+     * Compute the discrete Laplace-Beltrami operator for a mesh using the method of [Xu 2006] and store it in a compressed
+     * sparse matrix. The rows of the operator are computed in parallel, and the matrix is assembled directly from them.
+     */
+    template <typename MeshT, typename MatrixT>
+    static void computeXu(MeshT const & mesh, MatrixT & result,
+                          typename boost::enable_if< IsCompressed<MatrixT> >::type * dummy = 0)
+    {
+      typedef typename MatrixT::Entry Entry;
 
-            if (++num_visited == vx->numEdges() && ej_prev != first_edge)
-              throw Error("LaplaceBeltrami: Mesh is not manifold");
+      TheaArray<typename MeshT::Vertex const *> vertices;
+      TheaUnorderedMap<typename MeshT::Vertex const *, long> indices;
+      indexVertices(mesh, vertices, indices);
 
-          } while (ej_prev != first_edge);
+      // Each thread handles a contiguous block of vertices, if there are enough of them
+      static long const MIN_VERTICES_PER_THREAD = 10000;
+      long num_vertices = (long)vertices.size();
+      long num_threads = numThreadsForWork(num_vertices, MIN_VERTICES_PER_THREAD);
 
-          if (std::abs(denom) > 0)
-          {
-            for (typename MeshT::Vertex::EdgeConstIterator ei = vi->edgesBegin(); ei != vi->edgesEnd(); ++ei)
-            {
-              j = indices[(*ei)->getOtherEndpoint(&(*vi))];
-              result.getMutable(i, j) /= denom;
-            }
+      TheaArray< TheaArray<Entry> > thread_entries((array_size_t)num_threads);
+      TheaArray<std::string> thread_errors((array_size_t)num_threads);
+      parallelFor(num_threads, XuRowsTask<MeshT, Entry>(mesh, vertices, indices, thread_entries, thread_errors), 1, num_threads);
 
-            result.getMutable(i, i) /= denom;
-          }
+      for (array_size_t t = 0; t < thread_errors.size(); ++t)
+        if (!thread_errors[t].empty())
+          throw Error(thread_errors[t]);
+
+      TheaArray<Entry> entries;
+      if (num_threads <= 1)
+        entries.swap(thread_entries[0]);
+      else
+      {
+        array_size_t num_entries = 0;
+        for (array_size_t t = 0; t < thread_entries.size(); ++t)
+          num_entries += thread_entries[t].size();
+
+        entries.reserve(num_entries);
+        for (array_size_t t = 0; t < thread_entries.size(); ++t)
+        {
+          entries.insert(entries.end(), thread_entries[t].begin(), thread_entries[t].end());
+          TheaArray<Entry>().swap(thread_entries[t]);  // release memory early
         }
       }
+
+      result.setFromEntries(num_vertices, num_vertices, entries);
     }
 
     /**
-     * Compute the discrete Laplace-Beltrami operator for a DCEL mesh using the method of [Xu 2006] and store it in the result.
+     * Compute the row of the [Xu 2006] operator corresponding to a vertex of a general mesh, as a list of (column, value) pairs.
+     * The list may contain multiple pairs with the same column, whose values should be summed.
      */
-    template <typename MeshT, typename MatrixT>
-    static void computeXu(MeshT const & mesh, MatrixT & result,
-                          typename boost::enable_if< CheckTypes<Graphics::IsDCELMesh<MeshT>, MatrixT> >::type * dummy = 0)
+    template <typename MeshT>
+    static void computeXuRow(MeshT const & mesh, typename MeshT::Vertex const * vx, long i,
+                             TheaUnorderedMap<typename MeshT::Vertex const *, long> const & indices, TheaArray<RowEntry> & row,
+                             typename boost::enable_if< Graphics::IsGeneralMesh<MeshT> >::type * dummy = 0)
     {
-      // First sequentially index all vertices of the mesh
-      TheaUnorderedMap<typename MeshT::Vertex const *, long> indices;
-      long num_vertices = 0;
-      for (typename MeshT::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
-        indices[&(*vi)] = num_vertices++;
+      row.clear();
+      if (vx->numEdges() <= 0)  // isolated vertex
+        return;
 
-      // Now compute the discrete Laplace-Beltrami operator
-      result.resize(num_vertices, num_vertices);
-      result.makeZero();
+      typename MeshT::Edge const * first_edge, * ej_next, * ej_prev, * ej;
+      typename MeshT::Vertex const * vj, * vj_prev, * vj_next;
+      double denom, cot_a_ij, cot_b_ij, x, diag;
+      long num_visited;
+
+      first_edge = *vx->edgesBegin();
+      ej_prev = first_edge;
+      ej      = ej_prev->nextAroundEndpoint(vx);
+      ej_next = ej->nextAroundEndpoint(vx);
+      denom = 0;
+      diag = 0;
+      num_visited = 0;
+      do
+      {
+        vj      = ej->getOtherEndpoint(vx);
+        vj_prev = ej_prev->getOtherEndpoint(vx);
+        vj_next = ej_next->getOtherEndpoint(vx);
+
+        cot_a_ij = cot(vx->getPosition(), vj_prev->getPosition(), vj->getPosition());
+        cot_b_ij = cot(vx->getPosition(), vj_next->getPosition(), vj->getPosition());
+        denom += (cot_a_ij + cot_b_ij) * (vx->getPosition() - vj->getPosition()).length();
+
+        x = 4 * (cot_a_ij + cot_b_ij);
+        row.push_back(RowEntry(indices.find(vj)->second, x));
+        diag -= x;
+
+        ej_prev = ej;
+        ej      = ej_next;
+        ej_next = ej_next->nextAroundEndpoint(vx);
+
+        if (++num_visited == vx->numEdges() && ej_prev != first_edge)
+          throw Error("LaplaceBeltrami: Mesh is not manifold");
+
+      } while (ej_prev != first_edge);
+
+      row.push_back(RowEntry(i, diag));
+      normalizeRow(row, denom);
+    }
+
+    /**
+     * Compute the row of the [Xu 2006] operator corresponding to a vertex of a DCEL mesh, as a list of (column, value) pairs.
+     * The list may contain multiple pairs with the same column, whose values should be summed.
+     */
+    template <typename MeshT>
+    static void computeXuRow(MeshT const & mesh, typename MeshT::Vertex const * vx, long i,
+                             TheaUnorderedMap<typename MeshT::Vertex const *, long> const & indices, TheaArray<RowEntry> & row,
+                             typename boost::enable_if< Graphics::IsDCELMesh<MeshT> >::type * dummy = 0)
+    {
+      row.clear();
 
       typename MeshT::Halfedge const * he_j_next, * he_j_prev, * he_j;
       typename MeshT::Vertex const * vj, * vj_prev, * vj_next;
-      typename MatrixT::Value denom, cot_a_ij, cot_b_ij, x;
-      long i, j;
-      for (typename MeshT::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
-      {
-        i = indices[&(*vi)];
+      double denom, cot_a_ij, cot_b_ij, x, diag;
 
-        he_j_prev = vi->getHalfedge();
-        if (he_j_prev)  // not an isolated vertex
-        {
-          he_j      = he_j_prev->nextAroundOrigin();
-          he_j_next = he_j->nextAroundOrigin();
-          denom = 0;
-          do
-          {
-            vj      = he_j->getEnd();
-            vj_prev = he_j_prev->getEnd();
-            vj_next = he_j_next->getEnd();
+      he_j_prev = vx->getHalfedge();
+      if (!he_j_prev)  // isolated vertex
+        return;
 
-            cot_a_ij = (typename MatrixT::Value)cot(vi->getPosition(), vj_prev->getPosition(), vj->getPosition());
-            cot_b_ij = (typename MatrixT::Value)cot(vi->getPosition(), vj_next->getPosition(), vj->getPosition());
-            denom += (cot_a_ij + cot_b_ij) * (vi->getPosition() - vj->getPosition()).length();
+      he_j      = he_j_prev->nextAroundOrigin();
+      he_j_next = he_j->nextAroundOrigin();
+      denom = 0;
+      diag = 0;
+      do
+      {
+        vj      = he_j->getEnd();
+        vj_prev = he_j_prev->getEnd();
+        vj_next = he_j_next->getEnd();
 
-            j = indices[vj];
-            x = 4 * (cot_a_ij + cot_b_ij);
-            result.getMutable(i, j) += x;
-            result.getMutable(i, i) -= x;
+        cot_a_ij = cot(vx->getPosition(), vj_prev->getPosition(), vj->getPosition());
+        cot_b_ij = cot(vx->getPosition(), vj_next->getPosition(), vj->getPosition());
+        denom += (cot_a_ij + cot_b_ij) * (vx->getPosition() - vj->getPosition()).length();
 
-            he_j_prev = he_j;
-            he_j      = he_j_next;
-            he_j_next = he_j_next->nextAroundOrigin();
+        x = 4 * (cot_a_ij + cot_b_ij);
+        row.push_back(RowEntry(indices.find(vj)->second, x));
+        diag -= x;
 
-          } while (he_j_prev != vi->getHalfedge());
+        he_j_prev = he_j;
+        he_j      = he_j_next;
+        he_j_next = he_j_next->nextAroundOrigin();
 
-          he_j = vi->getHalfedge();
-          do
-          {
-            j = indices[he_j->getEnd()];
-            result.getMutable(i, j) /= denom;
-            he_j = he_j->nextAroundOrigin();
+      } while (he_j_prev != vx->getHalfedge());
 
-          } while (he_j != vi->getHalfedge());
+      row.push_back(RowEntry(i, diag));
+      normalizeRow(row, denom);
+    }
 
-          result.getMutable(i, i) /= denom;
-        }
-      }
+    /** Divide all entries of a row of the [Xu 2006] operator by the normalization factor, if it is non-zero. */
+    static void normalizeRow(TheaArray<RowEntry> & row, double denom)
+    {
+      if (std::abs(denom) > 0)
+        for (TheaArray<RowEntry>::iterator ri = row.begin(); ri != row.end(); ++ri)
+          ri->second /= denom;
     }
 
     /** Cotangent of angle ABC (vertex at B) for vectors in 3-space. The angle less than 180 degrees is chosen. */
@@ -41,17 +41,99 @@
 
 #include "LinearLeastSquares.hpp"
 #include "../Matrix.hpp"
+#include "../MatrixMultiply.hpp"
 #include "NNLS/nnls.h"
 #include "SVD.hpp"
+#include <cmath>
 
 namespace Thea {
 namespace Algorithms {
 
-LinearLeastSquares::LinearLeastSquares(long ndim_)
-: ndim(ndim_), num_objectives(0), has_solution(true)
+namespace LinearLeastSquaresInternal {
+
+// Number of objectives buffered in streaming mode before they are folded into the normal equations. Folding a block at a time
+// lets the update use the blocked matrix multiplication kernels instead of a rank-1 update per objective.
+static long const STREAMING_BLOCK_SIZE = 256;
+
+// Compute the lower-triangular factor L, in row-major form, of a symmetric positive definite n x n row-major matrix A, such
+// that A = L * L^T. Only the lower triangle of A is read. Returns false if a pivot is not greater than min_pivot, i.e. A is not
+// (numerically) positive definite.
+bool
+cholesky(long n, double const * a, double * l, double min_pivot)
+{
+  for (long i = 0; i < n; ++i)
+  {
+    for (long j = 0; j <= i; ++j)
+    {
+      double sum = a[i * n + j];
+      for (long k = 0; k < j; ++k)
+        sum -= l[i * n + k] * l[j * n + k];
+
+      if (i == j)
+      {
+        if (!(sum > min_pivot))
+          return false;
+
+        l[i * n + i] = std::sqrt(sum);
+      }
+      else
+        l[i * n + j] = sum / l[j * n + j];
+    }
+
+    for (long j = i + 1; j < n; ++j)
+      l[i * n + j] = 0;
+  }
+
+  return true;
+}
+
+// Non-negative least-squares solution of an m x n system with row-major coefficient matrix A.
+bool
+nnls(long m, long n, double const * a, double const * b, double * solution)
+{
+  // NNLS requires a COLUMN-MAJOR (Fortran-style) matrix. Plus the values will be overwritten, so we need a copy anyway
+  TheaArray<double> nnls_a((array_size_t)(m * n));
+  for (long i = 0; i < m; i++)
+    for (long j = 0; j < n; j++)
+      nnls_a[(array_size_t)(i + j * m)] = a[i * n + j];
+
+  TheaArray<double>  nnls_b(b, b + m);  // the values will be overwritten, so we need to make a copy
+  double             rnorm;
+  TheaArray<double>  w((array_size_t)n);
+  TheaArray<double>  zz((array_size_t)m);
+  TheaArray<int>     index((array_size_t)n);
+  int                mode;
+
+  int mda = (int)m, im = (int)m, in = (int)n;
+  nnls_c(&nnls_a[0], &mda, &im, &in, &nnls_b[0], solution, &rnorm, &w[0], &zz[0], &index[0], &mode);
+
+  if (mode == 1)
+    return true;
+
+  switch (mode)
+  {
+    // Should never be 2 since we've checked for this above, but recheck all the same
+    case 2:  THEA_DEBUG << "LinearLeastSquares: NNLS error (bad problem dimensions)"; break;
+    case 3:  THEA_DEBUG << "LinearLeastSquares: NNLS error (iteration count exceeded)"; break;
+    default: THEA_DEBUG << "LinearLeastSquares: Unknown NNLS error";
+  }
+
+  return false;
+}
+
+} // namespace LinearLeastSquaresInternal
+
+LinearLeastSquares::LinearLeastSquares(long ndim_, bool streaming_)
+: ndim(ndim_), streaming(streaming_), num_objectives(0), has_solution(true)
 {
   alwaysAssertM(ndim_ > 0, "LinearLeastSquares: Number of dimensions must be positive");
   solution.resize((array_size_t)ndim_, 0);
+
+  if (streaming)
+  {
+    ata.resize((array_size_t)(ndim * ndim), 0);
+    atb.resize((array_size_t)ndim, 0);
+  }
 }
 
 void
@@ -62,15 +144,67 @@ LinearLeastSquares::addObjective(double const * coeffs, double constant)
   a_values.insert(a_values.end(), coeffs, coeffs + ndim);
   b.push_back(constant);
   num_objectives++;
+
+  if (streaming && (long)b.size() >= LinearLeastSquaresInternal::STREAMING_BLOCK_SIZE)
+    flushObjectives();
+}
+
+void
+LinearLeastSquares::addObjectives(LinearLeastSquares const & src)
+{
+  alwaysAssertM(&src != this, "LinearLeastSquares: Cannot add objectives of a system to itself");
+  alwaysAssertM(src.ndim == ndim, "LinearLeastSquares: Cannot add objectives of a system with a different number of dimensions");
+
+  if (src.streaming)
+  {
+    alwaysAssertM(streaming, "LinearLeastSquares: A non-streaming system cannot absorb objectives from a streaming system");
+
+    for (array_size_t i = 0; i < ata.size(); ++i)
+      ata[i] += src.ata[i];
+
+    for (array_size_t i = 0; i < atb.size(); ++i)
+      atb[i] += src.atb[i];
+
+    num_objectives += src.num_objectives - (long)src.b.size();
+  }
+
+  // Individually stored objectives: all objectives of a non-streaming system, or the unflushed block of a streaming one
+  for (array_size_t i = 0; i < src.b.size(); ++i)
+    addObjective(&src.a_values[i * (array_size_t)ndim], src.b[i]);
 }
 
 void
 LinearLeastSquares::clearObjectives()
 {
   a_values.clear();
+  b.clear();
+  std::fill(ata.begin(), ata.end(), 0.0);
+  std::fill(atb.begin(), atb.end(), 0.0);
   num_objectives = 0;
 }
 
+void
+LinearLeastSquares::flushObjectives()
+{
+  if (b.empty())
+    return;
+
+  // The transpose of the buffered block is just the row-major block read in column-major order
+  long k = (long)b.size();
+  TheaArray<double> block_ata(ata.size()), block_atb(atb.size());
+  Internal::gemm<double>(ndim, ndim, k, &a_values[0], 1, ndim, &a_values[0], ndim, 1, &block_ata[0], ndim, 1);
+  Internal::gemv<double>(ndim, k, &a_values[0], 1, ndim, &b[0], &block_atb[0]);
+
+  for (array_size_t i = 0; i < ata.size(); ++i)
+    ata[i] += block_ata[i];
+
+  for (array_size_t i = 0; i < atb.size(); ++i)
+    atb[i] += block_atb[i];
+
+  a_values.clear();
+  b.clear();
+}
+
 bool
 LinearLeastSquares::solve(Constraint constraint, double tolerance)
 {
@@ -85,46 +219,15 @@ LinearLeastSquares::solve(Constraint constraint, double tolerance)
 
     has_solution = true;
   }
+  else if (streaming)
+    has_solution = solveNormalEquations(constraint, tolerance);
   else
   {
     switch (constraint)
     {
       case Constraint::NON_NEGATIVE:
       {
-        array_size_t m = (array_size_t)num_objectives;
-        array_size_t n = (array_size_t)ndim;
-
-        // NNLS requires a COLUMN-MAJOR (Fortran-style) matrix. Plus the values will be overwritten, so we need a copy anyway
-        TheaArray<double> nnls_a(a_values.size());
-        for (array_size_t i = 0; i < m; i++)
-          for (array_size_t j = 0; j < n; j++)
-            nnls_a[i + j * m] = a_values[i * n + j];
-
-        TheaArray<double>  nnls_b(b);  // the values will be overwritten, so we need to make a copy
-        double             rnorm;
-        TheaArray<double>  w(n);
-        TheaArray<double>  zz(m);
-        TheaArray<int>     index(n);
-        int                mode;
-
-        int mda = (int)m, im = (int)m, in = (int)n;
-        nnls_c(&nnls_a[0], &mda, &im, &in, &nnls_b[0], &solution[0], &rnorm, &w[0], &zz[0], &index[0], &mode);
-
-        if (mode == 1)
-          has_solution = true;
-        else
-        {
-          switch (mode)
-          {
-            // Should never be 2 since we've checked for this above, but recheck all the same
-            case 2:  THEA_DEBUG << "LinearLeastSquares: NNLS error (bad problem dimensions)"; break;
-            case 3:  THEA_DEBUG << "LinearLeastSquares: NNLS error (iteration count exceeded)"; break;
-            default: THEA_DEBUG << "LinearLeastSquares: Unknown NNLS error";
-          }
-
-          has_solution = false;
-        }
-
+        has_solution = LinearLeastSquaresInternal::nnls(num_objectives, ndim, &a_values[0], &b[0], &solution[0]);
         break;
       }
 
@@ -149,5 +252,112 @@ LinearLeastSquares::solve(Constraint constraint, double tolerance)
   return has_solution;
 }
 
+bool
+LinearLeastSquares::solveNormalEquations(Constraint constraint, double tolerance)
+{
+  if (constraint != Constraint::UNCONSTRAINED && constraint != Constraint::NON_NEGATIVE)
+    throw Error("LinearLeastSquares: Unsupported constraint");
+
+  flushObjectives();
+
+  // Same default as SVD::pseudoInverse(). Singular values of A^T A are squares of those of A.
+  if (tolerance < 0)
+    tolerance = std::max(num_objectives, ndim) * 1.0e-4;
+
+  double sq_tolerance = tolerance * tolerance;
+  array_size_t n = (array_size_t)ndim;
+
+  // An n x n row-major matrix R and an n-vector d such that ||R x - d|| and ||A x - b|| differ only by a constant, for all x
+  TheaArray<double> r(n * n, 0.0), d(n, 0.0);
+
+  TheaArray<double> l(n * n);
+  if (LinearLeastSquaresInternal::cholesky(ndim, &ata[0], &l[0], sq_tolerance))
+  {
+    // A^T A = L L^T, so R = L^T and d = L^{-1} A^T b (forward substitution)
+    for (array_size_t i = 0; i < n; ++i)
+    {
+      double sum = atb[i];
+      for (array_size_t k = 0; k < i; ++k)
+        sum -= l[i * n + k] * d[k];
+
+      d[i] = sum / l[i * n + i];
+    }
+
+    if (constraint == Constraint::UNCONSTRAINED)
+    {
+      // Solve L^T x = d (back substitution)
+      for (array_size_t i = n; i-- > 0; )
+      {
+        double sum = d[i];
+        for (array_size_t k = i + 1; k < n; ++k)
+          sum -= l[k * n + i] * solution[k];
+
+        solution[i] = sum / l[i * n + i];
+      }
+
+      return true;
+    }
+
+    for (array_size_t i = 0; i < n; ++i)
+      for (array_size_t j = i; j < n; ++j)
+        r[i * n + j] = l[j * n + i];
+  }
+  else
+  {
+    THEA_DEBUG << "LinearLeastSquares: Normal equations are (numerically) singular, falling back to SVD";
+
+    // The accumulated product need not be exactly symmetric because of rounding, so symmetrize it
+    Matrix<double> sym(ndim, ndim);
+    for (long i = 0; i < ndim; ++i)
+      for (long j = 0; j < ndim; ++j)
+        sym(i, j) = 0.5 * (ata[(array_size_t)(i * ndim + j)] + ata[(array_size_t)(j * ndim + i)]);
+
+    // A^T A = U D V, with U = V^T since A^T A is symmetric positive semi-definite
+    Matrix<double> u, v;
+    TheaArray<double> sv;
+    if (!SVD::compute(sym, u, sv, v))
+      return false;
+
+    TheaArray<double> y(n, 0.0);
+    for (array_size_t i = 0; i < n; ++i)
+    {
+      if (sv[i] < sq_tolerance)
+        continue;
+
+      double c = 0;  // (U^T A^T b)_i
+      for (array_size_t k = 0; k < n; ++k)
+        c += u((long)k, (long)i) * atb[k];
+
+      if (constraint == Constraint::UNCONSTRAINED)
+        y[i] = c / sv[i];
+      else
+      {
+        // R = D^{1/2} V and d = D^{-1/2} U^T A^T b, restricted to the non-negligible singular values
+        double s = std::sqrt(sv[i]);
+        d[i] = c / s;
+        for (array_size_t j = 0; j < n; ++j)
+          r[i * n + j] = s * v((long)i, (long)j);
+      }
+    }
+
+    if (constraint == Constraint::UNCONSTRAINED)
+    {
+      // x = V^T D^{-1} U^T A^T b
+      for (array_size_t j = 0; j < n; ++j)
+      {
+        double sum = 0;
+        for (array_size_t i = 0; i < n; ++i)
+          sum += v((long)i, (long)j) * y[i];
+
+        solution[j] = sum;
+      }
+
+      return true;
+    }
+  }
+
+  return LinearLeastSquaresInternal::nnls(ndim, ndim, &r[0], &d[0], &solution[0]);
+}
+
 } // namespace Algorithms
 } // namespace Thea
@@ -52,6 +52,13 @@ namespace Algorithms {
  * Solve linear least-squares problems of the form: minimize ||A<b>x</b> - <b>b</b>||. Here ||.|| denotes the L2 norm. This
  * class provides a few basic solvers. More advanced linear least-squares solvers may be provided by plugins implementing the
  * LinearSolver interface.
+ *
+ * By default, every objective is stored and the full system is solved directly. For very tall systems (many more objectives
+ * than dimensions), the class may instead be constructed in <em>streaming</em> mode, in which only the normal equations
+ * A<sup>T</sup>A <b>x</b> = A<sup>T</sup><b>b</b> are accumulated as objectives arrive. Memory usage is then O(n<sup>2</sup>)
+ * for an n-dimensional problem, independent of the number of objectives. Objectives may be accumulated in parallel in separate
+ * per-thread instances and combined with addObjectives() before solving. Note that forming the normal equations squares the
+ * condition number of the problem, so the dense mode is preferable for small, ill-conditioned systems.
  */
 class THEA_API LinearLeastSquares
 {
@@ -71,12 +78,22 @@ class THEA_API LinearLeastSquares
       THEA_ENUM_CLASS_BODY(Constraint)
     };
 
-    /** Constructor. Sets the number of dimensions of the problem domain (i.e. of the vector <b>x</b>). */
-    LinearLeastSquares(long ndim_);
+    /**
+     * Constructor. Sets the number of dimensions of the problem domain (i.e. of the vector <b>x</b>), and whether the system
+     * should be accumulated in streaming mode (see class documentation).
+     */
+    LinearLeastSquares(long ndim_, bool streaming_ = false);
 
     /** Get the number of dimensions of the problem domain. */
     long numDimensions() const { return ndim; }
 
+    /**
+     * Check if the system only accumulates the normal equations, instead of storing every objective.
+     *
+     * @see LinearLeastSquares(long, bool)
+     */
+    bool isStreaming() const { return streaming; }
+
     /**
      * Add an obective term that is to be satisfied in a least-squares sense. This corresponds to a row of the matrix A, and the
      * corresponding element of <b>b</b>. The equality dot(\a coeffs, <b>x</b>) = \a b is satisfied as best as possible.
@@ -88,6 +105,16 @@ class THEA_API LinearLeastSquares
      */
     void addObjective(double const * coeffs, double constant);
 
+    /**
+     * Add all the objectives of another system with the same number of dimensions. This is typically used to combine systems
+     * accumulated in parallel by different threads. A streaming system can absorb objectives from any system, but a
+     * non-streaming system cannot absorb objectives from a streaming one, since the latter does not retain individual
+     * objectives.
+     *
+     * @see addObjective()
+     */
+    void addObjectives(LinearLeastSquares const & src);
+
     /**
      * Clear all objectives.
      *
@@ -104,9 +131,15 @@ class THEA_API LinearLeastSquares
      * non-negative solution is computed via NNLS (C. L. Lawson and R. J. Hanson, "Solving Least Square Problems", Prentice
      * Hall, Englewood Cliffs NJ, 1974, http://hesperia.gsfc.nasa.gov/~schmahl/nnls).
      *
+     * In streaming mode, the n x n matrix A<sup>T</sup>A is factored as R<sup>T</sup>R by Cholesky decomposition, falling back
+     * to an SVD of A<sup>T</sup>A if it is (numerically) singular. An unconstrained solution is obtained by back-substitution,
+     * and a non-negative solution by running NNLS on the equivalent n x n problem: minimize ||R<b>x</b> -
+     * R<sup>-T</sup>A<sup>T</sup><b>b</b>||.
+     *
      * @param constraint The constraints to be imposed on the solution.
      * @param tolerance The numerical tolerance of the solution process. For a solution via SVD, singular values smaller than
-     *   the tolerance are zeroed out.
+     *   the tolerance are zeroed out. In streaming mode, the tolerance applies to the (implicit) singular values of A, i.e. to
+     *   the square roots of the singular values of A<sup>T</sup>A.
      *
      * @return True if a solution was found, else false. (The same value is returned by successive calls to hasSolution().)
      */
@@ -119,10 +152,19 @@ class THEA_API LinearLeastSquares
     TheaArray<double> const & getSolution() const { return solution; }
 
   private:
+    /** Fold the buffered objectives into the normal equations (streaming mode only). */
+    void flushObjectives();
+
+    /** Solve the accumulated normal equations (streaming mode only). */
+    bool solveNormalEquations(Constraint constraint, double tolerance);
+
     long ndim;  ///< The number of dimensions of the problem domain.
+    bool streaming;  ///< Accumulate only the normal equations?
     long num_objectives;  ///< The number of objectives in the system.
-    TheaArray<double> a_values;  ///< The values, in row-major form, of the matrix A.
-    TheaArray<double> b;  ///< The constants vector <b>b</b>.
+    TheaArray<double> a_values;  ///< The values, in row-major form, of the matrix A (only a block of recent rows if streaming).
+    TheaArray<double> b;  ///< The constants vector <b>b</b> (only a block of recent values if streaming).
+    TheaArray<double> ata;  ///< The n x n matrix A<sup>T</sup>A, in row-major form (streaming mode only).
+    TheaArray<double> atb;  ///< The vector A<sup>T</sup><b>b</b> (streaming mode only).
     bool has_solution;  ///< Was a solution computed by the last call to solve()? */
     TheaArray<double> solution;  ///< The solution vector <b>x</b>.
 
@@ -44,6 +44,34 @@
 namespace Thea {
 namespace Algorithms {
 
+bool
+LinearSolver::factorize(Options const & options)
+{
+  factor_options = options;
+  factored = true;
+  return factored;
+}
+
+bool
+LinearSolver::solveFactored(long num_rhs, double const * rhs, double * solutions)
+{
+  alwaysAssertM(factored, std::string(getName()) + ": Coefficient matrix has not been factored");
+  alwaysAssertM(num_rhs <= 0 || (rhs && solutions), std::string(getName()) + ": Constant and solution vectors must be non-null");
+
+  long nrows = coeffs.numRows(), ncols = coeffs.numColumns();
+  bool ok = true;
+  for (long i = 0; i < num_rhs; ++i)
+  {
+    setConstants(rhs + i * nrows, rhs + (i + 1) * nrows);
+    if (solve(factor_options) && (long)solution.size() >= ncols)
+      std::copy(solution.begin(), solution.begin() + ncols, solutions + i * ncols);
+    else
+      ok = false;
+  }
+
+  return ok;
+}
+
 LinearSolverFactory *
 LinearSolverManager::getFactory(std::string const & type)
 {
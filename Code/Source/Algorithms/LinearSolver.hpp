@@ -74,17 +74,28 @@ namespace Algorithms {
  * <b>b</b> from #constants. If the system is successfully solved, #has_solution is set to true and the %solution placed in
  * #solution. Else, #has_solution is set to false.
  *
+ * If the same coefficient matrix is to be used with many different constant vectors, call factorize() once and then
+ * solveFactored() for each (block of) constant vectors. Backends that support it override these functions to reuse the
+ * factorization of the matrix; the default implementations simply call solve() for each constant vector.
+ *
  * FIXME: This classes currently passes STL classes across DLL boundaries. It should be an abstract base class.
  */
 class THEA_API LinearSolver : private Noncopyable, public virtual NamedObject
 {
   public:
+    /** Constructor. */
+    LinearSolver() : has_solution(false), factored(false) {}
+
     /** Destructor. */
     virtual ~LinearSolver() {}
 
-    /** Set the coefficient matrix (<b>A</b> in <b>Ax = b</b>) of the linear system */
+    /**
+     * Set the coefficient matrix (<b>A</b> in <b>Ax = b</b>) of the linear system. Any existing factorization (see factorize())
+     * is discarded.
+     */
     template <typename MatrixT> void setCoefficients(MatrixT const & coeffs_)
     {
+      clearFactorization();
       coeffs.setMatrix(coeffs_, getPreferredFormat(MatrixUtil::getFormat(coeffs_)));
     }
 
@@ -112,14 +123,50 @@ class THEA_API LinearSolver : private Noncopyable, public virtual NamedObject
     /** Get the solution vector of the linear system. Valid only if hasSolution() returns true. */
     TheaArray<double> const & getSolution() const { return solution; }
 
+    /**
+     * Factor the coefficient matrix once, so that systems with the same coefficients and different constant vectors can then
+     * be solved cheaply by solveFactored(). The factorization is kept until the coefficients are changed.
+     *
+     * The default implementation does no precomputation: it just stores the options for later calls to solve().
+     *
+     * @param options Backend-specific options, as for solve().
+     *
+     * @return True if the coefficient matrix was successfully factored, else false. (The same value is returned by successive
+     *   calls to isFactored().)
+     */
+    virtual bool factorize(Options const & options = Options());
+
+    /** Was the coefficient matrix successfully factored by the last call to factorize()? */
+    bool isFactored() const { return factored; }
+
+    /**
+     * Solve the system for a block of constant vectors, using the factorization computed by the last call to factorize(). This
+     * does not change the values returned by hasSolution() and getSolution(), except in the default implementation, which
+     * calls solve() for each constant vector.
+     *
+     * @param num_rhs The number of constant vectors (right-hand sides).
+     * @param rhs The constant vectors, stored consecutively, i.e. as the columns of a column-major matrix with as many rows as
+     *   the coefficient matrix.
+     * @param solutions Used to return the solutions, stored consecutively, i.e. as the columns of a column-major matrix with as
+     *   many rows as the coefficient matrix has columns. Must be preallocated by the caller.
+     *
+     * @return True if the system was solved for every constant vector, else false.
+     */
+    virtual bool solveFactored(long num_rhs, double const * rhs, double * solutions);
+
   protected:
     /** Get the preferred storage format for a matrix in the given input format. */
     virtual MatrixFormat getPreferredFormat(MatrixFormat input_format) { return input_format; }
 
-    MatrixWrapper<double>  coeffs;        ///< Cached coefficient matrix.
-    TheaArray<double>      constants;     ///< Cached constant vector.
-    bool                   has_solution;  ///< Was the system successfully solved by the last call to solve()?
-    TheaArray<double>      solution;      ///< Solution of the linear system.
+    /** Discard the factorization computed by factorize(). Overriding implementations must call this base version. */
+    virtual void clearFactorization() { factored = false; }
+
+    MatrixWrapper<double>  coeffs;          ///< Cached coefficient matrix.
+    TheaArray<double>      constants;       ///< Cached constant vector.
+    bool                   has_solution;    ///< Was the system successfully solved by the last call to solve()?
+    TheaArray<double>      solution;        ///< Solution of the linear system.
+    bool                   factored;        ///< Was the coefficient matrix factored by the last call to factorize()?
+    Options                factor_options;  ///< Options passed to the last call to factorize().
 
 }; // class LinearSolver
 
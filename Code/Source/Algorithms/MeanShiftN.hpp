@@ -0,0 +1,631 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_Algorithms_MeanShiftN_hpp__
+#define __Thea_Algorithms_MeanShiftN_hpp__
+
+#include "../Common.hpp"
+#include "../Array.hpp"
+#include "../BallN.hpp"
+#include "../Math.hpp"
+#include "../ParallelFor.hpp"
+#include "../VectorN.hpp"
+#include "IntersectionTester.hpp"
+#include "KDTreeN.hpp"
+#include "MetricL2.hpp"
+#include "PointTraitsN.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Thea {
+namespace Algorithms {
+
+/**
+ * Mean-shift clustering of points in N-space. Each seed is iteratively moved to the kernel-weighted mean of the input points in
+ * a window around it, until it converges to a local maximum (mode) of the estimated density. Nearby modes are then merged, and
+ * each input point is labeled with its nearest surviving mode.
+ *
+ * Neighborhoods are gathered by range queries on a kd-tree over the input points, so each iteration costs time proportional to
+ * the size of the window rather than the size of the dataset. By default, seeds are the centroids of the occupied cells of a
+ * grid with cell size equal to the bandwidth, which is far fewer than the number of points for dense data. Seeds are shifted in
+ * parallel, and modes are merged greedily (in decreasing order of density) using a second kd-tree over the converged seeds.
+ *
+ * The class can be used with any type T for which PointTraitsN<T, N, ScalarT> is defined.
+ */
+template <long N, typename ScalarT = Real>
+class /* THEA_API */ MeanShiftN
+{
+  public:
+    typedef VectorN<N, ScalarT> VectorT;  ///< N-dimensional vector.
+
+    /** Kernel profiles (enum class). */
+    struct Kernel
+    {
+      /** Supported values. */
+      enum Value
+      {
+        FLAT,      ///< Uniform weights within the window (string: "flat").
+        GAUSSIAN   ///< Weights exp(-0.5 (d / h)^2) for distance d and bandwidth h (string: "gaussian").
+      };
+
+      THEA_ENUM_CLASS_BODY(Kernel)
+
+      THEA_ENUM_CLASS_STRINGS_BEGIN(Kernel)
+        THEA_ENUM_CLASS_STRING(FLAT,      "flat")
+        THEA_ENUM_CLASS_STRING(GAUSSIAN,  "gaussian")
+      THEA_ENUM_CLASS_STRINGS_END(Kernel)
+
+    }; // struct Kernel
+
+    /**
+     * %Options for mean-shift clustering. In most cases, passing a negative value for a normally non-negative parameter
+     * auto-selects a suitable value for that parameter.
+     */
+    class Options
+    {
+      public:
+        /** Constructor. Sets default options. */
+        Options()
+        : bandwidth(-1), kernel(Kernel::GAUSSIAN), kernel_support(-1), bin_seeding(true), bin_size(-1), min_bin_frequency(1),
+          max_iterations(300), convergence_threshold(1e-3), merge_radius(-1), parallelize(true), verbose(false)
+        {}
+
+        /**
+         * Kernel bandwidth (default -1). If negative, it is estimated from the data with the multivariate rule-of-thumb of
+         * estimateBandwidth().
+         */
+        Options & setBandwidth(double value) { bandwidth = value; return *this; }
+
+        /** Kernel profile (default Kernel::GAUSSIAN). */
+        Options & setKernel(Kernel value) { kernel = value; return *this; }
+
+        /**
+         * Radius of the window over which the kernel is evaluated, as a multiple of the bandwidth (default -1, which selects 1
+         * for the flat kernel and 3 for the Gaussian kernel).
+         */
+        Options & setKernelSupport(double value) { kernel_support = value; return *this; }
+
+        /**
+         * Seed from the centroids of occupied grid cells (true, default) or from every input point (false). The latter is much
+         * slower but finds the mode for each individual point.
+         */
+        Options & setBinSeeding(bool value) { bin_seeding = value; return *this; }
+
+        /** Size of grid cells for bin seeding (default -1, which selects the bandwidth). */
+        Options & setBinSize(double value) { bin_size = value; return *this; }
+
+        /** Minimum number of points in a grid cell for it to generate a seed (default 1). */
+        Options & setMinBinFrequency(long value) { min_bin_frequency = value; return *this; }
+
+        /** Maximum number of shifts per seed (default 300). */
+        Options & setMaxIterations(long value) { max_iterations = value; return *this; }
+
+        /** A seed has converged when its shift is less than this fraction of the bandwidth (default 0.001). */
+        Options & setConvergenceThreshold(double value) { convergence_threshold = value; return *this; }
+
+        /**
+         * Converged seeds closer than this distance to a denser mode are merged into it (default -1, which selects the
+         * bandwidth). Passing zero retains every distinct converged seed as a mode.
+         */
+        Options & setMergeRadius(double value) { merge_radius = value; return *this; }
+
+        /** Accelerate computations by parallelization or not (default true). */
+        Options & setParallelize(bool value) { parallelize = value; return *this; }
+
+        /** Set whether progress information will be printed to the console or not (default false). */
+        Options & setVerbose(bool value) { verbose = value; return *this; }
+
+        /** Get the set of default options. */
+        static Options const & defaults() { static Options const def; return def; }
+
+      private:
+        double bandwidth;              ///< Kernel bandwidth.
+        Kernel kernel;                 ///< Kernel profile.
+        double kernel_support;         ///< Radius of the kernel window, as a multiple of the bandwidth.
+        bool bin_seeding;              ///< Seed from occupied grid cells instead of every point?
+        double bin_size;               ///< Size of grid cells for bin seeding.
+        long min_bin_frequency;        ///< Minimum number of points in a cell for it to generate a seed.
+        long max_iterations;           ///< Maximum number of shifts per seed.
+        double convergence_threshold;  ///< Convergence threshold, as a fraction of the bandwidth.
+        double merge_radius;           ///< Radius for merging modes.
+        bool parallelize;              ///< Accelerate computations by parallelization.
+        bool verbose;                  ///< Print progress information to the console.
+
+        friend class MeanShiftN;
+
+    }; // class Options
+
+    /** Constructor. */
+    MeanShiftN(Options const & options_ = Options::defaults()) : options(options_), bandwidth(-1) {}
+
+    /** Get the current set of options. */
+    Options const & getOptions() const { return options; }
+
+    /** Set the options. */
+    void setOptions(Options const & options_) { options = options_; }
+
+    /**
+     * Cluster a set of points. Any previous results are discarded.
+     *
+     * @param begin Iterator to the first point.
+     * @param end Iterator to one position beyond the last point.
+     * @param weights If non-null, the (non-negative) weight of each point, in sequence.
+     *
+     * @return The number of modes found.
+     */
+    template <typename InputIterator>
+    long cluster(InputIterator begin, InputIterator end, ScalarT const * weights = NULL)
+    {
+      clear();
+
+      for (InputIterator pi = begin; pi != end; ++pi)
+        points.push_back(PointTraitsN<typename std::iterator_traits<InputIterator>::value_type, N, ScalarT>::getPosition(*pi));
+
+      if (points.empty())
+        return 0;
+
+      if (weights)
+        point_weights.assign(weights, weights + points.size());
+
+      bandwidth = (options.bandwidth > 0 ? static_cast<ScalarT>(options.bandwidth)
+                                         : estimateBandwidth(points.begin(), points.end()));
+      if (options.verbose)
+        THEA_CONSOLE << "MeanShift: Bandwidth = " << bandwidth;
+
+      // Shift the seeds to their modes
+      KDTree point_kdtree(points.begin(), points.end());
+      initSeeds();
+      if (options.verbose)
+        THEA_CONSOLE << "MeanShift: Shifting " << seeds.size() << " seed(s) for " << points.size() << " point(s)";
+
+      converged_seeds = seeds;
+      seed_densities.resize(seeds.size());
+
+      SeedShifter shifter(this, &point_kdtree);
+      parallelFor((long)seeds.size(), shifter);
+
+      // Merge nearby modes and label points
+      mergeModes();
+      labelPoints();
+
+      if (options.verbose)
+        THEA_CONSOLE << "MeanShift: Found " << modes.size() << " mode(s)";
+
+      return numModes();
+    }
+
+    /** Get the bandwidth used by the last call to cluster(). */
+    ScalarT getBandwidth() const { return bandwidth; }
+
+    /** Get the number of points clustered by the last call to cluster(). */
+    long numPoints() const { return (long)points.size(); }
+
+    /** Get the number of modes (clusters) found. */
+    long numModes() const { return (long)modes.size(); }
+
+    /** Get a mode. Modes are ordered by decreasing estimated density. */
+    VectorT const & getMode(long i) const { return modes[(array_size_t)i]; }
+
+    /** Get the total weight of the points assigned to a mode (the number of points, if the input was unweighted). */
+    ScalarT getModeSupport(long i) const { return mode_supports[(array_size_t)i]; }
+
+    /** Get the index of the mode to which a point is assigned, or a negative value if no modes were found. */
+    long getLabel(long point_index) const { return labels[(array_size_t)point_index]; }
+
+    /** Get the index of the mode to which each point is assigned, in input order. */
+    TheaArray<long> const & getLabels() const { return labels; }
+
+    /** Get the number of seeds. */
+    long numSeeds() const { return (long)seeds.size(); }
+
+    /** Get the initial position of a seed. */
+    VectorT const & getSeed(long i) const { return seeds[(array_size_t)i]; }
+
+    /**
+     * Get the final position of a seed, before modes were merged. This is useful for applying a custom merging strategy to the
+     * raw output of mean-shift.
+     */
+    VectorT const & getConvergedSeed(long i) const { return converged_seeds[(array_size_t)i]; }
+
+    /** Get the index of the mode into which a seed was merged, or a negative value if the seed had no points in its window. */
+    long getSeedMode(long i) const { return seed_modes[(array_size_t)i]; }
+
+    /** Discard all results. */
+    void clear()
+    {
+      points.clear(); point_weights.clear();
+      seeds.clear(); converged_seeds.clear(); seed_densities.clear(); seed_modes.clear();
+      modes.clear(); mode_supports.clear();
+      labels.clear();
+      bandwidth = -1;
+    }
+
+    /**
+     * Estimate a kernel bandwidth for a set of points, using the normal reference rule of Silverman (1986), eq. 4.14:
+     * h = sigma * (4 / ((N + 2) n))^(1 / (N + 4)), where sigma is the root-mean-square standard deviation along the coordinate
+     * axes.
+     */
+    template <typename InputIterator> static ScalarT estimateBandwidth(InputIterator begin, InputIterator end)
+    {
+      typedef typename std::iterator_traits<InputIterator>::value_type T;
+
+      VectorN<N, double> sum(0), sum_squares(0);
+      long n = 0;
+      for (InputIterator pi = begin; pi != end; ++pi, ++n)
+      {
+        VectorT p = PointTraitsN<T, N, ScalarT>::getPosition(*pi);
+        for (long i = 0; i < N; ++i)
+        {
+          sum[i] += p[i];
+          sum_squares[i] += p[i] * p[i];
+        }
+      }
+
+      if (n <= 1)
+        return 1;
+
+      double variance = 0;
+      for (long i = 0; i < N; ++i)
+      {
+        double mean = sum[i] / n;
+        variance += std::max(sum_squares[i] / n - mean * mean, 0.0);
+      }
+
+      double sigma = std::sqrt(variance / N);
+      if (sigma <= 0)
+        return 1;  // all points coincide, so any positive bandwidth will do
+
+      return static_cast<ScalarT>(sigma * std::pow(4.0 / ((N + 2) * (double)n), 1.0 / (N + 4)));
+    }
+
+  private:
+    typedef KDTreeN<VectorT, N, ScalarT> KDTree;  ///< A kd-tree on points.
+    typedef BallN<N, ScalarT> Ball;               ///< A ball in N-space.
+
+    /** Accumulates the kernel-weighted mean of the points in a window. */
+    class WindowAccumulator
+    {
+      public:
+        /** Constructor. */
+        WindowAccumulator(MeanShiftN const * parent_, VectorT const & center_)
+        : parent(parent_), center(center_), sum(0), sum_weights(0)
+        {
+          inv_sqbw = 1 / (parent->bandwidth * parent->bandwidth);
+        }
+
+        /** Called for each point in the window. */
+        bool operator()(long index, VectorT & p)
+        {
+          ScalarT w = (parent->point_weights.empty() ? 1 : parent->point_weights[(array_size_t)index]);
+          if (parent->options.kernel == Kernel::GAUSSIAN)
+          {
+            ScalarT sqdist = (p - center).squaredLength() * inv_sqbw;
+            w *= std::exp(-0.5f * sqdist);
+          }
+
+          sum += w * p;
+          sum_weights += w;
+
+          return false;
+        }
+
+        MeanShiftN const * parent;
+        VectorT center;
+        ScalarT inv_sqbw;
+        VectorT sum;
+        ScalarT sum_weights;
+
+    }; // class WindowAccumulator
+
+    /** Shifts a seed to its mode. */
+    class SeedShifter
+    {
+      public:
+        /** Constructor. */
+        SeedShifter(MeanShiftN * parent_, KDTree * point_kdtree_) : parent(parent_), point_kdtree(point_kdtree_) {}
+
+        /** Shift the seed with index \a i. */
+        void operator()(long i)
+        {
+          double radius = parent->bandwidth * parent->getKernelSupport();
+          double threshold = parent->bandwidth * parent->options.convergence_threshold;
+
+          VectorT x = parent->seeds[(array_size_t)i];
+          ScalarT density = 0;
+          for (long iter = 0; parent->options.max_iterations < 0 || iter < parent->options.max_iterations; ++iter)
+          {
+            WindowAccumulator acc(parent, x);
+            point_kdtree->template processRangeUntil<IntersectionTester>(Ball(x, static_cast<ScalarT>(radius)), &acc);
+
+            density = acc.sum_weights;
+            if (acc.sum_weights <= 0)
+              break;
+
+            VectorT next = acc.sum / acc.sum_weights;
+            double shift = (next - x).length();
+            x = next;
+
+            if (shift <= threshold)
+              break;
+          }
+
+          parent->converged_seeds[(array_size_t)i] = x;
+          parent->seed_densities[(array_size_t)i] = density;
+        }
+
+      private:
+        MeanShiftN * parent;
+        KDTree * point_kdtree;
+
+    }; // class SeedShifter
+
+    /** Labels each point with its nearest mode. */
+    class PointLabeler
+    {
+      public:
+        /** Constructor. */
+        PointLabeler(MeanShiftN * parent_, KDTree const * mode_kdtree_) : parent(parent_), mode_kdtree(mode_kdtree_) {}
+
+        /** Label the point with index \a i. */
+        void operator()(long i)
+        {
+          parent->labels[(array_size_t)i] = mode_kdtree->template closestElement<MetricL2>(parent->points[(array_size_t)i]);
+        }
+
+      private:
+        MeanShiftN * parent;
+        KDTree const * mode_kdtree;
+
+    }; // class PointLabeler
+
+    /**
+     * Run a task on each index in [0, num_tasks), in parallel if possible. Tasks are handed out in small chunks since their
+     * costs can vary a lot (e.g. seeds in sparse regions converge much faster than seeds in dense ones).
+     */
+    template <typename TaskT> void parallelFor(long num_tasks, TaskT const & task)
+    {
+      long num_threads = (options.parallelize ? numThreadsForWork(num_tasks, 2) : 1);
+      Thea::parallelFor(num_tasks, task, std::max(num_tasks / (16 * num_threads), 1L), num_threads);
+    }
+
+    /** Get the radius of the kernel window, as a multiple of the bandwidth. */
+    double getKernelSupport() const
+    {
+      if (options.kernel_support > 0)
+        return options.kernel_support;
+
+      return options.kernel == Kernel::GAUSSIAN ? 3.0 : 1.0;
+    }
+
+    /** Generate the initial seeds. */
+    void initSeeds()
+    {
+      if (!options.bin_seeding)
+      {
+        seeds = points;
+        return;
+      }
+
+      double cell_size = (options.bin_size > 0 ? options.bin_size : bandwidth);
+      array_size_t num_points = points.size();
+
+      // Quantize the points to grid cells and sort them by cell, so that the points in each occupied cell are contiguous
+      cells.resize(num_points * N);
+      for (array_size_t i = 0; i < num_points; ++i)
+        for (long j = 0; j < N; ++j)
+          cells[i * N + j] = (long)std::floor(points[i][j] / cell_size);
+
+      TheaArray<long> order(num_points);
+      for (array_size_t i = 0; i < num_points; ++i)
+        order[i] = (long)i;
+
+      std::sort(order.begin(), order.end(), CellLess(&cells[0]));
+
+      // Seed from the centroid of each sufficiently populated cell
+      CellLess less(&cells[0]);
+      for (array_size_t b = 0; b < num_points; )
+      {
+        array_size_t e = b + 1;
+        while (e < num_points && !less(order[b], order[e]))
+          ++e;
+
+        if ((long)(e - b) >= options.min_bin_frequency)
+        {
+          VectorT c(0);
+          for (array_size_t i = b; i < e; ++i)
+            c += points[(array_size_t)order[i]];
+
+          seeds.push_back(c / static_cast<ScalarT>(e - b));
+        }
+
+        b = e;
+      }
+
+      cells.clear();
+
+      if (seeds.empty())
+      {
+        THEA_WARNING << "MeanShift: No grid cell has " << options.min_bin_frequency << " or more points, seeding from all points";
+        seeds = points;
+      }
+    }
+
+    /** Lexicographic comparison of the grid cells of two points. */
+    class CellLess
+    {
+      public:
+        CellLess(long const * cells_) : cells(cells_) {}
+
+        bool operator()(long i, long j) const
+        {
+          long const * ci = cells + i * N;
+          long const * cj = cells + j * N;
+          for (long k = 0; k < N; ++k)
+            if (ci[k] != cj[k])
+              return ci[k] < cj[k];
+
+          return false;
+        }
+
+      private:
+        long const * cells;
+
+    }; // class CellLess
+
+    /** Orders seeds by decreasing density, breaking ties by index. */
+    class DenserSeed
+    {
+      public:
+        DenserSeed(ScalarT const * densities_) : densities(densities_) {}
+
+        bool operator()(long i, long j) const
+        {
+          return densities[i] > densities[j] || (densities[i] == densities[j] && i < j);
+        }
+
+      private:
+        ScalarT const * densities;
+
+    }; // class DenserSeed
+
+    /** Marks seeds within a ball as belonging to a mode, unless they already belong to one. */
+    class SeedMerger
+    {
+      public:
+        SeedMerger(TheaArray<long> * seed_modes_, long mode_) : seed_modes(seed_modes_), mode(mode_) {}
+
+        bool operator()(long index, VectorT & p)
+        {
+          long & m = (*seed_modes)[(array_size_t)index];
+          if (m < 0) m = mode;
+          return false;
+        }
+
+      private:
+        TheaArray<long> * seed_modes;
+        long mode;
+
+    }; // class SeedMerger
+
+    /** Greedily merge converged seeds into modes, visiting them in order of decreasing density. */
+    void mergeModes()
+    {
+      array_size_t num_seeds = seeds.size();
+      seed_modes.resize(num_seeds);
+      std::fill(seed_modes.begin(), seed_modes.end(), -1);
+
+      TheaArray<long> order;
+      order.reserve(num_seeds);
+      for (array_size_t i = 0; i < num_seeds; ++i)
+        if (seed_densities[i] > 0)
+          order.push_back((long)i);
+
+      if (order.empty())
+        return;
+
+      std::sort(order.begin(), order.end(), DenserSeed(&seed_densities[0]));
+
+      double radius = (options.merge_radius >= 0 ? options.merge_radius : bandwidth);
+      KDTree seed_kdtree(converged_seeds.begin(), converged_seeds.end());
+
+      for (array_size_t i = 0; i < order.size(); ++i)
+      {
+        long s = order[i];
+        if (seed_modes[(array_size_t)s] >= 0)
+          continue;
+
+        long mode = (long)modes.size();
+        VectorT const & x = converged_seeds[(array_size_t)s];
+        modes.push_back(x);
+        seed_modes[(array_size_t)s] = mode;
+
+        if (radius > 0)
+        {
+          SeedMerger merger(&seed_modes, mode);
+          seed_kdtree.template processRangeUntil<IntersectionTester>(Ball(x, static_cast<ScalarT>(radius)), &merger);
+        }
+      }
+
+      // Empty seeds (which converged nowhere) were marked by the range queries above, so unmark them
+      for (array_size_t i = 0; i < num_seeds; ++i)
+        if (seed_densities[i] <= 0)
+          seed_modes[i] = -1;
+    }
+
+    /** Assign each point to its nearest mode. */
+    void labelPoints()
+    {
+      labels.resize(points.size());
+      std::fill(labels.begin(), labels.end(), -1);
+      mode_supports.resize(modes.size());
+      std::fill(mode_supports.begin(), mode_supports.end(), static_cast<ScalarT>(0));
+
+      if (modes.empty())
+        return;
+
+      KDTree mode_kdtree(modes.begin(), modes.end());
+      PointLabeler labeler(this, &mode_kdtree);
+      parallelFor((long)points.size(), labeler);
+
+      for (array_size_t i = 0; i < points.size(); ++i)
+        if (labels[i] >= 0)
+          mode_supports[(array_size_t)labels[i]] += (point_weights.empty() ? 1 : point_weights[i]);
+    }
+
+    Options options;                  ///< Clustering options.
+    ScalarT bandwidth;                ///< Kernel bandwidth used for the last clustering.
+    TheaArray<VectorT> points;        ///< Input points.
+    TheaArray<ScalarT> point_weights; ///< Input point weights (empty if unweighted).
+    TheaArray<long> cells;            ///< Grid cell coordinates of points, used for bin seeding.
+    TheaArray<VectorT> seeds;         ///< Initial positions of seeds.
+    TheaArray<VectorT> converged_seeds;  ///< Final positions of seeds.
+    TheaArray<ScalarT> seed_densities;   ///< Kernel-weighted mass in the window of each converged seed.
+    TheaArray<long> seed_modes;       ///< Index of the mode into which each seed was merged.
+    TheaArray<VectorT> modes;         ///< Modes, in order of decreasing density.
+    TheaArray<ScalarT> mode_supports; ///< Total weight of points assigned to each mode.
+    TheaArray<long> labels;           ///< Mode assigned to each point.
+
+}; // class MeanShiftN
+
+} // namespace Algorithms
+} // namespace Thea
+
+#endif
@@ -153,6 +153,7 @@ class THEA_API Pyramid1D : public Serializable
     TheaArray< TheaArray<Real> > levels;
 
     friend class PyramidMatch;
+    friend class PyramidMatchCorpus;
 
 }; // class Pyramid1D
 
@@ -292,6 +293,7 @@ class THEA_API Pyramid2D : public Serializable
     TheaArray<Array2D> levels;
 
     friend class PyramidMatch;
+    friend class PyramidMatchCorpus;
 
 }; // class Pyramid2D
 
@@ -408,6 +410,7 @@ class THEA_API Pyramid3D : public Serializable
     TheaArray<Array3D> levels;
 
     friend class PyramidMatch;
+    friend class PyramidMatchCorpus;
 
 }; // class Pyramid3D
 
@@ -0,0 +1,635 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "PyramidMatchCorpus.hpp"
+#include "../BoundedSortedArray.hpp"
+#include "../Math.hpp"
+#include "../ParallelFor.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#  define THEA_PYRAMID_MATCH_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define THEA_PYRAMID_MATCH_SSE2
+#endif
+
+namespace Thea {
+namespace Algorithms {
+
+namespace PyramidMatchCorpusInternal {
+
+// The data of each pyramid level is padded to a multiple of this many elements, which is a multiple of every supported SIMD
+// width. Padding elements are zero, and all kernels evaluate to zero on a pair of zeros, so they don't affect the results.
+static long const PAD_WIDTH = 8;
+
+// Number of query pyramids processed together by a thread
+static long const ROW_TILE_SIZE = 16;
+
+// Target size of the level data of the pyramids in a column tile, chosen to fit comfortably in the L2 cache
+static long const COLUMN_TILE_BYTES = 256 * 1024;
+
+// Minimum number of (padded) bin comparisons to give each thread
+static double const MIN_WORK_PER_THREAD = 1 << 22;
+
+#if defined(THEA_PYRAMID_MATCH_AVX) || defined(THEA_PYRAMID_MATCH_SSE2)
+
+#define THEA_PYRAMID_MATCH_SIMD
+
+// Wrappers for the SIMD instructions on packed floats, selected by the instruction set the library is compiled for.
+struct SimdOps
+{
+#if defined(THEA_PYRAMID_MATCH_AVX)
+
+  typedef __m256 Vec;
+  static int const WIDTH = 8;
+
+  static Vec zero() { return _mm256_setzero_ps(); }
+  static Vec one() { return _mm256_set1_ps(1.0f); }
+  static Vec load(float const * p) { return _mm256_loadu_ps(p); }
+  static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+  static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+  static Vec div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+  static Vec min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+  static Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+  static Vec abs(Vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+  static float sum(Vec a)
+  {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+  }
+
+#else
+
+  typedef __m128 Vec;
+  static int const WIDTH = 4;
+
+  static Vec zero() { return _mm_setzero_ps(); }
+  static Vec one() { return _mm_set1_ps(1.0f); }
+  static Vec load(float const * p) { return _mm_loadu_ps(p); }
+  static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+  static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+  static Vec div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+  static Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+  static Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+  static Vec abs(Vec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+  static float sum(Vec a)
+  {
+    __m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+  }
+
+#endif
+};
+
+#endif // defined(THEA_PYRAMID_MATCH_AVX) || defined(THEA_PYRAMID_MATCH_SSE2)
+
+// Per-bin terms of the kernels. Each kernel accumulates a non-negative term per bin, and the sum is multiplied by SIGN to get
+// the similarity, matching PyramidInternal::similarity() in PyramidMatch.cpp.
+struct HIKOp
+{
+  static Real const SIGN;
+  static Real apply(Real x, Real y) { return std::min(x, y); }
+#ifdef THEA_PYRAMID_MATCH_SIMD
+  static SimdOps::Vec apply(SimdOps::Vec x, SimdOps::Vec y) { return SimdOps::min(x, y); }
+#endif
+};
+
+struct L1Op
+{
+  static Real const SIGN;
+  static Real apply(Real x, Real y) { return std::fabs(x - y); }
+#ifdef THEA_PYRAMID_MATCH_SIMD
+  static SimdOps::Vec apply(SimdOps::Vec x, SimdOps::Vec y) { return SimdOps::abs(SimdOps::sub(x, y)); }
+#endif
+};
+
+struct L2Op
+{
+  static Real const SIGN;
+  static Real apply(Real x, Real y) { return Math::square(x - y); }
+#ifdef THEA_PYRAMID_MATCH_SIMD
+  static SimdOps::Vec apply(SimdOps::Vec x, SimdOps::Vec y) { SimdOps::Vec d = SimdOps::sub(x, y); return SimdOps::mul(d, d); }
+#endif
+};
+
+struct ChiSquaredOp
+{
+  static Real const SIGN;
+  static Real apply(Real x, Real y) { return Math::square(x - y) / (x < 1 ? 1 : x); }
+#ifdef THEA_PYRAMID_MATCH_SIMD
+  static SimdOps::Vec apply(SimdOps::Vec x, SimdOps::Vec y)
+  {
+    SimdOps::Vec d = SimdOps::sub(x, y);
+    return SimdOps::div(SimdOps::mul(d, d), SimdOps::max(x, SimdOps::one()));
+  }
+#endif
+};
+
+Real const HIKOp::SIGN         =  1;
+Real const L1Op::SIGN          = -1;
+Real const L2Op::SIGN          = -1;
+Real const ChiSquaredOp::SIGN  = -1;
+
+// Sum of the per-bin terms of a kernel over two arrays of n elements.
+template <typename OpT>
+Real
+levelSum(Real const * a, Real const * b, long n)
+{
+  Real sum = 0;
+  long i = 0;
+
+#ifdef THEA_PYRAMID_MATCH_SIMD
+  // Two accumulators hide the latency of the additions
+  int const W = SimdOps::WIDTH;
+  SimdOps::Vec acc0 = SimdOps::zero(), acc1 = SimdOps::zero();
+  for ( ; i + 2 * W <= n; i += 2 * W)
+  {
+    acc0 = SimdOps::add(acc0, OpT::apply(SimdOps::load(a + i),     SimdOps::load(b + i)));
+    acc1 = SimdOps::add(acc1, OpT::apply(SimdOps::load(a + i + W), SimdOps::load(b + i + W)));
+  }
+
+  for ( ; i + W <= n; i += W)
+    acc0 = SimdOps::add(acc0, OpT::apply(SimdOps::load(a + i), SimdOps::load(b + i)));
+
+  sum = SimdOps::sum(SimdOps::add(acc0, acc1));
+#endif
+
+  for ( ; i < n; ++i)
+    sum += OpT::apply(a[i], b[i]);
+
+  return sum;
+}
+
+// Get the number of columns of a tile, such that the level data of the columns fits in the cache.
+long
+columnTileSize(long bytes_per_pyramid)
+{
+  return Math::clamp(COLUMN_TILE_BYTES / std::max(bytes_per_pyramid, 1L), 8L, 256L);
+}
+
+// Compute the similarities between rows [r0, r1) of the query levels and columns [c0, c1) of the corpus levels, and store them
+// in a row-major block with the given row stride. The block is processed in column tiles, and each tile level by level, so the
+// data being compared stays in the cache.
+template <typename OpT, typename LevelT>
+void
+computeBlock(TheaArray<LevelT> const & qlevels, TheaArray<LevelT> const & clevels, long r0, long r1, long c0, long c1,
+             Real * result, long result_stride)
+{
+  for (long i = r0; i < r1; ++i)
+  {
+    Real * row = result + (i - r0) * result_stride;
+    for (long j = c0; j < c1; ++j)
+      row[j - c0] = 0;
+  }
+
+  long bytes_per_pyramid = 0;
+  for (array_size_t l = 0; l < clevels.size(); ++l)
+    bytes_per_pyramid += clevels[l].stride * (long)sizeof(Real);
+
+  long tile_size = columnTileSize(bytes_per_pyramid);
+  for (long t0 = c0; t0 < c1; t0 += tile_size)
+  {
+    long t1 = std::min(t0 + tile_size, c1);
+
+    for (array_size_t l = 0; l < clevels.size(); ++l)
+    {
+      LevelT const & qlevel = qlevels[l];
+      LevelT const & clevel = clevels[l];
+      Real scale = OpT::SIGN * clevel.scale;
+
+      for (long i = r0; i < r1; ++i)
+      {
+        Real const * a = qlevel[i];
+        Real * row = result + (i - r0) * result_stride - c0;
+
+        for (long j = t0; j < t1; ++j)
+          row[j] += scale * levelSum<OpT>(a, clevel[j], clevel.stride);
+      }
+    }
+  }
+}
+
+// Dispatch computeBlock() on the kernel.
+template <typename LevelT>
+void
+computeBlock(PyramidMatch::Kernel kernel, TheaArray<LevelT> const & qlevels, TheaArray<LevelT> const & clevels, long r0,
+             long r1, long c0, long c1, Real * result, long result_stride)
+{
+  switch (kernel)
+  {
+    case PyramidMatch::Kernel::L1:
+      computeBlock<L1Op>(qlevels, clevels, r0, r1, c0, c1, result, result_stride); break;
+
+    case PyramidMatch::Kernel::L2:
+      computeBlock<L2Op>(qlevels, clevels, r0, r1, c0, c1, result, result_stride); break;
+
+    case PyramidMatch::Kernel::CHI_SQUARED:
+      computeBlock<ChiSquaredOp>(qlevels, clevels, r0, r1, c0, c1, result, result_stride); break;
+
+    default: /* HIK */
+      computeBlock<HIKOp>(qlevels, clevels, r0, r1, c0, c1, result, result_stride);
+  }
+}
+
+// Run a task on each tile in [0, num_tiles), in parallel if the total amount of work (number of bin comparisons) is large enough.
+// Tiles are handed out one at a time since their costs can differ, e.g. in the upper triangle of a symmetric matrix.
+template <typename TaskT>
+void
+parallelForTiles(long num_tiles, double work, TaskT const & task)
+{
+  parallelFor(num_tiles, task, 1, numThreadsForWork(work, MIN_WORK_PER_THREAD));
+}
+
+// Computes a tile of rows of a similarity matrix. If the matrix is symmetric, only the blocks on and above the diagonal are
+// computed, and mirrored to the lower triangle.
+template <typename LevelT>
+class MatrixTask
+{
+  public:
+    MatrixTask(PyramidMatch::Kernel kernel_, TheaArray<LevelT> const * qlevels_, TheaArray<LevelT> const * clevels_,
+               long num_rows_, long num_cols_, bool symmetric_, Real * result_)
+    : kernel(kernel_), qlevels(qlevels_), clevels(clevels_), num_rows(num_rows_), num_cols(num_cols_), symmetric(symmetric_),
+      result(result_)
+    {}
+
+    void operator()(long tile)
+    {
+      long r0 = tile * ROW_TILE_SIZE;
+      long r1 = std::min(r0 + ROW_TILE_SIZE, num_rows);
+      long c0 = (symmetric ? r0 : 0);
+
+      computeBlock(kernel, *qlevels, *clevels, r0, r1, c0, num_cols, result + r0 * num_cols + c0, num_cols);
+
+      if (symmetric)
+      {
+        for (long i = r0; i < r1; ++i)
+          for (long j = i + 1; j < num_cols; ++j)
+            result[j * num_cols + i] = result[i * num_cols + j];
+      }
+    }
+
+  private:
+    PyramidMatch::Kernel kernel;
+    TheaArray<LevelT> const * qlevels;
+    TheaArray<LevelT> const * clevels;
+    long num_rows, num_cols;
+    bool symmetric;
+    Real * result;
+
+}; // class MatrixTask
+
+// A corpus pyramid and its similarity to a query.
+struct ScoredIndex
+{
+  Real score;
+  long index;
+
+  ScoredIndex() {}
+  ScoredIndex(Real score_, long index_) : score(score_), index(index_) {}
+};
+
+// Orders scored indices by decreasing score, breaking ties by increasing index so the results are deterministic.
+struct ScoredIndexLess
+{
+  bool operator()(ScoredIndex const & a, ScoredIndex const & b) const
+  {
+    return a.score > b.score || (a.score == b.score && a.index < b.index);
+  }
+};
+
+// Finds the most similar corpus pyramids to each query in a tile of rows, column tile by column tile. Only the current block of
+// similarities is held in memory.
+template <typename LevelT>
+class TopKTask
+{
+  public:
+    TopKTask(PyramidMatch::Kernel kernel_, TheaArray<LevelT> const * qlevels_, TheaArray<LevelT> const * clevels_,
+             long num_rows_, long num_cols_, long k_, bool exclude_self_, long * indices_, Real * scores_)
+    : kernel(kernel_), qlevels(qlevels_), clevels(clevels_), num_rows(num_rows_), num_cols(num_cols_), k(k_),
+      exclude_self(exclude_self_), indices(indices_), scores(scores_)
+    {}
+
+    void operator()(long tile)
+    {
+      typedef BoundedSortedArray<ScoredIndex, ScoredIndexLess> Neighbors;
+
+      long r0 = tile * ROW_TILE_SIZE;
+      long r1 = std::min(r0 + ROW_TILE_SIZE, num_rows);
+
+      static long const BLOCK_COLS = 1024;
+      TheaArray<Real> block((array_size_t)(ROW_TILE_SIZE * BLOCK_COLS));
+      TheaArray<Neighbors> nbrs((array_size_t)(r1 - r0), Neighbors((int)k));
+
+      for (long c0 = 0; c0 < num_cols; c0 += BLOCK_COLS)
+      {
+        long c1 = std::min(c0 + BLOCK_COLS, num_cols);
+        computeBlock(kernel, *qlevels, *clevels, r0, r1, c0, c1, &block[0], BLOCK_COLS);
+
+        for (long i = r0; i < r1; ++i)
+        {
+          Neighbors & row_nbrs = nbrs[(array_size_t)(i - r0)];
+          Real const * row = &block[(array_size_t)((i - r0) * BLOCK_COLS)];
+
+          for (long j = c0; j < c1; ++j)
+            if (!exclude_self || j != i)
+              row_nbrs.insert(ScoredIndex(row[j - c0], j));
+        }
+      }
+
+      for (long i = r0; i < r1; ++i)
+      {
+        Neighbors const & row_nbrs = nbrs[(array_size_t)(i - r0)];
+        for (long m = 0; m < k; ++m)
+        {
+          if (m < row_nbrs.size())
+          {
+            indices[i * k + m] = row_nbrs[(int)m].index;
+            scores[i * k + m] = row_nbrs[(int)m].score;
+          }
+          else
+          {
+            indices[i * k + m] = -1;
+            scores[i * k + m] = -Math::inf<Real>();
+          }
+        }
+      }
+    }
+
+  private:
+    PyramidMatch::Kernel kernel;
+    TheaArray<LevelT> const * qlevels;
+    TheaArray<LevelT> const * clevels;
+    long num_rows, num_cols, k;
+    bool exclude_self;
+    long * indices;
+    Real * scores;
+
+}; // class TopKTask
+
+} // namespace PyramidMatchCorpusInternal
+
+PyramidMatchCorpus::PyramidMatchCorpus(Kernel kernel_, int max_levels_, Real attenuation_factor_)
+: kernel(kernel_),
+  max_levels(max_levels_),
+  attenuation_factor(attenuation_factor_ > 0 ? attenuation_factor_ : 0.5f),
+  num_dims(0),
+  nx(0),
+  ny(0),
+  nz(0),
+  num_pyramids(0)
+{}
+
+void
+PyramidMatchCorpus::clear()
+{
+  num_dims = nx = ny = nz = 0;
+  num_pyramids = 0;
+  levels.clear();
+}
+
+void
+PyramidMatchCorpus::initLevels(int num_dims_, int nx_, int ny_, int nz_, int num_levels_, TheaArray<long> const & level_sizes)
+{
+  using namespace PyramidMatchCorpusInternal;
+
+  int num_used_levels = (max_levels > 0 ? std::min(max_levels, num_levels_) : num_levels_);
+
+  if (num_pyramids <= 0)
+  {
+    num_dims = num_dims_;
+    nx = nx_;
+    ny = ny_;
+    nz = nz_;
+
+    levels.resize((array_size_t)num_used_levels);
+    Real scale = 1;
+    for (array_size_t i = 0; i < levels.size(); ++i)
+    {
+      levels[i].size = level_sizes[i];
+      levels[i].stride = ((level_sizes[i] + PAD_WIDTH - 1) / PAD_WIDTH) * PAD_WIDTH;
+      levels[i].scale = scale;
+      levels[i].data.clear();
+
+      scale *= attenuation_factor;
+    }
+  }
+  else
+  {
+    alwaysAssertM(num_dims_ == num_dims && nx_ == nx && ny_ == ny && nz_ == nz && num_used_levels == (int)levels.size(),
+                  "PyramidMatchCorpus: All pyramids in the corpus must have the same dimensions");
+  }
+}
+
+void
+PyramidMatchCorpus::appendLevel(int level, TheaArray<Real> const & level_data)
+{
+  Level & lev = levels[(array_size_t)level];
+  debugAssertM((long)level_data.size() == lev.size, "PyramidMatchCorpus: Pyramid level has unexpected size");
+
+  lev.data.insert(lev.data.end(), level_data.begin(), level_data.end());
+  lev.data.resize(lev.data.size() + (array_size_t)(lev.stride - lev.size), 0);
+}
+
+long
+PyramidMatchCorpus::add(Pyramid1D const & pyramid)
+{
+  TheaArray<long> level_sizes((array_size_t)pyramid.num_levels);
+  for (int i = 0; i < pyramid.num_levels; ++i)
+    level_sizes[(array_size_t)i] = (long)pyramid.levels[(array_size_t)i].size();
+
+  initLevels(1, pyramid.baseSize(), 1, 1, pyramid.num_levels, level_sizes);
+
+  for (array_size_t i = 0; i < levels.size(); ++i)
+    appendLevel((int)i, pyramid.levels[i]);
+
+  return num_pyramids++;
+}
+
+long
+PyramidMatchCorpus::add(Pyramid2D const & pyramid)
+{
+  TheaArray<long> level_sizes((array_size_t)pyramid.num_levels);
+  for (int i = 0; i < pyramid.num_levels; ++i)
+    level_sizes[(array_size_t)i] = (long)pyramid.levels[(array_size_t)i].data.size();
+
+  initLevels(2, pyramid.nx, pyramid.ny, 1, pyramid.num_levels, level_sizes);
+
+  for (array_size_t i = 0; i < levels.size(); ++i)
+    appendLevel((int)i, pyramid.levels[i].data);
+
+  return num_pyramids++;
+}
+
+long
+PyramidMatchCorpus::add(Pyramid3D const & pyramid)
+{
+  TheaArray<long> level_sizes((array_size_t)pyramid.num_levels);
+  for (int i = 0; i < pyramid.num_levels; ++i)
+    level_sizes[(array_size_t)i] = (long)pyramid.levels[(array_size_t)i].data.size();
+
+  initLevels(3, pyramid.nx, pyramid.ny, pyramid.nz, pyramid.num_levels, level_sizes);
+
+  for (array_size_t i = 0; i < levels.size(); ++i)
+    appendLevel((int)i, pyramid.levels[i].data);
+
+  return num_pyramids++;
+}
+
+void
+PyramidMatchCorpus::checkCompatible(PyramidMatchCorpus const & other) const
+{
+  alwaysAssertM(other.kernel == kernel && other.attenuation_factor == attenuation_factor,
+                "PyramidMatchCorpus: Can't compare corpora with different kernels or attenuation factors");
+  alwaysAssertM(other.num_dims == num_dims && other.nx == nx && other.ny == ny && other.nz == nz
+             && other.levels.size() == levels.size(),
+                "PyramidMatchCorpus: Can't compare pyramids of different dimensions");
+}
+
+Real
+PyramidMatchCorpus::similarity(long i, long j) const
+{
+  debugAssertM(i >= 0 && i < num_pyramids && j >= 0 && j < num_pyramids, "PyramidMatchCorpus: Pyramid index out of bounds");
+
+  Real result;
+  PyramidMatchCorpusInternal::computeBlock(kernel, levels, levels, i, i + 1, j, j + 1, &result, 1);
+  return result;
+}
+
+void
+PyramidMatchCorpus::computeSimilarities(PyramidMatchCorpus const & queries, long query_begin, long query_end, long begin,
+                                        long end, Real * result, long result_stride) const
+{
+  if (query_end <= query_begin || end <= begin)
+    return;
+
+  checkCompatible(queries);
+  alwaysAssertM(query_begin >= 0 && query_end <= queries.num_pyramids && begin >= 0 && end <= num_pyramids,
+                "PyramidMatchCorpus: Pyramid index range out of bounds");
+
+  if (result_stride <= 0) result_stride = end - begin;
+
+  PyramidMatchCorpusInternal::computeBlock(kernel, queries.levels, levels, query_begin, query_end, begin, end, result,
+                                           result_stride);
+}
+
+void
+PyramidMatchCorpus::computeSimilarityMatrix(Matrix<Real> & result) const
+{
+  computeSimilarityMatrix(*this, result);
+}
+
+void
+PyramidMatchCorpus::computeSimilarityMatrix(PyramidMatchCorpus const & queries, Matrix<Real> & result) const
+{
+  using namespace PyramidMatchCorpusInternal;
+
+  result.resize(queries.num_pyramids, num_pyramids);
+  if (queries.num_pyramids <= 0 || num_pyramids <= 0)
+    return;
+
+  checkCompatible(queries);
+
+  // All kernels except chi-squared are symmetric in their arguments
+  bool symmetric = (&queries == this && kernel != Kernel::CHI_SQUARED);
+
+  long num_tiles = (queries.num_pyramids + ROW_TILE_SIZE - 1) / ROW_TILE_SIZE;
+  double work = queries.num_pyramids * (double)num_pyramids * (levels.empty() ? 0 : levels[0].stride);
+  if (symmetric) work *= 0.5;
+
+  MatrixTask<Level> task(kernel, &queries.levels, &levels, queries.num_pyramids, num_pyramids, symmetric, result.data());
+  parallelForTiles(num_tiles, work, task);
+}
+
+void
+PyramidMatchCorpus::findMostSimilar(long k, Matrix<long> & indices, Matrix<Real> & scores, bool exclude_self) const
+{
+  using namespace PyramidMatchCorpusInternal;
+
+  alwaysAssertM(k >= 0, "PyramidMatchCorpus: Number of neighbors must be non-negative");
+
+  indices.resize(num_pyramids, k);
+  scores.resize(num_pyramids, k);
+  if (num_pyramids <= 0 || k <= 0)
+    return;
+
+  long num_tiles = (num_pyramids + ROW_TILE_SIZE - 1) / ROW_TILE_SIZE;
+  double work = num_pyramids * (double)num_pyramids * (levels.empty() ? 0 : levels[0].stride);
+
+  TopKTask<Level> task(kernel, &levels, &levels, num_pyramids, num_pyramids, k, exclude_self, indices.data(), scores.data());
+  parallelForTiles(num_tiles, work, task);
+}
+
+void
+PyramidMatchCorpus::findMostSimilar(PyramidMatchCorpus const & queries, long k, Matrix<long> & indices,
+                                    Matrix<Real> & scores) const
+{
+  using namespace PyramidMatchCorpusInternal;
+
+  alwaysAssertM(k >= 0, "PyramidMatchCorpus: Number of neighbors must be non-negative");
+
+  indices.resize(queries.num_pyramids, k);
+  scores.resize(queries.num_pyramids, k);
+  if (queries.num_pyramids <= 0 || k <= 0)
+    return;
+
+  if (num_pyramids > 0)
+    checkCompatible(queries);
+
+  long num_tiles = (queries.num_pyramids + ROW_TILE_SIZE - 1) / ROW_TILE_SIZE;
+  double work = queries.num_pyramids * (double)num_pyramids * (levels.empty() ? 0 : levels[0].stride);
+
+  TopKTask<Level> task(kernel, &queries.levels, &levels, queries.num_pyramids, num_pyramids, k, false, indices.data(),
+                       scores.data());
+  parallelForTiles(num_tiles, work, task);
+}
+
+} // namespace Algorithms
+} // namespace Thea
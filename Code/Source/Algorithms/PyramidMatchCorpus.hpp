@@ -0,0 +1,210 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_Algorithms_PyramidMatchCorpus_hpp__
+#define __Thea_Algorithms_PyramidMatchCorpus_hpp__
+
+#include "../Common.hpp"
+#include "../Array.hpp"
+#include "../Matrix.hpp"
+#include "../Noncopyable.hpp"
+#include "PyramidMatch.hpp"
+
+namespace Thea {
+namespace Algorithms {
+
+/**
+ * A set of pyramids of identical dimensions, stored for fast computation of all pairwise pyramid match similarities (see
+ * PyramidMatch). The data of each level of all pyramids is packed into a single contiguous array, with each pyramid's block
+ * zero-padded to a multiple of the SIMD width. The similarity matrix is computed in tiles, level by level, using SIMD
+ * instructions where available and multiple threads.
+ *
+ * The similarities match those returned by PyramidMatch::similarity() with the same parameters, up to rounding errors.
+ *
+ * Example:
+ * \code
+ * PyramidMatchCorpus corpus(PyramidMatch::Kernel::HIK);
+ * for (array_size_t i = 0; i < pyramids.size(); ++i)
+ *   corpus.add(*pyramids[i]);
+ *
+ * Matrix<long> indices;
+ * Matrix<Real> scores;
+ * corpus.findMostSimilar(10, indices, scores);  // 10 most similar pyramids to each pyramid, excluding itself
+ * \endcode
+ */
+class THEA_API PyramidMatchCorpus : private Noncopyable
+{
+  public:
+    THEA_DEF_POINTER_TYPES(PyramidMatchCorpus, shared_ptr, weak_ptr)
+
+    /** The kernel to use for comparing pyramid levels. */
+    typedef PyramidMatch::Kernel Kernel;
+
+    /**
+     * Constructor.
+     *
+     * @param kernel_ The kernel used to compare pyramid levels.
+     * @param max_levels_ The maximum number of levels (starting from the base) to compare. If non-positive, all levels are
+     *   compared.
+     * @param attenuation_factor_ The factor by which the contribution of each level is scaled relative to the previous
+     *   (finer) one. If non-positive, a default value of 0.5 is used.
+     */
+    PyramidMatchCorpus(Kernel kernel_ = Kernel::HIK, int max_levels_ = -1, Real attenuation_factor_ = -1);
+
+    /** Get the kernel used to compare pyramid levels. */
+    Kernel getKernel() const { return kernel; }
+
+    /** Get the number of pyramids in the corpus. */
+    long size() const { return num_pyramids; }
+
+    /** Check if the corpus is empty. */
+    bool isEmpty() const { return num_pyramids <= 0; }
+
+    /** Get the number of levels compared, or zero if the corpus is empty. */
+    int numLevels() const { return (int)levels.size(); }
+
+    /** Remove all pyramids from the corpus. */
+    void clear();
+
+    /**
+     * Add a pyramid with 1D support to the corpus. All pyramids in the corpus must have the same dimensions.
+     *
+     * @return The index of the pyramid in the corpus.
+     */
+    long add(Pyramid1D const & pyramid);
+
+    /**
+     * Add a pyramid with 2D support to the corpus. All pyramids in the corpus must have the same dimensions.
+     *
+     * @return The index of the pyramid in the corpus.
+     */
+    long add(Pyramid2D const & pyramid);
+
+    /**
+     * Add a pyramid with 3D support to the corpus. All pyramids in the corpus must have the same dimensions.
+     *
+     * @return The index of the pyramid in the corpus.
+     */
+    long add(Pyramid3D const & pyramid);
+
+    /** Get the similarity of two pyramids in the corpus. */
+    Real similarity(long i, long j) const;
+
+    /**
+     * Compute a block of similarities between pyramids of a query corpus (rows) and pyramids of this corpus (columns). The
+     * query corpus may be the same as this one, and must have the same pyramid dimensions and parameters.
+     *
+     * @param queries The query corpus.
+     * @param query_begin Index of the first query pyramid.
+     * @param query_end One past the index of the last query pyramid.
+     * @param begin Index of the first pyramid of this corpus.
+     * @param end One past the index of the last pyramid of this corpus.
+     * @param result Used to return the similarities, as a (query_end - query_begin) x (end - begin) row-major matrix.
+     * @param result_stride The number of elements between the starts of successive rows of \a result. If non-positive, rows
+     *   are assumed to be tightly packed.
+     */
+    void computeSimilarities(PyramidMatchCorpus const & queries, long query_begin, long query_end, long begin, long end,
+                             Real * result, long result_stride = -1) const;
+
+    /** Compute the N x N matrix of similarities between all pairs of pyramids in the corpus. */
+    void computeSimilarityMatrix(Matrix<Real> & result) const;
+
+    /**
+     * Compute the M x N matrix of similarities between the M pyramids of a query corpus and the N pyramids of this corpus. The
+     * query corpus must have the same pyramid dimensions and parameters.
+     */
+    void computeSimilarityMatrix(PyramidMatchCorpus const & queries, Matrix<Real> & result) const;
+
+    /**
+     * Find the \a k pyramids most similar to each pyramid in the corpus, without materializing the full similarity matrix.
+     *
+     * @param k The number of neighbors to find for each pyramid.
+     * @param indices Used to return the neighbors of each pyramid as an N x k matrix, sorted in order of decreasing similarity
+     *   (ties are broken by increasing index). If fewer than \a k neighbors exist, the remaining entries are set to -1.
+     * @param scores Used to return the similarities corresponding to \a indices, as an N x k matrix.
+     * @param exclude_self If true, a pyramid is not considered a neighbor of itself.
+     */
+    void findMostSimilar(long k, Matrix<long> & indices, Matrix<Real> & scores, bool exclude_self = true) const;
+
+    /**
+     * Find the \a k pyramids of this corpus most similar to each pyramid of a query corpus, without materializing the full
+     * similarity matrix. The query corpus must have the same pyramid dimensions and parameters. The results are returned as
+     * M x k matrices, as in findMostSimilar(long, Matrix<long> &, Matrix<Real> &, bool) const.
+     */
+    void findMostSimilar(PyramidMatchCorpus const & queries, long k, Matrix<long> & indices, Matrix<Real> & scores) const;
+
+  private:
+    /** The packed data of one level of all pyramids in the corpus. */
+    struct Level
+    {
+      long size;               ///< Number of bins in the level.
+      long stride;             ///< Number of elements per pyramid, i.e. the size padded to a multiple of the SIMD width.
+      Real scale;              ///< Weight of the level in the overall similarity.
+      TheaArray<Real> data;    ///< Level data of all pyramids, one block of length stride per pyramid.
+
+      /** Get the data of the level for a given pyramid. */
+      Real const * operator[](long i) const { return &data[(array_size_t)(i * stride)]; }
+    };
+
+    /**
+     * Check that a pyramid with the given dimensions can be added to the corpus, and set up the levels if the corpus is empty.
+     */
+    void initLevels(int num_dims_, int nx_, int ny_, int nz_, int num_levels_, TheaArray<long> const & level_sizes);
+
+    /** Append a level of a new pyramid to the packed data. */
+    void appendLevel(int level, TheaArray<Real> const & level_data);
+
+    /** Check that another corpus can be compared to this one. */
+    void checkCompatible(PyramidMatchCorpus const & other) const;
+
+    Kernel kernel;
+    int max_levels;
+    Real attenuation_factor;
+    int num_dims, nx, ny, nz;
+    long num_pyramids;
+    TheaArray<Level> levels;
+
+}; // class PyramidMatchCorpus
+
+} // namespace Algorithms
+} // namespace Thea
+
+#endif
@@ -0,0 +1,238 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "QueryStatistics.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace Thea {
+namespace Algorithms {
+
+namespace QueryStatisticsInternal {
+
+// Per-thread counter blocks of running threads, and the summed counts of threads that have exited.
+struct Registry
+{
+  boost::mutex mutex;
+  TheaArray<int64 *> blocks;
+  int64 retired[QueryStatistics::NUM_COUNTERS];
+
+  Registry() { std::memset(retired, 0, QueryStatistics::NUM_COUNTERS * sizeof(int64)); }
+};
+
+Registry &
+registry()
+{
+  static Registry r;
+  return r;
+}
+
+THEA_THREAD_LOCAL int64 * thread_counters = NULL;
+
+// Called when a thread that has counted something exits. Adds the thread's counts to the retired total and frees its block.
+void
+retireThread(int64 * block)
+{
+  Registry & r = registry();
+  {
+    boost::mutex::scoped_lock lock(r.mutex);
+
+    for (int j = 0; j < QueryStatistics::NUM_COUNTERS; ++j)
+      r.retired[j] += block[j];
+
+    TheaArray<int64 *>::iterator existing = std::find(r.blocks.begin(), r.blocks.end(), block);
+    if (existing != r.blocks.end())
+    {
+      *existing = r.blocks.back();
+      r.blocks.pop_back();
+    }
+  }
+
+  if (thread_counters == block)
+    thread_counters = NULL;
+
+  delete [] block;
+}
+
+// Owns the counter block of each thread, and retires it when the thread exits.
+boost::thread_specific_ptr<int64> &
+threadBlock()
+{
+  static boost::thread_specific_ptr<int64> tsp(retireThread);
+  return tsp;
+}
+
+int64 *
+registerThread()
+{
+  int64 * block = new int64[QueryStatistics::NUM_COUNTERS];
+  std::memset(block, 0, QueryStatistics::NUM_COUNTERS * sizeof(int64));
+
+  // Construct the registry before the thread-specific pointer, so that it is destroyed after it
+  Registry & r = registry();
+  {
+    boost::mutex::scoped_lock lock(r.mutex);
+    r.blocks.push_back(block);
+  }
+
+  threadBlock().reset(block);
+  thread_counters = block;
+
+  return block;
+}
+
+// Ratio of two counts, or zero if the denominator is zero.
+double
+ratio(int64 num, int64 den)
+{
+  return den > 0 ? num / (double)den : 0.0;
+}
+
+} // namespace QueryStatisticsInternal
+
+QueryStatistics::QueryStatistics()
+{
+  std::memset(counters, 0, NUM_COUNTERS * sizeof(int64));
+}
+
+char const *
+QueryStatistics::getName(Counter counter)
+{
+  switch (counter)
+  {
+    case PROXIMITY_QUERIES:    return "Proximity queries";
+    case NODES_VISITED:        return "Nodes visited";
+    case NODES_PRUNED:         return "Nodes pruned";
+    case LEAVES_VISITED:       return "Leaves visited";
+    case ELEMENTS_TESTED:      return "Elements tested";
+    case ACCELERATION_HITS:    return "Acceleration hits";
+    case RAY_QUERIES:          return "Ray queries";
+    case RAY_NODES_VISITED:    return "Ray nodes visited";
+    case RAY_ELEMENTS_TESTED:  return "Ray elements tested";
+    default:                   return "Unknown";
+  }
+}
+
+void
+QueryStatistics::increment(Counter counter, int64 n)
+{
+  using namespace QueryStatisticsInternal;
+
+  int64 * block = thread_counters;
+  if (!block)
+    block = registerThread();
+
+  block[counter] += n;
+}
+
+QueryStatistics
+QueryStatistics::aggregate()
+{
+  using namespace QueryStatisticsInternal;
+
+  QueryStatistics total;
+
+  Registry & r = registry();
+  boost::mutex::scoped_lock lock(r.mutex);
+
+  for (int j = 0; j < NUM_COUNTERS; ++j)
+    total.counters[j] = r.retired[j];
+
+  for (array_size_t i = 0; i < r.blocks.size(); ++i)
+    for (int j = 0; j < NUM_COUNTERS; ++j)
+      total.counters[j] += r.blocks[i][j];
+
+  return total;
+}
+
+void
+QueryStatistics::reset()
+{
+  using namespace QueryStatisticsInternal;
+
+  Registry & r = registry();
+  boost::mutex::scoped_lock lock(r.mutex);
+
+  std::memset(r.retired, 0, NUM_COUNTERS * sizeof(int64));
+  for (array_size_t i = 0; i < r.blocks.size(); ++i)
+    std::memset(r.blocks[i], 0, NUM_COUNTERS * sizeof(int64));
+}
+
+std::string
+QueryStatistics::toString() const
+{
+  using namespace QueryStatisticsInternal;
+
+  int64 nq = counters[PROXIMITY_QUERIES];
+  int64 nr = counters[RAY_QUERIES];
+
+  std::ostringstream oss;
+  oss << getName(PROXIMITY_QUERIES) << ": " << nq << '\n';
+  if (nq > 0)
+  {
+    Counter per_query[] = { NODES_VISITED, NODES_PRUNED, LEAVES_VISITED, ELEMENTS_TESTED };
+    for (size_t i = 0; i < sizeof(per_query) / sizeof(Counter); ++i)
+      oss << "  " << getName(per_query[i]) << ": " << counters[per_query[i]]
+          << " (" << ratio(counters[per_query[i]], nq) << " per query)\n";
+
+    int64 considered = counters[NODES_VISITED] + counters[NODES_PRUNED];
+    oss << "  Pruning efficiency: " << 100 * ratio(counters[NODES_PRUNED], considered) << "% of nodes considered\n";
+    oss << "  " << getName(ACCELERATION_HITS) << ": " << counters[ACCELERATION_HITS]
+        << " (" << 100 * ratio(counters[ACCELERATION_HITS], nq) << "% of queries)\n";
+  }
+
+  oss << getName(RAY_QUERIES) << ": " << nr << '\n';
+  if (nr > 0)
+  {
+    Counter per_query[] = { RAY_NODES_VISITED, RAY_ELEMENTS_TESTED };
+    for (size_t i = 0; i < sizeof(per_query) / sizeof(Counter); ++i)
+      oss << "  " << getName(per_query[i]) << ": " << counters[per_query[i]]
+          << " (" << ratio(counters[per_query[i]], nr) << " per query)\n";
+  }
+
+  return oss.str();
+}
+
+} // namespace Algorithms
+} // namespace Thea
@@ -0,0 +1,140 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_Algorithms_QueryStatistics_hpp__
+#define __Thea_Algorithms_QueryStatistics_hpp__
+
+#include "../Common.hpp"
+
+namespace Thea {
+namespace Algorithms {
+
+/**
+ * Counters for the work done by spatial queries (proximity and ray queries on KDTreeN and derived classes), useful for
+ * diagnosing poorly pruned searches. Counting is compiled in only if THEA_QUERY_STATISTICS is defined (CMake option of the
+ * same name), else the THEA_QUERY_STATS_ADD macro used at instrumentation points expands to nothing and there is no overhead.
+ *
+ * Each thread increments its own private block of counters, so instrumented queries may run concurrently without locking.
+ * The blocks of all running threads are summed on demand by aggregate(). When a thread exits, its counts are added to a
+ * retained total and its block is freed, so memory use does not grow with the number of threads created over time.
+ *
+ * The acceleration structure of a tree (see KDTreeN::enableNearestNeighborAcceleration()) is itself a kd-tree, so queries
+ * that consult it are counted twice, once for each tree.
+ */
+class THEA_API QueryStatistics
+{
+  public:
+    /** Recorded quantities. */
+    enum Counter
+    {
+      PROXIMITY_QUERIES,    ///< Number of proximity queries (one per query element for dual-tree queries).
+      NODES_VISITED,        ///< Number of nodes (or node pairs, for dual-tree queries) visited by proximity queries.
+      NODES_PRUNED,         ///< Number of nodes (or node pairs) skipped by proximity queries because of distance bounds.
+      LEAVES_VISITED,       ///< Number of leaves whose elements were tested by proximity queries.
+      ELEMENTS_TESTED,      ///< Number of elements tested by proximity queries.
+      ACCELERATION_HITS,    ///< Number of proximity queries that found an initial distance bound via a fast descent.
+      RAY_QUERIES,          ///< Number of ray queries.
+      RAY_NODES_VISITED,    ///< Number of nodes visited by ray queries.
+      RAY_ELEMENTS_TESTED,  ///< Number of elements tested by ray queries.
+      NUM_COUNTERS          ///< Number of counters (not a valid counter).
+    };
+
+    /** Constructor. Initializes all counters to zero. */
+    QueryStatistics();
+
+    /** Get the value of a counter. */
+    int64 get(Counter counter) const { return counters[counter]; }
+
+    /** Get a short human-readable name for a counter. */
+    static char const * getName(Counter counter);
+
+    /**
+     * Check if query statistics are compiled into the calling code, i.e. if THEA_QUERY_STATISTICS was defined when the caller
+     * was compiled. If not, all counters remain zero.
+     */
+    static bool isEnabled()
+    {
+#ifdef THEA_QUERY_STATISTICS
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    /**
+     * Add a value to a counter of the calling thread. Instrumented code should call this via the THEA_QUERY_STATS_ADD macro,
+     * which is a no-op unless statistics are enabled.
+     */
+    static void increment(Counter counter, int64 n = 1);
+
+    /**
+     * Get the sum of the counters of all threads, including those that have exited. The counters of running threads are read
+     * without synchronizing with the threads, so the result is exact only if no instrumented queries are running.
+     */
+    static QueryStatistics aggregate();
+
+    /** Reset the counters of all threads to zero. Should not be called while instrumented queries are running. */
+    static void reset();
+
+    /** Get a multi-line summary of the counters and derived ratios, such as nodes visited per query. */
+    std::string toString() const;
+
+  private:
+    int64 counters[NUM_COUNTERS];  ///< Counter values.
+
+}; // class QueryStatistics
+
+} // namespace Algorithms
+} // namespace Thea
+
+/**
+ * @def THEA_QUERY_STATS_ADD(counter, n)
+ * Add \a n to the QueryStatistics::Counter named \a counter (without the class prefix) for the current thread, if statistics
+ * are enabled. Else does nothing.
+ */
+#ifdef THEA_QUERY_STATISTICS
+#  define THEA_QUERY_STATS_ADD(counter, n)  \
+     Thea::Algorithms::QueryStatistics::increment(Thea::Algorithms::QueryStatistics::counter, (n))
+#else
+#  define THEA_QUERY_STATS_ADD(counter, n)  ((void)0)
+#endif
+
+#endif
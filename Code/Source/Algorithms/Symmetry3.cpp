@@ -0,0 +1,336 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "Symmetry3.hpp"
+#include "../ParallelFor.hpp"
+#include "../Random.hpp"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define THEA_SYMMETRY3_SSE2
+#endif
+
+namespace Thea {
+namespace Algorithms {
+
+namespace Symmetry3Internal {
+
+// Number of bins along each axis of the grid on a candidate plane, as in Symmetry3::symmetryError()
+static int const NUM_BINS = 10;
+
+// Number of points projected and binned in one go, chosen so the intermediate results stay in the L1 cache
+static long const BLOCK_SIZE = 256;
+
+// Default number of rounds of search
+static long const DEFAULT_NUM_ROUNDS = 5;
+
+// Default maximum number of points used to evaluate candidates in the first round
+static long const DEFAULT_MAX_COARSE_SAMPLES = 16384;
+
+// Number of best directions from the first round that are refined in the second round, to guard against subsampling noise
+static long const NUM_COARSE_SEEDS = 3;
+
+// Half-width, in steps, of the grid of directions evaluated around the best direction in each refinement round
+static int const GRID_HALF_WIDTH = 2;
+
+// Angular step of the grid in the first refinement round, which is a little more than half the spacing of the initial
+// directions. The step is halved in each subsequent round.
+static double const INITIAL_GRID_STEP = Math::degreesToRadians(8.0);
+
+// Minimum number of point evaluations to give each thread
+static double const MIN_WORK_PER_THREAD = 1 << 20;
+
+// Measure the quality of a candidate symmetry plane through the origin, using the first n points. Returns a number between 0
+// (best) and 1 (worst). The measure is identical to Symmetry3::symmetryError().
+double
+symmetryError(float const * x, float const * y, float const * z, long n, Vector3 const & normal, Real radius)
+{
+  static int const NUM_CELLS = NUM_BINS * NUM_BINS;
+
+  // The first NUM_CELLS entries are for the negative side, the rest for the positive side
+  double bins[2 * NUM_CELLS];
+  long count[2 * NUM_CELLS];
+  std::fill(bins, bins + 2 * NUM_CELLS, 0.0);
+  std::fill(count, count + 2 * NUM_CELLS, 0L);
+
+  Vector3 u, v; normal.createOrthonormalBasis(u, v);
+
+  // Map the u and v coordinates to [0, NUM_BINS], i.e. compute NUM_BINS * 0.5 * (p.dot(u) / radius + 1)
+  float su = (float)(0.5 * NUM_BINS / radius), sv = su, off = (float)(0.5 * NUM_BINS);
+  float ux = su * u.x(), uy = su * u.y(), uz = su * u.z();
+  float vx = sv * v.x(), vy = sv * v.y(), vz = sv * v.z();
+  float wx = normal.x(), wy = normal.y(), wz = normal.z();
+  float max_bin = (float)(NUM_BINS - 1);
+
+  int32 cell[BLOCK_SIZE];
+  float pw[BLOCK_SIZE];
+
+  for (long start = 0; start < n; start += BLOCK_SIZE)
+  {
+    long block_size = std::min(BLOCK_SIZE, n - start);
+    float const * bx = x + start;
+    float const * by = y + start;
+    float const * bz = z + start;
+
+    // Project the points and compute their cells
+    long i = 0;
+
+#ifdef THEA_SYMMETRY3_SSE2
+    __m128 ux4 = _mm_set1_ps(ux), uy4 = _mm_set1_ps(uy), uz4 = _mm_set1_ps(uz);
+    __m128 vx4 = _mm_set1_ps(vx), vy4 = _mm_set1_ps(vy), vz4 = _mm_set1_ps(vz);
+    __m128 wx4 = _mm_set1_ps(wx), wy4 = _mm_set1_ps(wy), wz4 = _mm_set1_ps(wz);
+    __m128 off4 = _mm_set1_ps(off), zero4 = _mm_setzero_ps(), max_bin4 = _mm_set1_ps(max_bin);
+    __m128i num_bins4 = _mm_set1_epi32(NUM_BINS);
+
+    for ( ; i + 4 <= block_size; i += 4)
+    {
+      __m128 px = _mm_loadu_ps(bx + i), py = _mm_loadu_ps(by + i), pz = _mm_loadu_ps(bz + i);
+
+      __m128 fu = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, ux4), _mm_mul_ps(py, uy4)), _mm_mul_ps(pz, uz4)), off4);
+      __m128 fv = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, vx4), _mm_mul_ps(py, vy4)), _mm_mul_ps(pz, vz4)), off4);
+      __m128 fw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, wx4), _mm_mul_ps(py, wy4)), _mm_mul_ps(pz, wz4));
+
+      // Clamping before truncation gives the same result as clamping the truncated value
+      __m128i bu = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(fu, zero4), max_bin4));
+      __m128i bv = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(fv, zero4), max_bin4));
+
+      // bu * NUM_BINS + bv, with 16-bit multiplication since SSE2 has no packed 32-bit multiply and the values are small
+      _mm_storeu_si128((__m128i *)(cell + i), _mm_add_epi32(_mm_mullo_epi16(bu, num_bins4), bv));
+      _mm_storeu_ps(pw + i, fw);
+    }
+#endif
+
+    for ( ; i < block_size; ++i)
+    {
+      float fu = bx[i] * ux + by[i] * uy + bz[i] * uz + off;
+      float fv = bx[i] * vx + by[i] * vy + bz[i] * vz + off;
+
+      int bu = (int)std::min(std::max(fu, 0.0f), max_bin);
+      int bv = (int)std::min(std::max(fv, 0.0f), max_bin);
+
+      cell[i] = (int32)(bu * NUM_BINS + bv);
+      pw[i] = bx[i] * wx + by[i] * wy + bz[i] * wz;
+    }
+
+    // Accumulate the distances from the plane in the cells
+    for (i = 0; i < block_size; ++i)
+    {
+      float w = pw[i];
+      int32 c = cell[i] + (w > 0 ? NUM_CELLS : 0);
+      bins[c] += std::fabs(w);
+      count[c]++;
+
+      if (w == 0)  // double-count points exactly on the plane, if any
+        count[cell[i] + NUM_CELLS]++;
+    }
+  }
+
+  double dist_error = 0, count_error = 0, sum_weights = 0;
+  for (int i = 0; i < NUM_CELLS; ++i)
+  {
+    long c0 = count[i];
+    long c1 = count[i + NUM_CELLS];
+    if (c0 == 0 && c1 == 0)
+      continue;
+
+    double avg0 = c0 > 0 ? bins[i] / c0 : 0.0;
+    double avg1 = c1 > 0 ? bins[i + NUM_CELLS] / c1 : 0.0;
+
+    double weight = c0 + c1;
+    dist_error += (std::fabs(avg0 - avg1) / radius) * weight;
+    count_error += (c0 < c1 ? 1.0 - c0 / (double)c1 : 1.0 - c1 / (double)c0) * weight;
+    sum_weights += weight;
+  }
+
+  dist_error /= sum_weights;
+  count_error /= sum_weights;
+
+  return 0.5 * (dist_error + count_error);
+}
+
+// Evaluates a candidate plane.
+class CandidateEvaluator
+{
+  public:
+    CandidateEvaluator(float const * x_, float const * y_, float const * z_, long num_points_, Real radius_,
+                       Vector3 const * candidates_, double * errors_)
+    : x(x_), y(y_), z(z_), num_points(num_points_), radius(radius_), candidates(candidates_), errors(errors_)
+    {}
+
+    void operator()(long i)
+    {
+      errors[i] = symmetryError(x, y, z, num_points, candidates[i], radius);
+    }
+
+  private:
+    float const * x;
+    float const * y;
+    float const * z;
+    long num_points;
+    Real radius;
+    Vector3 const * candidates;
+    double * errors;
+
+}; // class CandidateEvaluator
+
+// Evaluate a set of candidate planes on the first num_points points, in parallel if there is enough work.
+void
+evaluateCandidates(float const * x, float const * y, float const * z, long num_points, Real radius,
+                   TheaArray<Vector3> const & candidates, TheaArray<double> & errors)
+{
+  errors.resize(candidates.size());
+  if (candidates.empty())
+    return;
+
+  long num_candidates = (long)candidates.size();
+  parallelFor(num_candidates, CandidateEvaluator(x, y, z, num_points, radius, &candidates[0], &errors[0]), 1,
+              numThreadsForWork(num_candidates * (double)num_points, MIN_WORK_PER_THREAD));
+}
+
+// Append a square grid of directions around a given direction, with a given angular step.
+void
+appendGrid(Vector3 const & dir, double step, TheaArray<Vector3> & candidates)
+{
+  Vector3 a, b; dir.createOrthonormalBasis(a, b);
+  for (int i = -GRID_HALF_WIDTH; i <= GRID_HALF_WIDTH; ++i)
+    for (int j = -GRID_HALF_WIDTH; j <= GRID_HALF_WIDTH; ++j)
+      candidates.push_back((dir + (Real)std::tan(i * step) * a + (Real)std::tan(j * step) * b).unit());
+}
+
+double
+findPlaneFast(TheaArray<float> & x, TheaArray<float> & y, TheaArray<float> & z, Real radius, long num_rounds,
+              long max_coarse_samples, Vector3 & normal)
+{
+  alwaysAssertM(x.size() == y.size() && x.size() == z.size(), "Symmetry3: Coordinate arrays must have the same size");
+
+  normal = Vector3::unitZ();
+  long n = (long)x.size();
+  if (n <= 0)
+    return 0;
+
+  // If all the points coincide with the centroid, every plane through it is a perfect symmetry plane. The bins of
+  // symmetryError() cannot be computed in this case.
+  if (!(radius > 0))
+    return 0;
+
+  if (num_rounds <= 0)
+    num_rounds = DEFAULT_NUM_ROUNDS;
+
+  if (max_coarse_samples <= 0)
+    max_coarse_samples = DEFAULT_MAX_COARSE_SAMPLES;
+
+  // The number of points used to evaluate candidates in each round
+  TheaArray<long> num_samples((array_size_t)num_rounds);
+  for (long round = 0; round < num_rounds; ++round)
+  {
+    double s = std::ldexp((double)max_coarse_samples, (int)std::min(round, 60L));
+    num_samples[(array_size_t)round] = (s < n ? (long)s : n);
+  }
+
+  // Shuffle the points (only as far as needed) so that every prefix of the arrays is a random subsample
+  long num_to_shuffle = std::min(num_samples.back(), n - 1);
+  Random rng(0x5e3d);
+  for (long i = 0; i < num_to_shuffle; ++i)
+  {
+    long j = (long)rng.integer((int32)i, (int32)(n - 1));
+    std::swap(x[(array_size_t)i], x[(array_size_t)j]);
+    std::swap(y[(array_size_t)i], y[(array_size_t)j]);
+    std::swap(z[(array_size_t)i], z[(array_size_t)j]);
+  }
+
+  // Initial candidates are directions on a geodesic sphere. A plane and its flipped version are equivalent, so only one
+  // hemisphere is needed.
+  TheaArray<Vector3> vertices, candidates;
+  GeodesicSphere3::compute(2, vertices);
+  for (array_size_t i = 0; i < vertices.size(); ++i)
+  {
+    Vector3 const & d = vertices[i];
+    if (d.z() > 0 || (d.z() == 0 && (d.y() > 0 || (d.y() == 0 && d.x() > 0))))
+      candidates.push_back(d);
+  }
+
+  TheaArray<double> errors;
+  TheaArray< std::pair<double, long> > ranked;
+  TheaArray<Vector3> seeds;
+  double step = INITIAL_GRID_STEP;
+  for (long round = 0; round < num_rounds; ++round)
+  {
+    long m = num_samples[(array_size_t)round];
+    evaluateCandidates(&x[0], &y[0], &z[0], m, radius, candidates, errors);
+
+    ranked.clear();
+    for (array_size_t i = 0; i < candidates.size(); ++i)
+      ranked.push_back(std::make_pair(errors[i], (long)i));
+
+    long num_seeds = (round == 0 ? std::min(NUM_COARSE_SEEDS, (long)ranked.size()) : 1);
+    std::partial_sort(ranked.begin(), ranked.begin() + num_seeds, ranked.end());
+
+    seeds.clear();
+    for (long i = 0; i < num_seeds; ++i)
+      seeds.push_back(candidates[(array_size_t)ranked[(array_size_t)i].second]);
+
+    normal = seeds[0];
+
+    THEA_DEBUG << "Symmetry3: Round " << round << " (" << m << " samples), best normal = " << normal.toString()
+               << ", error = " << ranked[0].first;
+
+    // Further localize the search to a finer grid of directions around the best ones
+    if (round < num_rounds - 1)
+    {
+      candidates.clear();
+      for (array_size_t i = 0; i < seeds.size(); ++i)
+        appendGrid(seeds[i], step, candidates);
+
+      step *= 0.5;
+    }
+  }
+
+  // Report the error of the final plane over all the points
+  return symmetryError(&x[0], &y[0], &z[0], n, normal, radius);
+}
+
+} // namespace Symmetry3Internal
+
+} // namespace Algorithms
+} // namespace Thea
@@ -47,7 +47,9 @@
 #include "GeodesicSphere3.hpp"
 #include "IteratorModifiers.hpp"
 #include "PointTraitsN.hpp"
+#include "../Array.hpp"
 #include "../Math.hpp"
+#include "../Plane3.hpp"
 #include "../UnorderedSet.hpp"
 #include <boost/utility/enable_if.hpp>
 #include <cmath>
@@ -55,6 +57,18 @@
 namespace Thea {
 namespace Algorithms {
 
+namespace Symmetry3Internal {
+
+/**
+ * Find the normal of a plane of reflective symmetry through the origin, for a point cloud specified as separate arrays of
+ * coordinates relative to the centroid. Helper for Symmetry3::findPlaneFast(), see that function for details. The arrays will
+ * be shuffled. Returns the symmetry error of the plane.
+ */
+THEA_API double findPlaneFast(TheaArray<float> & x, TheaArray<float> & y, TheaArray<float> & z, Real radius, long num_rounds,
+                              long max_coarse_samples, Vector3 & normal);
+
+} // namespace Symmetry3Internal
+
 /** Symmetry detection in 3D. */
 template <typename T, typename Enable = void>
 class /* THEA_API */ Symmetry3
@@ -75,6 +89,29 @@ class /* THEA_API */ Symmetry3
     static double findPlane(InputIterator begin, InputIterator end, Plane3 & plane,
                             Vector3 const * precomputed_centroid = NULL);
 
+    /**
+     * Find a plane of (global) reflective symmetry of a set of objects, much faster than findPlane() for large inputs, with
+     * similar accuracy. The first round evaluates directions on a geodesic sphere using a random subsample of the input, and
+     * each subsequent round evaluates a progressively finer grid of directions around the best one so far, using a
+     * progressively larger subsample. Candidate planes are evaluated in parallel, and the projection and binning of points is
+     * vectorized.
+     *
+     * @param begin The first object.
+     * @param end One position beyond the last object.
+     * @param plane Used to store the resulting symmetry plane.
+     * @param precomputed_centroid The precomputed centroid of the objects. If NULL, the centroid will be computed from the
+     *   input data.
+     * @param num_rounds The number of rounds of search (negative for default).
+     * @param max_coarse_samples The maximum number of samples used to evaluate candidates in the first round, which is
+     *   doubled in each subsequent round (negative for default).
+     *
+     * @return The error, in the range 0 (best) to 1 (worst), of the symmetry relation, measured over all the input data.
+     */
+    template <typename InputIterator>
+    static double findPlaneFast(InputIterator begin, InputIterator end, Plane3 & plane,
+                                Vector3 const * precomputed_centroid = NULL, long num_rounds = -1,
+                                long max_coarse_samples = -1);
+
 }; // class Symmetry3
 
 // Symmetries of sets of objects passed as pointers.
@@ -89,6 +126,15 @@ class /* THEA_API */ Symmetry3<T *>
                                      plane, precomputed_centroid);
     }
 
+    template <typename InputIterator>
+    static double findPlaneFast(InputIterator begin, InputIterator end, Plane3 & plane,
+                                Vector3 const * precomputed_centroid = NULL, long num_rounds = -1,
+                                long max_coarse_samples = -1)
+    {
+      return Symmetry3<T>::findPlaneFast(PtrToRefIterator<T, InputIterator>(begin), PtrToRefIterator<T, InputIterator>(end),
+                                         plane, precomputed_centroid, num_rounds, max_coarse_samples);
+    }
+
 }; // class Symmetry3<T *>
 
 // Symmetries of point clouds.
@@ -182,6 +228,40 @@ class /* THEA_API */ Symmetry3<T, typename boost::enable_if< IsNonReferencedPoin
       return best_error;
     }
 
+    template <typename InputIterator>
+    static double findPlaneFast(InputIterator begin, InputIterator end, Plane3 & plane,
+                                Vector3 const * precomputed_centroid = NULL, long num_rounds = -1,
+                                long max_coarse_samples = -1)
+    {
+      if (begin == end)  // no points, early exit
+        return false;
+
+      Vector3 centroid = (precomputed_centroid ? *precomputed_centroid : CentroidN<T, 3>::compute(begin, end));
+
+      // Pack the points, relative to the centroid, into separate arrays of coordinates
+      TheaArray<float> x, y, z;
+      Real radius = 0;
+      for (InputIterator pi = begin; pi != end; ++pi)
+      {
+        Vector3 p = PointTraitsN<T, 3>::getPosition(*pi) - centroid;
+        x.push_back((float)p.x());
+        y.push_back((float)p.y());
+        z.push_back((float)p.z());
+
+        radius = std::max(radius, p.squaredLength());
+      }
+
+      radius = std::sqrt(radius);
+
+      Vector3 normal;
+      double error = Symmetry3Internal::findPlaneFast(x, y, z, radius, num_rounds, max_coarse_samples, normal);
+      plane = Plane3::fromPointAndNormal(centroid, normal);
+
+      THEA_DEBUG << "Symmetry3: Best plane = " << plane.toString() << ", error = " << error;
+
+      return error;
+    }
+
   private:
     /** Measure the quality of a candidate symmetry plane. Returns a number between 0 (best) and 1 (worst). */
     template <typename InputIterator>
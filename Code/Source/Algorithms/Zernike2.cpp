@@ -40,66 +40,250 @@
 //============================================================================
 
 #include "Zernike2.hpp"
-
-#ifndef THEA_NO_ZERNIKE
-
 #include "../Math.hpp"
+#include <cstddef>
+#include <map>
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#  define THEA_ZERNIKE_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define THEA_ZERNIKE_SSE2
+#endif
 
 namespace Thea {
 namespace Algorithms {
 
+namespace Zernike2Internal {
+
+// The values of the basis functions at each entry of the lookup table are padded to a multiple of this many elements, which
+// is a multiple of every supported SIMD width. Padding elements are zero.
+static long const PAD_WIDTH = 8;
+
+#if defined(THEA_ZERNIKE_AVX) || defined(THEA_ZERNIKE_SSE2)
+
+#define THEA_ZERNIKE_SIMD
+
+// Wrappers for the SIMD instructions on packed floats, selected by the instruction set the library is compiled for.
+struct SimdOps
+{
+#if defined(THEA_ZERNIKE_AVX)
+
+  typedef __m256 Vec;
+  static int const WIDTH = 8;
+
+  static Vec set1(float x) { return _mm256_set1_ps(x); }
+  static Vec load(float const * p) { return _mm256_load_ps(p); }
+  static void store(float * p, Vec a) { _mm256_store_ps(p, a); }
+  static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+
+#else
+
+  typedef __m128 Vec;
+  static int const WIDTH = 4;
+
+  static Vec set1(float x) { return _mm_set1_ps(x); }
+  static Vec load(float const * p) { return _mm_load_ps(p); }
+  static void store(float * p, Vec a) { _mm_store_ps(p, a); }
+  static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+
+#endif
+};
+
+#endif // defined(THEA_ZERNIKE_AVX) || defined(THEA_ZERNIKE_SSE2)
+
+// An array of floats aligned to 32 bytes, for aligned SIMD loads and stores.
+class AlignedFloats
+{
+  public:
+    AlignedFloats(long n = 0) { resize(n); }
+
+    void resize(long n)
+    {
+      storage.resize((array_size_t)(n + 8), 0.0f);
+      std::size_t addr = reinterpret_cast<std::size_t>(&storage[0]);
+      offset = (array_size_t)(((32 - (addr & 31)) & 31) / sizeof(float));
+    }
+
+    float * data() { return &storage[offset]; }
+    float const * data() const { return &storage[offset]; }
+
+  private:
+    TheaArray<float> storage;
+    array_size_t offset;
+
+}; // class AlignedFloats
+
+} // namespace Zernike2Internal
+
+// Lookup table of basis function values, on a (2 * lut_radius + 2) x (2 * lut_radius + 2) grid (including a row and column of
+// zero padding). The real and imaginary parts are stored in separate arrays, and the values of all basis functions at a grid
+// point are stored consecutively (angle-major, radius-minor), padded to a multiple of PAD_WIDTH, so they can be interpolated
+// and accumulated together with SIMD instructions.
+class Zernike2::BasisLUT
+{
+  public:
+    BasisLUT(Options const & opts)
+    : size(2 * opts.lut_radius + 2), num_moments(opts.angular_steps * opts.radial_steps)
+    {
+      using namespace Zernike2Internal;
+
+      stride = ((num_moments + PAD_WIDTH - 1) / PAD_WIDTH) * PAD_WIDTH;
+      re.resize(size * size * stride);
+      im.resize(size * size * stride);
+
+      int max_radius = opts.lut_radius;
+      double angle, temp, radius;
+
+      for (int x = 0; x < size - 1; ++x)
+        for (int y = 0; y < size - 1; ++y)
+        {
+          radius = std::sqrt((double)(Math::square(x - max_radius) + Math::square(y - max_radius)));
+          if (radius >= max_radius)
+            continue;
+
+          angle = std::atan2((double)(y - max_radius), (double)(x - max_radius));
+
+          float * cell_re = getReal(x, y);
+          float * cell_im = getImaginary(x, y);
+          for (int p = 0; p < opts.angular_steps; ++p)
+            for (int r = 0; r < opts.radial_steps; ++r)
+            {
+              temp = std::cos(radius * Math::pi() * r / max_radius);
+              cell_re[p * opts.radial_steps + r] = (float)(temp * std::cos(angle * p));
+              cell_im[p * opts.radial_steps + r] = (float)(temp * std::sin(angle * p));
+            }
+        }
+    }
+
+    float * getReal(int x, int y) { return re.data() + (x * size + y) * stride; }
+    float * getImaginary(int x, int y) { return im.data() + (x * size + y) * stride; }
+    float const * getReal(int x, int y) const { return re.data() + (x * size + y) * stride; }
+    float const * getImaginary(int x, int y) const { return im.data() + (x * size + y) * stride; }
+
+    int size;
+    long num_moments;
+    long stride;
+    Zernike2Internal::AlignedFloats re, im;
+
+}; // class Zernike2::BasisLUT
+
+namespace Zernike2Internal {
+
+// Guards the process-wide cache of lookup tables
+boost::mutex lut_cache_mutex;
+
+} // namespace Zernike2Internal
+
 Zernike2::Zernike2(Options const & opts_)
-: opts(opts_), lut_generated(false)
+: opts(opts_)
 {
+  using namespace Zernike2Internal;
+
   alwaysAssertM(opts.angular_steps > 0 && opts.radial_steps > 0 && opts.lut_radius > 0,
                 "Zernike2: Lookup dimensions must be greater than zero");
+
+  // Lookup tables are shared by all objects with the same options, and are never removed or modified once generated
+  typedef std::pair< std::pair<int, int>, int > LUTKey;
+  typedef std::map< LUTKey, shared_ptr<BasisLUT const> > LUTCache;
+
+  boost::mutex::scoped_lock lock(lut_cache_mutex);
+
+  static LUTCache lut_cache;  // initialized under the lock
+  shared_ptr<BasisLUT const> & cached = lut_cache[LUTKey(std::make_pair(opts.angular_steps, opts.radial_steps),
+                                                         opts.lut_radius)];
+  if (!cached)
+    cached = shared_ptr<BasisLUT const>(new BasisLUT(opts));
+
+  lut = cached;
 }
 
 void
-Zernike2::generateBasisLUT() const
+Zernike2::interpolateBasis(double tx, double ty, double * re, double * im) const
 {
-  if (lut_generated) return;
+  int ix = (int)tx, iy = (int)ty;
+  double dx = tx - ix, dy = ty - iy;
 
-  int lut_size = 2 * opts.lut_radius + 1;
-  lut.resize(boost::extents[opts.angular_steps][opts.radial_steps][lut_size + 1][lut_size + 1]);  // one row/column of padding
+  float const * re00 = lut->getReal(ix, iy),     * re10 = lut->getReal(ix + 1, iy);
+  float const * re01 = lut->getReal(ix, iy + 1), * re11 = lut->getReal(ix + 1, iy + 1);
+  float const * im00 = lut->getImaginary(ix, iy),     * im10 = lut->getImaginary(ix + 1, iy);
+  float const * im01 = lut->getImaginary(ix, iy + 1), * im11 = lut->getImaginary(ix + 1, iy + 1);
 
-  int max_radius = opts.lut_radius;
-  double angle, temp, radius;
+  double r1, r2, i1, i2;
+  for (long i = 0; i < lut->num_moments; ++i)
+  {
+    r1 = re00[i] + (re10[i] - re00[i]) * dx;
+    r2 = re01[i] + (re11[i] - re01[i]) * dx;
+    re[i] = r1 + (r2 - r1) * dy;
+
+    i1 = im00[i] + (im10[i] - im00[i]) * dx;
+    i2 = im01[i] + (im11[i] - im01[i]) * dx;
+    im[i] = i1 + (i2 - i1) * dy;
+  }
+}
 
-  for (int y = 0; y < lut_size; ++y)
-    for (int x = 0; x < lut_size; ++x)
+void
+Zernike2::accumulateBasis(long num_points, float const * points, double * sum_re, double * sum_im) const
+{
+  using namespace Zernike2Internal;
+
+  // Accumulate in single precision over the given set of points (typically a row of an image) and add the result to the
+  // double-precision running sums, which bounds the rounding error over large images
+  long stride = lut->stride;
+  AlignedFloats acc(2 * stride);
+  float * acc_re_data = acc.data();
+  float * acc_im_data = acc_re_data + stride;
+
+  for (long k = 0; k < num_points; ++k, points += 3)
+  {
+    float tx = points[0], ty = points[1], u = points[2];
+    int ix = (int)tx, iy = (int)ty;
+    float dx = tx - ix, dy = ty - iy;
+
+    // Bilinear interpolation weights, scaled by the density
+    float w00 = u * (1 - dx) * (1 - dy), w10 = u * dx * (1 - dy), w01 = u * (1 - dx) * dy, w11 = u * dx * dy;
+
+    float const * re00 = lut->getReal(ix, iy),     * re10 = lut->getReal(ix + 1, iy);
+    float const * re01 = lut->getReal(ix, iy + 1), * re11 = lut->getReal(ix + 1, iy + 1);
+    float const * im00 = lut->getImaginary(ix, iy),     * im10 = lut->getImaginary(ix + 1, iy);
+    float const * im01 = lut->getImaginary(ix, iy + 1), * im11 = lut->getImaginary(ix + 1, iy + 1);
+
+#ifdef THEA_ZERNIKE_SIMD
+
+    typedef SimdOps::Vec Vec;
+
+    Vec v00 = SimdOps::set1(w00), v10 = SimdOps::set1(w10), v01 = SimdOps::set1(w01), v11 = SimdOps::set1(w11);
+    for (long i = 0; i < stride; i += SimdOps::WIDTH)
     {
-      radius = std::sqrt((double)(Math::square(x - max_radius) + Math::square(y - max_radius)));
-
-      if(radius < max_radius)
-      {
-        angle = std::atan2((double)(y - max_radius), (double)(x - max_radius));
-
-        for (int p = 0; p < opts.angular_steps; ++p)
-          for (int r = 0; r < opts.radial_steps; ++r)
-          {
-            temp = std::cos(radius * Math::pi() * r / max_radius);
-            lut[p][r][x][y] = temp * std::complex<double>(std::cos(angle * p), std::sin(angle * p));
-          }
-      }
-      else
-      {
-        for (int p = 0; p < opts.angular_steps; ++p)
-          for (int r = 0; r < opts.radial_steps; ++r)
-            lut[p][r][x][y] = std::complex<double>(0.0, 0.0);
-      }
+      Vec r = SimdOps::add(SimdOps::add(SimdOps::mul(v00, SimdOps::load(re00 + i)), SimdOps::mul(v10, SimdOps::load(re10 + i))),
+                           SimdOps::add(SimdOps::mul(v01, SimdOps::load(re01 + i)), SimdOps::mul(v11, SimdOps::load(re11 + i))));
+      SimdOps::store(acc_re_data + i, SimdOps::add(SimdOps::load(acc_re_data + i), r));
+
+      Vec m = SimdOps::add(SimdOps::add(SimdOps::mul(v00, SimdOps::load(im00 + i)), SimdOps::mul(v10, SimdOps::load(im10 + i))),
+                           SimdOps::add(SimdOps::mul(v01, SimdOps::load(im01 + i)), SimdOps::mul(v11, SimdOps::load(im11 + i))));
+      SimdOps::store(acc_im_data + i, SimdOps::add(SimdOps::load(acc_im_data + i), m));
     }
 
-  // Add some padding in case we index beyond the border
-  for (int p = 0; p < opts.angular_steps; ++p)
-    for (int r = 0; r < opts.radial_steps; ++r)
-      for (int i = 0; i <= lut_size; ++i)
-        lut[p][r][i][lut_size] = lut[p][r][lut_size][i] = std::complex<double>(0.0, 0.0);
+#else
 
-  lut_generated = true;
+    for (long i = 0; i < stride; ++i)
+    {
+      acc_re_data[i] += w00 * re00[i] + w10 * re10[i] + w01 * re01[i] + w11 * re11[i];
+      acc_im_data[i] += w00 * im00[i] + w10 * im10[i] + w01 * im01[i] + w11 * im11[i];
+    }
+
+#endif
+  }
+
+  for (long i = 0; i < lut->num_moments; ++i)
+  {
+    sum_re[i] += acc_re_data[i];
+    sum_im[i] += acc_im_data[i];
+  }
 }
 
 } // namespace Algorithms
 } // namespace Thea
-
-#endif // !defined(THEA_NO_ZERNIKE)
@@ -42,18 +42,13 @@
 #ifndef __Thea_Algorithms_Zernike2_hpp__
 #define __Thea_Algorithms_Zernike2_hpp__
 
-// Currently Visual Studio 2010 fails to compile Boost multi_array in Debug mode: https://svn.boost.org/trac/boost/ticket/4874
-#if defined(_MSC_VER) && _MSC_VER >= 1600
-#  define THEA_NO_ZERNIKE
-#endif
-
-#ifndef THEA_NO_ZERNIKE
-
 #include "../Common.hpp"
 #include "../AddressableMatrix.hpp"
 #include "../Array.hpp"
+#include "../ParallelFor.hpp"
 #include "../VectorN.hpp"
-#include <boost/multi_array.hpp>
+#include <algorithm>
+#include <cmath>
 #include <complex>
 
 namespace Thea {
@@ -63,6 +58,10 @@ namespace Algorithms {
  * Compute Zernike moments of a 2D distribution, represented as a matrix of density values. The density values may be
  * multidimensional, i.e. the matrix elements may be vectors or colors.
  *
+ * The lookup table of basis function values is shared by all objects with the same options, across the process. It is
+ * generated once, when the first such object is constructed, and is never modified afterwards, so a single object may be used
+ * to compute moments from several threads at once.
+ *
  * This class adapts code for the LightField Descriptor from Ding-Yun Chen et al.,
  * http://3d.csie.ntu.edu.tw/~dynamic/3DRetrieval/index.html .
  */
@@ -135,39 +134,128 @@ class THEA_API Zernike2
       return computeImpl<ScalarT>(distrib, center_x, center_y, radius, moments);
     }
 
+    /**
+     * Compute Zernike moments of a stack of 2D distributions, each represented as a matrix of single-dimensional density values
+     * (such as the silhouettes of a light field descriptor). The basis functions are accumulated with SIMD instructions where
+     * available, and the distributions are split across threads.
+     *
+     * @param num_distribs The number of distributions.
+     * @param distribs The distributions, each represented as an addressable matrix of single-dimensional density values which
+     *   can be converted to <code>float</code>. The matrices must be safe to read from several threads at once.
+     * @param center_x The x-coordinates (columns) of the centers of the non-zero regions of the distributions, in matrix
+     *   coordinates.
+     * @param center_y The y-coordinates (rows) of the centers of the non-zero regions of the distributions, in matrix
+     *   coordinates.
+     * @param radius The radii of the non-zero regions of the distributions, as in compute().
+     * @param moments Used to return the Zernike moments, in a \a num_distribs * numMoments() array (distribution is major
+     *   dimension for packing), with the moments of each distribution in the same order as compute(). Must have space for this
+     *   many values.
+     * @param counts If non-null, used to return the number of pixels of each distribution that have non-zero values and were
+     *   used to compute its moments. Must have space for \a num_distribs values.
+     */
+    template <typename AddressableMatrixT, typename ScalarT>
+    void computeBatch(long num_distribs, AddressableMatrixT const * const * distribs, double const * center_x,
+                      double const * center_y, double const * radius, std::complex<ScalarT> * moments, long * counts = NULL)
+                      const;
+
   private:
+    class BasisLUT;  // shared lookup table of basis function values
+
     /** Helper function that actually computes the moments. */
     template <typename ScalarT, typename AddressableMatrixT, typename U>
     long computeImpl(AddressableMatrixT const & distrib, double center_x, double center_y, double radius,
                      TheaArray<U> & moments) const;
 
-    /** Generate lookup table for moments. */
-    void generateBasisLUT() const;
+    /** Compute the moments of a single distribution in a batch. */
+    template <typename AddressableMatrixT>
+    long computeBatchSingle(AddressableMatrixT const & distrib, double center_x, double center_y, double radius,
+                            TheaArray<float> & points, double * sum_re, double * sum_im) const;
+
+    /**
+     * Interpolate the values of all basis functions at a position in the lookup table, i.e. with both coordinates in the range
+     * [0, 2 * lut_radius].
+     */
+    void interpolateBasis(double tx, double ty, double * re, double * im) const;
+
+    /**
+     * Accumulate the basis functions at a set of positions in the lookup table, weighted by densities, into running sums of the
+     * real and imaginary parts of the moments. \a points is a sequence of (x, y, density) triplets.
+     */
+    void accumulateBasis(long num_points, float const * points, double * sum_re, double * sum_im) const;
 
     /** Add a single-dimensional scaled increment. */
     template <typename U, typename ScalarT>
-    static void accum(U const & u, std::complex<double> const & x, std::complex<ScalarT> & acc)
+    static void accum(U const & u, double re, double im, std::complex<ScalarT> & acc)
     {
-      acc.real(acc.real() + static_cast<ScalarT>(x.real() * u));
-      acc.imag(acc.imag() - static_cast<ScalarT>(x.imag() * u));
+      acc.real(acc.real() + static_cast<ScalarT>(re * u));
+      acc.imag(acc.imag() - static_cast<ScalarT>(im * u));
     }
 
     /** Add a multidimensional scaled increment. */
     template <typename U, long N, typename ScalarT>
-    static void accum(U const & u, std::complex<double> const & x, VectorN< N, std::complex<ScalarT> > & acc)
+    static void accum(U const & u, double re, double im, VectorN< N, std::complex<ScalarT> > & acc)
     {
       for (long i = 0; i < N; ++i)
       {
-        acc[i].real(acc[i].real() + static_cast<ScalarT>(x.real() * u[i]));
-        acc[i].imag(acc[i].imag() - static_cast<ScalarT>(x.imag() * u[i]));
+        acc[i].real(acc[i].real() + static_cast<ScalarT>(re * u[i]));
+        acc[i].imag(acc[i].imag() - static_cast<ScalarT>(im * u[i]));
       }
     }
 
-    typedef boost::multi_array< std::complex<double>, 4 > LUT;  ///< Lookup table class.
+    /**
+     * Worker class for computing the moments of a batch of distributions in parallel. Each thread gets its own copy of the
+     * worker, and hence of the scratch space.
+     */
+    template <typename AddressableMatrixT, typename ScalarT> class BatchWorker
+    {
+      public:
+        /** Constructor. */
+        BatchWorker(Zernike2 const * parent_, AddressableMatrixT const * const * distribs_, double const * center_x_,
+                    double const * center_y_, double const * radius_, std::complex<ScalarT> * moments_, long * counts_)
+        : parent(parent_), distribs(distribs_), center_x(center_x_), center_y(center_y_), radius(radius_), moments(moments_),
+          counts(counts_)
+        {}
+
+        /** Compute moments of the distributions with indices in [begin, end). */
+        void operator()(long begin, long end)
+        {
+          long num_moments = parent->numMoments();
+          sum_re.resize((array_size_t)num_moments);
+          sum_im.resize((array_size_t)num_moments);
+
+          for (long i = begin; i < end; ++i)
+          {
+            long count = parent->computeBatchSingle(*distribs[i], center_x[i], center_y[i], radius[i], points, &sum_re[0],
+                                                    &sum_im[0]);
+
+            std::complex<ScalarT> * m = moments + i * num_moments;
+            double scale = (count > 0 ? 1.0 / count : 1.0);
+            for (long j = 0; j < num_moments; ++j)
+              m[j] = std::complex<ScalarT>(static_cast<ScalarT>(sum_re[(array_size_t)j] * scale),
+                                           static_cast<ScalarT>(-sum_im[(array_size_t)j] * scale));
+
+            if (counts)
+              counts[i] = count;
+          }
+        }
+
+      private:
+        Zernike2 const * parent;
+        AddressableMatrixT const * const * distribs;
+        double const * center_x;
+        double const * center_y;
+        double const * radius;
+        std::complex<ScalarT> * moments;
+        long * counts;
+        TheaArray<double> sum_re, sum_im;  // scratch space
+        TheaArray<float> points;           // scratch space
+
+    }; // class BatchWorker
 
-    Options opts;                ///< Set of options.
-    mutable LUT lut;             ///< Coefficient lookup table.
-    mutable bool lut_generated;  ///< Has the LUT been generated?
+    template <typename AddressableMatrixT, typename ScalarT> friend class BatchWorker;
+
+    Options opts;                        ///< Set of options.
+    shared_ptr<BasisLUT const> lut;      ///< Shared coefficient lookup table.
 
 }; // class Zernike2
 
@@ -181,8 +269,6 @@ Zernike2::computeImpl(AddressableMatrixT const & distrib, double center_x, doubl
   static typename AddressableMatrixT::Value const IN_ZERO(0);
   static U const OUT_ZERO(std::complex<ScalarT>(0, 0));
 
-  this->generateBasisLUT();
-
   moments.resize(numMoments());
   std::fill(moments.begin(), moments.end(), OUT_ZERO);
 
@@ -198,9 +284,7 @@ Zernike2::computeImpl(AddressableMatrixT const & distrib, double center_x, doubl
 
   double r_radius = opts.lut_radius / radius;
 
-  std::complex<double> x1, x2, x3;
-  double dx, dy, tx, ty;
-  int ix, iy;
+  TheaArray<double> basis_re((array_size_t)numMoments()), basis_im((array_size_t)numMoments());
   long count = 0;
   for (int y = min_y; y <= max_y; ++y)
   {
@@ -209,27 +293,12 @@ Zernike2::computeImpl(AddressableMatrixT const & distrib, double center_x, doubl
       typename AddressableMatrixT::Value const & density = distrib.get(y, x);
       if (density != IN_ZERO)
       {
-        dx = x - center_x;
-        dy = y - center_y;
-        tx = dx * r_radius + opts.lut_radius;
-        ty = dy * r_radius + opts.lut_radius;
-        ix = (int)tx;
-        iy = (int)ty;
-        dx = tx - ix;
-        dy = ty - iy;
-
         // Summation of basis function
-        for(int p = 0; p < opts.angular_steps; ++p)
-        {
-          for(int r = 0; r < opts.radial_steps; ++r)
-          {
-            x1 = lut[p][r][ix][iy    ] + (lut[p][r][ix + 1][iy    ] - lut[p][r][ix][iy    ]) * dx;
-            x2 = lut[p][r][ix][iy + 1] + (lut[p][r][ix + 1][iy + 1] - lut[p][r][ix][iy + 1]) * dx;
-            x3 = x1 + (x2 - x1) * dy;
+        interpolateBasis((x - center_x) * r_radius + opts.lut_radius, (y - center_y) * r_radius + opts.lut_radius,
+                         &basis_re[0], &basis_im[0]);
 
-            accum(density, x3, moments[p * opts.radial_steps + r]);
-          }
-        }
+        for (array_size_t i = 0; i < moments.size(); ++i)
+          accum(density, basis_re[i], basis_im[i], moments[i]);
 
         count++;
       }
@@ -245,9 +314,72 @@ Zernike2::computeImpl(AddressableMatrixT const & distrib, double center_x, doubl
   return count;
 }
 
+template <typename AddressableMatrixT, typename ScalarT>
+void
+Zernike2::computeBatch(long num_distribs, AddressableMatrixT const * const * distribs, double const * center_x,
+                       double const * center_y, double const * radius, std::complex<ScalarT> * moments, long * counts) const
+{
+  if (num_distribs <= 0)
+    return;
+
+  alwaysAssertM(distribs && center_x && center_y && radius && moments, "Zernike2: Batch input and output must be non-null");
+
+  parallelForChunks(num_distribs, BatchWorker<AddressableMatrixT, ScalarT>(this, distribs, center_x, center_y, radius, moments,
+                                                                            counts), 1);
+}
+
+template <typename AddressableMatrixT>
+long
+Zernike2::computeBatchSingle(AddressableMatrixT const & distrib, double center_x, double center_y, double radius,
+                             TheaArray<float> & points, double * sum_re, double * sum_im) const
+{
+  alwaysAssertM(radius > 0, "Zernike2: Radius must be greater than zero");
+
+  std::fill(sum_re, sum_re + numMoments(), 0.0);
+  std::fill(sum_im, sum_im + numMoments(), 0.0);
+
+  int ncols = distrib.numColumns();
+  int nrows = distrib.numRows();
+
+  // Don't go outside the specified radius
+  int min_x = std::max(0,         (int)std::ceil (center_x - radius));
+  int max_x = std::min(ncols - 1, (int)std::floor(center_x + radius));
+
+  int min_y = std::max(0,         (int)std::ceil (center_y - radius));
+  int max_y = std::min(nrows - 1, (int)std::floor(center_y + radius));
+
+  double r_radius = opts.lut_radius / radius;
+
+  // Gather the non-zero pixels of each row and accumulate them together, so the accumulation can be vectorized
+  long count = 0;
+  for (int y = min_y; y <= max_y; ++y)
+  {
+    points.clear();
+    float ty = (float)((y - center_y) * r_radius + opts.lut_radius);
+
+    for (int x = min_x; x <= max_x; ++x)
+    {
+      float density = static_cast<float>(distrib.get(y, x));
+      if (density != 0)
+      {
+        points.push_back((float)((x - center_x) * r_radius + opts.lut_radius));
+        points.push_back(ty);
+        points.push_back(density);
+      }
+    }
+
+    if (!points.empty())
+    {
+      long n = (long)points.size() / 3;
+      accumulateBasis(n, &points[0], sum_re, sum_im);
+      count += n;
+    }
+  }
+
+  return count;
+}
+
 } // namespace Algorithms
 } // namespace Thea
 
-#endif // !defined(THEA_NO_ZERNIKE)
-
 #endif
@@ -130,12 +130,11 @@ class THEA_API AtomicInt32
                     : "memory", "cc");
       return old;
 #elif defined(THEA_OSX)
-      int32 old = m_value;
 #  pragma clang diagnostic push
 #  pragma clang diagnostic ignored "-Wdeprecated-declarations"
-      OSAtomicAdd32(x, &m_value);
+      // Note: returns the newly incremented value, which is the only value read atomically
+      return OSAtomicAdd32(x, &m_value) - x;
 #  pragma clang diagnostic pop
-      return old;
 #endif
     }
 
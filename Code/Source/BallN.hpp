@@ -115,12 +115,17 @@ class /* THEA_API */ BallN : public RayIntersectableN<N, T>
     /** Check if the ball contains an axis-aligned box. */
     bool contains(AxisAlignedBoxN<N, T> const & aab) const
     {
-      // FIXME: Currently works only for N < sizeof(unsigned long)
-      for (unsigned long i = 0; i < (1 << N); ++i)
-        if (!contains(aab.getCorner(i)))
-          return false;
+      // The box is contained iff its corner furthest from the center is. This is O(N), unlike testing all 2^N corners.
+      VectorT const & lo = aab.getLow();
+      VectorT const & hi = aab.getHigh();
+      T sqdist = 0;
+      for (long i = 0; i < N; ++i)
+      {
+        T d = std::max(std::abs(center[i] - lo[i]), std::abs(hi[i] - center[i]));
+        sqdist += d * d;
+      }
 
-      return true;
+      return sqdist <= radius * radius;
     }
 
     /** Get the distance of the ball from a point. */
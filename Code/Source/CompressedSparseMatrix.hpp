@@ -51,6 +51,7 @@
 #include "Algorithms/FastCopy.hpp"
 #include <boost/type_traits/is_base_of.hpp>
 #include <boost/utility/enable_if.hpp>
+#include <algorithm>
 
 namespace Thea {
 
@@ -220,6 +221,73 @@ class /* THEA_API */ CompressedSparseMatrix : public virtual IteratableMatrix<T>
         *i = static_cast<Index1D>(0);
     }
 
+    /**
+     * Set the matrix to have the specified dimensions and entries, discarding all existing data. The entries, specified as
+     * (row, column) => value triplets, may be in any order, and the values of multiple entries with the same row and column are
+     * summed. This assembles the matrix directly in compressed form, in time linear in the number of entries (plus the time
+     * to sort the entries within each row/column), without going through an intermediate addressable matrix.
+     */
+    void setFromEntries(long num_rows, long num_cols, TheaArray<Entry> const & entries)
+    {
+      alwaysAssertM(num_rows >= 0 && num_cols >= 0, "CompressedSparseMatrix: Dimensions must be non-negative");
+
+      bool row_major = (L == MatrixLayout::ROW_MAJOR);
+      size1 = (row_major ? num_rows : num_cols);
+      size2 = (row_major ? num_cols : num_rows);
+
+      // Bucket the entries by primary index (counting sort)
+      indices1.assign((array_size_t)size1 + 1, 0);
+      for (typename TheaArray<Entry>::const_iterator ei = entries.begin(); ei != entries.end(); ++ei)
+      {
+        long i1 = (row_major ? ei->first.first : ei->first.second);
+        long i2 = (row_major ? ei->first.second : ei->first.first);
+        alwaysAssertM(i1 >= 0 && i1 < size1 && i2 >= 0 && i2 < size2, "CompressedSparseMatrix: Entry index out of bounds");
+
+        indices1[(array_size_t)i1 + 1]++;
+      }
+
+      for (array_size_t i = 1; i < indices1.size(); ++i)
+        indices1[i] += indices1[i - 1];
+
+      typedef std::pair<Index2D, T> SecondaryEntry;
+      TheaArray<SecondaryEntry> bucketed(entries.size());
+      TheaArray<Index1D> next(indices1.begin(), indices1.end() - 1);
+      for (typename TheaArray<Entry>::const_iterator ei = entries.begin(); ei != entries.end(); ++ei)
+      {
+        long i1 = (row_major ? ei->first.first : ei->first.second);
+        long i2 = (row_major ? ei->first.second : ei->first.first);
+        bucketed[(array_size_t)next[(array_size_t)i1]++] = SecondaryEntry(static_cast<Index2D>(i2), ei->second);
+      }
+
+      // Sort each bucket by secondary index and merge duplicates
+      indices2.resize(entries.size());
+      values.resize(entries.size());
+      array_size_t out = 0;
+      for (long i1 = 0; i1 < size1; ++i1)
+      {
+        typename TheaArray<SecondaryEntry>::iterator b_begin = bucketed.begin() + indices1[(array_size_t)i1];
+        typename TheaArray<SecondaryEntry>::iterator b_end   = bucketed.begin() + indices1[(array_size_t)i1 + 1];
+        std::sort(b_begin, b_end, lessSecondary);
+
+        indices1[(array_size_t)i1] = static_cast<Index1D>(out);
+        for (typename TheaArray<SecondaryEntry>::iterator bi = b_begin; bi != b_end; ++bi)
+        {
+          if (bi != b_begin && bi->first == indices2[out - 1])
+            values[out - 1] += bi->second;
+          else
+          {
+            indices2[out] = bi->first;
+            values[out] = bi->second;
+            ++out;
+          }
+        }
+      }
+
+      indices1[(array_size_t)size1] = static_cast<Index1D>(out);
+      indices2.resize(out);
+      values.resize(out);
+    }
+
   protected:
     /**
      * Constructs a zero matrix of the specified size. If the number of columns is omitted or zero, a square matrix is created.
@@ -312,6 +380,9 @@ class /* THEA_API */ CompressedSparseMatrix : public virtual IteratableMatrix<T>
       indices1[(array_size_t)size1] = curr_pos;
     }
 
+    /** Compare two (secondary index, value) pairs by index. */
+    static bool lessSecondary(std::pair<Index2D, T> const & a, std::pair<Index2D, T> const & b) { return a.first < b.first; }
+
     /** Resizes the matrix to the specified dimensions. All existing data is discarded and the matrix is set to zero. */
     void resize(long size1_, long size2_)
     {
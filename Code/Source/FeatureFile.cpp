@@ -0,0 +1,326 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "FeatureFile.hpp"
+#include "BinaryOutputStream.hpp"
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace Thea {
+
+char const * const FeatureFile::MAGIC = "THEAFEAT";
+
+namespace FeatureFileInternal {
+
+// Read a little-endian unsigned integer of a given number of bytes from a buffer, advancing the read position. Throws an error if
+// the buffer does not have enough bytes left.
+uint64
+readLE(uint8 const * data, int64 size, int64 & pos, int num_bytes)
+{
+  if (pos + num_bytes > size)
+    throw Error("FeatureFileReader: Unexpected end of file header");
+
+  uint64 v = 0;
+  for (int i = num_bytes - 1; i >= 0; --i)
+    v = (v << 8) | data[pos + i];
+
+  pos += num_bytes;
+  return v;
+}
+
+} // namespace FeatureFileInternal
+
+bool
+FeatureFile::isFeatureFile(std::string const & path)
+{
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in)
+    return false;
+
+  char magic[MAGIC_LENGTH];
+  if (!in.read(magic, MAGIC_LENGTH))
+    return false;
+
+  return std::memcmp(magic, MAGIC, MAGIC_LENGTH) == 0;
+}
+
+FeatureFileWriter::FeatureFileWriter(long num_points_)
+: num_points(num_points_)
+{
+  alwaysAssertM(num_points >= 0, "FeatureFileWriter: Number of points must be non-negative");
+}
+
+long
+FeatureFileWriter::addFeature(std::string const & name, long num_dims, FeatureStorage storage)
+{
+  alwaysAssertM(num_dims > 0, "FeatureFileWriter: Feature must have at least one dimension");
+
+  features.push_back(Feature(name, num_dims, storage, num_points));
+  return numFeatures() - 1;
+}
+
+void
+FeatureFileWriter::write(std::string const & path) const
+{
+  BinaryOutputStream out(path, Endianness::LITTLE);
+  if (!out.ok())
+    throw Error("FeatureFileWriter: Could not open '" + path + "' for writing");
+
+  // Compute the offset of each feature block
+  int64 header_size = FeatureFile::MAGIC_LENGTH + 4 + 4 + 8;
+  for (array_size_t i = 0; i < features.size(); ++i)
+    header_size += 4 + (int64)features[i].name.length() + 4 + 4 + 8;
+
+  TheaArray<int64> offsets(features.size());
+  int64 offset = header_size;
+  for (array_size_t i = 0; i < features.size(); ++i)
+  {
+    offset = ((offset + FeatureFile::ALIGNMENT - 1) / FeatureFile::ALIGNMENT) * FeatureFile::ALIGNMENT;
+    offsets[i] = offset;
+    offset += (int64)num_points * features[i].num_dims * features[i].storage.bytesPerValue();
+  }
+
+  // Header
+  out.writeBytes(FeatureFile::MAGIC_LENGTH, FeatureFile::MAGIC);
+  out.writeUInt32(FeatureFile::VERSION);
+  out.writeUInt32((uint32)features.size());
+  out.writeInt64((int64)num_points);
+
+  for (array_size_t i = 0; i < features.size(); ++i)
+  {
+    Feature const & f = features[i];
+    out.writeUInt32((uint32)f.name.length());
+    out.writeBytes((int64)f.name.length(), f.name.data());
+    out.writeUInt32((uint32)f.num_dims);
+    out.writeUInt32((uint32)f.storage);
+    out.writeInt64(offsets[i]);
+  }
+
+  // Feature blocks. If the machine is little-endian, the values can be copied directly.
+  bool native = (Endianness::machine() == Endianness::LITTLE);
+  for (array_size_t i = 0; i < features.size(); ++i)
+  {
+    while (out.getPosition() < offsets[i])
+      out.writeUInt8(0);
+
+    Feature const & f = features[i];
+    if (f.storage == FeatureStorage::FLOAT16)
+    {
+      if (native)
+      {
+        if (!f.values16.empty())
+          out.writeBytes((int64)(f.values16.size() * sizeof(uint16)), &f.values16[0]);
+      }
+      else
+      {
+        for (array_size_t j = 0; j < f.values16.size(); ++j)
+          out.writeUInt16(f.values16[j]);
+      }
+    }
+    else
+    {
+      if (native)
+      {
+        if (!f.values32.empty())
+          out.writeBytes((int64)(f.values32.size() * sizeof(float32)), &f.values32[0]);
+      }
+      else
+      {
+        for (array_size_t j = 0; j < f.values32.size(); ++j)
+          out.writeFloat32(f.values32[j]);
+      }
+    }
+  }
+
+  if (!out.commit())
+    throw Error("FeatureFileWriter: Could not write features to '" + path + "'");
+}
+
+FeatureFileReader::FeatureFileReader(std::string const & path)
+: num_points(0)
+{
+  using namespace FeatureFileInternal;
+
+  // The feature blocks are accessed in place, which requires the file and machine byte orders to match
+  if (Endianness::machine() != Endianness::LITTLE)
+    throw Error("FeatureFileReader: Memory-mapped feature files are not supported on big-endian machines");
+
+  file.open(path);
+
+  uint8 const * data = file.data();
+  int64 size = file.size();
+
+  if (size < FeatureFile::MAGIC_LENGTH || std::memcmp(data, FeatureFile::MAGIC, FeatureFile::MAGIC_LENGTH) != 0)
+    throw Error("FeatureFileReader: '" + path + "' is not a feature file");
+
+  int64 pos = FeatureFile::MAGIC_LENGTH;
+  uint32 version = (uint32)readLE(data, size, pos, 4);
+  if (version != FeatureFile::VERSION)
+    throw Error(format("FeatureFileReader: Unsupported feature file version %lu", (unsigned long)version));
+
+  uint32 num_features = (uint32)readLE(data, size, pos, 4);
+  int64 num_points64 = (int64)readLE(data, size, pos, 8);
+  if (num_points64 < 0 || num_points64 > (int64)std::numeric_limits<long>::max())
+    throw Error("FeatureFileReader: Invalid number of points");
+
+  num_points = (long)num_points64;
+
+  // Check the number of features against the size of the header before allocating anything, in case the file is corrupt. Each
+  // entry has at least a name length, a number of dimensions, a storage type and an offset.
+  static int64 const MIN_ENTRY_SIZE = 4 + 4 + 4 + 8;
+  if ((int64)num_features > (size - pos) / MIN_ENTRY_SIZE)
+    throw Error("FeatureFileReader: Unexpected end of file header");
+
+  features.resize((array_size_t)num_features);
+  for (array_size_t i = 0; i < features.size(); ++i)
+  {
+    Feature & f = features[i];
+
+    int64 name_len = (int64)readLE(data, size, pos, 4);
+    if (pos + name_len > size)
+      throw Error("FeatureFileReader: Unexpected end of file header");
+
+    f.name = std::string(reinterpret_cast<char const *>(data + pos), (size_t)name_len);
+    pos += name_len;
+
+    int64 num_dims = (int64)readLE(data, size, pos, 4);
+    uint32 storage = (uint32)readLE(data, size, pos, 4);
+    int64 offset = (int64)readLE(data, size, pos, 8);
+
+    if (storage != FeatureStorage::FLOAT32 && storage != FeatureStorage::FLOAT16)
+      throw Error("FeatureFileReader: Unknown storage type for feature '" + f.name + "'");
+
+    f.storage = FeatureStorage(storage);
+
+    if (num_dims <= 0 || num_dims > (int64)std::numeric_limits<long>::max())
+      throw Error("FeatureFileReader: Invalid number of dimensions for feature '" + f.name + "'");
+
+    f.num_dims = (long)num_dims;
+
+    if (offset % FeatureFile::ALIGNMENT != 0)
+      throw Error("FeatureFileReader: Feature '" + f.name + "' is not correctly aligned");
+
+    // Compare by division, since the size of the block computed from corrupt values could overflow
+    int64 bytes_per_point = num_dims * f.storage.bytesPerValue();
+    if (offset < 0 || offset > size || num_points64 > (size - offset) / bytes_per_point)
+      throw Error("FeatureFileReader: Values of feature '" + f.name + "' extend beyond the end of the file");
+
+    f.data = data + offset;
+  }
+}
+
+long
+FeatureFileReader::findFeature(std::string const & name) const
+{
+  for (array_size_t i = 0; i < features.size(); ++i)
+    if (features[i].name == name)
+      return (long)i;
+
+  return -1;
+}
+
+float32 const *
+FeatureFileReader::getFloat32Data(long feature) const
+{
+  Feature const & f = getFeature(feature);
+  return f.storage == FeatureStorage::FLOAT32 ? reinterpret_cast<float32 const *>(f.data) : NULL;
+}
+
+uint16 const *
+FeatureFileReader::getFloat16Data(long feature) const
+{
+  Feature const & f = getFeature(feature);
+  return f.storage == FeatureStorage::FLOAT16 ? reinterpret_cast<uint16 const *>(f.data) : NULL;
+}
+
+float32
+FeatureFileReader::getValue(long feature, long point, long dim) const
+{
+  Feature const & f = getFeature(feature);
+  debugAssertM(point >= 0 && point < num_points, "FeatureFileReader: Point index out of bounds");
+  debugAssertM(dim >= 0 && dim < f.num_dims, "FeatureFileReader: Dimension index out of bounds");
+
+  array_size_t i = (array_size_t)(point * f.num_dims + dim);
+  if (f.storage == FeatureStorage::FLOAT16)
+    return Math::fromFloat16(reinterpret_cast<uint16 const *>(f.data)[i]);
+  else
+    return reinterpret_cast<float32 const *>(f.data)[i];
+}
+
+void
+FeatureFileReader::getValues(long feature, long point, float32 * values) const
+{
+  Feature const & f = getFeature(feature);
+  debugAssertM(point >= 0 && point < num_points, "FeatureFileReader: Point index out of bounds");
+
+  array_size_t base = (array_size_t)(point * f.num_dims);
+  if (f.storage == FeatureStorage::FLOAT16)
+  {
+    uint16 const * src = reinterpret_cast<uint16 const *>(f.data) + base;
+    for (long i = 0; i < f.num_dims; ++i)
+      values[i] = Math::fromFloat16(src[i]);
+  }
+  else
+    std::memcpy(values, reinterpret_cast<float32 const *>(f.data) + base, (size_t)f.num_dims * sizeof(float32));
+}
+
+void
+FeatureFileReader::getDimension(long feature, long dim, float32 * values) const
+{
+  Feature const & f = getFeature(feature);
+  debugAssertM(dim >= 0 && dim < f.num_dims, "FeatureFileReader: Dimension index out of bounds");
+
+  if (f.storage == FeatureStorage::FLOAT16)
+  {
+    uint16 const * src = reinterpret_cast<uint16 const *>(f.data) + dim;
+    for (long i = 0; i < num_points; ++i, src += f.num_dims)
+      values[i] = Math::fromFloat16(*src);
+  }
+  else
+  {
+    float32 const * src = reinterpret_cast<float32 const *>(f.data) + dim;
+    for (long i = 0; i < num_points; ++i, src += f.num_dims)
+      values[i] = *src;
+  }
+}
+
+} // namespace Thea
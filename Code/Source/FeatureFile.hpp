@@ -0,0 +1,294 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_FeatureFile_hpp__
+#define __Thea_FeatureFile_hpp__
+
+#include "Common.hpp"
+#include "Array.hpp"
+#include "MappedFile.hpp"
+#include "Math.hpp"
+#include "Noncopyable.hpp"
+
+namespace Thea {
+
+/** Precision with which the values of a feature are stored in a columnar feature file (enum class). */
+struct THEA_API FeatureStorage
+{
+  /** Supported values. */
+  enum Value
+  {
+    FLOAT32,  ///< 32-bit single-precision floats.
+    FLOAT16   ///< 16-bit half-precision floats (about three significant decimal digits, range +/- 65504).
+  };
+
+  THEA_ENUM_CLASS_BODY(FeatureStorage)
+
+  THEA_ENUM_CLASS_STRINGS_BEGIN(FeatureStorage)
+    THEA_ENUM_CLASS_STRING(FLOAT32, "float32")
+    THEA_ENUM_CLASS_STRING(FLOAT16, "float16")
+  THEA_ENUM_CLASS_STRINGS_END(FeatureStorage)
+
+  /** Get the number of bytes used to store a single value. */
+  int bytesPerValue() const { return *this == FLOAT16 ? 2 : 4; }
+};
+
+/**
+ * Constants describing the columnar feature file format, which stores a set of named features for a common set of points. Each
+ * feature is a fixed-dimensional vector per point, and its values for all points are stored in a single contiguous block
+ * (column), so that a file can be memory-mapped and each feature accessed in place without parsing. The file layout, with all
+ * numbers little-endian, is:
+ *
+ * <pre>
+ *   Magic string "THEAFEAT" (8 bytes)
+ *   Format version (uint32)
+ *   Number of features F (uint32)
+ *   Number of points N (int64)
+ *   F feature descriptors, each consisting of:
+ *     Length of the feature name in bytes (uint32), followed by the name itself (no terminating null)
+ *     Number of dimensions D of the feature (uint32)
+ *     Storage type (uint32, 0 = float32, 1 = float16)
+ *     Offset of the feature block from the start of the file (int64)
+ *   F feature blocks, each starting at a multiple of ALIGNMENT bytes and containing N * D values, with the D values of each
+ *     point stored consecutively
+ * </pre>
+ *
+ * @see FeatureFileWriter, FeatureFileReader
+ */
+struct THEA_API FeatureFile
+{
+  static char const * const MAGIC;           ///< Magic string at the start of every file.
+  static int const MAGIC_LENGTH = 8;         ///< Length of the magic string in bytes.
+  static uint32 const VERSION = 1;           ///< Current version of the format.
+  static int64 const ALIGNMENT = 64;         ///< Alignment, in bytes, of each feature block.
+
+  /** Check if a file is (has the header of) a columnar feature file. */
+  static bool isFeatureFile(std::string const & path);
+
+}; // struct FeatureFile
+
+/**
+ * Writes a columnar feature file (see FeatureFile for the format). Features are first added to the writer, their values are
+ * set, and the file is written with write(). Values are converted to the storage precision of the feature when they are set.
+ *
+ * Example:
+ * \code
+ *   FeatureFileWriter writer(num_points);
+ *   long pos = writer.addFeature("position", 3);
+ *   long sdf = writer.addFeature("sdf", 1, FeatureStorage::FLOAT16);
+ *   for (long i = 0; i < num_points; ++i)
+ *   {
+ *     writer.setValues(pos, i, &points[i][0]);
+ *     writer.setValues(sdf, i, &sdf_values[i]);
+ *   }
+ *
+ *   writer.write("shape.features.bin");
+ * \endcode
+ */
+class THEA_API FeatureFileWriter : private Noncopyable
+{
+  public:
+    /** Constructor. Creates an empty set of features for a given number of points. */
+    explicit FeatureFileWriter(long num_points_);
+
+    /** Get the number of points. */
+    long numPoints() const { return num_points; }
+
+    /** Get the number of features added so far. */
+    long numFeatures() const { return (long)features.size(); }
+
+    /**
+     * Add a feature, with all values initialized to zero.
+     *
+     * @param name The name of the feature. Names need not be unique, but FeatureFileReader::findFeature() will locate only the
+     *   first feature with a given name.
+     * @param num_dims The number of dimensions of the feature (number of values per point).
+     * @param storage The precision with which the feature values are stored.
+     *
+     * @return The index of the new feature.
+     */
+    long addFeature(std::string const & name, long num_dims, FeatureStorage storage = FeatureStorage::FLOAT32);
+
+    /** Set the values of a feature for a single point, from an array of as many values as the feature has dimensions. */
+    template <typename T> void setValues(long feature, long point, T const * values)
+    {
+      debugAssertM(feature >= 0 && feature < numFeatures(), "FeatureFileWriter: Feature index out of bounds");
+      debugAssertM(point >= 0 && point < num_points, "FeatureFileWriter: Point index out of bounds");
+
+      Feature & f = features[(array_size_t)feature];
+      array_size_t base = (array_size_t)(point * f.num_dims);
+      for (long i = 0; i < f.num_dims; ++i)
+        f.set(base + (array_size_t)i, static_cast<float32>(values[i]));
+    }
+
+    /**
+     * Set the values of a feature for all points, from an array of numPoints() * (number of feature dimensions) values, with the
+     * values for each point stored consecutively.
+     */
+    template <typename T> void setColumn(long feature, T const * values)
+    {
+      debugAssertM(feature >= 0 && feature < numFeatures(), "FeatureFileWriter: Feature index out of bounds");
+
+      Feature & f = features[(array_size_t)feature];
+      array_size_t n = (array_size_t)(num_points * f.num_dims);
+      for (array_size_t i = 0; i < n; ++i)
+        f.set(i, static_cast<float32>(values[i]));
+    }
+
+    /** Write the features to a file. Throws an error if the file could not be written. */
+    void write(std::string const & path) const;
+
+  private:
+    /** A feature and its values. */
+    struct Feature
+    {
+      Feature(std::string const & name_, long num_dims_, FeatureStorage storage_, long num_points)
+      : name(name_), num_dims(num_dims_), storage(storage_)
+      {
+        if (storage == FeatureStorage::FLOAT16)
+          values16.resize((array_size_t)(num_points * num_dims), 0);
+        else
+          values32.resize((array_size_t)(num_points * num_dims), 0);
+      }
+
+      void set(array_size_t i, float32 value)
+      {
+        if (storage == FeatureStorage::FLOAT16)
+          values16[i] = Math::toFloat16(value);
+        else
+          values32[i] = value;
+      }
+
+      std::string name;
+      long num_dims;
+      FeatureStorage storage;
+      TheaArray<float32> values32;
+      TheaArray<uint16> values16;
+
+    }; // struct Feature
+
+    long num_points;
+    TheaArray<Feature> features;
+
+}; // class FeatureFileWriter
+
+/**
+ * Reads a columnar feature file (see FeatureFile for the format). The file is memory-mapped, so opening it is fast regardless
+ * of its size, only the parts that are actually accessed are read from disk, and features can be accessed in place, without
+ * copying, via getFloat32Data() and getFloat16Data().
+ */
+class THEA_API FeatureFileReader : private Noncopyable
+{
+  public:
+    /** Open a feature file. Throws an error if the file cannot be opened or is not a valid feature file. */
+    explicit FeatureFileReader(std::string const & path);
+
+    /** Get the path of the file. */
+    std::string const & getPath() const { return file.getPath(); }
+
+    /** Get the number of points. */
+    long numPoints() const { return num_points; }
+
+    /** Get the number of features. */
+    long numFeatures() const { return (long)features.size(); }
+
+    /** Get the name of a feature. */
+    std::string const & getFeatureName(long feature) const { return getFeature(feature).name; }
+
+    /** Get the number of dimensions (values per point) of a feature. */
+    long getFeatureDims(long feature) const { return getFeature(feature).num_dims; }
+
+    /** Get the precision with which a feature is stored. */
+    FeatureStorage getFeatureStorage(long feature) const { return getFeature(feature).storage; }
+
+    /** Get the index of the first feature with a given name, or a negative value if there is no such feature. */
+    long findFeature(std::string const & name) const;
+
+    /**
+     * Get direct access to the values of a feature stored as 32-bit floats, with the values for each point stored
+     * consecutively. Returns null if the feature is stored in a different format.
+     */
+    float32 const * getFloat32Data(long feature) const;
+
+    /**
+     * Get direct access to the values of a feature stored as 16-bit floats (which can be converted with Math::fromFloat16()),
+     * with the values for each point stored consecutively. Returns null if the feature is stored in a different format.
+     */
+    uint16 const * getFloat16Data(long feature) const;
+
+    /** Get a single value of a feature, converted to single precision. */
+    float32 getValue(long feature, long point, long dim = 0) const;
+
+    /** Get the values of a feature for a single point, converted to single precision. */
+    void getValues(long feature, long point, float32 * values) const;
+
+    /**
+     * Get a single dimension of a feature for all points, converted to single precision. \a values must have space for
+     * numPoints() values.
+     */
+    void getDimension(long feature, long dim, float32 * values) const;
+
+  private:
+    /** Description of a feature in the file. */
+    struct Feature
+    {
+      std::string name;
+      long num_dims;
+      FeatureStorage storage;
+      uint8 const * data;
+    };
+
+    /** Get a feature by index. */
+    Feature const & getFeature(long feature) const
+    {
+      debugAssertM(feature >= 0 && feature < numFeatures(), "FeatureFileReader: Feature index out of bounds");
+      return features[(array_size_t)feature];
+    }
+
+    MappedFile file;
+    long num_points;
+    TheaArray<Feature> features;
+
+}; // class FeatureFileReader
+
+} // namespace Thea
+
+#endif
@@ -733,6 +733,19 @@ DisplayMesh::uploadToGraphicsSystem(RenderSystem & render_system)
   allGPUBuffersAreValid();
 }
 
+void
+DisplayMesh::releaseGPUBuffers(RenderSystem & render_system)
+{
+  if (var_area)
+  {
+    render_system.destroyVARArea(var_area);
+    var_area = NULL;
+  }
+
+  vertices_var = normals_var = colors_var = texcoords_var = tris_var = quads_var = edges_var = NULL;
+  invalidateGPUBuffers();
+}
+
 void
 DisplayMesh::draw(RenderSystem & render_system, RenderOptions const & options) const
 {
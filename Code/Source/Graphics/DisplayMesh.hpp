@@ -661,6 +661,12 @@ class THEA_API DisplayMesh : public virtual NamedObject, public DrawableObject
 
     void uploadToGraphicsSystem(RenderSystem & render_system);
 
+    /**
+     * Destroy the GPU buffers holding the mesh data, if any, and return the memory to the rendersystem. The data will be uploaded
+     * again the next time the mesh is drawn. The rendersystem must be the one the mesh was last drawn with.
+     */
+    void releaseGPUBuffers(RenderSystem & render_system);
+
     void draw(RenderSystem & render_system, RenderOptions const & options = RenderOptions::defaults()) const;
 
     void updateBounds();
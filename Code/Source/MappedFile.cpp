@@ -0,0 +1,194 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "MappedFile.hpp"
+
+#ifdef THEA_WINDOWS
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+
+#  if !defined(NOMINMAX) && defined(_MSC_VER)
+#    define NOMINMAX  // required to stop windows.h messing up std::min
+#  endif
+
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  include <cerrno>
+#  include <cstring>
+#endif
+
+namespace Thea {
+
+MappedFile::MappedFile()
+: contents(NULL), num_bytes(0)
+#ifdef THEA_WINDOWS
+  , file_handle(NULL), mapping_handle(NULL)
+#endif
+{}
+
+MappedFile::MappedFile(std::string const & path_)
+: contents(NULL), num_bytes(0)
+#ifdef THEA_WINDOWS
+  , file_handle(NULL), mapping_handle(NULL)
+#endif
+{
+  open(path_);
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+#ifdef THEA_WINDOWS
+
+void
+MappedFile::open(std::string const & path_)
+{
+  close();
+
+  HANDLE file = CreateFileA(path_.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    throw Error("MappedFile: Could not open file '" + path_ + '\'');
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size))
+  {
+    CloseHandle(file);
+    throw Error("MappedFile: Could not get size of file '" + path_ + '\'');
+  }
+
+  HANDLE mapping = NULL;
+  void const * addr = NULL;
+  if (file_size.QuadPart > 0)
+  {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+      CloseHandle(file);
+      throw Error("MappedFile: Could not create mapping for file '" + path_ + '\'');
+    }
+
+    addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!addr)
+    {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      throw Error("MappedFile: Could not map file '" + path_ + '\'');
+    }
+  }
+
+  path = path_;
+  contents = static_cast<uint8 const *>(addr);
+  num_bytes = (int64)file_size.QuadPart;
+  file_handle = file;
+  mapping_handle = mapping;
+}
+
+void
+MappedFile::close()
+{
+  if (contents) UnmapViewOfFile(contents);
+  if (mapping_handle) CloseHandle((HANDLE)mapping_handle);
+  if (file_handle) CloseHandle((HANDLE)file_handle);
+
+  path.clear();
+  contents = NULL;
+  num_bytes = 0;
+  file_handle = NULL;
+  mapping_handle = NULL;
+}
+
+#else
+
+void
+MappedFile::open(std::string const & path_)
+{
+  close();
+
+  int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw Error("MappedFile: Could not open file '" + path_ + "' (" + std::strerror(errno) + ')');
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    throw Error("MappedFile: Could not get size of file '" + path_ + '\'');
+  }
+
+  void * addr = NULL;
+  if (st.st_size > 0)
+  {
+    addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+      ::close(fd);
+      throw Error("MappedFile: Could not map file '" + path_ + "' (" + std::strerror(errno) + ')');
+    }
+  }
+
+  ::close(fd);  // the mapping remains valid after the descriptor is closed
+
+  path = path_;
+  contents = static_cast<uint8 const *>(addr);
+  num_bytes = (int64)st.st_size;
+}
+
+void
+MappedFile::close()
+{
+  if (contents)
+    munmap(const_cast<uint8 *>(contents), (size_t)num_bytes);
+
+  path.clear();
+  contents = NULL;
+  num_bytes = 0;
+}
+
+#endif
+
+} // namespace Thea
@@ -0,0 +1,102 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_MappedFile_hpp__
+#define __Thea_MappedFile_hpp__
+
+#include "Common.hpp"
+#include "Noncopyable.hpp"
+
+namespace Thea {
+
+/**
+ * A read-only view of a file that is mapped into the address space of the process. Pages of the file are loaded from disk on
+ * demand when first accessed, and are shared with other processes (and other mappings of the same file), so very large files
+ * can be accessed without reading them into memory in their entirety.
+ */
+class THEA_API MappedFile : private Noncopyable
+{
+  public:
+    /** Default constructor. Creates an empty object not associated with any file. */
+    MappedFile();
+
+    /** Map a file into memory. Throws an error if the file cannot be mapped. */
+    explicit MappedFile(std::string const & path_);
+
+    /** Destructor. Unmaps the file. */
+    ~MappedFile();
+
+    /**
+     * Map a file into memory, unmapping any previously mapped file. Throws an error if the file cannot be mapped, in which case
+     * the object is left closed.
+     */
+    void open(std::string const & path_);
+
+    /** Unmap the file, if any. */
+    void close();
+
+    /** Check if a file is currently mapped. */
+    bool isOpen() const { return !path.empty(); }
+
+    /** Get the path of the mapped file. */
+    std::string const & getPath() const { return path; }
+
+    /** Get a pointer to the start of the mapped file contents. Null if the file is not open or is empty. */
+    uint8 const * data() const { return contents; }
+
+    /** Get the size of the mapped file in bytes. */
+    int64 size() const { return num_bytes; }
+
+  private:
+    std::string path;        ///< Path of the mapped file.
+    uint8 const * contents;  ///< Start of the mapped contents.
+    int64 num_bytes;         ///< Size of the mapped file.
+
+#ifdef THEA_WINDOWS
+    void * file_handle;     ///< Handle to the open file.
+    void * mapping_handle;  ///< Handle to the file mapping object.
+#endif
+
+}; // class MappedFile
+
+} // namespace Thea
+
+#endif
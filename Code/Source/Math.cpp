@@ -42,6 +42,7 @@
 #include "Math.hpp"
 #include "Array.hpp"
 #include <algorithm>
+#include <cstring>
 
 namespace Thea {
 namespace Math {
@@ -267,5 +268,78 @@ solveQuartic(double c0, double c1, double c2, double c3, double c4, double * roo
   return num_roots;
 }
 
+uint16
+toFloat16(float32 f)
+{
+  uint32 x;
+  std::memcpy(&x, &f, sizeof(x));
+
+  uint32 sign = (x >> 16) & 0x8000;
+  uint32 mag = x & 0x7FFFFFFF;
+
+  if (mag >= 0x7F800000)  // infinity or NaN (keep NaNs quiet)
+    return (uint16)(sign | 0x7C00 | (mag > 0x7F800000 ? 0x0200 | ((mag >> 13) & 0x03FF) : 0));
+
+  if (mag >= 0x477FF000)  // rounds to a value larger than the largest half-precision float (65504)
+    return (uint16)(sign | 0x7C00);
+
+  if (mag < 0x38800000)  // smaller than the smallest normal half-precision float (2^-14)
+  {
+    if (mag <= 0x33000000)  // at most half the smallest subnormal (2^-24), so rounds to zero
+      return (uint16)sign;
+
+    uint32 exponent = mag >> 23;
+    uint32 mantissa = (mag & 0x007FFFFF) | 0x00800000;
+    uint32 shift = 126 - exponent;
+    uint32 h = mantissa >> shift;
+    uint32 rem = mantissa & ((1u << shift) - 1);
+    uint32 halfway = 1u << (shift - 1);
+    if (rem > halfway || (rem == halfway && (h & 1)))
+      ++h;  // may carry into the exponent, producing the smallest normal number, which is correct
+
+    return (uint16)(sign | h);
+  }
+
+  // Normal number: rebias the exponent from 127 to 15 and round the mantissa from 23 to 10 bits
+  uint32 h = (mag - 0x38000000) >> 13;
+  uint32 rem = mag & 0x1FFF;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+    ++h;
+
+  return (uint16)(sign | h);
+}
+
+float32
+fromFloat16(uint16 h)
+{
+  uint32 sign = (uint32)(h & 0x8000) << 16;
+  uint32 exponent = (h >> 10) & 0x1F;
+  uint32 mantissa = h & 0x03FF;
+
+  uint32 x;
+  if (exponent == 0x1F)  // infinity or NaN
+    x = sign | 0x7F800000 | (mantissa << 13);
+  else if (exponent != 0)
+    x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  else if (mantissa == 0)
+    x = sign;
+  else
+  {
+    // Subnormal half-precision, normal single-precision
+    exponent = 113;
+    while (!(mantissa & 0x0400))
+    {
+      mantissa <<= 1;
+      --exponent;
+    }
+
+    x = sign | (exponent << 23) | ((mantissa & 0x03FF) << 13);
+  }
+
+  float32 f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
 } // namespace Math
 } // namespace Thea
@@ -497,8 +497,10 @@ fastArcTan2(float dy, float dx)
     float t = dx / dy;
     a = (t < 0 ? -INV_TRIG_TABLE[valueToInvTrigIndex(-t)][2] : INV_TRIG_TABLE[valueToInvTrigIndex(t)][2]);
 
-    if (a < 0)  a = -MY_HALF_PI - a;  // a is negative, so we're adding
-    else        a =  MY_HALF_PI - a;
+    // Pick the branch by the sign of t, not of a, since the table can round a small ratio to zero. If t is zero (dx is zero),
+    // the sign of dy decides.
+    if (t < 0 || (t == 0 && dy < 0))  a = -MY_HALF_PI - a;  // a is non-positive, so we're adding
+    else                              a =  MY_HALF_PI - a;
   }
 
   if (dx < 0)  // lower two quadrants
@@ -599,6 +601,21 @@ THEA_API int solveCubic(double c0, double c1, double c2, double c3, double * roo
  */
 THEA_API int solveQuartic(double c0, double c1, double c2, double c3, double c4, double * roots);
 
+/**
+ * Convert a single-precision float to the nearest IEEE 754 half-precision (16-bit) float, rounding ties to even. Values too
+ * large in magnitude become infinities, and NaNs remain NaNs.
+ *
+ * @see fromFloat16()
+ */
+THEA_API uint16 toFloat16(float32 f);
+
+/**
+ * Convert an IEEE 754 half-precision (16-bit) float to single precision. The conversion is exact.
+ *
+ * @see toFloat16()
+ */
+THEA_API float32 fromFloat16(uint16 h);
+
 namespace MathInternal {
 
 // exp(-x) approximations from http://www.xnoiz.co.cc/fast-exp-x/
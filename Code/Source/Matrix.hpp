@@ -47,6 +47,7 @@
 #include "AddressableMatrix.hpp"
 #include "Array.hpp"
 #include "MatrixInvert.hpp"
+#include "MatrixMultiply.hpp"
 #include "ResizableMatrix.hpp"
 #include <boost/type_traits/is_base_of.hpp>
 #include <boost/utility/enable_if.hpp>
@@ -59,6 +60,11 @@ namespace Thea {
 template <typename T, MatrixLayout::Value L, typename Index2DT, typename Index1DT> class CompressedSparseMatrix;
 template <typename T, typename Index2DT, typename Index1DT> class CompressedRowMatrix;
 template <typename T, typename Index2DT, typename Index1DT> class CompressedColumnMatrix;
+template <typename T, MatrixLayout::Value L, typename AllocT> class Matrix;
+
+template <typename T, MatrixLayout::Value L1, typename A1, MatrixLayout::Value L2, typename A2, MatrixLayout::Value L3,
+          typename A3>
+void multiply(Matrix<T, L1, A1> const & a, Matrix<T, L2, A2> const & b, Matrix<T, L3, A3> & result);
 
 /** A standard dense 2D matrix, either row-major or column-major. */
 template < typename T, MatrixLayout::Value L = MatrixLayout::ROW_MAJOR, typename AllocT = std::allocator<T> >
@@ -587,84 +593,71 @@ class /* THEA_API */ Matrix : public AddressableMatrix<T>, public ResizableMatri
       return *this;
     }
 
-    /** Multiplication. */
+    /**
+     * Multiplication. Creates a new matrix for the result, so you might prefer multiply(Matrix const &, Matrix const &,
+     * Matrix &), which can reuse the storage of an existing matrix.
+     */
     Matrix operator*(Matrix const & rhs) const
     {
-      alwaysAssertM(numColumns() == rhs.numRows(), "Matrix: Matrices don't have compatible dimensions for multiplication");
+      Matrix result;
+      multiply(*this, rhs, result);
+      return result;
+    }
 
-      Matrix result(numRows(), rhs.numColumns());
-      for (long i = 0; i < numRows(); ++i)
-        for (long k = 0; k < rhs.numColumns(); ++k)
-        {
-          result(i, k) = (*this)(i, 0) * rhs(0, k);
+    /**
+     * Post-multiply by a matrix and assign. The product is computed in a new storage block, which then replaces the storage of
+     * this matrix. If this matrix does not own its storage, the product must have the same dimensions as this matrix, and is
+     * copied back into the storage block.
+     */
+    Matrix & operator*=(Matrix const & rhs)
+    {
+      Matrix product;
+      multiply(*this, rhs, product);
 
-          for (long j = 1; j < numColumns(); ++j)
-            result(i, k) += (*this)(i, j) * rhs(j, k);
-        }
+      if (owns_memory)
+      {
+        std::swap(num_rows, product.num_rows);
+        std::swap(num_cols, product.num_cols);
+        std::swap(values, product.values);
+      }
+      else
+      {
+        alwaysAssertM(num_rows == product.num_rows && num_cols == product.num_cols,
+                      "Matrix: A wrapper matrix cannot be assigned a value of different dimensions");
+        Algorithms::fastCopy(product.values, product.values + this->numElements(), values);
+      }
 
-      return result;
+      return *this;
     }
 
     /**
-     * Multiply a vector \a v by this matrix (M), yielding the product \a result = M * \a v.
+     * Multiply a vector \a v by this matrix (M), yielding the product \a result = M * \a v. If the vector has the same element
+     * type as the matrix, optimized (and for large matrices, multithreaded) kernels are used.
      *
      * @param v The vector to be multiplied, must contain numColumns() elements.
-     * @param result The result vector, must be preallocated to numRows() elements.
+     * @param result The result vector, must be preallocated to numRows() elements, and must not overlap \a v.
      */
     template <typename U> void postmulVector(U const * v, U * result) const
     {
       debugAssertM(v, "Matrix: Vector to be multiplied cannot be null");
       debugAssertM(result, "Matrix: Result vector of multiplication cannot be null");
 
-      if (L == MatrixLayout::ROW_MAJOR)
-      {
-        for (long r = 0; r < num_rows; ++r)
-        {
-          result[r] = static_cast<U>(0);
-          for (long c = 0; c < num_cols; ++c)
-            result[r] += static_cast<U>((*this)(r, c) * v[c]);
-        }
-      }
-      else
-      {
-        for (long r = 0; r < num_rows; ++r)
-          result[r] = static_cast<U>(0);
-
-        for (long c = 0; c < num_cols; ++c)
-          for (long r = 0; r < num_rows; ++r)
-            result[r] += static_cast<U>((*this)(r, c) * v[c]);
-      }
+      postmulVectorImpl(v, result);
     }
 
     /**
-     * Multiply a vector \a v by this matrix (M), yielding the product \a result = \a v * M.
+     * Multiply a vector \a v by this matrix (M), yielding the product \a result = \a v * M. If the vector has the same element
+     * type as the matrix, optimized (and for large matrices, multithreaded) kernels are used.
      *
      * @param v The vector to be multiplied, must contain numRows() elements.
-     * @param result The result vector, must be preallocated to numColumns() elements.
+     * @param result The result vector, must be preallocated to numColumns() elements, and must not overlap \a v.
      */
     template <typename U> void premulVector(U const * v, U * result) const
     {
       debugAssertM(v, "Matrix: Vector to be multiplied cannot be null");
       debugAssertM(result, "Matrix: Result vector of multiplication cannot be null");
 
-      if (L == MatrixLayout::ROW_MAJOR)
-      {
-        for (long c = 0; c < num_cols; ++c)
-          result[c] = static_cast<U>(0);
-
-        for (long r = 0; r < num_rows; ++r)
-          for (long c = 0; c < num_cols; ++c)
-            result[c] += static_cast<U>(v[r] * (*this)(r, c));
-      }
-      else
-      {
-        for (long c = 0; c < num_cols; ++c)
-        {
-          result[c] = static_cast<U>(0);
-          for (long r = 0; r < num_rows; ++r)
-            result[c] += static_cast<U>(v[r] * (*this)(r, c));
-        }
-      }
+      premulVectorImpl(v, result);
     }
 
     /**
@@ -721,6 +714,71 @@ class /* THEA_API */ Matrix : public AddressableMatrix<T>, public ResizableMatri
     }
 
   private:
+    /** Distance between consecutive rows in the storage block. */
+    long rowStride() const { return L == MatrixLayout::ROW_MAJOR ? num_cols : 1; }
+
+    /** Distance between consecutive columns in the storage block. */
+    long columnStride() const { return L == MatrixLayout::ROW_MAJOR ? 1 : num_rows; }
+
+    /** Multiply a vector by this matrix, when the vector has the same element type as the matrix. */
+    void postmulVectorImpl(T const * v, T * result) const
+    {
+      Internal::gemv(num_rows, num_cols, values, rowStride(), columnStride(), v, result);
+    }
+
+    /** Multiply a vector by this matrix, when the vector has a different element type from the matrix. */
+    template <typename U> void postmulVectorImpl(U const * v, U * result) const
+    {
+      if (L == MatrixLayout::ROW_MAJOR)
+      {
+        for (long r = 0; r < num_rows; ++r)
+        {
+          result[r] = static_cast<U>(0);
+          for (long c = 0; c < num_cols; ++c)
+            result[r] += static_cast<U>((*this)(r, c) * v[c]);
+        }
+      }
+      else
+      {
+        for (long r = 0; r < num_rows; ++r)
+          result[r] = static_cast<U>(0);
+
+        for (long c = 0; c < num_cols; ++c)
+          for (long r = 0; r < num_rows; ++r)
+            result[r] += static_cast<U>((*this)(r, c) * v[c]);
+      }
+    }
+
+    /** Pre-multiply a vector by this matrix, when the vector has the same element type as the matrix. */
+    void premulVectorImpl(T const * v, T * result) const
+    {
+      // v * M is the same as M^T * v, and transposing swaps the strides
+      Internal::gemv(num_cols, num_rows, values, columnStride(), rowStride(), v, result);
+    }
+
+    /** Pre-multiply a vector by this matrix, when the vector has a different element type from the matrix. */
+    template <typename U> void premulVectorImpl(U const * v, U * result) const
+    {
+      if (L == MatrixLayout::ROW_MAJOR)
+      {
+        for (long c = 0; c < num_cols; ++c)
+          result[c] = static_cast<U>(0);
+
+        for (long r = 0; r < num_rows; ++r)
+          for (long c = 0; c < num_cols; ++c)
+            result[c] += static_cast<U>(v[r] * (*this)(r, c));
+      }
+      else
+      {
+        for (long c = 0; c < num_cols; ++c)
+        {
+          result[c] = static_cast<U>(0);
+          for (long r = 0; r < num_rows; ++r)
+            result[c] += static_cast<U>(v[r] * (*this)(r, c));
+        }
+      }
+    }
+
     long num_rows, num_cols;
     T * values;
     bool owns_memory;
@@ -735,6 +793,46 @@ operator*(T const & s, Matrix<T, L> const & m)
   return m * s;
 }
 
+/**
+ * Multiply two matrices, placing the product in \a result, which is resized if necessary. No memory is allocated if \a result
+ * already has the right dimensions (in particular, \a result may be a wrapper for an existing storage block of the right
+ * size). The matrices may have any layouts. The product is computed with cache-blocked kernels that, for float and double
+ * matrices, are SIMD-accelerated and split large products across threads.
+ *
+ * \a result may be the same object as \a a or \a b, in which case the product is first computed in a temporary matrix.
+ */
+template <typename T, MatrixLayout::Value L1, typename A1, MatrixLayout::Value L2, typename A2, MatrixLayout::Value L3,
+          typename A3>
+void
+multiply(Matrix<T, L1, A1> const & a, Matrix<T, L2, A2> const & b, Matrix<T, L3, A3> & result)
+{
+  alwaysAssertM(a.numColumns() == b.numRows(), "Matrix: Matrices don't have compatible dimensions for multiplication");
+
+  if (static_cast<void const *>(&result) == static_cast<void const *>(&a)
+   || static_cast<void const *>(&result) == static_cast<void const *>(&b))
+  {
+    Matrix<T, L3, A3> product;
+    multiply(a, b, product);
+    result = product;
+    return;
+  }
+
+  long m = a.numRows(), n = b.numColumns(), k = a.numColumns();
+  if (result.numRows() != m || result.numColumns() != n)
+    result.resize(m, n);
+
+  if (k <= 0)
+  {
+    result.makeZero();
+    return;
+  }
+
+  Internal::gemm(m, n, k,
+                 a.data(), (L1 == MatrixLayout::ROW_MAJOR ? k : 1), (L1 == MatrixLayout::ROW_MAJOR ? 1 : m),
+                 b.data(), (L2 == MatrixLayout::ROW_MAJOR ? n : 1), (L2 == MatrixLayout::ROW_MAJOR ? 1 : k),
+                 result.data(), (L3 == MatrixLayout::ROW_MAJOR ? n : 1), (L3 == MatrixLayout::ROW_MAJOR ? 1 : m));
+}
+
 } // namespace Thea
 
 #endif
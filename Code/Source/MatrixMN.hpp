@@ -494,6 +494,9 @@ class /* THEA_API */ MatrixMN<N, N, T> : public Internal::SquareMatrixN<N, T>
      */
     MatrixMN inverse() const { MatrixMN result = *this; result.invert(); return result; }
 
+    // Don't hide the multiplication operators of the base class
+    using BaseT::operator*;
+
     /**
      * Post-multiply by a vector of one lower dimension, using homogenous coordinates. The last (homogenous) coordinate of the
      * vector is assumed to be 1, i.e. this is assumed to be a position vector.
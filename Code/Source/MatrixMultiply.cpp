@@ -0,0 +1,417 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "MatrixMultiply.hpp"
+#include "ParallelFor.hpp"
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#  define THEA_MATRIX_MULTIPLY_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define THEA_MATRIX_MULTIPLY_SSE2
+#endif
+
+namespace Thea {
+namespace Internal {
+
+namespace MatrixMultiplyInternal {
+
+// Wrappers for the SIMD instructions on packed floats or doubles, selected by the instruction set the library is compiled for.
+// Each provides the vector type, its width, and the operations needed by the kernels below.
+template <typename T> struct SimdOps { static int const WIDTH = 0; };
+
+#if defined(THEA_MATRIX_MULTIPLY_AVX)
+
+template <>
+struct SimdOps<float>
+{
+  typedef __m256 Vec;
+  static int const WIDTH = 8;
+
+  static Vec zero() { return _mm256_setzero_ps(); }
+  static Vec load(float const * p) { return _mm256_loadu_ps(p); }
+  static void store(float * p, Vec v) { _mm256_storeu_ps(p, v); }
+  static Vec broadcast(float const * p) { return _mm256_broadcast_ss(p); }
+  static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+#ifdef __FMA__
+  static Vec mulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+  static Vec mulAdd(Vec a, Vec b, Vec c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+};
+
+template <>
+struct SimdOps<double>
+{
+  typedef __m256d Vec;
+  static int const WIDTH = 4;
+
+  static Vec zero() { return _mm256_setzero_pd(); }
+  static Vec load(double const * p) { return _mm256_loadu_pd(p); }
+  static void store(double * p, Vec v) { _mm256_storeu_pd(p, v); }
+  static Vec broadcast(double const * p) { return _mm256_broadcast_sd(p); }
+  static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+#ifdef __FMA__
+  static Vec mulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+#else
+  static Vec mulAdd(Vec a, Vec b, Vec c) { return _mm256_add_pd(_mm256_mul_pd(a, b), c); }
+#endif
+};
+
+#elif defined(THEA_MATRIX_MULTIPLY_SSE2)
+
+template <>
+struct SimdOps<float>
+{
+  typedef __m128 Vec;
+  static int const WIDTH = 4;
+
+  static Vec zero() { return _mm_setzero_ps(); }
+  static Vec load(float const * p) { return _mm_loadu_ps(p); }
+  static void store(float * p, Vec v) { _mm_storeu_ps(p, v); }
+  static Vec broadcast(float const * p) { return _mm_set1_ps(*p); }
+  static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+  static Vec mulAdd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+};
+
+template <>
+struct SimdOps<double>
+{
+  typedef __m128d Vec;
+  static int const WIDTH = 2;
+
+  static Vec zero() { return _mm_setzero_pd(); }
+  static Vec load(double const * p) { return _mm_loadu_pd(p); }
+  static void store(double * p, Vec v) { _mm_storeu_pd(p, v); }
+  static Vec broadcast(double const * p) { return _mm_set1_pd(*p); }
+  static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+  static Vec mulAdd(Vec a, Vec b, Vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+};
+
+#endif
+
+// Tile kernel for GemmDriver that keeps a tile of MR rows and two SIMD vectors per row in registers. With 16 vector registers,
+// 4 rows (AVX: 6 rows) leave enough registers free for the operands.
+template <typename T, bool HasSimd = (SimdOps<T>::WIDTH > 0)>
+struct SimdGemmKernel : public GemmKernel<T> {};
+
+template <typename T>
+struct SimdGemmKernel<T, true>
+{
+  typedef SimdOps<T> Ops;
+  typedef typename Ops::Vec Vec;
+
+#if defined(THEA_MATRIX_MULTIPLY_AVX)
+  static int const MR = 6;
+#else
+  static int const MR = 4;
+#endif
+  static int const NR = 2 * Ops::WIDTH;
+
+  static void run(long kc, T const * ap, T const * bp, T * tile)
+  {
+    // Written out in full since compilers do not reliably keep arrays of accumulators in registers
+    Vec c00 = Ops::zero(), c01 = Ops::zero(), c10 = Ops::zero(), c11 = Ops::zero();
+    Vec c20 = Ops::zero(), c21 = Ops::zero(), c30 = Ops::zero(), c31 = Ops::zero();
+#if defined(THEA_MATRIX_MULTIPLY_AVX)
+    Vec c40 = Ops::zero(), c41 = Ops::zero(), c50 = Ops::zero(), c51 = Ops::zero();
+#endif
+
+    for (long k = 0; k < kc; ++k, ap += MR, bp += NR)
+    {
+      Vec b0 = Ops::load(bp), b1 = Ops::load(bp + Ops::WIDTH), a;
+      a = Ops::broadcast(ap + 0); c00 = Ops::mulAdd(a, b0, c00); c01 = Ops::mulAdd(a, b1, c01);
+      a = Ops::broadcast(ap + 1); c10 = Ops::mulAdd(a, b0, c10); c11 = Ops::mulAdd(a, b1, c11);
+      a = Ops::broadcast(ap + 2); c20 = Ops::mulAdd(a, b0, c20); c21 = Ops::mulAdd(a, b1, c21);
+      a = Ops::broadcast(ap + 3); c30 = Ops::mulAdd(a, b0, c30); c31 = Ops::mulAdd(a, b1, c31);
+#if defined(THEA_MATRIX_MULTIPLY_AVX)
+      a = Ops::broadcast(ap + 4); c40 = Ops::mulAdd(a, b0, c40); c41 = Ops::mulAdd(a, b1, c41);
+      a = Ops::broadcast(ap + 5); c50 = Ops::mulAdd(a, b0, c50); c51 = Ops::mulAdd(a, b1, c51);
+#endif
+    }
+
+    int const W = Ops::WIDTH;
+    Ops::store(tile + 0 * NR, c00); Ops::store(tile + 0 * NR + W, c01);
+    Ops::store(tile + 1 * NR, c10); Ops::store(tile + 1 * NR + W, c11);
+    Ops::store(tile + 2 * NR, c20); Ops::store(tile + 2 * NR + W, c21);
+    Ops::store(tile + 3 * NR, c30); Ops::store(tile + 3 * NR + W, c31);
+#if defined(THEA_MATRIX_MULTIPLY_AVX)
+    Ops::store(tile + 4 * NR, c40); Ops::store(tile + 4 * NR + W, c41);
+    Ops::store(tile + 5 * NR, c50); Ops::store(tile + 5 * NR + W, c51);
+#endif
+  }
+
+}; // struct SimdGemmKernel
+
+// Dot product of two contiguous vectors, using four independent SIMD accumulators if possible.
+template <typename T, bool HasSimd = (SimdOps<T>::WIDTH > 0)>
+struct Dot
+{
+  static T compute(long n, T const * x, T const * y)
+  {
+    T sum = static_cast<T>(0);
+    for (long i = 0; i < n; ++i)
+      sum += x[i] * y[i];
+
+    return sum;
+  }
+};
+
+template <typename T>
+struct Dot<T, true>
+{
+  static T compute(long n, T const * x, T const * y)
+  {
+    typedef SimdOps<T> Ops;
+    typedef typename Ops::Vec Vec;
+    int const W = Ops::WIDTH;
+
+    Vec s0 = Ops::zero(), s1 = Ops::zero(), s2 = Ops::zero(), s3 = Ops::zero();
+    long i = 0;
+    for ( ; i + 4 * W <= n; i += 4 * W)
+    {
+      s0 = Ops::mulAdd(Ops::load(x + i),         Ops::load(y + i),         s0);
+      s1 = Ops::mulAdd(Ops::load(x + i + W),     Ops::load(y + i + W),     s1);
+      s2 = Ops::mulAdd(Ops::load(x + i + 2 * W), Ops::load(y + i + 2 * W), s2);
+      s3 = Ops::mulAdd(Ops::load(x + i + 3 * W), Ops::load(y + i + 3 * W), s3);
+    }
+
+    T lanes[W];
+    Ops::store(lanes, Ops::add(Ops::add(s0, s1), Ops::add(s2, s3)));
+
+    T sum = static_cast<T>(0);
+    for (int j = 0; j < W; ++j)
+      sum += lanes[j];
+
+    for ( ; i < n; ++i)
+      sum += x[i] * y[i];
+
+    return sum;
+  }
+};
+
+// Compute y += alpha * x for contiguous vectors.
+template <typename T, bool HasSimd = (SimdOps<T>::WIDTH > 0)>
+struct Axpy
+{
+  static void compute(long n, T alpha, T const * x, T * y)
+  {
+    for (long i = 0; i < n; ++i)
+      y[i] += alpha * x[i];
+  }
+};
+
+template <typename T>
+struct Axpy<T, true>
+{
+  static void compute(long n, T alpha, T const * x, T * y)
+  {
+    typedef SimdOps<T> Ops;
+    typedef typename Ops::Vec Vec;
+    int const W = Ops::WIDTH;
+
+    Vec va = Ops::broadcast(&alpha);
+    long i = 0;
+    for ( ; i + 2 * W <= n; i += 2 * W)
+    {
+      Ops::store(y + i,     Ops::mulAdd(va, Ops::load(x + i),     Ops::load(y + i)));
+      Ops::store(y + i + W, Ops::mulAdd(va, Ops::load(x + i + W), Ops::load(y + i + W)));
+    }
+
+    for ( ; i < n; ++i)
+      y[i] += alpha * x[i];
+  }
+};
+
+// Choose the number of threads for a product with a given number of independent rows and a given number of multiply-adds.
+// Small products are not worth the cost of starting threads.
+long
+numThreads(long num_rows, long min_rows_per_thread, double num_ops, double min_ops_per_thread)
+{
+  return std::min(numThreadsForWork(num_rows, min_rows_per_thread), numThreadsForWork(num_ops, min_ops_per_thread));
+}
+
+// Multiplies a range of rows of the left operand by the right operand.
+template <typename T>
+class GemmTask
+{
+  public:
+    GemmTask(long n_, long k_, T const * a_, long a_rs_, long a_cs_, T const * b_, long b_rs_, long b_cs_, T * c_, long c_rs_,
+             long c_cs_)
+    : n(n_), k(k_), a(a_), a_rs(a_rs_), a_cs(a_cs_), b(b_), b_rs(b_rs_), b_cs(b_cs_), c(c_), c_rs(c_rs_), c_cs(c_cs_)
+    {}
+
+    void operator()(long begin, long end)
+    {
+      GemmDriver< T, SimdGemmKernel<T> > driver;
+      driver.run(end - begin, n, k, a + begin * a_rs, a_rs, a_cs, b, b_rs, b_cs, c + begin * c_rs, c_rs, c_cs);
+    }
+
+  private:
+    long n, k;
+    T const * a; long a_rs, a_cs;
+    T const * b; long b_rs, b_cs;
+    T * c; long c_rs, c_cs;
+
+}; // class GemmTask
+
+template <typename T>
+void
+gemmImpl(long m, long n, long k, T const * a, long a_rs, long a_cs, T const * b, long b_rs, long b_cs, T * c, long c_rs,
+         long c_cs)
+{
+  typedef GemmDriver< T, SimdGemmKernel<T> > Driver;
+
+  // Tiny products gain nothing from packing
+  if ((double)m * n * k <= 16 * 16 * 16)  // in double, since the product can overflow a 32-bit long
+  {
+    gemmDirect(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, c_rs, c_cs);
+    return;
+  }
+
+  for (long i = 0; i < m; ++i)
+    for (long j = 0; j < n; ++j)
+      c[i * c_rs + j * c_cs] = static_cast<T>(0);
+
+  // Give each thread a block of rows that is a multiple of the tile height
+  long num_threads = numThreads(m, Driver::MC, m * (double)n * k, 1 << 22);
+  long rows_per_thread = (m + num_threads - 1) / num_threads;
+  rows_per_thread = ((rows_per_thread + Driver::MR - 1) / Driver::MR) * Driver::MR;
+
+  parallelForChunks(m, GemmTask<T>(n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, c_rs, c_cs), rows_per_thread, num_threads);
+}
+
+// Multiplies a range of rows of a matrix by a vector.
+template <typename T>
+class GemvTask
+{
+  public:
+    GemvTask(long n_, T const * a_, long a_rs_, long a_cs_, T const * x_, T * y_)
+    : n(n_), a(a_), a_rs(a_rs_), a_cs(a_cs_), x(x_), y(y_)
+    {}
+
+    void operator()(long begin, long end)
+    {
+      long m = end - begin;
+      T const * ab = a + begin * a_rs;
+      T * yb = y + begin;
+
+      if (a_rs == 1)  // columns are contiguous, accumulate scaled columns
+      {
+        for (long i = 0; i < m; ++i)
+          yb[i] = static_cast<T>(0);
+
+        for (long j = 0; j < n; ++j)
+          Axpy<T>::compute(m, x[j], ab + j * a_cs, yb);
+      }
+      else if (a_cs == 1)  // rows are contiguous, take the dot product of each row with x
+      {
+        for (long i = 0; i < m; ++i)
+          yb[i] = Dot<T>::compute(n, ab + i * a_rs, x);
+      }
+      else
+      {
+        for (long i = 0; i < m; ++i)
+        {
+          T sum = static_cast<T>(0);
+          for (long j = 0; j < n; ++j)
+            sum += ab[i * a_rs + j * a_cs] * x[j];
+
+          yb[i] = sum;
+        }
+      }
+    }
+
+  private:
+    long n;
+    T const * a; long a_rs, a_cs;
+    T const * x;
+    T * y;
+
+}; // class GemvTask
+
+template <typename T>
+void
+gemvImpl(long m, long n, T const * a, long a_rs, long a_cs, T const * x, T * y)
+{
+  // Matrix-vector products are limited by memory bandwidth, so threads only pay off for matrices much larger than the cache
+  long num_threads = numThreads(m, 256, m * (double)n, 1 << 20);
+  long rows_per_thread = (m + num_threads - 1) / num_threads;
+  rows_per_thread = ((rows_per_thread + 15) / 16) * 16;  // keep blocks of contiguous columns aligned to cache lines
+
+  parallelForChunks(m, GemvTask<T>(n, a, a_rs, a_cs, x, y), rows_per_thread, num_threads);
+}
+
+} // namespace MatrixMultiplyInternal
+
+template <>
+void
+gemm<float>(long m, long n, long k, float const * a, long a_rs, long a_cs, float const * b, long b_rs, long b_cs, float * c,
+            long c_rs, long c_cs)
+{
+  MatrixMultiplyInternal::gemmImpl(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, c_rs, c_cs);
+}
+
+template <>
+void
+gemm<double>(long m, long n, long k, double const * a, long a_rs, long a_cs, double const * b, long b_rs, long b_cs,
+             double * c, long c_rs, long c_cs)
+{
+  MatrixMultiplyInternal::gemmImpl(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, c_rs, c_cs);
+}
+
+template <>
+void
+gemv<float>(long m, long n, float const * a, long a_rs, long a_cs, float const * x, float * y)
+{
+  MatrixMultiplyInternal::gemvImpl(m, n, a, a_rs, a_cs, x, y);
+}
+
+template <>
+void
+gemv<double>(long m, long n, double const * a, long a_rs, long a_cs, double const * x, double * y)
+{
+  MatrixMultiplyInternal::gemvImpl(m, n, a, a_rs, a_cs, x, y);
+}
+
+} // namespace Internal
+} // namespace Thea
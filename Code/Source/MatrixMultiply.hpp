@@ -0,0 +1,280 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_MatrixMultiply_hpp__
+#define __Thea_MatrixMultiply_hpp__
+
+#include "Common.hpp"
+#include "Array.hpp"
+#include <algorithm>
+
+namespace Thea {
+namespace Internal {
+
+/**
+ * <b>[Internal]</b> Portable register-blocked kernel for GemmDriver, that multiplies a packed MR x kc panel of the left operand
+ * by a packed kc x NR panel of the right operand. The float and double versions used by the library are SIMD-accelerated.
+ */
+template <typename T>
+struct GemmKernel
+{
+  static int const MR = 4;  ///< Number of rows of the result tile.
+  static int const NR = 4;  ///< Number of columns of the result tile.
+
+  /**
+   * Compute the MR x NR tile (stored row-major in \a tile) equal to the product of the packed panels \a ap (stores column k of
+   * the left panel at ap[k * MR]) and \a bp (stores row k of the right panel at bp[k * NR]).
+   */
+  static void run(long kc, T const * ap, T const * bp, T * tile)
+  {
+    for (int i = 0; i < MR * NR; ++i)
+      tile[i] = static_cast<T>(0);
+
+    for (long k = 0; k < kc; ++k, ap += MR, bp += NR)
+      for (int i = 0; i < MR; ++i)
+        for (int j = 0; j < NR; ++j)
+          tile[i * NR + j] += ap[i] * bp[j];
+  }
+
+}; // struct GemmKernel
+
+/**
+ * <b>[Internal]</b> Cache-blocked dense matrix multiplication, parametrized by the kernel that computes each small tile of the
+ * result. Blocks of the operands are copied into contiguous buffers ("packed") in the order in which the kernel reads them, so
+ * that each block of the right operand stays in cache while it is multiplied by every block of the left operand. The
+ * operands may have any layout: element (i, j) of a matrix X is at x[i * x_rs + j * x_cs], for row stride x_rs and column
+ * stride x_cs.
+ */
+template <typename T, typename KernelT>
+class GemmDriver
+{
+  public:
+    static int const MR = KernelT::MR;      ///< Number of rows of each tile of the result.
+    static int const NR = KernelT::NR;      ///< Number of columns of each tile of the result.
+    static long const MC = 16 * MR;         ///< Number of rows of each packed block of the left operand.
+    static long const KC = 256;             ///< Length of the inner dimension of each pair of packed blocks.
+    static long const NC = 256 * NR;        ///< Number of columns of each packed block of the right operand.
+
+    /** Compute C += A * B, where A is m x k, B is k x n and C is m x n. C must not overlap A or B. */
+    void run(long m, long n, long k, T const * a, long a_rs, long a_cs, T const * b, long b_rs, long b_cs, T * c, long c_rs,
+             long c_cs)
+    {
+      if (m <= 0 || n <= 0 || k <= 0)
+        return;
+
+      a_pack.resize((array_size_t)(std::min((long)MC, roundUp(m, MR)) * std::min((long)KC, k)));
+      b_pack.resize((array_size_t)(std::min((long)KC, k) * std::min((long)NC, roundUp(n, NR))));
+
+      T tile[MR * NR];
+
+      for (long jc = 0; jc < n; jc += NC)
+      {
+        long nc = std::min((long)NC, n - jc);
+
+        for (long pc = 0; pc < k; pc += KC)
+        {
+          long kc = std::min((long)KC, k - pc);
+          packRight(kc, nc, b + pc * b_rs + jc * b_cs, b_rs, b_cs, &b_pack[0]);
+
+          for (long ic = 0; ic < m; ic += MC)
+          {
+            long mc = std::min((long)MC, m - ic);
+            packLeft(mc, kc, a + ic * a_rs + pc * a_cs, a_rs, a_cs, &a_pack[0]);
+
+            for (long jr = 0; jr < nc; jr += NR)
+            {
+              long nr = std::min((long)NR, nc - jr);
+              T const * bp = &b_pack[0] + jr * kc;
+
+              for (long ir = 0; ir < mc; ir += MR)
+              {
+                long mr = std::min((long)MR, mc - ir);
+                KernelT::run(kc, &a_pack[0] + ir * kc, bp, tile);
+
+                T * c_tile = c + (ic + ir) * c_rs + (jc + jr) * c_cs;
+                for (long i = 0; i < mr; ++i)
+                  for (long j = 0; j < nr; ++j)
+                    c_tile[i * c_rs + j * c_cs] += tile[i * NR + j];
+              }
+            }
+          }
+        }
+      }
+    }
+
+  private:
+    /** Round a number up to a multiple of another. */
+    static long roundUp(long x, long multiple) { return ((x + multiple - 1) / multiple) * multiple; }
+
+    /** Pack an mc x kc block of the left operand into panels of MR rows, padding the last panel with zeros. */
+    static void packLeft(long mc, long kc, T const * a, long a_rs, long a_cs, T * dst)
+    {
+      for (long ip = 0; ip < mc; ip += MR)
+      {
+        long mr = std::min((long)MR, mc - ip);
+        for (long kk = 0; kk < kc; ++kk, dst += MR)
+        {
+          T const * src = a + ip * a_rs + kk * a_cs;
+          long i = 0;
+          for ( ; i < mr; ++i) dst[i] = src[i * a_rs];
+          for ( ; i < MR; ++i) dst[i] = static_cast<T>(0);
+        }
+      }
+    }
+
+    /** Pack a kc x nc block of the right operand into panels of NR columns, padding the last panel with zeros. */
+    static void packRight(long kc, long nc, T const * b, long b_rs, long b_cs, T * dst)
+    {
+      for (long jp = 0; jp < nc; jp += NR)
+      {
+        long nr = std::min((long)NR, nc - jp);
+        for (long kk = 0; kk < kc; ++kk, dst += NR)
+        {
+          T const * src = b + kk * b_rs + jp * b_cs;
+          long j = 0;
+          for ( ; j < nr; ++j) dst[j] = src[j * b_cs];
+          for ( ; j < NR; ++j) dst[j] = static_cast<T>(0);
+        }
+      }
+    }
+
+    TheaArray<T> a_pack;  ///< Packed block of the left operand.
+    TheaArray<T> b_pack;  ///< Packed block of the right operand.
+
+}; // class GemmDriver
+
+/**
+ * <b>[Internal]</b> Compute the dense matrix product C = A * B with a plain triple loop, for products too small to benefit from
+ * blocking. The arguments are as for gemm().
+ */
+template <typename T>
+void
+gemmDirect(long m, long n, long k, T const * a, long a_rs, long a_cs, T const * b, long b_rs, long b_cs, T * c, long c_rs,
+           long c_cs)
+{
+  for (long i = 0; i < m; ++i)
+  {
+    for (long j = 0; j < n; ++j)
+      c[i * c_rs + j * c_cs] = static_cast<T>(0);
+
+    for (long p = 0; p < k; ++p)
+    {
+      T a_ip = a[i * a_rs + p * a_cs];
+      for (long j = 0; j < n; ++j)
+        c[i * c_rs + j * c_cs] += a_ip * b[p * b_rs + j * b_cs];
+    }
+  }
+}
+
+/**
+ * <b>[Internal]</b> Compute the dense matrix product C = A * B, where A is m x k, B is k x n and C is m x n, with the strided
+ * layout described in GemmDriver. C must not overlap A or B. This function is called by the Matrix class and should not be
+ * used directly. The float and double versions, defined in the library, use SIMD kernels and split large products across
+ * threads by blocks of rows.
+ */
+template <typename T>
+void
+gemm(long m, long n, long k, T const * a, long a_rs, long a_cs, T const * b, long b_rs, long b_cs, T * c, long c_rs,
+     long c_cs)
+{
+  if ((double)m * n * k <= 16 * 16 * 16)  // in double, since the product can overflow a 32-bit long
+  {
+    gemmDirect(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, c_rs, c_cs);
+    return;
+  }
+
+  for (long i = 0; i < m; ++i)
+    for (long j = 0; j < n; ++j)
+      c[i * c_rs + j * c_cs] = static_cast<T>(0);
+
+  GemmDriver< T, GemmKernel<T> > driver;
+  driver.run(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, c_rs, c_cs);
+}
+
+/**
+ * <b>[Internal]</b> Compute the dense matrix-vector product y = A * x, where A is m x n with the strided layout described in
+ * GemmDriver, x has n elements and y has m elements. y must not overlap A or x. This function is called by the Matrix class
+ * and should not be used directly. The float and double versions, defined in the library, use SIMD kernels and split large
+ * products across threads by blocks of rows.
+ */
+template <typename T>
+void
+gemv(long m, long n, T const * a, long a_rs, long a_cs, T const * x, T * y)
+{
+  if (a_rs == 1)  // columns are contiguous, accumulate scaled columns
+  {
+    for (long i = 0; i < m; ++i)
+      y[i] = static_cast<T>(0);
+
+    for (long j = 0; j < n; ++j)
+    {
+      T const * col = a + j * a_cs;
+      T x_j = x[j];
+      for (long i = 0; i < m; ++i)
+        y[i] += col[i] * x_j;
+    }
+  }
+  else  // take the dot product of each row with x
+  {
+    for (long i = 0; i < m; ++i)
+    {
+      T const * row = a + i * a_rs;
+      T sum = static_cast<T>(0);
+      for (long j = 0; j < n; ++j)
+        sum += row[j * a_cs] * x[j];
+
+      y[i] = sum;
+    }
+  }
+}
+
+// Optimized versions, defined in MatrixMultiply.cpp
+template <> THEA_API void gemm<float>(long m, long n, long k, float const * a, long a_rs, long a_cs, float const * b,
+                                      long b_rs, long b_cs, float * c, long c_rs, long c_cs);
+template <> THEA_API void gemm<double>(long m, long n, long k, double const * a, long a_rs, long a_cs, double const * b,
+                                       long b_rs, long b_cs, double * c, long c_rs, long c_cs);
+template <> THEA_API void gemv<float>(long m, long n, float const * a, long a_rs, long a_cs, float const * x, float * y);
+template <> THEA_API void gemv<double>(long m, long n, double const * a, long a_rs, long a_cs, double const * x, double * y);
+
+} // namespace Internal
+} // namespace Thea
+
+#endif
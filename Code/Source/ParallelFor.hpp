@@ -0,0 +1,188 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_ParallelFor_hpp__
+#define __Thea_ParallelFor_hpp__
+
+#include "Common.hpp"
+#include "AtomicInt32.hpp"
+#include "System.hpp"
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace Thea {
+
+namespace ParallelForInternal {
+
+// Runs a task on consecutive ranges of indices, pulled from a shared counter until the indices run out. The counter holds the
+// index of the next range, not of the next task, so that it stays well within 32 bits for any sensible chunk size.
+template <typename TaskT>
+class ChunkRunner
+{
+  public:
+    ChunkRunner(TaskT const & task_, long num_tasks_, long chunk_size_, AtomicInt32 * next_chunk_)
+    : task(task_), num_tasks(num_tasks_), chunk_size(chunk_size_), num_chunks((num_tasks_ + chunk_size_ - 1) / chunk_size_),
+      next_chunk(next_chunk_) {}
+
+    void operator()()
+    {
+      while (true)
+      {
+        long chunk = (long)next_chunk->add(1);
+        if (chunk >= num_chunks)
+          break;
+
+        long chunk_begin = chunk * chunk_size;
+        task(chunk_begin, std::min(chunk_begin + chunk_size, num_tasks));
+      }
+    }
+
+  private:
+    TaskT task;
+    long num_tasks;
+    long chunk_size;
+    long num_chunks;
+    AtomicInt32 * next_chunk;
+
+}; // class ChunkRunner
+
+// Adapts a task on a single index to a task on a range of indices.
+template <typename TaskT>
+class IndexRangeTask
+{
+  public:
+    IndexRangeTask(TaskT const & task_) : task(task_) {}
+
+    void operator()(long begin, long end)
+    {
+      for (long i = begin; i < end; ++i)
+        task(i);
+    }
+
+  private:
+    TaskT task;
+
+}; // class IndexRangeTask
+
+} // namespace ParallelForInternal
+
+/**
+ * Get the number of threads worth using for a computation with a given total amount of work (in any units), if each thread
+ * should be given at least \a min_work_per_thread units. The result is between 1 and \a max_threads, or System::concurrency()
+ * if \a max_threads is not positive.
+ */
+inline long
+numThreadsForWork(double work, double min_work_per_thread, long max_threads = -1)
+{
+  long concurrency = (max_threads > 0 ? max_threads : System::concurrency());
+  double max_by_work = (min_work_per_thread > 0 ? work / min_work_per_thread : work);
+
+  return max_by_work < concurrency ? std::max((long)max_by_work, 1L) : concurrency;
+}
+
+/**
+ * Call <code>task(begin, end)</code> on consecutive ranges of indices that together cover [0, \a num_tasks), in parallel.
+ * Each thread pulls the next range from a shared counter when it finishes the last one, so threads that get cheap ranges take
+ * over the work that would otherwise wait for slower threads. The calling thread is one of the worker threads, and if only one
+ * thread is needed, the task is simply run in the calling thread.
+ *
+ * The task is copied once for each thread, so it may hold scratch space for the thread. Results must be written to storage
+ * shared via pointers (or references), and different ranges must not write to the same locations.
+ *
+ * @param num_tasks The number of indices.
+ * @param task The task, a copyable functor with the signature <code>void operator()(long begin, long end)</code>.
+ * @param chunk_size The number of indices in each range handed to a thread. If not positive, the indices are split into about 8
+ *   ranges per thread.
+ * @param num_threads The maximum number of threads to use. If not positive, System::concurrency() is used. No more threads are
+ *   used than there are ranges. Use numThreadsForWork() to avoid starting threads for small amounts of work.
+ */
+template <typename TaskT>
+void
+parallelForChunks(long num_tasks, TaskT const & task, long chunk_size = -1, long num_threads = -1)
+{
+  if (num_tasks <= 0)
+    return;
+
+  if (num_threads <= 0)
+    num_threads = System::concurrency();
+
+  if (chunk_size <= 0)
+    chunk_size = std::max(num_tasks / (8 * num_threads), 1L);
+
+  long num_chunks = (num_tasks + chunk_size - 1) / chunk_size;
+  num_threads = std::min(num_threads, num_chunks);
+
+  // Each thread overshoots the shared chunk counter by one when the chunks run out
+  alwaysAssertM((double)num_chunks + (double)num_threads <= (double)std::numeric_limits<int32>::max(),
+                "parallelForChunks: Too many chunks, use a larger chunk size");
+
+  AtomicInt32 next_chunk(0);
+  ParallelForInternal::ChunkRunner<TaskT> runner(task, num_tasks, chunk_size, &next_chunk);
+  if (num_threads <= 1)
+  {
+    runner();
+    return;
+  }
+
+  boost::thread_group pool;
+  for (long i = 1; i < num_threads; ++i)
+    pool.add_thread(new boost::thread(runner));
+
+  runner();
+  pool.join_all();
+}
+
+/**
+ * Call <code>task(i)</code> for each index \a i in [0, \a num_tasks), in parallel. The indices are handed to threads in ranges,
+ * exactly as in parallelForChunks(), which describes the parameters. The task must be a copyable functor with the signature
+ * <code>void operator()(long i)</code>.
+ */
+template <typename TaskT>
+void
+parallelFor(long num_tasks, TaskT const & task, long chunk_size = -1, long num_threads = -1)
+{
+  parallelForChunks(num_tasks, ParallelForInternal::IndexRangeTask<TaskT>(task), chunk_size, num_threads);
+}
+
+} // namespace Thea
+
+#endif
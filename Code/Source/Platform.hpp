@@ -124,6 +124,13 @@
 #  define __cdecl
 #endif
 
+/** Declare a variable with static storage duration to be thread-local, i.e. each thread has its own copy. */
+#ifdef _MSC_VER
+#  define THEA_THREAD_LOCAL __declspec(thread)
+#else
+#  define THEA_THREAD_LOCAL __thread
+#endif
+
 /** Use tight alignment for a class. Useful for small classes that must be packed into an array. */
 #ifdef _MSC_VER
 #  define THEA_BEGIN_PACKED_CLASS(byte_align)  PRAGMA( pack(push, byte_align) )
@@ -42,6 +42,8 @@
 #include "CSPARSELinearSolver.hpp"
 #include "../../Algorithms/FastCopy.hpp"
 #include "../../Array.hpp"
+#include "../../ParallelFor.hpp"
+#include "../../System.hpp"
 #include "csparse.h"
 #include <cmath>
 
@@ -49,9 +51,14 @@ namespace Thea {
 namespace Algorithms {
 
 CSPARSELinearSolver::CSPARSELinearSolver(std::string const & name_)
-: NamedObject(name_)
+: NamedObject(name_), factor_method(LU), factor_rows(0), factor_cols(0), symbolic(NULL), numeric(NULL), max_threads(1)
 {}
 
+CSPARSELinearSolver::~CSPARSELinearSolver()
+{
+  clearFactorization();
+}
+
 namespace CSPARSELinearSolverInternal {
 
 // Return value: 1: symmetric, 2: upper-triangular, 3: lower-triangular, 0: other
@@ -140,6 +147,56 @@ makeSymmetric(cs * A)
   return C;
 }
 
+// A CSPARSE view of a compressed column matrix, symmetrized if it is triangular and this is requested.
+class CSMatrix : private Noncopyable
+{
+  public:
+    CSMatrix(MatrixWrapper<double>::SparseColumnMatrix const & scm, bool symmetrize_triangular)
+    {
+      // (The row indices are ints by default, but just in case the parent class changes the default format let's cache them
+      // in an explicit int array.)
+      pcol.assign(scm.getColumnIndices().begin(), scm.getColumnIndices().end());
+      irow.assign(scm.getRowIndices().begin(), scm.getRowIndices().end());
+      A.nzmax = (int)scm.numSetElements();
+      A.m = scm.numRows();
+      A.n = scm.numColumns();
+      A.p = &pcol[0];
+      A.i = &irow[0];
+      A.x = const_cast<double *>(&scm.getValues()[0]);  // assume the values are always double-precision
+      A.nz = -1;
+
+      // Check if the matrix is symmetric, and if necessary symmetrize it if is triangular
+      Ap = &A;
+      sym = CSPARSELinearSolverInternal::isSymmetric(&A);
+      if (sym == 2 || sym == 3)
+      {
+        if (symmetrize_triangular)
+          Ap = makeSymmetric(&A);
+        else
+          sym = 0;
+      }
+    }
+
+    ~CSMatrix()
+    {
+      if (Ap != &A)
+        cs_spfree(Ap);
+    }
+
+    // Get the (possibly symmetrized) matrix.
+    cs * get() const { return Ap; }
+
+    // Check if the matrix is (possibly after symmetrization) symmetric.
+    bool isSymmetric() const { return sym != 0; }
+
+  private:
+    TheaArray<int> pcol, irow;
+    cs A;
+    cs * Ap;
+    int sym;
+
+}; // class CSMatrix
+
 } // namespace CSPARSELinearSolverInternal
 
 bool
@@ -179,29 +236,7 @@ CSPARSELinearSolver::solve(Options const & options)
                     std::string(getName()) + ": Coefficient matrix for method '" + method + "' must be square");
 
       // Create the coefficient matrix
-      // (The row indices are ints by default, but just in case the parent class changes the default format let's cache them in
-      // an explicit int array.)
-      TheaArray<int> pcol(scm.getColumnIndices().begin(), scm.getColumnIndices().end());
-      TheaArray<int> irow(scm.getRowIndices().begin(), scm.getRowIndices().end());
-      cs A;
-      A.nzmax = (int)scm.numSetElements();
-      A.m = scm.numRows();
-      A.n = scm.numColumns();
-      A.p = &pcol[0];
-      A.i = &irow[0];
-      A.x = const_cast<double *>(&scm.getValues()[0]);  // assume the values are always double-precision
-      A.nz = -1;
-
-      // Check if the matrix is symmetric, and if necessary symmetrize it if is triangular
-      cs * Ap = &A;
-      int sym = isSymmetric(&A);
-      if (sym == 2 || sym == 3)
-      {
-        if (options.get<bool>("symmetrize-triangular", false))
-          Ap = makeSymmetric(&A);
-        else
-          sym = 0;
-      }
+      CSMatrix A(scm, options.get<bool>("symmetrize-triangular", false));
 
       // Initialize the solutions vector with the constants vector. This will be overwritten by the solver.
       solution.resize(std::max(constants.size(), (array_size_t)scm.numColumns()));
@@ -210,51 +245,148 @@ CSPARSELinearSolver::solve(Options const & options)
         std::fill(solution.begin() + constants.size(), solution.end(), 0);
 
       int ok = 0;
-      try
+      if (method == "CHOLESKY")
+      {
+        THEA_DEBUG << getName() << ": Trying to solve linear system by Cholesky factorization";
+
+        if (!A.isSymmetric())
+          throw Error(std::string(getName())
+                    + ": Cholesky factorization requires a symmetric positive-definite coefficient matrix");
+
+        ok = cs_cholsol(A.get(), &solution[0], 1);
+
+        if (!ok)
+          THEA_DEBUG << getName() << ": Solution by Cholesky factorization failed:"
+                                   " please check that the coefficient matrix is symmetric positive-definite";
+      }
+      else if (method == "QR")
+      {
+        THEA_DEBUG << getName() << ": Trying to solve linear system by QR factorization";
+
+        ok = cs_qrsol(A.get(), &solution[0], 3);
+      }
+      else if (method == "LU")
+      {
+        THEA_DEBUG << getName() << ": Trying to solve linear system by LU factorization";
+
+        double tol = options.get<double>("tol", 1e-10);
+        ok = cs_lusol(A.get(), &solution[0], 1, tol);
+      }
+      else
+        throw Error(std::string(getName()) + ": Unknown solution method '" + method + '\'');
+
+      has_solution = (ok != 0);
+      break;
+    }
+
+    default:
+      throw Error(std::string(getName()) + ": Unknown format of cached matrix");
+  }
+
+  return has_solution;
+}
+
+bool
+CSPARSELinearSolver::factorize(Options const & options)
+{
+  using namespace CSPARSELinearSolverInternal;
+
+  clearFactorization();
+  factor_options = options;
+
+  switch (coeffs.getFormat())
+  {
+    case MatrixFormat::DENSE_ROW_MAJOR:
+    case MatrixFormat::DENSE_COLUMN_MAJOR:
+      throw Error(std::string(getName()) + ": The CSPARSE linear solver does not support dense coefficient matrices");
+
+    case MatrixFormat::SPARSE_ROW_MAJOR:  // should never be encountered since we always cache as sparse column-major
+      throw Error(std::string(getName()) + ": The CSPARSE linear solver does not support sparse row-major matrices");
+
+    case MatrixFormat::SPARSE_COLUMN_MAJOR:
+    {
+      MatrixWrapper<double>::SparseColumnMatrix const & scm = coeffs.getSparseColumnMatrix();
+      factor_rows = scm.numRows();
+      factor_cols = scm.numColumns();
+
+      max_threads = std::max(options.get<long>("max-threads", System::concurrency()), 1L);
+
+      std::string method = toUpper(options.get<std::string>("method", "LU"));
+      if (method == "CHOLESKY")
+        factor_method = CHOLESKY;
+      else if (method == "QR")
+        factor_method = QR;
+      else if (method == "LU")
+        factor_method = LU;
+      else
+        throw Error(std::string(getName()) + ": Unknown solution method '" + method + '\'');
+
+      if (scm.isEmpty())
       {
-        if (method == "CHOLESKY")
+        THEA_WARNING << getName() << ": Factoring empty system";
+        factored = true;
+        return factored;
+      }
+
+      // Only QR factorization allows rectangular matrices, returning least-squares solutions
+      alwaysAssertM(factor_method == QR || MatrixUtil::isSquare(scm),
+                    std::string(getName()) + ": Coefficient matrix for method '" + method + "' must be square");
+
+      CSMatrix A(scm, options.get<bool>("symmetrize-triangular", false));
+
+      switch (factor_method)
+      {
+        case CHOLESKY:
         {
-          THEA_DEBUG << getName() << ": Trying to solve linear system by Cholesky factorization";
+          THEA_DEBUG << getName() << ": Computing Cholesky factorization";
 
-          if (!sym)
+          if (!A.isSymmetric())
             throw Error(std::string(getName())
                       + ": Cholesky factorization requires a symmetric positive-definite coefficient matrix");
 
-          ok = cs_cholsol(Ap, &solution[0], 1);
-
-          THEA_DEBUG << getName() << ": Solution by Cholesky factorization failed:"
-                                     " please check that the coefficient matrix is symmetric positive-definite";
+          symbolic = cs_schol(A.get(), 1);
+          numeric = symbolic ? cs_chol(A.get(), symbolic) : NULL;
+          break;
         }
-        else if (method == "QR")
-        {
-          THEA_DEBUG << getName() << ": Trying to solve linear system by QR factorization";
 
-          ok = cs_qrsol(Ap, &solution[0], 3);
+        case QR:
+        {
+          THEA_DEBUG << getName() << ": Computing QR factorization";
+
+          if (factor_rows >= factor_cols)
+          {
+            symbolic = cs_sqr(A.get(), 3, 1);
+            numeric = symbolic ? cs_qr(A.get(), symbolic) : NULL;
+          }
+          else  // underdetermined system, factor the transpose
+          {
+            cs * At = cs_transpose(A.get(), 1);
+            symbolic = At ? cs_sqr(At, 3, 1) : NULL;
+            numeric = symbolic ? cs_qr(At, symbolic) : NULL;
+            cs_spfree(At);
+          }
+
+          break;
         }
-        else if (method == "LU")
+
+        default:
         {
-          THEA_DEBUG << getName() << ": Trying to solve linear system by LU factorization";
+          THEA_DEBUG << getName() << ": Computing LU factorization";
 
           double tol = options.get<double>("tol", 1e-10);
-          ok = cs_lusol(Ap, &solution[0], 1, tol);
+          symbolic = cs_sqr(A.get(), 1, 0);
+          numeric = symbolic ? cs_lu(A.get(), symbolic, tol) : NULL;
         }
-        else
-          throw Error(std::string(getName()) + ": Unknown solution method '" + method + '\'');
       }
-      catch (...)
-      {
-        // Cleanup
-        if (Ap != &A)
-          cs_spfree(Ap);
 
-        throw;
+      if (symbolic && numeric)
+        factored = true;
+      else
+      {
+        THEA_DEBUG << getName() << ": Factorization of coefficient matrix by method '" << method << "' failed";
+        clearFactorization();
       }
 
-      // Cleanup
-      if (Ap != &A)
-        cs_spfree(Ap);
-
-      has_solution = (ok != 0);
       break;
     }
 
@@ -262,7 +394,139 @@ CSPARSELinearSolver::solve(Options const & options)
       throw Error(std::string(getName()) + ": Unknown format of cached matrix");
   }
 
-  return has_solution;
+  return factored;
+}
+
+void
+CSPARSELinearSolver::clearFactorization()
+{
+  BaseType::clearFactorization();
+
+  cs_sfree(symbolic); symbolic = NULL;
+  cs_nfree(numeric); numeric = NULL;
+}
+
+bool
+CSPARSELinearSolver::solveFactoredRange(long begin, long end, double const * rhs, double * solutions) const
+{
+  int m = (int)factor_rows, n = (int)factor_cols;
+  double const * b = rhs + begin * factor_rows;
+  double * x = solutions + begin * factor_cols;
+
+  if (!symbolic)  // empty system
+  {
+    std::fill(x, x + (end - begin) * factor_cols, 0.0);
+    return true;
+  }
+
+  // Workspace. QR uses extra fictitious rows, which must be zero-initialized for each solve.
+  TheaArray<double> w((array_size_t)(factor_method == QR ? symbolic->m2 : n));
+
+  bool ok = true;
+  for (long j = begin; j < end; ++j, b += m, x += n)
+  {
+    switch (factor_method)
+    {
+      case CHOLESKY:
+      {
+        ok = ok && cs_ipvec(n, symbolic->Pinv, b, &w[0]);  // w = P * b
+        ok = ok && cs_lsolve(numeric->L, &w[0]);           // w = L \ w
+        ok = ok && cs_ltsolve(numeric->L, &w[0]);          // w = L' \ w
+        ok = ok && cs_pvec(n, symbolic->Pinv, &w[0], x);   // x = P' * w
+        break;
+      }
+
+      case QR:
+      {
+        std::fill(w.begin(), w.end(), 0.0);
+
+        if (m >= n)
+        {
+          ok = ok && cs_ipvec(m, symbolic->Pinv, b, &w[0]);  // w(0:m-1) = P * b
+          for (int k = 0; ok && k < n; ++k)                  // apply Householder reflections to w
+            ok = cs_happly(numeric->L, k, numeric->B[k], &w[0]);
+
+          ok = ok && cs_usolve(numeric->U, &w[0]);           // w = R \ w
+          ok = ok && cs_ipvec(n, symbolic->Q, &w[0], x);     // x = Q * w
+        }
+        else
+        {
+          ok = ok && cs_pvec(m, symbolic->Q, b, &w[0]);      // w(0:m-1) = Q' * b
+          ok = ok && cs_utsolve(numeric->U, &w[0]);          // w = R' \ w
+          for (int k = m - 1; ok && k >= 0; --k)             // apply Householder reflections to w
+            ok = cs_happly(numeric->L, k, numeric->B[k], &w[0]);
+
+          ok = ok && cs_pvec(n, symbolic->Pinv, &w[0], x);   // x = P' * w
+        }
+
+        break;
+      }
+
+      default:
+      {
+        ok = ok && cs_ipvec(n, numeric->Pinv, b, &w[0]);   // w = P * b
+        ok = ok && cs_lsolve(numeric->L, &w[0]);           // w = L \ w
+        ok = ok && cs_usolve(numeric->U, &w[0]);           // w = U \ w
+        ok = ok && cs_ipvec(n, symbolic->Q, &w[0], x);     // x = Q * w
+      }
+    }
+  }
+
+  return ok;
+}
+
+// Solves ranges of constant vectors, recording the success of each range.
+struct CSPARSELinearSolver::SolveTask
+{
+  SolveTask(CSPARSELinearSolver const * solver_, long rhs_per_range_, double const * rhs_, double * solutions_, int * ok_)
+  : solver(solver_), rhs_per_range(rhs_per_range_), rhs(rhs_), solutions(solutions_), ok(ok_)
+  {}
+
+  void operator()(long begin, long end)
+  {
+    ok[begin / rhs_per_range] = solver->solveFactoredRange(begin, end, rhs, solutions);
+  }
+
+  CSPARSELinearSolver const * solver;
+  long rhs_per_range;
+  double const * rhs;
+  double * solutions;
+  int * ok;
+
+}; // struct CSPARSELinearSolver::SolveTask
+
+bool
+CSPARSELinearSolver::solveFactored(long num_rhs, double const * rhs, double * solutions)
+{
+  alwaysAssertM(factored, std::string(getName()) + ": Coefficient matrix has not been factored");
+  alwaysAssertM(num_rhs <= 0 || (rhs && solutions), std::string(getName()) + ": Constant and solution vectors must be non-null");
+
+  if (num_rhs <= 0)
+    return true;
+
+  // Don't spawn threads unless each one has a reasonable amount of work (in terms of nonzeros in the factors) to do
+  static long const MIN_WORK_PER_THREAD = 1000000;
+  long factor_size = symbolic ? (long)symbolic->lnz + (long)symbolic->unz + factor_rows + factor_cols : 0;
+  long num_threads = (factor_size > 0
+                    ? numThreadsForWork((double)num_rhs * factor_size, MIN_WORK_PER_THREAD, std::min(max_threads, num_rhs))
+                    : 1);
+
+  if (num_threads <= 1)
+    return solveFactoredRange(0, num_rhs, rhs, solutions);
+
+  THEA_DEBUG << getName() << ": Solving " << num_rhs << " systems in " << num_threads << " threads";
+
+  // One range of constant vectors per thread
+  long rhs_per_range = (num_rhs + num_threads - 1) / num_threads;
+  long num_ranges = (num_rhs + rhs_per_range - 1) / rhs_per_range;
+  TheaArray<int> ok((array_size_t)num_ranges, 0);  // not bool, since std::vector<bool> does not have addressable elements
+  parallelForChunks(num_rhs, SolveTask(this, rhs_per_range, rhs, solutions, &ok[0]), rhs_per_range, num_threads);
+
+  bool all_ok = true;
+  for (long i = 0; i < num_ranges; ++i)
+    all_ok = all_ok && ok[(array_size_t)i];
+
+  return all_ok;
 }
 
 MatrixFormat
@@ -46,6 +46,10 @@
 #include "../../Set.hpp"
 #include "../../Algorithms/LinearSolver.hpp"
 
+// Forward declarations of CSPARSE structures
+struct cs_symbolic;
+struct cs_numeric;
+
 namespace Thea {
 namespace Algorithms {
 
@@ -63,6 +67,9 @@ class THEA_CSPARSE_DLL_LOCAL CSPARSELinearSolver : public LinearSolver
     /** Constructor. */
     CSPARSELinearSolver(std::string const & name_);
 
+    /** Destructor. */
+    ~CSPARSELinearSolver();
+
     /**
      * {@inheritDoc}
      *
@@ -83,8 +90,45 @@ class THEA_CSPARSE_DLL_LOCAL CSPARSELinearSolver : public LinearSolver
      */
     bool solve(Options const & options = Options());
 
+    /**
+     * {@inheritDoc}
+     *
+     * The fill-reducing ordering and the symbolic and numeric factors of the coefficient matrix are computed once and retained
+     * until the coefficients are changed. The options are the same as for solve().
+     */
+    bool factorize(Options const & options = Options());
+
+    /**
+     * {@inheritDoc}
+     *
+     * Each solution requires only permutations and triangular solves with the stored factors. Large blocks of constant vectors
+     * are split across several threads, up to the value of the option <b>max-threads</b> passed to factorize() (type
+     * <code>long</code>, default: the number of hardware threads).
+     */
+    bool solveFactored(long num_rhs, double const * rhs, double * solutions);
+
   protected:
     MatrixFormat getPreferredFormat(MatrixFormat input_format);
+    void clearFactorization();
+
+  private:
+    /** Supported factorization methods. */
+    enum FactorMethod { LU, QR, CHOLESKY };
+
+    struct SolveTask;  // solves ranges of constant vectors in parallel
+
+    /**
+     * Solve the factored system for the constant vectors in the range [begin, end) of the block \a rhs, placing the results
+     * in the corresponding positions of \a solutions.
+     */
+    bool solveFactoredRange(long begin, long end, double const * rhs, double * solutions) const;
+
+    FactorMethod   factor_method;  ///< The method used to compute the current factorization.
+    long           factor_rows;    ///< The number of rows of the factored coefficient matrix.
+    long           factor_cols;    ///< The number of columns of the factored coefficient matrix.
+    cs_symbolic *  symbolic;       ///< Fill-reducing ordering and symbolic analysis of the coefficient matrix.
+    cs_numeric *   numeric;        ///< Numeric factors of the coefficient matrix.
+    long           max_threads;    ///< The maximum number of threads to use for solving a block of constant vectors.
 
 }; // class CSPARSELinearSolver
 
@@ -0,0 +1,803 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "KrylovLinearSolver.hpp"
+#include "../../Array.hpp"
+#include "../../ParallelFor.hpp"
+#include "../../System.hpp"
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace Thea {
+namespace Algorithms {
+
+namespace KrylovLinearSolverInternal {
+
+typedef MatrixWrapper<double>::SparseRowMatrix SparseRowMatrix;
+
+// Dot product of two vectors.
+double
+dot(long n, double const * a, double const * b)
+{
+  double sum = 0;
+  for (long i = 0; i < n; ++i)
+    sum += a[i] * b[i];
+
+  return sum;
+}
+
+// Euclidean norm of a vector.
+double
+norm(long n, double const * a)
+{
+  return std::sqrt(dot(n, a, a));
+}
+
+// Computes y = A * x for a compressed row matrix A, splitting the rows across threads if the matrix is large enough.
+class SparseMatrixVectorProduct
+{
+  public:
+    SparseMatrixVectorProduct(SparseRowMatrix const & a_, long max_threads)
+    : a(a_)
+    {
+      // Split the rows into contiguous blocks with roughly the same number of non-zeros, one block per thread. Spawning threads
+      // has a fixed cost, so small matrices are not split.
+      static long const MIN_NONZEROS_PER_THREAD = 250000;
+
+      long n = a.numRows();
+      long nnz = a.numSetElements();
+      long num_threads = numThreadsForWork(nnz, MIN_NONZEROS_PER_THREAD, std::max(max_threads, 1L));
+
+      TheaArray<SparseRowMatrix::Index1D> const & row_starts = a.getRowIndices();
+      row_blocks.push_back(0);
+      for (long t = 1; t < num_threads; ++t)
+      {
+        long target = (nnz * t) / num_threads;
+        long row = (long)(std::lower_bound(row_starts.begin(), row_starts.end() - 1, (SparseRowMatrix::Index1D)target)
+                        - row_starts.begin());
+        if (row > row_blocks.back() && row < n)
+          row_blocks.push_back(row);
+      }
+
+      row_blocks.push_back(n);
+    }
+
+    // Get the number of threads used.
+    long numThreads() const { return (long)row_blocks.size() - 1; }
+
+    // Compute y = A * x.
+    void operator()(double const * x, double * y) const
+    {
+      if (numThreads() <= 1)
+      {
+        multiplyRows(0, a.numRows(), x, y);
+        return;
+      }
+
+      parallelFor(numThreads(), RowBlockTask(this, x, y), 1, numThreads());
+    }
+
+  private:
+    // Multiplies a block of rows of the matrix with a vector.
+    struct RowBlockTask
+    {
+      RowBlockTask(SparseMatrixVectorProduct const * product_, double const * x_, double * y_)
+      : product(product_), x(x_), y(y_)
+      {}
+
+      void operator()(long block)
+      {
+        array_size_t b = (array_size_t)block;
+        product->multiplyRows(product->row_blocks[b], product->row_blocks[b + 1], x, y);
+      }
+
+      SparseMatrixVectorProduct const * product;
+      double const * x;
+      double * y;
+
+    }; // struct RowBlockTask
+
+    // Compute rows [begin, end) of y = A * x.
+    void multiplyRows(long begin, long end, double const * x, double * y) const
+    {
+      TheaArray<SparseRowMatrix::Index1D> const & row_starts = a.getRowIndices();
+      TheaArray<SparseRowMatrix::Index2D> const & cols = a.getColumnIndices();
+      TheaArray<double> const & values = a.getValues();
+
+      for (long r = begin; r < end; ++r)
+      {
+        double sum = 0;
+        for (SparseRowMatrix::Index1D e = row_starts[(array_size_t)r]; e < row_starts[(array_size_t)r + 1]; ++e)
+          sum += values[(array_size_t)e] * x[cols[(array_size_t)e]];
+
+        y[r] = sum;
+      }
+    }
+
+    SparseRowMatrix const & a;
+    TheaArray<long> row_blocks;
+
+}; // class SparseMatrixVectorProduct
+
+// Interface for a preconditioner M, which approximates the inverse of the coefficient matrix.
+class Preconditioner
+{
+  public:
+    virtual ~Preconditioner() {}
+
+    // Compute z = M * r. The two vectors will be different.
+    virtual void apply(long n, double const * r, double * z) const = 0;
+
+}; // class Preconditioner
+
+// The trivial preconditioner, M = I.
+class IdentityPreconditioner : public Preconditioner
+{
+  public:
+    void apply(long n, double const * r, double * z) const
+    {
+      std::copy(r, r + n, z);
+    }
+
+}; // class IdentityPreconditioner
+
+// Jacobi (diagonal) preconditioner, M = diag(A)^-1. Zero diagonal entries are replaced with 1.
+class JacobiPreconditioner : public Preconditioner
+{
+  public:
+    JacobiPreconditioner(SparseRowMatrix const & a)
+    : inv_diag((array_size_t)a.numRows(), 1.0)
+    {
+      TheaArray<SparseRowMatrix::Index1D> const & row_starts = a.getRowIndices();
+      TheaArray<SparseRowMatrix::Index2D> const & cols = a.getColumnIndices();
+      TheaArray<double> const & values = a.getValues();
+
+      for (long r = 0; r < a.numRows(); ++r)
+      {
+        double d = 0;
+        for (SparseRowMatrix::Index1D e = row_starts[(array_size_t)r]; e < row_starts[(array_size_t)r + 1]; ++e)
+          if ((long)cols[(array_size_t)e] == r)
+            d += values[(array_size_t)e];
+
+        if (d != 0)
+          inv_diag[(array_size_t)r] = 1.0 / d;
+      }
+    }
+
+    void apply(long n, double const * r, double * z) const
+    {
+      for (long i = 0; i < n; ++i)
+        z[i] = inv_diag[(array_size_t)i] * r[i];
+    }
+
+  private:
+    TheaArray<double> inv_diag;
+
+}; // class JacobiPreconditioner
+
+// Incomplete Cholesky preconditioner with no fill-in, IC(0). The lower triangle of A is approximately factored as L * L^T,
+// where L has the same sparsity pattern as the lower triangle of A, and M = (L * L^T)^-1.
+class ICPreconditioner : public Preconditioner
+{
+  public:
+    // Try to factor the matrix, shifting the diagonal if the factorization breaks down. Returns null if it fails altogether.
+    static ICPreconditioner * create(SparseRowMatrix const & a)
+    {
+      static int const MAX_ATTEMPTS = 10;
+
+      ICPreconditioner * ic = new ICPreconditioner(a);
+      double shift = 0;
+      for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt)
+      {
+        if (ic->factor(shift))
+        {
+          if (shift > 0)
+            THEA_DEBUG << "KrylovLinearSolver: Incomplete Cholesky factorization needed a diagonal shift of " << shift;
+
+          return ic;
+        }
+
+        shift = (shift <= 0 ? 1.0e-3 : 10 * shift);
+      }
+
+      delete ic;
+      return NULL;
+    }
+
+    void apply(long n, double const * r, double * z) const
+    {
+      // Solve L * y = r (forward substitution), placing y in z
+      for (long i = 0; i < n; ++i)
+      {
+        double sum = r[i];
+        Index end = row_starts[(array_size_t)i + 1] - 1;  // the last entry of each row is the diagonal
+        for (Index e = row_starts[(array_size_t)i]; e < end; ++e)
+          sum -= values[(array_size_t)e] * z[cols[(array_size_t)e]];
+
+        z[i] = sum / values[(array_size_t)end];
+      }
+
+      // Solve L^T * z = y (back substitution), in place
+      for (long i = n - 1; i >= 0; --i)
+      {
+        Index end = row_starts[(array_size_t)i + 1] - 1;
+        z[i] /= values[(array_size_t)end];
+
+        for (Index e = row_starts[(array_size_t)i]; e < end; ++e)
+          z[cols[(array_size_t)e]] -= values[(array_size_t)e] * z[i];
+      }
+    }
+
+  private:
+    typedef long Index;
+
+    // Copy the sorted lower triangle of the matrix, with every row ending in a (possibly zero) diagonal entry.
+    ICPreconditioner(SparseRowMatrix const & a)
+    {
+      TheaArray<SparseRowMatrix::Index1D> const & a_row_starts = a.getRowIndices();
+      TheaArray<SparseRowMatrix::Index2D> const & a_cols = a.getColumnIndices();
+      TheaArray<double> const & a_values = a.getValues();
+
+      long n = a.numRows();
+      row_starts.resize((array_size_t)n + 1);
+      row_starts[0] = 0;
+
+      TheaArray< std::pair<long, double> > row;
+      for (long r = 0; r < n; ++r)
+      {
+        row.clear();
+        double diag = 0;
+        for (SparseRowMatrix::Index1D e = a_row_starts[(array_size_t)r]; e < a_row_starts[(array_size_t)r + 1]; ++e)
+        {
+          long c = (long)a_cols[(array_size_t)e];
+          if (c < r)
+            row.push_back(std::make_pair(c, a_values[(array_size_t)e]));
+          else if (c == r)
+            diag += a_values[(array_size_t)e];
+        }
+
+        std::sort(row.begin(), row.end());
+        for (array_size_t k = 0; k < row.size(); ++k)
+        {
+          if (k > 0 && row[k].first == row[k - 1].first)  // merge duplicates
+            lower_values.back() += row[k].second;
+          else
+          {
+            cols.push_back(row[k].first);
+            lower_values.push_back(row[k].second);
+          }
+        }
+
+        cols.push_back(r);
+        lower_values.push_back(diag);
+        row_starts[(array_size_t)r + 1] = (Index)cols.size();
+      }
+    }
+
+    // Compute the factor of the lower triangle, with the diagonal scaled by (1 + shift). Returns false on breakdown.
+    bool factor(double shift)
+    {
+      values = lower_values;
+      long n = (long)row_starts.size() - 1;
+      for (long i = 0; i < n; ++i)
+      {
+        Index i_begin = row_starts[(array_size_t)i], i_end = row_starts[(array_size_t)i + 1] - 1;  // i_end is the diagonal
+
+        // Off-diagonal entries, in increasing order of column: L_ik = (A_ik - sum_{j < k} L_ij * L_kj) / L_kk
+        for (Index e = i_begin; e < i_end; ++e)
+        {
+          long k = cols[(array_size_t)e];
+          Index k_begin = row_starts[(array_size_t)k], k_end = row_starts[(array_size_t)k + 1] - 1;
+
+          // Sparse dot product of the already computed parts of rows i and k (sorted merge)
+          double sum = values[(array_size_t)e];
+          for (Index p = i_begin, q = k_begin; p < e && q < k_end; )
+          {
+            if (cols[(array_size_t)p] < cols[(array_size_t)q])
+              ++p;
+            else if (cols[(array_size_t)p] > cols[(array_size_t)q])
+              ++q;
+            else
+              sum -= values[(array_size_t)p++] * values[(array_size_t)q++];
+          }
+
+          values[(array_size_t)e] = sum / values[(array_size_t)k_end];
+        }
+
+        // Diagonal entry: L_ii = sqrt(A_ii - sum_{j < i} L_ij^2)
+        double d = (1 + shift) * values[(array_size_t)i_end];
+        for (Index e = i_begin; e < i_end; ++e)
+          d -= values[(array_size_t)e] * values[(array_size_t)e];
+
+        if (!(d > 0))
+          return false;
+
+        values[(array_size_t)i_end] = std::sqrt(d);
+      }
+
+      return true;
+    }
+
+    TheaArray<Index> row_starts;
+    TheaArray<long> cols;
+    TheaArray<double> lower_values;  // lower triangle of the input matrix
+    TheaArray<double> values;        // computed factor
+
+}; // class ICPreconditioner
+
+// Preconditioned conjugate gradients, for symmetric positive-definite systems. Returns true on convergence.
+bool
+cg(SparseMatrixVectorProduct const & a, Preconditioner const & m, long n, double const * b, double * x, double tol,
+   long max_iters, long & iters)
+{
+  TheaArray<double> r((array_size_t)n), z((array_size_t)n), p((array_size_t)n), q((array_size_t)n);
+
+  double b_norm = norm(n, b);
+  a(x, &q[0]);
+  for (long i = 0; i < n; ++i) r[(array_size_t)i] = b[i] - q[(array_size_t)i];
+
+  iters = 0;
+  if (norm(n, &r[0]) <= tol * b_norm)
+    return true;
+
+  m.apply(n, &r[0], &z[0]);
+  p = z;
+  double rz = dot(n, &r[0], &z[0]);
+
+  while (iters < max_iters)
+  {
+    ++iters;
+
+    a(&p[0], &q[0]);
+    double pq = dot(n, &p[0], &q[0]);
+    if (!(pq > 0))
+    {
+      THEA_DEBUG << "KrylovLinearSolver: CG breakdown, the coefficient matrix is probably not positive-definite";
+      return false;
+    }
+
+    double alpha = rz / pq;
+    for (long i = 0; i < n; ++i)
+    {
+      x[i] += alpha * p[(array_size_t)i];
+      r[(array_size_t)i] -= alpha * q[(array_size_t)i];
+    }
+
+    if (norm(n, &r[0]) <= tol * b_norm)
+      return true;
+
+    m.apply(n, &r[0], &z[0]);
+    double rz_new = dot(n, &r[0], &z[0]);
+    double beta = rz_new / rz;
+    rz = rz_new;
+
+    for (long i = 0; i < n; ++i)
+      p[(array_size_t)i] = z[(array_size_t)i] + beta * p[(array_size_t)i];
+  }
+
+  return false;
+}
+
+// Preconditioned BiCGSTAB, for general square systems. Returns true on convergence.
+bool
+bicgstab(SparseMatrixVectorProduct const & a, Preconditioner const & m, long n, double const * b, double * x, double tol,
+         long max_iters, long & iters)
+{
+  TheaArray<double> r((array_size_t)n), r0((array_size_t)n), p((array_size_t)n, 0.0), v((array_size_t)n, 0.0);
+  TheaArray<double> p_hat((array_size_t)n), s((array_size_t)n), s_hat((array_size_t)n), t((array_size_t)n);
+
+  double b_norm = norm(n, b);
+  a(x, &t[0]);
+  for (long i = 0; i < n; ++i) r[(array_size_t)i] = b[i] - t[(array_size_t)i];
+
+  iters = 0;
+  if (norm(n, &r[0]) <= tol * b_norm)
+    return true;
+
+  r0 = r;
+  double rho = 1, alpha = 1, omega = 1;
+
+  while (iters < max_iters)
+  {
+    ++iters;
+
+    double rho_new = dot(n, &r0[0], &r[0]);
+    if (rho_new == 0 || omega == 0)
+    {
+      THEA_DEBUG << "KrylovLinearSolver: BiCGSTAB breakdown";
+      return false;
+    }
+
+    double beta = (rho_new / rho) * (alpha / omega);
+    rho = rho_new;
+    for (long i = 0; i < n; ++i)
+      p[(array_size_t)i] = r[(array_size_t)i] + beta * (p[(array_size_t)i] - omega * v[(array_size_t)i]);
+
+    m.apply(n, &p[0], &p_hat[0]);
+    a(&p_hat[0], &v[0]);
+
+    double r0v = dot(n, &r0[0], &v[0]);
+    if (r0v == 0)
+    {
+      THEA_DEBUG << "KrylovLinearSolver: BiCGSTAB breakdown";
+      return false;
+    }
+
+    alpha = rho / r0v;
+    for (long i = 0; i < n; ++i)
+      s[(array_size_t)i] = r[(array_size_t)i] - alpha * v[(array_size_t)i];
+
+    if (norm(n, &s[0]) <= tol * b_norm)
+    {
+      for (long i = 0; i < n; ++i)
+        x[i] += alpha * p_hat[(array_size_t)i];
+
+      return true;
+    }
+
+    m.apply(n, &s[0], &s_hat[0]);
+    a(&s_hat[0], &t[0]);
+
+    double tt = dot(n, &t[0], &t[0]);
+    omega = (tt > 0 ? dot(n, &t[0], &s[0]) / tt : 0);
+    for (long i = 0; i < n; ++i)
+    {
+      x[i] += alpha * p_hat[(array_size_t)i] + omega * s_hat[(array_size_t)i];
+      r[(array_size_t)i] = s[(array_size_t)i] - omega * t[(array_size_t)i];
+    }
+
+    if (norm(n, &r[0]) <= tol * b_norm)
+      return true;
+  }
+
+  return false;
+}
+
+// Preconditioned MINRES, for symmetric (possibly indefinite) systems, following the algorithm of C. C. Paige and
+// M. A. Saunders, "Solution of sparse indefinite systems of linear equations", SIAM J. Numer. Anal. 12(4), 1975. The
+// preconditioner must be symmetric positive-definite. Convergence is tested on the estimated residual norm in the norm induced
+// by the preconditioner. Returns true on convergence.
+bool
+minres(SparseMatrixVectorProduct const & a, Preconditioner const & m, long n, double const * b, double * x, double tol,
+       long max_iters, long & iters)
+{
+  TheaArray<double> r1((array_size_t)n), r2((array_size_t)n), y((array_size_t)n), v((array_size_t)n);
+  TheaArray<double> w((array_size_t)n, 0.0), w1((array_size_t)n, 0.0), w2((array_size_t)n, 0.0);
+
+  a(x, &y[0]);
+  for (long i = 0; i < n; ++i) r1[(array_size_t)i] = b[i] - y[(array_size_t)i];
+
+  m.apply(n, &r1[0], &y[0]);
+  double beta1 = dot(n, &r1[0], &y[0]);
+
+  iters = 0;
+  if (beta1 < 0)
+  {
+    THEA_DEBUG << "KrylovLinearSolver: MINRES requires a positive-definite preconditioner";
+    return false;
+  }
+
+  // Measure convergence relative to the norm of b in the preconditioned norm, so that the tolerance does not depend on the
+  // initial guess
+  TheaArray<double> mb((array_size_t)n);
+  m.apply(n, b, &mb[0]);
+  double b_norm = std::sqrt(std::max(dot(n, b, &mb[0]), 0.0));
+
+  beta1 = std::sqrt(beta1);
+  if (beta1 <= tol * b_norm)
+    return true;
+
+  r2 = r1;
+  double old_beta = 0, beta = beta1, dbar = 0, epsln = 0, phibar = beta1, cs = -1, sn = 0;
+
+  while (iters < max_iters)
+  {
+    ++iters;
+
+    // Lanczos step
+    double s = 1.0 / beta;
+    for (long i = 0; i < n; ++i) v[(array_size_t)i] = s * y[(array_size_t)i];
+
+    a(&v[0], &y[0]);
+    if (iters >= 2)
+    {
+      double f = beta / old_beta;
+      for (long i = 0; i < n; ++i) y[(array_size_t)i] -= f * r1[(array_size_t)i];
+    }
+
+    double alpha = dot(n, &v[0], &y[0]);
+    double f = alpha / beta;
+    for (long i = 0; i < n; ++i) y[(array_size_t)i] -= f * r2[(array_size_t)i];
+
+    r1.swap(r2);
+    r2 = y;
+    m.apply(n, &r2[0], &y[0]);
+    old_beta = beta;
+    beta = dot(n, &r2[0], &y[0]);
+    if (beta < 0)
+    {
+      THEA_DEBUG << "KrylovLinearSolver: MINRES requires a positive-definite preconditioner";
+      return false;
+    }
+
+    beta = std::sqrt(beta);
+
+    // Apply the previous rotation, and compute and apply the next one
+    double old_eps = epsln;
+    double delta = cs * dbar + sn * alpha;
+    double gbar = sn * dbar - cs * alpha;
+    epsln = sn * beta;
+    dbar = -cs * beta;
+
+    double gamma = std::max(std::sqrt(gbar * gbar + beta * beta), 1.0e-300);
+    cs = gbar / gamma;
+    sn = beta / gamma;
+    double phi = cs * phibar;
+    phibar = sn * phibar;
+
+    // Update the solution
+    double denom = 1.0 / gamma;
+    w1.swap(w2);
+    w2.swap(w);
+    for (long i = 0; i < n; ++i)
+    {
+      w[(array_size_t)i] = (v[(array_size_t)i] - old_eps * w1[(array_size_t)i] - delta * w2[(array_size_t)i]) * denom;
+      x[i] += phi * w[(array_size_t)i];
+    }
+
+    if (phibar <= tol * b_norm || beta <= 0)
+      return true;
+  }
+
+  return false;
+}
+
+} // namespace KrylovLinearSolverInternal
+
+KrylovLinearSolver::KrylovLinearSolver(std::string const & name_)
+: NamedObject(name_), preconditioner(NULL), num_iterations(0), relative_residual(0)
+{}
+
+KrylovLinearSolver::~KrylovLinearSolver()
+{
+  clearFactorization();
+}
+
+MatrixFormat
+KrylovLinearSolver::getPreferredFormat(MatrixFormat input_format)
+{
+  // Everything is converted to compressed row format, which is best for matrix-vector products
+  return MatrixFormat::SPARSE_ROW_MAJOR;
+}
+
+void
+KrylovLinearSolver::clearFactorization()
+{
+  BaseType::clearFactorization();
+
+  delete preconditioner;
+  preconditioner = NULL;
+}
+
+KrylovLinearSolverInternal::Preconditioner *
+KrylovLinearSolver::createPreconditioner(Options const & options) const
+{
+  using namespace KrylovLinearSolverInternal;
+
+  SparseRowMatrix const & a = coeffs.getSparseRowMatrix();
+  std::string type = toUpper(options.get<std::string>("preconditioner", "Jacobi"));
+
+  if (type == "NONE")
+    return new IdentityPreconditioner;
+  else if (type == "JACOBI")
+    return new JacobiPreconditioner(a);
+  else if (type == "IC")
+  {
+    Preconditioner * ic = ICPreconditioner::create(a);
+    if (ic)
+      return ic;
+
+    THEA_WARNING << getName() << ": Incomplete Cholesky factorization failed, falling back to Jacobi preconditioner";
+    return new JacobiPreconditioner(a);
+  }
+  else
+    throw Error(std::string(getName()) + ": Unknown preconditioner '" + type + '\'');
+}
+
+bool
+KrylovLinearSolver::solveSingle(double const * b, double * x, KrylovLinearSolverInternal::Preconditioner const & precond,
+                                Options const & options)
+{
+  using namespace KrylovLinearSolverInternal;
+
+  SparseRowMatrix const & a = coeffs.getSparseRowMatrix();
+  long n = a.numRows();
+
+  std::string method = toUpper(options.get<std::string>("method", "CG"));
+  double tol = options.get<double>("tol", 1e-8);
+  long max_iters = options.get<long>("max-iterations", 2 * n);
+  long max_threads = options.get<long>("max-threads", System::concurrency());
+
+  SparseMatrixVectorProduct product(a, max_threads);
+
+  bool converged = false;
+  if (method == "CG")
+    converged = cg(product, precond, n, b, x, tol, max_iters, num_iterations);
+  else if (method == "BICGSTAB")
+    converged = bicgstab(product, precond, n, b, x, tol, max_iters, num_iterations);
+  else if (method == "MINRES")
+    converged = minres(product, precond, n, b, x, tol, max_iters, num_iterations);
+  else
+    throw Error(std::string(getName()) + ": Unknown solution method '" + method + '\'');
+
+  // Report the true residual
+  TheaArray<double> ax((array_size_t)n);
+  product(x, &ax[0]);
+  double r_norm2 = 0;
+  for (long i = 0; i < n; ++i)
+    r_norm2 += (b[i] - ax[(array_size_t)i]) * (b[i] - ax[(array_size_t)i]);
+
+  double b_norm = norm(n, b);
+  relative_residual = (b_norm > 0 ? std::sqrt(r_norm2) / b_norm : std::sqrt(r_norm2));
+
+  THEA_DEBUG << getName() << ": " << method << (converged ? " converged" : " did not converge") << " after " << num_iterations
+             << " iteration(s) with " << product.numThreads() << " thread(s), relative residual = " << relative_residual;
+
+  return converged;
+}
+
+bool
+KrylovLinearSolver::solve(Options const & options)
+{
+  using namespace KrylovLinearSolverInternal;
+
+  has_solution = false;
+  num_iterations = 0;
+  relative_residual = 0;
+
+  if (coeffs.getFormat() != MatrixFormat::SPARSE_ROW_MAJOR)  // should never happen since we always cache as sparse row-major
+    throw Error(std::string(getName()) + ": Unknown format of cached matrix");
+
+  SparseRowMatrix const & a = coeffs.getSparseRowMatrix();
+  alwaysAssertM(MatrixUtil::isSquare(a), std::string(getName()) + ": Coefficient matrix must be square");
+  alwaysAssertM(a.numRows() == (long)constants.size(),
+                std::string(getName()) + ": Size of coefficient matrix does not match number of constants");
+
+  long n = a.numRows();
+  if (n <= 0)
+  {
+    THEA_WARNING << getName() << ": Attempting to solve empty system";
+    solution.clear();
+    has_solution = true;
+    return has_solution;
+  }
+
+  if (!options.get<bool>("warm-start", false) || (long)solution.size() != n)
+    solution.assign((array_size_t)n, 0.0);
+
+  boost::scoped_ptr<Preconditioner> local_precond(factored ? NULL : createPreconditioner(options));
+  Preconditioner const & precond = (factored ? *preconditioner : *local_precond);
+
+  has_solution = solveSingle(&constants[0], &solution[0], precond, options);
+  return has_solution;
+}
+
+bool
+KrylovLinearSolver::factorize(Options const & options)
+{
+  clearFactorization();
+  factor_options = options;
+
+  if (coeffs.getFormat() != MatrixFormat::SPARSE_ROW_MAJOR)  // should never happen since we always cache as sparse row-major
+    throw Error(std::string(getName()) + ": Unknown format of cached matrix");
+
+  alwaysAssertM(MatrixUtil::isSquare(coeffs.getSparseRowMatrix()),
+                std::string(getName()) + ": Coefficient matrix must be square");
+
+  preconditioner = createPreconditioner(options);
+  factored = true;
+
+  return factored;
+}
+
+bool
+KrylovLinearSolver::solveFactored(long num_rhs, double const * rhs, double * solutions)
+{
+  alwaysAssertM(factored, std::string(getName()) + ": Coefficient matrix has not been factored");
+  alwaysAssertM(num_rhs <= 0 || (rhs && solutions), std::string(getName()) + ": Constant and solution vectors must be non-null");
+
+  long n = coeffs.getSparseRowMatrix().numRows();
+  bool warm_start = factor_options.get<bool>("warm-start", false);
+
+  bool ok = true;
+  long max_iterations = 0;
+  double max_residual = 0;
+  for (long k = 0; k < num_rhs && n > 0; ++k)
+  {
+    double * x = solutions + k * n;
+    if (!warm_start)
+      std::fill(x, x + n, 0.0);
+
+    if (!solveSingle(rhs + k * n, x, *preconditioner, factor_options))
+      ok = false;
+
+    max_iterations = std::max(max_iterations, num_iterations);
+    max_residual = std::max(max_residual, relative_residual);
+  }
+
+  num_iterations = max_iterations;
+  relative_residual = max_residual;
+
+  return ok;
+}
+
+KrylovLinearSolverFactory::~KrylovLinearSolverFactory()
+{
+  destroyAllLinearSolvers();
+}
+
+LinearSolver *
+KrylovLinearSolverFactory::createLinearSolver(std::string const & name)
+{
+  KrylovLinearSolver * ls = new KrylovLinearSolver(name);
+  linear_solvers.insert(ls);
+  return ls;
+}
+
+void
+KrylovLinearSolverFactory::destroyLinearSolver(LinearSolver * linear_solver)
+{
+  linear_solvers.erase(linear_solver);
+  delete linear_solver;
+}
+
+void
+KrylovLinearSolverFactory::destroyAllLinearSolvers()
+{
+  for (LinearSolverSet::iterator li = linear_solvers.begin(); li != linear_solvers.end(); ++li)
+    delete *li;
+
+  linear_solvers.clear();
+}
+
+} // namespace Algorithms
+} // namespace Thea
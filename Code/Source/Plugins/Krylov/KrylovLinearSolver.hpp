@@ -0,0 +1,178 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_Algorithms_KrylovLinearSolver_hpp__
+#define __Thea_Algorithms_KrylovLinearSolver_hpp__
+
+#include "KrylovCommon.hpp"
+#include "../../Set.hpp"
+#include "../../Algorithms/LinearSolver.hpp"
+
+namespace Thea {
+namespace Algorithms {
+
+namespace KrylovLinearSolverInternal {
+
+class Preconditioner;
+
+} // namespace KrylovLinearSolverInternal
+
+/**
+ * Iterative solver for sparse systems of linear equations, using preconditioned Krylov subspace methods. Unlike a direct solver,
+ * it only needs to store the coefficient matrix (in compressed row format) and a few vectors, so it can handle systems that are
+ * too large to factor. The matrix-vector products, which dominate the cost of each iteration, are split across several
+ * threads for large matrices.
+ *
+ * If the system changes only slightly between successive solves (e.g. across frames of an animation), the previous solution can
+ * be used as the initial guess (see the <b>warm-start</b> option), which typically reduces the number of iterations required
+ * to a handful. The preconditioner can also be computed once by factorize() and reused for many solves.
+ */
+class THEA_KRYLOV_DLL_LOCAL KrylovLinearSolver : public LinearSolver
+{
+  private:
+    typedef LinearSolver BaseType;
+
+  public:
+    /** Constructor. */
+    KrylovLinearSolver(std::string const & name_);
+
+    /** Destructor. */
+    ~KrylovLinearSolver();
+
+    /**
+     * {@inheritDoc}
+     *
+     * Valid options for the Krylov backend are:
+     * - <b>method</b>: Solution method to use
+     *   - <i>Type:</i> <code>std::string</code> in {"CG", "BiCGSTAB", "MINRES"}
+     *   - <i>Default</i>: "CG"
+     *   - <i>Note</i>: Conjugate gradients (CG) requires a symmetric positive-definite coefficient matrix, and MINRES a
+     *     symmetric (possibly indefinite) one. BiCGSTAB handles general square matrices.
+     * - <b>preconditioner</b>: Preconditioner to use
+     *   - <i>Type:</i> <code>std::string</code> in {"None", "Jacobi", "IC"}
+     *   - <i>Default</i>: "Jacobi"
+     *   - <i>Note</i>: "IC" is incomplete Cholesky factorization with no fill-in, which requires a symmetric positive-definite
+     *     coefficient matrix (only its lower triangle is read). If the factorization breaks down, the diagonal is progressively
+     *     shifted until it succeeds. MINRES requires a positive-definite preconditioner.
+     * - <b>tol</b>: Convergence threshold for the residual norm ||<b>b</b> - A<b>x</b>||, relative to ||<b>b</b>||
+     *   - <i>Type:</i> <code>double</code>
+     *   - <i>Default</i>: 1e-8
+     * - <b>max-iterations</b>: Maximum number of iterations
+     *   - <i>Type:</i> <code>long</code>
+     *   - <i>Default</i>: Twice the size of the system
+     * - <b>warm-start</b>: If true, the solution of the previous call to solve() (or, for solveFactored(), the initial
+     *   contents of the solutions array) is used as the initial guess, instead of zero
+     *   - <i>Type:</i> <code>bool</code>
+     *   - <i>Default</i>: <code>false</code>
+     * - <b>max-threads</b>: Maximum number of threads for matrix-vector products
+     *   - <i>Type:</i> <code>long</code>
+     *   - <i>Default</i>: The number of hardware threads
+     *
+     * Returns false if the method did not converge within the maximum number of iterations (the solution vector still holds
+     * the last iterate).
+     */
+    bool solve(Options const & options = Options());
+
+    /**
+     * {@inheritDoc}
+     *
+     * Computes the preconditioner once and keeps it until the coefficients are changed. It is then reused by subsequent calls
+     * to solve(), which ignore their own <b>preconditioner</b> option, and by solveFactored(), which takes all other options
+     * from this function as well.
+     */
+    bool factorize(Options const & options = Options());
+
+    /** {@inheritDoc} */
+    bool solveFactored(long num_rhs, double const * rhs, double * solutions);
+
+    /** Get the number of iterations performed by the last solve (or, for solveFactored(), the maximum over all systems). */
+    long getNumIterations() const { return num_iterations; }
+
+    /**
+     * Get the residual norm ||<b>b</b> - A<b>x</b>||, relative to ||<b>b</b>||, after the last solve (or, for solveFactored(),
+     * the maximum over all systems).
+     */
+    double getRelativeResidual() const { return relative_residual; }
+
+  protected:
+    MatrixFormat getPreferredFormat(MatrixFormat input_format);
+    void clearFactorization();
+
+  private:
+    /**
+     * Solve the system for a single constant vector, starting from the initial guess in \a x, with the given preconditioner
+     * and options.
+     */
+    bool solveSingle(double const * b, double * x, KrylovLinearSolverInternal::Preconditioner const & precond,
+                     Options const & options);
+
+    /** Create a preconditioner for the current coefficient matrix, as specified by the options. */
+    KrylovLinearSolverInternal::Preconditioner * createPreconditioner(Options const & options) const;
+
+    KrylovLinearSolverInternal::Preconditioner * preconditioner;  ///< Preconditioner computed by factorize().
+    long num_iterations;  ///< Number of iterations performed by the last solve.
+    double relative_residual;  ///< Relative residual norm after the last solve.
+
+}; // class KrylovLinearSolver
+
+/** Factory for creating Krylov linear solvers. */
+class THEA_KRYLOV_DLL_LOCAL KrylovLinearSolverFactory : public LinearSolverFactory
+{
+  public:
+    /** Destructor. */
+    ~KrylovLinearSolverFactory();
+
+    LinearSolver * createLinearSolver(std::string const & name);
+    void destroyLinearSolver(LinearSolver * linear_solver);
+
+    /** Destroy all linear solvers created with this factory. */
+    void destroyAllLinearSolvers();
+
+  private:
+    typedef TheaSet<LinearSolver *> LinearSolverSet;  ///< Set of linear solvers.
+
+    LinearSolverSet linear_solvers;  ///< All linear solvers created by this factory.
+};
+
+} // namespace Algorithms
+} // namespace Thea
+
+#endif
@@ -0,0 +1,1155 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#include "LanczosEigenSolver.hpp"
+#include "../../Algorithms/LinearSolver.hpp"
+#include "../../Application.hpp"
+#include "../../Array.hpp"
+#include "../../ParallelFor.hpp"
+#include "../../System.hpp"
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Thea {
+namespace Algorithms {
+
+namespace LanczosEigenSolverInternal {
+
+typedef MatrixWrapper<double>::SparseRowMatrix SparseRowMatrix;
+
+// Dense operations on basis vectors process rows in tiles of this size, so that the tiles of a block of vectors stay in cache.
+static long const TILE_SIZE = 1024;
+
+// Calls task->run(begin, end, block) for a block of rows [blocks[block], blocks[block + 1]).
+template <typename TaskT>
+struct BlockRunner
+{
+  BlockRunner(TaskT * task_, TheaArray<long> const * blocks_) : task(task_), blocks(blocks_) {}
+
+  void operator()(long block)
+  {
+    task->run((*blocks)[(array_size_t)block], (*blocks)[(array_size_t)block + 1], block);
+  }
+
+  TaskT * task;
+  TheaArray<long> const * blocks;
+
+}; // struct BlockRunner
+
+// Run a task on each block of rows [blocks[i], blocks[i + 1]), in parallel.
+template <typename TaskT>
+void
+runOnBlocks(TaskT & task, TheaArray<long> const & blocks)
+{
+  long num_blocks = (long)blocks.size() - 1;
+  parallelFor(num_blocks, BlockRunner<TaskT>(&task, &blocks), 1, num_blocks);
+}
+
+// Fill a vector with deterministic pseudo-random values in [-1, 1].
+void
+fillRandom(long n, double * v, uint64 seed)
+{
+  for (long i = 0; i < n; ++i)
+  {
+    // SplitMix64 hash of the seed and the index
+    uint64 z = seed * 0x9E3779B97F4A7C15ULL + (uint64)i * 0xBF58476D1CE4E5B9ULL + 0x94D049BB133111EBULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+
+    v[i] = 2 * ((double)(z >> 11) / 9007199254740992.0) - 1;
+  }
+}
+
+// Computes C = V[:, v_begin..v_end)^T * V[:, w_begin..w_end) for a basis V of column vectors, with a separate partial product
+// for each block of rows.
+struct ProjectTask
+{
+  ProjectTask(double const * basis_, long n_, long v_begin_, long v_end_, long w_begin_, long w_end_, long num_blocks)
+  : basis(basis_), n(n_), v_begin(v_begin_), v_end(v_end_), w_begin(w_begin_), w_end(w_end_), partial((array_size_t)num_blocks)
+  {}
+
+  void run(long begin, long end, long block)
+  {
+    long nv = v_end - v_begin, nw = w_end - w_begin;
+    TheaArray<double> & c = partial[(array_size_t)block];
+    c.assign((array_size_t)(nv * nw), 0.0);
+
+    for (long t = begin; t < end; t += TILE_SIZE)
+    {
+      long t_end = std::min(t + TILE_SIZE, end);
+      for (long i = 0; i < nv; ++i)
+      {
+        double const * v = basis + (v_begin + i) * n;
+        double * ci = &c[(array_size_t)(i * nw)];
+
+        // Four dot products at a time, for independent accumulators and fewer loads of v
+        long j = 0;
+        for ( ; j + 4 <= nw; j += 4)
+        {
+          double const * w0 = basis + (w_begin + j) * n;
+          double const * w1 = w0 + n;
+          double const * w2 = w1 + n;
+          double const * w3 = w2 + n;
+
+          double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+          for (long r = t; r < t_end; ++r)
+          {
+            double vr = v[r];
+            s0 += vr * w0[r];
+            s1 += vr * w1[r];
+            s2 += vr * w2[r];
+            s3 += vr * w3[r];
+          }
+
+          ci[j] += s0; ci[j + 1] += s1; ci[j + 2] += s2; ci[j + 3] += s3;
+        }
+
+        for ( ; j < nw; ++j)
+        {
+          double const * w = basis + (w_begin + j) * n;
+
+          double s0 = 0, s1 = 0;
+          long r = t;
+          for ( ; r + 1 < t_end; r += 2)
+          {
+            s0 += v[r] * w[r];
+            s1 += v[r + 1] * w[r + 1];
+          }
+
+          if (r < t_end)
+            s0 += v[r] * w[r];
+
+          ci[j] += s0 + s1;
+        }
+      }
+    }
+  }
+
+  // Sum the partial products.
+  void getResult(TheaArray<double> & result) const
+  {
+    result = partial[0];
+    for (array_size_t b = 1; b < partial.size(); ++b)
+      for (array_size_t i = 0; i < result.size(); ++i)
+        result[i] += partial[b][i];
+  }
+
+  double const * basis;
+  long n, v_begin, v_end, w_begin, w_end;
+  TheaArray< TheaArray<double> > partial;
+
+}; // struct ProjectTask
+
+// Computes V[:, w_begin..w_end) -= V[:, v_begin..v_end) * C for a basis V of column vectors.
+struct UpdateTask
+{
+  UpdateTask(double * basis_, long n_, long v_begin_, long v_end_, long w_begin_, long w_end_, TheaArray<double> const & c_)
+  : basis(basis_), n(n_), v_begin(v_begin_), v_end(v_end_), w_begin(w_begin_), w_end(w_end_), c(c_)
+  {}
+
+  void run(long begin, long end, long block)
+  {
+    long nv = v_end - v_begin, nw = w_end - w_begin;
+    for (long t = begin; t < end; t += TILE_SIZE)
+    {
+      long t_end = std::min(t + TILE_SIZE, end);
+      for (long j = 0; j < nw; ++j)
+      {
+        double * w = basis + (w_begin + j) * n;
+
+        // Subtract four vectors at a time, to cut loads and stores of w
+        long i = 0;
+        for ( ; i + 4 <= nv; i += 4)
+        {
+          double c0 = c[(array_size_t)(i * nw + j)], c1 = c[(array_size_t)((i + 1) * nw + j)];
+          double c2 = c[(array_size_t)((i + 2) * nw + j)], c3 = c[(array_size_t)((i + 3) * nw + j)];
+          double const * v0 = basis + (v_begin + i) * n;
+          double const * v1 = v0 + n;
+          double const * v2 = v1 + n;
+          double const * v3 = v2 + n;
+
+          for (long r = t; r < t_end; ++r)
+            w[r] -= c0 * v0[r] + c1 * v1[r] + c2 * v2[r] + c3 * v3[r];
+        }
+
+        for ( ; i < nv; ++i)
+        {
+          double coeff = c[(array_size_t)(i * nw + j)];
+          double const * v = basis + (v_begin + i) * n;
+          for (long r = t; r < t_end; ++r)
+            w[r] -= coeff * v[r];
+        }
+      }
+    }
+  }
+
+  double * basis;
+  long n, v_begin, v_end, w_begin, w_end;
+  TheaArray<double> const & c;
+
+}; // struct UpdateTask
+
+// Replaces V[:, 0..k) with V[:, 0..m) * Y, where Y is an m x k row-major matrix, in place.
+struct CombineTask
+{
+  CombineTask(double * basis_, long n_, long m_, long k_, TheaArray<double> const & y_)
+  : basis(basis_), n(n_), m(m_), k(k_), y(y_)
+  {}
+
+  void run(long begin, long end, long block)
+  {
+    TheaArray<double> tile((array_size_t)(k * TILE_SIZE));
+    for (long t = begin; t < end; t += TILE_SIZE)
+    {
+      long len = std::min(t + TILE_SIZE, end) - t;
+      std::fill(tile.begin(), tile.end(), 0.0);
+
+      // Accumulate four basis vectors at a time
+      long c = 0;
+      for ( ; c + 4 <= m; c += 4)
+      {
+        double const * v0 = basis + c * n + t;
+        double const * v1 = v0 + n;
+        double const * v2 = v1 + n;
+        double const * v3 = v2 + n;
+
+        for (long s = 0; s < k; ++s)
+        {
+          double y0 = y[(array_size_t)(c * k + s)], y1 = y[(array_size_t)((c + 1) * k + s)];
+          double y2 = y[(array_size_t)((c + 2) * k + s)], y3 = y[(array_size_t)((c + 3) * k + s)];
+
+          double * out = &tile[(array_size_t)(s * TILE_SIZE)];
+          for (long r = 0; r < len; ++r)
+            out[r] += y0 * v0[r] + y1 * v1[r] + y2 * v2[r] + y3 * v3[r];
+        }
+      }
+
+      for ( ; c < m; ++c)
+      {
+        double const * v = basis + c * n + t;
+        for (long s = 0; s < k; ++s)
+        {
+          double coeff = y[(array_size_t)(c * k + s)];
+          double * out = &tile[(array_size_t)(s * TILE_SIZE)];
+          for (long r = 0; r < len; ++r)
+            out[r] += coeff * v[r];
+        }
+      }
+
+      for (long s = 0; s < k; ++s)
+        std::copy(&tile[(array_size_t)(s * TILE_SIZE)], &tile[(array_size_t)(s * TILE_SIZE)] + len, basis + s * n + t);
+    }
+  }
+
+  double * basis;
+  long n, m, k;
+  TheaArray<double> const & y;
+
+}; // struct CombineTask
+
+// Interface for the operator whose eigenpairs are computed.
+class Operator
+{
+  public:
+    virtual ~Operator() {}
+
+    // Apply the operator to num_vecs vectors stored consecutively in x, writing the results consecutively to y.
+    virtual void apply(long num_vecs, double const * x, double * y) = 0;
+
+}; // class Operator
+
+// Product with a compressed row matrix, for a block of vectors at a time.
+class MatrixOperator : public Operator
+{
+  public:
+    MatrixOperator(SparseRowMatrix const & a_, long max_threads) : a(a_)
+    {
+      // Split the rows into blocks with roughly the same number of non-zeros, one block per thread
+      static long const MIN_NONZEROS_PER_THREAD = 100000;
+
+      long n = a.numRows();
+      long nnz = a.numSetElements();
+      long num_threads = numThreadsForWork(nnz, MIN_NONZEROS_PER_THREAD, max_threads);
+
+      TheaArray<SparseRowMatrix::Index1D> const & row_starts = a.getRowIndices();
+      blocks.push_back(0);
+      for (long t = 1; t < num_threads; ++t)
+      {
+        long row = (long)(std::lower_bound(row_starts.begin(), row_starts.end() - 1,
+                                           (SparseRowMatrix::Index1D)((nnz * t) / num_threads)) - row_starts.begin());
+        if (row > blocks.back() && row < n)
+          blocks.push_back(row);
+      }
+
+      blocks.push_back(n);
+    }
+
+    void apply(long num_vecs, double const * x_, double * y_)
+    {
+      // Interleave the input vectors so that the entries of all vectors for a column are adjacent
+      num_vecs_ = num_vecs; x = x_; y = y_;
+      interleaved.resize((array_size_t)(a.numRows() * num_vecs));
+
+      phase = INTERLEAVE; runOnBlocks(*this, blocks);
+      phase = MULTIPLY;   runOnBlocks(*this, blocks);
+    }
+
+    // Process a block of rows.
+    void run(long begin, long end, long block)
+    {
+      long n = a.numRows(), b = num_vecs_;
+
+      if (phase == INTERLEAVE)
+      {
+        for (long r = begin; r < end; ++r)
+          for (long j = 0; j < b; ++j)
+            interleaved[(array_size_t)(r * b + j)] = x[j * n + r];
+
+        return;
+      }
+
+      TheaArray<SparseRowMatrix::Index1D> const & row_starts = a.getRowIndices();
+      TheaArray<SparseRowMatrix::Index2D> const & cols = a.getColumnIndices();
+      TheaArray<double> const & values = a.getValues();
+
+      TheaArray<double> sum((array_size_t)b);
+      for (long r = begin; r < end; ++r)
+      {
+        std::fill(sum.begin(), sum.end(), 0.0);
+        for (SparseRowMatrix::Index1D e = row_starts[(array_size_t)r]; e < row_starts[(array_size_t)r + 1]; ++e)
+        {
+          double v = values[(array_size_t)e];
+          double const * xc = &interleaved[(array_size_t)((long)cols[(array_size_t)e] * b)];
+          for (long j = 0; j < b; ++j)
+            sum[(array_size_t)j] += v * xc[j];
+        }
+
+        for (long j = 0; j < b; ++j)
+          y[j * n + r] = sum[(array_size_t)j];
+      }
+    }
+
+  private:
+    enum Phase { INTERLEAVE, MULTIPLY };
+
+    SparseRowMatrix const & a;
+    TheaArray<long> blocks;
+    TheaArray<double> interleaved;
+    Phase phase;
+    long num_vecs_;
+    double const * x;
+    double * y;
+
+}; // class MatrixOperator
+
+// Product with (A - sigma * I)^-1, computed by a linear solver from a single factorization.
+class ShiftInvertOperator : public Operator
+{
+  public:
+    ShiftInvertOperator(std::string const & name, SparseRowMatrix const & a, double sigma, std::string const & solver_type,
+                        std::string const & method, long max_threads)
+    : factory(NULL), solver(NULL)
+    {
+      // Shift the diagonal, adding missing diagonal entries if necessary
+      SparseRowMatrix shifted(a);
+      TheaArray<SparseRowMatrix::Index1D> const & row_starts = shifted.getRowIndices();
+      TheaArray<SparseRowMatrix::Index2D> const & cols = shifted.getColumnIndices();
+
+      bool has_diagonal = true;
+      for (long r = 0; r < shifted.numRows() && has_diagonal; ++r)
+      {
+        has_diagonal = false;
+        for (SparseRowMatrix::Index1D e = row_starts[(array_size_t)r]; e < row_starts[(array_size_t)r + 1]; ++e)
+          if ((long)cols[(array_size_t)e] == r)
+          {
+            shifted.values[(array_size_t)e] -= sigma;
+            has_diagonal = true;
+            break;
+          }
+      }
+
+      if (!has_diagonal)
+      {
+        TheaArray<SparseRowMatrix::Entry> entries;
+        entries.reserve((array_size_t)(a.numSetElements() + a.numRows()));
+        for (SparseRowMatrix::ConstIterator ei = a.begin(); ei != a.end(); ++ei)
+          entries.push_back(*ei);
+
+        for (long r = 0; r < a.numRows(); ++r)
+          entries.push_back(SparseRowMatrix::Entry(SparseRowMatrix::IndexPair(r, r), -sigma));
+
+        shifted.setFromEntries(a.numRows(), a.numColumns(), entries);
+      }
+
+      factory = Application::getLinearSolverManager().getFactory(solver_type);
+      solver = factory->createLinearSolver(name + " shift-invert solver");
+      solver->setCoefficients(shifted);
+
+      Options opts;
+      opts.set("method", method);
+      opts.set("max-threads", max_threads);
+      if (!solver->factorize(opts))
+      {
+        destroySolver();
+        throw Error(name + ": Could not factor shifted operator matrix (is sigma an eigenvalue?)");
+      }
+    }
+
+    ~ShiftInvertOperator() { destroySolver(); }
+
+    void apply(long num_vecs, double const * x, double * y)
+    {
+      if (!solver->solveFactored(num_vecs, x, y))
+        throw Error("LanczosEigenSolver: Could not solve shifted system");
+    }
+
+  private:
+    void destroySolver()
+    {
+      if (factory && solver)
+        factory->destroyLinearSolver(solver);
+
+      solver = NULL;
+    }
+
+    LinearSolverFactory * factory;
+    LinearSolver * solver;
+
+}; // class ShiftInvertOperator
+
+// Computes all eigenvalues d and eigenvectors of a dense symmetric m x m matrix, stored row-major in v. On return, v holds the
+// eigenvectors as columns. Householder reduction to tridiagonal form followed by the implicit QL method, after the EISPACK
+// routines tred2 and tql2.
+void
+symmetricEigen(long m, TheaArray<double> & v, TheaArray<double> & d)
+{
+  d.resize((array_size_t)m);
+  if (m <= 0)
+    return;
+
+  TheaArray<double> e((array_size_t)m, 0.0);
+
+#define V(i, j) v[(array_size_t)((i) * m + (j))]
+
+  // Householder tridiagonalization
+  for (long j = 0; j < m; ++j)
+    d[(array_size_t)j] = V(m - 1, j);
+
+  for (long i = m - 1; i > 0; --i)
+  {
+    double scale = 0, h = 0;
+    for (long k = 0; k < i; ++k)
+      scale += std::fabs(d[(array_size_t)k]);
+
+    if (scale == 0)
+    {
+      e[(array_size_t)i] = d[(array_size_t)i - 1];
+      for (long j = 0; j < i; ++j)
+      {
+        d[(array_size_t)j] = V(i - 1, j);
+        V(i, j) = 0;
+        V(j, i) = 0;
+      }
+    }
+    else
+    {
+      for (long k = 0; k < i; ++k)
+      {
+        d[(array_size_t)k] /= scale;
+        h += d[(array_size_t)k] * d[(array_size_t)k];
+      }
+
+      double f = d[(array_size_t)i - 1];
+      double g = std::sqrt(h);
+      if (f > 0) g = -g;
+
+      e[(array_size_t)i] = scale * g;
+      h -= f * g;
+      d[(array_size_t)i - 1] = f - g;
+      for (long j = 0; j < i; ++j)
+        e[(array_size_t)j] = 0;
+
+      for (long j = 0; j < i; ++j)
+      {
+        f = d[(array_size_t)j];
+        V(j, i) = f;
+        g = e[(array_size_t)j] + V(j, j) * f;
+        for (long k = j + 1; k <= i - 1; ++k)
+        {
+          g += V(k, j) * d[(array_size_t)k];
+          e[(array_size_t)k] += V(k, j) * f;
+        }
+
+        e[(array_size_t)j] = g;
+      }
+
+      f = 0;
+      for (long j = 0; j < i; ++j)
+      {
+        e[(array_size_t)j] /= h;
+        f += e[(array_size_t)j] * d[(array_size_t)j];
+      }
+
+      double hh = f / (h + h);
+      for (long j = 0; j < i; ++j)
+        e[(array_size_t)j] -= hh * d[(array_size_t)j];
+
+      for (long j = 0; j < i; ++j)
+      {
+        f = d[(array_size_t)j];
+        g = e[(array_size_t)j];
+        for (long k = j; k <= i - 1; ++k)
+          V(k, j) -= (f * e[(array_size_t)k] + g * d[(array_size_t)k]);
+
+        d[(array_size_t)j] = V(i - 1, j);
+        V(i, j) = 0;
+      }
+    }
+
+    d[(array_size_t)i] = h;
+  }
+
+  // Accumulate the transformations
+  for (long i = 0; i < m - 1; ++i)
+  {
+    V(m - 1, i) = V(i, i);
+    V(i, i) = 1;
+
+    double h = d[(array_size_t)i + 1];
+    if (h != 0)
+    {
+      for (long k = 0; k <= i; ++k)
+        d[(array_size_t)k] = V(k, i + 1) / h;
+
+      for (long j = 0; j <= i; ++j)
+      {
+        double g = 0;
+        for (long k = 0; k <= i; ++k)
+          g += V(k, i + 1) * V(k, j);
+
+        for (long k = 0; k <= i; ++k)
+          V(k, j) -= g * d[(array_size_t)k];
+      }
+    }
+
+    for (long k = 0; k <= i; ++k)
+      V(k, i + 1) = 0;
+  }
+
+  for (long j = 0; j < m; ++j)
+  {
+    d[(array_size_t)j] = V(m - 1, j);
+    V(m - 1, j) = 0;
+  }
+
+  V(m - 1, m - 1) = 1;
+  e[0] = 0;
+
+  // Implicit QL iterations on the tridiagonal matrix
+  for (long i = 1; i < m; ++i)
+    e[(array_size_t)i - 1] = e[(array_size_t)i];
+
+  e[(array_size_t)m - 1] = 0;
+
+  double f = 0, tst1 = 0;
+  double const eps = std::numeric_limits<double>::epsilon();
+  for (long l = 0; l < m; ++l)
+  {
+    // Find a small subdiagonal element
+    tst1 = std::max(tst1, std::fabs(d[(array_size_t)l]) + std::fabs(e[(array_size_t)l]));
+    long mm = l;
+    while (mm < m - 1 && std::fabs(e[(array_size_t)mm]) > eps * tst1)
+      ++mm;
+
+    // If mm == l, d[l] is already an eigenvalue, else iterate
+    if (mm > l)
+    {
+      do
+      {
+        // Compute the implicit shift
+        double g = d[(array_size_t)l];
+        double p = (d[(array_size_t)l + 1] - g) / (2 * e[(array_size_t)l]);
+        double r = std::sqrt(p * p + 1);
+        if (p < 0) r = -r;
+
+        d[(array_size_t)l] = e[(array_size_t)l] / (p + r);
+        d[(array_size_t)l + 1] = e[(array_size_t)l] * (p + r);
+        double dl1 = d[(array_size_t)l + 1];
+        double h = g - d[(array_size_t)l];
+        for (long i = l + 2; i < m; ++i)
+          d[(array_size_t)i] -= h;
+
+        f += h;
+
+        // Implicit QL transformation
+        p = d[(array_size_t)mm];
+        double c = 1, c2 = 1, c3 = 1, s = 0, s2 = 0;
+        double el1 = e[(array_size_t)l + 1];
+        for (long i = mm - 1; i >= l; --i)
+        {
+          c3 = c2;
+          c2 = c;
+          s2 = s;
+          g = c * e[(array_size_t)i];
+          h = c * p;
+          r = std::sqrt(p * p + e[(array_size_t)i] * e[(array_size_t)i]);
+          e[(array_size_t)i + 1] = s * r;
+          s = e[(array_size_t)i] / r;
+          c = p / r;
+          p = c * d[(array_size_t)i] - s * g;
+          d[(array_size_t)i + 1] = h + s * (c * g + s * d[(array_size_t)i]);
+
+          // Accumulate the transformation
+          for (long k = 0; k < m; ++k)
+          {
+            h = V(k, i + 1);
+            V(k, i + 1) = s * V(k, i) + c * h;
+            V(k, i) = c * V(k, i) - s * h;
+          }
+        }
+
+        p = -s * s2 * c3 * el1 * e[(array_size_t)l] / dl1;
+        e[(array_size_t)l] = s * p;
+        d[(array_size_t)l] = c * p;
+
+      } while (std::fabs(e[(array_size_t)l]) > eps * tst1);
+    }
+
+    d[(array_size_t)l] += f;
+    e[(array_size_t)l] = 0;
+  }
+
+#undef V
+}
+
+// Orders eigenvalues from the most to the least wanted.
+class EigenvalueOrder
+{
+  public:
+    EigenvalueOrder(std::string const & which_, TheaArray<double> const & values_, double center_ = 0)
+    : which(which_), values(values_), center(center_)
+    {}
+
+    bool operator()(long i, long j) const
+    {
+      double a = values[(array_size_t)i] - center, b = values[(array_size_t)j] - center;
+      if (which == "LA")      return a > b;
+      else if (which == "SA") return a < b;
+      else if (which == "SM") return std::fabs(a) < std::fabs(b);
+      else                    return std::fabs(a) > std::fabs(b);  // LM
+    }
+
+  private:
+    std::string which;
+    TheaArray<double> const & values;
+    double center;
+
+}; // class EigenvalueOrder
+
+// Thick-restart block Lanczos iteration for a symmetric operator.
+class BlockLanczos
+{
+  public:
+    BlockLanczos(Operator & op_, long n_, long block_size, long ncv_, long max_threads)
+    : op(op_), n(n_), b(block_size), ncv(ncv_), basis((array_size_t)(n_ * (ncv_ + block_size))),
+      h((array_size_t)(ncv_ * ncv_), 0.0), r((array_size_t)(block_size * block_size), 0.0), num_random(0)
+    {
+      // Dense operations on the basis are split into blocks of rows, one block per thread
+      static long const MIN_ROWS_PER_THREAD = 20000;
+
+      long num_threads = numThreadsForWork(n, MIN_ROWS_PER_THREAD, max_threads);
+      for (long t = 0; t <= num_threads; ++t)
+        row_blocks.push_back((n * t) / num_threads);
+    }
+
+    // Look for nev eigenpairs at the end of the spectrum specified by "which", with at most maxit restarts. On return, the
+    // first nev basis vectors are the Ritz vectors, in order, with their Ritz values and residual norms in the output arrays.
+    // Returns the number of converged Ritz pairs.
+    long run(long nev, std::string const & which, double tol, long maxit, TheaArray<double> & ritz_values,
+             TheaArray<double> & residuals, TheaArray<bool> & converged)
+    {
+      // Start with a random orthonormal block
+      for (long j = 0; j < b; ++j)
+        fillRandom(n, column(j), num_random++);
+
+      orthonormalizeBlock(0);
+
+      long p = 0;  // start of the block to be multiplied by the operator
+      for (long iter = 0; ; ++iter)
+      {
+        // Expand the basis a block at a time until it is full
+        while (true)
+        {
+          op.apply(b, column(p), column(p + b));
+          orthonormalizeBlock(p + b);
+
+          if (p + 2 * b > ncv)
+            break;
+
+          p += b;
+        }
+
+        // Rayleigh-Ritz step on the projected matrix
+        long m = p + b;
+        TheaArray<double> y((array_size_t)(m * m)), theta;
+        for (long i = 0; i < m; ++i)
+          std::copy(&h[(array_size_t)(i * ncv)], &h[(array_size_t)(i * ncv + m)], &y[(array_size_t)(i * m)]);
+
+        symmetricEigen(m, y, theta);
+
+        TheaArray<long> order((array_size_t)m);
+        for (long i = 0; i < m; ++i) order[(array_size_t)i] = i;
+        std::stable_sort(order.begin(), order.end(), EigenvalueOrder(which, theta));
+
+        // Residual norm of Ritz pair (theta, V * y) is |R * y_last|, where the last block of A * V - V * H is Q * R
+        double max_abs_theta = 0;
+        for (long i = 0; i < m; ++i)
+          max_abs_theta = std::max(max_abs_theta, std::fabs(theta[(array_size_t)i]));
+
+        // Ritz values near zero are accepted once their residuals reach the rounding error of the operator
+        double min_residual = 100 * std::numeric_limits<double>::epsilon() * max_abs_theta;
+        ritz_values.resize((array_size_t)nev);
+        residuals.resize((array_size_t)nev);
+        converged.resize((array_size_t)nev);
+
+        long num_converged = 0;
+        for (long s = 0; s < nev; ++s)
+        {
+          long i = order[(array_size_t)s];
+          double res = 0;
+          for (long u = 0; u < b; ++u)
+          {
+            double ru = 0;
+            for (long t = u; t < b; ++t)
+              ru += r[(array_size_t)(u * b + t)] * y[(array_size_t)((m - b + t) * m + i)];
+
+            res += ru * ru;
+          }
+
+          ritz_values[(array_size_t)s] = theta[(array_size_t)i];
+          residuals[(array_size_t)s] = std::sqrt(res);
+          converged[(array_size_t)s] = (residuals[(array_size_t)s]
+                                        <= std::max(tol * std::fabs(theta[(array_size_t)i]), min_residual));
+          if (converged[(array_size_t)s])
+            num_converged++;
+        }
+
+        THEA_DEBUG << "LanczosEigenSolver: Restart " << iter << ", basis size " << m << ", " << num_converged << '/' << nev
+                   << " Ritz pair(s) converged";
+
+        if (num_converged >= nev || iter >= maxit)
+        {
+          restart(nev, m, y, theta, order, false);
+          return num_converged;
+        }
+
+        // Keep the most wanted Ritz vectors, leaving room for at least two more blocks
+        long k = std::min(nev + (m - nev) / 2, ncv - 2 * b);
+        restart(k, m, y, theta, order, true);
+        p = k;
+      }
+    }
+
+    // Get a basis vector.
+    double * column(long i) { return &basis[(array_size_t)(i * n)]; }
+
+  private:
+    // Compute C = V[:, v_begin..v_end)^T * V[:, w_begin..w_end).
+    void project(long v_begin, long v_end, long w_begin, long w_end, TheaArray<double> & c)
+    {
+      ProjectTask task(&basis[0], n, v_begin, v_end, w_begin, w_end, (long)row_blocks.size() - 1);
+      runOnBlocks(task, row_blocks);
+      task.getResult(c);
+    }
+
+    // Compute V[:, w_begin..w_end) -= V[:, v_begin..v_end) * C.
+    void update(long v_begin, long v_end, long w_begin, long w_end, TheaArray<double> const & c)
+    {
+      UpdateTask task(&basis[0], n, v_begin, v_end, w_begin, w_end, c);
+      runOnBlocks(task, row_blocks);
+    }
+
+    // Orthogonalize V[:, w_begin..w_end) against V[:, 0..v_end) with two passes of classical Gram-Schmidt, accumulating the
+    // coefficients in c.
+    void orthogonalize(long v_end, long w_begin, long w_end, TheaArray<double> & c)
+    {
+      c.assign((array_size_t)(v_end * (w_end - w_begin)), 0.0);
+      if (v_end <= 0)
+        return;
+
+      TheaArray<double> pass_c;
+      for (int pass = 0; pass < 2; ++pass)
+      {
+        project(0, v_end, w_begin, w_end, pass_c);
+        update(0, v_end, w_begin, w_end, pass_c);
+
+        for (array_size_t i = 0; i < c.size(); ++i)
+          c[i] += pass_c[i];
+      }
+    }
+
+    // Get the norm of a basis vector.
+    double norm(long i)
+    {
+      TheaArray<double> c;
+      project(i, i + 1, i, i + 1, c);
+      return std::sqrt(c[0]);
+    }
+
+    // Scale a basis vector.
+    void scale(long i, double s)
+    {
+      double * v = column(i);
+      for (long j = 0; j < n; ++j)
+        v[j] *= s;
+    }
+
+    // Orthonormalize the block starting at column c0 against all preceding basis vectors, and within itself. If c0 > 0, the
+    // block is the operator applied to the preceding block, and the projection coefficients are recorded in the projected
+    // matrix H, and the upper-triangular factor of the within-block orthonormalization in R.
+    void orthonormalizeBlock(long c0)
+    {
+      TheaArray<double> norms0((array_size_t)b);
+      for (long j = 0; j < b; ++j)
+        norms0[(array_size_t)j] = norm(c0 + j);
+
+      // Project out the preceding basis, which gives the columns of H for the previous block
+      if (c0 > 0)
+      {
+        TheaArray<double> c;
+        orthogonalize(c0, c0, c0 + b, c);
+
+        long q0 = c0 - b;  // start of the previous block
+        for (long i = 0; i < c0; ++i)
+          for (long j = 0; j < b; ++j)
+          {
+            double hij = c[(array_size_t)(i * b + j)];
+            if (i < q0)
+            {
+              h[(array_size_t)(i * ncv + q0 + j)] = hij;
+              h[(array_size_t)((q0 + j) * ncv + i)] = hij;
+            }
+            else if (i - q0 <= j)  // symmetrize the diagonal block
+            {
+              double sym = 0.5 * (hij + c[(array_size_t)((q0 + j) * b + (i - q0))]);
+              h[(array_size_t)(i * ncv + q0 + j)] = sym;
+              h[(array_size_t)((q0 + j) * ncv + i)] = sym;
+            }
+          }
+      }
+
+      // Orthonormalize within the block
+      std::fill(r.begin(), r.end(), 0.0);
+      for (long j = 0; j < b; ++j)
+      {
+        long w = c0 + j;
+        if (j > 0)
+        {
+          TheaArray<double> c, pass_c;
+          c.assign((array_size_t)j, 0.0);
+          for (int pass = 0; pass < 2; ++pass)
+          {
+            project(c0, w, w, w + 1, pass_c);
+            update(c0, w, w, w + 1, pass_c);
+            for (long i = 0; i < j; ++i)
+              c[(array_size_t)i] += pass_c[(array_size_t)i];
+          }
+
+          for (long i = 0; i < j; ++i)
+            r[(array_size_t)(i * b + j)] = c[(array_size_t)i];
+        }
+
+        double nrm = norm(w);
+        if (nrm > 1.0e-10 * norms0[(array_size_t)j] && nrm > 0)
+        {
+          r[(array_size_t)(j * b + j)] = nrm;
+          scale(w, 1.0 / nrm);
+        }
+        else
+        {
+          // The block is (numerically) rank-deficient: continue with a random vector orthogonal to the basis. Its component
+          // in the residual is zero.
+          for (int attempt = 0; ; ++attempt)
+          {
+            fillRandom(n, column(w), num_random++);
+
+            TheaArray<double> c;
+            orthogonalize(w, w, w + 1, c);
+
+            nrm = norm(w);
+            if (nrm > 1.0e-6)
+              break;
+
+            if (attempt >= 10)
+              throw Error("LanczosEigenSolver: Could not extend Krylov basis");
+          }
+
+          scale(w, 1.0 / nrm);
+        }
+      }
+    }
+
+    // Replace the first k basis vectors with the Ritz vectors V * y for the k most wanted Ritz values. If thick_restart is
+    // true, also move the residual block after them and reset the projected matrix accordingly.
+    void restart(long k, long m, TheaArray<double> const & y, TheaArray<double> const & theta, TheaArray<long> const & order,
+                 bool thick_restart)
+    {
+      TheaArray<double> y_sel((array_size_t)(m * k));
+      for (long c = 0; c < m; ++c)
+        for (long s = 0; s < k; ++s)
+          y_sel[(array_size_t)(c * k + s)] = y[(array_size_t)(c * m + order[(array_size_t)s])];
+
+      CombineTask task(&basis[0], n, m, k, y_sel);
+      runOnBlocks(task, row_blocks);
+
+      if (!thick_restart)
+        return;
+
+      std::copy(column(m), column(m + b), column(k));
+
+      // The projected matrix is now diagonal, with an arrow for the coupling of the Ritz vectors to the residual block
+      std::fill(h.begin(), h.end(), 0.0);
+      for (long s = 0; s < k; ++s)
+      {
+        long i = order[(array_size_t)s];
+        h[(array_size_t)(s * ncv + s)] = theta[(array_size_t)i];
+
+        for (long u = 0; u < b; ++u)
+        {
+          double coupling = 0;
+          for (long t = u; t < b; ++t)
+            coupling += r[(array_size_t)(u * b + t)] * y[(array_size_t)((m - b + t) * m + i)];
+
+          h[(array_size_t)((k + u) * ncv + s)] = coupling;
+          h[(array_size_t)(s * ncv + k + u)] = coupling;
+        }
+      }
+    }
+
+    Operator & op;
+    long n, b, ncv;
+    TheaArray<double> basis;      // basis vectors, stored consecutively
+    TheaArray<double> h;          // projected matrix V^T * A * V, ncv x ncv row-major
+    TheaArray<double> r;          // upper-triangular coefficients of the residual block, b x b row-major
+    TheaArray<long> row_blocks;   // blocks of rows processed by different threads
+    uint64 num_random;            // number of random vectors generated so far
+
+}; // class BlockLanczos
+
+} // namespace LanczosEigenSolverInternal
+
+LanczosEigenSolver::LanczosEigenSolver(std::string const & name_)
+: NamedObject(name_)
+{}
+
+MatrixFormat
+LanczosEigenSolver::getPreferredFormat(MatrixFormat input_format)
+{
+  // Everything is converted to compressed row format, which is best for products with blocks of vectors
+  return MatrixFormat::SPARSE_ROW_MAJOR;
+}
+
+long
+LanczosEigenSolver::solve(int num_requested_eigenpairs, Options const & options)
+{
+  using namespace LanczosEigenSolverInternal;
+
+  eigenvalues.clear();
+  eigenvectors.clear();
+  relative_errors.clear();
+
+  if (matrix.getFormat() != MatrixFormat::SPARSE_ROW_MAJOR)  // should never happen since we always cache as sparse row-major
+    throw Error(std::string(getName()) + ": Unknown format of cached matrix");
+
+  SparseRowMatrix const & a = matrix.getSparseRowMatrix();
+  long n = a.numRows();
+  if (n <= 0)
+  {
+    THEA_WARNING << getName() << ": Attempting to compute eigenvalues of an empty matrix -- no eigenpairs computed";
+    return 0;
+  }
+
+  alwaysAssertM(MatrixUtil::isSquare(a), std::string(getName()) + ": Operator matrix is not square");
+
+  long nev = (num_requested_eigenpairs < 0 ? n : std::min((long)num_requested_eigenpairs, n));
+  if (nev <= 0)
+    return 0;
+
+  std::string which = toUpper(options.get<std::string>("which", "LM"));
+  if (which != "LM" && which != "SM" && which != "LA" && which != "SA")
+    throw Error(std::string(getName()) + ": Unsupported part of spectrum '" + which + '\'');
+
+  bool shift_invert = options.hasOption("sigma");
+  double sigma = (shift_invert ? options.get<double>("sigma", 0) : 0);
+
+  // Larger blocks make better use of the memory bandwidth (and of the threads of a shift-invert solver), but need a larger basis
+  // for the same rate of convergence
+  long block_size = std::max(options.get<long>("block-size", std::max(std::min(nev / 8, 8L), 1L)), 1L);
+  long ncv = std::max(options.get<long>("ncv", std::max(2 * nev + 4 * block_size, 32L)), nev + 2 * block_size);
+  long maxit = options.get<long>("maxit", 300);
+  double tol = options.get<double>("tol", 1e-8);
+  long max_threads = std::max(options.get<long>("max-threads", System::concurrency()), 1L);
+
+  THEA_DEBUG << getName() << ": nev = " << nev << ", which = " << which << ", sigma = " << (shift_invert ? sigma : 0)
+             << ", block-size = " << block_size << ", ncv = " << ncv << ", tol = " << tol << ", maxit = " << maxit;
+
+  // The basis must fit in the space, with room for the residual block. Small matrices are solved densely instead, but the dense
+  // solver needs O(n^2) memory, so for larger matrices the basis is shrunk to fit.
+  if (ncv + block_size > n)
+  {
+    static long const MAX_DENSE_SIZE = 1000;
+    if (n <= MAX_DENSE_SIZE)
+      return solveDense(nev, which, shift_invert, sigma);
+
+    if (n - block_size < nev + 2 * block_size)
+      throw Error(format("%s: Cannot compute %ld eigenpair(s) of a %ldx%ld matrix with block size %ld -- request fewer "
+                         "eigenpairs or use a smaller block size", getName(), nev, n, n, block_size));
+
+    ncv = n - block_size;
+    THEA_DEBUG << getName() << ": Basis size reduced to ncv = " << ncv << " to fit the matrix";
+  }
+
+  boost::scoped_ptr<Operator> op;
+  if (shift_invert)
+    op.reset(new ShiftInvertOperator(getName(), a, sigma, options.get<std::string>("linear-solver", "CSPARSE"),
+                                     options.get<std::string>("linear-solver-method", "LU"), max_threads));
+  else
+    op.reset(new MatrixOperator(a, max_threads));
+
+  // In shift-invert mode, the eigenvalues closest to sigma are the largest eigenvalues of the operator
+  BlockLanczos lanczos(*op, n, block_size, ncv, max_threads);
+  TheaArray<double> ritz_values, residuals;
+  TheaArray<bool> converged;
+  long num_converged = lanczos.run(nev, (shift_invert ? "LM" : which), tol, maxit, ritz_values, residuals, converged);
+
+  if (num_converged < nev)
+    THEA_WARNING << getName() << ": Only " << num_converged << " of " << nev << " eigenpair(s) converged";
+
+  for (long s = 0; s < nev; ++s)
+  {
+    if (!converged[(array_size_t)s])
+      continue;
+
+    double theta = ritz_values[(array_size_t)s];
+    eigenvalues.push_back(Eigenvalue(shift_invert ? sigma + 1.0 / theta : theta, 0));
+    relative_errors.push_back(theta != 0 ? residuals[(array_size_t)s] / std::fabs(theta) : residuals[(array_size_t)s]);
+
+    double const * v = lanczos.column(s);
+    eigenvectors.push_back(Eigenvector((array_size_t)n));
+    Eigenvector & ev = eigenvectors.back();
+    for (long i = 0; i < n; ++i)
+      ev[(array_size_t)i] = std::complex<double>(v[i], 0);
+  }
+
+  return (long)eigenvalues.size();
+}
+
+long
+LanczosEigenSolver::solveDense(long nev, std::string const & which, bool shift_invert, double sigma)
+{
+  using namespace LanczosEigenSolverInternal;
+
+  SparseRowMatrix const & a = matrix.getSparseRowMatrix();
+  long n = a.numRows();
+
+  TheaArray<double> v((array_size_t)(n * n), 0.0), d;
+  for (SparseRowMatrix::ConstIterator ei = a.begin(); ei != a.end(); ++ei)
+    v[(array_size_t)(ei->first.first * n + ei->first.second)] += ei->second;
+
+  symmetricEigen(n, v, d);
+
+  TheaArray<long> order((array_size_t)n);
+  for (long i = 0; i < n; ++i) order[(array_size_t)i] = i;
+
+  if (shift_invert)
+    std::stable_sort(order.begin(), order.end(), EigenvalueOrder("SM", d, sigma));
+  else
+    std::stable_sort(order.begin(), order.end(), EigenvalueOrder(which, d));
+
+  for (long s = 0; s < nev; ++s)
+  {
+    long j = order[(array_size_t)s];
+    eigenvalues.push_back(Eigenvalue(d[(array_size_t)j], 0));
+    relative_errors.push_back(0);
+
+    eigenvectors.push_back(Eigenvector((array_size_t)n));
+    Eigenvector & ev = eigenvectors.back();
+    for (long i = 0; i < n; ++i)
+      ev[(array_size_t)i] = std::complex<double>(v[(array_size_t)(i * n + j)], 0);
+  }
+
+  return nev;
+}
+
+LanczosEigenSolverFactory::~LanczosEigenSolverFactory()
+{
+  destroyAllEigenSolvers();
+}
+
+EigenSolver *
+LanczosEigenSolverFactory::createEigenSolver(std::string const & name)
+{
+  LanczosEigenSolver * es = new LanczosEigenSolver(name);
+  eigen_solvers.insert(es);
+  return es;
+}
+
+void
+LanczosEigenSolverFactory::destroyEigenSolver(EigenSolver * eigen_solver)
+{
+  eigen_solvers.erase(eigen_solver);
+  delete eigen_solver;
+}
+
+void
+LanczosEigenSolverFactory::destroyAllEigenSolvers()
+{
+  for (EigenSolverSet::iterator ei = eigen_solvers.begin(); ei != eigen_solvers.end(); ++ei)
+    delete *ei;
+
+  eigen_solvers.clear();
+}
+
+} // namespace Algorithms
+} // namespace Thea
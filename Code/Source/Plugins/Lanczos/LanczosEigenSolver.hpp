@@ -0,0 +1,146 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_Algorithms_LanczosEigenSolver_hpp__
+#define __Thea_Algorithms_LanczosEigenSolver_hpp__
+
+#include "LanczosCommon.hpp"
+#include "../../Set.hpp"
+#include "../../Algorithms/EigenSolver.hpp"
+
+namespace Thea {
+namespace Algorithms {
+
+/**
+ * Computes a few eigenpairs of a large, sparse, real symmetric matrix with the thick-restart block Lanczos method. The Krylov
+ * basis is expanded a block of vectors at a time, so that each product with the operator processes several vectors in a single
+ * pass over the matrix. The basis is kept fully orthogonal, and on restart it is compressed to the most wanted Ritz vectors
+ * plus the current residual block. Operator products and all dense operations on the basis vectors are split across threads.
+ *
+ * In shift-invert mode, the operator is (A - sigma * I)^-1, and each application is a solve with a single factorization of
+ * A - sigma * I computed by a LinearSolver that supports LinearSolver::factorize() (by default, the CSPARSE solver, whose plugin
+ * must be loaded). This is the fastest way to find the eigenvalues closest to sigma, e.g. the low end of the spectrum of a
+ * Laplacian.
+ *
+ * The operator matrix is assumed to be symmetric: this is not checked. All returned eigenvalues and eigenvectors are real.
+ */
+class THEA_LANCZOS_DLL_LOCAL LanczosEigenSolver : public EigenSolver
+{
+  private:
+    typedef EigenSolver BaseType;
+
+  public:
+    /** Constructor. */
+    LanczosEigenSolver(std::string const & name_);
+
+    /**
+     * {@inheritDoc}
+     *
+     * Only the eigenpairs that converge are returned, ordered as specified by the <b>which</b> option. Valid options for the
+     * Lanczos backend, where n is the size of the operator matrix and k is the number of requested eigenpairs, are:
+     * - <b>which</b>: Part of eigenvalue spectrum to be returned, ignored in shift-invert mode (which always returns the
+     *   eigenvalues closest to sigma)
+     *   - <i>Type:</i> <code>std::string</code> in {"LM", "SM", "LA", "SA"} (largest/smallest magnitude, largest/smallest
+     *     algebraic value)
+     *   - <i>Default</i>: "LM"
+     * - <b>sigma</b>: If specified, selects shift-invert mode with this shift
+     *   - <i>Type:</i> <code>double</code>
+     * - <b>block-size</b>: Number of vectors by which the basis is expanded at each step
+     *   - <i>Type:</i> <code>long</code>
+     *   - <i>Default</i>: k / 8, clamped to [1, 8]
+     * - <b>ncv</b>: Maximum size of the basis (at least k + 2 * block-size)
+     *   - <i>Type:</i> <code>long</code>
+     *   - <i>Default</i>: max{2 * k + 4 * block-size, 32}
+     * - <b>maxit</b>: Maximum number of restarts
+     *   - <i>Type:</i> <code>long</code>
+     *   - <i>Default</i>: 300
+     * - <b>tol</b>: Stopping criterion, satisfied for a Ritz pair (x, v) of the operator if |Av - xv| <= \a tol * |x|, or if
+     *   |Av - xv| is within a small multiple of machine precision times the largest Ritz value (for x close to zero)
+     *   - <i>Type:</i> <code>double</code>
+     *   - <i>Default</i>: 1e-8
+     * - <b>max-threads</b>: Maximum number of threads to use
+     *   - <i>Type:</i> <code>long</code>
+     *   - <i>Default</i>: Number of hardware threads
+     * - <b>linear-solver</b>: Type of linear solver used to factor A - sigma * I in shift-invert mode
+     *   - <i>Type:</i> <code>std::string</code>
+     *   - <i>Default</i>: "CSPARSE"
+     * - <b>linear-solver-method</b>: Factorization method passed to the linear solver (as its <b>method</b> option)
+     *   - <i>Type:</i> <code>std::string</code>
+     *   - <i>Default</i>: "LU"
+     *
+     * The relative error of each eigenpair is the residual norm of the corresponding Ritz pair of the operator, divided by the
+     * magnitude of the Ritz value. If n is too small for the basis, the eigenpairs of matrices with at most 1000 rows are computed
+     * with a dense solver instead, and for larger matrices the basis is shrunk to n - block-size vectors.
+     */
+    long solve(int num_requested_eigenpairs = -1, Options const & options = Options());
+
+  protected:
+    MatrixFormat getPreferredFormat(MatrixFormat input_format);
+
+  private:
+    /** Compute all eigenpairs of the (small) operator matrix with a dense solver, and return the requested subset. */
+    long solveDense(long nev, std::string const & which, bool shift_invert, double sigma);
+
+}; // class LanczosEigenSolver
+
+/** Factory for creating Lanczos eigensolvers. */
+class THEA_LANCZOS_DLL_LOCAL LanczosEigenSolverFactory : public EigenSolverFactory
+{
+  public:
+    /** Destructor. */
+    ~LanczosEigenSolverFactory();
+
+    EigenSolver * createEigenSolver(std::string const & name);
+    void destroyEigenSolver(EigenSolver * eigen_solver);
+
+    /** Destroy all eigensolvers created with this factory. */
+    void destroyAllEigenSolvers();
+
+  private:
+    typedef TheaSet<EigenSolver *> EigenSolverSet;  ///< Set of eigensolvers.
+
+    EigenSolverSet eigen_solvers;  ///< All eigensolvers created by this factory.
+};
+
+} // namespace Algorithms
+} // namespace Thea
+
+#endif
@@ -0,0 +1,127 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#include "SoftwareFramebuffer.hpp"
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+SoftwareFramebuffer::SoftwareFramebuffer(SoftwareRenderSystem * render_system_, char const * name_)
+: render_system(render_system_), name(name_), num_attachments(0), width(0), height(0)
+{
+  for (int i = 0; i < AttachmentPoint::MAX_ATTACHMENTS; ++i)
+  {
+    attachment_table[i] = NULL;
+    attachment_layers[i] = 0;
+  }
+}
+
+void
+SoftwareFramebuffer::attach(AttachmentPoint ap, Texture * texture, Texture::Face face, int z_offset)
+{
+  SoftwareTexture * sw_texture = dynamic_cast<SoftwareTexture *>(texture);
+  debugAssertM((texture && sw_texture) || (!texture && !sw_texture),
+               std::string(getName()) + ": Texture is not a valid software texture");
+
+  int layer = 0;
+  if (sw_texture)
+  {
+    if (sw_texture->getDimension() == Texture::Dimension::DIM_3D)
+    {
+      if (z_offset < 0 || z_offset >= sw_texture->getDepth())
+        throw Error(std::string(getName()) + ": Z-offset lies outside depth range of 3D texture");
+
+      layer = z_offset;
+    }
+    else if (sw_texture->getDimension() == Texture::Dimension::DIM_CUBE_MAP)
+      layer = (int)face;
+
+    if (num_attachments > 0 && !(num_attachments == 1 && attachment_table[ap])
+     && (sw_texture->getWidth() != width || sw_texture->getHeight() != height))
+      throw Error(std::string(getName()) + ": Texture to attach does not have same size as existing attachments");
+
+    if (ap == AttachmentPoint::DEPTH && sw_texture->getStorage() != SoftwareTexture::Storage::DEPTH32F)
+      throw Error(std::string(getName()) + ": Only a depth texture can be attached to the depth attachment point");
+
+    if (ap != AttachmentPoint::DEPTH && ap != AttachmentPoint::STENCIL
+     && sw_texture->getStorage() == SoftwareTexture::Storage::DEPTH32F)
+      throw Error(std::string(getName()) + ": A depth texture cannot be attached to a color attachment point");
+  }
+
+  if (sw_texture == attachment_table[ap] && layer == attachment_layers[ap])
+    return;
+
+  if (attachment_table[ap])
+    num_attachments--;
+
+  attachment_table[ap] = sw_texture;
+  attachment_layers[ap] = layer;
+
+  if (sw_texture)
+  {
+    num_attachments++;
+
+    if (num_attachments == 1)  // this is the first attachment
+    {
+      width  = sw_texture->getWidth();
+      height = sw_texture->getHeight();
+    }
+  }
+}
+
+void
+SoftwareFramebuffer::detach(AttachmentPoint ap)
+{
+  attach(ap, NULL);
+}
+
+void
+SoftwareFramebuffer::detachAll()
+{
+  for (int i = 0; i < AttachmentPoint::MAX_ATTACHMENTS; ++i)
+    detach(AttachmentPoint(i));
+}
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
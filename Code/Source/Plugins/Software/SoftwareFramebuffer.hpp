@@ -0,0 +1,100 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#ifndef __Thea_Graphics_Software_SoftwareFramebuffer_hpp__
+#define __Thea_Graphics_Software_SoftwareFramebuffer_hpp__
+
+#include "../../Graphics/Framebuffer.hpp"
+#include "SoftwareCommon.hpp"
+#include "SoftwareTexture.hpp"
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+// Forward declarations
+class SoftwareRenderSystem;
+
+/**
+ * An offscreen framebuffer for the software rendersystem. Only the COLOR_0 and DEPTH attachments are drawn to. Stencil
+ * attachments are accepted but ignored.
+ */
+class THEA_SOFTWARE_DLL_LOCAL SoftwareFramebuffer : public Framebuffer
+{
+  public:
+    /** Constructor. */
+    SoftwareFramebuffer(SoftwareRenderSystem * render_system_, char const * name_);
+
+    /** Get the parent rendersystem. */
+    SoftwareRenderSystem * getRenderSystem() const { return render_system; }
+
+    char const * getName() const { return name.c_str(); }
+
+    void attach(AttachmentPoint ap, Texture * texture, Texture::Face face = Texture::Face::POS_X, int z_offset = 0);
+    void detach(AttachmentPoint ap);
+    void detachAll();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /** Get the texture attached at an attachment point, if any. */
+    SoftwareTexture * getAttachment(AttachmentPoint ap) const { return attachment_table[ap]; }
+
+    /** Get the layer of the texture attached at an attachment point (the cube map face or the z-offset into a 3D texture). */
+    int getAttachmentLayer(AttachmentPoint ap) const { return attachment_layers[ap]; }
+
+  private:
+    SoftwareRenderSystem * render_system;
+    std::string name;
+    SoftwareTexture * attachment_table[AttachmentPoint::MAX_ATTACHMENTS];
+    int attachment_layers[AttachmentPoint::MAX_ATTACHMENTS];
+    int num_attachments;
+    int width;
+    int height;
+
+}; // class SoftwareFramebuffer
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
+
+#endif
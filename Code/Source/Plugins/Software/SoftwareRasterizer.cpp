@@ -0,0 +1,998 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#include "SoftwareRasterizer.hpp"
+#include "../../Math.hpp"
+#include "../../System.hpp"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define THEA_SOFTWARE_RASTERIZER_SSE2
+#endif
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+namespace SoftwareRasterizerInternal {
+
+enum
+{
+  TILE_SIZE                   =  64,     ///< Width and height of a screen tile, in pixels. Must be a multiple of BLOCK_SIZE.
+  BLOCK_SIZE                  =  8,      ///< Width and height of a block of pixels classified against triangle edges as a unit.
+  SUBPIXEL_SCALE              =  16,     ///< Number of subpixel steps per pixel (4 bits of subpixel precision).
+  SETUP_CHUNK_SIZE            =  256,    ///< Number of primitives set up by a single task.
+  BATCH_SIZE                  =  16384,  ///< Maximum number of primitives that are set up and binned before being rasterized.
+  MIN_PARALLEL_PRIMS          =  256,    ///< Minimum number of primitives in a batch for it to be processed in parallel.
+  MIN_TILES_PER_THREAD        =  4,      ///< Minimum number of non-empty tiles rasterized by each thread.
+  MIN_CLEAR_PIXELS_PER_THREAD =  262144  ///< Minimum number of pixels cleared by each thread.
+};
+
+// A primitive after clipping and setup, in window coordinates.
+struct THEA_SOFTWARE_DLL_LOCAL SetupPrim
+{
+  int type;                            // Number of vertices: 1 (point), 2 (line) or 3 (triangle).
+  int min_x, min_y, max_x, max_y;      // Bounding box of covered pixels, inclusive.
+
+  // Triangles only. Edge functions E(x, y) = a * x + b * y + c, evaluated at pixel (x, y), are non-negative inside the
+  // triangle. The fill convention bias is folded into c.
+  int64 edge_a[3], edge_b[3], edge_c[3];
+
+  // Reference point: the first vertex of a triangle, the start of a line, or the center of a point.
+  float x0, y0;
+
+  // Lines: end point. Points: diameter, in x1.
+  float x1, y1;
+
+  // Attribute planes. For triangles, the value at the reference point and the x and y derivatives. For lines, the values at
+  // the start and end. For points, the value. Varyings are divided by w to allow perspective-correct interpolation.
+  float z[3];
+  float inv_w[3];
+  float vary[Varying::NUM][3];
+
+}; // struct SetupPrim
+
+// Floor of the quotient of two integers, with a positive divisor.
+inline int64
+floorDiv(int64 a, int64 b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Check if a fragment with a given depth passes the depth test against the stored depth.
+inline bool
+depthPasses(RenderSystem::DepthTest test, float z, float stored)
+{
+  switch (test)
+  {
+    case RenderSystem::DepthTest::GREATER:      return z >  stored;
+    case RenderSystem::DepthTest::LESS:         return z <  stored;
+    case RenderSystem::DepthTest::GEQUAL:       return z >= stored;
+    case RenderSystem::DepthTest::LEQUAL:       return z <= stored;
+    case RenderSystem::DepthTest::NOTEQUAL:     return z != stored;
+    case RenderSystem::DepthTest::EQUAL:        return z == stored;
+    case RenderSystem::DepthTest::NEVER_PASS:   return false;
+    default:                                    return true;
+  }
+}
+
+// Quantize a value in [0, 1] to 8 bits.
+inline uint8
+quantize8(float value)
+{
+  return (uint8)(Math::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Shared state of a draw call, and the per-fragment operations.
+class THEA_SOFTWARE_DLL_LOCAL DrawContext
+{
+  public:
+    DrawContext(RasterState const & state_) : state(state_), num_active(0)
+    {
+      width = state.width;
+      height = state.height;
+      tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+      tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+      // Depth tests against a missing depth buffer always pass, and ALWAYS_PASS disables depth writes as in OpenGL
+      depth = (state.depth_target && state.depth_test != RenderSystem::DepthTest::ALWAYS_PASS)
+            ? state.depth_target->getData32F(state.depth_layer) : NULL;
+      depth_write = state.depth_write;
+
+      color8 = NULL;
+      color32f = NULL;
+      if (state.color_target && (state.color_write[0] || state.color_write[1] || state.color_write[2]
+                                 || state.color_write[3]))
+      {
+        if (state.color_target->getStorage() == SoftwareTexture::Storage::RGBA8)
+          color8 = state.color_target->getData8(state.color_layer);
+        else if (state.color_target->getStorage() == SoftwareTexture::Storage::RGBA32F)
+          color32f = state.color_target->getData32F(state.color_layer);
+      }
+
+      static int const VARYING_BITS[4] = { RasterState::COLOR_BIT, RasterState::NORMAL_BIT, RasterState::POSITION_BIT,
+                                           RasterState::TEXCOORD_BIT };
+      static int const VARYING_OFFSETS[5] = { Varying::COLOR, Varying::NORMAL, Varying::POSITION, Varying::TEXCOORD,
+                                              Varying::NUM };
+      for (int i = 0; i < 4; ++i)
+        if (state.varyings & VARYING_BITS[i])
+          for (int j = VARYING_OFFSETS[i]; j < VARYING_OFFSETS[i + 1]; ++j)
+            active[num_active++] = j;
+    }
+
+    /** Check if there is anything to write to. */
+    bool hasTargets() const { return depth || color8 || color32f; }
+
+    /** Run the depth test for the pixel with linear index \a index, updating the depth buffer if it passes. */
+    bool depthTest(long index, float z) const
+    {
+      if (!depth)
+        return state.depth_test != RenderSystem::DepthTest::NEVER_PASS;
+
+      if (!depthPasses(state.depth_test, z, depth[index]))
+        return false;
+
+      if (depth_write)
+        depth[index] = z;
+
+      return true;
+    }
+
+    /** Shade a fragment and write it to the color buffer. */
+    void writeColor(long index, float const * v) const
+    {
+      if (!color8 && !color32f)
+        return;
+
+      ColorRGBA c = state.shade(v);
+      float src[4] = { c.r(), c.g(), c.b(), c.a() };
+      float a = src[3];
+
+      if (color8)
+      {
+        uint8 * p = color8 + 4 * index;
+        for (int k = 0; k < 4; ++k)
+          if (state.color_write[k])
+            p[k] = quantize8(a < 1 ? src[k] * a + (p[k] / 255.0f) * (1 - a) : src[k]);
+      }
+      else
+      {
+        float * p = color32f + 4 * index;
+        for (int k = 0; k < 4; ++k)
+          if (state.color_write[k])
+            p[k] = (a < 1 ? src[k] * a + p[k] * (1 - a) : src[k]);
+      }
+    }
+
+    RasterState const & state;
+    int width, height;
+    int tiles_x, tiles_y;
+    float * depth;
+    bool depth_write;
+    uint8 * color8;
+    float * color32f;
+    int active[Varying::NUM];  // indices of active varyings
+    int num_active;
+
+}; // class DrawContext
+
+// Linearly interpolate between clip-space vertices.
+inline void
+lerp(ClipVertex const & a, ClipVertex const & b, float t, ClipVertex & result)
+{
+  result.position = a.position + t * (b.position - a.position);
+  for (int i = 0; i < Varying::NUM; ++i)
+    result.varyings[i] = a.varyings[i] + t * (b.varyings[i] - a.varyings[i]);
+}
+
+// Signed distance of a clip-space point from each of the six frustum planes (non-negative inside).
+inline float
+planeDistance(Vector4 const & p, int plane)
+{
+  switch (plane)
+  {
+    case 0:  return p.w() + p.x();
+    case 1:  return p.w() - p.x();
+    case 2:  return p.w() + p.y();
+    case 3:  return p.w() - p.y();
+    case 4:  return p.w() + p.z();
+    default: return p.w() - p.z();
+  }
+}
+
+// Bitmask of the frustum planes a clip-space point lies outside.
+inline int
+outcode(Vector4 const & p)
+{
+  int code = 0;
+  for (int i = 0; i < 6; ++i)
+    if (planeDistance(p, i) < 0) code |= (1 << i);
+
+  return code;
+}
+
+// Sets up the primitives in a range of a batch, and bins the results.
+class THEA_SOFTWARE_DLL_LOCAL PrimSetup
+{
+  public:
+    static int const MAX_CLIP_VERTS = 9;
+
+    PrimSetup(DrawContext const & ctx_, int verts_per_prim_, TheaArray<ClipVertex> const & vertices_,
+              TheaArray<uint32> const & indices_, long batch_begin_, long batch_end_, TheaArray< TheaArray<SetupPrim> > & out_)
+    : ctx(ctx_), verts_per_prim(verts_per_prim_), vertices(vertices_), indices(indices_), batch_begin(batch_begin_),
+      batch_end(batch_end_), out(out_)
+    {}
+
+    // Set up the primitives in a chunk.
+    void operator()(long chunk)
+    {
+      TheaArray<SetupPrim> & chunk_out = out[(array_size_t)chunk];
+      chunk_out.clear();
+
+      long begin = batch_begin + chunk * SETUP_CHUNK_SIZE;
+      long end = std::min(begin + SETUP_CHUNK_SIZE, batch_end);
+      for (long i = begin; i < end; ++i)
+      {
+        uint32 const * prim_indices = &indices[(array_size_t)(i * verts_per_prim)];
+        switch (verts_per_prim)
+        {
+          case 1: setupPoint(vertices[prim_indices[0]], chunk_out); break;
+          case 2: setupLine(vertices[prim_indices[0]], vertices[prim_indices[1]], chunk_out); break;
+          default: setupTriangle(vertices[prim_indices[0]], vertices[prim_indices[1]], vertices[prim_indices[2]], chunk_out);
+        }
+      }
+    }
+
+  private:
+    // Map a clip-space position to window coordinates. The depth is mapped to [0, 1].
+    void toWindow(Vector4 const & p, float & x, float & y, float & z, float & inv_w) const
+    {
+      inv_w = 1.0f / p.w();
+      x = (p.x() * inv_w * 0.5f + 0.5f) * ctx.width;
+      y = (p.y() * inv_w * 0.5f + 0.5f) * ctx.height;
+      z = p.z() * inv_w * 0.5f + 0.5f;
+    }
+
+    void setupPoint(ClipVertex const & v, TheaArray<SetupPrim> & prims)
+    {
+      if (outcode(v.position) != 0 || v.position.w() <= 0)
+        return;
+
+      SetupPrim sp;
+      sp.type = 1;
+      float inv_w;
+      toWindow(v.position, sp.x0, sp.y0, sp.z[0], inv_w);
+      sp.inv_w[0] = 1;
+      for (int i = 0; i < Varying::NUM; ++i)
+        sp.vary[i][0] = v.varyings[i];
+
+      float size = (float)ctx.state.point_size;
+      if (size <= 1)
+      {
+        sp.x1 = 1;
+        sp.min_x = sp.max_x = (int)std::floor(sp.x0);
+        sp.min_y = sp.max_y = (int)std::floor(sp.y0);
+      }
+      else
+      {
+        float r = 0.5f * size;
+        sp.x1 = size;
+        sp.min_x = (int)std::ceil(sp.x0 - r - 0.5f);
+        sp.max_x = (int)std::floor(sp.x0 + r - 0.5f);
+        sp.min_y = (int)std::ceil(sp.y0 - r - 0.5f);
+        sp.max_y = (int)std::floor(sp.y0 + r - 0.5f);
+      }
+
+      if (clampBounds(sp))
+        prims.push_back(sp);
+    }
+
+    void setupLine(ClipVertex const & v0, ClipVertex const & v1, TheaArray<SetupPrim> & prims)
+    {
+      int c0 = outcode(v0.position), c1 = outcode(v1.position);
+      if (c0 & c1)
+        return;
+
+      ClipVertex const * p0 = &v0, * p1 = &v1;
+      ClipVertex clipped[2];
+      if (c0 | c1)
+      {
+        // Liang-Barsky clipping against the frustum planes
+        float t0 = 0, t1 = 1;
+        for (int i = 0; i < 6; ++i)
+        {
+          float d0 = planeDistance(v0.position, i), d1 = planeDistance(v1.position, i);
+          if (d0 < 0 && d1 < 0) return;
+          if (d0 < 0)      t0 = std::max(t0, d0 / (d0 - d1));
+          else if (d1 < 0) t1 = std::min(t1, d0 / (d0 - d1));
+        }
+
+        if (t0 >= t1)
+          return;
+
+        lerp(v0, v1, t0, clipped[0]);
+        lerp(v0, v1, t1, clipped[1]);
+        p0 = &clipped[0];
+        p1 = &clipped[1];
+      }
+
+      if (p0->position.w() <= 0 || p1->position.w() <= 0)
+        return;
+
+      SetupPrim sp;
+      sp.type = 2;
+      toWindow(p0->position, sp.x0, sp.y0, sp.z[0], sp.inv_w[0]);
+      toWindow(p1->position, sp.x1, sp.y1, sp.z[1], sp.inv_w[1]);
+      for (int i = 0; i < Varying::NUM; ++i)
+      {
+        sp.vary[i][0] = p0->varyings[i] * sp.inv_w[0];
+        sp.vary[i][1] = p1->varyings[i] * sp.inv_w[1];
+      }
+
+      sp.min_x = (int)std::floor(std::min(sp.x0, sp.x1));
+      sp.max_x = (int)std::floor(std::max(sp.x0, sp.x1));
+      sp.min_y = (int)std::floor(std::min(sp.y0, sp.y1));
+      sp.max_y = (int)std::floor(std::max(sp.y0, sp.y1));
+
+      if (clampBounds(sp))
+        prims.push_back(sp);
+    }
+
+    void setupTriangle(ClipVertex const & v0, ClipVertex const & v1, ClipVertex const & v2, TheaArray<SetupPrim> & prims)
+    {
+      int c0 = outcode(v0.position), c1 = outcode(v1.position), c2 = outcode(v2.position);
+      if (c0 & c1 & c2)
+        return;
+
+      if ((c0 | c1 | c2) == 0)
+      {
+        setupClippedTriangle(v0, v1, v2, prims);
+        return;
+      }
+
+      // Sutherland-Hodgman clipping against the frustum planes, followed by triangulation of the clipped polygon as a fan
+      ClipVertex buf[2][MAX_CLIP_VERTS];
+      int n = 3;
+      buf[0][0] = v0; buf[0][1] = v1; buf[0][2] = v2;
+      int src = 0;
+      int all_codes = c0 | c1 | c2;
+      for (int plane = 0; plane < 6; ++plane)
+      {
+        if (!(all_codes & (1 << plane)))
+          continue;
+
+        ClipVertex const * in = buf[src];
+        ClipVertex * out_verts = buf[1 - src];
+        int m = 0;
+        for (int i = 0; i < n; ++i)
+        {
+          ClipVertex const & a = in[i];
+          ClipVertex const & b = in[(i + 1) % n];
+          float da = planeDistance(a.position, plane), db = planeDistance(b.position, plane);
+          if (da >= 0)
+            out_verts[m++] = a;
+
+          if ((da >= 0) != (db >= 0) && m < MAX_CLIP_VERTS)
+            lerp(a, b, da / (da - db), out_verts[m++]);
+        }
+
+        n = m;
+        src = 1 - src;
+        if (n < 3)
+          return;
+      }
+
+      for (int i = 1; i + 1 < n; ++i)
+        setupClippedTriangle(buf[src][0], buf[src][i], buf[src][i + 1], prims);
+    }
+
+    void setupClippedTriangle(ClipVertex const & v0, ClipVertex const & v1, ClipVertex const & v2,
+                              TheaArray<SetupPrim> & prims)
+    {
+      if (v0.position.w() <= 0 || v1.position.w() <= 0 || v2.position.w() <= 0)
+        return;
+
+      ClipVertex const * v[3] = { &v0, &v1, &v2 };
+      float x[3], y[3], z[3], inv_w[3];
+      int64 fx[3], fy[3];
+      for (int i = 0; i < 3; ++i)
+      {
+        toWindow(v[i]->position, x[i], y[i], z[i], inv_w[i]);
+        fx[i] = (int64)std::floor(x[i] * SUBPIXEL_SCALE + 0.5f);
+        fy[i] = (int64)std::floor(y[i] * SUBPIXEL_SCALE + 0.5f);
+      }
+
+      // Cull by orientation (counter-clockwise is front-facing), and make the triangle counter-clockwise
+      int64 area = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fx[2] - fx[0]) * (fy[1] - fy[0]);
+      if (area == 0
+       || (area > 0 && ctx.state.cull_face == RenderSystem::CullFace::FRONT)
+       || (area < 0 && ctx.state.cull_face == RenderSystem::CullFace::BACK))
+        return;
+
+      if (area < 0)
+      {
+        std::swap(v[1], v[2]);
+        std::swap(x[1], x[2]); std::swap(y[1], y[2]); std::swap(z[1], z[2]); std::swap(inv_w[1], inv_w[2]);
+        std::swap(fx[1], fx[2]); std::swap(fy[1], fy[2]);
+      }
+
+      SetupPrim sp;
+      sp.type = 3;
+
+      // Pixel (px, py) is sampled at subpixel position (S * px + S / 2, S * py + S / 2), where S = SUBPIXEL_SCALE
+      int64 const S = SUBPIXEL_SCALE, H = SUBPIXEL_SCALE / 2;
+      for (int i = 0; i < 3; ++i)
+      {
+        int j = (i + 1) % 3;
+        int64 dx = fx[j] - fx[i], dy = fy[j] - fy[i];
+
+        // E(p) = dx * (p.y - y_i) - dy * (p.x - x_i), positive to the left of the directed edge
+        sp.edge_a[i] = -dy * S;
+        sp.edge_b[i] = dx * S;
+        sp.edge_c[i] = dx * (H - fy[i]) - dy * (H - fx[i]);
+
+        // Top-left fill convention: samples exactly on an edge are covered only by left and top edges
+        bool top_left = (dy < 0 || (dy == 0 && dx < 0));
+        if (!top_left)
+          sp.edge_c[i] -= 1;
+      }
+
+      int64 min_fx = std::min(fx[0], std::min(fx[1], fx[2])), max_fx = std::max(fx[0], std::max(fx[1], fx[2]));
+      int64 min_fy = std::min(fy[0], std::min(fy[1], fy[2])), max_fy = std::max(fy[0], std::max(fy[1], fy[2]));
+      sp.min_x = (int)-floorDiv(-(min_fx - H), S);  // ceil
+      sp.max_x = (int)floorDiv(max_fx - H, S);
+      sp.min_y = (int)-floorDiv(-(min_fy - H), S);
+      sp.max_y = (int)floorDiv(max_fy - H, S);
+      if (!clampBounds(sp))
+        return;
+
+      // Attribute planes, relative to the snapped first vertex
+      double sx[3], sy[3];
+      for (int i = 0; i < 3; ++i)
+      {
+        sx[i] = fx[i] / (double)S;
+        sy[i] = fy[i] / (double)S;
+      }
+
+      double dx1 = sx[1] - sx[0], dy1 = sy[1] - sy[0], dx2 = sx[2] - sx[0], dy2 = sy[2] - sy[0];
+      double inv_det = 1.0 / (dx1 * dy2 - dx2 * dy1);
+      sp.x0 = (float)sx[0];
+      sp.y0 = (float)sy[0];
+
+      computePlane(z[0], z[1], z[2], dx1, dy1, dx2, dy2, inv_det, sp.z);
+      computePlane(inv_w[0], inv_w[1], inv_w[2], dx1, dy1, dx2, dy2, inv_det, sp.inv_w);
+      for (int k = 0; k < ctx.num_active; ++k)
+      {
+        int i = ctx.active[k];
+        computePlane(v[0]->varyings[i] * inv_w[0], v[1]->varyings[i] * inv_w[1], v[2]->varyings[i] * inv_w[2],
+                     dx1, dy1, dx2, dy2, inv_det, sp.vary[i]);
+      }
+
+      if (ctx.state.polygon_offset != 0)
+      {
+        float slope = std::max(std::fabs(sp.z[1]), std::fabs(sp.z[2]));
+        sp.z[0] += (float)ctx.state.polygon_offset * (slope + (float)ctx.state.depth_resolution);
+      }
+
+      prims.push_back(sp);
+    }
+
+    // Compute the value at the first vertex and the x and y derivatives of a linear function over a triangle.
+    static void computePlane(double f0, double f1, double f2, double dx1, double dy1, double dx2, double dy2,
+                             double inv_det, float * plane)
+    {
+      double df1 = f1 - f0, df2 = f2 - f0;
+      plane[0] = (float)f0;
+      plane[1] = (float)((df1 * dy2 - df2 * dy1) * inv_det);
+      plane[2] = (float)((df2 * dx1 - df1 * dx2) * inv_det);
+    }
+
+    // Clamp the bounding box of a primitive to the viewport, returning false if it becomes empty.
+    bool clampBounds(SetupPrim & sp) const
+    {
+      sp.min_x = std::max(sp.min_x, 0);
+      sp.min_y = std::max(sp.min_y, 0);
+      sp.max_x = std::min(sp.max_x, ctx.width - 1);
+      sp.max_y = std::min(sp.max_y, ctx.height - 1);
+      return sp.min_x <= sp.max_x && sp.min_y <= sp.max_y;
+    }
+
+    DrawContext const & ctx;
+    int verts_per_prim;
+    TheaArray<ClipVertex> const & vertices;
+    TheaArray<uint32> const & indices;
+    long batch_begin, batch_end;
+    TheaArray< TheaArray<SetupPrim> > & out;
+
+}; // class PrimSetup
+
+// Rasterizes the primitives binned to each tile.
+class THEA_SOFTWARE_DLL_LOCAL TileRasterizer
+{
+  public:
+    TileRasterizer(DrawContext const & ctx_, TheaArray< TheaArray<SetupPrim const *> > const & bins_,
+                   TheaArray<int> const & active_tiles_)
+    : ctx(ctx_), bins(bins_), active_tiles(active_tiles_)
+    {}
+
+    // Rasterize all primitives overlapping a tile, in order.
+    void operator()(long i)
+    {
+      int tile = active_tiles[(array_size_t)i];
+      int tx0 = (tile % ctx.tiles_x) * TILE_SIZE, ty0 = (tile / ctx.tiles_x) * TILE_SIZE;
+      int tx1 = std::min(tx0 + TILE_SIZE, ctx.width) - 1, ty1 = std::min(ty0 + TILE_SIZE, ctx.height) - 1;
+
+      TheaArray<SetupPrim const *> const & bin = bins[(array_size_t)tile];
+      for (array_size_t j = 0; j < bin.size(); ++j)
+      {
+        SetupPrim const & sp = *bin[j];
+        int x0 = std::max(tx0, sp.min_x), x1 = std::min(tx1, sp.max_x);
+        int y0 = std::max(ty0, sp.min_y), y1 = std::min(ty1, sp.max_y);
+
+        switch (sp.type)
+        {
+          case 1: rasterizePoint(sp, x0, y0, x1, y1); break;
+          case 2: rasterizeLine(sp, x0, y0, x1, y1); break;
+          default: rasterizeTriangle(sp, x0, y0, x1, y1);
+        }
+      }
+    }
+
+  private:
+    void rasterizePoint(SetupPrim const & sp, int x0, int y0, int x1, int y1) const
+    {
+      float r2 = 0.25f * sp.x1 * sp.x1;
+      for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+        {
+          if (sp.x1 > 1)
+          {
+            float dx = x + 0.5f - sp.x0, dy = y + 0.5f - sp.y0;
+            if (dx * dx + dy * dy > r2)
+              continue;
+          }
+
+          long index = (long)y * ctx.width + x;
+          if (!ctx.depthTest(index, Math::clamp(sp.z[0], 0.0f, 1.0f)))
+            continue;
+
+          float v[Varying::NUM];
+          for (int k = 0; k < ctx.num_active; ++k)
+            v[ctx.active[k]] = sp.vary[ctx.active[k]][0];
+
+          ctx.writeColor(index, v);
+        }
+    }
+
+    void rasterizeLine(SetupPrim const & sp, int x0, int y0, int x1, int y1) const
+    {
+      // Step one pixel at a time along the major axis. As in OpenGL, the last pixel is not drawn, so that connected segments
+      // do not overlap.
+      float dx = sp.x1 - sp.x0, dy = sp.y1 - sp.y0;
+      long n = (long)std::ceil(std::max(std::fabs(dx), std::fabs(dy)));
+      if (n <= 0) n = 1;
+
+      for (long i = 0; i < n; ++i)
+      {
+        float t = i / (float)n;
+        int x = (int)std::floor(sp.x0 + t * dx), y = (int)std::floor(sp.y0 + t * dy);
+        if (x < x0 || x > x1 || y < y0 || y > y1)
+          continue;
+
+        long index = (long)y * ctx.width + x;
+        float z = sp.z[0] + t * (sp.z[1] - sp.z[0]);
+        if (!ctx.depthTest(index, Math::clamp(z, 0.0f, 1.0f)))
+          continue;
+
+        float w = 1.0f / (sp.inv_w[0] + t * (sp.inv_w[1] - sp.inv_w[0]));
+        float v[Varying::NUM];
+        for (int k = 0; k < ctx.num_active; ++k)
+        {
+          float const * f = sp.vary[ctx.active[k]];
+          v[ctx.active[k]] = (f[0] + t * (f[1] - f[0])) * w;
+        }
+
+        ctx.writeColor(index, v);
+      }
+    }
+
+    // Depth-test, shade and write a covered pixel of a triangle.
+    void shadeTrianglePixel(SetupPrim const & sp, int x, int y) const
+    {
+      float fx = x + 0.5f - sp.x0, fy = y + 0.5f - sp.y0;
+      long index = (long)y * ctx.width + x;
+      float z = sp.z[0] + fx * sp.z[1] + fy * sp.z[2];
+      if (!ctx.depthTest(index, Math::clamp(z, 0.0f, 1.0f)))
+        return;
+
+      if (!ctx.color8 && !ctx.color32f)
+        return;
+
+      float w = 1.0f / (sp.inv_w[0] + fx * sp.inv_w[1] + fy * sp.inv_w[2]);
+      float v[Varying::NUM];
+      for (int k = 0; k < ctx.num_active; ++k)
+      {
+        float const * f = sp.vary[ctx.active[k]];
+        v[ctx.active[k]] = (f[0] + fx * f[1] + fy * f[2]) * w;
+      }
+
+      ctx.writeColor(index, v);
+    }
+
+    void rasterizeTriangle(SetupPrim const & sp, int x0, int y0, int x1, int y1) const
+    {
+      // Walk the 8x8 blocks overlapping the clipped bounding box. A block lying entirely outside an edge is skipped, edges
+      // the block lies entirely inside are not tested per pixel, and the rest are evaluated for a row of pixels at a time.
+      int64 const B1 = BLOCK_SIZE - 1;
+      int bx_begin = x0 - (x0 % BLOCK_SIZE), by_begin = y0 - (y0 % BLOCK_SIZE);  // tiles are block-aligned
+      for (int by = by_begin; by <= y1; by += BLOCK_SIZE)
+      {
+        for (int bx = bx_begin; bx <= x1; bx += BLOCK_SIZE)
+        {
+          int64 e[3];
+          int partial[3];
+          int num_partial = 0;
+          bool rejected = false;
+          for (int k = 0; k < 3; ++k)
+          {
+            int64 a = sp.edge_a[k], b = sp.edge_b[k];
+            e[k] = a * bx + b * by + sp.edge_c[k];
+            int64 lo = e[k] + std::min((int64)0, a * B1) + std::min((int64)0, b * B1);
+            int64 hi = e[k] + std::max((int64)0, a * B1) + std::max((int64)0, b * B1);
+            if (hi < 0) { rejected = true; break; }
+            if (lo < 0) partial[num_partial++] = k;
+          }
+
+          if (rejected)
+            continue;
+
+          int px0 = std::max(bx, x0), px1 = std::min(bx + BLOCK_SIZE - 1, x1);
+          int py0 = std::max(by, y0), py1 = std::min(by + BLOCK_SIZE - 1, y1);
+
+          if (num_partial == 0)
+          {
+            for (int y = py0; y <= py1; ++y)
+              for (int x = px0; x <= px1; ++x)
+                shadeTrianglePixel(sp, x, y);
+
+            continue;
+          }
+
+          // Within a block straddling an edge, the edge function is bounded by the variation across the block, so it fits
+          // in 32 bits
+          int32 row_e[3], step_a[3], step_b[3];
+          for (int j = 0; j < num_partial; ++j)
+          {
+            int k = partial[j];
+            step_a[j] = (int32)sp.edge_a[k];
+            step_b[j] = (int32)sp.edge_b[k];
+            row_e[j] = (int32)(e[k] + (int64)(py0 - by) * sp.edge_b[k]);
+          }
+
+          unsigned int range_mask = ((1u << (px1 - bx + 1)) - 1) & ~((1u << (px0 - bx)) - 1);
+
+#ifdef THEA_SOFTWARE_RASTERIZER_SSE2
+          __m128i offs_lo[3], offs_hi[3];
+          for (int j = 0; j < num_partial; ++j)
+          {
+            offs_lo[j] = _mm_setr_epi32(0, step_a[j], 2 * step_a[j], 3 * step_a[j]);
+            offs_hi[j] = _mm_add_epi32(offs_lo[j], _mm_set1_epi32(4 * step_a[j]));
+          }
+
+          __m128i const neg_one = _mm_set1_epi32(-1);
+#endif
+
+          for (int y = py0; y <= py1; ++y)
+          {
+            unsigned int mask = range_mask;
+
+#ifdef THEA_SOFTWARE_RASTERIZER_SSE2
+            __m128i m_lo = neg_one, m_hi = neg_one;
+            for (int j = 0; j < num_partial; ++j)
+            {
+              __m128i base = _mm_set1_epi32(row_e[j]);
+              m_lo = _mm_and_si128(m_lo, _mm_cmpgt_epi32(_mm_add_epi32(base, offs_lo[j]), neg_one));
+              m_hi = _mm_and_si128(m_hi, _mm_cmpgt_epi32(_mm_add_epi32(base, offs_hi[j]), neg_one));
+            }
+
+            mask &= (unsigned int)(_mm_movemask_ps(_mm_castsi128_ps(m_lo))
+                                 | (_mm_movemask_ps(_mm_castsi128_ps(m_hi)) << 4));
+#else
+            for (int i = 0; i < BLOCK_SIZE; ++i)
+              for (int j = 0; j < num_partial; ++j)
+                if (row_e[j] + i * step_a[j] < 0)
+                {
+                  mask &= ~(1u << i);
+                  break;
+                }
+#endif
+
+            for (int j = 0; j < num_partial; ++j)
+              row_e[j] += step_b[j];
+
+            for (int i = 0; mask != 0; ++i, mask >>= 1)
+              if (mask & 1)
+                shadeTrianglePixel(sp, bx + i, y);
+          }
+        }
+      }
+    }
+
+    DrawContext const & ctx;
+    TheaArray< TheaArray<SetupPrim const *> > const & bins;
+    TheaArray<int> const & active_tiles;
+
+}; // class TileRasterizer
+
+// Clears a range of rows of the render targets.
+class THEA_SOFTWARE_DLL_LOCAL RowClearer
+{
+  public:
+    RowClearer(RasterState const & state_, bool color_, ColorRGBA const & color_value_, bool depth_, float depth_value_)
+    : state(state_), color(color_), color_value(color_value_), depth(depth_), depth_value(depth_value_) {}
+
+    void operator()(long y)
+    {
+      long begin = y * state.width, end = begin + state.width;
+
+      if (color && state.color_target)
+      {
+        float c[4] = { color_value.r(), color_value.g(), color_value.b(), color_value.a() };
+        if (state.color_target->getStorage() == SoftwareTexture::Storage::RGBA8)
+        {
+          uint8 q[4] = { quantize8(c[0]), quantize8(c[1]), quantize8(c[2]), quantize8(c[3]) };
+          uint8 * p = state.color_target->getData8(state.color_layer);
+          for (long i = begin; i < end; ++i)
+            for (int k = 0; k < 4; ++k)
+              if (state.color_write[k]) p[4 * i + k] = q[k];
+        }
+        else if (state.color_target->getStorage() == SoftwareTexture::Storage::RGBA32F)
+        {
+          float * p = state.color_target->getData32F(state.color_layer);
+          for (long i = begin; i < end; ++i)
+            for (int k = 0; k < 4; ++k)
+              if (state.color_write[k]) p[4 * i + k] = c[k];
+        }
+      }
+
+      if (depth && state.depth_target && state.depth_write)
+      {
+        float * p = state.depth_target->getData32F(state.depth_layer);
+        std::fill(p + begin, p + end, depth_value);
+      }
+    }
+
+  private:
+    RasterState const & state;
+    bool color;
+    ColorRGBA color_value;
+    bool depth;
+    float depth_value;
+
+}; // class RowClearer
+
+} // namespace SoftwareRasterizerInternal
+
+ColorRGBA
+RasterState::shade(float const * v) const
+{
+  float c[4] = { 1, 1, 1, 1 };
+  if (varyings & COLOR_BIT)
+    for (int i = 0; i < 4; ++i) c[i] = v[Varying::COLOR + i];
+
+  if (texture3d && (varyings & POSITION_BIT))
+  {
+    float p[3];
+    for (int i = 0; i < 3; ++i)
+    {
+      float ext = bbox_hi[i] - bbox_lo[i];
+      p[i] = (ext != 0 ? (v[Varying::POSITION + i] - bbox_lo[i]) / ext : 0);
+    }
+
+    ColorRGBA t = texture3d->sample(p[0], p[1], p[2]);
+    c[0] += t.a() * (t.r() - c[0]);
+    c[1] += t.a() * (t.g() - c[1]);
+    c[2] += t.a() * (t.b() - c[2]);
+  }
+
+  switch (shading_model)
+  {
+    case SoftwareShader::ShadingModel::LAMBERT:
+    {
+      float n[3] = { 0, 0, 0 };
+      if (varyings & NORMAL_BIT)
+      {
+        n[0] = v[Varying::NORMAL]; n[1] = v[Varying::NORMAL + 1]; n[2] = v[Varying::NORMAL + 2];
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len > 0) { n[0] /= len; n[1] /= len; n[2] /= len; }
+      }
+
+      float n_dot_l = -(n[0] * light_dir[0] + n[1] * light_dir[1] + n[2] * light_dir[2]);
+      float lamb = (n_dot_l >= -two_sided ? material[1] * std::fabs(n_dot_l) : 0);
+      for (int i = 0; i < 3; ++i)
+        c[i] = material[0] * c[i] * ambient_color[i] + lamb * c[i] * light_color[i];
+
+      break;
+    }
+
+    case SoftwareShader::ShadingModel::MATCAP:
+    {
+      if (texture && (varyings & NORMAL_BIT))
+      {
+        float n[3] = { v[Varying::NORMAL], v[Varying::NORMAL + 1], v[Varying::NORMAL + 2] };
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len > 0) { n[0] /= len; n[1] /= len; n[2] /= len; }
+
+        float s = (two_sided > 0.5f ? (n[2] > 0 ? 1.0f : (n[2] < 0 ? -1.0f : 0.0f)) : 1.0f);
+        ColorRGBA m = texture->sample(0.5f * (s * n[0] + 1), 0.5f * (s * n[1] + 1));
+        c[0] *= m.r(); c[1] *= m.g(); c[2] *= m.b();
+      }
+
+      break;
+    }
+
+    default:
+    {
+      if (texture && (varyings & TEXCOORD_BIT))
+      {
+        ColorRGBA t = texture->sample(v[Varying::TEXCOORD], v[Varying::TEXCOORD + 1], v[Varying::TEXCOORD + 2]);
+        c[0] *= t.r(); c[1] *= t.g(); c[2] *= t.b(); c[3] *= t.a();
+      }
+    }
+  }
+
+  return ColorRGBA(c[0], c[1], c[2], c[3]);
+}
+
+int
+SoftwareRasterizer::numThreads()
+{
+  return (int)System::concurrency();
+}
+
+char const *
+SoftwareRasterizer::simdInstructionSet()
+{
+#ifdef THEA_SOFTWARE_RASTERIZER_SSE2
+  return "SSE2";
+#else
+  return "none";
+#endif
+}
+
+void
+SoftwareRasterizer::draw(RasterState const & state, int verts_per_prim, TheaArray<ClipVertex> const & vertices,
+                         TheaArray<uint32> const & indices)
+{
+  using namespace SoftwareRasterizerInternal;
+
+  alwaysAssertM(verts_per_prim >= 1 && verts_per_prim <= 3, "SoftwareRasterizer: Invalid number of vertices per primitive");
+
+  long num_prims = (long)indices.size() / verts_per_prim;
+  if (num_prims <= 0 || state.width <= 0 || state.height <= 0)
+    return;
+
+  DrawContext ctx(state);
+  if (!ctx.hasTargets())
+    return;
+
+  long num_tiles = (long)ctx.tiles_x * (long)ctx.tiles_y;
+  TheaArray< TheaArray<SetupPrim> > setup_out;
+  TheaArray< TheaArray<SetupPrim const *> > bins((array_size_t)num_tiles);
+  TheaArray<int> active_tiles;
+
+  for (long batch_begin = 0; batch_begin < num_prims; batch_begin += BATCH_SIZE)
+  {
+    long batch_end = std::min(batch_begin + (long)BATCH_SIZE, num_prims);
+    long num_chunks = (batch_end - batch_begin + SETUP_CHUNK_SIZE - 1) / SETUP_CHUNK_SIZE;
+    bool parallel = (batch_end - batch_begin >= MIN_PARALLEL_PRIMS);
+
+    // Clip and set up primitives in parallel, each chunk writing to its own array so that the submission order is preserved
+    if (setup_out.size() < (array_size_t)num_chunks)
+      setup_out.resize((array_size_t)num_chunks);
+
+    PrimSetup setup(ctx, verts_per_prim, vertices, indices, batch_begin, batch_end, setup_out);
+    parallelFor(num_chunks, parallel ? 1 : num_chunks + 1, setup);
+
+    // Bin the primitives into tiles, skipping tiles lying entirely outside an edge of a triangle
+    for (array_size_t i = 0; i < active_tiles.size(); ++i)
+      bins[(array_size_t)active_tiles[i]].clear();
+
+    active_tiles.clear();
+    for (long c = 0; c < num_chunks; ++c)
+    {
+      TheaArray<SetupPrim> const & chunk_out = setup_out[(array_size_t)c];
+      for (array_size_t j = 0; j < chunk_out.size(); ++j)
+      {
+        SetupPrim const & sp = chunk_out[j];
+        int tx0 = sp.min_x / TILE_SIZE, tx1 = sp.max_x / TILE_SIZE;
+        int ty0 = sp.min_y / TILE_SIZE, ty1 = sp.max_y / TILE_SIZE;
+        for (int ty = ty0; ty <= ty1; ++ty)
+          for (int tx = tx0; tx <= tx1; ++tx)
+          {
+            if (sp.type == 3 && (tx0 != tx1 || ty0 != ty1))
+            {
+              int64 px0 = tx * TILE_SIZE, px1 = px0 + TILE_SIZE - 1, py0 = ty * TILE_SIZE, py1 = py0 + TILE_SIZE - 1;
+              bool outside = false;
+              for (int k = 0; k < 3 && !outside; ++k)
+              {
+                int64 a = sp.edge_a[k], b = sp.edge_b[k];
+                outside = (std::max(a * px0, a * px1) + std::max(b * py0, b * py1) + sp.edge_c[k] < 0);
+              }
+
+              if (outside)
+                continue;
+            }
+
+            TheaArray<SetupPrim const *> & bin = bins[(array_size_t)(ty * ctx.tiles_x + tx)];
+            if (bin.empty())
+              active_tiles.push_back(ty * ctx.tiles_x + tx);
+
+            bin.push_back(&sp);
+          }
+      }
+    }
+
+    // Rasterize the tiles in parallel. Each tile is owned by a single thread, so no pixel is touched concurrently.
+    TileRasterizer raster(ctx, bins, active_tiles);
+    long num_active = (long)active_tiles.size();
+    parallelFor(num_active, parallel ? (long)MIN_TILES_PER_THREAD : num_active + 1, raster);
+  }
+}
+
+void
+SoftwareRasterizer::clear(RasterState const & state, bool color, ColorRGBA const & color_value, bool depth, Real depth_value)
+{
+  using namespace SoftwareRasterizerInternal;
+
+  if (state.width <= 0 || state.height <= 0)
+    return;
+
+  // Clearing is limited by memory bandwidth, so only large render targets are worth splitting across threads
+  RowClearer clearer(state, color, color_value, depth, Math::clamp((float)depth_value, 0.0f, 1.0f));
+  parallelFor(state.height, std::max((long)MIN_CLEAR_PIXELS_PER_THREAD / state.width, 1L), clearer);
+}
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
@@ -0,0 +1,167 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#ifndef __Thea_Graphics_Software_SoftwareRasterizer_hpp__
+#define __Thea_Graphics_Software_SoftwareRasterizer_hpp__
+
+#include "../../Graphics/RenderSystem.hpp"
+#include "../../Array.hpp"
+#include "../../Colors.hpp"
+#include "../../ParallelFor.hpp"
+#include "SoftwareCommon.hpp"
+#include "SoftwareShader.hpp"
+#include "SoftwareTexture.hpp"
+#include <algorithm>
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+/** Offsets of the per-vertex attributes (varyings) that are interpolated across primitives. */
+struct THEA_SOFTWARE_DLL_LOCAL Varying
+{
+  static int const COLOR     =   0;  ///< RGBA color (4 values).
+  static int const NORMAL    =   4;  ///< Normal in camera space (3 values).
+  static int const POSITION  =   7;  ///< Position in object space (3 values).
+  static int const TEXCOORD  =  10;  ///< Texture coordinate for texture unit 0 (3 values).
+  static int const NUM       =  13;  ///< Total number of values.
+
+}; // struct Varying
+
+/** A vertex transformed to clip space, with its varyings. */
+struct THEA_SOFTWARE_DLL_LOCAL ClipVertex
+{
+  Vector4 position;             ///< Homogeneous position in clip space.
+  float varyings[Varying::NUM];  ///< Values of varyings at the vertex.
+
+}; // struct ClipVertex
+
+/** The state required to rasterize and shade a set of primitives, captured when the primitives are drawn. */
+struct THEA_SOFTWARE_DLL_LOCAL RasterState
+{
+  /** Bits of the mask of active varyings. */
+  enum VaryingBits
+  {
+    COLOR_BIT     =  0x01,  ///< The color is interpolated.
+    NORMAL_BIT    =  0x02,  ///< The normal is interpolated.
+    POSITION_BIT  =  0x04,  ///< The object-space position is interpolated.
+    TEXCOORD_BIT  =  0x08   ///< The texture coordinate is interpolated.
+  };
+
+  SoftwareTexture * color_target;         ///< Color buffer, if any.
+  int color_layer;                        ///< Layer of the color buffer that is drawn to.
+  SoftwareTexture * depth_target;         ///< Depth buffer, if any.
+  int depth_layer;                        ///< Layer of the depth buffer that is drawn to.
+  int width;                              ///< Width of the viewport in pixels.
+  int height;                             ///< Height of the viewport in pixels.
+
+  RenderSystem::DepthTest depth_test;     ///< Depth test.
+  bool depth_write;                       ///< Write depth values?
+  bool color_write[4];                    ///< Write to the red, green, blue and alpha channels?
+  RenderSystem::CullFace cull_face;       ///< Faces to cull.
+  Real polygon_offset;                    ///< Polygon offset factor and units (zero if disabled).
+  Real depth_resolution;                  ///< Smallest resolvable depth difference, for polygon offsets.
+  Real point_size;                        ///< Diameter of points in pixels.
+
+  int varyings;                           ///< Mask of active varyings (combination of VaryingBits).
+  SoftwareShader::ShadingModel shading_model;  ///< Fragment shading model.
+  SoftwareTexture const * texture;        ///< Texture modulating the color (matcap or texture unit 0), if any.
+  SoftwareTexture const * texture3d;      ///< 3D texture blended with the color, if any.
+  float two_sided;                        ///< Light back faces?
+  float light_dir[3];                     ///< Normalized camera-space light direction.
+  float light_color[3];                   ///< Light color.
+  float ambient_color[3];                 ///< Ambient color.
+  float material[4];                      ///< Ambient and Lambertian coefficients.
+  float bbox_lo[3];                       ///< Low corner of the box mapped to the unit cube for 3D texturing.
+  float bbox_hi[3];                       ///< High corner of the box mapped to the unit cube for 3D texturing.
+
+  /** Shade a fragment with the given (perspective-corrected) varyings. Threadsafe. */
+  ColorRGBA shade(float const * v) const;
+
+}; // struct RasterState
+
+/**
+ * A tiled, multi-threaded scan converter for points, lines and triangles. Primitives are clipped in homogeneous space, set up
+ * in parallel, binned into square screen tiles, and each tile is then rasterized by a single thread, so primitives always
+ * update a pixel in the order they were submitted. Triangles are scan converted with exact fixed-point edge functions
+ * (evaluated with SIMD instructions where available) over 8x8 pixel blocks, which are trivially accepted or rejected when
+ * possible. Attributes are interpolated with perspective correction, and the depth test precedes shading.
+ */
+class THEA_SOFTWARE_DLL_LOCAL SoftwareRasterizer
+{
+  public:
+    /**
+     * Draw a set of primitives.
+     *
+     * @param state The rasterization and shading state.
+     * @param verts_per_prim 1 for points, 2 for lines and 3 for triangles.
+     * @param vertices The vertices of the primitives, in clip space.
+     * @param indices Each consecutive block of \a verts_per_prim indices into \a vertices defines a primitive.
+     */
+    static void draw(RasterState const & state, int verts_per_prim, TheaArray<ClipVertex> const & vertices,
+                     TheaArray<uint32> const & indices);
+
+    /** Clear the buffers of a render target, respecting the color and depth write masks in \a state. */
+    static void clear(RasterState const & state, bool color, ColorRGBA const & color_value, bool depth, Real depth_value);
+
+    /** Get the number of threads used for rendering. */
+    static int numThreads();
+
+    /** Get the name of the SIMD instruction set used to scan convert triangles, or "none". */
+    static char const * simdInstructionSet();
+
+    /**
+     * Run a task on each index in [0, num_tasks), in parallel, using only as many threads as can be given at least
+     * \a min_tasks_per_thread tasks each. See Thea::parallelFor().
+     */
+    template <typename TaskT> static void parallelFor(long num_tasks, long min_tasks_per_thread, TaskT const & task)
+    {
+      Thea::parallelFor(num_tasks, task, -1, numThreadsForWork(num_tasks, min_tasks_per_thread, numThreads()));
+    }
+
+}; // class SoftwareRasterizer
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
+
+#endif
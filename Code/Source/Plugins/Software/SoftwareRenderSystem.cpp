@@ -0,0 +1,1352 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#include "SoftwareRenderSystem.hpp"
+#include "SoftwareTexture.hpp"
+#include "SoftwareVARArea.hpp"
+#include <cmath>
+#include <sstream>
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+// Convert a sequence of vertex indices describing primitives of the given type to a list of points, line segments or
+// triangles. Returns the number of vertices per primitive in the list.
+static int
+SoftwareRenderSystem__assemblePrimitives(RenderSystem::Primitive primitive, TheaArray<uint32> const & v,
+                                         TheaArray<uint32> & prims)
+{
+  array_size_t n = v.size();
+  prims.clear();
+
+  switch (primitive)
+  {
+    case RenderSystem::Primitive::POINTS:
+      prims = v;
+      return 1;
+
+    case RenderSystem::Primitive::LINES:
+      prims.assign(v.begin(), v.begin() + (n - n % 2));
+      return 2;
+
+    case RenderSystem::Primitive::LINE_STRIP:
+    case RenderSystem::Primitive::LINE_LOOP:
+      for (array_size_t i = 0; i + 1 < n; ++i)
+      { prims.push_back(v[i]); prims.push_back(v[i + 1]); }
+
+      if (primitive == RenderSystem::Primitive::LINE_LOOP && n > 2)
+      { prims.push_back(v[n - 1]); prims.push_back(v[0]); }
+
+      return 2;
+
+    case RenderSystem::Primitive::TRIANGLES:
+      prims.assign(v.begin(), v.begin() + (n - n % 3));
+      return 3;
+
+    case RenderSystem::Primitive::TRIANGLE_STRIP:
+      for (array_size_t i = 0; i + 2 < n; ++i)
+      {
+        // Alternate triangles are reversed to preserve the orientation
+        if (i % 2 == 0) { prims.push_back(v[i]);     prims.push_back(v[i + 1]); }
+        else            { prims.push_back(v[i + 1]); prims.push_back(v[i]);     }
+
+        prims.push_back(v[i + 2]);
+      }
+
+      return 3;
+
+    case RenderSystem::Primitive::TRIANGLE_FAN:
+    case RenderSystem::Primitive::POLYGON:
+      for (array_size_t i = 1; i + 1 < n; ++i)
+      { prims.push_back(v[0]); prims.push_back(v[i]); prims.push_back(v[i + 1]); }
+
+      return 3;
+
+    case RenderSystem::Primitive::QUADS:
+      for (array_size_t i = 0; i + 3 < n; i += 4)
+      {
+        prims.push_back(v[i]); prims.push_back(v[i + 1]); prims.push_back(v[i + 2]);
+        prims.push_back(v[i]); prims.push_back(v[i + 2]); prims.push_back(v[i + 3]);
+      }
+
+      return 3;
+
+    case RenderSystem::Primitive::QUAD_STRIP:
+      for (array_size_t i = 0; i + 3 < n; i += 2)
+      {
+        prims.push_back(v[i]); prims.push_back(v[i + 1]); prims.push_back(v[i + 3]);
+        prims.push_back(v[i]); prims.push_back(v[i + 3]); prims.push_back(v[i + 2]);
+      }
+
+      return 3;
+  }
+
+  throw Error("SoftwareRenderSystem: Unknown primitive");
+}
+
+/** Transforms the vertices of the current arrays to clip space. */
+class SoftwareRenderSystem::VertexTransformer
+{
+  public:
+    /** Constructor. */
+    VertexTransformer(SoftwareRenderSystem const * render_system_, TheaArray<ClipVertex> & out_)
+    : render_system(render_system_), buffers(render_system_->current_buffer_state), out(out_) {}
+
+    /** Transform the vertex with index \a i. */
+    void operator()(long i)
+    {
+      float p[4] = { 0, 0, 0, 1 };
+      buffers.vertex_var.getElement(i, p, false);
+
+      ColorRGBA color = render_system->color_flags.color;
+      if (buffers.color_var.isValid() && i < buffers.color_var.numElements())
+      {
+        float c[4] = { 1, 1, 1, 1 };
+        buffers.color_var.getElement(i, c, true);
+        color = ColorRGBA(c[0], c[1], c[2], c[3]);
+      }
+
+      Vector3 normal = render_system->color_flags.normal;
+      if (buffers.normal_var.isValid() && i < buffers.normal_var.numElements())
+      {
+        float n[3] = { 0, 0, 1 };
+        buffers.normal_var.getElement(i, n, false);
+        normal = Vector3(n[0], n[1], n[2]);
+      }
+
+      Vector3 texcoord = render_system->color_flags.texcoord;
+      if (buffers.texcoord_var.isValid() && i < buffers.texcoord_var.numElements())
+      {
+        float t[3] = { 0, 0, 0 };
+        buffers.texcoord_var.getElement(i, t, false);
+        texcoord = Vector3(t[0], t[1], t[2]);
+      }
+
+      render_system->transformVertex(Vector4(p[0], p[1], p[2], p[3]), color, normal, texcoord, out[(array_size_t)i]);
+    }
+
+  private:
+    SoftwareRenderSystem const * render_system;
+    BufferState const & buffers;
+    TheaArray<ClipVertex> & out;
+
+}; // class SoftwareRenderSystem::VertexTransformer
+
+SoftwareRenderSystem::SoftwareRenderSystem(char const * name_)
+: name(name_), current_framebuffer(NULL), current_shader(NULL), matrix_mode(MatrixMode::MODELVIEW), transforms_valid(false),
+  transformed_valid(false), immediate_primitive(Primitive::POINTS)
+{
+  for (int i = 0; i < 4; ++i) color_flags.write[i] = true;
+  color_flags.clear_value = ColorRGBA(0, 0, 0, 0);
+  color_flags.color = ColorRGBA(1, 1, 1, 1);
+  color_flags.normal = Vector3(0, 0, 1);
+  color_flags.texcoord = Vector3(0, 0, 0);
+
+  depth_flags.write = true;
+  depth_flags.clear_value = 1;
+  depth_flags.test = DepthTest::LESS;
+
+  stencil_flags.write = 0xFFFFFFFF;
+  stencil_flags.clear_value = 0;
+
+  shape_flags.cull = CullFace::NONE;
+  shape_flags.polygon_offset_enabled = false;
+  shape_flags.polygon_offset = 0;
+  shape_flags.point_size = 1;
+
+  for (int i = 0; i < 4; ++i)
+    matrices[i] = Matrix4::identity();
+}
+
+SoftwareRenderSystem::~SoftwareRenderSystem()
+{
+  for (FramebufferSet::const_iterator fi = created_framebuffers.begin(); fi != created_framebuffers.end(); ++fi)
+    delete *fi;
+
+  created_framebuffers.clear();
+
+  for (TextureSet::const_iterator ti = created_textures.begin(); ti != created_textures.end(); ++ti)
+    delete *ti;
+
+  created_textures.clear();
+
+  for (ShaderSet::const_iterator si = created_shaders.begin(); si != created_shaders.end(); ++si)
+    delete *si;
+
+  created_shaders.clear();
+
+  for (VARAreaSet::const_iterator vi = created_varareas.begin(); vi != created_varareas.end(); ++vi)
+    delete *vi;
+
+  created_varareas.clear();
+}
+
+char const *
+SoftwareRenderSystem::describeSystem() const
+{
+  std::ostringstream os;
+  os << "Software rasterizer {\n"
+     << "  Threads              =  " << SoftwareRasterizer::numThreads() << '\n'
+     << "  SIMD                 =  " << SoftwareRasterizer::simdInstructionSet() << '\n'
+     << "  Texture units        =  " << MAX_TEXTURE_UNITS << '\n'
+     << "}" << std::endl;
+
+  desc = os.str();
+  return desc.c_str();
+}
+
+Framebuffer *
+SoftwareRenderSystem::createFramebuffer(char const * name_)
+{
+  SoftwareFramebuffer * fb = new SoftwareFramebuffer(this, name_);
+  if (fb)
+    created_framebuffers.insert(fb);
+
+  return fb;
+}
+
+void
+SoftwareRenderSystem::destroyFramebuffer(Framebuffer * framebuffer)
+{
+  if (!framebuffer)
+    return;
+
+  if (created_framebuffers.erase(dynamic_cast<SoftwareFramebuffer *>(framebuffer)) < 1)
+  {
+    THEA_ERROR << getName() << ": Attempting to destroy framebuffer '" << framebuffer->getName()
+               << "' which was not created using this rendersystem";
+    return;
+  }
+
+  if (current_framebuffer == framebuffer)
+    current_framebuffer = NULL;
+
+  delete framebuffer;
+}
+
+Shader *
+SoftwareRenderSystem::createShader(char const * name_)
+{
+  SoftwareShader * shader = new SoftwareShader(this, name_);
+  if (shader)
+    created_shaders.insert(shader);
+
+  return shader;
+}
+
+void
+SoftwareRenderSystem::destroyShader(Shader * shader)
+{
+  if (!shader)
+    return;
+
+  if (created_shaders.erase(dynamic_cast<SoftwareShader *>(shader)) < 1)
+  {
+    THEA_ERROR << getName() << ": Attempting to destroy shader '" << shader->getName()
+               << "' which was not created using this rendersystem";
+    return;
+  }
+
+  if (current_shader == shader)
+    current_shader = NULL;
+
+  delete shader;
+}
+
+Texture *
+SoftwareRenderSystem::createTexture(char const * name_, int width, int height, int depth,
+                                    Texture::Format const * desired_format, Texture::Dimension dimension,
+                                    Texture::Options const & options)
+{
+  SoftwareTexture * tex = new SoftwareTexture(this, name_, width, height, depth, desired_format, dimension, options);
+  if (tex)
+    created_textures.insert(tex);
+
+  return tex;
+}
+
+Texture *
+SoftwareRenderSystem::createTexture(char const * name_, AbstractImage const & image, Texture::Format const * desired_format,
+                                    Texture::Dimension dimension, Texture::Options const & options)
+{
+  SoftwareTexture * tex = new SoftwareTexture(this, name_, image, desired_format, dimension, options);
+  if (tex)
+    created_textures.insert(tex);
+
+  return tex;
+}
+
+Texture *
+SoftwareRenderSystem::createTexture(char const * name_, AbstractImage const * images[6],
+                                    Texture::Format const * desired_format, Texture::Options const & options)
+{
+  SoftwareTexture * tex = new SoftwareTexture(this, name_, images, desired_format, options);
+  if (tex)
+    created_textures.insert(tex);
+
+  return tex;
+}
+
+void
+SoftwareRenderSystem::destroyTexture(Texture * texture)
+{
+  if (!texture)
+    return;
+
+  if (created_textures.erase(dynamic_cast<SoftwareTexture *>(texture)) < 1)
+  {
+    THEA_ERROR << getName() << ": Attempting to destroy texture '" << texture->getName()
+               << "' which was not created using this rendersystem";
+    return;
+  }
+
+  for (int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+    if (current_textures.units[i] == texture)
+      current_textures.units[i] = NULL;
+
+  delete texture;
+}
+
+VARArea *
+SoftwareRenderSystem::createVARArea(char const * name_, long num_bytes, VARArea::Usage usage, bool gpu_memory)
+{
+  SoftwareVARArea * vararea = new SoftwareVARArea(this, name_, num_bytes, usage, gpu_memory);
+  if (vararea)
+    created_varareas.insert(vararea);
+
+  return vararea;
+}
+
+void
+SoftwareRenderSystem::destroyVARArea(VARArea * area)
+{
+  if (!area)
+    return;
+
+  if (created_varareas.erase(dynamic_cast<SoftwareVARArea *>(area)) < 1)
+  {
+    THEA_ERROR << getName() << ": Attempting to destroy VAR area '" << area->getName()
+               << "' which was not created using this rendersystem";
+    return;
+  }
+
+  invalidateTransformedVertices();
+  delete area;
+}
+
+void
+SoftwareRenderSystem::pushFramebuffer()
+{
+  framebuffer_stack.push(current_framebuffer);
+}
+
+void
+SoftwareRenderSystem::setFramebuffer(Framebuffer * framebuffer)
+{
+  if (framebuffer)
+  {
+    SoftwareFramebuffer * swfb = dynamic_cast<SoftwareFramebuffer *>(framebuffer);
+    debugAssertM(swfb, std::string(getName()) + ": Attempt to use a non-software framebuffer with a software rendersystem");
+
+    current_framebuffer = swfb;
+  }
+  else
+    current_framebuffer = NULL;
+}
+
+Framebuffer const *
+SoftwareRenderSystem::getFramebuffer() const
+{
+  return current_framebuffer;
+}
+
+Framebuffer *
+SoftwareRenderSystem::getFramebuffer()
+{
+  return current_framebuffer;
+}
+
+void
+SoftwareRenderSystem::popFramebuffer()
+{
+  alwaysAssertM(!framebuffer_stack.empty(), std::string(getName()) + ": No framebuffer to pop");
+
+  current_framebuffer = framebuffer_stack.top();
+  framebuffer_stack.pop();
+}
+
+void
+SoftwareRenderSystem::pushShader()
+{
+  shader_stack.push(current_shader);
+  pushTextures();  // for consistency with the OpenGL rendersystem
+}
+
+void
+SoftwareRenderSystem::setShader(Shader * shader)
+{
+  if (shader)
+  {
+    SoftwareShader * swshader = dynamic_cast<SoftwareShader *>(shader);
+    debugAssertM(swshader, std::string(getName()) + ": Attempt to use a non-software shader with a software rendersystem");
+
+    current_shader = swshader;
+  }
+  else
+    current_shader = NULL;
+}
+
+Shader const *
+SoftwareRenderSystem::getShader() const
+{
+  return current_shader;
+}
+
+Shader *
+SoftwareRenderSystem::getShader()
+{
+  return current_shader;
+}
+
+void
+SoftwareRenderSystem::popShader()
+{
+  debugAssertM(!shader_stack.empty(), std::string(getName()) + ": push/popShader calls not matched");
+
+  popTextures();
+
+  current_shader = shader_stack.top();
+  shader_stack.pop();
+}
+
+void
+SoftwareRenderSystem::pushTextures()
+{
+  texture_stack.push(current_textures);
+}
+
+void
+SoftwareRenderSystem::setTexture(int texunit, Texture * texture)
+{
+  if (texunit < 0 || texunit >= MAX_TEXTURE_UNITS)
+    throw Error(std::string(getName()) + ": Texture unit out of range");
+
+  if (texture)
+  {
+    SoftwareTexture * swtex = dynamic_cast<SoftwareTexture *>(texture);
+    debugAssertM(swtex, std::string(getName()) + ": Attempt to use a non-software texture with a software rendersystem");
+
+    current_textures.units[texunit] = swtex;
+  }
+  else
+    current_textures.units[texunit] = NULL;
+}
+
+void
+SoftwareRenderSystem::popTextures()
+{
+  debugAssertM(!texture_stack.empty(), std::string(getName()) + ": push/popTextures calls not matched");
+
+  current_textures = texture_stack.top();
+  texture_stack.pop();
+}
+
+RenderSystem::MatrixMode
+SoftwareRenderSystem::getMatrixMode() const
+{
+  return matrix_mode;
+}
+
+void
+SoftwareRenderSystem::setMatrixMode(MatrixMode mode)
+{
+  matrix_mode = mode;
+}
+
+void
+SoftwareRenderSystem::pushMatrix()
+{
+  matrix_stacks[matrix_mode].push(matrices[matrix_mode]);
+}
+
+void
+SoftwareRenderSystem::pushViewMatrices()
+{
+  matrix_stacks[MatrixMode::MODELVIEW].push(matrices[MatrixMode::MODELVIEW]);
+  matrix_stacks[MatrixMode::PROJECTION].push(matrices[MatrixMode::PROJECTION]);
+}
+
+Matrix4
+SoftwareRenderSystem::getMatrix(MatrixMode mode) const
+{
+  return matrices[mode];
+}
+
+void
+SoftwareRenderSystem::setMatrix(Matrix4 const & m)
+{
+  matrices[matrix_mode] = m;
+  transforms_valid = false;
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::setIdentityMatrix()
+{
+  setMatrix(Matrix4::identity());
+}
+
+void
+SoftwareRenderSystem::multMatrix(Matrix4 const & m)
+{
+  setMatrix(matrices[matrix_mode] * m);
+}
+
+void
+SoftwareRenderSystem::popMatrix()
+{
+  alwaysAssertM(!matrix_stacks[matrix_mode].empty(), std::string(getName()) + ": push/popMatrix calls not matched");
+
+  setMatrix(matrix_stacks[matrix_mode].top());
+  matrix_stacks[matrix_mode].pop();
+}
+
+void
+SoftwareRenderSystem::popViewMatrices()
+{
+  alwaysAssertM(!matrix_stacks[MatrixMode::MODELVIEW].empty() && !matrix_stacks[MatrixMode::PROJECTION].empty(),
+                std::string(getName()) + ": push/popViewMatrices calls not matched");
+
+  matrices[MatrixMode::PROJECTION] = matrix_stacks[MatrixMode::PROJECTION].top();
+  matrix_stacks[MatrixMode::PROJECTION].pop();
+
+  matrices[MatrixMode::MODELVIEW] = matrix_stacks[MatrixMode::MODELVIEW].top();
+  matrix_stacks[MatrixMode::MODELVIEW].pop();
+
+  transforms_valid = false;
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::beginIndexedPrimitives()
+{
+  buffer_stack.push(current_buffer_state);
+  current_buffer_state = BufferState();
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::setVertexAreaFromVAR(SoftwareVAR const & v)
+{
+  alwaysAssertM(!current_buffer_state.vertex_area || (v.getArea() == current_buffer_state.vertex_area),
+                std::string(getName())
+              + ": All vertex arrays used within a single begin/endIndexedPrimitives block must share the same VARArea");
+
+  current_buffer_state.vertex_area = v.getArea();
+}
+
+void
+SoftwareRenderSystem::setIndexAreaFromVAR(SoftwareVAR const & v)
+{
+  alwaysAssertM(!current_buffer_state.index_area || (v.getArea() == current_buffer_state.index_area),
+                std::string(getName())
+              + ": All index arrays used within a single begin/endIndexedPrimitives block must share the same VARArea");
+
+  current_buffer_state.index_area = v.getArea();
+}
+
+void
+SoftwareRenderSystem::setVertexArray(VAR const * vertices)
+{
+  if (vertices)
+  {
+    assert(vertices->isValid());
+
+    SoftwareVAR const & v = dynamic_cast<SoftwareVAR const &>(*vertices);
+    assert(v.getComponentType() == SoftwareVAR::ComponentType::FLOAT32);
+
+    setVertexAreaFromVAR(v);
+    current_buffer_state.vertex_var = v;
+  }
+  else
+    current_buffer_state.vertex_var = SoftwareVAR();  // an invalid buffer
+
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::setColorArray(VAR const * colors)
+{
+  if (colors)
+  {
+    assert(colors->isValid());
+
+    SoftwareVAR const & v = dynamic_cast<SoftwareVAR const &>(*colors);
+    assert(v.getNumComponents() == 3 || v.getNumComponents() == 4);
+
+    setVertexAreaFromVAR(v);
+    current_buffer_state.color_var = v;
+  }
+  else
+    current_buffer_state.color_var = SoftwareVAR();
+
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::setTexCoordArray(int texunit, VAR const * texcoords)
+{
+  if (texunit < 0 || texunit >= MAX_TEXTURE_UNITS)
+    throw Error(std::string(getName()) + ": Texture unit out of range");
+
+  // Only the coordinates of texture unit 0 are used by the built-in shading models
+  if (texunit != 0)
+    return;
+
+  if (texcoords)
+  {
+    assert(texcoords->isValid());
+
+    SoftwareVAR const & v = dynamic_cast<SoftwareVAR const &>(*texcoords);
+    assert(v.getComponentType() == SoftwareVAR::ComponentType::FLOAT32);
+
+    setVertexAreaFromVAR(v);
+    current_buffer_state.texcoord_var = v;
+  }
+  else
+    current_buffer_state.texcoord_var = SoftwareVAR();
+
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::setNormalArray(VAR const * normals)
+{
+  if (normals)
+  {
+    assert(normals->isValid());
+
+    SoftwareVAR const & v = dynamic_cast<SoftwareVAR const &>(*normals);
+    assert(v.getNumComponents() == 3);
+    assert(v.getComponentType() == SoftwareVAR::ComponentType::FLOAT32);
+
+    setVertexAreaFromVAR(v);
+    current_buffer_state.normal_var = v;
+  }
+  else
+    current_buffer_state.normal_var = SoftwareVAR();
+
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::setIndexArray(VAR const * indices)
+{
+  if (indices)
+  {
+    assert(indices->isValid());
+
+    SoftwareVAR const & v = dynamic_cast<SoftwareVAR const &>(*indices);
+    assert(v.getNumComponents() == 1);
+
+    setIndexAreaFromVAR(v);
+    current_buffer_state.index_var = v;
+  }
+  else
+    current_buffer_state.index_var = SoftwareVAR();  // an invalid buffer
+}
+
+void
+SoftwareRenderSystem::endIndexedPrimitives()
+{
+  debugAssertM(!buffer_stack.empty(), std::string(getName()) + ": begin/endIndexedPrimitives calls not matched");
+
+  current_buffer_state = buffer_stack.top();
+  buffer_stack.pop();
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::updateTransforms() const
+{
+  if (transforms_valid)
+    return;
+
+  Matrix4 const & mv = matrices[MatrixMode::MODELVIEW];
+  mvp = matrices[MatrixMode::PROJECTION] * mv;
+
+  normal_matrix = mv.upper3x3();
+  if (!normal_matrix.invert())
+    normal_matrix = Matrix3::identity();
+
+  normal_matrix = normal_matrix.transpose();
+  transforms_valid = true;
+}
+
+void
+SoftwareRenderSystem::transformVertex(Vector4 const & position, ColorRGBA const & color, Vector3 const & normal,
+                                      Vector3 const & texcoord, ClipVertex & result) const
+{
+  result.position = mvp * position;
+
+  float * v = result.varyings;
+  v[Varying::COLOR] = color.r(); v[Varying::COLOR + 1] = color.g(); v[Varying::COLOR + 2] = color.b();
+  v[Varying::COLOR + 3] = color.a();
+
+  Vector3 n = normal_matrix * normal;
+  v[Varying::NORMAL] = n.x(); v[Varying::NORMAL + 1] = n.y(); v[Varying::NORMAL + 2] = n.z();
+
+  v[Varying::POSITION] = position.x(); v[Varying::POSITION + 1] = position.y(); v[Varying::POSITION + 2] = position.z();
+
+  Vector4 t = matrices[MatrixMode::TEXTURE] * Vector4(texcoord, 1);
+  Real t_scale = (t.w() != 0 ? 1 / t.w() : 1);
+  v[Varying::TEXCOORD] = t.x() * t_scale; v[Varying::TEXCOORD + 1] = t.y() * t_scale;
+  v[Varying::TEXCOORD + 2] = t.z() * t_scale;
+}
+
+void
+SoftwareRenderSystem::transformVertexArrays()
+{
+  if (transformed_valid)
+    return;
+
+  updateTransforms();
+
+  long num_vertices = current_buffer_state.vertex_var.isValid() ? current_buffer_state.vertex_var.numElements() : 0;
+  transformed_vertices.resize((array_size_t)num_vertices);
+
+  VertexTransformer transformer(this, transformed_vertices);
+  SoftwareRasterizer::parallelFor(num_vertices, 4096, transformer);
+
+  transformed_valid = true;
+}
+
+template <typename IndexT>
+void
+SoftwareRenderSystem::drawIndexed(Primitive primitive, long num_indices, IndexT const * indices)
+{
+  if (num_indices <= 0 || !current_buffer_state.vertex_var.isValid())
+    return;
+
+  transformVertexArrays();
+
+  uint32 num_vertices = (uint32)transformed_vertices.size();
+  vertex_indices.resize((array_size_t)num_indices);
+  for (long i = 0; i < num_indices; ++i)
+  {
+    uint32 index = (uint32)indices[i];
+    alwaysAssertM(index < num_vertices, std::string(getName()) + ": Vertex index out of range");
+    vertex_indices[(array_size_t)i] = index;
+  }
+
+  drawPrimitives(primitive, transformed_vertices, vertex_indices);
+}
+
+void
+SoftwareRenderSystem::sendIndices(Primitive primitive, long num_indices, uint8 const * indices)
+{
+  drawIndexed(primitive, num_indices, indices);
+}
+
+void
+SoftwareRenderSystem::sendIndices(Primitive primitive, long num_indices, uint16 const * indices)
+{
+  drawIndexed(primitive, num_indices, indices);
+}
+
+void
+SoftwareRenderSystem::sendIndices(Primitive primitive, long num_indices, uint32 const * indices)
+{
+  drawIndexed(primitive, num_indices, indices);
+}
+
+void
+SoftwareRenderSystem::sendSequentialIndices(Primitive primitive, int first_index, int num_indices)
+{
+  if (num_indices <= 0 || !current_buffer_state.vertex_var.isValid())
+    return;
+
+  transformVertexArrays();
+
+  alwaysAssertM(first_index >= 0 && first_index + num_indices <= (long)transformed_vertices.size(),
+                std::string(getName()) + ": Vertex index out of range");
+
+  vertex_indices.resize((array_size_t)num_indices);
+  for (int i = 0; i < num_indices; ++i)
+    vertex_indices[(array_size_t)i] = (uint32)(first_index + i);
+
+  drawPrimitives(primitive, transformed_vertices, vertex_indices);
+}
+
+void
+SoftwareRenderSystem::sendIndicesFromArray(Primitive primitive, long offset, long num_indices)
+{
+  SoftwareVAR const & index_var = current_buffer_state.index_var;
+  alwaysAssertM(index_var.isValid(), std::string(getName()) + ": No valid index array set");
+
+  uint8 const * ptr = static_cast<uint8 const *>(index_var.getBasePointer()) + offset * index_var.getElementSize();
+  switch (index_var.getComponentType())
+  {
+    case SoftwareVAR::ComponentType::UINT8:
+      drawIndexed(primitive, num_indices, ptr); break;
+
+    case SoftwareVAR::ComponentType::UINT16:
+      drawIndexed(primitive, num_indices, reinterpret_cast<uint16 const *>(ptr)); break;
+
+    case SoftwareVAR::ComponentType::UINT32:
+      drawIndexed(primitive, num_indices, reinterpret_cast<uint32 const *>(ptr)); break;
+
+    default:
+      throw Error(std::string(getName()) + ": Index array does not contain integers");
+  }
+}
+
+void
+SoftwareRenderSystem::beginPrimitive(Primitive primitive)
+{
+  immediate_primitive = primitive;
+  immediate_vertices.clear();
+}
+
+void
+SoftwareRenderSystem::sendVertex(Vector2 const & vertex)
+{
+  sendVertex(Vector4(vertex.x(), vertex.y(), 0, 1));
+}
+
+void
+SoftwareRenderSystem::sendVertex(float x, float y)
+{
+  sendVertex(Vector4(x, y, 0, 1));
+}
+
+void
+SoftwareRenderSystem::sendVertex(double x, double y)
+{
+  sendVertex(Vector4((Real)x, (Real)y, 0, 1));
+}
+
+void
+SoftwareRenderSystem::sendVertex(Vector3 const & vertex)
+{
+  sendVertex(Vector4(vertex, 1));
+}
+
+void
+SoftwareRenderSystem::sendVertex(float x, float y, float z)
+{
+  sendVertex(Vector4(x, y, z, 1));
+}
+
+void
+SoftwareRenderSystem::sendVertex(double x, double y, double z)
+{
+  sendVertex(Vector4((Real)x, (Real)y, (Real)z, 1));
+}
+
+void
+SoftwareRenderSystem::sendVertex(Vector4 const & vertex)
+{
+  updateTransforms();
+
+  immediate_vertices.push_back(ClipVertex());
+  transformVertex(vertex, color_flags.color, color_flags.normal, color_flags.texcoord, immediate_vertices.back());
+}
+
+void
+SoftwareRenderSystem::sendVertex(float x, float y, float z, float w)
+{
+  sendVertex(Vector4(x, y, z, w));
+}
+
+void
+SoftwareRenderSystem::sendVertex(double x, double y, double z, double w)
+{
+  sendVertex(Vector4((Real)x, (Real)y, (Real)z, (Real)w));
+}
+
+void
+SoftwareRenderSystem::sendNormal(Vector3 const & normal)
+{
+  color_flags.normal = normal;
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::sendNormal(float x, float y, float z)
+{
+  sendNormal(Vector3(x, y, z));
+}
+
+void
+SoftwareRenderSystem::sendNormal(double x, double y, double z)
+{
+  sendNormal(Vector3((Real)x, (Real)y, (Real)z));
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, float texcoord)
+{
+  sendTexCoord(texunit, Vector3(texcoord, 0, 0));
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, double texcoord)
+{
+  sendTexCoord(texunit, Vector3((Real)texcoord, 0, 0));
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, Vector2 const & texcoord)
+{
+  sendTexCoord(texunit, Vector3(texcoord, 0));
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, float x, float y)
+{
+  sendTexCoord(texunit, Vector3(x, y, 0));
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, double x, double y)
+{
+  sendTexCoord(texunit, Vector3((Real)x, (Real)y, 0));
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, Vector3 const & texcoord)
+{
+  debugAssertM(texunit >= 0 && texunit < MAX_TEXTURE_UNITS, std::string(getName()) + ": Texture unit out of range");
+
+  // Only the coordinates of texture unit 0 are used by the built-in shading models
+  if (texunit == 0)
+  {
+    color_flags.texcoord = texcoord;
+    invalidateTransformedVertices();
+  }
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, float x, float y, float z)
+{
+  sendTexCoord(texunit, Vector3(x, y, z));
+}
+
+void
+SoftwareRenderSystem::sendTexCoord(int texunit, double x, double y, double z)
+{
+  sendTexCoord(texunit, Vector3((Real)x, (Real)y, (Real)z));
+}
+
+void
+SoftwareRenderSystem::endPrimitive()
+{
+  vertex_indices.resize(immediate_vertices.size());
+  for (array_size_t i = 0; i < vertex_indices.size(); ++i)
+    vertex_indices[i] = (uint32)i;
+
+  drawPrimitives(immediate_primitive, immediate_vertices, vertex_indices);
+  immediate_vertices.clear();
+}
+
+bool
+SoftwareRenderSystem::getRasterState(RasterState & state) const
+{
+  if (!current_framebuffer)
+    return false;
+
+  state.color_target = current_framebuffer->getAttachment(Framebuffer::AttachmentPoint::COLOR_0);
+  state.color_layer = current_framebuffer->getAttachmentLayer(Framebuffer::AttachmentPoint::COLOR_0);
+  state.depth_target = current_framebuffer->getAttachment(Framebuffer::AttachmentPoint::DEPTH);
+  state.depth_layer = current_framebuffer->getAttachmentLayer(Framebuffer::AttachmentPoint::DEPTH);
+  state.width = current_framebuffer->getWidth();
+  state.height = current_framebuffer->getHeight();
+
+  if (!state.color_target && !state.depth_target)
+    return false;
+
+  state.depth_test = depth_flags.test;
+  state.depth_write = depth_flags.write;
+  for (int i = 0; i < 4; ++i) state.color_write[i] = color_flags.write[i];
+  state.cull_face = shape_flags.cull;
+  state.polygon_offset = (shape_flags.polygon_offset_enabled ? shape_flags.polygon_offset : 0);
+  state.point_size = shape_flags.point_size;
+
+  // The minimum resolvable difference in depth values, used by polygon offsets, depends on the precision of the depth buffer
+  state.depth_resolution = 0;
+  if (state.depth_target)
+  {
+    Texture::Format const * depth_format = state.depth_target->getFormat();
+    int depth_bits = (depth_format->floatingPoint || depth_format->depthBits <= 0) ? 24 : std::min(depth_format->depthBits, 24);
+    state.depth_resolution = std::ldexp(1.0f, -depth_bits);
+  }
+
+  // Shading
+  state.shading_model = SoftwareShader::ShadingModel::UNLIT;
+  state.texture = NULL;
+  state.texture3d = NULL;
+  state.two_sided = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    state.light_dir[i] = state.light_color[i] = state.ambient_color[i] = 0;
+    state.bbox_lo[i] = state.bbox_hi[i] = 0;
+  }
+  for (int i = 0; i < 4; ++i) state.material[i] = 0;
+
+  if (current_shader)
+  {
+    state.shading_model = current_shader->getShadingModel();
+    current_shader->getUniformValue("two_sided", 1, &state.two_sided);
+
+    if (state.shading_model == SoftwareShader::ShadingModel::MATCAP)
+      state.texture = current_shader->getUniformTexture("matcap_tex");
+    else if (state.shading_model == SoftwareShader::ShadingModel::LAMBERT)
+    {
+      current_shader->getUniformValue("light_dir", 3, state.light_dir);
+      current_shader->getUniformValue("light_color", 3, state.light_color);
+      current_shader->getUniformValue("ambient_color", 3, state.ambient_color);
+      current_shader->getUniformValue("material", 4, state.material);
+
+      float len = std::sqrt(state.light_dir[0] * state.light_dir[0] + state.light_dir[1] * state.light_dir[1]
+                          + state.light_dir[2] * state.light_dir[2]);
+      if (len > 0)
+        for (int i = 0; i < 3; ++i) state.light_dir[i] /= len;
+    }
+
+    if (current_shader->hasTexture3D())
+    {
+      state.texture3d = current_shader->getUniformTexture("tex3d");
+      current_shader->getUniformValue("bbox_lo", 3, state.bbox_lo);
+      current_shader->getUniformValue("bbox_hi", 3, state.bbox_hi);
+    }
+  }
+  else
+    state.texture = current_textures.units[0];  // fixed-function texturing
+
+  state.varyings = RasterState::COLOR_BIT;
+  if (state.shading_model != SoftwareShader::ShadingModel::UNLIT) state.varyings |= RasterState::NORMAL_BIT;
+  if (state.texture3d)                                            state.varyings |= RasterState::POSITION_BIT;
+  if (state.texture && state.shading_model == SoftwareShader::ShadingModel::UNLIT)
+    state.varyings |= RasterState::TEXCOORD_BIT;
+
+  return true;
+}
+
+void
+SoftwareRenderSystem::drawPrimitives(Primitive primitive, TheaArray<ClipVertex> const & vertices,
+                                     TheaArray<uint32> const & vertex_indices_)
+{
+  RasterState state;
+  if (!getRasterState(state))
+    return;
+
+  TheaArray<uint32> prim_indices;
+  int verts_per_prim = SoftwareRenderSystem__assemblePrimitives(primitive, vertex_indices_, prim_indices);
+  SoftwareRasterizer::draw(state, verts_per_prim, vertices, prim_indices);
+}
+
+SoftwareRenderSystem::State
+SoftwareRenderSystem::getState() const
+{
+  State state;
+  state.color_flags = color_flags;
+  state.depth_flags = depth_flags;
+  state.stencil_flags = stencil_flags;
+  state.shape_flags = shape_flags;
+  state.matrix_mode = matrix_mode;
+  state.buffer_state = current_buffer_state;
+
+  return state;
+}
+
+void
+SoftwareRenderSystem::setState(State const & state)
+{
+  color_flags = state.color_flags;
+  depth_flags = state.depth_flags;
+  stencil_flags = state.stencil_flags;
+  shape_flags = state.shape_flags;
+  matrix_mode = state.matrix_mode;
+  current_buffer_state = state.buffer_state;
+
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::pushState()
+{
+  pushFramebuffer();
+  pushShader();
+  pushTextures();
+  state_stack.push(getState());
+}
+
+void
+SoftwareRenderSystem::pushColorFlags()
+{
+  color_flags_stack.push(color_flags);
+}
+
+void
+SoftwareRenderSystem::pushDepthFlags()
+{
+  depth_flags_stack.push(depth_flags);
+}
+
+void
+SoftwareRenderSystem::pushStencilFlags()
+{
+  stencil_flags_stack.push(stencil_flags);
+}
+
+void
+SoftwareRenderSystem::pushShapeFlags()
+{
+  shape_flags_stack.push(shape_flags);
+}
+
+void
+SoftwareRenderSystem::setColorWrite(bool red, bool green, bool blue, bool alpha)
+{
+  color_flags.write[0] = red;
+  color_flags.write[1] = green;
+  color_flags.write[2] = blue;
+  color_flags.write[3] = alpha;
+}
+
+void
+SoftwareRenderSystem::setDepthWrite(bool value)
+{
+  depth_flags.write = value;
+}
+
+void
+SoftwareRenderSystem::setStencilWrite(uint32 mask)
+{
+  stencil_flags.write = mask;
+}
+
+void
+SoftwareRenderSystem::setColor(ColorRGB const & value)
+{
+  setColor(ColorRGBA(value, 1));
+}
+
+void
+SoftwareRenderSystem::setColor(ColorRGBA const & value)
+{
+  color_flags.color = value;
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::setColorClearValue(ColorRGB const & value)
+{
+  color_flags.clear_value = ColorRGBA(value, 1);
+}
+
+void
+SoftwareRenderSystem::setColorClearValue(ColorRGBA const & value)
+{
+  color_flags.clear_value = value;
+}
+
+void
+SoftwareRenderSystem::setDepthClearValue(Real value)
+{
+  depth_flags.clear_value = value;
+}
+
+void
+SoftwareRenderSystem::setStencilClearValue(int value)
+{
+  stencil_flags.clear_value = value;
+}
+
+void
+SoftwareRenderSystem::clear()
+{
+  clear(true, true, true);
+}
+
+void
+SoftwareRenderSystem::clear(bool color, bool depth, bool stencil)
+{
+  (void)stencil;  // no stencil buffer
+
+  RasterState state;
+  if (!getRasterState(state))
+    return;
+
+  SoftwareRasterizer::clear(state, color, color_flags.clear_value, depth, depth_flags.clear_value);
+}
+
+void
+SoftwareRenderSystem::setDepthTest(DepthTest test)
+{
+  depth_flags.test = test;
+}
+
+void
+SoftwareRenderSystem::setCullFace(CullFace cull)
+{
+  shape_flags.cull = cull;
+}
+
+void
+SoftwareRenderSystem::setPolygonOffset(bool enable, Real offset)
+{
+  shape_flags.polygon_offset_enabled = enable;
+  if (enable)
+    shape_flags.polygon_offset = offset;
+}
+
+void
+SoftwareRenderSystem::setPointSize(Real size)
+{
+  shape_flags.point_size = size;
+}
+
+void
+SoftwareRenderSystem::popColorFlags()
+{
+  debugAssertM(!color_flags_stack.empty(), std::string(getName()) + ": push/popColorFlags calls not matched");
+
+  color_flags = color_flags_stack.top();
+  color_flags_stack.pop();
+  invalidateTransformedVertices();
+}
+
+void
+SoftwareRenderSystem::popDepthFlags()
+{
+  debugAssertM(!depth_flags_stack.empty(), std::string(getName()) + ": push/popDepthFlags calls not matched");
+
+  depth_flags = depth_flags_stack.top();
+  depth_flags_stack.pop();
+}
+
+void
+SoftwareRenderSystem::popStencilFlags()
+{
+  debugAssertM(!stencil_flags_stack.empty(), std::string(getName()) + ": push/popStencilFlags calls not matched");
+
+  stencil_flags = stencil_flags_stack.top();
+  stencil_flags_stack.pop();
+}
+
+void
+SoftwareRenderSystem::popShapeFlags()
+{
+  debugAssertM(!shape_flags_stack.empty(), std::string(getName()) + ": push/popShapeFlags calls not matched");
+
+  shape_flags = shape_flags_stack.top();
+  shape_flags_stack.pop();
+}
+
+void
+SoftwareRenderSystem::popState()
+{
+  debugAssertM(!state_stack.empty(), std::string(getName()) + ": push/popState calls not matched");
+
+  setState(state_stack.top());
+  state_stack.pop();
+  popTextures();
+  popShader();
+  popFramebuffer();
+}
+
+void
+SoftwareRenderSystem::finishAllOperations()
+{
+  // All operations are synchronous
+}
+
+SoftwareRenderSystemFactory::~SoftwareRenderSystemFactory()
+{
+  destroyAllRenderSystems();
+}
+
+RenderSystem *
+SoftwareRenderSystemFactory::createRenderSystem(char const * name)
+{
+  SoftwareRenderSystem * rs = NULL;
+  try
+  {
+    rs = new SoftwareRenderSystem(name);
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return NULL;, ERROR, "%s", "Could not create new software rendersystem")
+
+  render_systems.insert(rs);
+  return rs;
+}
+
+void
+SoftwareRenderSystemFactory::destroyRenderSystem(RenderSystem * render_system)
+{
+  if (!render_system)
+    return;
+
+  if (render_systems.erase(dynamic_cast<SoftwareRenderSystem *>(render_system)) < 1)
+  {
+    THEA_ERROR << "SoftwareRenderSystemFactory: Attempting to destroy rendersystem '" << render_system->getName()
+               << "' which was not created with this factory";
+    return;
+  }
+
+  delete render_system;
+}
+
+void
+SoftwareRenderSystemFactory::destroyAllRenderSystems()
+{
+  for (RenderSystemSet::const_iterator ri = render_systems.begin(); ri != render_systems.end(); ++ri)
+    delete *ri;
+
+  render_systems.clear();
+}
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
@@ -0,0 +1,413 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#ifndef __Thea_Graphics_Software_SoftwareRenderSystem_hpp__
+#define __Thea_Graphics_Software_SoftwareRenderSystem_hpp__
+
+#include "../../Graphics/RenderSystem.hpp"
+#include "../../Stack.hpp"
+#include "../../UnorderedSet.hpp"
+#include "SoftwareCommon.hpp"
+#include "SoftwareFramebuffer.hpp"
+#include "SoftwareRasterizer.hpp"
+#include "SoftwareShader.hpp"
+#include "SoftwareVAR.hpp"
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+/**
+ * A rendersystem that draws on the CPU, without any graphics hardware or display. All rendering is offscreen, to textures
+ * attached to a framebuffer: if no framebuffer is set, draw calls have no effect. Vertices are transformed by the
+ * fixed-function pipeline, and fragments are shaded by the built-in models described in SoftwareShader. Fragments with alpha
+ * less than 1 are blended with the existing color as <tt>src * alpha + dst * (1 - alpha)</tt>. Stencil operations are
+ * accepted but ignored. Primitives are scan converted in parallel by SoftwareRasterizer. <b>Not threadsafe</b>.
+ *
+ * The vertices of the current arrays are transformed once and reused by all subsequent draw calls, until the arrays, the
+ * matrices or the current attributes change, or the current begin/endIndexedPrimitives() block ends. Hence the contents of a
+ * VAR should not be updated between draw calls that use it within a single block.
+ */
+class THEA_SOFTWARE_DLL_LOCAL SoftwareRenderSystem : public RenderSystem
+{
+  public:
+    /** Constructor. */
+    SoftwareRenderSystem(char const * name_);
+
+    /** Destructor. */
+    ~SoftwareRenderSystem();
+
+    char const * getName() const { return name.c_str(); }
+
+    char const * describeSystem() const;
+
+    Framebuffer * createFramebuffer(char const * name_);
+    void destroyFramebuffer(Framebuffer * framebuffer);
+
+    Shader * createShader(char const * name_);
+    void destroyShader(Shader * shader);
+
+    Texture * createTexture(char const * name_, int width, int height, int depth,
+                            Texture::Format const * desired_format, Texture::Dimension dimension = Texture::Dimension::DIM_2D,
+                            Texture::Options const & options = Texture::Options::defaults());
+
+    Texture * createTexture(char const * name_, AbstractImage const & image,
+                            Texture::Format const * desired_format = Texture::Format::AUTO(),
+                            Texture::Dimension dimension = Texture::Dimension::DIM_2D,
+                            Texture::Options const & options = Texture::Options::defaults());
+
+    Texture * createTexture(char const * name_, AbstractImage const * images[6],
+                            Texture::Format const * desired_format = Texture::Format::AUTO(),
+                            Texture::Options const & options = Texture::Options::defaults());
+
+    void destroyTexture(Texture * texture);
+
+    VARArea * createVARArea(char const * name_, long num_bytes, VARArea::Usage usage, bool gpu_memory = true);
+    void destroyVARArea(VARArea * area);
+
+    void pushFramebuffer();
+    void setFramebuffer(Framebuffer * framebuffer);
+    Framebuffer const * getFramebuffer() const;
+    Framebuffer * getFramebuffer();
+    void popFramebuffer();
+
+    void pushShader();
+    void setShader(Shader * shader);
+    Shader const * getShader() const;
+    Shader * getShader();
+    void popShader();
+
+    void pushTextures();
+    void setTexture(int texunit, Texture * texture);
+    void popTextures();
+
+    MatrixMode getMatrixMode() const;
+    void setMatrixMode(MatrixMode mode);
+    void pushMatrix();
+    void pushViewMatrices();
+    Matrix4 getMatrix(MatrixMode mode) const;
+    void setMatrix(Matrix4 const & m);
+    void setIdentityMatrix();
+    void multMatrix(Matrix4 const & m);
+    void popMatrix();
+    void popViewMatrices();
+
+    void beginIndexedPrimitives();
+    void setVertexArray(VAR const * vertices);
+    void setColorArray(VAR const * colors);
+    void setTexCoordArray(int texunit, VAR const * texcoords);
+    void setNormalArray(VAR const * normals);
+    void setIndexArray(VAR const * indices);
+    void sendIndices(Primitive primitive, long num_indices, uint8 const * indices);
+    void sendIndices(Primitive primitive, long num_indices, uint16 const * indices);
+    void sendIndices(Primitive primitive, long num_indices, uint32 const * indices);
+    void sendSequentialIndices(Primitive primitive, int first_index, int num_indices);
+    void sendIndicesFromArray(Primitive primitive, long offset, long num_indices);
+    void endIndexedPrimitives();
+
+    void beginPrimitive(Primitive primitive);
+    void sendVertex(Vector2 const & vertex);
+    void sendVertex(float x, float y);
+    void sendVertex(double x, double y);
+    void sendVertex(Vector3 const & vertex);
+    void sendVertex(float x, float y, float z);
+    void sendVertex(double x, double y, double z);
+    void sendVertex(Vector4 const & vertex);
+    void sendVertex(float x, float y, float z, float w);
+    void sendVertex(double x, double y, double z, double w);
+    void sendNormal(Vector3 const & normal);
+    void sendNormal(float x, float y, float z);
+    void sendNormal(double x, double y, double z);
+    void sendTexCoord(int texunit, float texcoord);
+    void sendTexCoord(int texunit, double texcoord);
+    void sendTexCoord(int texunit, Vector2 const & texcoord);
+    void sendTexCoord(int texunit, float x, float y);
+    void sendTexCoord(int texunit, double x, double y);
+    void sendTexCoord(int texunit, Vector3 const & texcoord);
+    void sendTexCoord(int texunit, float x, float y, float z);
+    void sendTexCoord(int texunit, double x, double y, double z);
+    void endPrimitive();
+
+    void pushState();
+    void pushColorFlags();
+    void pushDepthFlags();
+    void pushStencilFlags();
+    void pushShapeFlags();
+    void setColorWrite(bool red, bool green, bool blue, bool alpha);
+    void setDepthWrite(bool value);
+    void setStencilWrite(uint32 mask);
+    void setColor(ColorRGB const & value);
+    void setColor(ColorRGBA const & value);
+    void setColorClearValue(ColorRGB const & value);
+    void setColorClearValue(ColorRGBA const & value);
+    void setDepthClearValue(Real value);
+    void setStencilClearValue(int value);
+    void clear();
+    void clear(bool color, bool depth, bool stencil);
+    void setDepthTest(DepthTest test);
+    void setCullFace(CullFace cull);
+    void setPolygonOffset(bool enable, Real offset = 1);
+    void setPointSize(Real size = 1);
+    void popColorFlags();
+    void popDepthFlags();
+    void popStencilFlags();
+    void popShapeFlags();
+    void popState();
+
+    void finishAllOperations();
+
+  private:
+    /** Number of supported texture units. */
+    static int const MAX_TEXTURE_UNITS = 8;
+
+    /** Stores the current set of vertex and index arrays. */
+    struct BufferState
+    {
+      SoftwareVARArea * vertex_area;  ///< Vertex buffer.
+      SoftwareVARArea * index_area;  ///< Index buffer.
+      SoftwareVAR vertex_var;  ///< Vertex array.
+      SoftwareVAR color_var;  ///< Color array.
+      SoftwareVAR normal_var;  ///< Normal array.
+      SoftwareVAR texcoord_var;  ///< Texture coordinate array of texture unit 0.
+      SoftwareVAR index_var;  ///< Index array.
+
+      /** Constructor. */
+      BufferState() : vertex_area(NULL), index_area(NULL) {}
+
+    }; // struct BufferState
+
+    /** Color state, and the current vertex attributes. */
+    struct ColorFlags
+    {
+      bool write[4];  ///< Write to the red, green, blue and alpha channels?
+      ColorRGBA clear_value;  ///< Color clear value.
+      ColorRGBA color;  ///< Current color.
+      Vector3 normal;  ///< Current normal.
+      Vector3 texcoord;  ///< Current texture coordinate of texture unit 0.
+
+    }; // struct ColorFlags
+
+    /** Depth buffer state. */
+    struct DepthFlags
+    {
+      bool write;  ///< Write to the depth buffer?
+      Real clear_value;  ///< Depth clear value.
+      DepthTest test;  ///< Depth test.
+
+    }; // struct DepthFlags
+
+    /** Stencil buffer state. */
+    struct StencilFlags
+    {
+      uint32 write;  ///< Stencil write mask.
+      int clear_value;  ///< Stencil clear value.
+
+    }; // struct StencilFlags
+
+    /** Primitive rasterization state. */
+    struct ShapeFlags
+    {
+      CullFace cull;  ///< Faces to cull.
+      bool polygon_offset_enabled;  ///< Is polygon offset enabled?
+      Real polygon_offset;  ///< Polygon offset.
+      Real point_size;  ///< Point diameter in pixels.
+
+    }; // struct ShapeFlags
+
+    /** Textures bound to the texture units. */
+    struct TextureUnits
+    {
+      SoftwareTexture * units[MAX_TEXTURE_UNITS];  ///< The bound textures.
+
+      /** Constructor. */
+      TextureUnits() { for (int i = 0; i < MAX_TEXTURE_UNITS; ++i) units[i] = NULL; }
+
+    }; // struct TextureUnits
+
+    /** All state saved by pushState(), apart from the framebuffer, shader and textures. */
+    struct State
+    {
+      ColorFlags color_flags;
+      DepthFlags depth_flags;
+      StencilFlags stencil_flags;
+      ShapeFlags shape_flags;
+      MatrixMode matrix_mode;
+      BufferState buffer_state;
+
+    }; // struct State
+
+    typedef TheaStack<SoftwareFramebuffer *>  FramebufferStack;
+    typedef TheaStack<BufferState>            BufferStack;
+    typedef TheaStack<SoftwareShader *>       ShaderStack;
+    typedef TheaStack<TextureUnits>           TextureStack;
+    typedef TheaStack<ColorFlags>             ColorFlagsStack;
+    typedef TheaStack<DepthFlags>             DepthFlagsStack;
+    typedef TheaStack<StencilFlags>           StencilFlagsStack;
+    typedef TheaStack<ShapeFlags>             ShapeFlagsStack;
+    typedef TheaStack<State>                  StateStack;
+    typedef TheaStack<Matrix4>                MatrixStack;
+
+    typedef TheaUnorderedSet<SoftwareFramebuffer *>  FramebufferSet;
+    typedef TheaUnorderedSet<SoftwareTexture *>      TextureSet;
+    typedef TheaUnorderedSet<SoftwareShader *>       ShaderSet;
+    typedef TheaUnorderedSet<SoftwareVARArea *>      VARAreaSet;
+
+    /** Get the full state saved by pushState(). */
+    State getState() const;
+
+    /** Restore the full state saved by pushState(). */
+    void setState(State const & state);
+
+    /**
+     * Set the current vertex area to match the specified VAR. The vertex area used within a single
+     * beginIndexedPrimitives()/endIndexedPrimitives() block must remain constant.
+     */
+    void setVertexAreaFromVAR(SoftwareVAR const & v);
+
+    /**
+     * Set the current index area to match the specified VAR. The index area used within a single
+     * beginIndexedPrimitives()/endIndexedPrimitives() block must remain constant.
+     */
+    void setIndexAreaFromVAR(SoftwareVAR const & v);
+
+    /** Mark cached transformed vertices as out of date. */
+    void invalidateTransformedVertices() { transformed_valid = false; }
+
+    /** Update the cached matrices used to transform vertices, if necessary. */
+    void updateTransforms() const;
+
+    /** Transform a vertex with the given attributes to clip space. */
+    void transformVertex(Vector4 const & position, ColorRGBA const & color, Vector3 const & normal, Vector3 const & texcoord,
+                         ClipVertex & result) const;
+
+    /** Transform the vertices of the current arrays, if they have not already been transformed. */
+    void transformVertexArrays();
+
+    /** Read vertex indices of the given type, and draw the primitives they define from the current arrays. */
+    template <typename IndexT> void drawIndexed(Primitive primitive, long num_indices, IndexT const * indices);
+
+    /** Assemble and draw a set of primitives, specified as a sequence of indices into a set of clip-space vertices. */
+    void drawPrimitives(Primitive primitive, TheaArray<ClipVertex> const & vertices, TheaArray<uint32> const & vertex_indices);
+
+    /** Initialize the rasterizer state from the current state. Returns false if there is nothing to draw to. */
+    bool getRasterState(RasterState & state) const;
+
+    /** Transform vertices of the current arrays in parallel. */
+    class VertexTransformer;
+    friend class VertexTransformer;
+
+    std::string name;
+    mutable std::string desc;
+
+    SoftwareFramebuffer * current_framebuffer;
+    FramebufferStack framebuffer_stack;
+
+    BufferState current_buffer_state;
+    BufferStack buffer_stack;
+
+    SoftwareShader * current_shader;
+    ShaderStack shader_stack;
+
+    TextureUnits current_textures;
+    TextureStack texture_stack;
+
+    ColorFlags color_flags;
+    ColorFlagsStack color_flags_stack;
+
+    DepthFlags depth_flags;
+    DepthFlagsStack depth_flags_stack;
+
+    StencilFlags stencil_flags;
+    StencilFlagsStack stencil_flags_stack;
+
+    ShapeFlags shape_flags;
+    ShapeFlagsStack shape_flags_stack;
+
+    StateStack state_stack;
+
+    MatrixMode matrix_mode;
+    Matrix4 matrices[4];
+    MatrixStack matrix_stacks[4];
+
+    mutable bool transforms_valid;      ///< Are the cached transformation matrices up to date?
+    mutable Matrix4 mvp;                ///< Cached product of the projection and modelview matrices.
+    mutable Matrix3 normal_matrix;      ///< Cached inverse transpose of the upper 3x3 block of the modelview matrix.
+
+    bool transformed_valid;                     ///< Are the cached transformed vertices up to date?
+    TheaArray<ClipVertex> transformed_vertices;  ///< Cached vertices of the current arrays, in clip space.
+
+    Primitive immediate_primitive;              ///< Primitive being specified in immediate mode.
+    TheaArray<ClipVertex> immediate_vertices;  ///< Vertices specified in immediate mode.
+    TheaArray<uint32> vertex_indices;           ///< Scratch space for vertex indices.
+
+    FramebufferSet  created_framebuffers;
+    TextureSet      created_textures;
+    ShaderSet       created_shaders;
+    VARAreaSet      created_varareas;
+
+}; // class SoftwareRenderSystem
+
+/** Factory for creating software rendersystems. Any number of rendersystems may be created. */
+class THEA_SOFTWARE_DLL_LOCAL SoftwareRenderSystemFactory : public RenderSystemFactory
+{
+  public:
+    /** Destructor. */
+    ~SoftwareRenderSystemFactory();
+
+    RenderSystem * createRenderSystem(char const * name);
+    void destroyRenderSystem(RenderSystem * render_system);
+
+    /** Destroy all rendersystems created with this factory. */
+    void destroyAllRenderSystems();
+
+  private:
+    typedef TheaUnorderedSet<SoftwareRenderSystem *> RenderSystemSet;
+
+    RenderSystemSet render_systems;
+
+}; // class SoftwareRenderSystemFactory
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
+
+#endif
@@ -0,0 +1,340 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#include "SoftwareShader.hpp"
+#include "../../FileSystem.hpp"
+#include "../../StringAlg.hpp"
+#include <cctype>
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+namespace SoftwareShaderInternal {
+
+// Remove C and C++ style comments from source code.
+static std::string
+stripComments(std::string const & source)
+{
+  std::string result;
+  result.reserve(source.size());
+
+  for (size_t i = 0; i < source.size(); )
+  {
+    if (source.compare(i, 2, "//") == 0)
+    {
+      size_t end = source.find('\n', i);
+      i = (end == std::string::npos ? source.size() : end);
+    }
+    else if (source.compare(i, 2, "/*") == 0)
+    {
+      size_t end = source.find("*/", i + 2);
+      i = (end == std::string::npos ? source.size() : end + 2);
+      result += ' ';
+    }
+    else
+      result += source[i++];
+  }
+
+  return result;
+}
+
+static bool isIdentifierChar(char c) { return std::isalnum((unsigned char)c) || c == '_'; }
+
+static void toFloats(Vector2 const & v, float * f) { f[0] = v.x(); f[1] = v.y(); }
+static void toFloats(Vector3 const & v, float * f) { f[0] = v.x(); f[1] = v.y(); f[2] = v.z(); }
+static void toFloats(Vector4 const & v, float * f) { f[0] = v.x(); f[1] = v.y(); f[2] = v.z(); f[3] = v.w(); }
+
+static void toFloats(ColorL const & c, float * f) { *f = c.value(); }
+static void toFloats(ColorRGB const & c, float * f) { f[0] = c.r(); f[1] = c.g(); f[2] = c.b(); }
+static void toFloats(ColorRGBA const & c, float * f) { f[0] = c.r(); f[1] = c.g(); f[2] = c.b(); f[3] = c.a(); }
+
+static void toFloats(Matrix2 const & m, float * f) { m.getElementsRowMajor(f); }
+static void toFloats(Matrix3 const & m, float * f) { m.getElementsRowMajor(f); }
+static void toFloats(Matrix4 const & m, float * f) { m.getElementsRowMajor(f); }
+
+} // namespace SoftwareShaderInternal
+
+SoftwareShader::SoftwareShader(SoftwareRenderSystem * render_system_, char const * name_)
+: render_system(render_system_), name(name_), has_fragment_module(false)
+{}
+
+void
+SoftwareShader::attachModuleFromFile(ModuleType type, char const * path)
+{
+  if (!FileSystem::exists(path))
+    throw Error(std::string(getName()) + ": Shader module '" + std::string(path) + "' not found");
+
+  std::string source = FileSystem::readWholeFile(path);
+  attachModuleFromString(type, source.c_str());
+}
+
+void
+SoftwareShader::attachModuleFromString(ModuleType type, char const * source)
+{
+  switch (type)
+  {
+    case ModuleType::VERTEX: break;
+    case ModuleType::FRAGMENT: has_fragment_module = true; break;
+    case ModuleType::GEOMETRY: throw Error(std::string(getName()) + ": Geometry shaders are not supported");
+    default: throw Error(std::string(getName()) + ": Unknown module type");
+  }
+
+  if (!source)
+    throw Error(std::string(getName()) + ": Null shader source");
+
+  readDeclaredUniforms(source);
+}
+
+void
+SoftwareShader::readDeclaredUniforms(std::string const & source)
+{
+  // Declarations are of the form: uniform <type> <name>[<size>] {, <name>[<size>]} ;
+  std::string src = SoftwareShaderInternal::stripComments(source);
+  static std::string const KEYWORD = "uniform";
+
+  for (size_t pos = src.find(KEYWORD); pos != std::string::npos; pos = src.find(KEYWORD, pos + 1))
+  {
+    if ((pos > 0 && SoftwareShaderInternal::isIdentifierChar(src[pos - 1]))
+     || (pos + KEYWORD.size() < src.size() && SoftwareShaderInternal::isIdentifierChar(src[pos + KEYWORD.size()])))
+      continue;
+
+    size_t end = src.find(';', pos);
+    if (end == std::string::npos)
+      break;
+
+    // Skip the keyword, any precision qualifiers and the type, then read the comma-separated names
+    TheaArray<std::string> fields;
+    stringSplit(src.substr(pos + KEYWORD.size(), end - pos - KEYWORD.size()), ',', fields);
+    for (array_size_t i = 0; i < fields.size(); ++i)
+    {
+      std::string decl = fields[i].substr(0, fields[i].find('['));
+      decl = trimWhitespace(decl);
+
+      size_t name_start = decl.size();
+      while (name_start > 0 && SoftwareShaderInternal::isIdentifierChar(decl[name_start - 1]))
+        name_start--;
+
+      std::string uniform_name = decl.substr(name_start);
+      if (!uniform_name.empty() && uniforms.find(uniform_name) == uniforms.end())
+        uniforms[uniform_name] = UniformValue();
+    }
+
+    pos = end;
+  }
+}
+
+SoftwareShader::UniformValue *
+SoftwareShader::findUniform(char const * uniform_name)
+{
+  Uniforms::iterator entry = uniforms.find(uniform_name);
+  if (entry == uniforms.end())
+  {
+    THEA_WARNING << getName() << ": Uniform '" << uniform_name << "' not found";
+    return NULL;
+  }
+
+  return &entry->second;
+}
+
+void
+SoftwareShader::setFloats(char const * uniform_name, long num_values, float const * values)
+{
+  UniformValue * u = findUniform(uniform_name);
+  if (!u) return;
+
+  u->f_array.assign(values, values + num_values);
+  u->i_array.clear();
+  u->texture = NULL;
+  u->has_value = true;
+}
+
+void
+SoftwareShader::setUniform(char const * uniform_name, float value)
+{
+  setFloats(uniform_name, 1, &value);
+}
+
+void
+SoftwareShader::setUniform(char const * uniform_name, int value)
+{
+  setUniform(uniform_name, 1, &value);
+}
+
+void
+SoftwareShader::setUniform(char const * uniform_name, ColorL const & value)
+{
+  setUniform(uniform_name, value.value());
+}
+
+void
+SoftwareShader::setUniform(char const * uniform_name, ColorL8 const & value)
+{
+  setUniform(uniform_name, ColorL(value).value());
+}
+
+void
+SoftwareShader::setUniform(char const * uniform_name, Texture * value)
+{
+  if (!value)
+    throw Error(std::string(getName()) + ": Null argument passed for uniform '" + std::string(uniform_name) + '\'');
+
+  SoftwareTexture * sw_tex = dynamic_cast<SoftwareTexture *>(value);
+  debugAssertM(sw_tex, std::string(getName()) + ": Attempt to use a non-software texture with a software rendersystem");
+
+  UniformValue * u = findUniform(uniform_name);
+  if (!u) return;
+
+  u->f_array.clear();
+  u->i_array.clear();
+  u->texture = sw_tex;
+  u->has_value = true;
+}
+
+#define SoftwareShader__MULTI_FLOAT_SET_UNIFORM(uniform_type, uniform_convert_type, num_components)                            \
+  void                                                                                                                        \
+  SoftwareShader::setUniform(char const * uniform_name, uniform_type const & value)                                           \
+  {                                                                                                                           \
+    float f[num_components];                                                                                                  \
+    SoftwareShaderInternal::toFloats(static_cast<uniform_convert_type>(value), f);                                            \
+    setFloats(uniform_name, num_components, f);                                                                               \
+  }
+
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(Vector2,      Vector2,    2)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(Vector3,      Vector3,    3)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(Vector4,      Vector4,    4)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(ColorRGB,     ColorRGB,   3)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(ColorRGB8,    ColorRGB,   3)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(ColorRGBA,    ColorRGBA,  4)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(ColorRGBA8,   ColorRGBA,  4)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(Matrix2,      Matrix2,    4)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(Matrix3,      Matrix3,    9)
+SoftwareShader__MULTI_FLOAT_SET_UNIFORM(Matrix4,      Matrix4,   16)
+
+void
+SoftwareShader::setUniform(char const * uniform_name, long num_values, float const * values)
+{
+  setFloats(uniform_name, num_values, values);
+}
+
+void
+SoftwareShader::setUniform(char const * uniform_name, long num_values, int const * values)
+{
+  UniformValue * u = findUniform(uniform_name);
+  if (!u) return;
+
+  u->f_array.clear();
+  u->i_array.assign(values, values + num_values);
+  u->texture = NULL;
+  u->has_value = true;
+}
+
+void
+SoftwareShader::setUniform(char const * uniform_name, long num_values, Texture * const * values)
+{
+  throw Error(std::string(getName()) + ": Texture array uniforms are not supported");
+}
+
+#define SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(uniform_type, uniform_convert_type, num_components)                            \
+  void                                                                                                                        \
+  SoftwareShader::setUniform(char const * uniform_name, long num_values, uniform_type const * values)                         \
+  {                                                                                                                           \
+    TheaArray<float> f((array_size_t)(num_components * num_values));                                                         \
+    for (long i = 0; i < num_values; ++i)                                                                                     \
+      SoftwareShaderInternal::toFloats(static_cast<uniform_convert_type>(values[i]), &f[(array_size_t)(num_components * i)]); \
+                                                                                                                              \
+    setFloats(uniform_name, (long)f.size(), f.empty() ? NULL : &f[0]);                                                        \
+  }
+
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(Vector2,      Vector2,    2)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(Vector3,      Vector3,    3)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(Vector4,      Vector4,    4)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(ColorL,       ColorL,     1)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(ColorL8,      ColorL,     1)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(ColorRGB,     ColorRGB,   3)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(ColorRGB8,    ColorRGB,   3)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(ColorRGBA,    ColorRGBA,  4)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(ColorRGBA8,   ColorRGBA,  4)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(Matrix2,      Matrix2,    4)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(Matrix3,      Matrix3,    9)
+SoftwareShader__FLOAT_ARRAY_SET_UNIFORM(Matrix4,      Matrix4,   16)
+
+SoftwareShader::ShadingModel
+SoftwareShader::getShadingModel() const
+{
+  if (hasUniform("matcap_tex"))
+    return ShadingModel::MATCAP;
+  else if (hasUniform("light_dir"))
+    return ShadingModel::LAMBERT;
+  else
+    return ShadingModel::UNLIT;
+}
+
+bool
+SoftwareShader::getUniformValue(char const * uniform_name, int n, float * values) const
+{
+  Uniforms::const_iterator entry = uniforms.find(uniform_name);
+  if (entry == uniforms.end() || !entry->second.has_value)
+    return false;
+
+  UniformValue const & u = entry->second;
+  for (int i = 0; i < n; ++i)
+  {
+    if ((array_size_t)i < u.f_array.size())
+      values[i] = u.f_array[(array_size_t)i];
+    else if ((array_size_t)i < u.i_array.size())
+      values[i] = (float)u.i_array[(array_size_t)i];
+  }
+
+  return true;
+}
+
+SoftwareTexture const *
+SoftwareShader::getUniformTexture(char const * uniform_name) const
+{
+  Uniforms::const_iterator entry = uniforms.find(uniform_name);
+  return entry == uniforms.end() ? NULL : entry->second.texture;
+}
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
@@ -0,0 +1,193 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#ifndef __Thea_Graphics_Software_SoftwareShader_hpp__
+#define __Thea_Graphics_Software_SoftwareShader_hpp__
+
+#include "../../Graphics/Shader.hpp"
+#include "../../Array.hpp"
+#include "../../Map.hpp"
+#include "SoftwareCommon.hpp"
+#include "SoftwareTexture.hpp"
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+// Forward declarations
+class SoftwareRenderSystem;
+
+/**
+ * A shader for the software rendersystem. GLSL source code cannot be executed on the CPU, so the attached modules are only
+ * scanned for their uniform declarations. Fragments are instead shaded by a built-in model, selected by the declared uniforms:
+ *
+ * - <tt>matcap_tex</tt> (sampler2D): the interpolated color is modulated by the matcap texture, looked up with the XY
+ *   components of the camera-space normal. If <tt>two_sided</tt> is greater than 0.5, back-facing normals are flipped.
+ * - <tt>light_dir</tt> (vec3, camera space, pointing towards the object): ambient plus Lambertian lighting, using
+ *   <tt>ambient_color</tt>, <tt>light_color</tt> and <tt>material</tt> ([ka, kl, *, *]). Back-facing surfaces are lit only if
+ *   <tt>two_sided</tt> is non-zero.
+ * - Otherwise the interpolated color is passed through unchanged.
+ *
+ * In addition, if <tt>tex3d</tt> (sampler3D), <tt>bbox_lo</tt> and <tt>bbox_hi</tt> are declared, the color is first blended
+ * with the 3D texture sampled at the object-space position, normalized to the box.
+ *
+ * These conventions match the shaders used by the RenderShape tool. Vertex modules are ignored: vertices are always transformed
+ * by the fixed-function modelview and projection matrices.
+ */
+class THEA_SOFTWARE_DLL_LOCAL SoftwareShader : public Shader
+{
+  public:
+    /** Built-in fragment shading models (enum class). */
+    struct THEA_SOFTWARE_DLL_LOCAL ShadingModel
+    {
+      /** Supported values. */
+      enum Value
+      {
+        UNLIT,    ///< Pass the interpolated color through unchanged.
+        LAMBERT,  ///< Ambient plus (optionally two-sided) Lambertian lighting.
+        MATCAP    ///< Modulate the interpolated color by a material capture texture.
+      };
+
+      THEA_ENUM_CLASS_BODY(ShadingModel)
+    };
+
+    /** Constructor. */
+    SoftwareShader(SoftwareRenderSystem * render_system_, char const * name_);
+
+    /** Get the parent rendersystem. */
+    SoftwareRenderSystem * getRenderSystem() const { return render_system; }
+
+    char const * getName() const { return name.c_str(); }
+
+    bool isComplete() const { return has_fragment_module; }
+
+    void attachModuleFromFile(ModuleType type, char const * path);
+    void attachModuleFromString(ModuleType type, char const * source);
+
+    bool hasUniform(char const * uniform_name) const { return uniforms.find(uniform_name) != uniforms.end(); }
+
+    void setUniform(char const * uniform_name, float value);
+    void setUniform(char const * uniform_name, int value);
+    void setUniform(char const * uniform_name, Vector2 const & value);
+    void setUniform(char const * uniform_name, Vector3 const & value);
+    void setUniform(char const * uniform_name, Vector4 const & value);
+    void setUniform(char const * uniform_name, ColorL8 const & value);
+    void setUniform(char const * uniform_name, ColorL const & value);
+    void setUniform(char const * uniform_name, ColorRGB8 const & value);
+    void setUniform(char const * uniform_name, ColorRGB const & value);
+    void setUniform(char const * uniform_name, ColorRGBA8 const & value);
+    void setUniform(char const * uniform_name, ColorRGBA const & value);
+    void setUniform(char const * uniform_name, Matrix2 const & value);
+    void setUniform(char const * uniform_name, Matrix3 const & value);
+    void setUniform(char const * uniform_name, Matrix4 const & value);
+    void setUniform(char const * uniform_name, Texture * value);
+
+    void setUniform(char const * uniform_name, long num_values, float const * values);
+    void setUniform(char const * uniform_name, long num_values, int const * values);
+    void setUniform(char const * uniform_name, long num_values, Vector2 const * values);
+    void setUniform(char const * uniform_name, long num_values, Vector3 const * values);
+    void setUniform(char const * uniform_name, long num_values, Vector4 const * values);
+    void setUniform(char const * uniform_name, long num_values, ColorL8 const * values);
+    void setUniform(char const * uniform_name, long num_values, ColorL const * values);
+    void setUniform(char const * uniform_name, long num_values, ColorRGB8 const * values);
+    void setUniform(char const * uniform_name, long num_values, ColorRGB const * values);
+    void setUniform(char const * uniform_name, long num_values, ColorRGBA8 const * values);
+    void setUniform(char const * uniform_name, long num_values, ColorRGBA const * values);
+    void setUniform(char const * uniform_name, long num_values, Matrix2 const * values);
+    void setUniform(char const * uniform_name, long num_values, Matrix3 const * values);
+    void setUniform(char const * uniform_name, long num_values, Matrix4 const * values);
+    void setUniform(char const * uniform_name, long num_values, Texture * const * values);
+
+    /** Get the built-in model used to shade fragments, as determined by the declared uniforms. */
+    ShadingModel getShadingModel() const;
+
+    /** Check if the color should be blended with a 3D texture before shading. */
+    bool hasTexture3D() const { return hasUniform("tex3d") && hasUniform("bbox_lo") && hasUniform("bbox_hi"); }
+
+    /**
+     * Get the first \a n floating-point components of the value of a uniform. If the uniform has not been assigned a value, or
+     * has fewer components, the remaining entries of \a values are left unchanged. Integer values are converted to floats.
+     *
+     * @return True if the uniform has been assigned a value, else false.
+     */
+    bool getUniformValue(char const * uniform_name, int n, float * values) const;
+
+    /** Get the texture assigned to a sampler uniform, or null if there is no such uniform or it has not been assigned. */
+    SoftwareTexture const * getUniformTexture(char const * uniform_name) const;
+
+  private:
+    /** A value for a uniform variable. */
+    struct UniformValue
+    {
+      TheaArray<float> f_array;
+      TheaArray<int> i_array;
+      SoftwareTexture * texture;
+      bool has_value;
+
+      /** Constructor. */
+      UniformValue() : texture(NULL), has_value(false) {}
+    };
+
+    /** A set of uniforms read from source code. */
+    typedef TheaMap<std::string, UniformValue> Uniforms;
+
+    /** Add all uniforms declared in a source module to the set of known uniforms. */
+    void readDeclaredUniforms(std::string const & source);
+
+    /** Get the entry for a uniform, warning and returning null if it has not been declared. */
+    UniformValue * findUniform(char const * uniform_name);
+
+    /** Set the value of a uniform from an array of floats. */
+    void setFloats(char const * uniform_name, long num_values, float const * values);
+
+    SoftwareRenderSystem * render_system;
+    std::string name;
+    bool has_fragment_module;
+    Uniforms uniforms;
+
+}; // class SoftwareShader
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
+
+#endif
@@ -0,0 +1,106 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+#ifndef __Thea_SoftwareSymbolVisibility_hpp__
+#define __Thea_SoftwareSymbolVisibility_hpp__
+
+// Shared library support. See http://gcc.gnu.org/wiki/Visibility . Quoting loosely from that page, and assuming M is a library-
+// specific prefix:
+//
+// - If M_DLL and M_DLL_EXPORTS are defined, we are building our library as a DLL and symbols should be exported. Something
+//   ending with _EXPORTS is defined by MSVC by default in all projects.
+//
+// - If M_DLL_EXPORTS is not defined, we are importing our library and symbols should be imported.
+//
+// - If we're building with GCC and __GNUC__ >= 4 , then GCC supports the new features.
+//
+// - For every non-templated non-static function definition in your library (both headers and source files), decide if it is
+//   publicly used or internally used:
+//
+//     - If it is publicly used, mark with M_API like this: extern M_API PublicFunc()
+//
+//     - If it is only internally used, mark with M_DLL_LOCAL like this: extern M_DLL_LOCAL PublicFunc(). Remember, static
+//       functions need no demarcation, nor does anything which is templated.
+//
+// - For every non-templated class definition in your library (both headers and source files), decide if it is publicly used or
+//   internally used:
+//
+//     - If it is publicly used, mark with M_API like this: class M_API PublicClass
+//
+//     - If it is only internally used, mark with M_DLL_LOCAL like this: class M_DLL_LOCAL PublicClass
+//
+// - Individual member functions of an exported class that are not part of the interface, in particular ones which are private,
+//   and are not used by friend code, should be marked individually with M_DLL_LOCAL.
+//
+// - Remember to test your library thoroughly afterwards, including that all exceptions correctly traverse shared object
+//   boundaries.
+//
+#ifdef _MSC_VER  // should be WIN32?
+#    define THEA_SOFTWARE_IMPORT  __declspec(dllimport)
+#    define THEA_SOFTWARE_EXPORT  __declspec(dllexport)
+#    define THEA_SOFTWARE_DLL_LOCAL
+#    define THEA_SOFTWARE_DLL_PUBLIC
+#else
+#    if (defined __GNUC__ && __GNUC__ >= 4)
+#        define THEA_SOFTWARE_IMPORT      __attribute__ ((visibility("default")))
+#        define THEA_SOFTWARE_EXPORT      __attribute__ ((visibility("default")))
+#        define THEA_SOFTWARE_DLL_LOCAL   __attribute__ ((visibility("hidden")))
+#        define THEA_SOFTWARE_DLL_PUBLIC  __attribute__ ((visibility("default")))
+#    else
+#        define THEA_SOFTWARE_IMPORT
+#        define THEA_SOFTWARE_EXPORT
+#        define THEA_SOFTWARE_DLL_LOCAL
+#        define THEA_SOFTWARE_DLL_PUBLIC
+#    endif
+#endif
+
+// Build flags for the Thea Software plugin (if any).
+#ifdef THEA_SOFTWARE_DLL
+#    ifdef THEA_SOFTWARE_DLL_EXPORTS
+#        define THEA_SOFTWARE_API  THEA_SOFTWARE_EXPORT
+#    else
+#        define THEA_SOFTWARE_API  THEA_SOFTWARE_IMPORT
+#    endif
+#else
+#    define THEA_SOFTWARE_API
+#endif
+
+#endif
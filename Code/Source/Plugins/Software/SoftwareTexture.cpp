@@ -0,0 +1,505 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#include "SoftwareTexture.hpp"
+#include "../../Math.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+// Read a pixel from a scanline of an image, as a floating-point color. Luminance values are replicated to the RGB channels.
+static ColorRGBA
+SoftwareTexture__readPixel(AbstractImage::Type type, void const * scanline, int x)
+{
+  static int const R = AbstractImage::Channel::RED, G = AbstractImage::Channel::GREEN, B = AbstractImage::Channel::BLUE,
+                   A = AbstractImage::Channel::ALPHA;
+
+  switch (type)
+  {
+    case AbstractImage::Type::LUMINANCE_8U:
+    {
+      float v = static_cast<uint8 const *>(scanline)[x] / 255.0f; return ColorRGBA(v, v, v, 1);
+    }
+
+    case AbstractImage::Type::LUMINANCE_16:
+    {
+      float v = static_cast<int16 const *>(scanline)[x] / 32767.0f; return ColorRGBA(v, v, v, 1);
+    }
+
+    case AbstractImage::Type::LUMINANCE_16U:
+    {
+      float v = static_cast<uint16 const *>(scanline)[x] / 65535.0f; return ColorRGBA(v, v, v, 1);
+    }
+
+    case AbstractImage::Type::LUMINANCE_32:
+    {
+      float v = (float)(static_cast<int32 const *>(scanline)[x] / 2147483647.0); return ColorRGBA(v, v, v, 1);
+    }
+
+    case AbstractImage::Type::LUMINANCE_32U:
+    {
+      float v = (float)(static_cast<uint32 const *>(scanline)[x] / 4294967295.0); return ColorRGBA(v, v, v, 1);
+    }
+
+    case AbstractImage::Type::LUMINANCE_32F:
+    {
+      float v = static_cast<float const *>(scanline)[x]; return ColorRGBA(v, v, v, 1);
+    }
+
+    case AbstractImage::Type::LUMINANCE_64F:
+    {
+      float v = (float)static_cast<double const *>(scanline)[x]; return ColorRGBA(v, v, v, 1);
+    }
+
+    case AbstractImage::Type::RGB_8U:
+    {
+      uint8 const * p = static_cast<uint8 const *>(scanline) + 3 * x;
+      return ColorRGBA(p[R] / 255.0f, p[G] / 255.0f, p[B] / 255.0f, 1);
+    }
+
+    case AbstractImage::Type::RGBA_8U:
+    {
+      uint8 const * p = static_cast<uint8 const *>(scanline) + 4 * x;
+      return ColorRGBA(p[R] / 255.0f, p[G] / 255.0f, p[B] / 255.0f, p[A] / 255.0f);
+    }
+
+    case AbstractImage::Type::RGB_16U:
+    {
+      uint16 const * p = static_cast<uint16 const *>(scanline) + 3 * x;
+      return ColorRGBA(p[R] / 65535.0f, p[G] / 65535.0f, p[B] / 65535.0f, 1);
+    }
+
+    case AbstractImage::Type::RGBA_16U:
+    {
+      uint16 const * p = static_cast<uint16 const *>(scanline) + 4 * x;
+      return ColorRGBA(p[R] / 65535.0f, p[G] / 65535.0f, p[B] / 65535.0f, p[A] / 65535.0f);
+    }
+
+    case AbstractImage::Type::RGB_32F:
+    {
+      float const * p = static_cast<float const *>(scanline) + 3 * x;
+      return ColorRGBA(p[R], p[G], p[B], 1);
+    }
+
+    case AbstractImage::Type::RGBA_32F:
+    {
+      float const * p = static_cast<float const *>(scanline) + 4 * x;
+      return ColorRGBA(p[R], p[G], p[B], p[A]);
+    }
+
+    default: throw Error("SoftwareTexture: Unsupported image type");
+  }
+}
+
+// Convert a floating-point value in [0, 1] to an unsigned integer with the specified maximum value, with clamping.
+static double
+SoftwareTexture__quantize(float value, double max_value)
+{
+  return std::floor(Math::clamp((double)value, 0.0, 1.0) * max_value + 0.5);
+}
+
+// Write a floating-point color to a pixel of an image scanline. For luminance images, the red channel is written.
+static void
+SoftwareTexture__writePixel(AbstractImage::Type type, void * scanline, int x, ColorRGBA const & c)
+{
+  static int const R = AbstractImage::Channel::RED, G = AbstractImage::Channel::GREEN, B = AbstractImage::Channel::BLUE,
+                   A = AbstractImage::Channel::ALPHA;
+
+  switch (type)
+  {
+    case AbstractImage::Type::LUMINANCE_8U:
+      static_cast<uint8 *>(scanline)[x] = (uint8)SoftwareTexture__quantize(c.r(), 255); break;
+
+    case AbstractImage::Type::LUMINANCE_16:
+      static_cast<int16 *>(scanline)[x] = (int16)SoftwareTexture__quantize(c.r(), 32767); break;
+
+    case AbstractImage::Type::LUMINANCE_16U:
+      static_cast<uint16 *>(scanline)[x] = (uint16)SoftwareTexture__quantize(c.r(), 65535); break;
+
+    case AbstractImage::Type::LUMINANCE_32:
+      static_cast<int32 *>(scanline)[x] = (int32)SoftwareTexture__quantize(c.r(), 2147483647.0); break;
+
+    case AbstractImage::Type::LUMINANCE_32U:
+      static_cast<uint32 *>(scanline)[x] = (uint32)SoftwareTexture__quantize(c.r(), 4294967295.0); break;
+
+    case AbstractImage::Type::LUMINANCE_32F:
+      static_cast<float *>(scanline)[x] = c.r(); break;
+
+    case AbstractImage::Type::LUMINANCE_64F:
+      static_cast<double *>(scanline)[x] = c.r(); break;
+
+    case AbstractImage::Type::RGB_8U:
+    {
+      uint8 * p = static_cast<uint8 *>(scanline) + 3 * x;
+      p[R] = (uint8)SoftwareTexture__quantize(c.r(), 255);
+      p[G] = (uint8)SoftwareTexture__quantize(c.g(), 255);
+      p[B] = (uint8)SoftwareTexture__quantize(c.b(), 255);
+      break;
+    }
+
+    case AbstractImage::Type::RGBA_8U:
+    {
+      uint8 * p = static_cast<uint8 *>(scanline) + 4 * x;
+      p[R] = (uint8)SoftwareTexture__quantize(c.r(), 255);
+      p[G] = (uint8)SoftwareTexture__quantize(c.g(), 255);
+      p[B] = (uint8)SoftwareTexture__quantize(c.b(), 255);
+      p[A] = (uint8)SoftwareTexture__quantize(c.a(), 255);
+      break;
+    }
+
+    case AbstractImage::Type::RGB_16U:
+    {
+      uint16 * p = static_cast<uint16 *>(scanline) + 3 * x;
+      p[R] = (uint16)SoftwareTexture__quantize(c.r(), 65535);
+      p[G] = (uint16)SoftwareTexture__quantize(c.g(), 65535);
+      p[B] = (uint16)SoftwareTexture__quantize(c.b(), 65535);
+      break;
+    }
+
+    case AbstractImage::Type::RGBA_16U:
+    {
+      uint16 * p = static_cast<uint16 *>(scanline) + 4 * x;
+      p[R] = (uint16)SoftwareTexture__quantize(c.r(), 65535);
+      p[G] = (uint16)SoftwareTexture__quantize(c.g(), 65535);
+      p[B] = (uint16)SoftwareTexture__quantize(c.b(), 65535);
+      p[A] = (uint16)SoftwareTexture__quantize(c.a(), 65535);
+      break;
+    }
+
+    case AbstractImage::Type::RGB_32F:
+    {
+      float * p = static_cast<float *>(scanline) + 3 * x;
+      p[R] = c.r(); p[G] = c.g(); p[B] = c.b();
+      break;
+    }
+
+    case AbstractImage::Type::RGBA_32F:
+    {
+      float * p = static_cast<float *>(scanline) + 4 * x;
+      p[R] = c.r(); p[G] = c.g(); p[B] = c.b(); p[A] = c.a();
+      break;
+    }
+
+    default: throw Error("SoftwareTexture: Unsupported image type");
+  }
+}
+
+SoftwareTexture::SoftwareTexture(SoftwareRenderSystem * render_system_, char const * name_, int width_, int height_,
+                                 int depth_, Format const * desired_format, Dimension dimension_, Options const & options_)
+: render_system(render_system_), name(name_), width(width_), height(height_), depth(depth_), dimension(dimension_),
+  options(options_)
+{
+  setInternalFormat(NULL, desired_format);
+  init();
+}
+
+SoftwareTexture::SoftwareTexture(SoftwareRenderSystem * render_system_, char const * name_, AbstractImage const & image,
+                                 Format const * desired_format, Dimension dimension_, Options const & options_)
+: render_system(render_system_), name(name_), width(image.getWidth()), height(image.getHeight()), depth(image.getDepth()),
+  dimension(dimension_), options(options_)
+{
+  if (dimension == Dimension::DIM_CUBE_MAP)
+    throw Error(std::string(getName()) + ": This constructor cannot be used to create a cube map");
+
+  if (!image.isValid())
+    throw Error(std::string(getName()) + ": Cannot construct texture from invalid image");
+
+  setInternalFormat(TextureFormat::fromImageType(image.getType()), desired_format);
+  init();
+  updateImage(image);
+}
+
+SoftwareTexture::SoftwareTexture(SoftwareRenderSystem * render_system_, char const * name_, AbstractImage const * images[6],
+                                 Format const * desired_format, Options const & options_)
+: render_system(render_system_), name(name_), dimension(Dimension::DIM_CUBE_MAP), options(options_)
+{
+  for (int i = 0; i < 6; ++i)
+  {
+    if (!images[i] || !images[i]->isValid())
+      throw Error(std::string(getName()) + ": Cannot construct cube map from invalid images");
+
+    if (images[i]->getType() != images[0]->getType()
+     || images[i]->getWidth() != images[0]->getWidth() || images[i]->getHeight() != images[0]->getHeight())
+      throw Error(std::string(getName()) + ": All six images of a cube map must have the same type and size");
+  }
+
+  width   =  images[0]->getWidth();
+  height  =  images[0]->getHeight();
+  depth   =  1;
+
+  setInternalFormat(TextureFormat::fromImageType(images[0]->getType()), desired_format);
+  init();
+
+  for (int i = 0; i < 6; ++i)
+    updateImage(*images[i], Face(i));
+}
+
+void
+SoftwareTexture::setInternalFormat(Format const * bytes_format, Format const * desired_format)
+{
+  if (desired_format == Format::AUTO())
+  {
+    if (!bytes_format)
+      throw Error(std::string(getName()) + ": Internal format cannot be automatically determined");
+
+    format = bytes_format;
+  }
+  else
+    format = desired_format;
+
+  if (format->compressed)
+    throw Error(std::string(getName()) + ": Compressed texture formats are not supported");
+
+  if (format->isDepth())
+    storage = Storage::DEPTH32F;
+  else if (format->floatingPoint
+        || std::max(std::max(format->redBits, format->greenBits), std::max(format->blueBits, format->alphaBits)) > 8
+        || format->luminanceBits > 8)
+    storage = Storage::RGBA32F;
+  else
+    storage = Storage::RGBA8;
+}
+
+void
+SoftwareTexture::init()
+{
+  if (width < 1 || height < 1 || depth < 1)
+    throw Error(std::string(getName()) + ": Texture must be at least one pixel wide in each dimension");
+
+  if (depth > 1 && dimension != Dimension::DIM_3D)
+    throw Error(std::string(getName()) + ": Only a 3D texture can have depth greater than one pixel");
+
+  if (dimension == Dimension::DIM_1D && height > 1)
+    throw Error(std::string(getName()) + ": A 1D texture cannot have height or depth greater than one pixel");
+
+  array_size_t num_texels = (array_size_t)(numLayers() * getLayerSize());
+  if (storage == Storage::RGBA8)
+    data8.resize(4 * num_texels, 0);
+  else
+    data32f.resize(numValuesPerTexel() * num_texels, 0.0f);
+}
+
+ColorRGBA
+SoftwareTexture::getTexel(int x, int y, int layer) const
+{
+  long i = (layer * (long)height + y) * (long)width + x;
+  switch (storage)
+  {
+    case Storage::RGBA8:
+    {
+      uint8 const * p = &data8[(array_size_t)(4 * i)];
+      return ColorRGBA(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f);
+    }
+
+    case Storage::RGBA32F:
+    {
+      float const * p = &data32f[(array_size_t)(4 * i)];
+      return ColorRGBA(p[0], p[1], p[2], p[3]);
+    }
+
+    default:
+    {
+      float d = data32f[(array_size_t)i];
+      return ColorRGBA(d, d, d, 1);
+    }
+  }
+}
+
+void
+SoftwareTexture::setTexel(int x, int y, int layer, ColorRGBA const & value)
+{
+  long i = (layer * (long)height + y) * (long)width + x;
+  switch (storage)
+  {
+    case Storage::RGBA8:
+    {
+      uint8 * p = &data8[(array_size_t)(4 * i)];
+      p[0] = (uint8)SoftwareTexture__quantize(value.r(), 255);
+      p[1] = (uint8)SoftwareTexture__quantize(value.g(), 255);
+      p[2] = (uint8)SoftwareTexture__quantize(value.b(), 255);
+      p[3] = (uint8)SoftwareTexture__quantize(value.a(), 255);
+      break;
+    }
+
+    case Storage::RGBA32F:
+    {
+      float * p = &data32f[(array_size_t)(4 * i)];
+      p[0] = value.r(); p[1] = value.g(); p[2] = value.b(); p[3] = value.a();
+      break;
+    }
+
+    default:
+      data32f[(array_size_t)i] = Math::clamp(value.r(), 0.0f, 1.0f);
+  }
+}
+
+void
+SoftwareTexture::updateImage(AbstractImage const & image, Face face)
+{
+  if (image.getWidth() != width || image.getHeight() != height || image.getDepth() != depth)
+    throw Error(std::string(getName()) + ": Image does not have the same size as the texture");
+
+  updateSubImage(image, 0, 0, 0, width, height, depth, 0, 0, 0, face);
+}
+
+void
+SoftwareTexture::updateSubImage(AbstractImage const & image, int src_x, int src_y, int src_z, int src_width, int src_height,
+                                int src_depth, int dst_x, int dst_y, int dst_z, Face face)
+{
+  if (!image.isValid())
+    throw Error(std::string(getName()) + ": Cannot update texture from invalid image");
+
+  if (src_x < 0 || src_y < 0 || src_z < 0 || src_x + src_width > image.getWidth() || src_y + src_height > image.getHeight()
+   || src_z + src_depth > image.getDepth())
+    throw Error(std::string(getName()) + ": Source block lies outside image");
+
+  if (dst_x < 0 || dst_y < 0 || dst_z < 0 || dst_x + src_width > width || dst_y + src_height > height
+   || dst_z + src_depth > depth)
+    throw Error(std::string(getName()) + ": Destination block lies outside texture");
+
+  AbstractImage::Type type = image.getType();
+  int layer0 = faceToLayer(face);
+  for (int k = 0; k < src_depth; ++k)
+    for (int j = 0; j < src_height; ++j)
+    {
+      void const * scanline = image.getScanLine(src_y + j, src_z + k);
+      for (int i = 0; i < src_width; ++i)
+        setTexel(dst_x + i, dst_y + j, layer0 + dst_z + k, SoftwareTexture__readPixel(type, scanline, src_x + i));
+    }
+}
+
+void
+SoftwareTexture::getImage(AbstractImage & image, Face face) const
+{
+  if (depth > 1) throw Error(std::string(getName()) + ": 3D images are not currently supported");
+
+  image.resize(image.getType(), width, height);
+  getSubImage(image, 0, 0, 0, width, height, 1, face);
+}
+
+void
+SoftwareTexture::getSubImage(AbstractImage & image, int x, int y, int z, int subimage_width, int subimage_height,
+                             int subimage_depth, Face face) const
+{
+  if (x < 0 || y < 0 || z < 0 || x + subimage_width > width || y + subimage_height > height || z + subimage_depth > depth)
+    throw Error(std::string(getName()) + ": Subimage lies outside texture");
+
+  if (image.getWidth() != subimage_width || image.getHeight() != subimage_height || image.getDepth() != subimage_depth)
+    image.resize(image.getType(), subimage_width, subimage_height, subimage_depth);
+
+  AbstractImage::Type type = image.getType();
+  int layer0 = faceToLayer(face);
+  for (int k = 0; k < subimage_depth; ++k)
+    for (int j = 0; j < subimage_height; ++j)
+    {
+      void * scanline = image.getScanLine(j, k);
+      for (int i = 0; i < subimage_width; ++i)
+        SoftwareTexture__writePixel(type, scanline, i, getTexel(x + i, y + j, layer0 + z + k));
+    }
+}
+
+ColorRGBA
+SoftwareTexture::wrappedTexel(int x, int y, int z) const
+{
+  switch (options.wrapMode)
+  {
+    case WrapMode::TILE:
+      x %= width;   if (x < 0) x += width;
+      y %= height;  if (y < 0) y += height;
+      z %= depth;   if (z < 0) z += depth;
+      break;
+
+    case WrapMode::ZERO:
+      if (x < 0 || x >= width || y < 0 || y >= height || z < 0 || z >= depth)
+        return ColorRGBA(0, 0, 0, 0);
+
+      break;
+
+    default:  // CLAMP
+      x = Math::clamp(x, 0, width - 1);
+      y = Math::clamp(y, 0, height - 1);
+      z = Math::clamp(z, 0, depth - 1);
+  }
+
+  return getTexel(x, y, z);
+}
+
+ColorRGBA
+SoftwareTexture::sample(Real s, Real t, Real r) const
+{
+  // Continuous texel coordinates, with texel centers at half-integers
+  Real u = s * width, v = t * height, w = (dimension == Dimension::DIM_3D ? r * depth : (Real)0.5);
+
+  if (options.interpolateMode == InterpolateMode::NEAREST_NO_MIPMAP
+   || options.interpolateMode == InterpolateMode::NEAREST_MIPMAP)
+  {
+    return wrappedTexel((int)std::floor(u), (int)std::floor(v), (int)std::floor(w));
+  }
+
+  u -= 0.5f; v -= 0.5f; w -= 0.5f;
+  int x0 = (int)std::floor(u), y0 = (int)std::floor(v), z0 = (int)std::floor(w);
+  Real fx = u - x0, fy = v - y0, fz = w - z0;
+
+  ColorRGBA c = (1 - fx) * (1 - fy) * wrappedTexel(x0,     y0,     z0)
+              +      fx  * (1 - fy) * wrappedTexel(x0 + 1, y0,     z0)
+              + (1 - fx) *      fy  * wrappedTexel(x0,     y0 + 1, z0)
+              +      fx  *      fy  * wrappedTexel(x0 + 1, y0 + 1, z0);
+
+  if (dimension == Dimension::DIM_3D && fz > 0)
+  {
+    ColorRGBA c1 = (1 - fx) * (1 - fy) * wrappedTexel(x0,     y0,     z0 + 1)
+                 +      fx  * (1 - fy) * wrappedTexel(x0 + 1, y0,     z0 + 1)
+                 + (1 - fx) *      fy  * wrappedTexel(x0,     y0 + 1, z0 + 1)
+                 +      fx  *      fy  * wrappedTexel(x0 + 1, y0 + 1, z0 + 1);
+
+    c = (1 - fz) * c + fz * c1;
+  }
+
+  return c;
+}
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
@@ -0,0 +1,192 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#ifndef __Thea_Graphics_Software_SoftwareTexture_hpp__
+#define __Thea_Graphics_Software_SoftwareTexture_hpp__
+
+#include "../../Graphics/Texture.hpp"
+#include "../../Array.hpp"
+#include "../../Colors.hpp"
+#include "SoftwareCommon.hpp"
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+class SoftwareRenderSystem;
+
+/**
+ * A texture stored in main memory, for the software rendersystem. Color formats with at most 8 bits per channel are stored as
+ * 8-bit RGBA, other color formats as 32-bit floating-point RGBA, and depth formats as a single 32-bit float per texel. Each
+ * cube map face is stored as a separate layer. Mipmaps are not generated: the mipmapped interpolation modes fall back to their
+ * non-mipmapped counterparts.
+ *
+ * Texels are laid out row by row, with row 0 at the bottom, like OpenGL textures and Thea images.
+ */
+class THEA_SOFTWARE_DLL_LOCAL SoftwareTexture : public Texture
+{
+  public:
+    /** Internal storage of texels (enum class). */
+    struct THEA_SOFTWARE_DLL_LOCAL Storage
+    {
+      /** Supported values. */
+      enum Value
+      {
+        RGBA8,     ///< Four 8-bit unsigned integer channels.
+        RGBA32F,   ///< Four 32-bit floating-point channels.
+        DEPTH32F   ///< A single 32-bit floating-point depth value.
+      };
+
+      THEA_ENUM_CLASS_BODY(Storage)
+    };
+
+    /** Constructs an empty texture of the specified format and size. */
+    SoftwareTexture(SoftwareRenderSystem * render_system_, char const * name_, int width_, int height_, int depth_,
+                    Format const * desired_format, Dimension dimension, Options const & options);
+
+    /** Constructs a texture from a pixel buffer. The dimension argument <em>cannot</em> be DIM_CUBE_MAP. */
+    SoftwareTexture(SoftwareRenderSystem * render_system_, char const * name_, AbstractImage const & image,
+                    Format const * desired_format, Dimension dimension, Options const & options);
+
+    /** Constructs a cube-map from six pixel buffers, representing 2D images of identical format and size. */
+    SoftwareTexture(SoftwareRenderSystem * render_system_, char const * name_, AbstractImage const * images[6],
+                    Format const * desired_format, Options const & options);
+
+    /** Get the parent rendersystem. */
+    SoftwareRenderSystem * getRenderSystem() const { return render_system; }
+
+    char const * getName() const { return name.c_str(); }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getDepth() const { return depth; }
+    Format const * getFormat() const { return format; }
+    Dimension getDimension() const { return dimension; }
+
+    void updateImage(AbstractImage const & image, Face face = Face::POS_X);
+    void updateSubImage(AbstractImage const & image, int src_x, int src_y, int src_z, int src_width, int src_height,
+                        int src_depth, int dst_x, int dst_y, int dst_z, Face face = Face::POS_X);
+
+    void getImage(AbstractImage & image, Face face = Face::POS_X) const;
+    void getSubImage(AbstractImage & image, int x, int y, int z, int subimage_width, int subimage_height, int subimage_depth,
+                     Face face = Face::POS_X) const;
+
+    /** Get the texture options. */
+    Options const & getOptions() const { return options; }
+
+    /** Get the internal storage type of the texels. */
+    Storage getStorage() const { return storage; }
+
+    /** Get the number of layers: 6 for a cube map, else the depth of the texture. */
+    int numLayers() const { return dimension == Dimension::DIM_CUBE_MAP ? 6 : depth; }
+
+    /** Get the number of texels in a single layer. */
+    long getLayerSize() const { return (long)width * (long)height; }
+
+    /**
+     * Get a pointer to the first 8-bit RGBA texel of a layer, or null if the texture does not have Storage::RGBA8. The four
+     * bytes of a texel are always in RGBA order.
+     */
+    uint8 * getData8(int layer = 0) { return data8.empty() ? NULL : &data8[(array_size_t)(4 * layer * getLayerSize())]; }
+
+    /** Get a pointer to the first 8-bit RGBA texel of a layer, or null if the texture does not have Storage::RGBA8. */
+    uint8 const * getData8(int layer = 0) const
+    { return data8.empty() ? NULL : &data8[(array_size_t)(4 * layer * getLayerSize())]; }
+
+    /**
+     * Get a pointer to the first floating-point value of a layer, or null if the texture has Storage::RGBA8. Each texel has
+     * four values (RGBA) for Storage::RGBA32F and one for Storage::DEPTH32F.
+     */
+    float * getData32F(int layer = 0)
+    { return data32f.empty() ? NULL : &data32f[(array_size_t)(numValuesPerTexel() * layer * getLayerSize())]; }
+
+    /** Get a pointer to the first floating-point value of a layer, or null if the texture has Storage::RGBA8. */
+    float const * getData32F(int layer = 0) const
+    { return data32f.empty() ? NULL : &data32f[(array_size_t)(numValuesPerTexel() * layer * getLayerSize())]; }
+
+    /** Get the value of a texel as a color. Depth values are replicated to the RGB channels. */
+    ColorRGBA getTexel(int x, int y, int layer = 0) const;
+
+    /** Set the value of a texel. For depth textures, only the red channel is used. */
+    void setTexel(int x, int y, int layer, ColorRGBA const & value);
+
+    /**
+     * Sample the texture at a (normalized) texture coordinate, respecting the wrap and interpolation modes of the texture. 1D
+     * and 2D textures ignore \a r. This function is threadsafe as long as the texture is not concurrently modified.
+     */
+    ColorRGBA sample(Real s, Real t, Real r = 0) const;
+
+  private:
+    /** Determine the internal storage format of the texture. */
+    void setInternalFormat(Format const * bytes_format, Format const * desired_format);
+
+    /** Do a series of checks to detect invalid parameters, and allocate storage. */
+    void init();
+
+    /** Number of floating-point values per texel, when the storage is floating-point. */
+    int numValuesPerTexel() const { return storage == Storage::DEPTH32F ? 1 : 4; }
+
+    /** Get the layer corresponding to a cube map face, or zero for other textures. */
+    int faceToLayer(Face face) const { return dimension == Dimension::DIM_CUBE_MAP ? (int)face : 0; }
+
+    /** Look up a texel, applying the wrap mode to out-of-range coordinates. */
+    ColorRGBA wrappedTexel(int x, int y, int z) const;
+
+    SoftwareRenderSystem * render_system;
+    std::string name;
+    int width;
+    int height;
+    int depth;
+    Format const * format;
+    Dimension dimension;
+    Options options;
+    Storage storage;
+    TheaArray<uint8> data8;
+    TheaArray<float> data32f;
+
+}; // class SoftwareTexture
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
+
+#endif
@@ -0,0 +1,140 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#include "SoftwareVAR.hpp"
+#include <cstring>
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+SoftwareVAR::SoftwareVAR()
+: area(NULL), capacity(0), pointer(NULL), generation(-1), component_type(ComponentType::NONE), num_components(0), elem_size(0),
+  num_elems(0)
+{
+}
+
+SoftwareVAR::SoftwareVAR(SoftwareVARArea * area_, long num_bytes)
+: area(area_), capacity(num_bytes), pointer(NULL), generation(-1), component_type(ComponentType::NONE), num_components(0),
+  elem_size(0), num_elems(0)
+{
+  alwaysAssertM(area_, "SoftwareVAR: Valid VAR area required");
+  alwaysAssertM(num_bytes > 0, "SoftwareVAR: Capacity must be greater than zero");
+
+  if (num_bytes > area_->getAvailableSize())
+    throw Error("SoftwareVAR: Not enough free space in VAR area to create VAR");
+
+  generation = area_->getCurrentGeneration();
+  pointer = (uint8 *)area_->getBasePointer() + area_->getAllocatedSize();
+
+  area_->incrementAllocated(num_bytes);
+}
+
+std::string
+SoftwareVAR::toString() const
+{
+  std::ostringstream oss;
+  oss << "Software VAR (" << capacity << " bytes)";
+  return oss.str();
+}
+
+#define SOFTWAREVAR_UPDATE_ARRAY(func_name, type_, component_type_, num_components_) \
+  void \
+  SoftwareVAR::func_name(long start_elem, long num_elems_to_update, type_ const * array) \
+  { \
+    if (num_elems_to_update <= 0) return; \
+    \
+    alwaysAssertM(isValid(), "SoftwareVAR: Can't update invalid VAR"); \
+    \
+    if (num_elems > 0) \
+    { \
+      alwaysAssertM(component_type == component_type_ && num_components == num_components_, \
+                    "SoftwareVAR: Can't update non-empty VAR with elements of a different type"); \
+    } \
+    else \
+    { \
+      component_type = component_type_; \
+      num_components = num_components_; \
+      elem_size = sizeof(type_); \
+    } \
+    \
+    long offset_bytes = start_elem * elem_size; \
+    long num_bytes = num_elems_to_update * elem_size; \
+    long total_size = offset_bytes + num_bytes; \
+    if (total_size > capacity) \
+      throw Error("SoftwareVAR: Can't update beyond end of VAR"); \
+    \
+    if (start_elem + num_elems_to_update > num_elems) \
+      num_elems = start_elem + num_elems_to_update; \
+    \
+    std::memcpy((uint8 *)pointer + offset_bytes, array, (size_t)num_bytes); \
+  }
+
+SOFTWAREVAR_UPDATE_ARRAY(updateVectors, float,    ComponentType::FLOAT32,  1)
+SOFTWAREVAR_UPDATE_ARRAY(updateVectors, Vector2,  ComponentType::FLOAT32,  2)
+SOFTWAREVAR_UPDATE_ARRAY(updateVectors, Vector3,  ComponentType::FLOAT32,  3)
+SOFTWAREVAR_UPDATE_ARRAY(updateVectors, Vector4,  ComponentType::FLOAT32,  4)
+
+SOFTWAREVAR_UPDATE_ARRAY(updateColors, ColorL,      ComponentType::FLOAT32,  1)
+SOFTWAREVAR_UPDATE_ARRAY(updateColors, ColorL8,     ComponentType::UINT8,    1)
+SOFTWAREVAR_UPDATE_ARRAY(updateColors, ColorL16,    ComponentType::UINT16,   1)
+SOFTWAREVAR_UPDATE_ARRAY(updateColors, ColorRGB,    ComponentType::FLOAT32,  3)
+SOFTWAREVAR_UPDATE_ARRAY(updateColors, ColorRGB8,   ComponentType::UINT8,    3)
+SOFTWAREVAR_UPDATE_ARRAY(updateColors, ColorRGBA,   ComponentType::FLOAT32,  4)
+SOFTWAREVAR_UPDATE_ARRAY(updateColors, ColorRGBA8,  ComponentType::UINT8,    4)
+
+SOFTWAREVAR_UPDATE_ARRAY(updateIndices, uint8,   ComponentType::UINT8,   1)
+SOFTWAREVAR_UPDATE_ARRAY(updateIndices, uint16,  ComponentType::UINT16,  1)
+SOFTWAREVAR_UPDATE_ARRAY(updateIndices, uint32,  ComponentType::UINT32,  1)
+
+void
+SoftwareVAR::clear()
+{
+  component_type = ComponentType::NONE;
+  num_components = 0;
+  elem_size = 0;
+  num_elems = 0;
+}
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
@@ -0,0 +1,187 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#ifndef __Thea_Graphics_Software_SoftwareVAR_hpp__
+#define __Thea_Graphics_Software_SoftwareVAR_hpp__
+
+#include "../../Graphics/VAR.hpp"
+#include "SoftwareCommon.hpp"
+#include "SoftwareVARArea.hpp"
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+/** A Vertex Area Range object for the software rendersystem, always stored in main memory. */
+class THEA_SOFTWARE_DLL_LOCAL SoftwareVAR : public VAR
+{
+  public:
+    /** Data type of a single component of an element (enum class). */
+    struct THEA_SOFTWARE_DLL_LOCAL ComponentType
+    {
+      /** Supported values. */
+      enum Value
+      {
+        NONE,     ///< No data has been stored yet.
+        FLOAT32,  ///< 32-bit floating point.
+        UINT8,    ///< 8-bit unsigned integer.
+        UINT16,   ///< 16-bit unsigned integer.
+        UINT32    ///< 32-bit unsigned integer.
+      };
+
+      THEA_ENUM_CLASS_BODY(ComponentType)
+    };
+
+    /** Default constructor. Creates an empty, invalid VAR. */
+    SoftwareVAR();
+
+    /**
+     * Constructor. Creates an empty VAR of the specified size. The VAR is not valid until it has been initialized with one of
+     * the <code>update...()</code> functions. \a area_ must be non-null and \a num_bytes must be greater than zero.
+     */
+    SoftwareVAR(SoftwareVARArea * area_, long num_bytes);
+
+    /** Get a string describing the VAR. */
+    std::string toString() const;
+
+    void updateVectors(long start_elem, long num_elems_to_update, float const * array);
+    void updateVectors(long start_elem, long num_elems_to_update, Vector2 const * array);
+    void updateVectors(long start_elem, long num_elems_to_update, Vector3 const * array);
+    void updateVectors(long start_elem, long num_elems_to_update, Vector4 const * array);
+
+    void updateColors(long start_elem, long num_elems_to_update, ColorL const * array);
+    void updateColors(long start_elem, long num_elems_to_update, ColorL8 const * array);
+    void updateColors(long start_elem, long num_elems_to_update, ColorL16 const * array);
+    void updateColors(long start_elem, long num_elems_to_update, ColorRGB const * array);
+    void updateColors(long start_elem, long num_elems_to_update, ColorRGB8 const * array);
+    void updateColors(long start_elem, long num_elems_to_update, ColorRGBA const * array);
+    void updateColors(long start_elem, long num_elems_to_update, ColorRGBA8 const * array);
+
+    void updateIndices(long start_elem, long num_elems_to_update, uint8 const * array);
+    void updateIndices(long start_elem, long num_elems_to_update, uint16 const * array);
+    void updateIndices(long start_elem, long num_elems_to_update, uint32 const * array);
+
+    void clear();
+
+    long numElements() const { return num_elems; }
+    long getCapacityInBytes() const { return capacity; }
+    bool isValid() const { return area && capacity > 0 && generation == area->getCurrentGeneration(); }
+
+    /** The data type of a single component. */
+    ComponentType getComponentType() const { return component_type; }
+
+    /** The number of components per element. */
+    int getNumComponents() const { return num_components; }
+
+    /** The size of an element in bytes. */
+    int getElementSize() const { return elem_size; }
+
+    /** Get the VARArea where this VAR is stored. */
+    SoftwareVARArea * getArea() const { return area; }
+
+    /** A pointer to the first element of the VAR. */
+    void * getBasePointer() const { return pointer; }
+
+    /** The generation of the parent VARArea when this VAR was created. */
+    int getGeneration() const { return generation; }
+
+    /**
+     * Read the components of an element as floating-point numbers, into the first getNumComponents() entries of \a values.
+     * Integer components are normalized to [0, 1] if \a normalize is true, else converted directly.
+     */
+    void getElement(long index, float * values, bool normalize) const
+    {
+      uint8 const * p = static_cast<uint8 const *>(pointer) + index * elem_size;
+      switch (component_type)
+      {
+        case ComponentType::FLOAT32:
+          for (int i = 0; i < num_components; ++i) values[i] = reinterpret_cast<float const *>(p)[i];
+          break;
+
+        case ComponentType::UINT8:
+          for (int i = 0; i < num_components; ++i) values[i] = p[i] * (normalize ? 1.0f / 255.0f : 1.0f);
+          break;
+
+        case ComponentType::UINT16:
+          for (int i = 0; i < num_components; ++i)
+            values[i] = reinterpret_cast<uint16 const *>(p)[i] * (normalize ? 1.0f / 65535.0f : 1.0f);
+          break;
+
+        case ComponentType::UINT32:
+          for (int i = 0; i < num_components; ++i)
+            values[i] = (float)(reinterpret_cast<uint32 const *>(p)[i] * (normalize ? 1.0 / 4294967295.0 : 1.0));
+          break;
+
+        default: break;
+      }
+    }
+
+    /** Read an element of an index array. */
+    uint32 getIndex(long index) const
+    {
+      switch (component_type)
+      {
+        case ComponentType::UINT8:   return static_cast<uint8  const *>(pointer)[index];
+        case ComponentType::UINT16:  return static_cast<uint16 const *>(pointer)[index];
+        case ComponentType::UINT32:  return static_cast<uint32 const *>(pointer)[index];
+        default: throw Error("SoftwareVAR: Array does not contain integer indices");
+      }
+    }
+
+  private:
+    SoftwareVARArea * area;
+    long capacity;
+    void * pointer;
+    int generation;
+
+    ComponentType component_type;
+    int num_components;
+    int elem_size;
+    long num_elems;
+
+}; // class SoftwareVAR
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
+
+#endif
@@ -0,0 +1,110 @@
+//============================================================================
+//
+// This file is part of the Thea project.
+//
+// This software is covered by the following BSD license, except for portions
+// derived from other works which are covered by their respective licenses.
+// For full licensing information including reproduction of these external
+// licenses, see the file LICENSE.txt provided in the documentation.
+//
+// Copyright (C) 2017, Siddhartha Chaudhuri
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the name of the copyright holders nor the names of contributors
+// to this software may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//============================================================================
+
+
+#include "SoftwareVARArea.hpp"
+#include "SoftwareVAR.hpp"
+
+namespace Thea {
+namespace Graphics {
+namespace Software {
+
+SoftwareVARArea::SoftwareVARArea(SoftwareRenderSystem * render_system_, char const * name_, long capacity_, Usage usage,
+                                 bool gpu_memory_)
+: render_system(render_system_), name(name_), capacity(capacity_), gpu_memory(gpu_memory_), base_pointer(NULL), generation(0),
+  allocated_size(0)
+{
+  alwaysAssertM(capacity > 0, std::string(getName()) + ": VAR area must have non-zero capacity");
+
+  base_pointer = new uint8[capacity];
+}
+
+SoftwareVARArea::~SoftwareVARArea()
+{
+  destroyAllArrays();
+  delete [] base_pointer;
+}
+
+void
+SoftwareVARArea::destroyAllArrays()
+{
+  for (VARSet::iterator vi = vars.begin(); vi != vars.end(); ++vi)
+    delete *vi;
+
+  vars.clear();
+}
+
+std::string
+SoftwareVARArea::toString() const
+{
+  std::ostringstream oss;
+  oss << "Software VARArea of capacity " << getCapacity() << " bytes in CPU memory, of which " << getAllocatedSize()
+      << " bytes are currently allocated";
+  return oss.str();
+}
+
+void
+SoftwareVARArea::reset()
+{
+  destroyAllArrays();
+
+  generation++;
+  allocated_size = 0;
+}
+
+VAR *
+SoftwareVARArea::createArray(long num_bytes)
+{
+  VAR * v = new SoftwareVAR(this, num_bytes);
+  if (v) vars.insert(v);
+  return v;
+}
+
+void
+SoftwareVARArea::destroyArray(VAR * array)
+{
+  vars.erase(array);
+  delete array;
+}
+
+} // namespace Software
+} // namespace Graphics
+} // namespace Thea
@@ -0,0 +1,199 @@
+#include "../Common.hpp"
+#include "../Algorithms/BestFitBox3.hpp"
+#include "../Array.hpp"
+#include "../Math.hpp"
+#include "../Matrix3.hpp"
+#include "../Random.hpp"
+#include "../Vector3.hpp"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+bool testRotatedBox(bool use_up);
+bool testDegenerate();
+
+int
+main(int argc, char * argv[])
+{
+  try
+  {
+    if (!testRotatedBox(false)) return -1;
+    if (!testRotatedBox(true)) return -1;
+    if (!testDegenerate()) return -1;
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "An error occurred")
+
+  cout << "Test passed" << endl;
+  return 0;
+}
+
+static Real const TOLERANCE = 1.0e-4f;
+
+// Compute the best-fit box of a set of points with a given method, and check that it contains all the points.
+bool
+fitBox(TheaArray<Vector3> const & points, BestFitBox3::Method method, Vector3 const * up, Box3 & box)
+{
+  BestFitBox3 fitter(method);
+  if (up)
+    fitter.setUpVector(*up);
+
+  for (array_size_t i = 0; i < points.size(); ++i)
+    fitter.addPoint(points[i]);
+
+  box = fitter.getBox();
+
+  Vector3 ext = box.getExtent();
+  if (!Math::isFinite(ext.x()) || !Math::isFinite(ext.y()) || !Math::isFinite(ext.z()))
+  {
+    cerr << "Box computed by method " << method.toString() << " has non-finite extents" << endl;
+    return false;
+  }
+
+  AxisAlignedBox3 const & local = box.getLocalAAB();
+  for (array_size_t i = 0; i < points.size(); ++i)
+  {
+    Vector3 p = box.getLocalFrame().pointToObjectSpace(points[i]);
+    Vector3 outside = (local.getLow() - p).max(p - local.getHigh());
+    if (outside.max() > TOLERANCE)
+    {
+      cerr << "Box computed by method " << method.toString() << " does not contain point " << i << endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Real
+volume(Box3 const & box)
+{
+  Vector3 ext = box.getExtent();
+  return ext.x() * ext.y() * ext.z();
+}
+
+bool
+testRotatedBox(bool use_up)
+{
+  cout << "\nTesting best-fit box of a rotated 4 x 2 x 0.6 box" << (use_up ? ", with up vector" : "") << endl;
+
+  Vector3 const HALF_EXT(2.0f, 1.0f, 0.3f);
+  Real const TRUE_VOLUME = 8 * HALF_EXT.x() * HALF_EXT.y() * HALF_EXT.z();
+  Matrix3 rot = Matrix3::rotationAxisAngle(Vector3(1, 2, 3).unit(), 0.7f);
+
+  // Random points filling the box, so that the tightest box is slightly smaller than, but close to, the true one
+  Random rng(1234);
+  TheaArray<Vector3> points;
+  for (int i = 0; i < 20000; ++i)
+  {
+    Vector3 p(rng.uniform(-HALF_EXT.x(), HALF_EXT.x()), rng.uniform(-HALF_EXT.y(), HALF_EXT.y()),
+              rng.uniform(-HALF_EXT.z(), HALF_EXT.z()));
+    points.push_back(rot * p);
+  }
+
+  Vector3 up = rot * Vector3(0, 0, 1);
+  Box3 hull_box, brute_box;
+  if (!fitBox(points, BestFitBox3::Method::CONVEX_HULL, use_up ? &up : NULL, hull_box)) return false;
+  if (!fitBox(points, BestFitBox3::Method::BRUTE_FORCE, use_up ? &up : NULL, brute_box)) return false;
+
+  Real hull_vol = volume(hull_box), brute_vol = volume(brute_box);
+  cout << "True volume = " << TRUE_VOLUME << ", convex hull volume = " << hull_vol << ", brute force volume = " << brute_vol
+       << endl;
+
+  if (std::fabs(hull_vol - TRUE_VOLUME) > 0.02f * TRUE_VOLUME)
+  {
+    cerr << "Convex hull method did not find a box close to the true one" << endl;
+    return false;
+  }
+
+  if (hull_vol > brute_vol * (1 + TOLERANCE))
+  {
+    cerr << "Convex hull method found a larger box than the brute force method" << endl;
+    return false;
+  }
+
+  if (use_up)
+  {
+    // One of the box axes must be the up vector
+    Real max_dot = 0;
+    for (int i = 0; i < 3; ++i)
+      max_dot = std::max(max_dot, std::fabs(hull_box.getLocalFrame().getAxis(i).dot(up)));
+
+    if (max_dot < 1 - TOLERANCE)
+    {
+      cerr << "Box computed with an up vector is not aligned with it" << endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+testDegenerate()
+{
+  cout << "\nTesting best-fit boxes of degenerate point sets" << endl;
+
+  Matrix3 rot = Matrix3::rotationAxisAngle(Vector3(-1, 1, 2).unit(), 1.1f);
+
+  // Points on a rotated 4 x 2 rectangle
+  Random rng(1234);
+  TheaArray<Vector3> planar;
+  for (int i = 0; i < 1000; ++i)
+    planar.push_back(rot * Vector3(rng.uniform(-2, 2), rng.uniform(-1, 1), 0));
+
+  for (int i = 0; i < 4; ++i)
+    planar.push_back(rot * Vector3((i & 1) ? 2 : -2, (i & 2) ? 1 : -1, 0));
+
+  // A few copies of a single point, and points on a line
+  TheaArray<Vector3> coincident(10, Vector3(1, -2, 3));
+  TheaArray<Vector3> collinear;
+  Real t_min = 1, t_max = -1;
+  for (int i = 0; i < 100; ++i)
+  {
+    Real t = rng.uniform(-1, 1);
+    collinear.push_back(Vector3(1, -2, 3) + t * Vector3(1, 1, 1));
+    t_min = std::min(t, t_min); t_max = std::max(t, t_max);
+  }
+
+  Real line_length = (t_max - t_min) * std::sqrt((Real)3);
+
+  Vector3 up = rot * Vector3(0, 1, 0);
+  for (int use_up = 0; use_up < 2; ++use_up)
+  {
+    Vector3 const * up_ptr = (use_up ? &up : NULL);
+
+    Box3 box;
+    if (!fitBox(planar, BestFitBox3::Method::CONVEX_HULL, up_ptr, box)) return false;
+
+    // The box should be flat, and its largest face should be close to the rectangle
+    Vector3 ext = box.getExtent();
+    Real area = std::max(std::max(ext.x() * ext.y(), ext.y() * ext.z()), ext.z() * ext.x());
+    if (ext.min() > TOLERANCE || std::fabs(area - 8) > 0.01f * 8)
+    {
+      cerr << "Bad box for planar points: extent = " << ext.toString() << endl;
+      return false;
+    }
+
+    if (!fitBox(coincident, BestFitBox3::Method::CONVEX_HULL, up_ptr, box)) return false;
+    if (box.getExtent().max() > TOLERANCE)
+    {
+      cerr << "Bad box for coincident points: extent = " << box.getExtent().toString() << endl;
+      return false;
+    }
+
+    if (!fitBox(collinear, BestFitBox3::Method::CONVEX_HULL, up_ptr, box)) return false;
+
+    // The box of points on a line should have zero volume, and (without an up vector) be as long as the line
+    Vector3 line_ext = box.getExtent();
+    if (volume(box) > TOLERANCE || (!use_up && std::fabs(line_ext.max() - line_length) > TOLERANCE * line_length))
+    {
+      cerr << "Bad box for collinear points: extent = " << line_ext.toString() << endl;
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -13,6 +13,8 @@ using namespace Thea;
 using namespace Algorithms;
 
 bool testCSPARSE(int argc, char * argv[]);
+bool testFactoredSolve(LinearSolver * ls, CompressedColumnMatrix<double, int, int> const & a, string const & method,
+                       long num_rhs);
 int cleanup(int status);
 
 int
@@ -96,6 +98,46 @@ testCSPARSE(int argc, char * argv[])
     ok = false;
   }
 
+  // Factor once and solve for a block of constant vectors. The last (larger) system is split across threads.
+  if (ok)
+  {
+    CSC sq(A);
+    ok = testFactoredSolve(ls, sq, "LU", 5) && testFactoredSolve(ls, sq, "QR", 5);
+  }
+
+  if (ok)
+  {
+    Matrix<double> S(3, 3, 0.0), R(4, 3, 0.0);
+    S(0, 0) = 4; S(0, 1) = 1;
+    S(1, 0) = 1; S(1, 1) = 3; S(1, 2) = 1;
+    S(2, 1) = 1; S(2, 2) = 2;
+
+    R(0, 0) = 1; R(1, 1) = 2; R(2, 2) = 3; R(3, 0) = 1; R(3, 2) = 1;
+
+    ok = testFactoredSolve(ls, CSC(S), "Cholesky", 5)
+      && testFactoredSolve(ls, CSC(R), "QR", 5)
+      && testFactoredSolve(ls, CSC(R.transpose()), "QR", 5);
+  }
+
+  if (ok)
+  {
+    // Shifted Laplacian of a 2D grid (symmetric positive-definite)
+    static long const GRID_SIZE = 40, N = GRID_SIZE * GRID_SIZE;
+    Matrix<double> L(N, N, 0.0);
+    for (long i = 0; i < GRID_SIZE; ++i)
+      for (long j = 0; j < GRID_SIZE; ++j)
+      {
+        long r = i * GRID_SIZE + j;
+        L(r, r) = 5;
+        if (i > 0)             L(r, r - GRID_SIZE) = -1;
+        if (i < GRID_SIZE - 1) L(r, r + GRID_SIZE) = -1;
+        if (j > 0)             L(r, r - 1) = -1;
+        if (j < GRID_SIZE - 1) L(r, r + 1) = -1;
+      }
+
+    ok = testFactoredSolve(ls, CSC(L), "Cholesky", 200);
+  }
+
   // Destroy the linear solver
   factory->destroyLinearSolver(ls);
 
@@ -105,6 +147,54 @@ testCSPARSE(int argc, char * argv[])
   return ok;
 }
 
+bool
+testFactoredSolve(LinearSolver * ls, CompressedColumnMatrix<double, int, int> const & a, string const & method, long num_rhs)
+{
+  long m = a.numRows(), n = a.numColumns();
+
+  TheaArray<double> rhs((array_size_t)(m * num_rhs));
+  for (array_size_t i = 0; i < rhs.size(); ++i)
+    rhs[i] = (double)((i * 7919) % 23) - 11;
+
+  Options opts;
+  opts.set("method", method);
+  opts.set("max-threads", 4L);
+
+  ls->setCoefficients(a);
+  if (!ls->factorize(opts))
+  {
+    cout << method << ": Could not factor coefficient matrix" << endl;
+    return false;
+  }
+
+  TheaArray<double> solutions((array_size_t)(n * num_rhs));
+  if (!ls->solveFactored(num_rhs, &rhs[0], &solutions[0]))
+  {
+    cout << method << ": Could not solve factored system" << endl;
+    return false;
+  }
+
+  // Compare with solving each system from scratch
+  double max_diff = 0;
+  for (long k = 0; k < num_rhs; ++k)
+  {
+    ls->setConstants(rhs.begin() + k * m, rhs.begin() + (k + 1) * m);
+    if (!ls->solve(opts))
+    {
+      cout << method << ": Could not solve system " << k << endl;
+      return false;
+    }
+
+    for (long i = 0; i < n; ++i)
+      max_diff = std::max(max_diff, std::fabs(ls->getSolution()[(array_size_t)i] - solutions[(array_size_t)(k * n + i)]));
+  }
+
+  printf("%s: Factored solution of %ldx%ld system for %ld constant vectors differs from direct solution by %g\n",
+         method.c_str(), m, n, num_rhs, max_diff);
+
+  return max_diff < 1e-8;
+}
+
 int
 cleanup(int status)
 {
@@ -0,0 +1,249 @@
+#include "../Algorithms/Clustering.hpp"
+#include "../Common.hpp"
+#include "../Array.hpp"
+#include "../Math.hpp"
+#include "../Matrix.hpp"
+#include "../Random.hpp"
+#include "../Vector3.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+typedef Clustering::Linkage Linkage;
+typedef Clustering::Merge Merge;
+
+bool testNNChain(Linkage linkage);
+bool testGraphClustering();
+bool testWeightMatrixClustering();
+void naiveMergeDistances(TheaArray<Vector3> const & points, Linkage linkage, TheaArray<double> & dists);
+void makeBlobs(long num_blobs, long points_per_blob, Real spread, TheaArray<Vector3> & points, TheaArray<int> & blob_labels);
+bool samePartition(TheaArray<int> const & a, TheaArray<int> const & b);
+
+int
+main(int argc, char * argv[])
+{
+  if (!testNNChain(Linkage::WARD)) return -1;
+  if (!testNNChain(Linkage::AVERAGE)) return -1;
+  if (!testNNChain(Linkage::COMPLETE)) return -1;
+  if (!testGraphClustering()) return -1;
+  if (!testWeightMatrixClustering()) return -1;
+
+  cout << "Test passed" << endl;
+  return 0;
+}
+
+bool
+testNNChain(Linkage linkage)
+{
+  cout << "\nNearest-neighbor chain with linkage " << (int)linkage << endl;
+
+  static long const NUM_POINTS = 80;
+  Random rng(4321);
+  TheaArray<Vector3> points(NUM_POINTS);
+  for (long i = 0; i < NUM_POINTS; ++i)
+    points[(array_size_t)i] = Vector3(rng.uniform01(), rng.uniform01(), rng.uniform01());
+
+  TheaArray<Merge> merges;
+  Clustering::HierarchicalOptions options(Clustering::HierarchicalMethod::NN_CHAIN, linkage);
+  long num_merges = Clustering::computeHierarchical(points, merges, options);
+  if (num_merges != NUM_POINTS - 1)
+  {
+    cerr << "Expected " << NUM_POINTS - 1 << " merges, found " << num_merges << endl;
+    return false;
+  }
+
+  // Compare merge heights with the naive cubic-time algorithm
+  TheaArray<double> expected;
+  naiveMergeDistances(points, linkage, expected);
+
+  for (array_size_t i = 0; i < merges.size(); ++i)
+  {
+    if (std::fabs(merges[i].distance - expected[i]) > 1e-5 * (1 + expected[i]))
+    {
+      cerr << "Merge " << i << " has distance " << merges[i].distance << ", expected " << expected[i] << endl;
+      return false;
+    }
+
+    if (merges[i].first >= NUM_POINTS + (long)i || merges[i].second >= NUM_POINTS + (long)i)
+    {
+      cerr << "Merge " << i << " refers to a cluster that does not exist yet" << endl;
+      return false;
+    }
+  }
+
+  cout << "Final merge distance = " << merges.back().distance << endl;
+  return true;
+}
+
+bool
+testGraphClustering()
+{
+  cout << "\nk-NN graph clustering" << endl;
+
+  TheaArray<Vector3> points;
+  TheaArray<int> blob_labels;
+  makeBlobs(5, 400, 0.1f, points, blob_labels);
+
+  // Fixed-dimensional points use a kd-tree to build the graph
+  TheaArray<int> labels;
+  Clustering::FlatOptions options(Clustering::FlatMethod::GRAPH_AGGLOMERATIVE);
+  options.num_nearest_neighbors = 8;
+  int num_clusters = Clustering::computeFlat(points, labels, options, 5);
+  if (num_clusters != 5 || !samePartition(labels, blob_labels))
+  {
+    cerr << "k-NN graph clustering did not recover the blobs (found " << num_clusters << " clusters)" << endl;
+    return false;
+  }
+
+  // Variable-dimensional points use brute-force neighbor search, and should give the same hierarchy
+  TheaArray< TheaArray<double> > array_points(points.size());
+  for (array_size_t i = 0; i < points.size(); ++i)
+    array_points[i] = TheaArray<double>(points[i].begin(), points[i].end());
+
+  TheaArray<Merge> merges, array_merges;
+  Clustering::HierarchicalOptions hoptions(Clustering::HierarchicalMethod::KNN_GRAPH, Clustering::Linkage::AVERAGE, 8);
+  Clustering::computeHierarchical(points, merges, hoptions);
+  Clustering::computeHierarchical(array_points, array_merges, hoptions);
+
+  if (merges.size() != array_merges.size())
+  {
+    cerr << "Brute-force and kd-tree neighbor graphs give different hierarchies" << endl;
+    return false;
+  }
+
+  for (array_size_t i = 0; i < merges.size(); ++i)
+    if (std::fabs(merges[i].distance - array_merges[i].distance) > 1e-5 || merges[i].size != array_merges[i].size)
+    {
+      cerr << "Brute-force and kd-tree neighbor graphs give different merge " << i << endl;
+      return false;
+    }
+
+  cout << "Recovered " << num_clusters << " blobs" << endl;
+  return true;
+}
+
+bool
+testWeightMatrixClustering()
+{
+  cout << "\nWeight matrix clustering" << endl;
+
+  // Three cliques with strong internal edges, joined in a chain by weak edges
+  static long const CLIQUE_SIZE = 6;
+  static long const NUM_CLIQUES = 3;
+  long n = CLIQUE_SIZE * NUM_CLIQUES;
+  Matrix<double> weights(n, n, 0.0);
+  TheaArray<int> clique_labels((array_size_t)n);
+  for (long i = 0; i < n; ++i)
+  {
+    clique_labels[(array_size_t)i] = (int)(i / CLIQUE_SIZE);
+    for (long j = 0; j < n; ++j)
+      if (i != j && i / CLIQUE_SIZE == j / CLIQUE_SIZE)
+        weights(i, j) = 1.0 + 0.01 * ((i + j) % 3);
+  }
+
+  for (long c = 0; c + 1 < NUM_CLIQUES; ++c)
+  {
+    long i = c * CLIQUE_SIZE, j = (c + 1) * CLIQUE_SIZE;
+    weights(i, j) = weights(j, i) = 0.1;
+  }
+
+  TheaArray<int> labels;
+  int num_clusters = Clustering::computeFlat(weights, labels,
+                                             Clustering::FlatOptions(Clustering::FlatMethod::GRAPH_AGGLOMERATIVE), 3);
+  if (num_clusters != 3 || !samePartition(labels, clique_labels))
+  {
+    cerr << "Weight matrix clustering did not recover the cliques (found " << num_clusters << " clusters)" << endl;
+    return false;
+  }
+
+  cout << "Recovered " << num_clusters << " cliques" << endl;
+  return true;
+}
+
+void
+naiveMergeDistances(TheaArray<Vector3> const & points, Linkage linkage, TheaArray<double> & dists)
+{
+  array_size_t n = points.size();
+  TheaArray< TheaArray<array_size_t> > clusters(n);
+  for (array_size_t i = 0; i < n; ++i)
+    clusters[i].push_back(i);
+
+  dists.clear();
+  while (clusters.size() > 1)
+  {
+    double best = -1;
+    array_size_t best_a = 0, best_b = 0;
+    for (array_size_t a = 0; a < clusters.size(); ++a)
+      for (array_size_t b = a + 1; b < clusters.size(); ++b)
+      {
+        double d = 0;
+        if (linkage == Linkage::WARD)
+        {
+          Vector3 ca = Vector3::zero(), cb = Vector3::zero();
+          for (array_size_t i = 0; i < clusters[a].size(); ++i) ca += points[clusters[a][i]];
+          for (array_size_t i = 0; i < clusters[b].size(); ++i) cb += points[clusters[b][i]];
+          double na = (double)clusters[a].size(), nb = (double)clusters[b].size();
+          ca /= (Real)na; cb /= (Real)nb;
+          d = std::sqrt(2 * na * nb / (na + nb)) * (ca - cb).length();
+        }
+        else
+        {
+          for (array_size_t i = 0; i < clusters[a].size(); ++i)
+            for (array_size_t j = 0; j < clusters[b].size(); ++j)
+            {
+              double pd = (points[clusters[a][i]] - points[clusters[b][j]]).length();
+              if (linkage == Linkage::AVERAGE)
+                d += pd / (clusters[a].size() * clusters[b].size());
+              else
+                d = std::max(d, pd);
+            }
+        }
+
+        if (best < 0 || d < best)
+        {
+          best = d;
+          best_a = a;
+          best_b = b;
+        }
+      }
+
+    dists.push_back(best);
+    clusters[best_a].insert(clusters[best_a].end(), clusters[best_b].begin(), clusters[best_b].end());
+    clusters.erase(clusters.begin() + best_b);
+  }
+}
+
+void
+makeBlobs(long num_blobs, long points_per_blob, Real spread, TheaArray<Vector3> & points, TheaArray<int> & blob_labels)
+{
+  Random rng(1234);
+  points.clear();
+  blob_labels.clear();
+  for (long i = 0; i < num_blobs; ++i)
+  {
+    Vector3 center((Real)(2 * i), (Real)(i % 2), 0);
+    for (long j = 0; j < points_per_blob; ++j)
+    {
+      points.push_back(center + Vector3(rng.gaussian(0, spread), rng.gaussian(0, spread), rng.gaussian(0, spread)));
+      blob_labels.push_back((int)i);
+    }
+  }
+}
+
+bool
+samePartition(TheaArray<int> const & a, TheaArray<int> const & b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  for (array_size_t i = 0; i < a.size(); ++i)
+    for (array_size_t j = i + 1; j < a.size(); ++j)
+      if ((a[i] == a[j]) != (b[i] == b[j]))
+        return false;
+
+  return true;
+}
@@ -0,0 +1,169 @@
+#include "../Common.hpp"
+#include "../Algorithms/DiscreteExponentialMap.hpp"
+#include "../Algorithms/SampleGraph.hpp"
+#include "../Array.hpp"
+#include "../Math.hpp"
+#include "../Random.hpp"
+#include "../Vector3.hpp"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+bool testParametrizeBatch(bool blend_upwind);
+
+int
+main(int argc, char * argv[])
+{
+  try
+  {
+    if (!testParametrizeBatch(false)) return -1;
+    if (!testParametrizeBatch(true)) return -1;
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "An error occurred")
+
+  cout << "Test passed" << endl;
+  return 0;
+}
+
+static long const NUM_SAMPLES = 2000;
+static long const NUM_ORIGINS = 40;
+static long const GRID_SIZE = 12;
+static long const NUM_CHANNELS = 3;
+static Real const RADIUS = 0.2f;
+
+// Resample the current parametrization of a discrete exponential map onto a grid, in the same way as parametrizeBatch().
+void
+resampleParameterMap(DiscreteExponentialMap const & dem, Real const * sample_values, Real * patch, Real * coverage)
+{
+  for (long i = 0; i < GRID_SIZE * GRID_SIZE; ++i)
+  {
+    coverage[i] = 0;
+    for (long c = 0; c < NUM_CHANNELS; ++c)
+      patch[i * NUM_CHANNELS + c] = 0;
+  }
+
+  Real scale = 0.5f * GRID_SIZE / RADIUS;
+  DiscreteExponentialMap::ParameterMap const & params = dem.getParameterMap();
+  for (DiscreteExponentialMap::ParameterMap::const_iterator pi = params.begin(); pi != params.end(); ++pi)
+  {
+    // Cell centers are at half-integer grid coordinates
+    Real gx = (pi->second.x() + RADIUS) * scale - 0.5f;
+    Real gy = (pi->second.y() + RADIUS) * scale - 0.5f;
+    long ix = (long)std::floor(gx), iy = (long)std::floor(gy);
+    Real fx = gx - ix, fy = gy - iy;
+
+    for (int dy = 0; dy < 2; ++dy)
+      for (int dx = 0; dx < 2; ++dx)
+      {
+        long x = ix + dx, y = iy + dy;
+        Real w = (dx ? fx : 1 - fx) * (dy ? fy : 1 - fy);
+        if (x < 0 || y < 0 || x >= GRID_SIZE || y >= GRID_SIZE || w <= 0)
+          continue;
+
+        long cell = y * GRID_SIZE + x;
+        coverage[cell] += w;
+        for (long c = 0; c < NUM_CHANNELS; ++c)
+          patch[cell * NUM_CHANNELS + c] += w * sample_values[pi->first * NUM_CHANNELS + c];
+      }
+  }
+
+  for (long i = 0; i < GRID_SIZE * GRID_SIZE; ++i)
+    if (coverage[i] > 0)
+      for (long c = 0; c < NUM_CHANNELS; ++c)
+        patch[i * NUM_CHANNELS + c] /= coverage[i];
+}
+
+bool
+testParametrizeBatch(bool blend_upwind)
+{
+  cout << "\nTesting batched exponential maps (blend upwind = " << blend_upwind << ')' << endl;
+
+  // A bumpy height field, with the position of each sample as its value
+  Random rng(1234);
+  TheaArray<Vector3> points((array_size_t)NUM_SAMPLES), normals((array_size_t)NUM_SAMPLES, Vector3(0, 0, 1));
+  TheaArray<Real> sample_values((array_size_t)(NUM_SAMPLES * NUM_CHANNELS));
+  for (long i = 0; i < NUM_SAMPLES; ++i)
+  {
+    Real x = rng.uniform(-1, 1), y = rng.uniform(-1, 1);
+    points[(array_size_t)i] = Vector3(x, y, 0.2f * std::sin(3 * x) * std::cos(2 * y));
+
+    for (long c = 0; c < NUM_CHANNELS; ++c)
+      sample_values[(array_size_t)(i * NUM_CHANNELS + c)] = points[(array_size_t)i][c];
+  }
+
+  SampleGraph graph;
+  graph.setSamples(NUM_SAMPLES, &points[0], &normals[0]);
+  graph.init();
+
+  TheaArray<long> origins((array_size_t)NUM_ORIGINS);
+  TheaArray<Vector3> u_axes((array_size_t)NUM_ORIGINS), v_axes((array_size_t)NUM_ORIGINS);
+  for (long i = 0; i < NUM_ORIGINS; ++i)
+  {
+    origins[(array_size_t)i] = rng.integer(0, NUM_SAMPLES - 1);
+
+    Real angle = rng.uniform(0, Math::twoPi());
+    u_axes[(array_size_t)i] = Vector3(std::cos(angle), std::sin(angle), 0);
+    v_axes[(array_size_t)i] = Vector3(-std::sin(angle), std::cos(angle), 0);
+  }
+
+  // The batch ignores normalization, so turn it off for the single-origin parametrizations
+  DiscreteExponentialMap dem(DiscreteExponentialMap::Options().setNormalize(false).setBlendUpwind(blend_upwind));
+
+  static long const NUM_THREADS = 4;
+  long patch_size = GRID_SIZE * GRID_SIZE * NUM_CHANNELS;
+  TheaArray<Real> patches((array_size_t)(NUM_ORIGINS * patch_size));
+  TheaArray<Real> coverage((array_size_t)(NUM_ORIGINS * GRID_SIZE * GRID_SIZE));
+  dem.parametrizeBatch(graph, NUM_ORIGINS, &origins[0], &u_axes[0], &v_axes[0], RADIUS, GRID_SIZE, NUM_CHANNELS,
+                       &sample_values[0], &patches[0], &coverage[0], NUM_THREADS);
+
+  // Each thread reuses its scratch space across origins, so the results should not depend on the number of threads
+  TheaArray<Real> serial_patches(patches.size()), serial_coverage(coverage.size());
+  dem.parametrizeBatch(graph, NUM_ORIGINS, &origins[0], &u_axes[0], &v_axes[0], RADIUS, GRID_SIZE, NUM_CHANNELS,
+                       &sample_values[0], &serial_patches[0], &serial_coverage[0], 1);
+
+  if (patches != serial_patches || coverage != serial_coverage)
+  {
+    cerr << "Batched exponential maps with " << NUM_THREADS << " threads differ from those with one thread" << endl;
+    return false;
+  }
+
+  // Compare each patch to the one resampled from a separate parametrization around its origin
+  static Real const TOLERANCE = 1.0e-4f;
+  long num_covered = 0;
+  TheaArray<Real> patch((array_size_t)patch_size), patch_coverage((array_size_t)(GRID_SIZE * GRID_SIZE));
+  for (long i = 0; i < NUM_ORIGINS; ++i)
+  {
+    dem.parametrize(graph, origins[(array_size_t)i], u_axes[(array_size_t)i], v_axes[(array_size_t)i], RADIUS);
+    resampleParameterMap(dem, &sample_values[0], &patch[0], &patch_coverage[0]);
+
+    for (long j = 0; j < GRID_SIZE * GRID_SIZE; ++j)
+    {
+      Real batch_coverage = coverage[(array_size_t)(i * GRID_SIZE * GRID_SIZE + j)];
+      bool ok = (std::fabs(batch_coverage - patch_coverage[(array_size_t)j]) <= TOLERANCE);
+      for (long c = 0; ok && c < NUM_CHANNELS; ++c)
+        ok = (std::fabs(patches[(array_size_t)(i * patch_size + j * NUM_CHANNELS + c)]
+                      - patch[(array_size_t)(j * NUM_CHANNELS + c)]) <= TOLERANCE);
+
+      if (!ok)
+      {
+        cerr << "Cell " << j << " of batched patch " << i << " does not match the patch from parametrize()" << endl;
+        return false;
+      }
+
+      if (batch_coverage > 0)
+        num_covered++;
+    }
+  }
+
+  // Make sure the comparison was not vacuous
+  if (num_covered < NUM_ORIGINS * GRID_SIZE * GRID_SIZE / 4)
+  {
+    cerr << "Only " << num_covered << " cells of the batched patches are covered" << endl;
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,305 @@
+#include "../Common.hpp"
+#include "../Array.hpp"
+#include "../BasicStringAlg.hpp"
+#include "../FeatureFile.hpp"
+#include "../Math.hpp"
+#include "../Random.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+
+bool testFloat16();
+bool testFeatureFile(long num_points);
+bool testCorruptFeatureFile();
+
+int
+main(int argc, char * argv[])
+{
+  if (!testFloat16()) return -1;
+  if (!testFeatureFile(1000)) return -1;
+  if (!testFeatureFile(0)) return -1;
+  if (!testCorruptFeatureFile()) return -1;
+
+  cout << "Test passed" << endl;
+  return 0;
+}
+
+bool
+testFloat16()
+{
+  cout << "\nTesting half-precision conversion" << endl;
+
+  // Values exactly representable in half precision should survive a round trip unchanged
+  float32 exact[] = { 0.0f, -0.0f, 1.0f, -2.5f, 0.333251953125f, 65504.0f, 6.103515625e-05f, 5.9604644775390625e-08f };
+  for (size_t i = 0; i < sizeof(exact) / sizeof(float32); ++i)
+  {
+    float32 f = Math::fromFloat16(Math::toFloat16(exact[i]));
+    if (std::memcmp(&f, &exact[i], sizeof(float32)) != 0)  // also distinguishes -0 from 0
+    {
+      cerr << "Half-precision round trip of " << exact[i] << " gave " << f << endl;
+      return false;
+    }
+  }
+
+  // Overflow goes to infinity, and NaN stays NaN
+  if (!Math::isInfinite(Math::fromFloat16(Math::toFloat16(1.0e6f)))
+   || !Math::isNaN(Math::fromFloat16(Math::toFloat16(Math::nan<float32>()))))
+  {
+    cerr << "Special values not preserved by half-precision conversion" << endl;
+    return false;
+  }
+
+  // Other values should be rounded to within half a unit in the last place (11 significant bits)
+  Random rng(1234);
+  for (int i = 0; i < 10000; ++i)
+  {
+    float32 x = rng.uniform(-1000.0f, 1000.0f);
+    float32 y = Math::fromFloat16(Math::toFloat16(x));
+    if (std::fabs(y - x) > std::fabs(x) / 2048)
+    {
+      cerr << "Half-precision round trip of " << x << " gave " << y << endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+testFeatureFile(long num_points)
+{
+  cout << "\nTesting feature file with " << num_points << " points" << endl;
+
+  Random rng(5678);
+  TheaArray<float32> positions((array_size_t)(3 * num_points));
+  TheaArray<double> curvatures((array_size_t)num_points);
+  TheaArray<float32> histograms((array_size_t)(5 * num_points));
+
+  for (array_size_t i = 0; i < positions.size(); ++i) positions[i] = rng.uniform(-10.0f, 10.0f);
+  for (array_size_t i = 0; i < curvatures.size(); ++i) curvatures[i] = rng.uniform(-1.0f, 1.0f);
+  for (array_size_t i = 0; i < histograms.size(); ++i) histograms[i] = rng.uniform(0.0f, 1.0f);
+
+  FeatureFileWriter writer(num_points);
+  long wpos = writer.addFeature("position", 3);
+  long wcurv = writer.addFeature("curvature", 1, FeatureStorage::FLOAT16);
+  long whist = writer.addFeature("histogram", 5, FeatureStorage::FLOAT16);
+
+  if (num_points > 0)
+    writer.setColumn(wpos, &positions[0]);
+
+  for (long i = 0; i < num_points; ++i)
+  {
+    writer.setValues(wcurv, i, &curvatures[(array_size_t)i]);
+    writer.setValues(whist, i, &histograms[(array_size_t)(5 * i)]);
+  }
+
+  std::string path = "test_features.bin";
+  writer.write(path);
+
+  if (!FeatureFile::isFeatureFile(path))
+  {
+    cerr << "Written file not recognized as a feature file" << endl;
+    return false;
+  }
+
+  bool ok = true;
+  {
+    FeatureFileReader reader(path);
+    if (reader.numPoints() != num_points || reader.numFeatures() != 3)
+    {
+      cerr << "Read " << reader.numPoints() << " points and " << reader.numFeatures() << " features" << endl;
+      ok = false;
+    }
+
+    long pos = reader.findFeature("position");
+    long curv = reader.findFeature("curvature");
+    long hist = reader.findFeature("histogram");
+    if (ok && (pos < 0 || curv < 0 || hist < 0 || reader.findFeature("normal") >= 0))
+    {
+      cerr << "Feature lookup by name failed" << endl;
+      ok = false;
+    }
+
+    if (ok && (reader.getFeatureDims(pos) != 3 || reader.getFeatureDims(hist) != 5
+            || reader.getFeatureStorage(pos) != FeatureStorage::FLOAT32
+            || reader.getFeatureStorage(curv) != FeatureStorage::FLOAT16))
+    {
+      cerr << "Incorrect feature dimensions or storage types" << endl;
+      ok = false;
+    }
+
+    // Feature blocks should be accessible in place, and aligned
+    if (ok && (!reader.getFloat32Data(pos) || reader.getFloat16Data(pos)
+            || !reader.getFloat16Data(curv) || reader.getFloat32Data(curv)
+            || ((size_t)reader.getFloat32Data(pos)) % FeatureFile::ALIGNMENT != 0
+            || ((size_t)reader.getFloat16Data(hist)) % FeatureFile::ALIGNMENT != 0))
+    {
+      cerr << "Feature blocks are not directly accessible, or are incorrectly aligned" << endl;
+      ok = false;
+    }
+
+    // Single-precision values should be exact, half-precision values close
+    for (long i = 0; ok && i < num_points; ++i)
+    {
+      float32 p[3];
+      reader.getValues(pos, i, p);
+      float32 h = reader.getValue(hist, i, 4);
+      if (p[0] != positions[(array_size_t)(3 * i)] || p[2] != positions[(array_size_t)(3 * i + 2)]
+       || std::fabs(reader.getValue(curv, i) - curvatures[(array_size_t)i]) > 1.0e-3
+       || std::fabs(h - histograms[(array_size_t)(5 * i + 4)]) > 1.0e-3)
+      {
+        cerr << "Incorrect values for point " << i << endl;
+        ok = false;
+      }
+    }
+
+    if (ok && num_points > 0)
+    {
+      TheaArray<float32> dim((array_size_t)num_points);
+      reader.getDimension(pos, 1, &dim[0]);
+      for (long i = 0; i < num_points; ++i)
+        if (dim[(array_size_t)i] != positions[(array_size_t)(3 * i + 1)])
+        {
+          cerr << "Incorrect values when reading a single feature dimension" << endl;
+          ok = false;
+          break;
+        }
+    }
+  }
+
+  std::remove(path.c_str());
+  return ok;
+}
+
+// Write raw bytes to a file.
+void
+writeBytes(std::string const & path, TheaArray<uint8> const & bytes)
+{
+  std::ofstream out(path.c_str(), std::ios::binary);
+  if (!bytes.empty())
+    out.write(reinterpret_cast<char const *>(&bytes[0]), (std::streamsize)bytes.size());
+}
+
+// Overwrite a little-endian unsigned integer of a given number of bytes.
+void
+setLE(TheaArray<uint8> & bytes, array_size_t pos, uint64 value, int num_bytes)
+{
+  for (int i = 0; i < num_bytes; ++i, value >>= 8)
+    bytes[pos + (array_size_t)i] = (uint8)(value & 0xFF);
+}
+
+// Check that opening a (corrupt) feature file with the given contents throws an error.
+bool
+readerRejects(std::string const & path, TheaArray<uint8> const & bytes, std::string const & desc)
+{
+  writeBytes(path, bytes);
+
+  try
+  {
+    FeatureFileReader reader(path);
+  }
+  catch (Error & e)
+  {
+    cout << desc << ": " << e.what() << endl;
+    return true;
+  }
+
+  cerr << desc << ": Corrupt feature file was not rejected" << endl;
+  return false;
+}
+
+bool
+testCorruptFeatureFile()
+{
+  cout << "\nTesting corrupt feature files" << endl;
+
+  static long const NUM_POINTS = 100;
+  TheaArray<float32> values((array_size_t)(3 * NUM_POINTS), 1.0f);
+
+  FeatureFileWriter writer(NUM_POINTS);
+  long wpos = writer.addFeature("position", 3);
+  writer.addFeature("curvature", 1, FeatureStorage::FLOAT16);
+  writer.setColumn(wpos, &values[0]);
+
+  std::string path = "test_corrupt_features.bin";
+  writer.write(path);
+
+  TheaArray<uint8> good;
+  {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    good.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  // Byte offsets of header fields: the magic string, the version, the number of features and the number of points, followed by
+  // the entry of the first feature ("position"), with its name length, name, number of dimensions, storage type and offset.
+  array_size_t const NUM_FEATURES_POS = FeatureFile::MAGIC_LENGTH + 4;
+  array_size_t const NUM_POINTS_POS = NUM_FEATURES_POS + 4;
+  array_size_t const NUM_DIMS_POS = NUM_POINTS_POS + 8 + 4 + 8;
+  array_size_t const OFFSET_POS = NUM_DIMS_POS + 4 + 4;
+
+  bool ok = true;
+
+  // Truncated in the fixed part of the header, in the feature entries, and in the feature values
+  array_size_t cut_sizes[] = { NUM_POINTS_POS + 3, NUM_DIMS_POS + 2, OFFSET_POS + 8 + 10, good.size() - 1 };
+  for (size_t i = 0; ok && i < sizeof(cut_sizes) / sizeof(cut_sizes[0]); ++i)
+  {
+    TheaArray<uint8> bytes(good.begin(), good.begin() + (std::ptrdiff_t)cut_sizes[i]);
+    ok = readerRejects(path, bytes, format("Truncated to %lu bytes", (unsigned long)cut_sizes[i]));
+  }
+
+  // Header values that are impossible for a file of this size, or would overflow size computations
+  if (ok)
+  {
+    TheaArray<uint8> bytes = good;
+    setLE(bytes, NUM_FEATURES_POS, 0xFFFFFFFF, 4);
+    ok = readerRejects(path, bytes, "Too many features");
+  }
+
+  if (ok)
+  {
+    TheaArray<uint8> bytes = good;
+    setLE(bytes, NUM_POINTS_POS, (uint64)1 << 61, 8);
+    ok = readerRejects(path, bytes, "Too many points");
+  }
+
+  if (ok)
+  {
+    TheaArray<uint8> bytes = good;
+    setLE(bytes, NUM_DIMS_POS, 0, 4);
+    ok = readerRejects(path, bytes, "Zero dimensions");
+  }
+
+  if (ok)
+  {
+    TheaArray<uint8> bytes = good;
+    setLE(bytes, NUM_DIMS_POS, 0xFFFFFFFF, 4);
+    ok = readerRejects(path, bytes, "Too many dimensions");
+  }
+
+  if (ok)
+  {
+    TheaArray<uint8> bytes = good;
+    setLE(bytes, OFFSET_POS, (uint64)1 << 62, 8);
+    ok = readerRejects(path, bytes, "Offset beyond end of file");
+  }
+
+  // The unmodified file should still be readable
+  if (ok)
+  {
+    writeBytes(path, good);
+    FeatureFileReader reader(path);
+    if (reader.numPoints() != NUM_POINTS || reader.numFeatures() != 2)
+    {
+      cerr << "Could not read the uncorrupted feature file" << endl;
+      ok = false;
+    }
+  }
+
+  std::remove(path.c_str());
+  return ok;
+}
@@ -1,11 +1,18 @@
 #include "../Common.hpp"
+#include "../Algorithms/KDTreeForestN.hpp"
 #include "../Algorithms/KDTreeN.hpp"
 #include "../Algorithms/MetricL2.hpp"
+#include "../Algorithms/QueryStatistics.hpp"
 #include "../Algorithms/IntersectionTester.hpp"
 #include "../Algorithms/RayIntersectionTester.hpp"
+#include "../AffineTransform3.hpp"
 #include "../AxisAlignedBox3.hpp"
 #include "../Ball3.hpp"
+#include "../BoundedSortedArray.hpp"
 #include "../BoundedSortedArrayN.hpp"
+#include "../Matrix3.hpp"
+#include "../Stopwatch.hpp"
+#include <boost/thread.hpp>
 #include <cmath>
 #include <iostream>
 #include <sstream>
@@ -18,6 +25,11 @@ using namespace Algorithms;
 
 void testPointKDTree();
 void testTriangleKDTree();
+void testDualTreeQueries();
+void testIncrementalUpdates();
+void testTransformedQueries();
+void testApproximateQueries();
+void testQueryStatistics();
 
 int
 main(int argc, char * argv[])
@@ -27,6 +39,16 @@ main(int argc, char * argv[])
     testPointKDTree();
     cout << endl;
     testTriangleKDTree();
+    cout << endl;
+    testDualTreeQueries();
+    cout << endl;
+    testIncrementalUpdates();
+    cout << endl;
+    testTransformedQueries();
+    cout << endl;
+    testApproximateQueries();
+    cout << endl;
+    testQueryStatistics();
   }
   THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "An error occurred")
 
@@ -366,7 +388,8 @@ testTriangleKDTree()
 
   //============================================================================================================================
   // Ray-triangle intersection. There are three types of intersection queries, each giving strictly more information than the
-  // last. They all take roughly the same time for kd-trees of triangles, so there's no special reason to favour
+  // last. The first stops at any hit and is the fastest, the other two search for the nearest hit and take roughly the same
+  // time for kd-trees of triangles
   //============================================================================================================================
 
   // Generate a random ray from the origin into the positive quadrant (the ray's direction vector need not be a unit vector,
@@ -404,4 +427,555 @@ testTriangleKDTree()
   }
   else
     cout << "Ray does not intersect any triangle in the kd-tree" << endl;
+
+  // The first type of query stops at the first hit it finds, but should always agree with the others
+  static int const NUM_RAYS = 1000;
+  for (int i = 0; i < NUM_RAYS; ++i)
+  {
+    Vector3 origin(2 * rand() / (Real)RAND_MAX - 0.5f, 2 * rand() / (Real)RAND_MAX - 0.5f, 2 * rand() / (Real)RAND_MAX - 0.5f);
+    Vector3 dir(2 * rand() / (Real)RAND_MAX - 1, 2 * rand() / (Real)RAND_MAX - 1, 2 * rand() / (Real)RAND_MAX - 1);
+    Ray3 test_ray(origin, dir);
+    Real test_max_time = (i % 2 == 0 ? -1 : rand() / (Real)RAND_MAX);
+
+    alwaysAssertM(kdtree.rayIntersects<RayIntersectionTester>(test_ray, test_max_time)
+               == (kdtree.rayIntersectionTime<RayIntersectionTester>(test_ray, test_max_time) >= 0),
+                  "Ray intersection test does not agree with ray intersection time");
+  }
+
+  cout << "Ray intersection tests agree with ray intersection times for " << NUM_RAYS << " random rays" << endl;
+}
+
+void
+testDualTreeQueries()
+{
+  cout << "==============================================\n"
+       << "Testing dual-tree queries between point clouds\n"
+       << "==============================================" << endl;
+
+  //============================================================================================================================
+  // Generate two large point clouds and build a kd-tree on each
+  //============================================================================================================================
+
+  static int NUM_POINTS = 100000;
+  vector<Vector3> src_points(NUM_POINTS), tgt_points(NUM_POINTS);
+  for (int i = 0; i < NUM_POINTS; ++i)
+  {
+    src_points[i] = Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX);
+    tgt_points[i] = Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX);
+  }
+
+  typedef KDTreeN<Vector3, 3> KDTree;
+  typedef KDTree::NeighborPair NeighborPair;
+  KDTree src_kdtree(src_points.begin(), src_points.end());
+  KDTree tgt_kdtree(tgt_points.begin(), tgt_points.end());
+  cout << "Created kd-trees for two sets of " << NUM_POINTS << " random points" << endl;
+
+  //============================================================================================================================
+  // All k-nearest neighbors, with a single simultaneous traversal of both trees vs one query per source point
+  //============================================================================================================================
+
+  static int const K = 4;
+  Stopwatch timer;
+
+  timer.tick();
+    TheaArray< BoundedSortedArray<NeighborPair> > all_nbrs;
+    long num_found = tgt_kdtree.allKClosestPairs<MetricL2>(src_kdtree, K, all_nbrs);
+  timer.tock();
+  double dual_time = timer.elapsedTime();
+
+  timer.tick();
+    TheaArray< BoundedSortedArrayN<K, NeighborPair> > single_nbrs(src_points.size());
+    for (array_size_t i = 0; i < src_points.size(); ++i)
+      tgt_kdtree.kClosestPairs<MetricL2>(src_points[i], single_nbrs[i]);
+  timer.tock();
+  double single_time = timer.elapsedTime();
+
+  cout << "\nFound " << K << " nearest neighbors of " << num_found << " points in " << dual_time << "s (dual-tree), vs "
+       << single_time << "s (" << NUM_POINTS << " separate queries)" << endl;
+
+  for (array_size_t i = 0; i < src_points.size(); ++i)
+  {
+    alwaysAssertM(all_nbrs[i].size() == single_nbrs[i].size(), "Dual-tree k-NN returned the wrong number of neighbors");
+
+    for (int j = 0; j < all_nbrs[i].size(); ++j)
+      alwaysAssertM(Math::fuzzyEq(all_nbrs[i][j].getMonotoneApproxDistance(),
+                                  single_nbrs[i][j].getMonotoneApproxDistance()),
+                    "Dual-tree k-NN does not match single-tree k-NN");
+  }
+
+  cout << "Dual-tree k-NN results match single-tree k-NN results" << endl;
+
+  //============================================================================================================================
+  // Closest pair and Hausdorff distance between the two clouds
+  //============================================================================================================================
+
+  NeighborPair closest = tgt_kdtree.closestPair<MetricL2>(src_kdtree, -1, true);
+  double min_dist = -1, max_nn_dist = 0;
+  for (array_size_t i = 0; i < src_points.size(); ++i)
+  {
+    double d = all_nbrs[i][0].getDistance<MetricL2>();
+    if (min_dist < 0 || d < min_dist) min_dist = d;
+    if (d > max_nn_dist) max_nn_dist = d;
+  }
+
+  alwaysAssertM(closest.isValid() && Math::fuzzyEq(closest.getDistance<MetricL2>(), min_dist),
+                "Dual-tree closest pair does not match k-NN results");
+  cout << "\nThe closest pair of points is at separation " << closest.getDistance<MetricL2>() << endl;
+
+  double directed_hausdorff = tgt_kdtree.hausdorffDistance<MetricL2>(src_kdtree);
+  alwaysAssertM(Math::fuzzyEq(directed_hausdorff, max_nn_dist), "Hausdorff distance does not match k-NN results");
+
+  double hausdorff = tgt_kdtree.hausdorffDistance<MetricL2>(src_kdtree, true);
+  cout << "Directed Hausdorff distance = " << directed_hausdorff << ", symmetric Hausdorff distance = " << hausdorff << endl;
+}
+
+// Brute-force nearest neighbor of a point among those elements of a kd-tree that have not been removed.
+long
+bruteForceNearestNeighbor(KDTreeN<Vector3, 3> const & kdtree, Vector3 const & query)
+{
+  long best = -1;
+  Real best_sqdist = 0;
+  for (long i = 0; i < kdtree.numElements(); ++i)
+  {
+    if (kdtree.isRemoved(i))
+      continue;
+
+    Real sqdist = (kdtree.getElements()[i] - query).squaredLength();
+    if (best < 0 || sqdist < best_sqdist)
+    {
+      best = i;
+      best_sqdist = sqdist;
+    }
+  }
+
+  return best;
+}
+
+void
+testIncrementalUpdates()
+{
+  cout << "=======================================\n"
+       << "Testing incremental updates of kd-trees\n"
+       << "=======================================" << endl;
+
+  //============================================================================================================================
+  // Build a kd-tree on a random point cloud, then insert, remove and move points one at a time
+  //============================================================================================================================
+
+  static int const NUM_POINTS = 200000;
+  static int const NUM_UPDATES = 20000;
+
+  vector<Vector3> points(NUM_POINTS);
+  for (int i = 0; i < NUM_POINTS; ++i)
+    points[i] = Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX);
+
+  typedef KDTreeN<Vector3, 3> KDTree;
+  KDTree kdtree(points.begin(), points.end());
+
+  Stopwatch timer;
+
+  // Insert points clustered in one corner, to force subtrees to be rebalanced
+  timer.tick();
+    for (int i = 0; i < NUM_UPDATES; ++i)
+    {
+      long index = kdtree.insert(0.1f * Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX));
+      alwaysAssertM(index == NUM_POINTS + i, "Inserted point has the wrong index");
+    }
+  timer.tock();
+  double insert_time = timer.elapsedTime();
+
+  timer.tick();
+    int num_removed = 0;
+    for (int i = 0; i < NUM_UPDATES; ++i)
+      if (kdtree.remove(rand() % kdtree.numElements()))
+        num_removed++;
+  timer.tock();
+  double remove_time = timer.elapsedTime();
+
+  alwaysAssertM(kdtree.numRemovedElements() == num_removed, "Wrong number of removed points");
+
+  timer.tick();
+    for (int i = 0; i < NUM_UPDATES; ++i)
+    {
+      long index = rand() % kdtree.numElements();
+      if (!kdtree.isRemoved(index))
+        kdtree.update(index, kdtree.getElements()[index] + 0.05f * Vector3(rand() / (Real)RAND_MAX - 0.5f,
+                                                                           rand() / (Real)RAND_MAX - 0.5f,
+                                                                           rand() / (Real)RAND_MAX - 0.5f));
+    }
+  timer.tock();
+  double update_time = timer.elapsedTime();
+
+  // Compare to rebuilding the tree from scratch
+  vector<Vector3> live_points;
+  for (long i = 0; i < kdtree.numElements(); ++i)
+    if (!kdtree.isRemoved(i))
+      live_points.push_back(kdtree.getElements()[i]);
+
+  timer.tick();
+    KDTree rebuilt_kdtree(live_points.begin(), live_points.end());
+  timer.tock();
+  double rebuild_time = timer.elapsedTime();
+
+  cout << NUM_UPDATES << " insertions took " << insert_time << "s, " << NUM_UPDATES << " removals took " << remove_time
+       << "s, " << NUM_UPDATES << " moves took " << update_time << "s\n"
+       << "A single full rebuild of the tree with " << live_points.size() << " points took " << rebuild_time << 's' << endl;
+
+  //============================================================================================================================
+  // Check that queries on the updated tree are still correct
+  //============================================================================================================================
+
+  static int const NUM_QUERIES = 200;
+  for (int i = 0; i < NUM_QUERIES; ++i)
+  {
+    Vector3 query = (i % 2 == 0 ? 0.1f : 1.0f) * Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX,
+                                                         rand() / (Real)RAND_MAX);
+    long nn = kdtree.closestElement<MetricL2>(query);
+    long brute_nn = bruteForceNearestNeighbor(kdtree, query);
+
+    alwaysAssertM(nn >= 0 && !kdtree.isRemoved(nn), "Nearest neighbor query returned a removed point");
+    alwaysAssertM(Math::fuzzyEq((kdtree.getElements()[nn] - query).squaredLength(),
+                                (kdtree.getElements()[brute_nn] - query).squaredLength()),
+                  "Nearest neighbor query on updated kd-tree does not match brute-force search");
+
+    Ball3 ball(query, 0.05f);
+    TheaArray<long> in_range;
+    kdtree.rangeQueryIndices<IntersectionTester>(ball, in_range);
+
+    long brute_in_range = 0;
+    for (long j = 0; j < kdtree.numElements(); ++j)
+      if (!kdtree.isRemoved(j) && ball.contains(kdtree.getElements()[j]))
+        brute_in_range++;
+
+    alwaysAssertM((long)in_range.size() == brute_in_range, "Range query on updated kd-tree does not match brute-force search");
+  }
+
+  cout << "Queries on the updated kd-tree match brute-force search" << endl;
+
+  //============================================================================================================================
+  // Check that index arrays abandoned by many update cycles are reclaimed
+  //============================================================================================================================
+
+  static int const NUM_CYCLE_POINTS = 5000;
+  static int const NUM_CYCLES = 100;
+
+  KDTree cycled_kdtree(points.begin(), points.begin() + NUM_CYCLE_POINTS);
+  long num_indices_at_build = cycled_kdtree.numAllocatedIndices();
+  long max_num_indices = num_indices_at_build;
+  for (int i = 0; i < NUM_CYCLES; ++i)
+  {
+    // Move every point, and replace a tenth of them with new ones
+    for (long j = 0; j < cycled_kdtree.numElements(); ++j)
+    {
+      if (!cycled_kdtree.isRemoved(j))
+        cycled_kdtree.update(j, cycled_kdtree.getElements()[j] + 0.05f * Vector3(rand() / (Real)RAND_MAX - 0.5f,
+                                                                                 rand() / (Real)RAND_MAX - 0.5f,
+                                                                                 rand() / (Real)RAND_MAX - 0.5f));
+
+      max_num_indices = std::max(max_num_indices, cycled_kdtree.numAllocatedIndices());
+    }
+
+    for (int j = 0; j < NUM_CYCLE_POINTS / 10; ++j)
+    {
+      long index = rand() % cycled_kdtree.numElements();
+      if (cycled_kdtree.remove(index))
+        cycled_kdtree.insert(Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX));
+
+      max_num_indices = std::max(max_num_indices, cycled_kdtree.numAllocatedIndices());
+    }
+  }
+
+  cout << "After " << NUM_CYCLES << " update cycles, at most " << max_num_indices << " indices were allocated, compared to "
+       << num_indices_at_build << " after the initial build" << endl;
+
+  alwaysAssertM(max_num_indices <= 4 * num_indices_at_build, "Index pool of kd-tree grows without bound with updates");
+}
+
+void
+testTransformedQueries()
+{
+  cout << "====================================\n"
+       << "Testing queries on transformed trees\n"
+       << "====================================" << endl;
+
+  //============================================================================================================================
+  // Compare queries on a transformed kd-tree to the same queries on a kd-tree built on pre-transformed points, for a rigid
+  // transform, a similarity transform and a general affine transform
+  //============================================================================================================================
+
+  static int const NUM_POINTS = 100000;
+  static int const NUM_QUERIES = 20000;
+  static int const K = 8;
+
+  vector<Vector3> points(NUM_POINTS);
+  for (int i = 0; i < NUM_POINTS; ++i)
+    points[i] = Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX);
+
+  vector<Vector3> queries(NUM_QUERIES);
+  for (int i = 0; i < NUM_QUERIES; ++i)
+    queries[i] = 4 * Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX) - Vector3(2, 2, 2);
+
+  typedef KDTreeN<Vector3, 3> KDTree;
+  KDTree kdtree(points.begin(), points.end());
+
+  Matrix3 rot = Matrix3::rotationAxisAngle(Vector3(1, 2, 3).unit(), 0.7f);
+  AffineTransform3 transforms[3] = {
+    AffineTransform3(rot, Vector3(0.5f, -0.3f, 0.2f)),
+    AffineTransform3(2.5f * rot, Vector3(-1, 0, 0.4f)),
+    AffineTransform3(Matrix3(1, 0.4f, 0, 0, 3, 0, 0, 0.2f, 0.5f) * rot, Vector3(0.2f, 0.1f, -0.6f))
+  };
+  char const * transform_names[3] = { "a rigid", "a similarity", "an affine" };
+
+  Stopwatch timer;
+
+  for (int t = 0; t < 3; ++t)
+  {
+    vector<Vector3> tr_points(NUM_POINTS);
+    for (int i = 0; i < NUM_POINTS; ++i)
+      tr_points[i] = transforms[t] * points[i];
+
+    KDTree tr_kdtree(tr_points.begin(), tr_points.end());
+    kdtree.setTransform(transforms[t]);
+
+    vector<long> nn(NUM_QUERIES), tr_nn(NUM_QUERIES);
+    timer.tick();
+      for (int i = 0; i < NUM_QUERIES; ++i)
+        nn[i] = kdtree.closestElement<MetricL2>(queries[i]);
+    timer.tock();
+    double transformed_time = timer.elapsedTime();
+
+    timer.tick();
+      for (int i = 0; i < NUM_QUERIES; ++i)
+        tr_nn[i] = tr_kdtree.closestElement<MetricL2>(queries[i]);
+    timer.tock();
+    double pretransformed_time = timer.elapsedTime();
+
+    cout << NUM_QUERIES << " NN queries on a tree with " << transform_names[t] << " transform took " << transformed_time
+         << "s (" << pretransformed_time << "s on pre-transformed points)" << endl;
+
+    for (int i = 0; i < NUM_QUERIES; ++i)
+    {
+      alwaysAssertM(nn[i] >= 0, "Nearest neighbor not found in transformed kd-tree");
+      alwaysAssertM(Math::fuzzyEq((tr_points[nn[i]] - queries[i]).length(), (tr_points[tr_nn[i]] - queries[i]).length(),
+                                  (Real)1.0e-4),
+                    "Nearest neighbor in transformed kd-tree does not match pre-transformed kd-tree");
+    }
+
+    for (int i = 0; i < NUM_QUERIES; i += 20)
+    {
+      BoundedSortedArrayN<K, KDTree::NeighborPair> nbrs, tr_nbrs;
+      kdtree.kClosestPairs<MetricL2>(queries[i], nbrs, -1, true);
+      tr_kdtree.kClosestPairs<MetricL2>(queries[i], tr_nbrs, -1, true);
+
+      alwaysAssertM(nbrs.size() == K && tr_nbrs.size() == K, "Wrong number of k-nearest neighbors");
+      for (int j = 0; j < K; ++j)
+      {
+        alwaysAssertM(Math::fuzzyEq(nbrs[j].getDistance<MetricL2>(), tr_nbrs[j].getDistance<MetricL2>(), 1.0e-4),
+                      "k-nearest neighbors in transformed kd-tree do not match pre-transformed kd-tree");
+        alwaysAssertM((nbrs[j].getTargetPoint() - tr_points[nbrs[j].getTargetIndex()]).length() < 1.0e-4f,
+                      "Closest point on neighbor in transformed kd-tree is not in world space");
+      }
+    }
+  }
+
+  kdtree.clearTransform();
+
+  cout << "Queries on transformed kd-trees match queries on pre-transformed points" << endl;
+}
+
+// Brute-force search for the distance to the nearest neighbor of a point in a high-dimensional point set.
+template <long N>
+Real
+bruteForceNearestNeighborDistance(vector< VectorN<N, Real> > const & points, VectorN<N, Real> const & query)
+{
+  Real best_sqdist = -1;
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    Real sqdist = (points[i] - query).squaredLength();
+    if (best_sqdist < 0 || sqdist < best_sqdist)
+      best_sqdist = sqdist;
+  }
+
+  return sqrt(best_sqdist);
+}
+
+void
+testApproximateQueries()
+{
+  cout << "====================================================\n"
+       << "Testing approximate nearest neighbors in high dimension\n"
+       << "====================================================" << endl;
+
+  //============================================================================================================================
+  // Generate clustered points in 64 dimensions, resembling a set of feature descriptors
+  //============================================================================================================================
+
+  static long const DIM = 64;
+  static int const NUM_POINTS = 50000;
+  static int const NUM_CLUSTERS = 100;
+  static int const NUM_QUERIES = 200;
+
+  typedef VectorN<DIM, Real> VectorT;
+
+  vector<VectorT> centers(NUM_CLUSTERS);
+  for (int i = 0; i < NUM_CLUSTERS; ++i)
+    for (long j = 0; j < DIM; ++j)
+      centers[i][j] = rand() / (Real)RAND_MAX;
+
+  vector<VectorT> points(NUM_POINTS + NUM_QUERIES);
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    VectorT const & center = centers[rand() % NUM_CLUSTERS];
+    for (long j = 0; j < DIM; ++j)
+      points[i][j] = center[j] + 0.6f * (rand() / (Real)RAND_MAX - 0.5f);
+  }
+
+  vector<VectorT> queries(points.begin() + NUM_POINTS, points.end());
+  points.resize(NUM_POINTS);
+
+  vector<Real> exact_dist(NUM_QUERIES);
+  for (int i = 0; i < NUM_QUERIES; ++i)
+    exact_dist[i] = bruteForceNearestNeighborDistance(points, queries[i]);
+
+  typedef KDTreeN<VectorT, DIM> KDTree;
+  typedef KDTreeForestN<VectorT, DIM> KDTreeForest;
+
+  Stopwatch timer;
+
+  timer.tick();
+    KDTree kdtree(points.begin(), points.end());
+  timer.tock();
+  cout << "Built kd-tree on " << NUM_POINTS << " points in " << DIM << " dimensions in " << timer.elapsedTime() << 's' << endl;
+
+  timer.tick();
+    KDTreeForest forest(points.begin(), points.end(), 4);
+  timer.tock();
+  cout << "Built forest of " << forest.numTrees() << " randomized kd-trees in " << timer.elapsedTime() << 's' << endl;
+
+  // Exact search
+  timer.tick();
+    for (int i = 0; i < NUM_QUERIES; ++i)
+    {
+      double dist = -1;
+      kdtree.closestElement<MetricL2>(queries[i], -1, &dist);
+      alwaysAssertM(Math::fuzzyEq(dist, (double)exact_dist[i], 1.0e-4), "Exact nearest neighbor query returned wrong result");
+    }
+  timer.tock();
+  cout << "\nExact search: " << 1000 * timer.elapsedTime() / NUM_QUERIES << "ms/query" << endl;
+
+  //============================================================================================================================
+  // Measure recall (fraction of queries for which the true nearest neighbor is found) vs speed
+  //============================================================================================================================
+
+  double const EPSILONS[] = { 0, 0.5, 1, 2 };
+  long const MAX_LEAVES[] = { 8, 32, 128, -1 };
+  for (int t = 0; t < 2; ++t)
+  {
+    cout << '\n' << (t == 0 ? "Single tree" : "Forest") << ':' << endl;
+
+    for (size_t e = 0; e < sizeof(EPSILONS) / sizeof(EPSILONS[0]); ++e)
+      for (size_t m = 0; m < sizeof(MAX_LEAVES) / sizeof(MAX_LEAVES[0]); ++m)
+      {
+        // Sweep the leaf budget only for exact search. An exhaustive search of the forest is slower than a single tree.
+        if ((EPSILONS[e] > 0 && MAX_LEAVES[m] > 0 && MAX_LEAVES[m] != 32) || (t == 1 && EPSILONS[e] <= 0 && MAX_LEAVES[m] <= 0))
+          continue;
+
+        int num_exact = 0;
+        timer.tick();
+          for (int i = 0; i < NUM_QUERIES; ++i)
+          {
+            double dist = -1;
+            long nn = (t == 0 ? kdtree.approxClosestElement<MetricL2>(queries[i], EPSILONS[e], MAX_LEAVES[m], -1, &dist)
+                              : forest.approxClosestElement<MetricL2>(queries[i], EPSILONS[e], MAX_LEAVES[m], -1, &dist));
+
+            alwaysAssertM(nn >= 0, "Approximate nearest neighbor not found");
+            alwaysAssertM(MAX_LEAVES[m] > 0 || dist <= (1 + EPSILONS[e]) * exact_dist[i] * (1 + 1.0e-5),
+                          "Approximate nearest neighbor violates error bound");
+
+            if (dist <= exact_dist[i] * (1 + 1.0e-5))
+              num_exact++;
+          }
+        timer.tock();
+
+        cout << "  epsilon = " << EPSILONS[e] << ", max leaves = " << MAX_LEAVES[m] << ": recall = "
+             << num_exact / (double)NUM_QUERIES << ", " << 1000 * timer.elapsedTime() / NUM_QUERIES << "ms/query" << endl;
+      }
+  }
+}
+
+// Runs a batch of nearest neighbor queries on a kd-tree, for testing statistics collection from several threads.
+struct NearestNeighborQueryRunner
+{
+  NearestNeighborQueryRunner(KDTreeN<Vector3, 3> const * kdtree_, vector<Vector3> const * queries_)
+  : kdtree(kdtree_), queries(queries_) {}
+
+  void operator()()
+  {
+    for (size_t i = 0; i < queries->size(); ++i)
+      kdtree->closestElement<MetricL2>((*queries)[i]);
+  }
+
+  KDTreeN<Vector3, 3> const * kdtree;
+  vector<Vector3> const * queries;
+};
+
+void
+testQueryStatistics()
+{
+  cout << "========================\n"
+       << "Testing query statistics\n"
+       << "========================" << endl;
+
+  static int const NUM_POINTS = 10000;
+  static int const NUM_QUERIES = 1000;
+  static int const NUM_THREADS = 4;
+
+  vector<Vector3> points(NUM_POINTS);
+  for (int i = 0; i < NUM_POINTS; ++i)
+    points[i] = Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX);
+
+  vector<Vector3> queries(NUM_QUERIES);
+  for (int i = 0; i < NUM_QUERIES; ++i)
+    queries[i] = Vector3(rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX, rand() / (Real)RAND_MAX);
+
+  KDTreeN<Vector3, 3> kdtree(points.begin(), points.end());
+
+  QueryStatistics::reset();
+
+  // Run the queries in several rounds of short-lived threads, whose counts must be kept after they exit
+  static int const NUM_ROUNDS = 3;
+  for (int r = 0; r < NUM_ROUNDS; ++r)
+  {
+    boost::thread_group threads;
+    for (int i = 0; i < NUM_THREADS; ++i)
+      threads.create_thread(NearestNeighborQueryRunner(&kdtree, &queries));
+
+    threads.join_all();
+  }
+
+  QueryStatistics stats = QueryStatistics::aggregate();
+  if (!QueryStatistics::isEnabled())
+  {
+    for (int i = 0; i < QueryStatistics::NUM_COUNTERS; ++i)
+      alwaysAssertM(stats.get((QueryStatistics::Counter)i) == 0, "Query statistics recorded when disabled");
+
+    cout << "Query statistics are disabled (define THEA_QUERY_STATISTICS to enable them)" << endl;
+    return;
+  }
+
+  cout << stats.toString();
+
+  alwaysAssertM(stats.get(QueryStatistics::PROXIMITY_QUERIES) == NUM_ROUNDS * NUM_THREADS * NUM_QUERIES,
+                "Query statistics from different threads not aggregated correctly");
+  alwaysAssertM(stats.get(QueryStatistics::LEAVES_VISITED) >= NUM_ROUNDS * NUM_THREADS * NUM_QUERIES
+             && stats.get(QueryStatistics::NODES_VISITED) > stats.get(QueryStatistics::LEAVES_VISITED)
+             && stats.get(QueryStatistics::ELEMENTS_TESTED) >= stats.get(QueryStatistics::LEAVES_VISITED),
+                "Inconsistent query statistics");
+  alwaysAssertM(stats.get(QueryStatistics::ELEMENTS_TESTED) < (int64)NUM_ROUNDS * NUM_THREADS * NUM_QUERIES * NUM_POINTS / 10,
+                "Nearest neighbor queries are not pruned");
+
+  QueryStatistics::reset();
+  alwaysAssertM(QueryStatistics::aggregate().get(QueryStatistics::NODES_VISITED) == 0, "Query statistics not reset");
+
+  cout << "Query statistics are consistent" << endl;
 }
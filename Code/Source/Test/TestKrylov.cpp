@@ -0,0 +1,237 @@
+#include "../Common.hpp"
+#include "../Application.hpp"
+#include "../Array.hpp"
+#include "../FilePath.hpp"
+#include "../Plugin.hpp"
+#include "../Algorithms/LinearSolver.hpp"
+#include <cmath>
+#include <iostream>
+#include <cstdio>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+typedef CompressedRowMatrix<double, int, long> CSR;
+
+bool testKrylov(int argc, char * argv[]);
+void gridMatrix(long grid_size, double diag, double west, double east, CSR & a);
+bool testIterativeSolve(LinearSolver * ls, CSR const & a, string const & method, string const & preconditioner);
+bool testFactoredSolve(LinearSolver * ls, CSR const & a, string const & method, string const & preconditioner,
+                       long num_rhs);
+int cleanup(int status);
+
+int
+main(int argc, char * argv[])
+{
+  bool ok;
+  try
+  {
+    ok = testKrylov(argc, argv);
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return cleanup(-1);, ERROR, "%s", "An error occurred")
+
+  if (ok)  // hooray, all tests passed
+    cout << "Test passed" << endl;
+  else  // test failed
+    cout << "Test failed" << endl;
+
+  return cleanup(ok ? 0 : -1);
+}
+
+bool
+testKrylov(int argc, char * argv[])
+{
+  // Get the path containing the executable
+  string bin_path = FilePath::parent(argv[0]);
+
+  // Try to load the Krylov plugin from the same parent directory as the executable
+#ifdef THEA_DEBUG_BUILD
+  string plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginKrylovd");
+#else
+  string plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginKrylov");
+#endif
+
+  cout << "Loading plugin: " << plugin_path << endl;
+  Plugin * plugin = Application::getPluginManager().load(plugin_path);
+
+  // Start up the plugin
+  plugin->startup();
+
+  // We should now have a Krylov linear solver factory
+  LinearSolverFactory * factory = Application::getLinearSolverManager().getFactory("Krylov");
+
+  // Create a linear solver
+  LinearSolver * ls = factory->createLinearSolver("My Krylov linear solver");
+
+  // Shifted Laplacian of a 2D grid (symmetric positive-definite)
+  CSR spd;
+  gridMatrix(40, 5, -1, -1, spd);
+
+  bool ok = testIterativeSolve(ls, spd, "CG", "None")
+         && testIterativeSolve(ls, spd, "CG", "Jacobi")
+         && testIterativeSolve(ls, spd, "CG", "IC")
+         && testIterativeSolve(ls, spd, "BiCGSTAB", "IC")
+         && testIterativeSolve(ls, spd, "MINRES", "Jacobi");
+
+  if (ok)
+  {
+    // Symmetric indefinite
+    CSR indefinite;
+    gridMatrix(40, 1.5, -1, -1, indefinite);
+    ok = testIterativeSolve(ls, indefinite, "MINRES", "None");
+  }
+
+  if (ok)
+  {
+    // Non-symmetric (convection-diffusion)
+    CSR nonsymmetric;
+    gridMatrix(40, 5, -1.5, -0.5, nonsymmetric);
+    ok = testIterativeSolve(ls, nonsymmetric, "BiCGSTAB", "Jacobi");
+  }
+
+  // Reuse the preconditioner for a block of constant vectors. The larger system is split across threads.
+  if (ok)
+    ok = testFactoredSolve(ls, spd, "CG", "IC", 20);
+
+  if (ok)
+  {
+    CSR large;
+    gridMatrix(400, 5, -1, -1, large);
+    ok = testFactoredSolve(ls, large, "CG", "IC", 4);
+  }
+
+  // Destroy the linear solver
+  factory->destroyLinearSolver(ls);
+
+  // Cleanup and quit
+  plugin->shutdown();
+
+  return ok;
+}
+
+void
+gridMatrix(long grid_size, double diag, double west, double east, CSR & a)
+{
+  TheaArray<CSR::Entry> entries;
+  for (long i = 0; i < grid_size; ++i)
+    for (long j = 0; j < grid_size; ++j)
+    {
+      long r = i * grid_size + j;
+      entries.push_back(CSR::Entry(CSR::IndexPair(r, r), diag));
+      if (i > 0)             entries.push_back(CSR::Entry(CSR::IndexPair(r, r - grid_size), -1.0));
+      if (i < grid_size - 1) entries.push_back(CSR::Entry(CSR::IndexPair(r, r + grid_size), -1.0));
+      if (j > 0)             entries.push_back(CSR::Entry(CSR::IndexPair(r, r - 1), west));
+      if (j < grid_size - 1) entries.push_back(CSR::Entry(CSR::IndexPair(r, r + 1), east));
+    }
+
+  long n = grid_size * grid_size;
+  a.setFromEntries(n, n, entries);
+}
+
+bool
+testIterativeSolve(LinearSolver * ls, CSR const & a, string const & method, string const & preconditioner)
+{
+  long n = a.numRows();
+
+  // Right-hand side with a known solution
+  TheaArray<double> expected((array_size_t)n), b((array_size_t)n, 0.0);
+  for (long i = 0; i < n; ++i)
+    expected[(array_size_t)i] = std::sin(0.1 * (double)i) + 1;
+
+  for (long r = 0; r < n; ++r)
+    for (long e = a.getRowIndices()[(array_size_t)r]; e < a.getRowIndices()[(array_size_t)r + 1]; ++e)
+      b[(array_size_t)r] += a.getValues()[(array_size_t)e] * expected[(array_size_t)a.getColumnIndices()[(array_size_t)e]];
+
+  Options opts;
+  opts.set("method", method);
+  opts.set("preconditioner", preconditioner);
+  opts.set("tol", 1e-10);
+  opts.set("max-iterations", 10 * n);
+
+  ls->setCoefficients(a);
+  ls->setConstants(b.begin(), b.end());
+  if (!ls->solve(opts))
+  {
+    cout << method << "/" << preconditioner << ": Iterations did not converge" << endl;
+    return false;
+  }
+
+  double max_err = 0;
+  for (long i = 0; i < n; ++i)
+    max_err = std::max(max_err, std::fabs(ls->getSolution()[(array_size_t)i] - expected[(array_size_t)i]));
+
+  printf("%s/%s: Maximum error in solution of %ldx%ld system = %g\n", method.c_str(), preconditioner.c_str(), n, n, max_err);
+  if (max_err > 1e-6)
+    return false;
+
+  // Solving again from the previous solution should need no further iterations
+  opts.set("warm-start", true);
+  opts.set("tol", 1e-8);
+  opts.set("max-iterations", 0L);
+  if (!ls->solve(opts))
+  {
+    cout << method << "/" << preconditioner << ": Warm start from converged solution failed" << endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool
+testFactoredSolve(LinearSolver * ls, CSR const & a, string const & method, string const & preconditioner, long num_rhs)
+{
+  long n = a.numRows();
+
+  TheaArray<double> rhs((array_size_t)(n * num_rhs));
+  for (array_size_t i = 0; i < rhs.size(); ++i)
+    rhs[i] = (double)((i * 7919) % 23) - 11;
+
+  Options opts;
+  opts.set("method", method);
+  opts.set("preconditioner", preconditioner);
+  opts.set("tol", 1e-12);
+  opts.set("max-threads", 4L);
+
+  ls->setCoefficients(a);
+  if (!ls->factorize(opts))
+  {
+    cout << method << "/" << preconditioner << ": Could not compute preconditioner" << endl;
+    return false;
+  }
+
+  TheaArray<double> solutions((array_size_t)(n * num_rhs));
+  if (!ls->solveFactored(num_rhs, &rhs[0], &solutions[0]))
+  {
+    cout << method << "/" << preconditioner << ": Could not solve systems with precomputed preconditioner" << endl;
+    return false;
+  }
+
+  // Compare with solving each system from scratch
+  double max_diff = 0;
+  for (long k = 0; k < num_rhs; ++k)
+  {
+    ls->setCoefficients(a);
+    ls->setConstants(rhs.begin() + k * n, rhs.begin() + (k + 1) * n);
+    if (!ls->solve(opts))
+    {
+      cout << method << "/" << preconditioner << ": Could not solve system " << k << endl;
+      return false;
+    }
+
+    for (long i = 0; i < n; ++i)
+      max_diff = std::max(max_diff, std::fabs(ls->getSolution()[(array_size_t)i] - solutions[(array_size_t)(k * n + i)]));
+  }
+
+  printf("%s/%s: Solution of %ldx%ld system for %ld constant vectors with precomputed preconditioner differs from direct "
+         "solution by %g\n", method.c_str(), preconditioner.c_str(), n, n, num_rhs, max_diff);
+
+  return max_diff < 1e-8;
+}
+
+int
+cleanup(int status)
+{
+  Application::getPluginManager().unloadAllPlugins();
+  return status;
+}
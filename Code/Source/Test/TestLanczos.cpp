@@ -0,0 +1,218 @@
+#include "../Common.hpp"
+#include "../Application.hpp"
+#include "../Array.hpp"
+#include "../FilePath.hpp"
+#include "../Math.hpp"
+#include "../Plugin.hpp"
+#include "../Algorithms/EigenSolver.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cstdio>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+typedef CompressedRowMatrix<double, int, long> CSR;
+
+bool testLanczos(int argc, char * argv[]);
+void gridLaplacian(long grid_size, CSR & a, TheaArray<double> & exact_eigenvalues);
+bool testEigenpairs(EigenSolver * es, CSR const & a, TheaArray<double> const & exact_eigenvalues, long nev,
+                    Options const & opts);
+int cleanup(int status);
+
+int
+main(int argc, char * argv[])
+{
+  bool ok;
+  try
+  {
+    ok = testLanczos(argc, argv);
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return cleanup(-1);, ERROR, "%s", "An error occurred")
+
+  if (ok)  // hooray, all tests passed
+    cout << "Test passed" << endl;
+  else  // test failed
+    cout << "Test failed" << endl;
+
+  return cleanup(ok ? 0 : -1);
+}
+
+bool
+testLanczos(int argc, char * argv[])
+{
+  // Get the path containing the executable
+  string bin_path = FilePath::parent(argv[0]);
+
+  // Try to load the Lanczos plugin, and the CSPARSE plugin for shift-invert mode, from the same parent directory as the
+  // executable
+#ifdef THEA_DEBUG_BUILD
+  string plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginLanczosd");
+  string ls_plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginCSPARSEd");
+#else
+  string plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginLanczos");
+  string ls_plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginCSPARSE");
+#endif
+
+  cout << "Loading plugin: " << plugin_path << endl;
+  Plugin * plugin = Application::getPluginManager().load(plugin_path);
+
+  cout << "Loading plugin: " << ls_plugin_path << endl;
+  Plugin * ls_plugin = Application::getPluginManager().load(ls_plugin_path);
+
+  // Start up the plugins
+  plugin->startup();
+  ls_plugin->startup();
+
+  // We should now have a Lanczos eigensolver factory
+  EigenSolverFactory * factory = Application::getEigenSolverManager().getFactory("Lanczos");
+
+  // Create an eigensolver
+  EigenSolver * es = factory->createEigenSolver("My Lanczos eigensolver");
+
+  CSR laplacian;
+  TheaArray<double> exact;
+  gridLaplacian(30, laplacian, exact);
+
+  Options opts;
+  opts.set("which", "LA");
+  bool ok = testEigenpairs(es, laplacian, exact, 10, opts);
+
+  if (ok)
+  {
+    opts.set("which", "SA");
+    opts.set("block-size", 4L);
+    ok = testEigenpairs(es, laplacian, exact, 10, opts);
+  }
+
+  if (ok)
+  {
+    Options si_opts;
+    si_opts.set("sigma", -0.1);
+    ok = testEigenpairs(es, laplacian, exact, 30, si_opts);
+  }
+
+  // Small matrix, solved densely
+  if (ok)
+  {
+    CSR small;
+    TheaArray<double> small_exact;
+    gridLaplacian(4, small, small_exact);
+
+    opts.set("which", "SA");
+    ok = testEigenpairs(es, small, small_exact, 5, opts);
+  }
+
+  // Matrix too large to be solved densely, with so many eigenpairs requested that the default basis does not fit
+  if (ok)
+  {
+    CSR medium;
+    TheaArray<double> medium_exact;
+    gridLaplacian(32, medium, medium_exact);
+
+    Options medium_opts;
+    medium_opts.set("which", "SA");
+    ok = testEigenpairs(es, medium, medium_exact, 500, medium_opts);
+  }
+
+  // Destroy the eigensolver
+  factory->destroyEigenSolver(es);
+
+  // Cleanup and quit
+  ls_plugin->shutdown();
+  plugin->shutdown();
+
+  return ok;
+}
+
+void
+gridLaplacian(long grid_size, CSR & a, TheaArray<double> & exact_eigenvalues)
+{
+  // Graph Laplacian of a 2D grid. Its eigenvalues are the pairwise sums of the eigenvalues 2 - 2 cos(pi * k / grid_size) of
+  // the path Laplacian.
+  TheaArray<CSR::Entry> entries;
+  for (long i = 0; i < grid_size; ++i)
+    for (long j = 0; j < grid_size; ++j)
+    {
+      long r = i * grid_size + j;
+      double degree = 0;
+      if (i > 0)             { entries.push_back(CSR::Entry(CSR::IndexPair(r, r - grid_size), -1.0)); degree++; }
+      if (i < grid_size - 1) { entries.push_back(CSR::Entry(CSR::IndexPair(r, r + grid_size), -1.0)); degree++; }
+      if (j > 0)             { entries.push_back(CSR::Entry(CSR::IndexPair(r, r - 1), -1.0)); degree++; }
+      if (j < grid_size - 1) { entries.push_back(CSR::Entry(CSR::IndexPair(r, r + 1), -1.0)); degree++; }
+
+      entries.push_back(CSR::Entry(CSR::IndexPair(r, r), degree));
+    }
+
+  long n = grid_size * grid_size;
+  a.setFromEntries(n, n, entries);
+
+  exact_eigenvalues.clear();
+  for (long i = 0; i < grid_size; ++i)
+    for (long j = 0; j < grid_size; ++j)
+      exact_eigenvalues.push_back(4 - 2 * std::cos(Math::pi() * i / grid_size) - 2 * std::cos(Math::pi() * j / grid_size));
+
+  std::sort(exact_eigenvalues.begin(), exact_eigenvalues.end());
+}
+
+bool
+testEigenpairs(EigenSolver * es, CSR const & a, TheaArray<double> const & exact_eigenvalues, long nev, Options const & opts)
+{
+  long n = a.numRows();
+  bool largest = (opts.get<std::string>("which", "LM") == "LA");
+
+  es->setMatrix(a);
+  long num_found = es->solve((int)nev, opts);
+  if (num_found != nev)
+  {
+    cout << "Found " << num_found << " eigenpair(s), expected " << nev << endl;
+    return false;
+  }
+
+  TheaArray<double> found;
+  double max_residual = 0;
+  for (long k = 0; k < nev; ++k)
+  {
+    double lambda = es->getEigenvalues()[(array_size_t)k].real();
+    found.push_back(lambda);
+
+    // Check that A * x = lambda * x
+    EigenSolver::Eigenvector const & x = es->getEigenvectors()[(array_size_t)k];
+    TheaArray<double> ax((array_size_t)n, 0.0);
+    for (CSR::ConstIterator ei = a.begin(); ei != a.end(); ++ei)
+      ax[(array_size_t)ei->first.first] += ei->second * x[(array_size_t)ei->first.second].real();
+
+    double res = 0, norm = 0;
+    for (long i = 0; i < n; ++i)
+    {
+      double d = ax[(array_size_t)i] - lambda * x[(array_size_t)i].real();
+      res += d * d;
+      norm += std::norm(x[(array_size_t)i]);
+    }
+
+    max_residual = std::max(max_residual, std::sqrt(res / norm));
+  }
+
+  std::sort(found.begin(), found.end());
+  double max_err = 0;
+  for (long k = 0; k < nev; ++k)
+  {
+    double expected = (largest ? exact_eigenvalues[exact_eigenvalues.size() - nev + k] : exact_eigenvalues[(array_size_t)k]);
+    max_err = std::max(max_err, std::fabs(found[(array_size_t)k] - expected));
+  }
+
+  printf("%ld eigenpair(s) of %ldx%ld Laplacian (%s%s): maximum eigenvalue error = %g, maximum residual = %g\n", nev, n, n,
+         opts.get<std::string>("which", "LM").c_str(), (opts.hasOption("sigma") ? ", shift-invert" : ""), max_err,
+         max_residual);
+
+  return max_err < 1e-6 && max_residual < 1e-5;
+}
+
+int
+cleanup(int status)
+{
+  Application::getPluginManager().unloadAllPlugins();
+  return status;
+}
@@ -21,6 +21,7 @@ using namespace Thea;
 
 #include "../Algorithms/LaplaceBeltrami.hpp"
 #include "../Graphics/MeshGroup.hpp"
+#include "../CompressedSparseMatrix.hpp"
 #include "../MappedMatrix.hpp"
 #include <cmath>
 #include <fstream>
@@ -33,6 +34,33 @@ using namespace Graphics;
 
 void testLB(int argc, char * argv[]);
 
+// Check that a compressed matrix has exactly the non-zero entries of a mapped matrix, up to floating point error.
+template <typename CompressedMatrixT>
+bool
+sameEntries(MappedMatrix<Real> const & m, CompressedMatrixT const & c)
+{
+  if (c.numRows() != m.numRows() || c.numColumns() != m.numColumns())
+    return false;
+
+  long num_nonzero = 0;
+  for (MappedMatrix<Real>::ConstIterator mi = m.begin(); mi != m.end(); ++mi)
+    if (mi->second != 0)
+      num_nonzero++;
+
+  long num_matched = 0;
+  for (typename CompressedMatrixT::ConstIterator ci = c.begin(); ci != c.end(); ++ci)
+  {
+    Real expected = m.get(ci->first.first, ci->first.second);
+    if (std::fabs(ci->second - expected) > 1e-4f * std::max(std::fabs(expected), 1.0f))
+      return false;
+
+    if (expected != 0)
+      num_matched++;
+  }
+
+  return num_matched == num_nonzero;
+}
+
 int
 main(int argc, char * argv[])
 {
@@ -83,4 +111,16 @@ testLB(int argc, char * argv[])
     cout << "    (" << mi->first.first << ", " << mi->first.second << ") = " << mi->second << '\n';
 
   cout << ']' << endl;
+
+  // The directly assembled compressed matrices should match
+  CompressedRowMatrix<Real> lb_row;
+  LaplaceBeltrami::compute(*mesh, LaplaceBeltrami::Method::XU_2006, lb_row);
+
+  CompressedColumnMatrix<Real> lb_col;
+  LaplaceBeltrami::compute(*mesh, LaplaceBeltrami::Method::XU_2006, lb_col);
+
+  if (!sameEntries(lb, lb_row) || !sameEntries(lb, lb_col))
+    throw Error("Compressed Laplace-Beltrami matrices do not match mapped matrix");
+
+  cout << "Compressed Laplace-Beltrami matrices match mapped matrix" << endl;
 }
@@ -2,7 +2,11 @@
 #include "../Algorithms/LinearLeastSquares.hpp"
 #include "../Algorithms/LogisticRegression.hpp"
 #include "../Array.hpp"
+#include "../Math.hpp"
 #include "../Matrix.hpp"
+#include "../Stopwatch.hpp"
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -10,7 +14,10 @@ using namespace Thea;
 using namespace Algorithms;
 
 bool testSVD();
+bool testStreamingLinearLeastSquares();
 bool testLogisticRegression();
+bool testMatrixMultiplication(bool benchmark);
+bool testFastArcTan2();
 
 int
 main(int argc, char * argv[])
@@ -18,7 +25,10 @@ main(int argc, char * argv[])
   try
   {
     if (!testSVD()) return -1;
+    if (!testStreamingLinearLeastSquares()) return -1;
     if (!testLogisticRegression()) return -1;
+    if (!testMatrixMultiplication(argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)) return -1;
+    if (!testFastArcTan2()) return -1;
   }
   THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "An error occurred")
 
@@ -134,6 +144,152 @@ testSVD()
   return true;
 }
 
+// Check that a streaming system gives the same solutions as the equivalent dense system. The non-negative solutions are compared
+// only if they are unique.
+bool
+compareLinearLeastSquares(LinearLeastSquares & dense, LinearLeastSquares & streaming, char const * desc,
+                          bool unique_non_negative = true)
+{
+  static LinearLeastSquares::Constraint const CONSTRAINTS[2] = { LinearLeastSquares::Constraint::UNCONSTRAINED,
+                                                                 LinearLeastSquares::Constraint::NON_NEGATIVE };
+  static char const * CONSTRAINT_NAMES[2] = { "UNCONSTRAINED", "NON_NEGATIVE" };
+
+  if (dense.numObjectives() != streaming.numObjectives())
+  {
+    cout << "Streaming linear least squares (" << desc << "): objective count mismatch" << endl;
+    return false;
+  }
+
+  for (int i = 0; i < (unique_non_negative ? 2 : 1); ++i)
+  {
+    if (!dense.solve(CONSTRAINTS[i]) || !streaming.solve(CONSTRAINTS[i]))
+    {
+      cout << "Streaming linear least squares (" << desc << "): no solution with constraint " << CONSTRAINT_NAMES[i]
+           << endl;
+      return false;
+    }
+
+    double max_diff = 0;
+    for (long j = 0; j < dense.numDimensions(); ++j)
+      max_diff = std::max(max_diff, std::fabs(dense.getSolution()[(array_size_t)j] - streaming.getSolution()[(array_size_t)j]));
+
+    if (max_diff > 1.0e-6)
+    {
+      cout << "Streaming linear least squares (" << desc << "): solution with constraint " << CONSTRAINT_NAMES[i]
+           << " differs from dense solution by " << max_diff << endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+testStreamingLinearLeastSquares()
+{
+  // The small example above
+  {
+    LinearLeastSquares dense(2), streaming(2, true);
+    double coeffs[2] = { -1, 0 };
+    double constants[4] = { 6, 5, 7, 10 };
+    for (int i = 0; i < 4; ++i)
+    {
+      coeffs[1] = i + 1;
+      dense.addObjective(coeffs, constants[i]);
+      streaming.addObjective(coeffs, constants[i]);
+    }
+
+    if (!compareLinearLeastSquares(dense, streaming, "small")) return false;
+  }
+
+  // A tall random system, accumulated in several partial systems (as separate threads would) and then combined
+  {
+    static long const NDIM = 20, NUM_PARTS = 4, OBJECTIVES_PER_PART = 2500;
+
+    TheaArray<double> x_true((array_size_t)NDIM);
+    for (long j = 0; j < NDIM; ++j)
+      x_true[(array_size_t)j] = 2 * (rand() / (double)RAND_MAX) - 1;
+
+    LinearLeastSquares dense(NDIM), streaming(NDIM, true);
+    TheaArray<double> coeffs((array_size_t)NDIM);
+    for (long p = 0; p < NUM_PARTS; ++p)
+    {
+      LinearLeastSquares part(NDIM, true);
+      for (long i = 0; i < OBJECTIVES_PER_PART; ++i)
+      {
+        double constant = 0.01 * (2 * (rand() / (double)RAND_MAX) - 1);  // noise
+        for (long j = 0; j < NDIM; ++j)
+        {
+          coeffs[(array_size_t)j] = 2 * (rand() / (double)RAND_MAX) - 1;
+          constant += coeffs[(array_size_t)j] * x_true[(array_size_t)j];
+        }
+
+        dense.addObjective(&coeffs[0], constant);
+        part.addObjective(&coeffs[0], constant);
+      }
+
+      streaming.addObjectives(part);
+    }
+
+    if (!compareLinearLeastSquares(dense, streaming, "random")) return false;
+
+    // Clearing the system should leave no trace of previous objectives
+    streaming.clearObjectives();
+    dense.clearObjectives();
+    for (long i = 0; i < 3 * NDIM; ++i)
+    {
+      double constant = 0;
+      for (long j = 0; j < NDIM; ++j)
+      {
+        coeffs[(array_size_t)j] = 2 * (rand() / (double)RAND_MAX) - 1;
+        constant += coeffs[(array_size_t)j];
+      }
+
+      dense.addObjective(&coeffs[0], constant);
+      streaming.addObjective(&coeffs[0], constant);
+    }
+
+    if (!compareLinearLeastSquares(dense, streaming, "cleared")) return false;
+  }
+
+  // A rank-deficient system (two identical columns), which needs the SVD fallback
+  {
+    LinearLeastSquares dense(3), streaming(3, true);
+    double coeffs[3];
+    for (int i = 0; i < 50; ++i)
+    {
+      coeffs[0] = coeffs[1] = 2 * (rand() / (double)RAND_MAX) - 1;
+      coeffs[2] = 2 * (rand() / (double)RAND_MAX) - 1;
+      double constant = 3 * coeffs[0] - 0.5 * coeffs[2] + 0.01 * (2 * (rand() / (double)RAND_MAX) - 1);
+
+      dense.addObjective(coeffs, constant);
+      streaming.addObjective(coeffs, constant);
+    }
+
+    if (!compareLinearLeastSquares(dense, streaming, "rank-deficient", false)) return false;
+
+    // The non-negative solution is not unique, but the sum of the weights of the identical columns is
+    if (!dense.solve(LinearLeastSquares::Constraint::NON_NEGATIVE)
+     || !streaming.solve(LinearLeastSquares::Constraint::NON_NEGATIVE))
+    {
+      cout << "Streaming linear least squares (rank-deficient): no non-negative solution" << endl;
+      return false;
+    }
+
+    TheaArray<double> const & xd = dense.getSolution();
+    TheaArray<double> const & xs = streaming.getSolution();
+    if (std::fabs((xd[0] + xd[1]) - (xs[0] + xs[1])) > 1.0e-6 || std::fabs(xd[2] - xs[2]) > 1.0e-6)
+    {
+      cout << "Streaming linear least squares (rank-deficient): non-negative solution differs from dense solution" << endl;
+      return false;
+    }
+  }
+
+  cout << "\nStreaming linear least squares solutions match dense solutions" << endl;
+
+  return true;
+}
+
 bool
 testLogisticRegression()
 {
@@ -169,3 +325,223 @@ testLogisticRegression()
 
   return true;
 }
+
+// Fill a matrix with random values in [-1, 1].
+template <typename MatrixT>
+void
+randomFill(MatrixT & m)
+{
+  for (long r = 0; r < m.numRows(); ++r)
+    for (long c = 0; c < m.numColumns(); ++c)
+      m(r, c) = static_cast<typename MatrixT::Value>(2 * (rand() / (double)RAND_MAX) - 1);
+}
+
+// Multiply two matrices with the simple triple loop that Matrix::operator* used before it was blocked.
+template <typename MatrixT, typename MatrixU, typename MatrixV>
+void
+naiveMultiply(MatrixT const & a, MatrixU const & b, MatrixV & result)
+{
+  result.resize(a.numRows(), b.numColumns());
+  for (long i = 0; i < a.numRows(); ++i)
+    for (long k = 0; k < b.numColumns(); ++k)
+    {
+      result(i, k) = a(i, 0) * b(0, k);
+
+      for (long j = 1; j < a.numColumns(); ++j)
+        result(i, k) += a(i, j) * b(j, k);
+    }
+}
+
+// Get the largest absolute difference between corresponding elements of two matrices of the same size.
+template <typename MatrixT, typename MatrixU>
+double
+maxAbsDifference(MatrixT const & a, MatrixU const & b)
+{
+  double max_diff = 0;
+  for (long r = 0; r < a.numRows(); ++r)
+    for (long c = 0; c < a.numColumns(); ++c)
+      max_diff = std::max(max_diff, std::fabs((double)a(r, c) - (double)b(r, c)));
+
+  return max_diff;
+}
+
+// Check products of matrices with the given element type and layouts against the naive implementation.
+template <typename T, MatrixLayout::Value L1, MatrixLayout::Value L2, MatrixLayout::Value L3>
+bool
+testMatrixProducts(double tolerance)
+{
+  static long const SIZES[][3] = { { 1, 1, 1 }, { 3, 5, 7 }, { 17, 33, 9 }, { 64, 64, 64 }, { 100, 37, 250 },
+                                   { 301, 257, 513 }, { 600, 500, 300 }, { 2500, 1000, 2 } };
+
+  for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); ++i)
+  {
+    long m = SIZES[i][0], k = SIZES[i][1], n = SIZES[i][2];
+
+    Matrix<T, L1> a(m, k);
+    Matrix<T, L2> b(k, n);
+    randomFill(a);
+    randomFill(b);
+
+    Matrix<T, L3> product;
+    Matrix<double> expected;
+    naiveMultiply(Matrix<double>(a), Matrix<double>(b), expected);
+    multiply(a, b, product);
+
+    if (product.numRows() != m || product.numColumns() != n || maxAbsDifference(product, expected) > tolerance * k)
+    {
+      cout << "Incorrect " << m << " x " << k << " x " << n << " matrix product" << endl;
+      return false;
+    }
+
+    // Matrix-vector products
+    TheaArray<T> x((array_size_t)k), y((array_size_t)m), z((array_size_t)k);
+    for (long j = 0; j < k; ++j) x[(array_size_t)j] = b(j, 0);
+
+    a.postmulVector(&x[0], &y[0]);
+    for (long r = 0; r < m; ++r)
+      if (std::fabs((double)y[(array_size_t)r] - (double)product(r, 0)) > tolerance * k)
+      {
+        cout << "Incorrect product of " << m << " x " << k << " matrix and vector" << endl;
+        return false;
+      }
+
+    a.premulVector(&y[0], &z[0]);
+    Matrix<double> yt(1, m);
+    for (long r = 0; r < m; ++r) yt(0, r) = y[(array_size_t)r];
+
+    Matrix<double> expected_z;
+    naiveMultiply(yt, Matrix<double>(a), expected_z);
+    for (long j = 0; j < k; ++j)
+      if (std::fabs((double)z[(array_size_t)j] - expected_z(0, j)) > tolerance * m * k)
+      {
+        cout << "Incorrect product of vector and " << m << " x " << k << " matrix" << endl;
+        return false;
+      }
+  }
+
+  return true;
+}
+
+bool
+testMatrixMultiplication(bool benchmark)
+{
+  //====================================================================
+  // Correctness of blocked products, for all combinations of layouts
+  //====================================================================
+
+  static MatrixLayout::Value const R = MatrixLayout::ROW_MAJOR;
+  static MatrixLayout::Value const C = MatrixLayout::COLUMN_MAJOR;
+
+  bool ok = testMatrixProducts<float, R, R, R>(1.0e-5)
+         && testMatrixProducts<float, R, C, R>(1.0e-5)
+         && testMatrixProducts<float, C, R, C>(1.0e-5)
+         && testMatrixProducts<float, C, C, R>(1.0e-5)
+         && testMatrixProducts<double, R, R, R>(1.0e-12)
+         && testMatrixProducts<double, C, R, R>(1.0e-12)
+         && testMatrixProducts<double, R, C, C>(1.0e-12)
+         && testMatrixProducts<double, C, C, C>(1.0e-12)
+         && testMatrixProducts<long double, R, R, C>(1.0e-12);  // generic (non-SIMD) kernel
+  if (!ok)
+    return false;
+
+  // Output parameters: reusing an existing matrix or storage block, and products that overwrite an operand
+  Matrix<double> a(50, 50), b(50, 50), expected;
+  randomFill(a);
+  randomFill(b);
+  naiveMultiply(a, b, expected);
+
+  TheaArray<double> storage(50 * 50);
+  Matrix<double> wrapper(&storage[0], 50, 50);
+  multiply(a, b, wrapper);
+
+  Matrix<double> a_copy = a;
+  multiply(a_copy, b, a_copy);
+
+  Matrix<double> a_times_b = a;
+  a_times_b *= b;
+
+  if (maxAbsDifference(wrapper, expected) > 1.0e-10 || maxAbsDifference(a_copy, expected) > 1.0e-10
+   || maxAbsDifference(a_times_b, expected) > 1.0e-10 || maxAbsDifference(a * b, expected) > 1.0e-10)
+  {
+    cout << "Incorrect matrix product with output parameter" << endl;
+    return false;
+  }
+
+  cout << "\nMatrix products are correct" << endl;
+
+  //====================================================================
+  // Benchmark against the naive product (pass --benchmark to run)
+  //====================================================================
+
+  if (benchmark)
+  {
+    Stopwatch timer;
+    for (long n = 64; n <= 4096; n *= 2)
+    {
+      Matrix<float> fa(n, n), fb(n, n), fc, fd;
+      randomFill(fa);
+      randomFill(fb);
+
+      // The naive product takes too long for large matrices, so time it on a block of rows and extrapolate
+      long naive_rows = std::min(n, 256L);
+      Matrix<float> fa_rows(naive_rows, n);
+      for (long r = 0; r < naive_rows; ++r)
+        for (long c = 0; c < n; ++c)
+          fa_rows(r, c) = fa(r, c);
+
+      timer.tick();
+        naiveMultiply(fa_rows, fb, fd);
+      timer.tock();
+      double naive_time = timer.elapsedTime() * (n / (double)naive_rows);
+
+      timer.tick();
+        multiply(fa, fb, fc);
+      timer.tock();
+      double blocked_time = timer.elapsedTime();
+
+      TheaArray<float> x((array_size_t)n, 1.0f), y((array_size_t)n);
+      timer.tick();
+        for (int i = 0; i < 10; ++i)
+          fa.postmulVector(&x[0], &y[0]);
+      timer.tock();
+      double gemv_time = timer.elapsedTime() / 10;
+
+      cout << n << " x " << n << " float product: naive " << naive_time << "s, blocked " << blocked_time << "s ("
+           << 2e-9 * n * n * (double)n / blocked_time << " GFLOPS), matrix-vector " << 1000 * gemv_time << "ms" << endl;
+    }
+  }
+
+  return true;
+}
+
+bool
+testFastArcTan2()
+{
+  //====================================================================
+  // Fast atan2
+  //====================================================================
+
+  // Points on the axes and in every octant, including negative zeros
+  // Include large ratios, for which the lookup table rounds the arctangent of the smaller ratio to zero
+  static float const COORDS[] = { -2000.0f, -1025.0f, -3.0f, -1.0f, -0.25f, -0.0f, 0.0f, 0.25f, 1.0f, 3.0f, 1025.0f, 2000.0f };
+  static int const NUM_COORDS = (int)(sizeof(COORDS) / sizeof(float));
+
+  for (int i = 0; i < NUM_COORDS; ++i)
+    for (int j = 0; j < NUM_COORDS; ++j)
+    {
+      float dy = COORDS[i], dx = COORDS[j];
+      if (dy == 0 && dx == 0)
+        continue;
+
+      float a = Math::fastArcTan2(dy, dx);
+      float b = std::atan2(dy, dx);
+      if (std::fabs(a - b) > 1.0e-2f && std::fabs(std::fabs(a - b) - Math::twoPi()) > 1.0e-2f)  // -pi and pi are equivalent
+      {
+        THEA_ERROR << "fastArcTan2(" << dy << ", " << dx << ") = " << a << ", expected " << b;
+        return false;
+      }
+    }
+
+  cout << "\nFast atan2 test passed" << endl;
+  return true;
+}
@@ -0,0 +1,111 @@
+#include "../Algorithms/MeanShiftN.hpp"
+#include "../Common.hpp"
+#include "../Array.hpp"
+#include "../Random.hpp"
+#include "../Vector3.hpp"
+#include "../VectorN.hpp"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+template <long N> bool testMeanShift(long num_blobs, long points_per_blob, Real spread, bool bin_seeding);
+
+int
+main(int argc, char * argv[])
+{
+  if (!testMeanShift<3>(4, 500, 0.1f, true)) return -1;
+  if (!testMeanShift<3>(3, 100, 0.1f, false)) return -1;
+  if (!testMeanShift<16>(5, 300, 0.05f, true)) return -1;
+
+  cout << "Test passed" << endl;
+  return 0;
+}
+
+template <long N>
+bool
+testMeanShift(long num_blobs, long points_per_blob, Real spread, bool bin_seeding)
+{
+  typedef VectorN<N, Real> VectorT;
+
+  cout << "\nClustering " << num_blobs << " blobs of " << points_per_blob << " points each in " << N << "-D" << endl;
+
+  // Well-separated Gaussian blobs, with centers at distance 2 from each other (scaled basis vectors)
+  Random rng(1234);
+  TheaArray<VectorT> centers((array_size_t)num_blobs);
+  TheaArray<VectorT> points;
+  TheaArray<long> blob_of_point;
+  for (long i = 0; i < num_blobs; ++i)
+  {
+    centers[(array_size_t)i] = VectorT(0);
+    centers[(array_size_t)i][i % N] = (Real)(i / N + 1) * std::sqrt(2.0f);
+
+    for (long j = 0; j < points_per_blob; ++j)
+    {
+      VectorT p = centers[(array_size_t)i];
+      for (long k = 0; k < N; ++k)
+        p[k] += rng.gaussian(0, spread);
+
+      points.push_back(p);
+      blob_of_point.push_back(i);
+    }
+  }
+
+  MeanShiftN<N, Real> ms(typename MeanShiftN<N, Real>::Options().setBandwidth(0.5).setBinSeeding(bin_seeding));
+  long num_modes = ms.cluster(points.begin(), points.end());
+
+  cout << "Found " << num_modes << " modes from " << ms.numSeeds() << " seeds" << endl;
+  if (num_modes != num_blobs)
+  {
+    cerr << "Expected " << num_blobs << " modes" << endl;
+    return false;
+  }
+
+  // Each mode should be close to a distinct blob center, and label exactly the points of that blob
+  TheaArray<long> blob_of_mode((array_size_t)num_modes, -1);
+  for (long i = 0; i < num_modes; ++i)
+  {
+    VectorT const & mode = ms.getMode(i);
+    cout << "  Mode " << i << ": support = " << ms.getModeSupport(i) << endl;
+
+    for (long j = 0; j < num_blobs; ++j)
+      if ((mode - centers[(array_size_t)j]).length() < 3 * spread)
+        blob_of_mode[(array_size_t)i] = j;
+
+    if (blob_of_mode[(array_size_t)i] < 0)
+    {
+      cerr << "Mode " << i << " is not near any blob center" << endl;
+      return false;
+    }
+
+    if (Math::fuzzyNe(ms.getModeSupport(i), (Real)points_per_blob))
+    {
+      cerr << "Mode " << i << " has support " << ms.getModeSupport(i) << ", expected " << points_per_blob << endl;
+      return false;
+    }
+  }
+
+  for (array_size_t i = 0; i < points.size(); ++i)
+  {
+    long label = ms.getLabel((long)i);
+    if (label < 0 || blob_of_mode[(array_size_t)label] != blob_of_point[i])
+    {
+      cerr << "Point " << i << " is mislabeled" << endl;
+      return false;
+    }
+  }
+
+  // Weighted points should count multiple times towards the support of their modes
+  TheaArray<Real> weights(points.size(), 1);
+  weights[0] = 10;
+  ms.cluster(points.begin(), points.end(), &weights[0]);
+  if (ms.numModes() != num_blobs || Math::fuzzyNe(ms.getModeSupport(ms.getLabel(0)), (Real)(points_per_blob + 9)))
+  {
+    cerr << "Weighted clustering failed: " << ms.numModes() << " modes, support " << ms.getModeSupport(ms.getLabel(0)) << endl;
+    return false;
+  }
+
+  return true;
+}
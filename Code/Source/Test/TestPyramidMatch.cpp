@@ -1,17 +1,29 @@
 #include "../Common.hpp"
 #include "../Algorithms/PyramidMatch.hpp"
+#include "../Algorithms/PyramidMatchCorpus.hpp"
+#include "../Random.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
 
 using namespace std;
 using namespace Thea;
 using namespace Algorithms;
 
+bool testCorpus(PyramidMatch::Kernel kernel, char const * kernel_name, int levels);
+
 int
 main(int argc, char * argv[])
 {
   try
   {
     PyramidMatch::test();
+
+    if (!testCorpus(PyramidMatch::Kernel::HIK,          "HIK",         -1)) return -1;
+    if (!testCorpus(PyramidMatch::Kernel::L1,           "L1",          -1)) return -1;
+    if (!testCorpus(PyramidMatch::Kernel::L2,           "L2",           2)) return -1;
+    if (!testCorpus(PyramidMatch::Kernel::CHI_SQUARED,  "chi-squared", -1)) return -1;
   }
   THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "An error occurred")
 
@@ -19,3 +31,92 @@ main(int argc, char * argv[])
   cout << "PyramidMatch: Test completed" << endl;
   return 0;
 }
+
+bool
+approxEq(Real x, Real y)
+{
+  return std::fabs(x - y) <= 1.0e-4f * std::max(std::max(std::fabs(x), std::fabs(y)), (Real)1);
+}
+
+bool
+testCorpus(PyramidMatch::Kernel kernel, char const * kernel_name, int levels)
+{
+  cout << "=============================\n"
+          "Pyramid Match: Corpus test (kernel " << kernel_name << ", levels " << levels << ')' << endl;
+
+  // Random 2D pyramids, not a multiple of the tile sizes
+  static int const NUM_PYRAMIDS = 150;
+  static int const NX = 16, NY = 8;
+
+  Random rng(5678);
+  TheaArray<Pyramid2D::Ptr> pyramids;
+  PyramidMatchCorpus corpus(kernel, levels, 0.5f);
+  TheaArray<Real> base(NX * NY);
+  for (int i = 0; i < NUM_PYRAMIDS; ++i)
+  {
+    for (array_size_t j = 0; j < base.size(); ++j)
+      base[j] = rng.uniform(0, 2);
+
+    pyramids.push_back(Pyramid2D::Ptr(new Pyramid2D(&base[0], NX, NY)));
+    corpus.add(*pyramids.back());
+  }
+
+  Matrix<Real> sim;
+  corpus.computeSimilarityMatrix(sim);
+  for (int i = 0; i < NUM_PYRAMIDS; ++i)
+    for (int j = 0; j < NUM_PYRAMIDS; ++j)
+    {
+      Real expected = PyramidMatch::similarity(*pyramids[(array_size_t)i], *pyramids[(array_size_t)j], kernel, levels, 0.5f);
+      if (!approxEq(sim(i, j), expected) || !approxEq(corpus.similarity(i, j), expected))
+      {
+        cerr << "Corpus similarity (" << i << ", " << j << ") = " << sim(i, j) << ", expected " << expected << endl;
+        return false;
+      }
+    }
+
+  // The k most similar pyramids should be the k largest entries of each row of the similarity matrix
+  static long const K = 7;
+  Matrix<long> indices;
+  Matrix<Real> scores;
+  corpus.findMostSimilar(K, indices, scores);
+  if (indices.numRows() != NUM_PYRAMIDS || indices.numColumns() != K)
+  {
+    cerr << "Top-k result has wrong size" << endl;
+    return false;
+  }
+
+  for (int i = 0; i < NUM_PYRAMIDS; ++i)
+  {
+    TheaArray<Real> row;
+    for (int j = 0; j < NUM_PYRAMIDS; ++j)
+      if (j != i)
+        row.push_back(sim(i, j));
+
+    std::sort(row.begin(), row.end(), std::greater<Real>());
+
+    for (long m = 0; m < K; ++m)
+    {
+      long j = indices(i, m);
+      if (j < 0 || j == i || !approxEq(scores(i, m), row[(array_size_t)m]) || !approxEq(scores(i, m), sim(i, j)))
+      {
+        cerr << "Top-k neighbor " << m << " of pyramid " << i << " is incorrect" << endl;
+        return false;
+      }
+    }
+  }
+
+  // Queries from a separate corpus, with more neighbors requested than exist
+  PyramidMatchCorpus queries(kernel, levels, 0.5f);
+  queries.add(*pyramids[3]);
+  queries.add(*pyramids[100]);
+
+  corpus.findMostSimilar(queries, NUM_PYRAMIDS + 5, indices, scores);
+  if (indices(0, 0) != 3 || indices(1, 0) != 100 || indices(0, NUM_PYRAMIDS) != -1 || indices(1, NUM_PYRAMIDS - 1) < 0)
+  {
+    cerr << "Top-k search with separate query corpus failed" << endl;
+    return false;
+  }
+
+  cout << "Corpus results agree with pairwise similarities" << endl;
+  return true;
+}
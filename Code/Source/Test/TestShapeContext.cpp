@@ -0,0 +1,161 @@
+#include "../Common.hpp"
+#include "../Algorithms/ImageFeatures/ShapeContext.hpp"
+#include "../Array.hpp"
+#include "../Image.hpp"
+#include "../Math.hpp"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+bool testDenseExact();
+bool testDenseApprox();
+
+int
+main(int argc, char * argv[])
+{
+  try
+  {
+    if (!testDenseExact()) return -1;
+    if (!testDenseApprox()) return -1;
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "An error occurred")
+
+  cout << "Test passed" << endl;
+  return 0;
+}
+
+static int const WIDTH = 48;
+static int const HEIGHT = 40;
+static long const NUM_RADIAL_BINS = 4;
+static long const NUM_POLAR_BINS = 8;
+
+// A small contour image: a circle, a horizontal line at half intensity and a vertical line.
+void
+makeContourImage(Image & image)
+{
+  image = Image(Image::Type::LUMINANCE_8U, WIDTH, HEIGHT);
+
+  for (int i = 0; i < HEIGHT; ++i)
+  {
+    uint8 * scanline = (uint8 *)image.getScanLine(i);
+    for (int j = 0; j < WIDTH; ++j)
+      scanline[j] = 0;
+  }
+
+  for (int t = 0; t < 1000; ++t)
+  {
+    double a = t * Math::twoPi() / 1000;
+    int x = (int)(0.5 * WIDTH + 0.3 * WIDTH * std::cos(a));
+    int y = (int)(0.5 * HEIGHT + 0.3 * HEIGHT * std::sin(a));
+    ((uint8 *)image.getScanLine(y))[x] = 255;
+  }
+
+  uint8 * line = (uint8 *)image.getScanLine(HEIGHT / 4);
+  for (int j = 0; j < WIDTH; ++j)
+    line[j] = 128;
+
+  for (int i = HEIGHT / 3; i < HEIGHT; ++i)
+    ((uint8 *)image.getScanLine(i))[WIDTH / 5] = 255;
+}
+
+// Sum of absolute differences between two sets of shape contexts, and the maximum absolute difference.
+void
+compareShapeContexts(TheaArray<Real> const & dense, TheaArray<Real> const & exact, double & total_err, double & max_err,
+                     double & total)
+{
+  total_err = max_err = total = 0;
+  for (array_size_t i = 0; i < exact.size(); ++i)
+  {
+    double err = std::fabs(dense[i] - exact[i]);
+    total_err += err;
+    max_err = std::max(max_err, err);
+    total += std::fabs(exact[i]);
+  }
+}
+
+bool
+testDenseExact()
+{
+  cout << "\nTesting exact dense shape contexts" << endl;
+
+  Image image;
+  makeContourImage(image);
+
+  ImageFeatures::ShapeContext sc(image);
+
+  TheaArray<Real> exact, dense;
+  sc.compute(NUM_RADIAL_BINS, NUM_POLAR_BINS, exact, true);
+  sc.computeDense(NUM_RADIAL_BINS, NUM_POLAR_BINS, dense, true, -1, 0);
+
+  if (dense.size() != exact.size())
+  {
+    cerr << "Dense shape contexts have " << dense.size() << " values instead of " << exact.size() << endl;
+    return false;
+  }
+
+  // Compare pixel by pixel, bin by bin
+  long entry_size = NUM_RADIAL_BINS * NUM_POLAR_BINS;
+  for (array_size_t i = 0; i < exact.size(); ++i)
+  {
+    if (std::fabs(dense[i] - exact[i]) > 1.0e-4f * (1 + std::fabs(exact[i])))
+    {
+      long pixel = (long)i / entry_size, bin = (long)i % entry_size;
+      cerr << "Dense shape context at row " << pixel / WIDTH << ", column " << pixel % WIDTH << ", bin (" << bin / NUM_POLAR_BINS
+           << ", " << bin % NUM_POLAR_BINS << ") is " << dense[i] << " instead of " << exact[i] << endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+testDenseApprox()
+{
+  cout << "\nTesting approximate dense shape contexts" << endl;
+
+  Image image;
+  makeContourImage(image);
+
+  ImageFeatures::ShapeContext sc(image);
+
+  TheaArray<Real> exact, dense;
+  sc.compute(NUM_RADIAL_BINS, NUM_POLAR_BINS, exact, true);
+
+  // The error should shrink with the size of the boundary cells, and stay within a small fraction of the total mass (the
+  // bounds are about twice the observed errors)
+  Real fractions[]        = { 1.0f, 0.5f, 0.25f, 0.1f };
+  double rel_err_bounds[] = { 0.5, 0.2, 0.05, 0.005 };
+
+  double last_err = -1;
+  for (size_t k = 0; k < sizeof(fractions) / sizeof(fractions[0]); ++k)
+  {
+    sc.computeDense(NUM_RADIAL_BINS, NUM_POLAR_BINS, dense, true, -1, fractions[k]);
+
+    double total_err, max_err, total;
+    compareShapeContexts(dense, exact, total_err, max_err, total);
+
+    double rel_err = total_err / total;
+    cout << "Cell fraction " << fractions[k] << ": relative L1 error = " << rel_err << ", max error = " << max_err << endl;
+
+    if (rel_err > rel_err_bounds[k])
+    {
+      cerr << "Relative error of approximate shape contexts with cell fraction " << fractions[k] << " exceeds "
+           << rel_err_bounds[k] << endl;
+      return false;
+    }
+
+    if (last_err >= 0 && total_err > last_err)
+    {
+      cerr << "Error of approximate shape contexts does not decrease with the cell fraction" << endl;
+      return false;
+    }
+
+    last_err = total_err;
+  }
+
+  return true;
+}
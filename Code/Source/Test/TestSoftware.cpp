@@ -0,0 +1,360 @@
+#include "../Common.hpp"
+#include "../Application.hpp"
+#include "../FilePath.hpp"
+#include "../Image.hpp"
+#include "../Plugin.hpp"
+#include "../Graphics/Framebuffer.hpp"
+#include "../Graphics/RenderSystem.hpp"
+#include "../Graphics/Texture.hpp"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+using namespace Graphics;
+
+// Size of the render targets. Larger than a single screen tile of the rasterizer, and not a multiple of the tile size.
+static int const WIDTH = 256;
+static int const HEIGHT = 200;
+
+// Subpixel steps per pixel. Vertices placed on this grid are not moved by the rasterizer's snapping.
+static int const SUBPIXELS = 16;
+
+bool testSoftware(int argc, char * argv[]);
+bool testClear(RenderSystem * rs, Texture * color_tex, Texture * depth_tex);
+bool testCoverage(RenderSystem * rs, Texture * color_tex);
+bool testDepth(RenderSystem * rs, Texture * color_tex, Texture * depth_tex);
+bool testManyTriangles(RenderSystem * rs, Texture * color_tex);
+int cleanup(int status);
+
+int
+main(int argc, char * argv[])
+{
+  bool ok;
+  try
+  {
+    ok = testSoftware(argc, argv);
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return cleanup(-1);, ERROR, "%s", "An error occurred")
+
+  if (ok)  // hooray, all tests passed
+    cout << "Test passed" << endl;
+  else  // test failed
+    cout << "Test failed" << endl;
+
+  return cleanup(ok ? 0 : -1);
+}
+
+bool
+testSoftware(int argc, char * argv[])
+{
+  // Get the path containing the executable
+  string bin_path = FilePath::parent(argv[0]);
+
+  // Try to load the software rendering plugin from the same parent directory as the executable
+#ifdef THEA_DEBUG_BUILD
+  string plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginSoftwared");
+#else
+  string plugin_path = FilePath::concat(bin_path, "../lib/libTheaPluginSoftware");
+#endif
+
+  cout << "Loading plugin: " << plugin_path << endl;
+  Plugin * plugin = Application::getPluginManager().load(plugin_path);
+
+  // Start up the plugin
+  plugin->startup();
+
+  // We should now have a software rendersystem factory
+  RenderSystemFactory * factory = Application::getRenderSystemManager().getFactory("Software");
+
+  // Create a rendersystem, and a framebuffer with color and depth attachments
+  RenderSystem * rs = factory->createRenderSystem("My software rendersystem");
+
+  Texture::Options tex_opts = Texture::Options::defaults();
+  tex_opts.interpolateMode = Texture::InterpolateMode::NEAREST_NO_MIPMAP;
+  Texture * color_tex = rs->createTexture("Color", WIDTH, HEIGHT, 1, TextureFormat::RGBA8(), Texture::Dimension::DIM_2D,
+                                          tex_opts);
+  Texture * depth_tex = rs->createTexture("Depth", WIDTH, HEIGHT, 1, TextureFormat::DEPTH16(), Texture::Dimension::DIM_2D,
+                                          tex_opts);
+
+  Framebuffer * fb = rs->createFramebuffer("Framebuffer");
+  fb->attach(Framebuffer::AttachmentPoint::COLOR_0, color_tex);
+  fb->attach(Framebuffer::AttachmentPoint::DEPTH, depth_tex);
+  rs->setFramebuffer(fb);
+
+  // Vertices are specified directly in normalized device coordinates
+  rs->setMatrixMode(RenderSystem::MatrixMode::PROJECTION); rs->setIdentityMatrix();
+  rs->setMatrixMode(RenderSystem::MatrixMode::MODELVIEW); rs->setIdentityMatrix();
+
+  bool ok = testClear(rs, color_tex, depth_tex)
+         && testCoverage(rs, color_tex)
+         && testDepth(rs, color_tex, depth_tex)
+         && testManyTriangles(rs, color_tex);
+
+  rs->setFramebuffer(NULL);
+  rs->destroyFramebuffer(fb);
+  rs->destroyTexture(depth_tex);
+  rs->destroyTexture(color_tex);
+  factory->destroyRenderSystem(rs);
+
+  return ok;
+}
+
+// Read back the color and depth buffers.
+void
+readBuffers(Texture * color_tex, Texture * depth_tex, Image & color, Image & depth)
+{
+  color = Image(Image::Type::RGBA_32F, WIDTH, HEIGHT);
+  color_tex->getImage(color);
+
+  if (depth_tex)
+  {
+    depth = Image(Image::Type::LUMINANCE_32F, WIDTH, HEIGHT);
+    depth_tex->getImage(depth);
+  }
+}
+
+// Get the color of a pixel of an image read back from the color buffer.
+ColorRGBA
+pixelColor(Image const & color, int x, int y)
+{
+  float const * p = static_cast<float const *>(color.getScanLine(y)) + 4 * x;
+  return ColorRGBA(p[AbstractImage::Channel::RED], p[AbstractImage::Channel::GREEN], p[AbstractImage::Channel::BLUE],
+                   p[AbstractImage::Channel::ALPHA]);
+}
+
+// Get the value of a pixel of an image read back from the depth buffer.
+float
+pixelDepth(Image const & depth, int x, int y)
+{
+  return static_cast<float const *>(depth.getScanLine(y))[x];
+}
+
+// Check if two colors are equal up to 8-bit quantization.
+bool
+sameColor(ColorRGBA const & a, ColorRGBA const & b)
+{
+  static float const TOL = 1.0f / 255;
+  return std::fabs(a.r() - b.r()) <= TOL && std::fabs(a.g() - b.g()) <= TOL && std::fabs(a.b() - b.b()) <= TOL
+      && std::fabs(a.a() - b.a()) <= TOL;
+}
+
+// A triangle with vertices on the subpixel grid, in window coordinates measured in subpixels.
+struct GridTriangle
+{
+  long x[3], y[3];
+
+  // Send the triangle to the rendersystem, at a given normalized depth in [-1, 1].
+  void draw(RenderSystem * rs, float z) const
+  {
+    rs->beginPrimitive(RenderSystem::Primitive::TRIANGLES);
+      for (int i = 0; i < 3; ++i)
+        rs->sendVertex(2 * x[i] / (float)(SUBPIXELS * WIDTH) - 1, 2 * y[i] / (float)(SUBPIXELS * HEIGHT) - 1, z);
+    rs->endPrimitive();
+  }
+
+  // Check if the center of pixel (px, py) is strictly inside (1), strictly outside (-1), or on the boundary (0) of the triangle.
+  // Exact, since everything is an integer number of half-subpixels.
+  int classify(int px, int py) const
+  {
+    long cx = 2 * px * SUBPIXELS + SUBPIXELS, cy = 2 * py * SUBPIXELS + SUBPIXELS;
+    long area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    int num_pos = 0, num_neg = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+      int j = (i + 1) % 3;
+      long e = (2 * x[j] - 2 * x[i]) * (cy - 2 * y[i]) - (2 * y[j] - 2 * y[i]) * (cx - 2 * x[i]);
+      if (area < 0) e = -e;
+      if (e > 0) num_pos++; else if (e < 0) num_neg++;
+    }
+
+    return num_neg > 0 ? -1 : (num_pos == 3 ? 1 : 0);
+  }
+
+}; // struct GridTriangle
+
+bool
+testClear(RenderSystem * rs, Texture * color_tex, Texture * depth_tex)
+{
+  ColorRGBA clear_color(0.25f, 0.5f, 0.75f, 1.0f);
+  rs->setColorClearValue(clear_color);
+  rs->setDepthClearValue(0.375f);
+  rs->clear();
+
+  // Clearing only the color buffer should leave the depth buffer untouched
+  ColorRGBA clear_color2(1.0f, 0.0f, 0.5f, 0.25f);
+  rs->setColorClearValue(clear_color2);
+  rs->setDepthClearValue(1.0f);
+  rs->clear(true, false, false);
+
+  Image color, depth;
+  readBuffers(color_tex, depth_tex, color, depth);
+
+  long num_bad_color = 0, num_bad_depth = 0;
+  for (int y = 0; y < HEIGHT; ++y)
+    for (int x = 0; x < WIDTH; ++x)
+    {
+      if (!sameColor(pixelColor(color, x, y), clear_color2)) num_bad_color++;
+      if (std::fabs(pixelDepth(depth, x, y) - 0.375f) > 1e-4f) num_bad_depth++;
+    }
+
+  cout << "Clear: " << num_bad_color << " wrong color(s), " << num_bad_depth << " wrong depth(s)" << endl;
+
+  return num_bad_color == 0 && num_bad_depth == 0;
+}
+
+bool
+testCoverage(RenderSystem * rs, Texture * color_tex)
+{
+  ColorRGBA bg(0, 0, 0, 1), fg(1, 1, 1, 1);
+  rs->setColorClearValue(bg);
+  rs->setDepthClearValue(1.0f);
+  rs->clear();
+  rs->setDepthTest(RenderSystem::DepthTest::ALWAYS_PASS);
+
+  // A slanted triangle spanning several tiles. Pixel centers lying exactly on an edge are decided by the fill convention, and are
+  // not checked.
+  GridTriangle tri = { { 5 * SUBPIXELS + 3, 231 * SUBPIXELS + 11, 97 * SUBPIXELS + 8 },
+                       { 12 * SUBPIXELS + 9, 70 * SUBPIXELS + 1, 188 * SUBPIXELS + 5 } };
+  rs->setColor(fg);
+  tri.draw(rs, 0);
+
+  Image color, depth;
+  readBuffers(color_tex, NULL, color, depth);
+
+  long num_inside = 0, num_covered = 0, num_wrong = 0;
+  for (int y = 0; y < HEIGHT; ++y)
+    for (int x = 0; x < WIDTH; ++x)
+    {
+      ColorRGBA c = pixelColor(color, x, y);
+      bool covered = sameColor(c, fg);
+      if (covered) num_covered++;
+
+      if (!covered && !sameColor(c, bg))
+      {
+        num_wrong++;
+        continue;
+      }
+
+      int side = tri.classify(x, y);
+      if (side > 0) num_inside++;
+      if ((side > 0 && !covered) || (side < 0 && covered)) num_wrong++;
+    }
+
+  cout << "Coverage: " << num_covered << " pixel(s) covered, " << num_inside << " pixel center(s) strictly inside, "
+       << num_wrong << " wrong pixel(s)" << endl;
+
+  return num_inside > 0 && num_wrong == 0;
+}
+
+bool
+testDepth(RenderSystem * rs, Texture * color_tex, Texture * depth_tex)
+{
+  ColorRGBA red(1, 0, 0, 1), green(0, 1, 0, 1), blue(0, 0, 1, 1);
+  rs->setColorClearValue(ColorRGBA(0, 0, 0, 1));
+  rs->setDepthClearValue(1.0f);
+  rs->clear();
+  rs->setDepthTest(RenderSystem::DepthTest::LESS);
+
+  // A red background at depth 0.75, a green triangle in front of it at depth 0.5, and a blue triangle covering the whole
+  // screen behind both at depth 0.9
+  long w = SUBPIXELS * WIDTH, h = SUBPIXELS * HEIGHT;
+  GridTriangle bg1 = { { 0, w, w }, { 0, 0, h } };
+  GridTriangle bg2 = { { 0, w, 0 }, { 0, h, h } };
+  GridTriangle front = { { 40 * SUBPIXELS + 7, 200 * SUBPIXELS + 2, 70 * SUBPIXELS + 13 },
+                         { 30 * SUBPIXELS + 5, 60 * SUBPIXELS + 11, 170 * SUBPIXELS + 1 } };
+  GridTriangle back = { { -w, 3 * w, -w }, { -h, -h, 3 * h } };
+
+  rs->setColor(red);
+  bg1.draw(rs, 0.5f);
+  bg2.draw(rs, 0.5f);
+
+  rs->setColor(green);
+  front.draw(rs, 0.0f);
+
+  rs->setColor(blue);
+  back.draw(rs, 0.8f);
+
+  Image color, depth;
+  readBuffers(color_tex, depth_tex, color, depth);
+
+  long num_front = 0, num_wrong_color = 0, num_wrong_depth = 0;
+  for (int y = 0; y < HEIGHT; ++y)
+    for (int x = 0; x < WIDTH; ++x)
+    {
+      int side = front.classify(x, y);
+      if (side == 0)
+        continue;
+
+      ColorRGBA expected_color = (side > 0 ? green : red);
+      float expected_depth = (side > 0 ? 0.5f : 0.75f);
+      if (side > 0) num_front++;
+
+      if (!sameColor(pixelColor(color, x, y), expected_color)) num_wrong_color++;
+      if (std::fabs(pixelDepth(depth, x, y) - expected_depth) > 1e-3f) num_wrong_depth++;
+    }
+
+  cout << "Depth test: " << num_front << " pixel(s) in front, " << num_wrong_color << " wrong color(s), " << num_wrong_depth
+       << " wrong depth(s)" << endl;
+
+  return num_front > 0 && num_wrong_color == 0 && num_wrong_depth == 0;
+}
+
+bool
+testManyTriangles(RenderSystem * rs, Texture * color_tex)
+{
+  // Enough triangles to be set up and rasterized in parallel. Together they cover a rectangle exactly once, so every pixel
+  // center in the rectangle must be covered and no other pixel may be.
+  static int const GRID = 24;
+  long x0 = 17 * SUBPIXELS + 4, y0 = 9 * SUBPIXELS + 12;
+  long cell_w = 9 * SUBPIXELS, cell_h = 7 * SUBPIXELS;
+
+  ColorRGBA bg(0, 0, 0, 1), fg(1, 1, 0, 1);
+  rs->setColorClearValue(bg);
+  rs->clear();
+  rs->setDepthTest(RenderSystem::DepthTest::ALWAYS_PASS);
+  rs->setColor(fg);
+
+  rs->beginPrimitive(RenderSystem::Primitive::TRIANGLES);
+    for (int i = 0; i < GRID; ++i)
+      for (int j = 0; j < GRID; ++j)
+      {
+        float xa = 2 * (x0 + i * cell_w) / (float)(SUBPIXELS * WIDTH) - 1;
+        float xb = 2 * (x0 + (i + 1) * cell_w) / (float)(SUBPIXELS * WIDTH) - 1;
+        float ya = 2 * (y0 + j * cell_h) / (float)(SUBPIXELS * HEIGHT) - 1;
+        float yb = 2 * (y0 + (j + 1) * cell_h) / (float)(SUBPIXELS * HEIGHT) - 1;
+
+        rs->sendVertex(xa, ya); rs->sendVertex(xb, ya); rs->sendVertex(xb, yb);
+        rs->sendVertex(xa, ya); rs->sendVertex(xb, yb); rs->sendVertex(xa, yb);
+      }
+  rs->endPrimitive();
+
+  Image color, depth;
+  readBuffers(color_tex, NULL, color, depth);
+
+  // The pixel centers (x + 0.5, y + 0.5), in subpixels, lying strictly inside the rectangle. Its edges are not at pixel centers.
+  long x1 = x0 + GRID * cell_w, y1 = y0 + GRID * cell_h;
+  long num_expected = 0, num_wrong = 0;
+  for (int y = 0; y < HEIGHT; ++y)
+    for (int x = 0; x < WIDTH; ++x)
+    {
+      long cx = x * SUBPIXELS + SUBPIXELS / 2, cy = y * SUBPIXELS + SUBPIXELS / 2;
+      bool inside = (cx > x0 && cx < x1 && cy > y0 && cy < y1);
+      if (inside) num_expected++;
+
+      ColorRGBA c = pixelColor(color, x, y);
+      if (!sameColor(c, inside ? fg : bg)) num_wrong++;
+    }
+
+  cout << "Many triangles: " << 2 * GRID * GRID << " triangle(s), " << num_expected << " pixel(s) expected, " << num_wrong
+       << " wrong pixel(s)" << endl;
+
+  return num_expected > 0 && num_wrong == 0;
+}
+
+int
+cleanup(int status)
+{
+  Application::getPluginManager().unloadAllPlugins();
+  return status;
+}
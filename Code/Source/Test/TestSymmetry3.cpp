@@ -0,0 +1,132 @@
+#include "../Common.hpp"
+#include "../Algorithms/Symmetry3.hpp"
+#include "../Array.hpp"
+#include "../Math.hpp"
+#include "../Plane3.hpp"
+#include "../Random.hpp"
+#include "../Vector3.hpp"
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace Thea;
+using namespace Algorithms;
+
+bool testFindPlaneFast(long num_points);
+bool testFindPlaneFastTiny();
+
+int
+main(int argc, char * argv[])
+{
+  try
+  {
+    if (!testFindPlaneFast(2000)) return -1;
+    if (!testFindPlaneFast(20000)) return -1;
+    if (!testFindPlaneFastTiny()) return -1;
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "An error occurred")
+
+  cout << "Test passed" << endl;
+  return 0;
+}
+
+// Generate a point cloud that is mirror-symmetric (up to a little noise) about a plane through a given point with a given
+// normal, but has no other obvious symmetries.
+void
+mirrorSymmetricCloud(long num_points, Vector3 const & normal, Vector3 const & center, Random & rng, TheaArray<Vector3> & points)
+{
+  Vector3 a, b;
+  normal.createOrthonormalBasis(a, b);
+
+  points.clear();
+  while ((long)points.size() < num_points)
+  {
+    Real s = rng.uniform(0, 1), t = rng.uniform(-1, 1);
+    Real w = rng.uniform(0.1f, 0.8f) * (0.5f + s * s + 0.3f * t);
+    Vector3 p = center + (2 * s - 1) * a + t * (0.5f + 0.5f * s) * b;
+
+    points.push_back(p + w * normal);
+    points.push_back(p - w * normal + Vector3(rng.gaussian(0, 0.002f), 0, 0));
+  }
+}
+
+bool
+testFindPlaneFast(long num_points)
+{
+  cout << "\nTesting fast symmetry plane search with " << num_points << " points" << endl;
+
+  Vector3 normal = Vector3(0.3f, 0.8f, -0.5f).unit();
+  Random rng(1234);
+  TheaArray<Vector3> points;
+  mirrorSymmetricCloud(num_points, normal, Vector3(0.1f, 0.2f, 0.3f), rng, points);
+
+  Plane3 fast_plane, plane;
+  double fast_error = Symmetry3<Vector3>::findPlaneFast(points.begin(), points.end(), fast_plane);
+  double error = Symmetry3<Vector3>::findPlane(points.begin(), points.end(), plane);
+
+  Real dot = std::fabs(fast_plane.getNormal().dot(normal));
+  cout << "findPlaneFast: |normal . true normal| = " << dot << ", error = " << fast_error << endl;
+  cout << "findPlane: |normal . true normal| = " << std::fabs(plane.getNormal().dot(normal)) << ", error = " << error << endl;
+
+  if (dot < 0.999f)
+  {
+    cerr << "findPlaneFast did not recover the symmetry plane" << endl;
+    return false;
+  }
+
+  // The plane should pass through the center of symmetry, i.e. the centroid
+  if (std::fabs(fast_plane.distance(Vector3(0.1f, 0.2f, 0.3f))) > 0.05f)
+  {
+    cerr << "Plane found by findPlaneFast is offset from the true plane" << endl;
+    return false;
+  }
+
+  if (std::fabs(fast_error - error) > 0.005 + 0.25 * error)
+  {
+    cerr << "Error of plane found by findPlaneFast is not close to that of findPlane" << endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool
+testFindPlaneFastTiny()
+{
+  cout << "\nTesting fast symmetry plane search with tiny inputs" << endl;
+
+  Vector3 normal = Vector3(-0.2f, 0.1f, 1.0f).unit();
+  Random rng(1234);
+
+  // Fewer points than are used in the first round, and degenerate inputs. Subsampling a small input (with a small maximum
+  // number of samples) breaks up mirrored pairs, so the plane need not be recovered, but the result must still be valid.
+  long sizes[] = { 40, 2, 1 };
+  long max_coarse_samples[] = { -1, 16 };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    for (size_t j = 0; j < sizeof(max_coarse_samples) / sizeof(max_coarse_samples[0]); ++j)
+    {
+      TheaArray<Vector3> points;
+      mirrorSymmetricCloud(sizes[i], normal, Vector3(0, 0, 0), rng, points);
+      points.resize((array_size_t)sizes[i]);
+
+      Plane3 plane;
+      double error = Symmetry3<Vector3>::findPlaneFast(points.begin(), points.end(), plane, NULL, -1, max_coarse_samples[j]);
+
+      Vector3 n = plane.getNormal();
+      if (!(error >= 0 && error <= 1) || !Math::isFinite(n.x()) || !Math::isFinite(n.y()) || !Math::isFinite(n.z())
+       || std::fabs(n.length() - 1) > 1.0e-4f)
+      {
+        cerr << "findPlaneFast with " << sizes[i] << " points returned a bad plane " << plane.toString() << " with error "
+             << error << endl;
+        return false;
+      }
+
+      if (sizes[i] >= 40 && max_coarse_samples[j] < 0 && std::fabs(n.dot(normal)) < 0.99f)
+      {
+        cerr << "findPlaneFast with " << sizes[i] << " points did not recover the symmetry plane" << endl;
+        return false;
+      }
+    }
+
+  return true;
+}
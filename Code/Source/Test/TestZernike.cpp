@@ -3,6 +3,8 @@
 #include "../Image.hpp"
 #include "../ImageMatrix.hpp"
 #include "../Math.hpp"
+#include "../Matrix.hpp"
+#include "../Random.hpp"
 #include "../Vector3.hpp"
 #include "../Vector4.hpp"
 #include "../VectorN.hpp"
@@ -48,11 +50,88 @@ zernike(ImageMatrix<T> const & m)
   return 0;
 }
 
+bool
+testBatch()
+{
+  cout << "=============================\n"
+          "Zernike: Batch test" << endl;
+
+  // Random blobby silhouettes of different sizes, some of them empty
+  static int const NUM_DISTRIBS = 37;
+
+  Random rng(1234);
+  TheaArray< Matrix<float> > distribs((array_size_t)NUM_DISTRIBS);
+  TheaArray<double> center_x((array_size_t)NUM_DISTRIBS), center_y((array_size_t)NUM_DISTRIBS),
+                    radius((array_size_t)NUM_DISTRIBS);
+  TheaArray< Matrix<float> const * > distrib_ptrs((array_size_t)NUM_DISTRIBS);
+
+  for (array_size_t i = 0; i < distribs.size(); ++i)
+  {
+    int nrows = rng.integer(20, 80), ncols = rng.integer(20, 80);
+    Matrix<float> & m = distribs[i];
+    m.resize(nrows, ncols);
+    m.fill(0);
+
+    double cx = rng.uniform(0.3f, 0.7f) * ncols, cy = rng.uniform(0.3f, 0.7f) * nrows;
+    double r = 0.3 * std::min(nrows, ncols);
+    if (i % 10 != 9)
+    {
+      for (int y = 0; y < nrows; ++y)
+        for (int x = 0; x < ncols; ++x)
+          if (Math::square(x - cx) + 2 * Math::square(y - cy) < r * r)
+            m(y, x) = (rng.integer(0, 3) == 0 ? 0.5f : 1.0f);
+    }
+
+    center_x[i] = 0.5 * (ncols - 1);
+    center_y[i] = 0.5 * (nrows - 1);
+    radius[i] = 0.5 * sqrt((double)(Math::square(ncols) + Math::square(nrows)));
+    distrib_ptrs[i] = &m;
+  }
+
+  Zernike2 zernike;
+  long num_moments = zernike.numMoments();
+  TheaArray< std::complex<double> > batch_moments((array_size_t)(NUM_DISTRIBS * num_moments));
+  TheaArray<long> batch_counts((array_size_t)NUM_DISTRIBS);
+  zernike.computeBatch(NUM_DISTRIBS, &distrib_ptrs[0], &center_x[0], &center_y[0], &radius[0], &batch_moments[0],
+                       &batch_counts[0]);
+
+  // Each distribution should have the same moments as when computed on its own, by a different object with the same (shared)
+  // lookup table
+  Zernike2 zernike2;
+  TheaArray< std::complex<double> > moments;
+  for (array_size_t i = 0; i < distribs.size(); ++i)
+  {
+    long count = zernike2.compute(distribs[i], center_x[i], center_y[i], radius[i], moments);
+    if (count != batch_counts[i])
+    {
+      cerr << "Distribution " << i << " has " << batch_counts[i] << " non-zero pixels in batch, expected " << count << endl;
+      return false;
+    }
+
+    for (long j = 0; j < num_moments; ++j)
+    {
+      std::complex<double> const & b = batch_moments[(array_size_t)(i * num_moments + j)];
+      if (abs(b - moments[(array_size_t)j]) > 1.0e-5)
+      {
+        cerr << "Batch moment " << j << " of distribution " << i << " = " << b << ", expected " << moments[(array_size_t)j]
+             << endl;
+        return false;
+      }
+    }
+  }
+
+  cout << "Batch moments agree with individually computed moments" << endl;
+  return true;
+}
+
 int
 main(int argc, char * argv[])
 {
   try
   {
+    if (!testBatch())
+      return -1;
+
     if (argc < 2)
     {
       cerr << "Usage: " << argv[0] << " <image-file>" << endl;
@@ -336,6 +336,8 @@ MainWindow::init()
         break;
       }
     }
+
+    prefetchAdjacentModels();
   }
 
   //==========================================================================================================================
@@ -404,7 +406,10 @@ void
 MainWindow::selectAndLoadModel(wxEvent & event)
 {
   if (model->selectAndLoad())
+  {
     clearOverlays();
+    prefetchAdjacentModels();
+  }
 }
 
 void
@@ -469,7 +474,8 @@ MainWindow::loadPreviousModel(wxEvent & event)
   getMeshPatterns(patterns);
 
   TheaArray<std::string> files;
-  long index = fileIndex(FilePath::parent(FileSystem::resolve(model->getPath())), model->getPath(), files, &patterns);
+  long index = fileIndex(FilePath::parent(FileSystem::resolve(model->getLoadingPath())), model->getLoadingPath(), files,
+                         &patterns);
   if (files.empty())
     return;
 
@@ -481,9 +487,11 @@ MainWindow::loadPreviousModel(wxEvent & event)
   clearOverlays();
 
   if (index == 0)
-    model->load(files[files.size() - 1]);
+    model->load(files[files.size() - 1], true /* async */);
   else
-    model->load(files[index - 1]);
+    model->load(files[index - 1], true /* async */);
+
+  prefetchAdjacentModels();
 }
 
 void
@@ -493,7 +501,8 @@ MainWindow::loadNextModel(wxEvent & event)
   getMeshPatterns(patterns);
 
   TheaArray<std::string> files;
-  long index = fileIndex(FilePath::parent(FileSystem::resolve(model->getPath())), model->getPath(), files, &patterns);
+  long index = fileIndex(FilePath::parent(FileSystem::resolve(model->getLoadingPath())), model->getLoadingPath(), files,
+                         &patterns);
   if (files.empty())
     return;
 
@@ -505,9 +514,32 @@ MainWindow::loadNextModel(wxEvent & event)
   clearOverlays();
 
   if (index == (long)files.size() - 1)
-    model->load(files[0]);
+    model->load(files[0], true /* async */);
   else
-    model->load(files[index + 1]);
+    model->load(files[index + 1], true /* async */);
+
+  prefetchAdjacentModels();
+}
+
+void
+MainWindow::prefetchAdjacentModels()
+{
+  TheaArray<std::string> patterns;
+  getMeshPatterns(patterns);
+
+  TheaArray<std::string> files;
+  long index = fileIndex(FilePath::parent(FileSystem::resolve(model->getLoadingPath())), model->getLoadingPath(), files,
+                         &patterns);
+  if (index < 0 || files.size() < 2)
+    return;
+
+  long n = (long)files.size();
+  TheaArray<std::string> adjacent;
+  adjacent.push_back(files[(array_size_t)((index + 1) % n)]);
+  if (n > 2)
+    adjacent.push_back(files[(array_size_t)((index + n - 1) % n)]);
+
+  model->prefetch(adjacent);
 }
 
 void
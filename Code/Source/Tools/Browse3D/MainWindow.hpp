@@ -216,6 +216,9 @@ class MainWindow : public wxFrame
     /** Get rid of all overlay models. */
     void clearOverlays();
 
+    /** Start loading the models before and after the current one in its directory, in the background. */
+    void prefetchAdjacentModels();
+
     /** Show or hide the toolbox. */
     void setToolboxVisible(bool value);
 
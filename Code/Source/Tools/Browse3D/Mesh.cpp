@@ -42,11 +42,35 @@
 #include "Mesh.hpp"
 #include "../../Algorithms/CentroidN.hpp"
 #include "../../Math.hpp"
+#include <boost/thread/tss.hpp>
 
 namespace Browse3D {
 
-Mesh::IndexVertexMap Mesh::index_to_vertex;
-Mesh::IndexFaceMap Mesh::index_to_face;
+Mesh::IndexMaps Mesh::index_maps;
+
+namespace MeshInternal {
+
+// The maps are owned by whoever called Mesh::setThreadIndexMaps(), so don't delete them on thread exit.
+void
+releaseIndexMaps(Mesh::IndexMaps * maps)
+{}
+
+boost::thread_specific_ptr<Mesh::IndexMaps> thread_index_maps(releaseIndexMaps);
+
+} // namespace MeshInternal
+
+void
+Mesh::setThreadIndexMaps(IndexMaps * maps)
+{
+  MeshInternal::thread_index_maps.reset(maps);
+}
+
+Mesh::IndexMaps &
+Mesh::loadingIndexMaps()
+{
+  IndexMaps * maps = MeshInternal::thread_index_maps.get();
+  return maps ? *maps : index_maps;
+}
 
 MeshGroup *
 Mesh::getAncestor(long generations) const
@@ -89,7 +89,8 @@ class FaceAttribute : public Graphics::ColorAttribute<ColorRGBA>
 };
 
 // FIXME: In a huge hack, we make the assumption there is only one set of vertex indices and one set of face indices in the
-// entire program, and declare these as static variables. This avoids having to pass separate structures around.
+// entire program (per loading thread), and declare these as static variables. This avoids having to pass separate structures
+// around.
 class Mesh : public Graphics::GeneralMesh<VertexAttribute, Graphics::NullAttribute, FaceAttribute>
 {
   private:
@@ -100,6 +101,17 @@ class Mesh : public Graphics::GeneralMesh<VertexAttribute, Graphics::NullAttribu
   public:
     THEA_DEF_POINTER_TYPES(Mesh, shared_ptr, weak_ptr)
 
+    /** Maps from vertex and face indices to the corresponding mesh elements. */
+    struct IndexMaps
+    {
+      IndexVertexMap vertices;
+      IndexFaceMap faces;
+
+      /** Swap the contents of the maps with another set. */
+      void swap(IndexMaps & other) { vertices.swap(other.vertices); faces.swap(other.faces); }
+
+    }; // struct IndexMaps
+
     Mesh(std::string const & name = "AnonymousMesh") : NamedObject(name), BaseType(name), parent(NULL), valid_features(false) {}
 
     typedef BaseType::Vertex Vertex;
@@ -112,7 +124,7 @@ class Mesh : public Graphics::GeneralMesh<VertexAttribute, Graphics::NullAttribu
 
       if (vertex)
       {
-        index_to_vertex[index] = vertex;
+        loadingIndexMaps().vertices[index] = vertex;
         vertex->attr().setParent(this);
       }
 
@@ -126,7 +138,7 @@ class Mesh : public Graphics::GeneralMesh<VertexAttribute, Graphics::NullAttribu
 
       if (face)
       {
-        index_to_face[index] = face;
+        loadingIndexMaps().faces[index] = face;
         face->attr().setParent(this);
       }
 
@@ -135,26 +147,39 @@ class Mesh : public Graphics::GeneralMesh<VertexAttribute, Graphics::NullAttribu
 
     static void resetVertexIndices()
     {
-      index_to_vertex.clear();
+      loadingIndexMaps().vertices.clear();
     }
 
     static Vertex * mapIndexToVertex(long index)
     {
-      IndexVertexMap::const_iterator existing = index_to_vertex.find(index);
-      return existing == index_to_vertex.end() ? NULL : existing->second;
+      IndexVertexMap::const_iterator existing = index_maps.vertices.find(index);
+      return existing == index_maps.vertices.end() ? NULL : existing->second;
     }
 
     static void resetFaceIndices()
     {
-      index_to_face.clear();
+      loadingIndexMaps().faces.clear();
     }
 
     static Face * mapIndexToFace(long index)
     {
-      IndexFaceMap::const_iterator existing = index_to_face.find(index);
-      return existing == index_to_face.end() ? NULL : existing->second;
+      IndexFaceMap::const_iterator existing = index_maps.faces.find(index);
+      return existing == index_maps.faces.end() ? NULL : existing->second;
     }
 
+    /**
+     * Make meshes loaded by the calling thread record their element indices in \a maps instead of the global maps queried by
+     * mapIndexToVertex() and mapIndexToFace(). This allows meshes to be loaded in the background while the global maps are in
+     * use. Pass null to revert to the global maps. The caller retains ownership of \a maps.
+     */
+    static void setThreadIndexMaps(IndexMaps * maps);
+
+    /**
+     * Swap the global index maps with another set, typically filled in the background after a call to setThreadIndexMaps().
+     * Should be called only from the main thread.
+     */
+    static void swapIndexMaps(IndexMaps & maps) { index_maps.swap(maps); }
+
     void setParent(MeshGroup * p) { parent = p; }
     MeshGroup * getParent() const { return parent; }
 
@@ -168,13 +193,15 @@ class Mesh : public Graphics::GeneralMesh<VertexAttribute, Graphics::NullAttribu
   private:
     void updateFeatures() const;
 
+    /** Get the maps to which the calling thread should write element indices. */
+    static IndexMaps & loadingIndexMaps();
+
     MeshGroup * parent;
 
     mutable bool valid_features;
     mutable TheaArray<double> features;
 
-    static IndexVertexMap index_to_vertex;  // horrible hack
-    static IndexFaceMap index_to_face;  // horrible hack
+    static IndexMaps index_maps;  // horrible hack
 
 }; // class Mesh
 
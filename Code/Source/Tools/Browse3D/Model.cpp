@@ -53,9 +53,13 @@
 #include "../../Graphics/MeshCodec.hpp"
 #include "../../BoundedSortedArrayN.hpp"
 #include "../../Colors.hpp"
+#include "../../FeatureFile.hpp"
 #include "../../FilePath.hpp"
 #include "../../FileSystem.hpp"
 #include <wx/filedlg.h>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <algorithm>
 #include <fstream>
 
@@ -65,6 +69,10 @@ wxDEFINE_EVENT(EVT_MODEL_NEEDS_REDRAW,         wxCommandEvent);
 wxDEFINE_EVENT(EVT_MODEL_NEEDS_SYNC_SAMPLES,   wxCommandEvent);
 wxDEFINE_EVENT(EVT_MODEL_NEEDS_SYNC_SEGMENTS,  wxCommandEvent);
 
+// Sent from background threads when a loading job reaches a new stage
+wxDECLARE_EVENT(EVT_MODEL_LOAD_PROGRESS,        wxThreadEvent);
+wxDEFINE_EVENT(EVT_MODEL_LOAD_PROGRESS,         wxThreadEvent);
+
 namespace Browse3D {
 
 namespace ModelInternal {
@@ -110,6 +118,107 @@ linkMeshesToParent(MeshGroupPtr mesh_group)
 static ColorRGBA const DEFAULT_COLOR(1.0f, 0.9f, 0.8f, 1.0f);
 static ColorRGBA const PICKED_SEGMENT_COLOR(0.4f, 0.69f, 0.21f, 1.0f);
 
+// Reads a model from disk and builds its kd-trees, optionally in a background thread. The job first parses the geometry and
+// applies the default features and element labels, after which the model can be displayed (stage PARSED). It then builds the
+// kd-trees, after which the model can be picked (stage COMPLETED). The listener, if any, is sent EVT_MODEL_LOAD_PROGRESS at
+// each stage. The results are read by the main thread only after the corresponding stage has been reached.
+class LoadJob
+{
+  public:
+    enum Stage { STARTED, PARSED, COMPLETED, FAILED };
+
+    LoadJob(std::string const & path_)
+    : path(path_), has_features(false), has_elem_labels(false), kdtree(NULL), vertex_kdtree(NULL), installed(false),
+      stage(STARTED), listener(NULL), cancelled(false)
+    {}
+
+    ~LoadJob()
+    {
+      delete vertex_kdtree;
+      delete kdtree;
+    }
+
+    // Run a job in a new thread, which keeps it alive until it finishes.
+    static void start(shared_ptr<LoadJob> job);
+
+    // Run the job in the calling thread.
+    void run();
+
+    Stage getStage() const
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return stage;
+    }
+
+    // Block until the job has finished.
+    void wait() const
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      while (stage != COMPLETED && stage != FAILED)
+        finished.wait(lock);
+    }
+
+    // Set the handler to be notified of progress. If the job has already made some progress, it is notified immediately.
+    void setListener(wxEvtHandler * listener_)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      listener = listener_;
+      if (listener && stage != STARTED)
+        wxQueueEvent(listener, new wxThreadEvent(EVT_MODEL_LOAD_PROGRESS));
+    }
+
+    // Skip any remaining stages that can be skipped and stop sending notifications.
+    void cancel()
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      cancelled = true;
+      listener = NULL;
+    }
+
+    std::string path;
+    MeshGroupPtr mesh_group;
+    PointCloudPtr point_cloud;
+    Mesh::IndexMaps index_maps;
+    AxisAlignedBox3 bounds;
+    std::string features_path;
+    bool has_features;
+    bool has_elem_labels;
+    Model::KDTree * kdtree;
+    Model::VertexKDTree * vertex_kdtree;
+
+    bool installed;  // set by the main thread once it has switched to the loaded model
+
+  private:
+    // Load the geometry, features and labels.
+    bool parse();
+
+    // Build the kd-trees on the loaded mesh.
+    void buildKDTrees();
+
+    bool isCancelled() const
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      return cancelled;
+    }
+
+    void setStage(Stage stage_)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      stage = stage_;
+      if (listener)
+        wxQueueEvent(listener, new wxThreadEvent(EVT_MODEL_LOAD_PROGRESS));
+
+      finished.notify_all();
+    }
+
+    Stage stage;
+    wxEvtHandler * listener;
+    bool cancelled;
+    mutable boost::mutex mutex;
+    mutable boost::condition_variable finished;
+
+}; // class LoadJob
+
 } // namespace ModelInternal
 
 Model::Model(std::string const & initial_mesh)
@@ -125,6 +234,8 @@ Model::Model(std::string const & initial_mesh)
   valid_vertex_kdtree(true),
   vertex_kdtree(new VertexKDTree)
 {
+  Bind(EVT_MODEL_LOAD_PROGRESS, &Model::loadProgress, this);
+
   load(initial_mesh);
 
   picked_sample.type = "Picked";
@@ -132,6 +243,10 @@ Model::Model(std::string const & initial_mesh)
 
 Model::~Model()
 {
+  cancelLoad();
+  for (array_size_t i = 0; i < prefetched.size(); ++i)
+    prefetched[i]->cancel();
+
   delete vertex_kdtree;
   delete kdtree;
 }
@@ -156,6 +271,15 @@ Model::isEmpty() const
 void
 Model::clear()
 {
+  // Make sure no background job is still reading the mesh before clearing it
+  if (pending_load && pending_load->installed)
+  {
+    pending_load->cancel();
+    pending_load->wait();
+  }
+
+  cancelLoad();
+
   clearMesh();
   clearPoints();
   invalidateAll();
@@ -178,67 +302,221 @@ Model::clearPoints()
 }
 
 bool
-Model::load(std::string path_)
+Model::load(std::string path_, bool async)
 {
+  using namespace ModelInternal;
+
   if (path_.empty())
     return false;
 
   path_ = FileSystem::resolve(path_);
-  if (!FileSystem::fileExists(path_) || path_ == FileSystem::resolve(path))
+  if (!FileSystem::fileExists(path_))
     return false;
 
-  if (endsWith(toLower(path_), ".pts"))
+  if (pending_load && pending_load->path == path_)
   {
-    clear();
+    if (async)
+      return true;
 
-    point_cloud = PointCloudPtr(new PointCloud);
-    if (!point_cloud->load(path_))
-      return false;
+    pending_load->wait();
+    checkLoad();
+    return path == path_;
+  }
 
-    bounds = point_cloud->getBounds();
-    path = path_;
+  cancelLoad();
+
+  if (path_ == FileSystem::resolve(path))
+    return false;
+
+  LoadJobPtr job;
+  for (array_size_t i = 0; i < prefetched.size(); ++i)
+    if (prefetched[i]->path == path_)
+    {
+      job = prefetched[i];
+      prefetched.erase(prefetched.begin() + i);
+      break;
+    }
+
+  if (!job)
+  {
+    job = LoadJobPtr(new LoadJob(path_));
+    if (async)
+      LoadJob::start(job);
+    else
+      job->run();
   }
-  else
+
+  pending_load = job;
+
+  if (async)
   {
-    MeshGroupPtr new_mesh_group(new MeshGroup("Mesh Group"));
+    job->setListener(this);
+    return true;
+  }
 
-    Mesh::resetVertexIndices();  // reset counting
-    Mesh::resetFaceIndices();
+  job->wait();
+  checkLoad();
 
-    static CodecOBJ<Mesh> const obj_codec(CodecOBJ<Mesh>::ReadOptions().setIgnoreTexCoords(true));
-    try
+  return path == path_;
+}
+
+void
+Model::prefetch(TheaArray<std::string> const & paths)
+{
+  using namespace ModelInternal;
+
+  TheaArray<LoadJobPtr> jobs;
+  for (array_size_t i = 0; i < paths.size(); ++i)
+  {
+    if (paths[i].empty())
+      continue;
+
+    std::string p = FileSystem::resolve(paths[i]);
+    if (!FileSystem::fileExists(p) || p == FileSystem::resolve(getLoadingPath()))
+      continue;
+
+    LoadJobPtr job;
+    for (array_size_t j = 0; j < prefetched.size(); ++j)
+      if (prefetched[j] && prefetched[j]->path == p)
+      {
+        job = prefetched[j];
+        prefetched[j].reset();
+        break;
+      }
+
+    if (!job)
     {
-      if (endsWith(toLower(path_), ".obj"))
-        new_mesh_group->load(path_, obj_codec);
-      else
-        new_mesh_group->load(path_);
+      job = LoadJobPtr(new LoadJob(p));
+      LoadJob::start(job);
     }
-    THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "Couldn't load model '%s'", path_.c_str())
 
-    invalidateAll();
+    jobs.push_back(job);
+  }
+
+  // Discard the files that are no longer needed
+  for (array_size_t i = 0; i < prefetched.size(); ++i)
+    if (prefetched[i])
+      prefetched[i]->cancel();
+
+  prefetched.swap(jobs);
+}
+
+std::string const &
+Model::getLoadingPath() const
+{
+  return pending_load && !pending_load->installed ? pending_load->path : path;
+}
+
+void
+Model::cancelLoad()
+{
+  if (pending_load)
+  {
+    pending_load->cancel();
+    pending_load.reset();
+  }
+}
+
+void
+Model::loadProgress(wxThreadEvent & event)
+{
+  checkLoad();
+}
+
+void
+Model::checkLoad()
+{
+  using namespace ModelInternal;
+
+  if (!pending_load)
+    return;
 
-    ModelInternal::linkMeshesToParent(new_mesh_group);
+  LoadJob::Stage stage = pending_load->getStage();
+  if (stage == LoadJob::FAILED)
+  {
+    THEA_WARNING << "Couldn't load model '" << pending_load->path << '\'';
+    pending_load.reset();
+    return;
+  }
+
+  if (stage == LoadJob::STARTED)
+    return;
 
-    mesh_group = new_mesh_group;
-    clearPoints();
+  if (!pending_load->installed)
+    installLoaded(*pending_load);
+
+  if (stage == LoadJob::COMPLETED)
+  {
+    installLoadedKDTrees();
+    wxPostEvent(this, wxCommandEvent(EVT_MODEL_NEEDS_REDRAW));
+  }
+}
 
-    bounds = new_mesh_group->getBounds();
+void
+Model::installLoaded(ModelInternal::LoadJob & job)
+{
+  // Replace, rather than clear, the previous model since an abandoned background job might still be reading it
+  mesh_group = job.mesh_group;
+  point_cloud = job.point_cloud;
+  Mesh::swapIndexMaps(job.index_maps);
 
-    THEA_CONSOLE << "Loaded model '" << path_ << "' with bounding box " << mesh_group->getBounds().toString();
+  invalidateAll();
+  invalidatePick();
+  picked_segment.clear();
+  samples.clear();
+  segments.clear();
 
-    path = path_;
+  bounds = job.bounds;
+  path = job.path;
+  features_path = job.features_path;
+  has_features = job.has_features;
+  has_elem_labels = job.has_elem_labels;
 
+  if (mesh_group)
+  {
     loadSamples(getSamplesPath());
     loadSegments(getSegmentsPath());
-    loadFeatures(getDefaultFeaturesPath());
   }
 
-  loadElementLabels(getDefaultElementLabelsPath());
+  job.installed = true;
 
   wxPostEvent(this, wxCommandEvent(EVT_MODEL_PATH_CHANGED));
   wxPostEvent(this, wxCommandEvent(EVT_MODEL_GEOMETRY_CHANGED));
+}
 
-  return true;
+void
+Model::installLoadedKDTrees() const
+{
+  if (!pending_load || !pending_load->installed)
+    return;
+
+  pending_load->wait();
+
+  if (pending_load->kdtree)
+  {
+    delete kdtree;
+    kdtree = pending_load->kdtree;
+    pending_load->kdtree = NULL;
+
+    if (hasTransform())
+      kdtree->setTransform(getTransform());
+
+    valid_kdtree = true;
+  }
+
+  if (pending_load->vertex_kdtree)
+  {
+    delete vertex_kdtree;
+    vertex_kdtree = pending_load->vertex_kdtree;
+    pending_load->vertex_kdtree = NULL;
+
+    if (hasTransform())
+      vertex_kdtree->setTransform(getTransform());
+
+    valid_vertex_kdtree = true;
+  }
+
+  pending_load.reset();
 }
 
 bool
@@ -252,7 +530,7 @@ Model::selectAndLoad()
   if (file_dialog.ShowModal() == wxID_CANCEL)
       return false;
 
-  bool success = load(file_dialog.GetPath().ToStdString());
+  bool success = load(file_dialog.GetPath().ToStdString(), true /* async */);
   if (success)
     ModelInternal::first_file_dialog = false;
 
@@ -301,6 +579,10 @@ Model::updateKDTree() const
 {
   if (valid_kdtree) return;
 
+  // If the kd-tree is being built in the background, wait for it instead of building another one
+  installLoadedKDTrees();
+  if (valid_kdtree) return;
+
   kdtree->clear(false);
 
   if (mesh_group)
@@ -348,6 +630,9 @@ Model::updateVertexKDTree() const
 {
   if (valid_vertex_kdtree) return;
 
+  installLoadedKDTrees();
+  if (valid_vertex_kdtree) return;
+
   vertex_kdtree->clear(false);
 
   TheaArray<MeshVertex *> verts;
@@ -1081,73 +1366,97 @@ struct VertexFeatureVisitor
   Real const * feat_vals2;
 };
 
-} // namespace ModelInternal
-
-bool
-Model::loadFeatures(std::string const & path_)
+// Read the positions of sample points, and all feature channels except the positions, from a columnar feature file.
+void
+readColumnarFeatures(std::string const & path, TheaArray<Vector3> & feat_pts, TheaArray< TheaArray<Real> > & feat_vals)
 {
-  using namespace ModelInternal;
+  FeatureFileReader reader(path);
+  long num_points = reader.numPoints();
 
-  features_path = path_;
+  long pos_feat = reader.findFeature("position");
+  if (pos_feat < 0 || reader.getFeatureDims(pos_feat) != 3)
+    throw Error("Columnar feature file has no point positions");
 
-  if (point_cloud)
+  feat_pts.resize((array_size_t)num_points);
+  float32 p[3];
+  for (long i = 0; i < num_points; ++i)
   {
-    has_features = point_cloud->loadFeatures(path_);
-    return has_features;
+    reader.getValues(pos_feat, i, p);
+    feat_pts[(array_size_t)i] = Vector3(p[0], p[1], p[2]);
   }
 
-  if (!mesh_group)
+  feat_vals.clear();
+  TheaArray<float32> values((array_size_t)num_points);
+  for (long i = 0; i < reader.numFeatures(); ++i)
   {
-    has_features = false;
-    return has_features;
+    if (i == pos_feat)
+      continue;
+
+    for (long j = 0; j < reader.getFeatureDims(i); ++j)
+    {
+      if (num_points > 0)
+        reader.getDimension(i, j, &values[0]);
+
+      feat_vals.push_back(TheaArray<Real>(values.begin(), values.end()));
+    }
   }
 
+  if (feat_vals.empty())
+    feat_pts.clear();  // nothing to color by
+}
+
+// Color the vertices of a mesh group by features read from a file.
+bool
+colorByFeatures(MeshGroup & mesh_group, std::string const & path)
+{
   TheaArray<Vector3> feat_pts;
   TheaArray< TheaArray<Real> > feat_vals(1);
-  has_features = true;
+  bool status = true;
   try
   {
-    std::ifstream in(path_.c_str());
-    if (!in)
-      throw Error("Couldn't open file");
-
-    std::string line;
-    Vector3 p;
-    Real f;
-    while (getNextNonBlankLine(in, line))
+    if (FeatureFile::isFeatureFile(path))
+      readColumnarFeatures(path, feat_pts, feat_vals);
+    else
     {
-      std::istringstream line_in(line);
-      if (!(line_in >> p[0] >> p[1] >> p[2] >> f))
-        throw Error("Couldn't read feature");
+      std::ifstream in(path.c_str());
+      if (!in)
+        throw Error("Couldn't open file");
+
+      std::string line;
+      Vector3 p;
+      Real f;
+      while (getNextNonBlankLine(in, line))
+      {
+        std::istringstream line_in(line);
+        if (!(line_in >> p[0] >> p[1] >> p[2] >> f))
+          throw Error("Couldn't read feature");
 
-      feat_pts.push_back(p);
-      feat_vals[0].push_back(f);
+        feat_pts.push_back(p);
+        feat_vals[0].push_back(f);
 
-      if (feat_pts.size() == 1)
-      {
-        while (line_in >> f)
+        if (feat_pts.size() == 1)
         {
-          feat_vals.push_back(TheaArray<Real>());
-          feat_vals.back().push_back(f);
+          while (line_in >> f)
+          {
+            feat_vals.push_back(TheaArray<Real>());
+            feat_vals.back().push_back(f);
+          }
         }
-      }
-      else
-      {
-        for (array_size_t i = 1; i < feat_vals.size(); ++i)
+        else
         {
-          if (!(line_in >> f))
-            throw Error("Couldn't read feature");
+          for (array_size_t i = 1; i < feat_vals.size(); ++i)
+          {
+            if (!(line_in >> f))
+              throw Error("Couldn't read feature");
 
-          feat_vals[i].push_back(f);
+            feat_vals[i].push_back(f);
+          }
         }
       }
     }
 
     if (feat_pts.empty())
-    {
-      wxPostEvent(this, wxCommandEvent(EVT_MODEL_NEEDS_REDRAW));
       return true;
-    }
 
     if (app().options().accentuate_features)
     {
@@ -1216,9 +1525,36 @@ Model::loadFeatures(std::string const & path_)
                                  &feat_vals[0][0],
                                  feat_vals.size() > 1 ? &feat_vals[1][0] : NULL,
                                  feat_vals.size() > 2 ? &feat_vals[2][0] : NULL);
-    mesh_group->forEachMeshUntil(&visitor);
+    mesh_group.forEachMeshUntil(&visitor);
+  }
+  THEA_STANDARD_CATCH_BLOCKS(status = false;, WARNING, "Couldn't load model features from '%s'", path.c_str())
+
+
+  return status;
+}
+
+} // namespace ModelInternal
+
+bool
+Model::loadFeatures(std::string const & path_)
+{
+  using namespace ModelInternal;
+
+  features_path = path_;
+
+  if (point_cloud)
+  {
+    has_features = point_cloud->loadFeatures(path_);
+    return has_features;
   }
-  THEA_STANDARD_CATCH_BLOCKS(has_features = false;, WARNING, "Couldn't load model features from '%s'", path_.c_str())
+
+  if (!mesh_group)
+  {
+    has_features = false;
+    return has_features;
+  }
+
+  has_features = colorByFeatures(*mesh_group, path_);
 
   wxPostEvent(this, wxCommandEvent(EVT_MODEL_NEEDS_REDRAW));
 
@@ -1250,21 +1586,18 @@ class FaceLabeler
     TheaArray<ColorRGBA> const & elem_colors;
 };
 
-} // namespace ModelInternal
-
+// Color the faces of a mesh group, or the points of a point cloud, by labels read from a file.
 bool
-Model::loadElementLabels(std::string const & path_)
+colorByElementLabels(MeshGroupPtr mesh_group, PointCloudPtr point_cloud, std::string const & path)
 {
-  has_elem_labels = false;
-
   if (!mesh_group && !point_cloud)
-    return has_elem_labels;
+    return false;
 
-  std::ifstream in(path_.c_str());
+  std::ifstream in(path.c_str());
   if (!in)
   {
-    THEA_WARNING << "Couldn't open face labels file '" << path_ << '\'';
-    return has_elem_labels;
+    THEA_WARNING << "Couldn't open face labels file '" << path << '\'';
+    return false;
   }
 
   TheaArray<ColorRGBA> elem_colors;
@@ -1287,17 +1620,26 @@ Model::loadElementLabels(std::string const & path_)
   {
     try
     {
-      ModelInternal::FaceLabeler flab(elem_colors);
+      FaceLabeler flab(elem_colors);
       mesh_group->forEachMeshUntil(&flab);
     }
-    THEA_STANDARD_CATCH_BLOCKS(return has_elem_labels;, WARNING, "Couldn't load model face labels from '%s'", path_.c_str())
+    THEA_STANDARD_CATCH_BLOCKS(return false;, WARNING, "Couldn't load model face labels from '%s'", path.c_str())
   }
   else
     if (!point_cloud->setPointColors(elem_colors))
-      return has_elem_labels;
+      return false;
 
-  has_elem_labels = true;
-  wxPostEvent(this, wxCommandEvent(EVT_MODEL_NEEDS_REDRAW));
+  return true;
+}
+
+} // namespace ModelInternal
+
+bool
+Model::loadElementLabels(std::string const & path_)
+{
+  has_elem_labels = ModelInternal::colorByElementLabels(mesh_group, point_cloud, path_);
+  if (has_elem_labels)
+    wxPostEvent(this, wxCommandEvent(EVT_MODEL_NEEDS_REDRAW));
 
   return has_elem_labels;
 }
@@ -1341,27 +1683,30 @@ getDefaultPath(std::string model_path, std::string const & query_path, TheaArray
   return "";
 }
 
-} // namespace ModelInternal
-
+// Get the default path to the file in which the features for a model are stored.
 std::string
-Model::getDefaultFeaturesPath() const
+getDefaultFeaturesPath(std::string const & model_path)
 {
   TheaArray<std::string> exts;
   exts.push_back(".arff");
   exts.push_back(".features");
+  exts.push_back(".features.bin");
 
-  return ModelInternal::getDefaultPath(path, app().options().features, exts);
+  return getDefaultPath(model_path, app().options().features, exts);
 }
 
+// Get the default path to the file in which the face labels for a model are stored.
 std::string
-Model::getDefaultElementLabelsPath() const
+getDefaultElementLabelsPath(std::string const & model_path)
 {
   TheaArray<std::string> exts;
   exts.push_back(".seg");
 
-  return ModelInternal::getDefaultPath(path, app().options().elem_labels, exts);
+  return getDefaultPath(model_path, app().options().elem_labels, exts);
 }
 
+} // namespace ModelInternal
+
 void
 Model::registerDisplay(ModelDisplay * display)
 {
@@ -1635,4 +1980,112 @@ Model::draw(Graphics::RenderSystem & render_system, Graphics::RenderOptions cons
   }
 }
 
+//=============================================================================================================================
+// Background loading
+//=============================================================================================================================
+
+namespace ModelInternal {
+
+struct LoadJobRunner
+{
+  LoadJobRunner(shared_ptr<LoadJob> job_) : job(job_) {}
+  void operator()() { job->run(); }
+
+  shared_ptr<LoadJob> job;
+
+}; // struct LoadJobRunner
+
+void
+LoadJob::start(shared_ptr<LoadJob> job)
+{
+  LoadJobRunner runner(job);
+  boost::thread thread(runner);
+  thread.detach();
+}
+
+void
+LoadJob::run()
+{
+  // Record the element indices of the new meshes separately, so that the model currently being displayed is not affected
+  Mesh::setThreadIndexMaps(&index_maps);
+  bool success = parse();
+  Mesh::setThreadIndexMaps(NULL);
+
+  if (!success)
+  {
+    setStage(FAILED);
+    return;
+  }
+
+  setStage(PARSED);
+
+  // Kd-trees are only needed for picking, so they can be skipped if the job is abandoned and rebuilt later if necessary
+  if (mesh_group && !isCancelled())
+    buildKDTrees();
+
+  setStage(COMPLETED);
+}
+
+bool
+LoadJob::parse()
+{
+  if (endsWith(toLower(path), ".pts"))
+  {
+    point_cloud = PointCloudPtr(new PointCloud);
+    if (!point_cloud->load(path))
+      return false;
+
+    bounds = point_cloud->getBounds();
+  }
+  else
+  {
+    mesh_group = MeshGroupPtr(new MeshGroup("Mesh Group"));
+
+    CodecOBJ<Mesh> const obj_codec(CodecOBJ<Mesh>::ReadOptions().setIgnoreTexCoords(true));
+    try
+    {
+      if (endsWith(toLower(path), ".obj"))
+        mesh_group->load(path, obj_codec);
+      else
+        mesh_group->load(path);
+    }
+    THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "Couldn't load model '%s'", path.c_str())
+
+    linkMeshesToParent(mesh_group);
+    bounds = mesh_group->getBounds();
+
+    THEA_CONSOLE << "Loaded model '" << path << "' with bounding box " << bounds.toString();
+
+    // The mesh is not yet visible, so its colors can be safely changed here
+    features_path = getDefaultFeaturesPath(path);
+    has_features = colorByFeatures(*mesh_group, features_path);
+  }
+
+  has_elem_labels = colorByElementLabels(mesh_group, point_cloud, getDefaultElementLabelsPath(path));
+
+  return true;
+}
+
+void
+LoadJob::buildKDTrees()
+{
+  try
+  {
+    kdtree = new Model::KDTree;
+    kdtree->add(*mesh_group);
+    kdtree->init();
+
+    TheaArray<MeshVertex *> verts;
+    CollectVerticesFunctor func(&verts);
+    mesh_group->forEachMeshUntil(&func);
+    vertex_kdtree = new Model::VertexKDTree(verts.begin(), verts.end());
+
+    THEA_CONSOLE << mesh_group->getName() << ": Built kd-trees in the background";
+  }
+  THEA_STANDARD_CATCH_BLOCKS({ delete vertex_kdtree; vertex_kdtree = NULL; delete kdtree; kdtree = NULL; }, WARNING,
+                             "Couldn't build kd-trees for model '%s'", path.c_str())
+}
+
+} // namespace ModelInternal
+
 } // namespace Browse3D
@@ -62,6 +62,12 @@ class ModelDisplay;
 class PointCloud;
 typedef shared_ptr<PointCloud> PointCloudPtr;
 
+namespace ModelInternal {
+
+class LoadJob;
+
+} // namespace ModelInternal
+
 } // namespace Browse3D
 
 wxDECLARE_EVENT(EVT_MODEL_PATH_CHANGED,         wxCommandEvent);
@@ -367,9 +373,27 @@ class Model : public GraphicsWidget, public Transformable<AffineTransform3>, pub
     /**
      * Load the model from a disk file.
      *
-     * @return True if the model was successfully loaded, else false.
+     * If \a async is true, the file is parsed in a background thread and the function returns immediately. The model is
+     * replaced (and EVT_MODEL_PATH_CHANGED and EVT_MODEL_GEOMETRY_CHANGED are sent) as soon as the geometry is available, and
+     * the kd-trees for picking are built in the background after that. A query that needs a kd-tree before it is ready waits
+     * for it. If the file has been prefetched via prefetch(), the prefetched data is used.
+     *
+     * @return True if the model was successfully loaded (or, if \a async is true, if loading was successfully started), else
+     *   false.
+     */
+    bool load(std::string path_, bool async = false);
+
+    /**
+     * Start loading a set of files in the background, so that a subsequent call to load() with one of these paths completes
+     * quickly. Any previously prefetched files not in this set are discarded.
+     */
+    void prefetch(TheaArray<std::string> const & paths);
+
+    /**
+     * Get the path of the model being loaded in the background, if any, else the path of the currently loaded model. Use this
+     * instead of getPath() to find the file the user most recently asked to view.
      */
-    bool load(std::string path_);
+    std::string const & getLoadingPath() const;
 
     /**
      * Select a file via a file dialog and load the model from it.
@@ -379,17 +403,28 @@ class Model : public GraphicsWidget, public Transformable<AffineTransform3>, pub
     bool selectAndLoad();
 
   private:
+    typedef shared_ptr<ModelInternal::LoadJob> LoadJobPtr;  ///< A handle to a background loading job.
+
     /** Clear the model mesh. */
     void clearMesh();
 
-    /** Clear the point cloud. */
-    void clearPoints();
+    /** Called when a background loading job makes progress. */
+    void loadProgress(wxThreadEvent & event);
+
+    /** Switch to the data read so far by the current loading job, if any. */
+    void checkLoad();
 
-    /** Get the default path to the file in which features are stored. */
-    std::string getDefaultFeaturesPath() const;
+    /** Abandon the current background load, if any. */
+    void cancelLoad();
 
-    /** Get the default path to the file in which the face labels are stored. */
-    std::string getDefaultElementLabelsPath() const;
+    /** Replace the current model with the data read by a loading job. */
+    void installLoaded(ModelInternal::LoadJob & job);
+
+    /** Wait for the kd-trees being built by the current loading job, if any, and use them for queries. */
+    void installLoadedKDTrees() const;
+
+    /** Clear the point cloud. */
+    void clearPoints();
 
     /** Draw the mesh group colored by segment. */
     void drawSegmentedMeshGroup(MeshGroupPtr mesh_group, int depth, int & node_index, Graphics::RenderSystem & render_system,
@@ -424,6 +459,9 @@ class Model : public GraphicsWidget, public Transformable<AffineTransform3>, pub
     mutable bool valid_vertex_kdtree;
     mutable VertexKDTree * vertex_kdtree;
 
+    mutable LoadJobPtr pending_load;  ///< The model being loaded in the background, if any.
+    TheaArray<LoadJobPtr> prefetched;  ///< Models being prefetched in the background.
+
 }; // class Model
 
 } // namespace Browse3D
@@ -45,6 +45,7 @@
 #include "../../Graphics/VARArea.hpp"
 #include "../../Graphics/VAR.hpp"
 #include "../../Colors.hpp"
+#include "../../FeatureFile.hpp"
 #include "../../FilePath.hpp"
 #include "../../FileSystem.hpp"
 #include "../../Math.hpp"
@@ -267,6 +268,39 @@ readFeaturesTXT(std::string const & path, long num_points, TheaArray< TheaArray<
   return true;
 }
 
+bool
+readFeaturesColumnar(std::string const & path, long num_points, TheaArray< TheaArray<Real> > & features)
+{
+  FeatureFileReader reader(path);
+  if (reader.numPoints() != num_points)
+    throw Error(format("Columnar: File has features for %ld points, expected %ld", reader.numPoints(), num_points)
+              + " in '" + path + '\'');
+
+  // Every dimension of every feature except the point positions becomes a separate channel. The values are copied out of the
+  // mapped file, instead of being read on demand, because load() rescales each channel in place to the [0, 1] range used for
+  // coloring (after sorting a copy of it to find percentiles), so the rescaled values would have to be materialized anyway.
+  features.clear();
+  TheaArray<float32> values((array_size_t)num_points);
+  for (long i = 0; i < reader.numFeatures(); ++i)
+  {
+    if (reader.getFeatureName(i) == "position")
+      continue;
+
+    for (long j = 0; j < reader.getFeatureDims(i); ++j)
+    {
+      if (num_points > 0)
+        reader.getDimension(i, j, &values[0]);
+
+      features.push_back(TheaArray<Real>(values.begin(), values.end()));
+    }
+  }
+
+  if (features.empty())
+    features.resize(1);  // signals that there are no features
+
+  return true;
+}
+
 bool
 readFeaturesARFF(std::string const & path, long num_points, TheaArray< TheaArray<Real> > & features)
 {
@@ -356,7 +390,9 @@ PointCloud::loadFeatures(std::string const & filename_)
   {
     std::string filename_lc = toLower(filename_);
     bool status = true;
-    if (endsWith(filename_lc, ".arff"))
+    if (FeatureFile::isFeatureFile(filename_))
+      status = PointCloudInternal::readFeaturesColumnar(filename_, (long)points.size(), features);
+    else if (endsWith(filename_lc, ".arff"))
       status = PointCloudInternal::readFeaturesARFF(filename_, (long)points.size(), features);
     else if (endsWith(filename_lc, ".features") || endsWith(filename_lc, ".feat"))
       status = PointCloudInternal::readFeaturesTXT(filename_, (long)points.size(), features, true);
@@ -450,7 +486,7 @@ PointCloud::getDefaultFeaturesFilename(std::string const & filename, std::string
   if (FileSystem::fileExists(app_features_path))
     return app_features_path;
 
-  static std::string const EXTS[] = { ".arff", ".features", ".feat" };  // in order of decreasing priority
+  static std::string const EXTS[] = { ".arff", ".features", ".feat", ".features.bin" };  // in order of decreasing priority
   static size_t NUM_EXTS = sizeof(EXTS) / sizeof(std::string);
   static int const NUM_DIRS = 3;
 
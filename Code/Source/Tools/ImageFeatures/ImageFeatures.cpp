@@ -1,8 +1,10 @@
 #include "../../Common.hpp"
 #include "../../Algorithms/ImageFeatures/ShapeContext.hpp"
 #include "../../Array.hpp"
+#include "../../FeatureFile.hpp"
 #include "../../Image.hpp"
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -12,7 +14,8 @@ using namespace std;
 using namespace Thea;
 using namespace Algorithms;
 
-bool computeShapeContext(Image const & image, long num_radial_bins, long num_polar_bins, TheaArray<Real> & values);
+bool computeShapeContext(Image const & image, long num_radial_bins, long num_polar_bins, Real max_cell_fraction,
+                         TheaArray<Real> & values);
 
 int
 main(int argc, char * argv[])
@@ -21,6 +24,9 @@ main(int argc, char * argv[])
   string out_path;
 
   bool invert = false;
+  Real max_cell_fraction = 0;
+  bool columnar = false;
+  FeatureStorage columnar_storage = FeatureStorage::FLOAT32;
 
   int curr_opt = 0;
   for (int i = 1; i < argc; ++i)
@@ -35,8 +41,33 @@ main(int argc, char * argv[])
 
       curr_opt++;
     }
-    else if (string(argv[i]) == "--invert")
-      invert = true;
+    else
+    {
+      string arg = argv[i];
+      if (arg == "--invert")
+        invert = true;
+      else if (arg == "--approx" || beginsWith(arg, "--approx="))
+      {
+        max_cell_fraction = 0.25f;
+
+        if (arg != "--approx"
+         && (sscanf(arg.c_str(), "--approx=%f", &max_cell_fraction) != 1 || max_cell_fraction < 0))
+        {
+          THEA_ERROR << "Could not parse maximum cell fraction for approximate features";
+          return -1;
+        }
+      }
+      else if (arg == "--columnar" || beginsWith(arg, "--columnar="))
+      {
+        columnar = true;
+
+        if (arg != "--columnar" && !columnar_storage.fromString(arg.substr(strlen("--columnar="))))
+        {
+          THEA_ERROR << "Unsupported columnar storage type (should be float32 or float16)";
+          return -1;
+        }
+      }
+    }
   }
 
   if (curr_opt < 2)
@@ -45,6 +76,10 @@ main(int argc, char * argv[])
     THEA_CONSOLE << "    <featureN> must be one of:";
     THEA_CONSOLE << "        --sc[:num-radial-bins,num-polar-bins]";
     THEA_CONSOLE << "        --invert (not a feature, inverts pixel values before computing features)";
+    THEA_CONSOLE << "        --approx[=<max-cell-fraction>] (not a feature, computes approximate shape contexts faster, with";
+    THEA_CONSOLE << "              accuracy controlled by the maximum size of a boundary cell relative to its bin, default 0.25)";
+    THEA_CONSOLE << "        --columnar[={float32|float16}] (outputs a memory-mappable columnar feature file, optionally at";
+    THEA_CONSOLE << "              half precision, with values for all pixels)";
 
     return 0;
   }
@@ -65,9 +100,12 @@ main(int argc, char * argv[])
   int width  = image.getWidth();
   int height = image.getHeight();
 
-  // Compute features
-  TheaArray< TheaArray<Real> > features((array_size_t)(width * height));
+  // Compute features. The values of each feature are stored as a single block, with the values for each pixel stored
+  // consecutively, so they can be passed directly to a columnar feature file.
+  array_size_t num_pixels = (array_size_t)width * (array_size_t)height;
   TheaArray<string> feat_names;
+  TheaArray<long> feat_dims;
+  TheaArray< TheaArray<Real> > feat_values;
 
   for (int i = 1; i < argc; ++i)
   {
@@ -89,19 +127,17 @@ main(int argc, char * argv[])
         }
       }
 
-      TheaArray<Real> values;
-      if (!computeShapeContext(image, num_radial_bins, num_polar_bins, values))
+      feat_values.push_back(TheaArray<Real>());
+      if (!computeShapeContext(image, num_radial_bins, num_polar_bins, max_cell_fraction, feat_values.back()))
         return -1;
 
-      alwaysAssertM(values.size() == num_radial_bins * num_polar_bins * features.size(),
+      alwaysAssertM(feat_values.back().size() == (array_size_t)(num_radial_bins * num_polar_bins) * num_pixels,
                     "Number of shape contexts don't match number of pixels");
 
-      Real const * entry = &values[0];
-      long entry_size = num_radial_bins * num_polar_bins;
-      for (array_size_t j = 0; j < features.size(); ++j, entry += entry_size)
-        features[j].insert(features[j].end(), entry, entry + entry_size);
+      feat_dims.push_back(num_radial_bins * num_polar_bins);
     }
-    else if (feat == "invert")
+    else if (feat == "invert" || feat == "approx" || beginsWith(feat, "approx=")
+          || feat == "columnar" || beginsWith(feat, "columnar="))
       continue;
     else
     {
@@ -122,6 +158,33 @@ main(int argc, char * argv[])
   THEA_CONSOLE << "Computed " << feat_names.size() << " feature(s): " << feat_str.str();
 
   // Write features to file
+  if (columnar)
+  {
+    try
+    {
+      FeatureFileWriter writer((long)num_pixels);
+      long pixel_feat = writer.addFeature("pixel", 2);
+      for (int i = 0; i < height; ++i)
+        for (int j = 0; j < width; ++j)
+        {
+          long pixel[2] = { i, j };
+          writer.setValues(pixel_feat, (long)i * width + j, pixel);
+        }
+
+      for (array_size_t i = 0; i < feat_names.size(); ++i)
+      {
+        long feat = writer.addFeature(feat_names[i], feat_dims[i], columnar_storage);
+        writer.setColumn(feat, &feat_values[i][0]);
+      }
+
+      writer.write(out_path);
+    }
+    THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "Could not write features to %s", out_path.c_str())
+
+    THEA_CONSOLE << "Wrote " << num_pixels << " feature vectors to " << out_path;
+    return 0;
+  }
+
   ofstream out(out_path.c_str());
   if (!out)
   {
@@ -134,23 +197,31 @@ main(int argc, char * argv[])
   {
     for (int j = 0; j < width; ++j)
     {
-      TheaArray<Real> const & entry = features[(array_size_t)(i * width + j)];
+      array_size_t pixel = (array_size_t)i * (array_size_t)width + (array_size_t)j;
 
       bool all_zero = true;
-      for (array_size_t k = 0; k < entry.size(); ++k)
-        if (entry[k] > 0)
-        {
-          all_zero = false;
-          break;
-        }
+      for (array_size_t f = 0; all_zero && f < feat_values.size(); ++f)
+      {
+        Real const * entry = &feat_values[f][pixel * (array_size_t)feat_dims[f]];
+        for (long k = 0; k < feat_dims[f]; ++k)
+          if (entry[k] > 0)
+          {
+            all_zero = false;
+            break;
+          }
+      }
 
       if (all_zero)
         continue;
 
       out << i << ' ' << j;
 
-      for (array_size_t k = 0; k < entry.size(); ++k)
-        out << ' ' << entry[k];
+      for (array_size_t f = 0; f < feat_values.size(); ++f)
+      {
+        Real const * entry = &feat_values[f][pixel * (array_size_t)feat_dims[f]];
+        for (long k = 0; k < feat_dims[f]; ++k)
+          out << ' ' << entry[k];
+      }
 
       out << '\n';
 
@@ -158,13 +229,14 @@ main(int argc, char * argv[])
     }
   }
 
-  THEA_CONSOLE << "Wrote " << num_written << '/' << features.size() << " feature vectors to " << out_path;
+  THEA_CONSOLE << "Wrote " << num_written << '/' << num_pixels << " feature vectors to " << out_path;
 
   return 0;
 }
 
 bool
-computeShapeContext(Image const & image, long num_radial_bins, long num_polar_bins, TheaArray<Real> & values)
+computeShapeContext(Image const & image, long num_radial_bins, long num_polar_bins, Real max_cell_fraction,
+                    TheaArray<Real> & values)
 {
   THEA_CONSOLE << "Computing shape contexts";
 
@@ -173,7 +245,7 @@ computeShapeContext(Image const & image, long num_radial_bins, long num_polar_bi
   try
   {
     ImageFeatures::ShapeContext sc(image);
-    sc.compute(num_radial_bins, num_polar_bins, values);
+    sc.computeDense(num_radial_bins, num_polar_bins, values, true, -1, max_cell_fraction);
   }
   THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "%s", "Could not compute shape context")
 
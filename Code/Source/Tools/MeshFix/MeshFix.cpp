@@ -13,6 +13,7 @@
 #include "../../FilePath.hpp"
 #include "../../LineSegment3.hpp"
 #include "../../Math.hpp"
+#include "../../ParallelFor.hpp"
 #include "../../Random.hpp"
 #include "../../UnorderedSet.hpp"
 #include "../../UnorderedMap.hpp"
@@ -1067,44 +1068,125 @@ orient(Mesh & mesh)
   return false;
 }
 
-struct SDFOrienter
+// Number of faces handed to a thread at a time by the parallel orientation passes
+static long const ORIENT_CHUNK_SIZE = 64;
+
+// Space out the lowest 10 bits of a number, with two zero bits between consecutive bits
+uint32
+spreadBits10(uint32 x)
 {
-  SDFOrienter(Local::ShapeDiameter<Mesh> * sdf_) : sdf(sdf_) {}
+  x &= 0x3FF;
+  x = (x | (x << 16)) & 0x030000FF;
+  x = (x | (x <<  8)) & 0x0300F00F;
+  x = (x | (x <<  4)) & 0x030C30C3;
+  x = (x | (x <<  2)) & 0x09249249;
+  return x;
+}
 
-  bool operator()(Mesh & mesh)
+// The faces of a mesh, and an order in which to process them that keeps faces close together in space close together in the
+// sequence (a Morton curve through their centroids). A chunk of consecutive faces then casts rays from nearby origins, which
+// traverse the same parts of the kd-tree. The processing order does not affect the result of any face.
+struct CoherentFaces
+{
+  CoherentFaces(Mesh & mesh)
   {
-    long num_flipped = 0;
+    TheaArray<Vector3> centroids;
+    AxisAlignedBox3 bounds;
     for (Mesh::FaceIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi)
     {
-      if (fi->numVertices() < 3)
+      Vector3 c = Vector3::zero();
+      for (Mesh::Face::VertexConstIterator fvi = fi->verticesBegin(); fvi != fi->verticesEnd(); ++fvi)
+        c += (*fvi)->getPosition();
+
+      if (fi->numVertices() > 0)
+        c /= fi->numVertices();
+
+      faces.push_back(&(*fi));
+      centroids.push_back(c);
+      bounds.merge(c);
+    }
+
+    Vector3 lo = bounds.getLow();
+    Vector3 ext = bounds.getExtent();
+    Real scale = 1023 / std::max(ext.max(), (Real)1.0e-20f);
+
+    TheaArray< std::pair<uint32, long> > keys(faces.size());
+    for (array_size_t i = 0; i < faces.size(); ++i)
+    {
+      Vector3 q = scale * (centroids[i] - lo);
+      uint32 code = (spreadBits10((uint32)q.x()) << 2) | (spreadBits10((uint32)q.y()) << 1) | spreadBits10((uint32)q.z());
+      keys[i] = std::make_pair(code, (long)i);
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    order.resize(keys.size());
+    for (array_size_t i = 0; i < keys.size(); ++i)
+      order[i] = keys[i].second;
+  }
+
+  TheaArray<Mesh::Face *> faces;  // in the order of the mesh
+  TheaArray<long> order;          // indices into faces, in processing order
+};
+
+struct SDFOrientTask
+{
+  SDFOrientTask(Local::ShapeDiameter<Mesh> const * sdf_, CoherentFaces const * cf_, TheaArray<char> * flip_)
+  : sdf(sdf_), cf(cf_), flip(flip_) {}
+
+  void operator()(long begin, long end)
+  {
+    for (long i = begin; i < end; ++i)
+    {
+      long f = cf->order[(array_size_t)i];
+      Mesh::Face const * face = cf->faces[(array_size_t)f];
+      if (face->numVertices() < 3)
         continue;
 
       Vector3 centroid = Vector3::zero();
-      for (Mesh::Face::VertexConstIterator fvi = fi->verticesBegin(); fvi != fi->verticesEnd(); ++fvi)
+      for (Mesh::Face::VertexConstIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
         centroid += (*fvi)->getPosition();
 
-      centroid /= fi->numVertices();
+      centroid /= face->numVertices();
 
-      Vector3 n = fi->getNormal();
+      Vector3 n = face->getNormal();
       double sdf_pos = sdf->compute(centroid,  n, false);
       double sdf_neg = sdf->compute(centroid, -n, false);
 #if 0
       if ((sdf_neg < 0 || sdf_neg > 0.4) && (sdf_pos < 0 || sdf_pos > 0.4))
-      {
-        if (fi->getNormal().z() < 0)
-        {
-          fi->reverseWinding();
-          num_flipped++;
-        }
-      }
+        (*flip)[(array_size_t)f] = (face->getNormal().z() < 0);
       else
 #endif
-      if (sdf_neg >= 0 && (sdf_pos < 0 || sdf_neg < sdf_pos))
+      (*flip)[(array_size_t)f] = (sdf_neg >= 0 && (sdf_pos < 0 || sdf_neg < sdf_pos));
+    }
+  }
+
+  Local::ShapeDiameter<Mesh> const * sdf;
+  CoherentFaces const * cf;
+  TheaArray<char> * flip;
+
+}; // struct SDFOrientTask
+
+struct SDFOrienter
+{
+  SDFOrienter(Local::ShapeDiameter<Mesh> * sdf_) : sdf(sdf_) {}
+
+  bool operator()(Mesh & mesh)
+  {
+    // Decide which faces to flip in parallel, then flip them. The decisions don't depend on each other since the kd-tree of the
+    // SDF keeps its own copy of the triangles.
+    CoherentFaces cf(mesh);
+    TheaArray<char> flip(cf.faces.size(), 0);
+    SDFOrientTask task(sdf, &cf, &flip);
+    parallelForChunks((long)cf.faces.size(), task, ORIENT_CHUNK_SIZE);
+
+    long num_flipped = 0;
+    for (array_size_t i = 0; i < cf.faces.size(); ++i)
+      if (flip[i])
       {
-        fi->reverseWinding();
+        cf.faces[i]->reverseWinding();
         num_flipped++;
       }
-    }
 
     if (verbose)
     {
@@ -1304,80 +1386,149 @@ struct VisibilityOrienter
     static size_t const NUM_CAMERAS_LO = sizeof(CAMERAS_LO) / sizeof(Vector3);
     static size_t const NUM_CAMERAS_HI = sizeof(CAMERAS_HI) / sizeof(Vector3);
 
-    static int const NUM_JITTERED = 5;
-    static Real const JITTER_SCALE = 0.25;
-
     Vector3 const * cameras = hi_qual ? CAMERAS_HI : CAMERAS_LO;
     size_t num_cameras = hi_qual ? NUM_CAMERAS_HI : NUM_CAMERAS_LO;
 
-    TheaArray<Vector3> face_pts;
-    face_pts.reserve(32);
+    // Decide which faces to flip in parallel, then flip them. Ray intersections don't depend on the winding of the faces, so the
+    // decisions don't depend on each other.
+    CoherentFaces cf(mesh);
+    TheaArray<char> flip(cf.faces.size(), 0);
+    VisibilityOrientTask task(this, cameras, num_cameras, &cf, &flip);
+    parallelForChunks((long)cf.faces.size(), task, ORIENT_CHUNK_SIZE);
 
-    for (Mesh::FaceIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi)
+    for (array_size_t i = 0; i < cf.faces.size(); ++i)
+      if (flip[i])
+        cf.faces[i]->reverseWinding();
+
+    return false;
+  }
+
+  // Deterministic pseudo-random number in [lo, hi] for a given key. The jitter of each ray is derived from the index of its
+  // face, so the result does not depend on which thread processes the face, or when.
+  static Real hashUniform(uint32 key, Real lo, Real hi)
+  {
+    // Finalizer of MurmurHash3
+    key ^= key >> 16;
+    key *= 0x85EBCA6B;
+    key ^= key >> 13;
+    key *= 0xC2B2AE35;
+    key ^= key >> 16;
+
+    return lo + (hi - lo) * (Real)(key / (double)0xFFFFFFFF);
+  }
+
+  // Finds the most exposed camera for each face in a chunk. The rays of the chunk are cast camera by camera, so consecutive rays
+  // start from nearby points (see CoherentFaces) in the same direction, and traverse the same parts of the kd-tree.
+  struct VisibilityOrientTask
+  {
+    VisibilityOrientTask(VisibilityOrienter const * parent_, Vector3 const * cameras_, size_t num_cameras_,
+                         CoherentFaces const * cf_, TheaArray<char> * flip_)
+    : parent(parent_), cameras(cameras_), num_cameras(num_cameras_), cf(cf_), flip(flip_) {}
+
+    void operator()(long begin, long end)
     {
-      face_pts.clear();
+      static int const NUM_JITTERED = 5;
+      static Real const JITTER_SCALE = 0.25;
+
+      // The centroid followed by the vertices of each face
+      long n = end - begin;
+      TheaArray<Vector3> face_pts;
+      TheaArray<array_size_t> face_pts_begin((array_size_t)n + 1);
+      for (long i = 0; i < n; ++i)
       {
-        Vector3 c = CentroidN<Mesh::Vertex const *, 3>::compute(fi->verticesBegin(), fi->verticesEnd());
-        face_pts.push_back(c);
-        for (Mesh::Face::VertexConstIterator fvi = fi->verticesBegin(); fvi != fi->verticesEnd(); ++fvi)
+        Mesh::Face const * face = cf->faces[(array_size_t)cf->order[(array_size_t)(begin + i)]];
+        face_pts_begin[(array_size_t)i] = face_pts.size();
+
+        face_pts.push_back(CentroidN<Mesh::Vertex const *, 3>::compute(face->verticesBegin(), face->verticesEnd()));
+        for (Mesh::Face::VertexConstIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
           face_pts.push_back((*fvi)->getPosition());
       }
+      face_pts_begin[(array_size_t)n] = face_pts.size();
 
-      int best_camera = -1;
-      Real best_exposure = -1;
-      Vector3 best_dir = Vector3::zero();
+      TheaArray<int> best_camera((array_size_t)n, -1);
+      TheaArray<Real> best_exposure((array_size_t)n, -1);
+      TheaArray<Vector3> best_dir((array_size_t)n, Vector3::zero());
+      TheaArray<char> done((array_size_t)n, 0);
 
-      for (array_size_t j = 0; j < face_pts.size(); ++j)
+      // Try the points of each face in turn, until one of them is visible from some camera. All cameras are considered for a
+      // point before the face is done.
+      for (array_size_t j = 0; ; ++j)
       {
-        Vector3 const & p = face_pts[j];
-
+        bool more_points = false;
         for (size_t k = 0; k < num_cameras; ++k)
         {
+          for (long i = 0; i < n; ++i)
+          {
+            array_size_t ai = (array_size_t)i;
+            if (done[ai] || face_pts_begin[ai] + j >= face_pts_begin[ai + 1])
+              continue;
+
+            more_points = true;
+
+            long f = cf->order[(array_size_t)(begin + i)];
+            Mesh::Face const * face = cf->faces[(array_size_t)f];
+            Vector3 const & p = face_pts[face_pts_begin[ai] + j];
+
 #define ORIENT_VISIBILITY_RELATIVE_CAMERAS
 #ifdef ORIENT_VISIBILITY_RELATIVE_CAMERAS
-          Vector3 camera_pos = p + camera_distance * cameras[k];
+            Vector3 camera_pos = p + parent->camera_distance * cameras[k];
 #else
-          Vector3 camera_pos = mesh_center + camera_distance * cameras[k];
+            Vector3 camera_pos = parent->mesh_center + parent->camera_distance * cameras[k];
 #endif
-          Ray3 ray(p, camera_pos - p);
-          ray.setOrigin(ray.getPoint(0.0001));
-          if (kdtree.rayIntersects<RayIntersectionTester>(ray))
-            continue;
-
-          // Shoot a few jittered rays to test "openness" of the face w.r.t. this camera
-          int num_open = 0;
-          for (int h = 0; h < NUM_JITTERED; ++h)
-          {
-            Real jx = Random::common().uniform(-JITTER_SCALE, JITTER_SCALE);
-            Real jy = Random::common().uniform(-JITTER_SCALE, JITTER_SCALE);
-            Real jz = Random::common().uniform(-JITTER_SCALE, JITTER_SCALE);
-            Ray3 jray(p, camera_pos + Vector3(jx, jy, jz) - p);
-            jray.setOrigin(ray.getPoint(0.0001));
-
-            if (!kdtree.rayIntersects<RayIntersectionTester>(jray))
-              num_open++;
-          }
-
-          Vector3 dir = ray.getDirection().unit();
-          Real exposure = num_open / (Real)NUM_JITTERED + fabs(fi->getNormal().dot(dir));
-          if (best_camera < 0 || exposure > best_exposure)
-          {
-            best_camera = (int)k;
-            best_exposure = exposure;
-            best_dir = dir;
+            Ray3 ray(p, camera_pos - p);
+            ray.setOrigin(ray.getPoint(0.0001));
+            if (parent->kdtree.rayIntersects<RayIntersectionTester>(ray))
+              continue;
+
+            // Shoot a few jittered rays to test "openness" of the face w.r.t. this camera
+            uint32 seed = (uint32)f * 0x9E3779B9 + (uint32)j * 0x85EBCA6B + (uint32)k * 0xC2B2AE35;
+            int num_open = 0;
+            for (int h = 0; h < NUM_JITTERED; ++h)
+            {
+              Real jx = hashUniform(seed + 3 * h,     -JITTER_SCALE, JITTER_SCALE);
+              Real jy = hashUniform(seed + 3 * h + 1, -JITTER_SCALE, JITTER_SCALE);
+              Real jz = hashUniform(seed + 3 * h + 2, -JITTER_SCALE, JITTER_SCALE);
+              Ray3 jray(p, camera_pos + Vector3(jx, jy, jz) - p);
+              jray.setOrigin(ray.getPoint(0.0001));
+
+              if (!parent->kdtree.rayIntersects<RayIntersectionTester>(jray))
+                num_open++;
+            }
+
+            Vector3 dir = ray.getDirection().unit();
+            Real exposure = num_open / (Real)NUM_JITTERED + fabs(face->getNormal().dot(dir));
+            if (best_camera[ai] < 0 || exposure > best_exposure[ai])
+            {
+              best_camera[ai] = (int)k;
+              best_exposure[ai] = exposure;
+              best_dir[ai] = dir;
+            }
           }
         }
 
-        if (best_camera >= 0)
+        if (!more_points)
           break;
+
+        for (long i = 0; i < n; ++i)
+          if (best_camera[(array_size_t)i] >= 0)
+            done[(array_size_t)i] = 1;
       }
 
-      if (best_camera >= 0 && fi->getNormal().dot(best_dir) < 0)
-        fi->reverseWinding();
+      for (long i = 0; i < n; ++i)
+      {
+        long f = cf->order[(array_size_t)(begin + i)];
+        if (best_camera[(array_size_t)i] >= 0 && cf->faces[(array_size_t)f]->getNormal().dot(best_dir[(array_size_t)i]) < 0)
+          (*flip)[(array_size_t)f] = 1;
+      }
     }
 
-    return false;
-  }
+    VisibilityOrienter const * parent;
+    Vector3 const * cameras;
+    size_t num_cameras;
+    CoherentFaces const * cf;
+    TheaArray<char> * flip;
+
+  }; // struct VisibilityOrientTask
 
   KDTree kdtree;
   bool hi_qual;
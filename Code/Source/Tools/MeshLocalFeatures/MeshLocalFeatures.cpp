@@ -10,9 +10,11 @@
 #include "../../Algorithms/CentroidN.hpp"
 #include "../../Algorithms/MeshKDTree.hpp"
 #include "../../Algorithms/MeshSampler.hpp"
+#include "../../Algorithms/QueryStatistics.hpp"
 #include "../../Graphics/GeneralMesh.hpp"
 #include "../../Graphics/MeshGroup.hpp"
 #include "../../Array.hpp"
+#include "../../FeatureFile.hpp"
 #include "../../IOStream.hpp"
 #include "../../Matrix.hpp"
 #include "../../Vector3.hpp"
@@ -73,8 +75,10 @@ MeshScaleType mesh_scale_type = MeshScaleType::BSPHERE;
 bool normalize_by_mesh_scale = false;
 double mesh_scale = 1;
 bool is_oriented = false;  // all normals point outwards
+bool verbose = false;
 
 int usage(int argc, char * argv[]);
+void printQueryStatistics(string const & stage);
 double meshScale(MG & mg, MeshScaleType mesh_scale_type);
 bool computeSDF(KDTree const & kdtree, TheaArray<Vector3> const & positions, TheaArray<Vector3> const & normals,
                 TheaArray<double> & values);
@@ -106,6 +110,8 @@ main(int argc, char * argv[])
   bool feat_scale = false;
   double feat_scale_factor = 1;
   bool binary = false;
+  bool columnar = false;
+  FeatureStorage columnar_storage = FeatureStorage::FLOAT32;
 
   int curr_opt = 0;
   for (int i = 1; i < argc; ++i)
@@ -135,6 +141,16 @@ main(int argc, char * argv[])
     {
       binary = true;
     }
+    else if (arg == "--columnar" || beginsWith(arg, "--columnar="))
+    {
+      columnar = true;
+
+      if (arg != "--columnar" && !columnar_storage.fromString(arg.substr(strlen("--columnar="))))
+      {
+        THEA_ERROR << "Unsupported columnar storage type (should be float32 or float16)";
+        return -1;
+      }
+    }
     else if (beginsWith(arg, "--featscale="))
     {
       if (sscanf(arg.c_str(), "--featscale=%lf", &feat_scale_factor) == 1)
@@ -172,6 +188,13 @@ main(int argc, char * argv[])
     {
       shift_to_01 = true;
     }
+    else if (arg == "--verbose")
+    {
+      verbose = true;
+
+      if (!QueryStatistics::isEnabled())
+        THEA_WARNING << "Spatial query statistics are not available (rebuild with THEA_QUERY_STATISTICS to collect them)";
+    }
     else
       continue;
 
@@ -257,9 +280,13 @@ main(int argc, char * argv[])
 
   THEA_CONSOLE << "Snapped query points to mesh";
 
+  if (verbose)
+    printQueryStatistics("snapping query points");
+
   // Compute features
   TheaArray< TheaArray<double> > features(positions.size());
   TheaArray<string> feat_names;
+  TheaArray<long> feat_dims;  // number of values contributed by each feature to each point
 
   for (int i = 1; i < argc; ++i)
   {
@@ -565,6 +592,13 @@ main(int argc, char * argv[])
     }
 
     feat_names.push_back(feat.substr(2));
+
+    long prev_dims = 0;
+    for (array_size_t j = 0; j < feat_dims.size(); ++j) prev_dims += feat_dims[j];
+    feat_dims.push_back(features.empty() ? 1 : (long)features[0].size() - prev_dims);
+
+    if (verbose)
+      printQueryStatistics(feat_names.back());
   }
 
   ostringstream feat_str;
@@ -577,7 +611,43 @@ main(int argc, char * argv[])
   THEA_CONSOLE << "Computed " << feat_names.size() << " feature(s): " << feat_str.str();
 
   // Write features to file
-  if (binary)
+  if (columnar)
+  {
+    try
+    {
+      FeatureFileWriter writer((long)features.size());
+      long pos_feat = writer.addFeature("position", 3);
+      for (array_size_t i = 0; i < features.size(); ++i)
+        writer.setValues(pos_feat, (long)i, &pts[i][0]);
+
+      TheaArray<double> values;
+      for (array_size_t i = 0, first_dim = 0; i < feat_names.size(); first_dim += (array_size_t)feat_dims[i], ++i)
+      {
+        long feat = writer.addFeature(feat_names[i], feat_dims[i], columnar_storage);
+        values.resize((array_size_t)feat_dims[i]);
+
+        for (array_size_t j = 0; j < features.size(); ++j)
+        {
+          for (array_size_t k = 0; k < values.size(); ++k)
+          {
+            double f = features[j][first_dim + k];
+
+            if (feat_scale) f *= feat_scale_factor;
+            if (shift_to_01) f = 0.5 * (1.0 + f);
+            if (abs_values) f = fabs(f);
+
+            values[k] = f;
+          }
+
+          writer.setValues(feat, (long)j, &values[0]);
+        }
+      }
+
+      writer.write(out_path);
+    }
+    THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "Could not write features to %s", out_path.c_str())
+  }
+  else if (binary)
   {
     BinaryOutputStream out(out_path, Endianness::LITTLE);
     if (!out.ok())
@@ -662,16 +732,30 @@ usage(int argc, char * argv[])
   THEA_CONSOLE << "    The following options may also be specified:";
   THEA_CONSOLE << "        --abs (uses the absolute value of every feature)";
   THEA_CONSOLE << "        --binary (outputs features in binary format)";
+  THEA_CONSOLE << "        --columnar[={float32|float16}] (outputs a memory-mappable columnar feature file, optionally at";
+  THEA_CONSOLE << "              half precision)";
   THEA_CONSOLE << "        --featscale=<factor> (scales feature values by the factor)";
   THEA_CONSOLE << "        --is-oriented (assumes mesh normals consistently point outward)";
   THEA_CONSOLE << "        --meshscale={bsphere|bbox|avgdist} (used to set neighborhood scales)";
   THEA_CONSOLE << "        --normalize (rescale mesh so --meshscale == 1)";
   THEA_CONSOLE << "        --shift01 (maps features in [-1, 1] to [0, 1])";
+  THEA_CONSOLE << "        --verbose (prints statistics of spatial queries for each feature, if compiled in)";
   THEA_CONSOLE << "";
 
   return -1;
 }
 
+void
+printQueryStatistics(string const & stage)
+{
+  if (!QueryStatistics::isEnabled())
+    return;
+
+  // Print the queries made since the last call, then start counting afresh for the next stage
+  THEA_CONSOLE << "Spatial query statistics for " << stage << ":\n" << QueryStatistics::aggregate().toString();
+  QueryStatistics::reset();
+}
+
 double
 meshScale(MG & mg, MeshScaleType mesh_scale_type)
 {
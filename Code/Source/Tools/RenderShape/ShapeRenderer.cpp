@@ -22,13 +22,20 @@
 #include "../../Memory.hpp"
 #include "../../Plugin.hpp"
 #include "../../Random.hpp"
+#include "../../System.hpp"
 #include "../../UnorderedMap.hpp"
 #include "../../Vector3.hpp"
 #include "../../Vector4.hpp"
 #include <boost/functional/hash.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <algorithm>
 #include <cstdio>
+#include <deque>
 #include <fstream>
+#include <iostream>
+#include <map>
 #include <sstream>
 #include <utility>
 
@@ -57,7 +64,7 @@ struct View
 struct Model
 {
   Model(bool convert_to_points_ = false) : convert_to_points(convert_to_points_), is_point_cloud(false) {}
-  Camera fitCamera(Matrix4 const & transform, View const & view, Real zoom, int width, int height);
+  Camera fitCamera(Matrix4 const & transform, View const & view, Real zoom, int width, int height) const;
 
   bool convert_to_points;
   MG mesh_group;
@@ -66,6 +73,36 @@ struct Model
   TheaArray<ColorRGBA> point_colors;
 };
 
+typedef Thea::shared_ptr<Model> ModelPtr;
+
+// The shapes rendered by a single command line: a primary model and optional overlays
+struct ModelSet
+{
+  ModelSet(bool primary_to_points) : primary(primary_to_points) {}
+
+  Model primary;
+  TheaArray<ModelPtr> overlay_models;
+};
+
+typedef Thea::shared_ptr<ModelSet> ModelSetPtr;
+
+// A rendered image that must be rescaled to the output resolution and saved, either immediately or on an encoder thread
+struct OutputImage
+{
+  OutputImage() : width(0), height(0) {}
+  OutputImage(Image::Ptr image_, int width_, int height_, string const & path_)
+  : image(image_), width(width_), height(height_), path(path_) {}
+
+  bool save();
+
+  Image::Ptr image;
+  int width, height;
+  string path;
+};
+
+template <typename T> class BatchQueue;
+typedef BatchQueue<OutputImage> OutputQueue;
+
 enum PointUsage
 {
   POINTS_NONE     = 0x0000,
@@ -80,11 +117,20 @@ class ShapeRendererImpl
     static AtomicInt32 has_render_system;
     static RenderSystemFactory * render_system_factory;
     static RenderSystem * render_system;
+    static bool software_rendering;
     static Shader * point_shader;
     static Shader * mesh_shader;
+    static int mesh_shader_variant;
     static Shader * face_id_shader;
     static Texture * matcap_tex;
     static Texture * tex3d;
+    static string loaded_matcap_path;
+    static string loaded_tex3d_path;
+    static Texture * color_tex;
+    static Texture * depth_tex;
+    static Framebuffer * framebuffer;
+
+    bool owns_plugins;
 
     TheaArray<string> model_paths;
     TheaArray<Matrix4> transforms;
@@ -117,6 +163,7 @@ class ShapeRendererImpl
     int palette_shift;
 
     bool loadPlugins(int argc, char ** argv);
+    bool loadRenderSystem(string const & plugin_name, string const & factory_name);
     bool parseArgs(int argc, char ** argv);
     bool usage();
     bool parseTransform(string const & s, Matrix4 & m);
@@ -128,14 +175,25 @@ class ShapeRendererImpl
     int parseVector(string const & str, Vector4 & v);
     void resetArgs();
     bool loadModel(Model & model, string const & path);
+    bool loadModels(ModelSet & models);
+    string modelKey() const;
     bool loadLabels(Model & model, FaceIndexMap const * tri_ids, FaceIndexMap const * quad_ids);
     bool loadFeatures(Model & model);
     bool renderModel(Model const & model, ColorRGBA const & color);
+    bool renderViews(ModelSet const & models, OutputQueue * output_queue);
+    bool initFramebuffer(int buffer_width, int buffer_height);
+    bool loadTextures();
+    bool updateMeshShader(ModelSet const & models);
+    void destroyRenderResources();
+    void releaseGPUBuffers(ModelSet & models);
     void colorizeMeshSelection(MG & mg, uint32 parent_id);
     ColorRGBA getPaletteColor(long n) const;
     ColorRGBA getLabelColor(long label) const;
 
+    ShapeRendererImpl();  // holds the arguments of a single batch job, does not load plugins
+
     friend struct FaceColorizer;
+    friend struct BatchLoader;
 
   public:
     ShapeRendererImpl(int argc, char * argv[]);  // just loads plugins and initializes variables
@@ -143,6 +201,7 @@ class ShapeRendererImpl
 
     int exec(string const & cmdline);
     int exec(int argc, char ** argv);
+    int execBatch(istream & jobs, TheaArray<string> const & common_args);
 
 }; // class ShapeRendererImpl
 
@@ -168,16 +227,30 @@ ShapeRenderer::exec(int argc, char ** argv)
   return impl->exec(argc, argv);
 }
 
+int
+ShapeRenderer::execBatch(istream & jobs)
+{
+  return impl->execBatch(jobs, TheaArray<string>());
+}
+
 AtomicInt32 ShapeRendererImpl::has_render_system(0);
 RenderSystemFactory * ShapeRendererImpl::render_system_factory = NULL;
 RenderSystem * ShapeRendererImpl::render_system = NULL;
+bool ShapeRendererImpl::software_rendering = false;
 Shader * ShapeRendererImpl::point_shader = NULL;
 Shader * ShapeRendererImpl::mesh_shader = NULL;
+int ShapeRendererImpl::mesh_shader_variant = 0;
 Shader * ShapeRendererImpl::face_id_shader = NULL;
 Texture * ShapeRendererImpl::matcap_tex = NULL;
 Texture * ShapeRendererImpl::tex3d = NULL;
+string ShapeRendererImpl::loaded_matcap_path;
+string ShapeRendererImpl::loaded_tex3d_path;
+Texture * ShapeRendererImpl::color_tex = NULL;
+Texture * ShapeRendererImpl::depth_tex = NULL;
+Framebuffer * ShapeRendererImpl::framebuffer = NULL;
 
 ShapeRendererImpl::ShapeRendererImpl(int argc, char * argv[])
+: owns_plugins(true)
 {
   resetArgs();
 
@@ -188,17 +261,47 @@ ShapeRendererImpl::ShapeRendererImpl(int argc, char * argv[])
   }
 }
 
+ShapeRendererImpl::ShapeRendererImpl()
+: owns_plugins(false)
+{
+  resetArgs();
+}
+
 ShapeRendererImpl::~ShapeRendererImpl()
 {
+  if (!owns_plugins)
+    return;
+
   if (has_render_system.compareAndSet(1, 0) == 1)
   {
     if (render_system_factory)
+    {
+      destroyRenderResources();
       render_system_factory->destroyRenderSystem(render_system);
+    }
   }
 
   Application::getPluginManager().unloadAllPlugins();
 }
 
+void
+ShapeRendererImpl::destroyRenderResources()
+{
+  if (framebuffer) render_system->destroyFramebuffer(framebuffer);
+  if (color_tex) render_system->destroyTexture(color_tex);
+  if (depth_tex) render_system->destroyTexture(depth_tex);
+  if (matcap_tex) render_system->destroyTexture(matcap_tex);
+  if (tex3d) render_system->destroyTexture(tex3d);
+  if (point_shader) render_system->destroyShader(point_shader);
+  if (mesh_shader) render_system->destroyShader(mesh_shader);
+  if (face_id_shader) render_system->destroyShader(face_id_shader);
+
+  framebuffer = NULL;
+  color_tex = depth_tex = matcap_tex = tex3d = NULL;
+  point_shader = mesh_shader = face_id_shader = NULL;
+  loaded_matcap_path = loaded_tex3d_path = "";
+}
+
 void
 ShapeRendererImpl::resetArgs()
 {
@@ -233,30 +336,48 @@ ShapeRendererImpl::resetArgs()
   palette_shift = 0;
 }
 
-int
-ShapeRendererImpl::exec(string const & cmdline)  // cmdline should not include program name
+// A command line stored as a C-style array of arguments, with the name of the program prepended
+class ArgList
 {
-  TheaArray<string> args;
-  stringSplit(cmdline, " \t\n\f\r", args, true);
+  public:
+    ArgList(TheaArray<string> const & args) : argv(args.size() + 1)
+    {
+      string prog_name = FilePath::objectName(Application::programPath());
+      argv[0] = new char[prog_name.length() + 1];
+      strcpy(argv[0], prog_name.c_str());
 
-  TheaArray<char *> argv(args.size() + 1);
+      for (array_size_t i = 0; i < args.size(); ++i)
+      {
+        argv[i + 1] = new char[args[i].length() + 1];
+        strcpy(argv[i + 1], args[i].c_str());
+      }
+    }
 
-  string prog_name = FilePath::objectName(Application::programPath());
-  argv[0] = new char[prog_name.length() + 1];
-  strcpy(argv[0], prog_name.c_str());
+    ~ArgList()
+    {
+      for (array_size_t i = 0; i < argv.size(); ++i)
+        delete [] argv[i];
+    }
 
-  for (array_size_t i = 0; i < args.size(); ++i)
-  {
-    argv[i + 1] = new char[args[i].length() + 1];
-    strcpy(argv[i + 1], args[i].c_str());
-  }
+    int getArgc() const { return (int)argv.size(); }
+    char ** getArgv() { return &argv[0]; }
 
-  int status = exec((int)argv.size(), &argv[0]);
+  private:
+    ArgList(ArgList const &);
+    ArgList & operator=(ArgList const &);
+
+    TheaArray<char *> argv;
 
-  for (array_size_t i = 0; i < argv.size(); ++i)
-    delete [] argv[i];
+}; // class ArgList
 
-  return status;
+int
+ShapeRendererImpl::exec(string const & cmdline)  // cmdline should not include program name
+{
+  TheaArray<string> args;
+  stringSplit(cmdline, " \t\n\f\r", args, true);
+
+  ArgList arg_list(args);
+  return exec(arg_list.getArgc(), arg_list.getArgv());
 }
 
 // Guaranteed to return a value between 0 and 2^32 - 1
@@ -311,20 +432,128 @@ ShapeRendererImpl::getLabelColor(long label) const
 int
 ShapeRendererImpl::exec(int argc, char ** argv)
 {
+  // In batch mode, each line of the job list is a separate command line, and the remaining arguments are shared by all jobs
+  for (int i = 1; i < argc; ++i)
+  {
+    if (string(argv[i]) != "--batch")
+      continue;
+
+    if (i + 1 >= argc)
+    {
+      THEA_ERROR << "--batch: Job list not specified";
+      return -1;
+    }
+
+    TheaArray<string> common_args;
+    for (int j = 1; j < argc; ++j)
+    {
+      if (j == i || j == i + 1 || string(argv[j]) == "--software")
+        continue;
+
+      common_args.push_back(argv[j]);
+    }
+
+    string jobs_path = argv[i + 1];
+    if (jobs_path == "-")
+      return execBatch(cin, common_args);
+
+    ifstream jobs(jobs_path.c_str());
+    if (!jobs)
+    {
+      THEA_ERROR << "Could not open job list '" << jobs_path << '\'';
+      return -1;
+    }
+
+    return execBatch(jobs, common_args);
+  }
+
   if (!parseArgs(argc, argv))
     return -1;
 
-  // Load the mesh
-  Model model(show_points & POINTS_PRIMARY);
-  if (!loadModel(model, model_paths[0]))
+  // Load the shapes
+  ModelSet models(show_points & POINTS_PRIMARY);
+  if (!loadModels(models))
     return -1;
 
-  // Set up framebuffer for offscreen drawing
-  int buffer_width   =  antialiasing_level * out_width;
-  int buffer_height  =  antialiasing_level * out_height;
-  Texture * color_tex = NULL;
-  Texture * depth_tex = NULL;
-  Framebuffer * fb = NULL;
+  // Render them, saving each image as soon as it is ready
+  bool status = renderViews(models, NULL);
+  releaseGPUBuffers(models);
+  if (!status)
+    return -1;
+
+  THEA_CONSOLE << "Rendered " << views.size() << " view(s) of the shape";
+
+  return 0;
+}
+
+bool
+OutputImage::save()
+{
+  try
+  {
+    if ((image->getWidth() != width || image->getHeight() != height)
+     && !image->rescale(width, height, 1, Image::Filter::BICUBIC))
+    {
+      THEA_ERROR << "Could not rescale image '" << path << "' to output dimensions";
+      return false;
+    }
+
+    image->save(path);
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "Could not save image '%s'", path.c_str())
+
+  return true;
+}
+
+bool
+ShapeRendererImpl::loadModels(ModelSet & models)
+{
+  if (!loadModel(models.primary, model_paths[0]))
+    return false;
+
+  models.overlay_models.clear();
+  for (array_size_t i = 1; i < model_paths.size(); ++i)
+  {
+    ModelPtr overlay_model(new Model);
+    overlay_model->convert_to_points = (show_points & POINTS_OVERLAY);
+    if (!loadModel(*overlay_model, model_paths[i]))
+      return false;
+
+    models.overlay_models.push_back(overlay_model);
+  }
+
+  return true;
+}
+
+string
+ShapeRendererImpl::modelKey() const
+{
+  // Everything that affects how loadModels() reads and colors the shapes, but not the views or appearance
+  ostringstream key;
+  for (array_size_t i = 0; i < model_paths.size(); ++i)
+    key << model_paths[i] << '\n';
+
+  key << show_points << ' ' << color_by_id << ' ' << color_by_label << ' ' << color_by_features << ' ' << accentuate_features
+      << ' ' << flat << ' ' << palette_shift << '\n'
+      << labels_path << '\n' << features_path << '\n' << selected_mesh << '\n';
+
+  if (show_points != POINTS_NONE)  // the number of points sampled from a mesh depends on the output size
+    key << out_width << ' ' << out_height << '\n';
+
+  return key.str();
+}
+
+bool
+ShapeRendererImpl::initFramebuffer(int buffer_width, int buffer_height)
+{
+  // Keep the offscreen buffers of the previous render if they have the right size
+  if (framebuffer && color_tex->getWidth() == buffer_width && color_tex->getHeight() == buffer_height)
+    return true;
+
+  if (framebuffer) { render_system->destroyFramebuffer(framebuffer); framebuffer = NULL; }
+  if (color_tex) { render_system->destroyTexture(color_tex); color_tex = NULL; }
+  if (depth_tex) { render_system->destroyTexture(depth_tex); depth_tex = NULL; }
+
   try
   {
     Texture::Options tex_opts = Texture::Options::defaults();
@@ -334,7 +563,7 @@ ShapeRendererImpl::exec(int argc, char ** argv)
     if (!color_tex)
     {
       THEA_ERROR << "Could not create color buffer";
-      return -1;
+      return false;
     }
 
     depth_tex = render_system->createTexture("Depth", buffer_width, buffer_height, 1, Texture::Format::DEPTH16(),
@@ -342,68 +571,233 @@ ShapeRendererImpl::exec(int argc, char ** argv)
     if (!depth_tex)
     {
       THEA_ERROR << "Could not create depth buffer";
-      return -1;
+      return false;
     }
 
-    fb = render_system->createFramebuffer("Framebuffer");
+    Framebuffer * fb = render_system->createFramebuffer("Framebuffer");
     if (!fb)
     {
       THEA_ERROR << "Could not create offscreen framebuffer";
-      return -1;
+      return false;
     }
 
     fb->attach(Framebuffer::AttachmentPoint::COLOR_0, color_tex);
     fb->attach(Framebuffer::AttachmentPoint::DEPTH,   depth_tex);
+    framebuffer = fb;
   }
-  THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "Could not render shape")
+  THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "%s", "Could not render shape")
 
-  matcap_tex = NULL;
-  if (!matcap_path.empty())
+  return true;
+}
+
+bool
+ShapeRendererImpl::loadTextures()
+{
+  // Textures are cached by path, so consecutive jobs with the same material upload them only once
+  if (matcap_path != loaded_matcap_path)
   {
-    try
+    if (matcap_tex) { render_system->destroyTexture(matcap_tex); matcap_tex = NULL; }
+    loaded_matcap_path = "";
+
+    if (!matcap_path.empty())
     {
-      Image matcap_img(matcap_path);
-      matcap_tex = render_system->createTexture("Matcap", matcap_img);
+      try
+      {
+        Image matcap_img(matcap_path);
+        matcap_tex = render_system->createTexture("Matcap", matcap_img);
+      }
+      THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "%s", "Could not create matcap texture")
     }
-    THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "Could not create matcap texture")
+
+    loaded_matcap_path = matcap_path;
   }
 
-  tex3d = NULL;
-  if (!tex3d_path.empty())
+  if (tex3d_path != loaded_tex3d_path)
   {
-    try
+    if (tex3d) { render_system->destroyTexture(tex3d); tex3d = NULL; }
+    loaded_tex3d_path = "";
+
+    if (!tex3d_path.empty())
     {
-      Image tex3d_img(tex3d_path);
-      tex3d = render_system->createTexture("Texture3D", tex3d_img, Texture::Format::AUTO(), Texture::Dimension::DIM_3D);
+      try
+      {
+        Image tex3d_img(tex3d_path);
+        tex3d = render_system->createTexture("Texture3D", tex3d_img, Texture::Format::AUTO(), Texture::Dimension::DIM_3D);
+      }
+      THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "%s", "Could not create 3D texture")
     }
-    THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "%s", "Could not create 3D texture")
+
+    loaded_tex3d_path = tex3d_path;
   }
 
-  typedef Thea::shared_ptr<Model> ModelPtr;
-  TheaArray<ModelPtr> overlay_models;
-  for (array_size_t i = 1; i < model_paths.size(); ++i)
+  return true;
+}
+
+// Forward declarations
+bool initMeshShader(Shader & shader, bool use_matcap, bool use_tex3d);
+void setMeshShaderUniforms(Shader & shader, Vector4 const & material, Texture * matcap_tex, Texture * tex3d,
+                           AxisAlignedBox3 const & bbox);
+
+bool
+ShapeRendererImpl::updateMeshShader(ModelSet const & models)
+{
+  if (color_by_id || !selected_mesh.empty())  // the mesh shader is not used
+    return true;
+
+  // The 3D texture is fitted to the first mesh to be rendered
+  Model const * first_mesh = NULL;
+  if (!models.primary.is_point_cloud)
+    first_mesh = &models.primary;
+  else
   {
-    ModelPtr overlay_model(new Model);
-    overlay_model->convert_to_points = (show_points & POINTS_OVERLAY);
-    if (!loadModel(*overlay_model, model_paths[i]))
-      return -1;
+    for (array_size_t i = 0; !first_mesh && i < models.overlay_models.size(); ++i)
+      if (!models.overlay_models[i]->is_point_cloud)
+        first_mesh = models.overlay_models[i].get();
+  }
 
-    overlay_models.push_back(overlay_model);
+  if (!first_mesh)
+    return true;
+
+  // Recompile the shader only if its set of modules has changed, else just update its parameters
+  int variant = (matcap_tex ? 0x01 : 0) | (tex3d ? 0x02 : 0);
+  if (mesh_shader && variant != mesh_shader_variant)
+  {
+    render_system->destroyShader(mesh_shader);
+    mesh_shader = NULL;
   }
 
-  // Do the rendering
+  if (!mesh_shader)
+  {
+    mesh_shader = render_system->createShader("Mesh shader");
+    if (!mesh_shader)
+    {
+      THEA_ERROR << "Could not create mesh shader";
+      return false;
+    }
+
+    if (!initMeshShader(*mesh_shader, matcap_tex != NULL, tex3d != NULL))
+    {
+      THEA_ERROR << "Could not initialize mesh shader";
+      render_system->destroyShader(mesh_shader);
+      mesh_shader = NULL;
+      return false;
+    }
+
+    mesh_shader_variant = variant;
+  }
+
+  try
+  {
+    setMeshShaderUniforms(*mesh_shader, material, matcap_tex, tex3d, first_mesh->mesh_group.getBounds());
+  }
+  THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "%s", "Could not set mesh shader parameters")
+
+  return true;
+}
+
+struct GPUBufferReleaser
+{
+  GPUBufferReleaser(RenderSystem & render_system_) : render_system(render_system_) {}
+  bool operator()(Mesh & mesh) { mesh.releaseGPUBuffers(render_system); return false; }
+
+  RenderSystem & render_system;
+};
+
+void
+ShapeRendererImpl::releaseGPUBuffers(ModelSet & models)
+{
+  GPUBufferReleaser releaser(*render_system);
+  models.primary.mesh_group.forEachMeshUntil(&releaser);
+  for (array_size_t i = 0; i < models.overlay_models.size(); ++i)
+    models.overlay_models[i]->mesh_group.forEachMeshUntil(&releaser);
+}
+
+// A bounded, blocking FIFO queue for passing work from one stage of the batch pipeline to the next
+template <typename T>
+class BatchQueue
+{
+  public:
+    BatchQueue(array_size_t capacity_) : capacity(std::max(capacity_, (array_size_t)1)), closed(false) {}
+
+    // Add an item at the back of the queue, waiting for space if the queue is full
+    void push(T const & item)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      while (items.size() >= capacity)
+        not_full.wait(lock);
+
+      items.push_back(item);
+      not_empty.notify_one();
+    }
+
+    // Remove the item at the front of the queue, waiting for one if the queue is empty. Returns false if the queue is empty and
+    // has been closed.
+    bool pop(T & item)
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      while (items.empty() && !closed)
+        not_empty.wait(lock);
+
+      if (items.empty())
+        return false;
+
+      item = items.front();
+      items.pop_front();
+      not_full.notify_one();
+
+      return true;
+    }
+
+    // Signal that no more items will be added
+    void close()
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      closed = true;
+      not_empty.notify_all();
+    }
+
+  private:
+    array_size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    boost::mutex mutex;
+    boost::condition_variable not_empty;
+    boost::condition_variable not_full;
+
+}; // class BatchQueue
+
+// Save an image immediately if there is no output queue, else queue it for an encoder thread
+bool
+emitImage(OutputImage image, OutputQueue * output_queue)
+{
+  if (!output_queue)
+    return image.save();
+
+  output_queue->push(image);
+  return true;
+}
+
+bool
+ShapeRendererImpl::renderViews(ModelSet const & models, OutputQueue * output_queue)
+{
+  // Set up framebuffer for offscreen drawing, and the textures and shaders used by this command line
+  int buffer_width   =  antialiasing_level * out_width;
+  int buffer_height  =  antialiasing_level * out_height;
+  if (!initFramebuffer(buffer_width, buffer_height) || !loadTextures() || !updateMeshShader(models))
+    return false;
+
   for (array_size_t v = 0; v < views.size(); ++v)
   {
     try
     {
       // Initialize the camera
-      Camera camera = model.fitCamera(transforms[0], views[v], zoom, buffer_width, buffer_height);
+      Camera camera = models.primary.fitCamera(transforms[0], views[v], zoom, buffer_width, buffer_height);
       if (print_camera)
         THEA_CONSOLE << "Camera for view " << v << " is: " << camera.toString();
 
       // Render the mesh to the offscreen framebuffer
       render_system->pushFramebuffer();
-        render_system->setFramebuffer(fb);
+        render_system->setFramebuffer(framebuffer);
 
         render_system->pushDepthFlags();
         render_system->pushColorFlags();
@@ -423,13 +817,13 @@ ShapeRendererImpl::exec(int argc, char ** argv)
           // Draw primary model
           render_system->setMatrixMode(RenderSystem::MatrixMode::MODELVIEW); render_system->pushMatrix();
             render_system->multMatrix(transforms[0]);
-            renderModel(model, primary_color);
+            renderModel(models.primary, primary_color);
           render_system->setMatrixMode(RenderSystem::MatrixMode::MODELVIEW); render_system->popMatrix();
 
           // Draw overlay models
-          for (array_size_t i = 0; i < overlay_models.size(); ++i)
+          for (array_size_t i = 0; i < models.overlay_models.size(); ++i)
           {
-            Model const & overlay = *overlay_models[i];
+            Model const & overlay = *models.overlay_models[i];
             ColorRGBA overlay_color = getPaletteColor((long)i - 1);
             overlay_color.a() = (!color_by_id && !overlay.is_point_cloud ? 0.5f : 1.0f);
 
@@ -448,15 +842,9 @@ ShapeRendererImpl::exec(int argc, char ** argv)
         render_system->popColorFlags();
         render_system->popDepthFlags();
 
-        // Grab and save the rendered image
-        Image image(Image::Type::RGB_8U, buffer_width, buffer_height);
-        color_tex->getImage(image);
-
-        if (antialiasing_level > 1 && !image.rescale(out_width, out_height, 1, Image::Filter::BICUBIC))
-        {
-          THEA_ERROR << "Could not rescale image to output dimensions";
-          return -1;
-        }
+        // Grab the rendered image and save it, or hand it to the encoder threads
+        Image::Ptr image(new Image(Image::Type::RGB_8U, buffer_width, buffer_height));
+        color_tex->getImage(*image);
 
         string path = out_path;
         if (views.size() > 1)
@@ -465,35 +853,277 @@ ShapeRendererImpl::exec(int argc, char ** argv)
                                   FilePath::baseName(path) + format("_%06ld.", (long)v) + FilePath::completeExtension(path));
         }
 
-        image.save(path);
+        if (!emitImage(OutputImage(image, out_width, out_height, path), output_queue))
+          return false;
 
         // Grab and save the depth image
         if (save_depth)
         {
-          Image depth_image(Image::Type::LUMINANCE_16U, buffer_width, buffer_height);
-          depth_tex->getImage(depth_image);
-
-          if (antialiasing_level > 1 && !depth_image.rescale(out_width, out_height, 1, Image::Filter::BICUBIC))
-          {
-            THEA_ERROR << "Could not rescale depth image to output dimensions";
-            return -1;
-          }
+          Image::Ptr depth_image(new Image(Image::Type::LUMINANCE_16U, buffer_width, buffer_height));
+          depth_tex->getImage(*depth_image);
 
           string suffix = (views.size() > 1 ? format("_%06ld.tif", (long)v) : ".tif");
           string depth_path = FilePath::concat(FilePath::parent(out_path), FilePath::baseName(out_path) + "_depth" + suffix);
 
-          depth_image.save(depth_path);
+          if (!emitImage(OutputImage(depth_image, out_width, out_height, depth_path), output_queue))
+            return false;
         }
 
       render_system->popFramebuffer();
     }
-    THEA_STANDARD_CATCH_BLOCKS(return -1;, ERROR, "Could not render view %ld of shape", (long)v)
+    THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "Could not render view %ld of shape", (long)v)
   }
 
-  render_system->destroyTexture(tex3d);
-  render_system->destroyTexture(matcap_tex);
+  return true;
+}
 
-  THEA_CONSOLE << "Rendered " << views.size() << " view(s) of the shape";
+// Saves images from the output queue until it is closed
+struct BatchEncoder
+{
+  BatchEncoder(OutputQueue & queue_, AtomicInt32 & num_failed_) : queue(queue_), num_failed(num_failed_) {}
+
+  void operator()()
+  {
+    OutputImage image;
+    while (queue.pop(image))
+    {
+      if (!image.save())
+        num_failed.increment();
+
+      image.image.reset();  // don't hold on to the pixels while waiting for the next image
+    }
+  }
+
+  OutputQueue & queue;
+  AtomicInt32 & num_failed;
+};
+
+// A single line of the job list
+struct BatchJob
+{
+  BatchJob() : index(-1), reuses_models(false) {}
+
+  long index;                                     // position in the job list
+  string cmdline;                                 // the line itself
+  Thea::shared_ptr<ShapeRendererImpl> settings;   // parsed arguments, null if they could not be parsed
+  string model_key;                               // identifies the loaded shapes, see ShapeRendererImpl::modelKey()
+  bool reuses_models;                             // loads the same shapes as the previous job, so they weren't reloaded
+  ModelSetPtr models;                             // loaded shapes, null if reused or if they could not be loaded
+};
+
+typedef Thea::shared_ptr<BatchJob> BatchJobPtr;
+
+// State shared by the stages of the batch pipeline
+struct BatchState
+{
+  BatchState(istream & jobs_, TheaArray<string> const & common_args_, long max_jobs_ahead_)
+  : jobs(jobs_), common_args(common_args_), num_jobs_read(0), max_jobs_ahead(max_jobs_ahead_), input_done(false),
+    num_jobs(0), next_job_to_render(0)
+  {}
+
+  // Accessed only by loader threads, under input_mutex
+  istream & jobs;
+  TheaArray<string> const & common_args;
+  long num_jobs_read;
+  string last_model_key;
+  boost::mutex input_mutex;
+
+  // Shared by the loader threads and the rendering thread, under ready_mutex
+  long max_jobs_ahead;                // maximum number of loaded jobs waiting to be rendered
+  bool input_done;
+  long num_jobs;                      // total number of jobs, valid once input_done is set
+  long next_job_to_render;
+  std::map<long, BatchJobPtr> ready_jobs;
+  boost::mutex ready_mutex;
+  boost::condition_variable job_ready;
+  boost::condition_variable slot_free;
+};
+
+// Reads jobs from the job list, and loads their shapes in parallel with rendering
+struct BatchLoader
+{
+  BatchLoader(BatchState & state_) : state(state_) {}
+
+  void operator()()
+  {
+    while (true)
+    {
+      BatchJobPtr job(new BatchJob);
+      if (!readJob(*job))
+        return;
+
+      if (job->settings && !job->reuses_models)
+      {
+        ShapeRendererImpl const & settings = *job->settings;
+        job->models = ModelSetPtr(new ModelSet(settings.show_points & POINTS_PRIMARY));
+        try
+        {
+          if (!job->settings->loadModels(*job->models))
+            job->models.reset();
+        }
+        THEA_STANDARD_CATCH_BLOCKS(job->models.reset();, ERROR, "Could not load shapes for job %ld", job->index)
+      }
+
+      boost::mutex::scoped_lock lock(state.ready_mutex);
+      state.ready_jobs[job->index] = job;
+      state.job_ready.notify_all();
+    }
+  }
+
+  // Read and parse the next job, in job list order. Returns false if there are no more jobs.
+  bool readJob(BatchJob & job)
+  {
+    boost::mutex::scoped_lock input_lock(state.input_mutex);
+
+    // Don't get too far ahead of the renderer
+    {
+      boost::mutex::scoped_lock ready_lock(state.ready_mutex);
+      while (state.num_jobs_read - state.next_job_to_render >= state.max_jobs_ahead)
+        state.slot_free.wait(ready_lock);
+    }
+
+    string line;
+    do
+    {
+      if (!getline(state.jobs, line))
+      {
+        boost::mutex::scoped_lock ready_lock(state.ready_mutex);
+        state.input_done = true;
+        state.num_jobs = state.num_jobs_read;
+        state.job_ready.notify_all();
+        return false;
+      }
+
+      line = trimWhitespace(line);
+
+    } while (line.empty() || line[0] == '#');
+
+    job.index = state.num_jobs_read++;
+    job.cmdline = line;
+
+    TheaArray<string> args = state.common_args;
+    TheaArray<string> line_args;
+    stringSplit(line, " \t\n\f\r", line_args, true);
+    args.insert(args.end(), line_args.begin(), line_args.end());
+
+    try
+    {
+      ArgList arg_list(args);
+      job.settings = Thea::shared_ptr<ShapeRendererImpl>(new ShapeRendererImpl);
+      if (!job.settings->parseArgs(arg_list.getArgc(), arg_list.getArgv()))
+        job.settings.reset();
+    }
+    THEA_STANDARD_CATCH_BLOCKS(job.settings.reset();, ERROR, "Could not parse job %ld", job.index)
+
+    if (!job.settings)
+      return true;
+
+    // Consecutive jobs rendering the same shapes (e.g. different views) share the shapes loaded for the first of them
+    job.model_key = job.settings->modelKey();
+    job.reuses_models = (job.model_key == state.last_model_key);
+    state.last_model_key = job.model_key;
+
+    return true;
+  }
+
+  BatchState & state;
+};
+
+int
+ShapeRendererImpl::execBatch(istream & jobs, TheaArray<string> const & common_args)
+{
+  // Jobs are loaded and images are encoded by worker threads. Rendering happens only in this thread, which owns the
+  // rendersystem, so the framebuffer, textures, shaders and shape buffers can be reused from one job to the next.
+  long num_threads = System::concurrency();
+  long num_loaders = num_threads;
+  long num_encoders = num_threads;
+
+  BatchState state(jobs, common_args, 2 * num_loaders);
+  OutputQueue output_queue((array_size_t)(4 * num_encoders));
+  AtomicInt32 num_failed_images(0);
+
+  boost::thread_group loaders, encoders;
+  for (long i = 0; i < num_loaders; ++i)
+    loaders.create_thread(BatchLoader(state));
+
+  for (long i = 0; i < num_encoders; ++i)
+    encoders.create_thread(BatchEncoder(output_queue, num_failed_images));
+
+  ModelSetPtr current_models;
+  string current_model_key;
+  long num_rendered_jobs = 0, num_failed_jobs = 0, num_views = 0;
+  while (true)
+  {
+    // Wait for the next job in order
+    BatchJobPtr job;
+    {
+      boost::mutex::scoped_lock lock(state.ready_mutex);
+      std::map<long, BatchJobPtr>::iterator ready;
+      while ((ready = state.ready_jobs.find(state.next_job_to_render)) == state.ready_jobs.end())
+      {
+        if (state.input_done && state.next_job_to_render >= state.num_jobs)
+          break;
+
+        state.job_ready.wait(lock);
+      }
+
+      if (ready == state.ready_jobs.end())
+        break;
+
+      job = ready->second;
+      state.ready_jobs.erase(ready);
+      state.next_job_to_render++;
+      state.slot_free.notify_all();
+    }
+
+    num_rendered_jobs++;
+
+    if (job->settings && !job->reuses_models)
+    {
+      // Free the GPU buffers of the shapes of the previous job before uploading new ones
+      if (current_models)
+        releaseGPUBuffers(*current_models);
+
+      current_models = job->models;
+      current_model_key = job->model_key;
+    }
+
+    bool status = false;
+    if (!job->settings)
+      THEA_ERROR << "Could not parse job " << job->index << ": " << job->cmdline;
+    else if (!current_models || current_model_key != job->model_key)
+      THEA_ERROR << "Could not load shapes for job " << job->index << ": " << job->cmdline;
+    else
+    {
+      status = job->settings->renderViews(*current_models, &output_queue);
+      if (status)
+        num_views += (long)job->settings->views.size();
+      else
+        THEA_ERROR << "Could not render job " << job->index << ": " << job->cmdline;
+    }
+
+    if (!status)
+      num_failed_jobs++;
+  }
+
+  loaders.join_all();
+
+  output_queue.close();
+  encoders.join_all();
+
+  if (current_models)
+    releaseGPUBuffers(*current_models);
+
+  THEA_CONSOLE << "Rendered " << num_views << " view(s) from " << num_rendered_jobs - num_failed_jobs << " of "
+               << num_rendered_jobs << " job(s)";
+
+  if (num_failed_jobs > 0 || num_failed_images.value() > 0)
+  {
+    if (num_failed_images.value() > 0)
+      THEA_ERROR << "Could not save " << num_failed_images.value() << " image(s)";
+
+    return -1;
+  }
 
   return 0;
 }
@@ -505,6 +1135,7 @@ ShapeRendererImpl::usage()
 
   THEA_CONSOLE << "";
   THEA_CONSOLE << "Usage: " << app_path << " [OPTIONS] <mesh> <output-image> <width> <height>";
+  THEA_CONSOLE << "       " << app_path << " [OPTIONS] --batch <job-list>";
   THEA_CONSOLE << "";
   THEA_CONSOLE << "Options:";
   THEA_CONSOLE << "  -o <overlay-shape>    (may be mesh or point set)";
@@ -538,6 +1169,14 @@ ShapeRendererImpl::usage()
   THEA_CONSOLE << "  -d                    (also save the depth image)";
   THEA_CONSOLE << "  -w cam                (print the camera parameters)";
   THEA_CONSOLE << "  -i <shift>            (add a shift to how indices are mapped to colors)";
+  THEA_CONSOLE << "  --software            (render on the CPU instead of with OpenGL -- used";
+  THEA_CONSOLE << "                         automatically if OpenGL is not available)";
+  THEA_CONSOLE << "  --batch <path>        (render each line of <path>, or of stdin if <path> is";
+  THEA_CONSOLE << "                         '-', as a separate command line without the program";
+  THEA_CONSOLE << "                         name, with any other options applied to every line;";
+  THEA_CONSOLE << "                         shapes are loaded and images saved in parallel with";
+  THEA_CONSOLE << "                         rendering, and consecutive lines with the same shapes";
+  THEA_CONSOLE << "                         load them only once)";
   THEA_CONSOLE << "";
 
   return false;
@@ -826,6 +1465,9 @@ ShapeRendererImpl::parseArgs(int argc, char ** argv)
     if (arg.length() <= 0)
       continue;
 
+    if (arg == "--software")  // handled when the plugins are loaded
+      continue;
+
     if (arg[0] == '-')
     {
       if (arg.length() != 2)
@@ -2018,7 +2660,7 @@ modelBSphere(Model const & model, Matrix4 const & transform)
 }
 
 Camera
-Model::fitCamera(Matrix4 const & transform, View const & view, Real zoom, int width, int height)
+Model::fitCamera(Matrix4 const & transform, View const & view, Real zoom, int width, int height) const
 {
   // Orientation
   Ball3 bsphere = modelBSphere(*this, transform);
@@ -2097,8 +2739,7 @@ initPointShader(Shader & shader)
 }
 
 bool
-initMeshShader(Shader & shader, Vector4 const & material, Texture * matcap_tex = NULL, Texture * tex3d = NULL,
-               AxisAlignedBox3 const & bbox = AxisAlignedBox3())
+initMeshShader(Shader & shader, bool use_matcap, bool use_tex3d)
 {
   static string const VERTEX_SHADER =
 "varying vec3 src_pos;  // position in mesh coordinates\n"
@@ -2160,16 +2801,16 @@ initMeshShader(Shader & shader, Vector4 const & material, Texture * matcap_tex =
 "}\n";
 
   string fragment_shader = FRAGMENT_SHADER_HEADER_1;
-  if (matcap_tex)
+  if (use_matcap)
     fragment_shader += FRAGMENT_SHADER_HEADER_MATCAP;
   else
     fragment_shader += FRAGMENT_SHADER_HEADER_PHONG;
 
-  if (tex3d) fragment_shader += FRAGMENT_SHADER_HEADER_TEX3D;
+  if (use_tex3d) fragment_shader += FRAGMENT_SHADER_HEADER_TEX3D;
 
   fragment_shader += FRAGMENT_SHADER_BODY_1;
-  if (tex3d) fragment_shader += FRAGMENT_SHADER_BODY_TEX3D;
-  if (matcap_tex)
+  if (use_tex3d) fragment_shader += FRAGMENT_SHADER_BODY_TEX3D;
+  if (use_matcap)
     fragment_shader += FRAGMENT_SHADER_BODY_MATCAP;
   else
     fragment_shader += FRAGMENT_SHADER_BODY_PHONG;
@@ -2181,6 +2822,14 @@ initMeshShader(Shader & shader, Vector4 const & material, Texture * matcap_tex =
   }
   THEA_STANDARD_CATCH_BLOCKS(return false;, ERROR, "%s", "Could not attach mesh shader module")
 
+  return true;
+}
+
+// Set the parameters of a mesh shader compiled by initMeshShader(), with the same choice of matcap and 3D texture
+void
+setMeshShaderUniforms(Shader & shader, Vector4 const & material, Texture * matcap_tex, Texture * tex3d,
+                      AxisAlignedBox3 const & bbox)
+{
   shader.setUniform("two_sided", 1.0f);
 
   if (matcap_tex)
@@ -2211,8 +2860,6 @@ initMeshShader(Shader & shader, Vector4 const & material, Texture * matcap_tex =
     shader.setUniform("bbox_lo", center - 0.5 * box_ext);
     shader.setUniform("bbox_hi", center + 0.5 * box_ext);
   }
-
-  return true;
 }
 
 bool
@@ -2253,7 +2900,7 @@ ShapeRendererImpl::renderModel(Model const & model, ColorRGBA const & color)
   render_system->setColor(color);
 
   bool has_transparency = (color.a() < 1);
-  if (has_transparency)
+  if (has_transparency && !software_rendering)  // the software rendersystem always blends translucent fragments
   {
     // Enable alpha-blending
     glEnable(GL_BLEND);
@@ -2321,20 +2968,11 @@ ShapeRendererImpl::renderModel(Model const & model, ColorRGBA const & color)
     }
     else
     {
+      // Set up by updateMeshShader()
       if (!mesh_shader)
       {
-        mesh_shader = render_system->createShader("Mesh shader");
-        if (!mesh_shader)
-        {
-          THEA_ERROR << "Could not create mesh shader";
-          return false;
-        }
-
-        if (!initMeshShader(*mesh_shader, material, matcap_tex, tex3d, model.mesh_group.getBounds()))
-        {
-          THEA_ERROR << "Could not initialize mesh shader";
-          return false;
-        }
+        THEA_ERROR << "Mesh shader not initialized";
+        return false;
       }
 
       render_system->setShader(mesh_shader);
@@ -2373,20 +3011,19 @@ ShapeRendererImpl::renderModel(Model const & model, ColorRGBA const & color)
 }
 
 bool
-ShapeRendererImpl::loadPlugins(int argc, char ** argv)
+ShapeRendererImpl::loadRenderSystem(string const & plugin_name, string const & factory_name)
 {
   string app_path = FileSystem::resolve(Application::programPath());
   string plugin_dir = FilePath::concat(FilePath::parent(FilePath::parent(app_path)), "lib");
 
-  // Try to load the OpenGL plugin
 #ifdef THEA_DEBUG_BUILD
 
 #ifdef THEA_WINDOWS
-  string debug_plugin_path    =  FilePath::concat(plugin_dir, "TheaPluginGLd");
-  string release_plugin_path  =  FilePath::concat(plugin_dir, "TheaPluginGL");
+  string debug_plugin_path    =  FilePath::concat(plugin_dir, "TheaPlugin" + plugin_name + "d");
+  string release_plugin_path  =  FilePath::concat(plugin_dir, "TheaPlugin" + plugin_name);
 #else
-  string debug_plugin_path    =  FilePath::concat(plugin_dir, "libTheaPluginGLd");
-  string release_plugin_path  =  FilePath::concat(plugin_dir, "libTheaPluginGL");
+  string debug_plugin_path    =  FilePath::concat(plugin_dir, "libTheaPlugin" + plugin_name + "d");
+  string release_plugin_path  =  FilePath::concat(plugin_dir, "libTheaPlugin" + plugin_name);
 #endif
 
 #ifdef THEA_WINDOWS
@@ -2401,35 +3038,58 @@ ShapeRendererImpl::loadPlugins(int argc, char ** argv)
 #else
 
 #ifdef THEA_WINDOWS
-  string plugin_path = FilePath::concat(plugin_dir, "TheaPluginGL");
+  string plugin_path = FilePath::concat(plugin_dir, "TheaPlugin" + plugin_name);
 #else
-  string plugin_path = FilePath::concat(plugin_dir, "libTheaPluginGL");
+  string plugin_path = FilePath::concat(plugin_dir, "libTheaPlugin" + plugin_name);
 #endif
 
 #endif
 
-  Plugin * gl_plugin = Application::getPluginManager().load(plugin_path);
-  if (!gl_plugin)
+  Plugin * plugin = Application::getPluginManager().load(plugin_path);
+  if (!plugin)
   {
-    THEA_ERROR << "Could not load OpenGL plugin: " << plugin_path;
+    THEA_ERROR << "Could not load " << plugin_name << " plugin: " << plugin_path;
     return false;
   }
 
-  gl_plugin->startup();
+  plugin->startup();
 
-  render_system_factory = Application::getRenderSystemManager().getFactory("OpenGL");
+  render_system_factory = Application::getRenderSystemManager().getFactory(factory_name.c_str());
   if (!render_system_factory)
   {
-    THEA_ERROR << "Could not get OpenGL rendersystem factory";
+    THEA_ERROR << "Could not get " << factory_name << " rendersystem factory";
     return false;
   }
 
-  render_system = render_system_factory->createRenderSystem("OpenGL RenderSystem");
+  render_system = render_system_factory->createRenderSystem((factory_name + " RenderSystem").c_str());
   if (!render_system)
   {
-    THEA_ERROR << "Could not create OpenGL rendersystem";
+    THEA_ERROR << "Could not create " << factory_name << " rendersystem";
+    render_system_factory = NULL;
     return false;
   }
 
   return true;
 }
+
+bool
+ShapeRendererImpl::loadPlugins(int argc, char ** argv)
+{
+  // Render on the CPU if explicitly requested, else try OpenGL first and fall back to the CPU if it is not available (e.g. on
+  // a headless server)
+  software_rendering = false;
+  for (int i = 1; i < argc; ++i)
+    if (string(argv[i]) == "--software")
+      software_rendering = true;
+
+  if (!software_rendering)
+  {
+    if (loadRenderSystem("GL", "OpenGL"))
+      return true;
+
+    THEA_WARNING << "Could not initialize OpenGL, falling back to software rendering";
+    software_rendering = true;
+  }
+
+  return loadRenderSystem("Software", "Software");
+}
@@ -2,6 +2,7 @@
 #define __Thea_RenderShape_ShapeRenderer__
 
 #include "../../Common.hpp"
+#include <iosfwd>
 
 using namespace std;
 
@@ -15,6 +16,7 @@ class ShapeRenderer
 
     int exec(string const & cmdline);
     int exec(int argc, char ** argv);
+    int execBatch(istream & jobs);  // each non-blank line is a separate command line, without the program name
 
   private:
     ShapeRendererImpl * impl;
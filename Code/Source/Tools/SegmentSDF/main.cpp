@@ -9,6 +9,7 @@
 #endif
 
 #include "../../Algorithms/ConvexHull3.hpp"
+#include "../../Algorithms/MeanShiftN.hpp"
 #include "../../Algorithms/MeshKDTree.hpp"
 #include "../../Graphics/GeneralMesh.hpp"
 #include "../../Graphics/MeshGroup.hpp"
@@ -19,7 +20,6 @@
 #include "../../UnorderedMap.hpp"
 #include "../../VectorN.hpp"
 #include <boost/functional/hash.hpp>
-#include <boost/thread/thread.hpp>
 #include <algorithm>
 #include <cstdlib>
 #include <fstream>
@@ -250,41 +250,6 @@ getPaletteColor(int i)
   return COLOR_PALETTE[i % numPaletteColors()];
 }
 
-namespace MathInternal {
-
-// exp(-x) approximation from http://www.xnoiz.co.cc/fast-exp-x/
-inline float fastMinuzExp_1(float x) {
-
-        // err <= 3e-3
-        return 1
-                -x*(0.9664
-                -x*(0.3536));
-
-}
-
-} // namespace MathInternal
-
-/** Computes a fast approximation to exp(-x) for 0 <= x <= 1. */
-inline float
-fastMinusExp01(float x)
-{
-  if (x > 0.69)
-  {
-    float y = MathInternal::fastMinuzExp_1(0.5 * x);
-    return y * y;
-  }
-  else
-    return MathInternal::fastMinuzExp_1(x);
-}
-
-// Returns a value proportional to the (negative of the) derivative of k(s) w.r.t. s, where the kernel is k(x^2).
-inline double
-dKernel(double x_squared)
-{
-  return fastMinusExp01(x_squared);
-//   return 1;
-}
-
 /** A value, plus an index, sortable by value. */
 struct IndexedValue
 {
@@ -325,66 +290,8 @@ estimateBandwidth(TheaArray<IndexedValue> const & sorted_pts)
   return bandwidth;
 }
 
-double
-doMeanShift(double start, TheaArray<IndexedValue> const & sorted_pts, double bandwidth, unsigned int num_iters = 100,
-            double threshold = 0.001)
-{
-  double inv_bandwidth = 1.0 / bandwidth;
-
-  for (unsigned int i = 0; i < num_iters; ++i)
-  {
-    // Speed up things by only looking at points within a window
-    double lo = start - 1.2 * bandwidth;
-    double hi = start + 1.2 * bandwidth;
-
-    typedef TheaArray<IndexedValue>::const_iterator Iterator;
-    Iterator begin = lower_bound(sorted_pts.begin(), sorted_pts.end(), IndexedValue(lo, -1));
-    Iterator end   = upper_bound(sorted_pts.begin(), sorted_pts.end(), IndexedValue(hi, -1));
-
-    double weighted_sum = 0;
-    double sum_weights = 0, x, w;
-    for (Iterator pi = begin; pi != end; ++pi)
-    {
-      x = (pi->value - start) * inv_bandwidth;
-      w = dKernel(x * x);
-      weighted_sum += w * (pi->value);
-      sum_weights += w;
-    }
-
-    if (Math::fuzzyNe(sum_weights, 0.0))
-    {
-      double new_start = weighted_sum / sum_weights;
-      double shift = fabs(new_start - start);
-      start = new_start;
-      if (shift < threshold) break;
-    }
-    else
-      break;
-  }
-
-  return start;
-}
-
-void
-doMeanShiftBlock(TheaArray<IndexedValue> const * descs, TheaArray<IndexedValue> * modes, array_size_t begin, array_size_t end,
-                 double bandwidth, int thread_index)
-{
-  static unsigned int const NUM_ITERS = 100;
-  static double       const THRESHOLD = 0.0001;
-
-  array_size_t actual_end = min(end, descs->size());
-  for (array_size_t i = begin; i < actual_end; ++i)
-    (*modes)[i] = IndexedValue(doMeanShift((*descs)[i].value, *descs, bandwidth, NUM_ITERS, THRESHOLD), (*descs)[i].index);
-}
-
 typedef UnionFind<> LabelUnionFind;
 
-int
-defaultConcurrency()
-{
-  return (int)System::concurrency();
-}
-
 int
 countSDFModes(TheaArray<Real> const & sdf_values)
 {
@@ -393,30 +300,38 @@ countSDFModes(TheaArray<Real> const & sdf_values)
   for (array_size_t i = 0; i < sdf_values.size(); ++i)
     descs[i] = IndexedValue(sdf_values[i], (int)i);
 
-  // Sort them, so we can quickly get all points in a range
+  // Sort them, so we can compute quartiles
   sort(descs.begin(), descs.end());
 
   double bandwidth = estimateBandwidth(descs);  // 0.005
   THEA_CONSOLE << "Estimated bandwidth = " << bandwidth;
 
-  // Do mean shift on each point to find its nearest mode
-  TheaArray<IndexedValue> modes(descs.size());
-
-  array_size_t num_threads = (array_size_t)defaultConcurrency();  // numCores()
-  THEA_CONSOLE << "Using " << num_threads << " threads to find initial modes via mean-shift";
+  // Do mean shift on each point to find its nearest mode. The kernel exp(-(x / h)^2), truncated at 1.2h, is a standard
+  // Gaussian with bandwidth h / sqrt(2). Modes are merged below, so every sample is a seed and no merging is done here. The
+  // values are embedded on the X axis of the plane since VectorN<1> is not instantiable.
+  static long   const NUM_ITERS = 100;
+  static double const THRESHOLD = 0.0001;
+
+  double ms_bandwidth = bandwidth / sqrt(2.0);
+  typedef MeanShiftN<2, double> MeanShift;
+  MeanShift ms(MeanShift::Options()
+               .setBandwidth(ms_bandwidth)
+               .setKernel(MeanShift::Kernel::GAUSSIAN)
+               .setKernelSupport(1.2 * sqrt(2.0))
+               .setBinSeeding(false)
+               .setMaxIterations(NUM_ITERS)
+               .setConvergenceThreshold(THRESHOLD / ms_bandwidth)
+               .setMergeRadius(0));
+
+  TheaArray< VectorN<2, double> > samples(descs.size());
+  for (array_size_t i = 0; i < descs.size(); ++i)
+    samples[i] = VectorN<2, double>(descs[i].value, 0);
+
+  ms.cluster(samples.begin(), samples.end());
 
-  array_size_t samples_per_thread = (descs.size() <= num_threads
-                                  ? 1 : (array_size_t)ceil(descs.size() / (double)num_threads));
-
-  boost::thread_group threads;
-  int thread_index = 0;
-  for (array_size_t begin = 0; begin < descs.size(); begin += samples_per_thread, ++thread_index)
-  {
-    threads.add_thread(new boost::thread(doMeanShiftBlock, &descs, &modes, begin, begin + samples_per_thread, bandwidth,
-                                         thread_index));
-  }
-
-  threads.join_all();
+  TheaArray<IndexedValue> modes(descs.size());
+  for (array_size_t i = 0; i < descs.size(); ++i)
+    modes[i] = IndexedValue(ms.getConvergedSeed((long)i)[0], descs[i].index);
 
   // Sort the set of modes
   sort(modes.begin(), modes.end());
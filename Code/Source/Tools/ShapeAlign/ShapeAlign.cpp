@@ -3,11 +3,14 @@
 #include "../../Algorithms/ICP3.hpp"
 #include "../../Algorithms/KDTreeN.hpp"
 #include "../../Algorithms/MeshSampler.hpp"
+#include "../../Algorithms/QueryStatistics.hpp"
 #include "../../Graphics/DisplayMesh.hpp"
 #include "../../Graphics/MeshGroup.hpp"
 #include "../../AffineTransformN.hpp"
 #include "../../FilePath.hpp"
 #include "../../MatrixMN.hpp"
+#include "../../ParallelFor.hpp"
+#include "../../UnorderedMap.hpp"
 #include "../../VectorN.hpp"
 #include <cstdio>
 #include <fstream>
@@ -21,6 +24,8 @@ using namespace Graphics;
 typedef VectorN<3, double> DVector3;
 typedef MatrixMN<3, 3, double> DMatrix3;
 typedef AffineTransformN<3, double> DAffineTransform3;
+typedef KDTreeN<DVector3, 3, double> DKDTree3;
+typedef Thea::shared_ptr<DKDTree3> DKDTree3Ptr;
 
 long num_mesh_samples = 5000;
 bool normalize_scales = false;
@@ -31,6 +36,9 @@ bool rotate_axis_aligned = false;
 bool rotate_arbitrary = false;
 bool has_up_vector = false;
 DVector3 up_vector;
+bool verbose = false;
+string corpus_error_path;
+bool log_alignment_steps = true;  // turned off in corpus mode, where the messages of pairs aligned in parallel would interleave
 
 int
 usage(int argc, char * argv[])
@@ -45,6 +53,9 @@ usage(int argc, char * argv[])
   THEA_CONSOLE << "  -x                  :  Test over various axis-aligned rotations";
   THEA_CONSOLE << "  -r                  :  Test over various rotations (currently requires -u)";
   THEA_CONSOLE << "  -u                  :  Up vector";
+  THEA_CONSOLE << "  -v, --verbose       :  Print statistics of spatial queries at the end";
+  THEA_CONSOLE << "  --corpus <errors>   :  Load each shape once, align all (from, to) pairs in parallel, and write the";
+  THEA_CONSOLE << "                         matrix of alignment errors (one row per <from> shape) to <errors>";
   return -1;
 }
 
@@ -205,41 +216,68 @@ loadPoints(string const & points_path, TheaArray<DVector3> & points)
   return true;
 }
 
+// A shape loaded and preprocessed once, for alignment to and from any number of other shapes.
+struct Shape
+{
+  string path;                    ///< Path to the shape file.
+  TheaArray<DVector3> points;     ///< Points sampled from the shape.
+  DVector3 center;                ///< Centroid of the points.
+  double avg_dist;                ///< Average distance of the points from the centroid.
+  DKDTree3Ptr kdtree;             ///< Kd-tree on the points, if the shape is a target of alignment.
+};
+
+bool
+loadShape(string const & path, bool build_kdtree, Shape & shape)
+{
+  shape.path = path;
+  if (!loadPoints(path, shape.points))
+    return false;
+
+  shape.center = DVector3::zero();
+  shape.avg_dist = 0;
+  shape.kdtree.reset();
+
+  if (shape.points.empty())
+    return true;
+
+  // Measure average distance of points to the centroid
+  shape.center = CentroidN<DVector3, 3, double>::compute(shape.points.begin(), shape.points.end());
+  for (array_size_t i = 0; i < shape.points.size(); ++i)
+    shape.avg_dist += (shape.points[i] - shape.center).length();
+
+  shape.avg_dist /= shape.points.size();
+
+  if (build_kdtree)
+  {
+    shape.kdtree = DKDTree3Ptr(new DKDTree3(shape.points.begin(), shape.points.end()));
+    shape.kdtree->getBounds();  // cache the bounds so that concurrent queries don't modify the tree
+  }
+
+  return true;
+}
+
 DAffineTransform3
-normalization(TheaArray<DVector3> const & from_pts, TheaArray<DVector3> const & to_pts, double & from_scale, double & to_scale)
+normalization(Shape const & from, Shape const & to, double & from_scale, double & to_scale)
 {
   from_scale = to_scale = 1.0;
 
-  if (from_pts.empty() || to_pts.empty())
+  if (from.points.empty() || to.points.empty())
     return DAffineTransform3::identity();
 
-  DVector3 from_center  =  CentroidN<DVector3, 3, double>::compute(from_pts.begin(), from_pts.end());
-  DVector3 to_center    =  CentroidN<DVector3, 3, double>::compute(to_pts.begin(), to_pts.end());
+  DVector3 const & from_center  =  from.center;
+  DVector3 const & to_center    =  to.center;
 
   double rescaling = 1.0;
   if (normalize_scales)
   {
-    // Measure average distance of from_pts to from_center
-    double from_avg_dist = 0;
-    for (array_size_t i = 0; i < from_pts.size(); ++i)
-      from_avg_dist += (from_pts[i] - from_center).length();
-
-    from_avg_dist /= from_pts.size();
-
-    // Measure average distance of to_pts to to_center
-    double to_avg_dist = 0;
-    for (array_size_t i = 0; i < to_pts.size(); ++i)
-      to_avg_dist += (to_pts[i] - to_center).length();
+    if (from.avg_dist > 0 && to.avg_dist > 0)
+      rescaling = to.avg_dist / from.avg_dist;
 
-    to_avg_dist /= to_pts.size();
+    from_scale  =  from.avg_dist;
+    to_scale    =  to.avg_dist;
 
-    if (from_avg_dist > 0 && to_avg_dist > 0)
-      rescaling = to_avg_dist / from_avg_dist;
-
-    from_scale  =  from_avg_dist;
-    to_scale    =  to_avg_dist;
-
-    THEA_CONSOLE << "Rescaling = " << rescaling;
+    if (log_alignment_steps)
+      THEA_CONSOLE << "Rescaling = " << rescaling;
   }
 
   if (normalize_scales)
@@ -299,31 +337,42 @@ loadShapePaths(string const & path, TheaArray<string> & shape_paths)
   return true;
 }
 
-int
-alignShapes(string const & from_path, string const & to_path, std::ostream * out)
+void
+writeAlignment(std::ostream & out, string const & from_path, string const & to_path, DAffineTransform3 const & tr, double error)
 {
-  TheaArray<DVector3> from_pts;
-  if (!loadPoints(from_path, from_pts))
-    return -1;
+  DMatrix3 const & lin = tr.getLinear();
+  DVector3 const & trn = tr.getTranslation();
+
+  out << from_path << '\n'
+      << to_path << '\n'
+      << error << '\n'
+      << lin(0, 0) << ' ' << lin(0, 1) << ' ' << lin(0, 2) << ' ' << trn[0] << '\n'
+      << lin(1, 0) << ' ' << lin(1, 1) << ' ' << lin(1, 2) << ' ' << trn[1] << '\n'
+      << lin(2, 0) << ' ' << lin(2, 1) << ' ' << lin(2, 2) << ' ' << trn[2] << endl;
+}
 
-  TheaArray<DVector3> to_pts;
-  if (!loadPoints(to_path, to_pts))
-    return -1;
+int
+alignShapes(Shape const & from, Shape const & to, DAffineTransform3 & tr, double & error)
+{
+  tr = DAffineTransform3::identity();
+  error = 0;
 
-  DAffineTransform3 tr = DAffineTransform3::identity();
   double from_scale = 1.0, to_scale = 1.0;
-  double error = 0;
-  if (from_pts.empty())
+  if (from.points.empty())
   {
     THEA_WARNING << "Source shape is empty: returning identity transform";
   }
-  else if (to_pts.empty())
+  else if (to.points.empty())
   {
     THEA_WARNING << "Target shape is empty: returning identity transform";
   }
   else
   {
-    DAffineTransform3 init_tr = normalization(from_pts, to_pts, from_scale, to_scale);
+    alwaysAssertM(to.kdtree, "Target shape has no kd-tree");
+    DKDTree3 const & to_kdtree = *to.kdtree;
+
+    TheaArray<DVector3> from_pts(from.points);
+    DAffineTransform3 init_tr = normalization(from, to, from_scale, to_scale);
     for (array_size_t i = 0; i < from_pts.size(); ++i)
       from_pts[i] = init_tr * from_pts[i];
 
@@ -337,8 +386,6 @@ alignShapes(string const & from_path, string const & to_path, std::ostream * out
         from_pts[i] += offset;
     }
 
-    KDTreeN<DVector3, 3, double> to_kdtree(to_pts.begin(), to_pts.end());
-
     if (rotate_axis_aligned)
     {
       ICP3<double> icp(-1, -1, false);
@@ -376,9 +423,10 @@ alignShapes(string const & from_path, string const & to_path, std::ostream * out
                 tr = icp_tr * rot_tr;
                 first = false;
 
-                THEA_CONSOLE << "-- rotation " << rot.toString() << " reduced error to " << error;
+                if (log_alignment_steps)
+                  THEA_CONSOLE << "-- rotation " << rot.toString() << " reduced error to " << error;
               }
-              else
+              else if (log_alignment_steps)
                 THEA_CONSOLE << "-- rotation " << rot.toString() << ", no reduction in error";
             }
 
@@ -422,9 +470,10 @@ alignShapes(string const & from_path, string const & to_path, std::ostream * out
           tr = icp_tr * rot_tr;
           first = false;
 
-          THEA_CONSOLE << "-- rotation by " << Math::radiansToDegrees(angle) << " degrees reduced error to " << error;
+          if (log_alignment_steps)
+            THEA_CONSOLE << "-- rotation by " << Math::radiansToDegrees(angle) << " degrees reduced error to " << error;
         }
-        else
+        else if (log_alignment_steps)
           THEA_CONSOLE << "-- rotation by " << Math::radiansToDegrees(angle) << " degrees, no reduction in error";
       }
 
@@ -445,20 +494,164 @@ alignShapes(string const & from_path, string const & to_path, std::ostream * out
     }
   }
 
-  THEA_CONSOLE << "Alignment error = " << std::setprecision(10) << error;
-  THEA_CONSOLE << "Alignment = " << tr.toString();
+  if (log_alignment_steps)
+  {
+    THEA_CONSOLE << "Alignment error = " << std::setprecision(10) << error;
+    THEA_CONSOLE << "Alignment = " << tr.toString();
+  }
+
+  return 0;
+}
+
+int
+alignShapes(string const & from_path, string const & to_path, std::ostream * out)
+{
+  Shape from, to;
+  if (!loadShape(from_path, false, from) || !loadShape(to_path, true, to))
+    return -1;
+
+  DAffineTransform3 tr;
+  double error;
+  if (alignShapes(from, to, tr, error) != 0)
+    return -1;
+
+  if (out)
+    writeAlignment(*out, from_path, to_path, tr, error);
+
+  return 0;
+}
+
+// Aligns a pair of preprocessed shapes. Pair i aligns from_shapes[i / num_to] to to_shapes[i % num_to]. Each pair is reported
+// with a single message, since pairs are aligned in parallel.
+class PairAligner
+{
+  public:
+    PairAligner(TheaArray<Shape> const * shapes_, TheaArray<long> const * from_shapes_, TheaArray<long> const * to_shapes_,
+                TheaArray<DAffineTransform3> * transforms_, TheaArray<double> * errors_, TheaArray<int> * status_)
+    : shapes(shapes_), from_shapes(from_shapes_), to_shapes(to_shapes_), transforms(transforms_), errors(errors_),
+      status(status_)
+    {}
+
+    void operator()(long i)
+    {
+      long num_to = (long)to_shapes->size();
+      Shape const & from = (*shapes)[(array_size_t)(*from_shapes)[(array_size_t)(i / num_to)]];
+      Shape const & to = (*shapes)[(array_size_t)(*to_shapes)[(array_size_t)(i % num_to)]];
+
+      (*status)[(array_size_t)i] = alignShapes(from, to, (*transforms)[(array_size_t)i], (*errors)[(array_size_t)i]);
+      if ((*status)[(array_size_t)i] == 0)
+        THEA_CONSOLE << "Aligned " << from.path << " to " << to.path << " with error " << std::setprecision(10)
+                     << (*errors)[(array_size_t)i];
+    }
+
+  private:
+    TheaArray<Shape> const * shapes;
+    TheaArray<long> const * from_shapes;
+    TheaArray<long> const * to_shapes;
+    TheaArray<DAffineTransform3> * transforms;
+    TheaArray<double> * errors;
+    TheaArray<int> * status;
+
+}; // class PairAligner
+
+// Align every shape in one list to every shape in another, loading and preprocessing each distinct shape only once. The
+// pairs are aligned in parallel. Writes the matrix of alignment errors to a file, and the transforms of all pairs, in row-major
+// order, to an optional output stream.
+int
+alignCorpus(TheaArray<string> const & from_paths, TheaArray<string> const & to_paths, string const & error_path,
+            std::ostream * out)
+{
+  // Map each path to a distinct shape, shared by the two lists
+  TheaArray<Shape> shapes;
+  TheaArray<string> shape_paths;
+  TheaArray<bool> is_target;
+  TheaArray<long> from_shapes, to_shapes;
+  TheaUnorderedMap<string, long> path_indices;
+  for (int k = 0; k < 2; ++k)
+  {
+    TheaArray<string> const & paths = (k == 0 ? from_paths : to_paths);
+    TheaArray<long> & indices = (k == 0 ? from_shapes : to_shapes);
+    for (array_size_t i = 0; i < paths.size(); ++i)
+    {
+      TheaUnorderedMap<string, long>::const_iterator existing = path_indices.find(paths[i]);
+      long index = (existing != path_indices.end() ? existing->second : (long)shape_paths.size());
+      if (existing == path_indices.end())
+      {
+        path_indices[paths[i]] = index;
+        shape_paths.push_back(paths[i]);
+        is_target.push_back(false);
+      }
+
+      if (k == 1)
+        is_target[(array_size_t)index] = true;
+
+      indices.push_back(index);
+    }
+  }
+
+  // Mesh loading is not guaranteed to be thread-safe, so shapes are loaded sequentially
+  shapes.resize(shape_paths.size());
+  for (array_size_t i = 0; i < shapes.size(); ++i)
+    if (!loadShape(shape_paths[i], is_target[i], shapes[i]))
+      return -1;
+
+  THEA_CONSOLE << "Loaded " << shapes.size() << " distinct shapes";
+
+  long num_pairs = (long)from_shapes.size() * (long)to_shapes.size();
+  TheaArray<DAffineTransform3> transforms((array_size_t)num_pairs);
+  TheaArray<double> errors((array_size_t)num_pairs, 0.0);
+  TheaArray<int> status((array_size_t)num_pairs, 0);
+
+  // Pairs take very different times to align, so each thread pulls one pair at a time
+  log_alignment_steps = false;
+  parallelFor(num_pairs, PairAligner(&shapes, &from_shapes, &to_shapes, &transforms, &errors, &status), 1);
+  log_alignment_steps = true;
+
+  for (long i = 0; i < num_pairs; ++i)
+    if (status[(array_size_t)i] != 0)
+    {
+      THEA_ERROR << "Could not align " << from_paths[(array_size_t)(i / (long)to_paths.size())] << " to "
+                 << to_paths[(array_size_t)(i % (long)to_paths.size())];
+      return -1;
+    }
+
+  ofstream err_out(error_path.c_str());
+  if (!err_out)
+  {
+    THEA_ERROR << "Couldn't open error matrix file " << error_path;
+    return -1;
+  }
+
+  err_out << std::setprecision(10);
+  for (array_size_t i = 0, k = 0; i < from_paths.size(); ++i)
+  {
+    for (array_size_t j = 0; j < to_paths.size(); ++j, ++k)
+    {
+      if (j > 0) err_out << ' ';
+      err_out << errors[k];
+    }
+
+    err_out << '\n';
+  }
+
+  if (!err_out)
+  {
+    THEA_ERROR << "Couldn't write error matrix file " << error_path;
+    return -1;
+  }
+
+  THEA_CONSOLE << "Wrote " << from_paths.size() << " x " << to_paths.size() << " error matrix to " << error_path;
 
   if (out)
   {
-    DMatrix3 const & lin = tr.getLinear();
-    DVector3 const & trn = tr.getTranslation();
-
-    *out << from_path << '\n'
-         << to_path << '\n'
-         << error << '\n'
-         << lin(0, 0) << ' ' << lin(0, 1) << ' ' << lin(0, 2) << ' ' << trn[0] << '\n'
-         << lin(1, 0) << ' ' << lin(1, 1) << ' ' << lin(1, 2) << ' ' << trn[1] << '\n'
-         << lin(2, 0) << ' ' << lin(2, 1) << ' ' << lin(2, 2) << ' ' << trn[2] << endl;
+    for (array_size_t i = 0, k = 0; i < from_paths.size(); ++i)
+      for (array_size_t j = 0; j < to_paths.size(); ++j, ++k)
+      {
+        if (k > 0)
+          *out << '\n';
+
+        writeAlignment(*out, from_paths[i], to_paths[j], transforms[k], errors[k]);
+      }
   }
 
   return 0;
@@ -559,6 +752,18 @@ main(int argc, char * argv[])
         rotate_arbitrary = true;
         THEA_CONSOLE << "Alignment will search over rotations";
       }
+      else if (arg == "-v" || arg == "--verbose")
+      {
+        verbose = true;
+      }
+      else if (arg == "--corpus")
+      {
+        if (i >= argc - 1)
+          return usage(argc, argv);
+
+        corpus_error_path = argv[++i];
+        THEA_CONSOLE << "All pairs will be aligned in corpus mode, with errors written to " << corpus_error_path;
+      }
       else
         return usage(argc, argv);
     }
@@ -603,17 +808,33 @@ main(int argc, char * argv[])
   if (!loadShapePaths(from_path, from_shape_paths) || !loadShapePaths(to_path, to_shape_paths))
     return -1;
 
-  for (array_size_t i = 0; i < from_shape_paths.size(); ++i)
-    for (array_size_t j = 0; j < to_shape_paths.size(); ++j)
-    {
-      if (!(i == 0 && j == 0) && out)
-        *out << '\n';
+  if (!corpus_error_path.empty())
+  {
+    if (alignCorpus(from_shape_paths, to_shape_paths, corpus_error_path, out) != 0)
+      return -1;
+  }
+  else
+  {
+    for (array_size_t i = 0; i < from_shape_paths.size(); ++i)
+      for (array_size_t j = 0; j < to_shape_paths.size(); ++j)
+      {
+        if (!(i == 0 && j == 0) && out)
+          *out << '\n';
 
-      THEA_CONSOLE << "*** Aligning " << from_shape_paths[i] << " to " << to_shape_paths[j] << " ***";
-      int status = alignShapes(from_shape_paths[i], to_shape_paths[j], out);
-      if (status != 0)
-        return -1;
-    }
+        THEA_CONSOLE << "*** Aligning " << from_shape_paths[i] << " to " << to_shape_paths[j] << " ***";
+        int status = alignShapes(from_shape_paths[i], to_shape_paths[j], out);
+        if (status != 0)
+          return -1;
+      }
+  }
+
+  if (verbose)
+  {
+    if (QueryStatistics::isEnabled())
+      THEA_CONSOLE << "Spatial query statistics:\n" << QueryStatistics::aggregate().toString();
+    else
+      THEA_CONSOLE << "Spatial query statistics are not available (rebuild with THEA_QUERY_STATISTICS to collect them)";
+  }
 
   return 0;
 }